@@ -0,0 +1,140 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Times the Dart bindings on the shapes of fuchsia.fidl.benchmarks, reporting
+// results named dart/<shape>/<operation> in the same JSON lines as
+// //benchmarks/fidl, so that the languages can be compared side by side.
+//
+// The Dart VM has no allocation counters, so only ns_per_op is reported. The
+// handles shape is left out: dart:zircon cannot create events.
+
+import 'dart:convert';
+import 'dart:typed_data';
+
+import 'package:fidl/fidl.dart';
+import 'package:fidl_fuchsia_fidl_benchmarks/fidl_async.dart';
+
+String _filter = '';
+int _minTimeUs = 100000;
+
+bool _shouldRun(String name) => _filter.isEmpty || name.contains(_filter);
+
+/// Times [op] as the C++ harness does: the iteration count doubles until one
+/// batch takes the minimum time, and only that last batch is reported.
+void _run(String name, void op()) {
+  if (!_shouldRun(name)) {
+    return;
+  }
+  op();
+  final Stopwatch stopwatch = new Stopwatch();
+  for (int iterations = 1;; iterations *= 2) {
+    stopwatch
+      ..reset()
+      ..start();
+    for (int i = 0; i < iterations; ++i) {
+      op();
+    }
+    stopwatch.stop();
+    if (stopwatch.elapsedMicroseconds >= _minTimeUs ||
+        iterations >= (1 << 40)) {
+      print(json.encode(<String, Object>{
+        'name': name,
+        'iterations': iterations,
+        'ns_per_op': stopwatch.elapsedMicroseconds * 1000.0 / iterations,
+      }));
+      return;
+    }
+  }
+}
+
+Message _encode<T>(FidlType<T> type, T value) {
+  final Encoder encoder = new Encoder(0)..alloc(type.encodedSize);
+  type.encode(encoder, value, kMessageHeaderSize);
+  return encoder.message;
+}
+
+T _decode<T>(FidlType<T> type, Message message) {
+  final Decoder decoder = new Decoder(message)..claimMemory(kMessageHeaderSize);
+  return type.decode(decoder, decoder.claimMemory(type.encodedSize));
+}
+
+void _runShape<T>(String shape, FidlType<T> type, T value) {
+  final Message encoded = _encode(type, value);
+  T result;
+  _run('dart/$shape/encode', () {
+    _encode(type, value);
+  });
+  _run('dart/$shape/decode', () {
+    result = _decode(type, encoded);
+  });
+  _run('dart/$shape/encode_decode', () {
+    result = _decode(type, _encode(type, value));
+  });
+  // Keeps the decoded values reachable, so the decodes are not dead code.
+  if (result == null) {
+    throw new StateError('$shape did not decode');
+  }
+}
+
+Small _makeSmall(int id) =>
+    new Small(id: id, flags: 0x5, x: 1.5, y: -2.5, visible: true);
+
+Leaf _makeLeaf(int id) => new Leaf(value: _makeSmall(id), name: 'leaf-$id');
+
+Deep _makeDeep() {
+  return new Deep(
+    head: _makeSmall(0),
+    next: new Level1(
+      leaves: new List<Leaf>.generate(16, _makeLeaf),
+      next: new Level2(
+        label: 'level-2',
+        next: new Level3(
+          leaf: _makeLeaf(100),
+          items: new List<Small>.generate(16, _makeSmall),
+        ),
+      ),
+    ),
+  );
+}
+
+Bytes _makeBytes() {
+  final Uint8List data = new Uint8List(32 * 1024);
+  for (int i = 0; i < data.length; ++i) {
+    data[i] = i & 0xff;
+  }
+  return new Bytes(data: data);
+}
+
+Strings _makeStrings() => new Strings(
+    values: new List<String>.generate(64, (int i) => 'string number $i'));
+
+Table _makeTable() {
+  return new Table(
+    attributes: new Attributes(
+      id: 42,
+      name: 'attributes',
+      counts: new List<int>.generate(32, (int i) => i),
+      small: _makeSmall(7),
+      enabled: true,
+    ),
+  );
+}
+
+void main(List<String> args) {
+  for (final String arg in args) {
+    if (arg.startsWith('--filter=')) {
+      _filter = arg.substring('--filter='.length);
+    } else if (arg.startsWith('--min_time_ms=')) {
+      _minTimeUs = int.parse(arg.substring('--min_time_ms='.length)) * 1000;
+    } else {
+      throw new ArgumentError('Unknown argument: $arg');
+    }
+  }
+
+  _runShape('small', kSmall_Type, _makeSmall(1));
+  _runShape('deep', kDeep_Type, _makeDeep());
+  _runShape('bytes', kBytes_Type, _makeBytes());
+  _runShape('strings', kStrings_Type, _makeStrings());
+  _runShape('table', kTable_Type, _makeTable());
+}
@@ -0,0 +1,385 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures the cost of encoding, decoding, validating and dispatching the
+// message shapes of fuchsia.fidl.benchmarks in the C, HLCPP and LLCPP
+// bindings. See //benchmarks/fidl/dart for the Dart bindings.
+//
+// Results are named <binding>/<shape>/<operation>:
+//
+//   encode         Encodes a value, as a proxy does before writing it.
+//   decode         Decodes a value from a copy of its encoded bytes, as a
+//                  stub does after reading it, including the copy.
+//   validate       Walks the encoded bytes with fidl_validate.
+//   encode_decode  Encodes a value and decodes it back in place. Covers the
+//                  shapes with handles, which cannot be encoded twice.
+//   dispatch       Hands a copy of an encoded request to a generated stub,
+//                  which decodes it and calls the implementation.
+//
+// The C bindings have no code of their own on these paths: they encode and
+// decode with the coding tables through fidl_encode and fidl_decode, so that
+// is what the c/ results measure.
+
+#include <fuchsia/fidl/benchmarks/cpp/fidl.h>
+#include <lib/benchmark/benchmark.h>
+#include <lib/fidl/coding.h>
+#include <lib/fidl/cpp/clone.h>
+#include <lib/fidl/cpp/coding_traits.h>
+#include <lib/fidl/cpp/decoder.h>
+#include <lib/fidl/cpp/encoder.h>
+#include <lib/fidl/cpp/internal/pending_response.h>
+#include <lib/fidl/cpp/internal/stub.h>
+#include <lib/fidl/llcpp/decoded_message.h>
+#include <lib/fidl/llcpp/encoded_message.h>
+#include <lib/fidl/llcpp/traits.h>
+#include <lib/zx/event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zircon/assert.h>
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench = fuchsia::fidl::benchmarks;
+
+namespace {
+
+// The ordinals of the methods of |Sink|, from benchmarks.fidl.
+constexpr uint32_t kSendSmallOrdinal = 1u;
+constexpr uint32_t kSendDeepOrdinal = 2u;
+constexpr uint32_t kSendBytesOrdinal = 3u;
+constexpr uint32_t kSendStringsOrdinal = 4u;
+constexpr uint32_t kSendTableOrdinal = 6u;
+
+// The traits that fidlgen's LLCPP generator gives a type. cc_fidl_library
+// does not generate LLCPP bindings, whose messages have the layout of the
+// coding table, so the benchmark declares the traits the generated types
+// would have.
+template <typename T, uint32_t kMaxNumHandles>
+struct LlcppType {
+  static const fidl_type_t* const type;
+  static constexpr uint32_t MaxNumHandles = kMaxNumHandles;
+  static constexpr uint32_t MaxSize = std::numeric_limits<uint32_t>::max();
+};
+
+template <typename T, uint32_t kMaxNumHandles>
+const fidl_type_t* const LlcppType<T, kMaxNumHandles>::type = T::FidlType;
+
+}  // namespace
+
+namespace fidl {
+
+template <typename T, uint32_t kMaxNumHandles>
+struct IsFidlType<LlcppType<T, kMaxNumHandles>> : public std::true_type {};
+
+}  // namespace fidl
+
+namespace {
+
+void Check(zx_status_t status, const char* what, const char* error_msg) {
+  if (status != ZX_OK) {
+    fprintf(stderr, "%s failed: %d (%s)\n", what, status,
+            error_msg ? error_msg : "");
+    exit(EXIT_FAILURE);
+  }
+}
+
+// Encodes |value| by itself, without a message header.
+template <typename T>
+fidl::Message EncodeValue(fidl::Encoder* encoder, T* value) {
+  encoder->Reset(fidl::Encoder::NO_HEADER);
+  value->Encode(encoder, encoder->Alloc(fidl::CodingTraits<T>::encoded_size));
+  return encoder->GetMessage();
+}
+
+// A value encoded by itself, owning its handles.
+struct EncodedValue {
+  std::vector<uint8_t> bytes;
+  std::vector<zx_handle_t> handles;
+};
+
+// Encodes a copy of |value|, which keeps its own handles.
+template <typename T>
+EncodedValue EncodeCopy(const T& value) {
+  T copy;
+  Check(fidl::Clone(value, &copy), "Clone", nullptr);
+  fidl::Encoder encoder(fidl::Encoder::NO_HEADER);
+  fidl::Message message = EncodeValue(&encoder, &copy);
+  EncodedValue encoded;
+  encoded.bytes.assign(message.bytes().data(),
+                       message.bytes().data() + message.bytes().actual());
+  encoded.handles.assign(
+      message.handles().data(),
+      message.handles().data() + message.handles().actual());
+  message.ClearHandlesUnsafe();
+  return encoded;
+}
+
+template <typename T>
+void RunHlcpp(const std::string& name, T* value) {
+  fidl::Encoder encoder(fidl::Encoder::NO_HEADER);
+  const EncodedValue encoded = EncodeCopy(*value);
+  const bool has_handles = !encoded.handles.empty();
+  zx_handle_close_many(encoded.handles.data(), encoded.handles.size());
+
+  if (!has_handles) {
+    benchmark::Run("hlcpp/" + name + "/encode", [&encoder, value] {
+      fidl::Message message = EncodeValue(&encoder, value);
+      benchmark::DoNotOptimize(message.bytes().data());
+    });
+
+    std::vector<uint8_t> scratch(encoded.bytes.size());
+    const uint32_t size = static_cast<uint32_t>(scratch.size());
+    benchmark::Run("hlcpp/" + name + "/decode", [&encoded, &scratch, size] {
+      memcpy(scratch.data(), encoded.bytes.data(), size);
+      fidl::Message message(fidl::BytePart(scratch.data(), size, size),
+                            fidl::HandlePart());
+      const char* error_msg = nullptr;
+      Check(message.Decode(T::FidlType, &error_msg), "Decode", error_msg);
+      fidl::Decoder decoder(std::move(message));
+      T decoded;
+      T::Decode(&decoder, &decoded, 0u);
+      benchmark::DoNotOptimize(decoded);
+    });
+  }
+
+  benchmark::Run("hlcpp/" + name + "/encode_decode", [&encoder, value] {
+    fidl::Message message = EncodeValue(&encoder, value);
+    const char* error_msg = nullptr;
+    Check(message.Decode(T::FidlType, &error_msg), "Decode", error_msg);
+    fidl::Decoder decoder(std::move(message));
+    T::Decode(&decoder, value, 0u);
+  });
+}
+
+template <typename T>
+void RunHlcppDispatch(const std::string& name, T* value, uint32_t ordinal,
+                      fidl::internal::Stub* stub) {
+  // A request whose only argument is |value| is laid out as |value| after the
+  // message header.
+  fidl::Encoder encoder(ordinal);
+  value->Encode(&encoder,
+                encoder.Alloc(fidl::CodingTraits<T>::encoded_size));
+  fidl::Message request = encoder.GetMessage();
+  ZX_ASSERT(request.handles().actual() == 0u);
+  const std::vector<uint8_t> encoded(
+      request.bytes().data(), request.bytes().data() + request.bytes().actual());
+  std::vector<uint8_t> scratch(encoded.size());
+  const uint32_t size = static_cast<uint32_t>(scratch.size());
+
+  benchmark::Run("hlcpp/" + name + "/dispatch",
+                 [&encoded, &scratch, size, stub] {
+                   memcpy(scratch.data(), encoded.data(), size);
+                   fidl::Message message(
+                       fidl::BytePart(scratch.data(), size, size),
+                       fidl::HandlePart());
+                   Check(stub->Dispatch_(std::move(message),
+                                         fidl::internal::PendingResponse()),
+                         "Dispatch", nullptr);
+                 });
+}
+
+template <typename T>
+void RunC(const std::string& name, const T& value) {
+  EncodedValue encoded = EncodeCopy(value);
+  const fidl_type_t* type = T::FidlType;
+  uint8_t* bytes = encoded.bytes.data();
+  const uint32_t size = static_cast<uint32_t>(encoded.bytes.size());
+  const uint32_t num_handles = static_cast<uint32_t>(encoded.handles.size());
+
+  benchmark::Run("c/" + name + "/validate", [type, bytes, size, num_handles] {
+    const char* error_msg = nullptr;
+    Check(fidl_validate(type, bytes, size, num_handles, &error_msg),
+          "fidl_validate", error_msg);
+  });
+
+  if (num_handles == 0u) {
+    std::vector<uint8_t> scratch(size);
+    benchmark::Run("c/" + name + "/decode", [type, bytes, size, &scratch] {
+      memcpy(scratch.data(), bytes, size);
+      const char* error_msg = nullptr;
+      Check(fidl_decode(type, scratch.data(), size, nullptr, 0u, &error_msg),
+            "fidl_decode", error_msg);
+    });
+  }
+
+  // Decoded once here, the value then goes back and forth in place.
+  std::vector<zx_handle_t> handles(ZX_CHANNEL_MAX_MSG_HANDLES);
+  memcpy(handles.data(), encoded.handles.data(),
+         num_handles * sizeof(zx_handle_t));
+  const char* error_msg = nullptr;
+  Check(fidl_decode(type, bytes, size, handles.data(), num_handles,
+                    &error_msg),
+        "fidl_decode", error_msg);
+  benchmark::Run("c/" + name + "/encode_decode", [type, bytes, size,
+                                                  &handles] {
+    uint32_t actual_handles = 0u;
+    const char* error_msg = nullptr;
+    Check(fidl_encode(type, bytes, size, handles.data(),
+                      static_cast<uint32_t>(handles.size()), &actual_handles,
+                      &error_msg),
+          "fidl_encode", error_msg);
+    Check(fidl_decode(type, bytes, size, handles.data(), actual_handles,
+                      &error_msg),
+          "fidl_decode", error_msg);
+  });
+  fidl_close_handles(type, bytes, size, nullptr);
+}
+
+template <typename T, uint32_t kMaxNumHandles>
+void RunLlcpp(const std::string& name, const T& value) {
+  using Type = LlcppType<T, kMaxNumHandles>;
+  EncodedValue encoded = EncodeCopy(value);
+  const uint32_t size = static_cast<uint32_t>(encoded.bytes.size());
+  const uint32_t num_handles = static_cast<uint32_t>(encoded.handles.size());
+  ZX_ASSERT(num_handles <= kMaxNumHandles);
+
+  // Decoded once here, the message then goes back and forth in place.
+  const char* error_msg = nullptr;
+  Check(fidl_decode(Type::type, encoded.bytes.data(), size,
+                    encoded.handles.data(), num_handles, &error_msg),
+        "fidl_decode", error_msg);
+  fidl::DecodedMessage<Type> decoded(
+      fidl::BytePart(encoded.bytes.data(), size, size));
+  fidl::EncodedMessage<Type> message;
+  benchmark::Run("llcpp/" + name + "/encode_decode", [&decoded, &message] {
+    const char* error_msg = nullptr;
+    Check(decoded.EncodeTo(&message, &error_msg), "EncodeTo", error_msg);
+    Check(decoded.DecodeFrom(&message, &error_msg), "DecodeFrom", error_msg);
+  });
+}
+
+// Runs every benchmark of a shape, in each of the bindings.
+template <typename T, uint32_t kMaxNumHandles>
+void RunShape(const std::string& name, T value, uint32_t ordinal,
+              fidl::internal::Stub* stub) {
+  RunC(name, value);
+  RunLlcpp<T, kMaxNumHandles>(name, value);
+  if (ordinal)
+    RunHlcppDispatch(name, &value, ordinal, stub);
+  RunHlcpp(name, &value);
+}
+
+class SinkImpl : public bench::Sink {
+ public:
+  void SendSmall(bench::Small value) override {
+    benchmark::DoNotOptimize(value);
+  }
+  void SendDeep(bench::Deep value) override { benchmark::DoNotOptimize(value); }
+  void SendBytes(bench::Bytes value) override {
+    benchmark::DoNotOptimize(value);
+  }
+  void SendStrings(bench::Strings value) override {
+    benchmark::DoNotOptimize(value);
+  }
+  void SendHandles(bench::Handles value) override {
+    benchmark::DoNotOptimize(value);
+  }
+  void SendTable(bench::Table value) override {
+    benchmark::DoNotOptimize(value);
+  }
+};
+
+bench::Small MakeSmall(uint64_t id) {
+  bench::Small small;
+  small.id = id;
+  small.flags = 0x5u;
+  small.x = 1.5f;
+  small.y = -2.5f;
+  small.visible = true;
+  return small;
+}
+
+bench::Leaf MakeLeaf(uint64_t id) {
+  bench::Leaf leaf;
+  leaf.value = MakeSmall(id);
+  leaf.name = "leaf " + std::to_string(id);
+  return leaf;
+}
+
+bench::Deep MakeDeep() {
+  auto level3 = std::make_unique<bench::Level3>();
+  level3->leaf = std::make_unique<bench::Leaf>(MakeLeaf(3u));
+  level3->items.resize(0u);
+  for (uint64_t i = 0u; i < 16u; ++i)
+    level3->items.push_back(MakeSmall(i));
+
+  auto level2 = std::make_unique<bench::Level2>();
+  level2->next = std::move(level3);
+  level2->label = "the second level of a deep message";
+
+  auto level1 = std::make_unique<bench::Level1>();
+  level1->next = std::move(level2);
+  level1->leaves.resize(0u);
+  for (uint64_t i = 0u; i < 16u; ++i)
+    level1->leaves.push_back(MakeLeaf(i));
+
+  bench::Deep deep;
+  deep.next = std::move(level1);
+  deep.head = MakeSmall(0u);
+  return deep;
+}
+
+bench::Bytes MakeBytes() {
+  bench::Bytes bytes;
+  bytes.data.resize(32u * 1024u);
+  for (size_t i = 0u; i < bytes.data->size(); ++i)
+    bytes.data->at(i) = static_cast<uint8_t>(i);
+  return bytes;
+}
+
+bench::Strings MakeStrings() {
+  bench::Strings strings;
+  strings.values.resize(0u);
+  for (int i = 0; i < 64; ++i)
+    strings.values.push_back("string number " + std::to_string(i));
+  return strings;
+}
+
+bench::Handles MakeHandles() {
+  bench::Handles handles;
+  handles.events.resize(0u);
+  for (int i = 0; i < 64; ++i) {
+    zx::event event;
+    Check(zx::event::create(0u, &event), "zx::event::create", nullptr);
+    handles.events.push_back(std::move(event));
+  }
+  return handles;
+}
+
+bench::Table MakeTable() {
+  fidl::VectorPtr<uint32_t> counts;
+  for (uint32_t i = 0u; i < 32u; ++i)
+    counts.push_back(i);
+  bench::Table table;
+  table.attributes.set_id(42u);
+  table.attributes.set_name("a table with every field set");
+  table.attributes.set_counts(std::move(counts));
+  table.attributes.set_small(MakeSmall(1u));
+  table.attributes.set_enabled(true);
+  return table;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  benchmark::Init(argc, argv);
+
+  SinkImpl sink;
+  bench::Sink_Stub stub(&sink);
+
+  RunShape<bench::Small, 0u>("small", MakeSmall(1u), kSendSmallOrdinal, &stub);
+  RunShape<bench::Deep, 0u>("deep", MakeDeep(), kSendDeepOrdinal, &stub);
+  RunShape<bench::Bytes, 0u>("bytes", MakeBytes(), kSendBytesOrdinal, &stub);
+  RunShape<bench::Strings, 0u>("strings", MakeStrings(), kSendStringsOrdinal,
+                               &stub);
+  // Requests carrying handles cannot be dispatched twice.
+  RunShape<bench::Handles, 64u>("handles", MakeHandles(), 0u, &stub);
+  RunShape<bench::Table, 0u>("table", MakeTable(), kSendTableOrdinal, &stub);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/benchmark/benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+namespace benchmark {
+namespace {
+
+std::atomic<uint64_t> g_allocations{0u};
+std::atomic<uint64_t> g_allocated_bytes{0u};
+
+std::string g_filter;
+std::chrono::nanoseconds g_min_time = std::chrono::milliseconds(100);
+
+void* CountedAlloc(size_t size) {
+  g_allocations.fetch_add(1u, std::memory_order_relaxed);
+  g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  // malloc(0) may return null, which operator new must not.
+  return malloc(size ? size : 1u);
+}
+
+// Writes |name| as a JSON string. Benchmark names never need escaping beyond
+// quotes and backslashes.
+void PrintName(const std::string& name) {
+  putchar('"');
+  for (char c : name) {
+    if (c == '"' || c == '\\')
+      putchar('\\');
+    putchar(c);
+  }
+  putchar('"');
+}
+
+}  // namespace
+
+void Init(int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--filter=", 9) == 0) {
+      g_filter = arg + 9;
+    } else if (strncmp(arg, "--min_time_ms=", 14) == 0) {
+      g_min_time = std::chrono::milliseconds(atol(arg + 14));
+    } else {
+      fprintf(stderr, "Unknown argument: %s\n", arg);
+      fprintf(stderr, "Usage: %s [--filter=<substring>] [--min_time_ms=<ms>]\n",
+              argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+bool ShouldRun(const std::string& name) {
+  return g_filter.empty() || name.find(g_filter) != std::string::npos;
+}
+
+AllocationCounts GetAllocationCounts() {
+  return {g_allocations.load(std::memory_order_relaxed),
+          g_allocated_bytes.load(std::memory_order_relaxed)};
+}
+
+namespace internal {
+
+std::chrono::nanoseconds MinTime() { return g_min_time; }
+
+void ReportRun(const std::string& name, uint64_t iterations,
+               std::chrono::nanoseconds elapsed,
+               const AllocationCounts& before, const AllocationCounts& after) {
+  const double count = static_cast<double>(iterations);
+  printf("{\"name\":");
+  PrintName(name);
+  printf(
+      ",\"iterations\":%llu,\"ns_per_op\":%.2f,\"bytes_per_op\":%.2f,"
+      "\"allocs_per_op\":%.2f}\n",
+      static_cast<unsigned long long>(iterations),
+      static_cast<double>(elapsed.count()) / count,
+      static_cast<double>(after.bytes - before.bytes) / count,
+      static_cast<double>(after.allocations - before.allocations) / count);
+  fflush(stdout);
+}
+
+}  // namespace internal
+
+void ReportLatencies(const std::string& name,
+                     std::vector<std::chrono::nanoseconds> samples) {
+  if (samples.empty())
+    return;
+  std::sort(samples.begin(), samples.end());
+  auto percentile = [&samples](double p) {
+    size_t index = static_cast<size_t>(p * (samples.size() - 1u) + 0.5);
+    return static_cast<double>(samples[index].count());
+  };
+  ReportValues(name, {{"samples", static_cast<double>(samples.size())},
+                      {"p50_ns", percentile(0.5)},
+                      {"p90_ns", percentile(0.9)},
+                      {"p99_ns", percentile(0.99)},
+                      {"max_ns", static_cast<double>(samples.back().count())}});
+}
+
+void ReportValues(const std::string& name,
+                  const std::vector<std::pair<std::string, double>>& values) {
+  printf("{\"name\":");
+  PrintName(name);
+  for (const auto& value : values) {
+    putchar(',');
+    PrintName(value.first);
+    printf(":%.2f", value.second);
+  }
+  printf("}\n");
+  fflush(stdout);
+}
+
+}  // namespace benchmark
+
+// Counts every allocation the benchmarks make.
+
+void* operator new(size_t size) {
+  void* p = benchmark::CountedAlloc(size);
+  // Built without exceptions, so there is no |std::bad_alloc| to throw.
+  if (!p)
+    abort();
+  return p;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return benchmark::CountedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return benchmark::CountedAlloc(size);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+
+void operator delete[](void* p) noexcept { free(p); }
+
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+void operator delete[](void* p, size_t) noexcept { free(p); }
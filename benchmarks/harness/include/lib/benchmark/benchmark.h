@@ -0,0 +1,106 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_BENCHMARK_BENCHMARK_H_
+#define LIB_BENCHMARK_BENCHMARK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace benchmark {
+
+// A minimal harness for benchmark binaries, timed with |std::chrono| so that
+// it needs nothing beyond the SDK.
+//
+// Each result is printed to stdout as one JSON object per line, for scripts
+// to collect and compare across releases:
+//
+//   {"name":"hlcpp/small/encode","iterations":1048576,"ns_per_op":41.2,
+//    "bytes_per_op":0,"allocs_per_op":0}
+//
+// Allocations are counted by replacements of the global |operator new| and
+// |operator delete| linked in with the harness, across all threads.
+//
+// Command line:
+//
+//   --filter=<substring>  runs only the benchmarks whose name contains it.
+//   --min_time_ms=<ms>    times each benchmark for at least this long (100).
+
+// Parses the harness's flags out of the command line.
+void Init(int argc, char** argv);
+
+// Whether the benchmark called |name| is selected by the filter.
+bool ShouldRun(const std::string& name);
+
+// The number of allocations and bytes allocated since the process started.
+struct AllocationCounts {
+  uint64_t allocations;
+  uint64_t bytes;
+};
+AllocationCounts GetAllocationCounts();
+
+// Keeps the compiler from optimizing away the computation of |value|.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+namespace internal {
+
+std::chrono::nanoseconds MinTime();
+
+void ReportRun(const std::string& name, uint64_t iterations,
+               std::chrono::nanoseconds elapsed,
+               const AllocationCounts& before, const AllocationCounts& after);
+
+}  // namespace internal
+
+// Times |op|, a callable taking no arguments, over as many iterations as fit
+// in the minimum time, and reports its cost per iteration.
+//
+// The iteration count doubles until one batch takes the minimum time; only
+// that last batch is reported, so one-time costs such as growing buffers on
+// the first iterations are left out.
+template <typename Op>
+void Run(const std::string& name, Op op) {
+  if (!ShouldRun(name))
+    return;
+  using Clock = std::chrono::steady_clock;
+  const std::chrono::nanoseconds min_time = internal::MinTime();
+  op();
+  for (uint64_t iterations = 1u;; iterations *= 2u) {
+    const AllocationCounts before = GetAllocationCounts();
+    const Clock::time_point start = Clock::now();
+    for (uint64_t i = 0u; i < iterations; ++i)
+      op();
+    const std::chrono::nanoseconds elapsed = Clock::now() - start;
+    const AllocationCounts after = GetAllocationCounts();
+    if (elapsed >= min_time || iterations >= (uint64_t(1) << 40)) {
+      internal::ReportRun(name, iterations, elapsed, before, after);
+      return;
+    }
+  }
+}
+
+// Reports the distribution of |samples|, such as the latencies of single
+// operations, as percentiles.
+//
+// Unlike |Run|, the reports are not filtered: check |ShouldRun| before
+// collecting the samples.
+void ReportLatencies(const std::string& name,
+                     std::vector<std::chrono::nanoseconds> samples);
+
+// Reports named values that are not per-operation costs, such as the
+// throughput of a configuration.
+void ReportValues(const std::string& name,
+                  const std::vector<std::pair<std::string, double>>& values);
+
+}  // namespace benchmark
+
+#endif  // LIB_BENCHMARK_BENCHMARK_H_
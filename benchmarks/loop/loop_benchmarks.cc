@@ -0,0 +1,263 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures the costs of the message loop and of FIDL calls dispatched by it:
+//
+//   fidl/echo/latency             Round trips of an async call, from posting
+//                                 the request to running its callback.
+//   fidl/echo_sync/latency        Round trips of a synchronous call.
+//   fidl/echo/throughput/...      Calls per second served by a loop with
+//                                 1 to kMaxLoopThreads threads, for
+//                                 kMaxLoopThreads bindings each called
+//                                 from a client thread of its own.
+//   loop/post_task/latency        From posting a task on one thread to its
+//                                 handler running on the loop's thread.
+//   loop/timer/post_cancel        Posting a delayed task and cancelling it,
+//                                 alone and among pending timers.
+
+#include <fuchsia/fidl/benchmarks/cpp/fidl.h>
+#include <lib/async-loop/cpp/loop.h>
+#include <lib/async/cpp/task.h>
+#include <lib/async/task.h>
+#include <lib/benchmark/benchmark.h>
+#include <lib/fidl/cpp/binding.h>
+#include <lib/sync/completion.h>
+#include <lib/zx/channel.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+using fuchsia::fidl::benchmarks::Echo;
+
+// The largest number of loop threads that the throughput is measured with.
+constexpr uint32_t kMaxLoopThreads = 4u;
+
+// The fewest samples a latency is reported from, however fast they are.
+constexpr size_t kMinSamples = 1000u;
+
+class EchoImpl : public Echo {
+ public:
+  void EchoValue(uint64_t value, EchoValueCallback callback) override {
+    callback(value);
+  }
+};
+
+// Collects the durations of |op| until both the minimum time has passed and
+// |kMinSamples| have been taken.
+template <typename Op>
+std::vector<std::chrono::nanoseconds> CollectLatencies(Op op) {
+  std::vector<std::chrono::nanoseconds> samples;
+  const Clock::time_point end =
+      Clock::now() + benchmark::internal::MinTime();
+  while (samples.size() < kMinSamples || Clock::now() < end)
+    samples.push_back(op());
+  return samples;
+}
+
+void Check(zx_status_t status, const char* what) {
+  if (status != ZX_OK) {
+    fprintf(stderr, "%s failed: %d\n", what, status);
+    abort();
+  }
+}
+
+void RunEchoLatency() {
+  const bool run_async = benchmark::ShouldRun("fidl/echo/latency");
+  const bool run_sync = benchmark::ShouldRun("fidl/echo_sync/latency");
+  if (!run_async && !run_sync)
+    return;
+
+  async::Loop server_loop(&kAsyncLoopConfigNoAttachToThread);
+  EchoImpl impl;
+  fidl::Binding<Echo> binding(&impl);
+  fidl::Binding<Echo> sync_binding(&impl);
+
+  async::Loop client_loop(&kAsyncLoopConfigNoAttachToThread);
+  fuchsia::fidl::benchmarks::EchoPtr echo;
+  binding.Bind(echo.NewRequest(client_loop.dispatcher()),
+               server_loop.dispatcher());
+  fuchsia::fidl::benchmarks::EchoSyncPtr echo_sync;
+  sync_binding.Bind(echo_sync.NewRequest(), server_loop.dispatcher());
+  Check(server_loop.StartThread("echo-server"), "StartThread");
+
+  if (run_async) {
+    uint64_t value = 0u;
+    benchmark::ReportLatencies(
+        "fidl/echo/latency", CollectLatencies([&] {
+          const Clock::time_point start = Clock::now();
+          echo->EchoValue(value++,
+                          [&client_loop](uint64_t) { client_loop.Quit(); });
+          client_loop.Run();
+          client_loop.ResetQuit();
+          return std::chrono::nanoseconds(Clock::now() - start);
+        }));
+  }
+
+  if (run_sync) {
+    uint64_t value = 0u;
+    benchmark::ReportLatencies(
+        "fidl/echo_sync/latency", CollectLatencies([&] {
+          const Clock::time_point start = Clock::now();
+          uint64_t result;
+          Check(echo_sync->EchoValue(value++, &result), "EchoValue");
+          return std::chrono::nanoseconds(Clock::now() - start);
+        }));
+  }
+
+  // The bindings are destroyed only once no thread is dispatching to them.
+  server_loop.Quit();
+  server_loop.JoinThreads();
+  server_loop.Shutdown();
+}
+
+// Serves |num_bindings| bindings on a loop with |num_threads| threads, each
+// called as fast as it answers by a client thread of its own.
+void RunEchoThroughput(uint32_t num_bindings, uint32_t num_threads) {
+  const std::string name = "fidl/echo/throughput/" +
+                           std::to_string(num_bindings) + "_bindings/" +
+                           std::to_string(num_threads) + "_threads";
+  if (!benchmark::ShouldRun(name))
+    return;
+
+  async::Loop server_loop(&kAsyncLoopConfigNoAttachToThread);
+  EchoImpl impl;
+  // Each binding unbinds itself when its client goes away, on whichever
+  // thread sees the peer close, so they are not kept in a BindingSet.
+  std::vector<std::unique_ptr<fidl::Binding<Echo>>> bindings;
+  std::vector<zx::channel> clients;
+  for (uint32_t i = 0; i < num_bindings; ++i) {
+    zx::channel client, server;
+    Check(zx::channel::create(0, &client, &server), "zx_channel_create");
+    bindings.push_back(std::make_unique<fidl::Binding<Echo>>(
+        &impl, std::move(server), server_loop.dispatcher()));
+    clients.push_back(std::move(client));
+  }
+  for (uint32_t i = 0; i < num_threads; ++i)
+    Check(server_loop.StartThread("echo-server"), "StartThread");
+
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> calls{0u};
+  const Clock::time_point start = Clock::now();
+  std::vector<std::thread> threads;
+  for (zx::channel& client : clients) {
+    threads.emplace_back([&stop, &calls, channel = std::move(client)]() mutable {
+      fuchsia::fidl::benchmarks::EchoSyncPtr echo;
+      echo.Bind(std::move(channel));
+      uint64_t count = 0u;
+      while (!stop.load(std::memory_order_relaxed)) {
+        uint64_t result;
+        Check(echo->EchoValue(count, &result), "EchoValue");
+        ++count;
+      }
+      calls.fetch_add(count, std::memory_order_relaxed);
+    });
+  }
+  std::this_thread::sleep_for(benchmark::internal::MinTime());
+  stop.store(true, std::memory_order_relaxed);
+  for (std::thread& thread : threads)
+    thread.join();
+  const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  server_loop.Quit();
+  server_loop.JoinThreads();
+  server_loop.Shutdown();
+
+  benchmark::ReportValues(
+      name, {{"bindings", static_cast<double>(num_bindings)},
+             {"threads", static_cast<double>(num_threads)},
+             {"calls", static_cast<double>(calls.load())},
+             {"calls_per_second", calls.load() / elapsed.count()}});
+}
+
+// A task that records how long after being posted it ran.
+struct LatencyTask {
+  async_task_t task;  // Must be first.
+  Clock::time_point posted;
+  std::chrono::nanoseconds latency;
+  sync_completion_t done;
+
+  static void Handle(async_dispatcher_t*, async_task_t* task, zx_status_t) {
+    LatencyTask* self = reinterpret_cast<LatencyTask*>(task);
+    self->latency = Clock::now() - self->posted;
+    sync_completion_signal(&self->done);
+  }
+};
+
+// The SDK has no |async::PostTask|, so this posts an |async_task_t| as it
+// would.
+void RunPostTaskLatency() {
+  if (!benchmark::ShouldRun("loop/post_task/latency"))
+    return;
+
+  async::Loop loop(&kAsyncLoopConfigNoAttachToThread);
+  Check(loop.StartThread("post-task"), "StartThread");
+  LatencyTask latency_task = {};
+  latency_task.task.handler = &LatencyTask::Handle;
+  benchmark::ReportLatencies(
+      "loop/post_task/latency", CollectLatencies([&] {
+        sync_completion_reset(&latency_task.done);
+        latency_task.task.state = ASYNC_STATE_INIT;
+        latency_task.task.deadline = async_now(loop.dispatcher());
+        latency_task.posted = Clock::now();
+        Check(async_post_task(loop.dispatcher(), &latency_task.task),
+              "async_post_task");
+        Check(sync_completion_wait(&latency_task.done, ZX_TIME_INFINITE),
+              "sync_completion_wait");
+        return latency_task.latency;
+      }));
+  loop.Quit();
+  loop.JoinThreads();
+}
+
+// Times posting a delayed task and cancelling it with |num_pending| other
+// timers pending, half of them due before it.
+void RunTimerPostCancel(uint32_t num_pending) {
+  const std::string name =
+      num_pending == 0u ? "loop/timer/post_cancel"
+                        : "loop/timer/post_cancel/" +
+                              std::to_string(num_pending) + "_pending";
+  if (!benchmark::ShouldRun(name))
+    return;
+
+  // Never run, so the timers stay pending until the loop is destroyed.
+  async::Loop loop(&kAsyncLoopConfigNoAttachToThread);
+  std::vector<std::unique_ptr<async::TaskClosure>> pending;
+  for (uint32_t i = 0; i < num_pending; ++i) {
+    pending.push_back(std::make_unique<async::TaskClosure>([] {}));
+    Check(pending.back()->PostDelayed(loop.dispatcher(),
+                                      zx::sec(60) + zx::msec(2 * i)),
+          "PostDelayed");
+  }
+  async::TaskClosure task([] {});
+  const zx::duration delay = zx::sec(60) + zx::msec(num_pending);
+  benchmark::Run(name, [&] {
+    task.PostDelayed(loop.dispatcher(), delay);
+    task.Cancel();
+  });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  benchmark::Init(argc, argv);
+
+  RunEchoLatency();
+  for (uint32_t threads = 1u; threads <= kMaxLoopThreads; ++threads)
+    RunEchoThroughput(kMaxLoopThreads, threads);
+  RunPostTaskLatency();
+  RunTimerPostCancel(0u);
+  RunTimerPostCancel(1000u);
+
+  return 0;
+}
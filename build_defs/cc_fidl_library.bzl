@@ -10,6 +10,17 @@ load(":fidl_library.bzl", "FidlLibraryInfo")
 #
 #   library
 #     Label of the FIDL library.
+#
+#   bindings
+#     List of the bindings to generate, among "hlcpp" (<.../cpp/fidl.h>, the
+#     default) and "c" (<.../c/fidl.h>). The C bindings of a library include
+#     those of its dependencies, which must generate them too.
+#
+#   optimize
+#     Whether the encoding, decoding and dispatch code of the generated
+#     bindings is compiled for "speed" or for "size". In "size" mode, binaries
+#     only keep the code and coding tables of the types they use. Leave unset
+#     to use the build's settings.
 
 CodegenInfo = provider(fields=["impl"])
 
@@ -80,6 +91,59 @@ _codegen = rule(
     }
 )
 
+def _c_codegen_impl(context):
+    info = context.attr.library[FidlLibraryInfo]
+
+    header = context.actions.declare_file(
+        context.attr.name + "_include/" + info.name.replace(".", "/") +
+        "/c/fidl.h")
+
+    files_argument = []
+    inputs = []
+    for lib in info.info:
+        files_argument += ["--files"] + [f.path for f in lib.files]
+        inputs.extend(lib.files)
+
+    context.actions.run(
+        executable = context.executable._fidlc,
+        arguments = [
+            "--c-header",
+            header.path,
+            "--name",
+            info.name,
+        ] + files_argument,
+        inputs = inputs,
+        outputs = [
+            header,
+        ],
+        mnemonic = "FidlcC",
+    )
+
+    return [
+        DefaultInfo(files = depset([header]))
+    ]
+
+# Runs fidlc to produce the C bindings header. The C bindings use the coding
+# tables of the FIDL library target, so the header is the only output.
+_c_codegen = rule(
+    implementation = _c_codegen_impl,
+    output_to_genfiles = True,
+    attrs = {
+        "library": attr.label(
+            doc = "The FIDL library to generate code for",
+            mandatory = True,
+            allow_files = False,
+            providers = [FidlLibraryInfo],
+        ),
+        "_fidlc": attr.label(
+            default = Label("//tools:fidlc"),
+            allow_single_file = True,
+            executable = True,
+            cfg = "host",
+        ),
+    }
+)
+
 # Simply declares the implementation file generated by the codegen target as an
 # output.
 # This allows the implementation file to be exposed as a source in its own rule.
@@ -96,37 +160,81 @@ _impl_wrapper = rule(
     }
 )
 
-def cc_fidl_library(name, library, deps=[], tags=[], visibility=None):
-    gen_name = "%s_codegen" % name
-    impl_name = "%s_impl" % name
+_BINDINGS = ["hlcpp", "c"]
 
-    _codegen(
-        name = gen_name,
-        library = library,
-    )
+_OPTIMIZE_COPTS = {
+    "speed": ["-O2"],
+    # fidlgen emits the code of every type of a library in one source file.
+    # Putting each function and coding table in its own section lets the
+    # linker drop the ones a binary never references.
+    "size": ["-Os", "-ffunction-sections", "-fdata-sections"],
+}
 
-    _impl_wrapper(
-        name = impl_name,
-        codegen = ":%s" % gen_name,
-    )
+# Propagated to the binaries that link the library.
+_OPTIMIZE_LINKOPTS = {
+    "size": ["-Wl,--gc-sections"],
+}
+
+def cc_fidl_library(name, library, bindings=["hlcpp"], optimize=None, deps=[],
+                    tags=[], visibility=None):
+    for binding in bindings:
+        if binding not in _BINDINGS:
+            fail("Unknown FIDL binding \"%s\", expected one of %s" %
+                 (binding, _BINDINGS), "bindings")
+    if not bindings:
+        fail("At least one binding is needed", "bindings")
+    if optimize != None and optimize not in _OPTIMIZE_COPTS:
+        fail("Unknown optimization \"%s\", expected one of %s" %
+             (optimize, _OPTIMIZE_COPTS.keys()), "optimize")
+
+    hdrs = []
+    srcs = [
+        # For the coding tables.
+        library,
+    ]
+    includes = []
+    library_deps = []
+
+    if "hlcpp" in bindings:
+        gen_name = "%s_codegen" % name
+        impl_name = "%s_impl" % name
+
+        _codegen(
+            name = gen_name,
+            library = library,
+        )
+
+        _impl_wrapper(
+            name = impl_name,
+            codegen = ":%s" % gen_name,
+        )
+
+        hdrs.append(":%s" % gen_name)
+        srcs.append(":%s" % impl_name)
+        # This is necessary in order to locate generated headers.
+        includes.append(gen_name + ".cc")
+        library_deps.append(Label("//pkg/fidl_cpp"))
+
+    if "c" in bindings:
+        c_gen_name = "%s_c_codegen" % name
+
+        _c_codegen(
+            name = c_gen_name,
+            library = library,
+        )
+
+        hdrs.append(":%s" % c_gen_name)
+        includes.append(c_gen_name + "_include")
+        library_deps.append(Label("//pkg/fidl"))
 
     native.cc_library(
         name = name,
-        hdrs = [
-            ":%s" % gen_name,
-        ],
-        srcs = [
-            ":%s" % impl_name,
-            # For the coding tables.
-            library,
-        ],
-        includes = [
-            # This is necessary in order to locate generated headers.
-            gen_name + ".cc",
-        ],
-        deps = deps + [
-            Label("//pkg/fidl_cpp"),
-        ],
+        hdrs = hdrs,
+        srcs = srcs,
+        includes = includes,
+        copts = _OPTIMIZE_COPTS.get(optimize, []),
+        linkopts = _OPTIMIZE_LINKOPTS.get(optimize, []),
+        deps = deps + library_deps,
         tags = tags,
         visibility = visibility,
     )
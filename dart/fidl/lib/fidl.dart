@@ -12,6 +12,7 @@ export 'src/enum.dart';
 export 'src/error.dart';
 export 'src/interface.dart';
 export 'src/interface_async.dart';
+export 'src/lazy_string.dart';
 export 'src/message.dart';
 export 'src/struct.dart';
 export 'src/table.dart';
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+import 'dart:collection';
 import 'dart:typed_data';
 
 import 'package:zircon/zircon.dart';
@@ -28,8 +29,67 @@ void _throwIfNegative(int value) {
 
 const int _kInitialBufferSize = 1024;
 
+/// The most buffers an [EncoderBufferPool] keeps.
+const int _kMaxPooledBuffers = 4;
+
+/// The largest buffer an [EncoderBufferPool] keeps, which is the most bytes a
+/// channel message can hold.
+const int _kMaxPooledBufferSize = 65536;
+
+/// A small set of buffers that [Encoder]s reuse instead of allocating a new
+/// one for each message.
+///
+/// Proxies own a pool and take back the buffer of each message once it is
+/// written to the channel, which copies it.  A buffer must not be used after
+/// it is released, so messages encoded with a pool must only be sent once.
+class EncoderBufferPool {
+  final List<ByteData> _free = <ByteData>[];
+  final Set<ByteBuffer> _lent = new HashSet<ByteBuffer>.identity();
+
+  /// Returns a zeroed buffer of at least [size] bytes.
+  ByteData acquire(int size) {
+    for (int i = 0; i < _free.length; i++) {
+      if (_free[i].lengthInBytes >= size) {
+        final ByteData data = _free.removeAt(i);
+        _lent.add(data.buffer);
+        return data;
+      }
+    }
+    final ByteData data = new ByteData(size);
+    if (size <= _kMaxPooledBufferSize) {
+      _lent.add(data.buffer);
+    }
+    return data;
+  }
+
+  /// Takes back the buffer that [data] views, if it came from [acquire],
+  /// after zeroing the [data.lengthInBytes] bytes the encoder used.
+  void release(ByteData data) {
+    final ByteBuffer buffer = data.buffer;
+    if (!_lent.remove(buffer)) {
+      return;
+    }
+    if (_free.length >= _kMaxPooledBuffers) {
+      return;
+    }
+    buffer.asUint8List(data.offsetInBytes, data.lengthInBytes)
+        .fillRange(0, data.lengthInBytes, 0);
+    _free.add(buffer.asByteData());
+  }
+}
+
 class Encoder {
-  Encoder(int ordinal) {
+  /// Creates an encoder for a message with [ordinal].
+  ///
+  /// [sizeHint] is the number of bytes the message is expected to take, such
+  /// as the inline size of its request struct plus the sizes of its known
+  /// vectors and strings, so that the buffer does not have to grow during
+  /// encoding.  When [pool] is given, the buffer comes from it.
+  Encoder(int ordinal, {int sizeHint, EncoderBufferPool pool}) : _pool = pool {
+    final int size = (sizeHint == null || sizeHint < kMessageHeaderSize)
+        ? _kInitialBufferSize
+        : _align(sizeHint);
+    data = pool != null ? pool.acquire(size) : new ByteData(size);
     _encodeMessageHeader(ordinal);
   }
 
@@ -38,21 +98,31 @@ class Encoder {
     return new Message(trimmed, _handles, _extent, _handles.length);
   }
 
-  ByteData data = new ByteData(_kInitialBufferSize);
+  ByteData data;
+  final EncoderBufferPool _pool;
   final List<Handle> _handles = <Handle>[];
   int _extent = 0;
 
   void _grow(int newSize) {
-    final Uint8List newList = new Uint8List(newSize)
-      ..setRange(0, data.lengthInBytes, data.buffer.asUint8List());
-    data = newList.buffer.asByteData();
+    final ByteData oldData = data;
+    final ByteData newData =
+        _pool != null ? _pool.acquire(newSize) : new ByteData(newSize);
+    newData.buffer
+        .asUint8List()
+        .setRange(0, oldData.lengthInBytes, oldData.buffer.asUint8List());
+    data = newData;
+    _pool?.release(oldData);
   }
 
   void _claimMemory(int claimSize) {
     _extent += claimSize;
     if (_extent > data.lengthInBytes) {
-      int newSize = data.lengthInBytes + claimSize;
-      newSize += newSize >> 1;
+      // Doubling keeps the number of copies logarithmic in the size of the
+      // message; a claim larger than that is taken in one step.
+      int newSize = data.lengthInBytes * 2;
+      if (newSize < _extent) {
+        newSize = _extent;
+      }
       _grow(newSize);
     }
   }
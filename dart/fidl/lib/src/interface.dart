@@ -8,6 +8,7 @@ import 'dart:collection';
 import 'package:meta/meta.dart';
 import 'package:zircon/zircon.dart';
 
+import 'codec.dart';
 import 'error.dart';
 import 'message.dart';
 
@@ -176,7 +177,7 @@ abstract class Binding<T> {
   /// FIDL compiler for a specific interface.
   Binding() {
     _reader
-      ..onReadable = _handleReadable
+      ..onMessage = _handleMessage
       ..onError = _handleError;
   }
 
@@ -290,8 +291,7 @@ abstract class Binding<T> {
   @protected
   void handleMessage(Message message, MessageSink respond);
 
-  void _handleReadable() {
-    final ReadResult result = _reader.channel.queryAndRead();
+  void _handleMessage(ReadResult result) {
     if ((result.bytes == null) || (result.bytes.lengthInBytes == 0))
       throw new FidlError('Unexpected empty message or error: $result');
 
@@ -360,7 +360,7 @@ class ProxyController<T> {
   /// property of a `TProxy` object.
   ProxyController({this.$serviceName, this.$interfaceName}) {
     _reader
-      ..onReadable = _handleReadable
+      ..onMessage = _handleMessage
       ..onError = _handleError;
   }
 
@@ -505,8 +505,7 @@ class ProxyController<T> {
     _pendingResponsesCount = 0;
   }
 
-  void _handleReadable() {
-    final ReadResult result = _reader.channel.queryAndRead();
+  void _handleMessage(ReadResult result) {
     if ((result.bytes == null) || (result.bytes.lengthInBytes == 0)) {
       proxyError('Read from channel failed');
       return;
@@ -537,6 +536,12 @@ class ProxyController<T> {
     }
   }
 
+  /// The buffers that the encoders of this proxy's messages reuse.
+  ///
+  /// Generated code passes it to [Encoder], and the buffer of each message
+  /// returns to it once the message is written to the channel.
+  final EncoderBufferPool encoderPool = new EncoderBufferPool();
+
   /// Sends the given messages over the bound channel.
   ///
   /// Used by subclasses of [Proxy<T>] to send encoded messages.
@@ -546,6 +551,7 @@ class ProxyController<T> {
       return;
     }
     final int status = _reader.channel.write(message.data, message.handles);
+    encoderPool.release(message.data);
     if (status != ZX.OK)
       proxyError(
           'Failed to write to channel: ${_reader.channel} (status: $status)');
@@ -568,6 +574,7 @@ class ProxyController<T> {
       txid = _nextTxid++ & _kUserspaceTxidMask;
     message.txid = txid;
     final int status = _reader.channel.write(message.data, message.handles);
+    encoderPool.release(message.data);
 
     if (status != ZX.OK) {
       proxyError(
@@ -3,11 +3,11 @@
 // found in the LICENSE file.
 
 import 'dart:async';
-import 'dart:collection';
 
 import 'package:zircon/zircon.dart';
 import 'package:meta/meta.dart';
 
+import 'codec.dart';
 import 'error.dart';
 import 'interface.dart';
 import 'message.dart';
@@ -100,7 +100,7 @@ abstract class AsyncBinding<T> extends _Stateful {
   /// FIDL compiler for a specific interface.
   AsyncBinding(this.$interfaceName) {
     _reader
-      ..onReadable = _handleReadable
+      ..onMessage = _handleMessage
       ..onError = _handleError;
   }
 
@@ -215,8 +215,7 @@ abstract class AsyncBinding<T> extends _Stateful {
   @protected
   void handleMessage(Message message, MessageSink respond);
 
-  void _handleReadable() {
-    final ReadResult result = _reader.channel.queryAndRead();
+  void _handleMessage(ReadResult result) {
     if ((result.bytes == null) || (result.bytes.lengthInBytes == 0))
       throw new FidlError(
           'AsyncBinding<${$interfaceName}> Unexpected empty message or error: $result');
@@ -276,12 +275,84 @@ class AsyncProxy<T> {
   // to avoid name conflicts.
 }
 
+// Userspace transaction identifiers have the high bit clear. The remaining
+// bits hold a slot index in the low |_kTxidSlotBits| and the slot's generation
+// above them. Generations are never zero, so neither is a txid.
+const int _kTxidSlotBits = 20;
+const int _kTxidSlotMask = (1 << _kTxidSlotBits) - 1;
+const int _kTxidGenerationMask = 0x7FFFFFFF >> _kTxidSlotBits;
+
+/// The completers of the calls that are waiting for a response, indexed by
+/// the low bits of their transaction identifiers.
+///
+/// The high bits hold the slot's generation, which changes every time the
+/// slot is freed, so a stale or duplicate response never matches a later
+/// call that reuses the slot.
+class _PendingCompleters {
+  final List<Completer<dynamic>> _completers = <Completer<dynamic>>[];
+  final List<int> _generations = <int>[];
+  // Indices of the unused slots, most recently freed last.
+  final List<int> _freeSlots = <int>[];
+  int _count = 0;
+
+  /// Stores [completer] in a free slot and returns the transaction identifier
+  /// that refers to it, or zero if every slot is in use.
+  int add(Completer<dynamic> completer) {
+    int slot;
+    if (_freeSlots.isNotEmpty) {
+      slot = _freeSlots.removeLast();
+    } else if (_completers.length <= _kTxidSlotMask) {
+      slot = _completers.length;
+      _completers.add(null);
+      _generations.add(1);
+    } else {
+      return 0;
+    }
+    _completers[slot] = completer;
+    _count++;
+    return (_generations[slot] << _kTxidSlotBits) | slot;
+  }
+
+  /// Removes and returns the completer for [txid], or null if there is none.
+  Completer<dynamic> take(int txid) {
+    final int slot = txid & _kTxidSlotMask;
+    if (slot >= _completers.length ||
+        _generations[slot] != txid >> _kTxidSlotBits) {
+      return null;
+    }
+    final Completer<dynamic> completer = _completers[slot];
+    if (completer == null) {
+      return null;
+    }
+    _completers[slot] = null;
+    _generations[slot] = _generations[slot] == _kTxidGenerationMask
+        ? 1
+        : _generations[slot] + 1;
+    _freeSlots.add(slot);
+    _count--;
+    return completer;
+  }
+
+  /// Removes every pending completer, and calls [callback] with each.
+  void drain(void Function(Completer<dynamic> completer) callback) {
+    if (_count == 0) {
+      return;
+    }
+    for (int slot = 0; slot < _completers.length; slot++) {
+      final Completer<dynamic> completer = _completers[slot];
+      if (completer != null) {
+        take((_generations[slot] << _kTxidSlotBits) | slot);
+        callback(completer);
+      }
+    }
+  }
+}
+
 /// A controller for Future based proxies.
 class AsyncProxyController<T> extends _Stateful {
   final ChannelReader _reader = new ChannelReader();
 
-  final HashMap<int, Completer<dynamic>> _completerMap = new HashMap();
-  int _nextTxid = 1;
+  final _PendingCompleters _pending = new _PendingCompleters();
 
   /// Creates proxy controller.
   ///
@@ -290,16 +361,15 @@ class AsyncProxyController<T> extends _Stateful {
   /// property of a `TProxy` object.
   AsyncProxyController({this.$serviceName, this.$interfaceName}) {
     _reader
-      ..onReadable = _handleReadable
+      ..onMessage = _handleMessage
       ..onError = _handleError;
     whenClosed.then((_) {
-      for (final Completer completer in _completerMap.values) {
+      _pending.drain((Completer<dynamic> completer) {
         if (!completer.isCompleted) {
           completer.completeError(new FidlError(
               'AsyncProxyController<${$interfaceName}> connection closed'));
         }
-      }
-      _completerMap.clear();
+      });
     }, onError: (_) {
       // Ignore errors.
     });
@@ -399,7 +469,7 @@ class AsyncProxyController<T> extends _Stateful {
     if (isBound) {
       _reader.close();
       state = InterfaceState.closed;
-      _completerMap.forEach((_, Completer<dynamic> completer) =>
+      _pending.drain((Completer<dynamic> completer) =>
           completer.completeError(new FidlStateException(
               'AsyncProxyController<${$interfaceName}> is closed.')));
     }
@@ -416,8 +486,7 @@ class AsyncProxyController<T> extends _Stateful {
   /// Used by subclasses of [Proxy<T>] to receive responses to messages.
   MessageSink onResponse;
 
-  void _handleReadable() {
-    final ReadResult result = _reader.channel.queryAndRead();
+  void _handleMessage(ReadResult result) {
     if ((result.bytes == null) || (result.bytes.lengthInBytes == 0)) {
       proxyError(new FidlError(
           'AsyncProxyController<${$interfaceName}>: Read from channel failed'));
@@ -442,6 +511,12 @@ class AsyncProxyController<T> extends _Stateful {
     proxyError(new FidlError(error.toString()));
   }
 
+  /// The buffers that the encoders of this proxy's messages reuse.
+  ///
+  /// Generated code passes it to [Encoder], and the buffer of each message
+  /// returns to it once the message is written to the channel.
+  final EncoderBufferPool encoderPool = new EncoderBufferPool();
+
   /// Sends the given messages over the bound channel.
   ///
   /// Used by subclasses of [Proxy<T>] to send encoded messages.
@@ -452,6 +527,7 @@ class AsyncProxyController<T> extends _Stateful {
       return;
     }
     final int status = _reader.channel.write(message.data, message.handles);
+    encoderPool.release(message.data);
     if (status != ZX.OK) {
       proxyError(new FidlError(
           'AsyncProxyController<${$interfaceName}> failed to write to channel: ${_reader.channel} (status: $status)'));
@@ -461,6 +537,11 @@ class AsyncProxyController<T> extends _Stateful {
   /// Sends the given messages over the bound channel and registers a Completer
   /// to handle the response.
   ///
+  /// The completer is completed at the end of handling the response message,
+  /// so it may be a [Completer.sync], such as one from [createCompleter],
+  /// which runs the listeners of its future right away instead of a
+  /// microtask later.
+  ///
   /// Used by subclasses of [AsyncProxy<T>] to send encoded messages.
   void sendMessageWithResponse(Message message, Completer<dynamic> completer) {
     if (!_reader.isBound) {
@@ -469,14 +550,17 @@ class AsyncProxyController<T> extends _Stateful {
       return;
     }
 
-    const int _userspaceTxidMask = 0x7FFFFFFF;
-
-    int txid = _nextTxid++ & _userspaceTxidMask;
-    while (txid == 0 || _completerMap.containsKey(txid))
-      txid = _nextTxid++ & _userspaceTxidMask;
+    final int txid = _pending.add(completer);
+    if (txid == 0) {
+      message.closeHandles();
+      completer.completeError(new FidlError(
+          'AsyncProxyController<${$interfaceName}> has too many calls in '
+          'flight'));
+      return;
+    }
     message.txid = txid;
-    _completerMap[message.txid] = completer;
     final int status = _reader.channel.write(message.data, message.handles);
+    encoderPool.release(message.data);
 
     if (status != ZX.OK) {
       proxyError(new FidlError(
@@ -485,12 +569,16 @@ class AsyncProxyController<T> extends _Stateful {
     }
   }
 
+  /// Creates a completer for the response to a call, which completes its
+  /// future synchronously, see [sendMessageWithResponse].
+  Completer<R> createCompleter<R>() => new Completer<R>.sync();
+
   /// Returns the completer associated with the given response message.
   ///
   /// Used by subclasses of [AsyncProxy<T>] to retrieve registered completers when
   /// handling response messages.
   Completer getCompleter(int txid) {
-    final Completer result = _completerMap.remove(txid);
+    final Completer result = _pending.take(txid);
     if (result == null) {
       proxyError(new FidlError('Message had unknown request id: $txid'));
     }
@@ -0,0 +1,87 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+import 'dart:convert';
+import 'dart:typed_data';
+
+import 'error.dart';
+
+// ignore_for_file: public_member_api_docs
+
+/// A FIDL string whose UTF-8 bytes are only decoded when it is first read.
+///
+/// A [LazyString] decoded from a message views the bytes of the message, so
+/// strings that a handler never reads cost no decoding or allocation beyond
+/// the view.  Invalid UTF-8 is reported by [value], rather than when the
+/// message is decoded.
+class LazyString {
+  /// Wraps the encoded [bytes] of a string, which must not change while it is
+  /// in use.
+  LazyString.fromUtf8(this._bytes);
+
+  /// Wraps a string that is already decoded.
+  LazyString(String value) : _value = value;
+
+  Uint8List _bytes;
+  String _value;
+
+  /// The string, decoded on first access.
+  String get value => _value ??= _decode(_bytes);
+
+  /// The UTF-8 encoding of the string.
+  Uint8List get bytes =>
+      _bytes ??= new Uint8List.fromList(const Utf8Encoder().convert(_value));
+
+  /// Whether the string has been decoded.
+  bool get isDecoded => _value != null;
+
+  static String _decode(Uint8List bytes) {
+    // Most strings in messages are ASCII, which needs no validation beyond
+    // the range of each byte.
+    final int length = bytes.length;
+    int i = 0;
+    while (i < length && bytes[i] < 0x80) {
+      i++;
+    }
+    if (i == length) {
+      return new String.fromCharCodes(bytes);
+    }
+    try {
+      return const Utf8Decoder().convert(bytes);
+    } on FormatException {
+      throw new FidlError('Received a string with invalid UTF8: $bytes');
+    }
+  }
+
+  @override
+  int get hashCode => value.hashCode;
+
+  @override
+  bool operator ==(dynamic other) {
+    if (identical(this, other)) {
+      return true;
+    }
+    if (other is! LazyString) {
+      return false;
+    }
+    final LazyString otherString = other;
+    if (!isDecoded && !otherString.isDecoded) {
+      final Uint8List a = _bytes;
+      final Uint8List b = otherString._bytes;
+      if (a.length != b.length) {
+        return false;
+      }
+      for (int i = 0; i < a.length; i++) {
+        if (a[i] != b[i]) {
+          return false;
+        }
+      }
+      return true;
+    }
+    return value == otherString.value;
+  }
+
+  @override
+  String toString() => value;
+}
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+import 'dart:collection';
 import 'dart:convert';
 import 'dart:typed_data';
 
@@ -11,6 +12,7 @@ import 'codec.dart';
 import 'enum.dart';
 import 'error.dart';
 import 'interface.dart';
+import 'lazy_string.dart';
 import 'struct.dart';
 import 'table.dart';
 import 'union.dart';
@@ -44,82 +46,58 @@ void _throwIfNotZero(int value) {
   }
 }
 
+// The copies below rely on the host being little-endian, like the typed-data
+// views that |decodeArray| returns, and on |offset| being aligned for the
+// element type, which the wire format guarantees.
+
 void _copyInt8(ByteData data, Int8List value, int offset) {
   final int count = value.length;
-  for (int i = 0; i < count; ++i) {
-    data.setInt8(offset + i, value[i]);
-  }
+  data.buffer.asInt8List(offset, count).setRange(0, count, value);
 }
 
 void _copyUint8(ByteData data, Uint8List value, int offset) {
   final int count = value.length;
-  for (int i = 0; i < count; ++i) {
-    data.setUint8(offset + i, value[i]);
-  }
+  data.buffer.asUint8List(offset, count).setRange(0, count, value);
 }
 
 void _copyInt16(ByteData data, Int16List value, int offset) {
   final int count = value.length;
-  const int stride = 2;
-  for (int i = 0; i < count; ++i) {
-    data.setInt16(offset + i * stride, value[i], Endian.little);
-  }
+  data.buffer.asInt16List(offset, count).setRange(0, count, value);
 }
 
 void _copyUint16(ByteData data, Uint16List value, int offset) {
   final int count = value.length;
-  const int stride = 2;
-  for (int i = 0; i < count; ++i) {
-    data.setUint16(offset + i * stride, value[i], Endian.little);
-  }
+  data.buffer.asUint16List(offset, count).setRange(0, count, value);
 }
 
 void _copyInt32(ByteData data, Int32List value, int offset) {
   final int count = value.length;
-  const int stride = 4;
-  for (int i = 0; i < count; ++i) {
-    data.setInt32(offset + i * stride, value[i], Endian.little);
-  }
+  data.buffer.asInt32List(offset, count).setRange(0, count, value);
 }
 
 void _copyUint32(ByteData data, Uint32List value, int offset) {
   final int count = value.length;
-  const int stride = 4;
-  for (int i = 0; i < count; ++i) {
-    data.setUint32(offset + i * stride, value[i], Endian.little);
-  }
+  data.buffer.asUint32List(offset, count).setRange(0, count, value);
 }
 
 void _copyInt64(ByteData data, Int64List value, int offset) {
   final int count = value.length;
-  const int stride = 8;
-  for (int i = 0; i < count; ++i) {
-    data.setInt64(offset + i * stride, value[i], Endian.little);
-  }
+  data.buffer.asInt64List(offset, count).setRange(0, count, value);
 }
 
 void _copyUint64(ByteData data, Uint64List value, int offset) {
   final int count = value.length;
-  const int stride = 8;
-  for (int i = 0; i < count; ++i) {
-    data.setUint64(offset + i * stride, value[i], Endian.little);
-  }
+  data.buffer.asUint64List(offset, count).setRange(0, count, value);
 }
 
 void _copyFloat32(ByteData data, Float32List value, int offset) {
   final int count = value.length;
-  const int stride = 4;
-  for (int i = 0; i < count; ++i) {
-    data.setFloat32(offset + i * stride, value[i], Endian.little);
-  }
+  data.buffer.asFloat32List(offset, count).setRange(0, count, value);
 }
 
 void _copyFloat64(ByteData data, Float64List value, int offset) {
   final int count = value.length;
-  const int stride = 8;
-  for (int i = 0; i < count; ++i) {
-    data.setFloat64(offset + i * stride, value[i], Endian.little);
-  }
+  data.buffer.asFloat64List(offset, count).setRange(0, count, value);
 }
 
 String _convertFromUTF8(Uint8List bytes) {
@@ -605,6 +583,55 @@ class StringType extends FidlType<String> {
   }
 }
 
+/// Like [StringType], but decodes to a [LazyString] that views the message
+/// instead of decoding the UTF-8 up front.
+class LazyStringType extends FidlType<LazyString> {
+  const LazyStringType({
+    this.maybeElementCount,
+    this.nullable,
+  }) : super(encodedSize: 16);
+
+  final int maybeElementCount;
+  final bool nullable;
+
+  // See fidl_string_t.
+
+  @override
+  void encode(Encoder encoder, LazyString value, int offset) {
+    if (value == null) {
+      _throwIfNotNullable(nullable);
+      encoder
+        ..encodeUint64(0, offset) // size
+        ..encodeUint64(kAllocAbsent, offset + 8); // data
+      return;
+    }
+    final Uint8List bytes = value.bytes;
+    final int size = bytes.lengthInBytes;
+    _throwIfExceedsLimit(size, maybeElementCount);
+    encoder
+      ..encodeUint64(size, offset) // size
+      ..encodeUint64(kAllocPresent, offset + 8); // data
+    int childOffset = encoder.alloc(size);
+    _copyUint8(encoder.data, bytes, childOffset);
+  }
+
+  @override
+  LazyString decode(Decoder decoder, int offset) {
+    final int size = decoder.decodeUint64(offset);
+    final int data = decoder.decodeUint64(offset + 8);
+    if (data == kAllocAbsent) {
+      _throwIfNotNullable(nullable);
+      _throwIfNotZero(size);
+      return null;
+    } else if (data != kAllocPresent) {
+      throw new FidlError('Invalid string encoding: $data.');
+    }
+    _throwIfExceedsLimit(size, maybeElementCount);
+    return new LazyString.fromUtf8(
+        decoder.data.buffer.asUint8List(decoder.claimMemory(size), size));
+  }
+}
+
 class PointerType<T> extends FidlType<T> {
   const PointerType({
     this.element,
@@ -692,6 +719,75 @@ class StructType<T extends Struct> extends FidlType<T> {
   }
 }
 
+/// The type of a struct whose encoding is the same as its in-memory layout:
+/// its members are all primitives, enums, or other such structs, with no
+/// handles and nothing out-of-line.
+///
+/// Arrays and vectors of these structs decode to a [PlainStructList], which
+/// views the bytes of the message and only decodes an element when it is
+/// accessed, and encode from one by copying its bytes.
+class PlainStructType<T extends Struct> extends StructType<T> {
+  const PlainStructType({
+    int encodedSize,
+    List<MemberType> members,
+    StructFactory<T> ctor,
+  }) : super(encodedSize: encodedSize, members: members, ctor: ctor);
+
+  @override
+  void encodeArray(Encoder encoder, List<T> value, int offset) {
+    if (value is PlainStructList<T> && identical(value._type, this)) {
+      final int size = value.length * encodedSize;
+      encoder.data.buffer
+          .asUint8List(offset, size)
+          .setRange(0, size, value.bytes);
+      return;
+    }
+    super.encodeArray(encoder, value, offset);
+  }
+
+  @override
+  List<T> decodeArray(Decoder decoder, int count, int offset) {
+    return new PlainStructList<T>._(this, decoder, offset, count);
+  }
+}
+
+/// An unmodifiable list of plain structs that views their encoding in a
+/// message.
+///
+/// Each access to an element decodes it anew, so callers that read an
+/// element repeatedly should keep the result.
+class PlainStructList<T extends Struct> extends ListBase<T> {
+  PlainStructList._(this._type, this._decoder, this._offset, this._length);
+
+  final PlainStructType<T> _type;
+  final Decoder _decoder;
+  final int _offset;
+  final int _length;
+
+  @override
+  int get length => _length;
+
+  @override
+  set length(int newLength) {
+    throw new UnsupportedError('Cannot change the length of a struct view');
+  }
+
+  /// The encoded elements.
+  Uint8List get bytes => _decoder.data.buffer
+      .asUint8List(_offset, length * _type.encodedSize);
+
+  @override
+  T operator [](int index) {
+    RangeError.checkValidIndex(index, this);
+    return _type.decode(_decoder, _offset + index * _type.encodedSize);
+  }
+
+  @override
+  void operator []=(int index, T value) {
+    throw new UnsupportedError('Cannot modify a struct view');
+  }
+}
+
 const int _kEnvelopeSize = 16;
 
 class TableType<T extends Table> extends FidlType<T> {
@@ -31,3 +31,60 @@ void connectToEnvironmentService<T>(AsyncProxy<T> serviceProxy) {
     throw e;
   });
 }
+
+/// Connects to the environment services specified by [serviceProxies] at
+/// once.
+///
+/// Declare every service a component needs at startup here rather than
+/// connecting to each as it is first used. As with
+/// [connectToEnvironmentService], each connection request is a one-way
+/// message, and calls can be made on the proxies as soon as this returns.
+///
+/// Throws before binding any proxy if one of the proxies is null, is already
+/// bound, appears more than once, or is not of a [Discoverable] interface.
+void connectToEnvironmentServices(
+    Iterable<AsyncProxy<dynamic>> serviceProxies) {
+  if (serviceProxies == null) {
+    throw Exception('serviceProxies must not be null in call to '
+        'connectToEnvironmentServices');
+  }
+  final proxies = serviceProxies.toList();
+  final seen = Set<AsyncProxy<dynamic>>.identity();
+  for (final serviceProxy in proxies) {
+    if (serviceProxy == null) {
+      throw Exception('serviceProxies must not contain null in call to '
+          'connectToEnvironmentServices');
+    }
+    // Checked here so that request() cannot throw once some of the proxies
+    // have been bound.
+    if (!serviceProxy.ctrl.isUnbound) {
+      throw Exception("${serviceProxy.ctrl.$interfaceName}'s proxy must be "
+          'unbound in call to connectToEnvironmentServices');
+    }
+    if (!seen.add(serviceProxy)) {
+      throw Exception("${serviceProxy.ctrl.$interfaceName}'s proxy appears "
+          'more than once in call to connectToEnvironmentServices');
+    }
+    if (serviceProxy.ctrl.$serviceName == null) {
+      throw Exception("${serviceProxy.ctrl.$interfaceName}'s "
+          'proxyServiceController.\$serviceName must not be null. Check the '
+          'FIDL file for a missing [Discoverable]');
+    }
+  }
+
+  final requests = proxies.map((proxy) => proxy.ctrl.request()).toList();
+  final environmentServices =
+      StartupContext.fromStartupInfo().environmentServices;
+  for (var i = 0; i < proxies.length; i++) {
+    final serviceProxyRequest = requests[i];
+    connectToService(
+      environmentServices,
+      proxies[i].ctrl.$serviceName,
+      proxies[i].ctrl.$interfaceName,
+      serviceProxyRequest,
+    ).catchError((e) {
+      serviceProxyRequest.close();
+      throw e;
+    });
+  }
+}
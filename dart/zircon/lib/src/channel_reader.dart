@@ -18,6 +18,7 @@ class ChannelReaderError {
 
 typedef ChannelReaderReadableHandler = void Function();
 typedef ChannelReaderErrorHandler = void Function(ChannelReaderError error);
+typedef ChannelReaderMessageHandler = void Function(ReadResult result);
 
 class ChannelReader {
   Channel get channel => _channel;
@@ -30,6 +31,17 @@ class ChannelReader {
   ChannelReaderReadableHandler onReadable;
   ChannelReaderErrorHandler onError;
 
+  /// Called with each message the reader reads, instead of [onReadable].
+  ///
+  /// When set, the reader drains the channel: each time it becomes readable,
+  /// the reader reads up to [maxMessagesPerWakeup] messages before waiting
+  /// again, rather than one.
+  ChannelReaderMessageHandler onMessage;
+
+  /// The most messages read for [onMessage] before yielding to the event
+  /// loop, so that a busy channel cannot starve other handlers.
+  int maxMessagesPerWakeup = 64;
+
   void bind(Channel channel) {
     if (isBound) {
       throw new ZirconApiError('ChannelReader is already bound.');
@@ -78,6 +90,28 @@ class ChannelReader {
   @override
   String toString() => 'ChannelReader($_channel)';
 
+  void _drain() {
+    for (int i = 0; i < maxMessagesPerWakeup; i++) {
+      if (!isBound || onMessage == null) {
+        return;
+      }
+      final ReadResult result = _channel.queryAndRead();
+      if (result.status == ZX.ERR_SHOULD_WAIT) {
+        return;
+      }
+      if (result.status != ZX.OK) {
+        final String reason = result.status == ZX.ERR_PEER_CLOSED
+            ? 'Peer unexpectedly closed'
+            : 'Read failed with status '
+                '${getStringForStatus(result.status)} (${result.status})';
+        close();
+        _errorSoon(new ChannelReaderError(reason, null));
+        return;
+      }
+      onMessage(result);
+    }
+  }
+
   void _handleWaitComplete(int status, int pending) {
     assert(isBound);
     if (status != ZX.OK) {
@@ -91,7 +125,9 @@ class ChannelReader {
     // RawReceivePort any more.
     try {
       if ((pending & Channel.READABLE) != 0) {
-        if (onReadable != null) {
+        if (onMessage != null) {
+          _drain();
+        } else if (onReadable != null) {
           onReadable();
         }
         if (isBound) {
@@ -89,3 +89,134 @@ class SizedVmo extends Vmo {
   /// Size of the Vmo in bytes.
   int get size => _size;
 }
+
+/// A read-only view of the first [size] bytes of a VMO, such as the contents
+/// of a `fuchsia.mem.Buffer`, mapped into the process instead of copied onto
+/// the Dart heap.
+///
+/// The mapping lasts as long as any view of it is reachable.  [unmap] drops
+/// this object's view and closes the VMO, so callers that do not keep views
+/// of [bytes] let the pages go at the next collection rather than when the
+/// [MappedVmo] itself is collected.
+class MappedVmo {
+  /// Maps [vmo], whose contents are [size] bytes long, and takes ownership of
+  /// it.
+  ///
+  /// Throws a [ZxStatusException] if the VMO cannot be mapped or is smaller
+  /// than [size].
+  factory MappedVmo(Vmo vmo, int size) {
+    Uint8List mapping;
+    try {
+      mapping = vmo.map();
+    } on ZxStatusException {
+      vmo.close();
+      rethrow;
+    }
+    if (size < 0 || size > mapping.lengthInBytes) {
+      vmo.close();
+      const int status = ZX.ERR_OUT_OF_RANGE;
+      throw new ZxStatusException(status, getStringForStatus(status));
+    }
+    return new MappedVmo._(vmo, new UnmodifiableUint8ListView(
+        mapping.buffer.asUint8List(mapping.offsetInBytes, size)));
+  }
+
+  MappedVmo._(this._vmo, this._bytes);
+
+  Vmo _vmo;
+  Uint8List _bytes;
+
+  /// The contents of the VMO, which are read-only.
+  ///
+  /// Throws a [StateError] after [unmap].
+  Uint8List get bytes {
+    if (_bytes == null) {
+      throw new StateError('MappedVmo is unmapped');
+    }
+    return _bytes;
+  }
+
+  /// Whether [unmap] has not been called.
+  bool get isMapped => _bytes != null;
+
+  /// Releases the view and closes the VMO.
+  void unmap() {
+    _bytes = null;
+    _vmo?.close();
+    _vmo = null;
+  }
+}
+
+/// Fills a new VMO with chunks of data as they are produced, such as the
+/// parts of a large HTTP body or an image, so that they reach the VMO without
+/// first being concatenated on the Dart heap.
+///
+/// Each chunk is written straight from its typed-data view, and the VMO grows
+/// as needed.
+class VmoWriter {
+  /// Creates a VMO with room for [capacity] bytes, the expected total size.
+  factory VmoWriter([int capacity = 4096]) {
+    final int initialSize = capacity > 0 ? capacity : 4096;
+    final HandleResult r = System.vmoCreate(initialSize);
+    if (r.status != ZX.OK) {
+      throw new ZxStatusException(r.status, getStringForStatus(r.status));
+    }
+    return new VmoWriter._(new Vmo(r.handle), initialSize);
+  }
+
+  VmoWriter._(this._vmo, this._capacity);
+
+  Vmo _vmo;
+  int _capacity;
+  int _size = 0;
+
+  /// The number of bytes written so far.
+  int get size => _size;
+
+  /// Appends [data] to the VMO.
+  ///
+  /// Throws a [ZxStatusException] if the VMO cannot grow or be written.
+  void add(ByteData data) {
+    if (_vmo == null) {
+      throw new StateError('VmoWriter is finished');
+    }
+    final int end = _size + data.lengthInBytes;
+    if (end > _capacity) {
+      int newCapacity = _capacity * 2;
+      if (newCapacity < end) {
+        newCapacity = end;
+      }
+      _check(_vmo.setSize(newCapacity));
+      _capacity = newCapacity;
+    }
+    _check(_vmo.write(data, _size));
+    _size = end;
+  }
+
+  /// Appends [bytes] to the VMO, see [add].
+  void addBytes(Uint8List bytes) {
+    add(bytes.buffer.asByteData(bytes.offsetInBytes, bytes.lengthInBytes));
+  }
+
+  /// Returns the VMO with the data written so far, for a
+  /// `fuchsia.mem.Buffer` of [SizedVmo.size] bytes, and ends writing.
+  SizedVmo finish() {
+    if (_vmo == null) {
+      throw new StateError('VmoWriter is finished');
+    }
+    // Give back what doubling reserved beyond the data; the VMO stays valid
+    // at its larger size if it cannot shrink.
+    if (_capacity > _size) {
+      _vmo.setSize(_size);
+    }
+    final SizedVmo result = new SizedVmo(_vmo.handle, _size);
+    _vmo = null;
+    return result;
+  }
+
+  static void _check(int status) {
+    if (status != ZX.OK) {
+      throw new ZxStatusException(status, getStringForStatus(status));
+    }
+  }
+}
@@ -20,6 +20,7 @@ typedef struct async_guest_bell_trap async_guest_bell_trap_t;
 typedef struct async_wait async_wait_t;
 typedef struct async_task async_task_t;
 typedef struct async_receiver async_receiver_t;
+typedef struct async_packet async_packet_t;
 typedef struct async_exception async_exception_t;
 
 // Private state owned by the asynchronous dispatcher.
@@ -46,9 +47,10 @@ typedef struct {
 // This interface consists of several groups of methods:
 //
 // - Timing: |now|
-// - Waiting for signals: |begin_wait|, |cancel_wait|
+// - Waiting for signals: |begin_wait|, |cancel_wait|, |begin_repeating_wait|,
+//   |cancel_waits|
 // - Posting tasks: |post_task|, |cancel_task|
-// - Queuing packets: |queue_packet|
+// - Queuing packets: |queue_packet|, |queue_packets|
 // - Virtual machine operations: |set_guest_bell_trap|
 // - Exception handling: |bind_exception_port|, |unbind_exception_port|
 //
@@ -72,9 +74,12 @@ typedef uint32_t async_ops_version_t;
 
 #define ASYNC_OPS_V1 ((async_ops_version_t) 1)
 #define ASYNC_OPS_V2 ((async_ops_version_t) 2)
+#define ASYNC_OPS_V3 ((async_ops_version_t) 3)
+#define ASYNC_OPS_V4 ((async_ops_version_t) 4)
+#define ASYNC_OPS_V5 ((async_ops_version_t) 5)
 
 typedef struct async_ops {
-    // The interface version number, e.g. |ASYNC_OPS_V2|.
+    // The interface version number, e.g. |ASYNC_OPS_V5|.
     async_ops_version_t version;
 
     // Reserved for future expansion, set to zero.
@@ -114,6 +119,28 @@ typedef struct async_ops {
                                              zx_handle_t task,
                                              uint32_t options);
     } v2;
+
+    // Operations supported by |ASYNC_OPS_V3|, in addition to those in V2.
+    struct v3 {
+        // See |async_begin_repeating_wait()| for details.
+        zx_status_t (*begin_repeating_wait)(async_dispatcher_t* dispatcher, async_wait_t* wait);
+    } v3;
+
+    // Operations supported by |ASYNC_OPS_V4|, in addition to those in V3.
+    struct v4 {
+        // See |async_queue_packets()| for details.
+        zx_status_t (*queue_packets)(async_dispatcher_t* dispatcher,
+                                     const async_packet_t* packets, size_t count,
+                                     size_t* out_queued);
+    } v4;
+
+    // Operations supported by |ASYNC_OPS_V5|, in addition to those in V4.
+    struct v5 {
+        // See |async_cancel_waits()| for details.
+        zx_status_t (*cancel_waits)(async_dispatcher_t* dispatcher,
+                                    async_wait_t* const* waits, size_t count,
+                                    size_t* out_canceled);
+    } v5;
 } async_ops_t;
 
 struct async_dispatcher {
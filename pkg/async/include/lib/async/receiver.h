@@ -47,6 +47,36 @@ struct async_receiver {
 zx_status_t async_queue_packet(async_dispatcher_t* dispatcher, async_receiver_t* receiver,
                                const zx_packet_user_t* data);
 
+// A packet to enqueue with |async_queue_packets()|.
+struct async_packet {
+    // The receiver to deliver the packet to.
+    async_receiver_t* receiver;
+
+    // The data to copy into the packet, or NULL for a zero-initialized payload.
+    const zx_packet_user_t* data;
+};
+
+// Enqueues |count| packets, each for delivery to its own receiver, as if by
+// calling |async_queue_packet()| for each of them in order.
+//
+// Producers that signal many receivers at once, for example once per frame,
+// should prefer this to a loop of |async_queue_packet()| calls: dispatchers can
+// check their state once for the whole array.  Dispatchers that predate this
+// operation get one |async_queue_packet()| call per packet.
+//
+// If |out_queued| is not NULL, it is set to the number of packets that were
+// enqueued, which are always the first ones in the array.
+//
+// Returns |ZX_OK| if all packets were successfully enqueued.
+// Returns |ZX_ERR_BAD_STATE| if the dispatcher is shutting down.
+// Returns |ZX_ERR_NOT_SUPPORTED| if not supported by the dispatcher.
+// Returns the status of the first packet that could not be enqueued
+// otherwise, in which case none of the packets after it are enqueued.
+//
+// This operation is thread-safe.
+zx_status_t async_queue_packets(async_dispatcher_t* dispatcher, const async_packet_t* packets,
+                                size_t count, size_t* out_queued);
+
 __END_CDECLS
 
 #endif  // LIB_ASYNC_RECEIVER_H_
\ No newline at end of file
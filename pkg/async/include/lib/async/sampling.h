@@ -0,0 +1,101 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_ASYNC_SAMPLING_H_
+#define LIB_ASYNC_SAMPLING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// Kinds of handlers that dispatchers and executors publish.
+typedef uint32_t async_handler_kind_t;
+#define ASYNC_HANDLER_KIND_WAIT ((async_handler_kind_t) 1)
+#define ASYNC_HANDLER_KIND_TASK ((async_handler_kind_t) 2)
+#define ASYNC_HANDLER_KIND_RECEIVER ((async_handler_kind_t) 3)
+#define ASYNC_HANDLER_KIND_GUEST_BELL_TRAP ((async_handler_kind_t) 4)
+#define ASYNC_HANDLER_KIND_EXCEPTION ((async_handler_kind_t) 5)
+// A |fit::pending_task| run by an executor.
+#define ASYNC_HANDLER_KIND_PENDING_TASK ((async_handler_kind_t) 6)
+
+// Describes a handler that a thread is running, so that a sampling profiler
+// can attribute the thread's samples to it.
+//
+// Dispatchers and executors push a frame on the thread's stack before they
+// invoke a handler and pop it afterwards.  The frames of handlers that run
+// nested dispatchers or executors form a chain, innermost first, through
+// |parent|.
+typedef struct async_handler_frame {
+    // The frame of the handler that was running when this one started, or
+    // NULL if none.
+    const struct async_handler_frame* parent;
+
+    // What kind of handler this is.
+    async_handler_kind_t kind;
+
+    // The address of the handler's code, to symbolize.  For a handler held
+    // in a |fit::function|, such as a continuation of a |fit::pending_task|,
+    // this is the function's |target_code_address()|.
+    const void* code;
+
+    // The object being handled, such as the |async_wait_t|, or the
+    // |fit::pending_task|, which the object may have destroyed by the time
+    // the profiler reads it.
+    const void* object;
+} async_handler_frame_t;
+
+// The innermost frame of the calling thread, or NULL if it is not running a
+// handler.  Use the functions below rather than accessing it directly.
+//
+// The initial-exec TLS model puts the slot at the same offset from the
+// thread pointer in every thread, see |async_get_handler_slot_offset()|.
+extern __thread const async_handler_frame_t* async_handler_slot_
+    __attribute__((tls_model("initial-exec")));
+
+// Gets the offset of the handler slot of each thread from its thread
+// pointer (the value of %fs:0 on x86-64, TPIDR_EL0 on ARM64).
+//
+// A sampling profiler reads the slot of a thread by suspending it, reading
+// its thread pointer from its registers, and reading the pointer at this
+// offset from it, then the chain of frames it points to.  This works from
+// the process itself or, with a handle to the process, from another one.
+ptrdiff_t async_get_handler_slot_offset(void);
+
+// Gets the frame of the handler the calling thread is running, or NULL if
+// none.
+static inline const async_handler_frame_t* async_get_current_handler(void) {
+    return async_handler_slot_;
+}
+
+// Publishes |frame| as the calling thread's current handler.  Must be
+// balanced by |async_pop_handler_frame()| on the same thread; |frame|
+// usually lives on the stack of the caller, which pops it before returning.
+//
+// This costs a few stores and no synchronization, since the slot is only
+// read while its thread is suspended.
+static inline void async_push_handler_frame(async_handler_frame_t* frame,
+                                            async_handler_kind_t kind,
+                                            const void* code,
+                                            const void* object) {
+    frame->parent = async_handler_slot_;
+    frame->kind = kind;
+    frame->code = code;
+    frame->object = object;
+    // The frame must be complete wherever the thread is suspended.
+    __atomic_signal_fence(__ATOMIC_RELEASE);
+    async_handler_slot_ = frame;
+}
+
+// Restores the calling thread's current handler to the parent of |frame|,
+// which must be the current one.
+static inline void async_pop_handler_frame(const async_handler_frame_t* frame) {
+    async_handler_slot_ = frame->parent;
+}
+
+__END_CDECLS
+
+#endif // LIB_ASYNC_SAMPLING_H_
@@ -35,6 +35,15 @@ struct async_task {
     // dispatcher (usually |ZX_CLOCK_MONOTONIC| except in unit tests).
     // See |async_now()| for details.
     zx_time_t deadline;
+
+    // How long after its deadline the task may run, or zero to run it as soon
+    // as possible.
+    //
+    // Low-priority work that can run a little late, such as periodic flushes
+    // or retries, should set a slack so that the dispatcher can serve several
+    // nearby deadlines with a single wake-up.  The task never runs before its
+    // deadline.  Dispatchers may ignore the slack.
+    zx_duration_t slack;
 };
 
 // Posts a task to run on or after its deadline following all posted
@@ -54,6 +54,33 @@ struct async_wait {
 // This operation is thread-safe.
 zx_status_t async_begin_wait(async_dispatcher_t* dispatcher, async_wait_t* wait);
 
+// Begins asynchronously waiting for an object to receive one or more signals
+// specified in |wait|, and keeps waiting after each time they are received.
+//
+// Unlike |async_begin_wait()|, the wait remains pending after its handler runs:
+// the handler is invoked again each time the object's signals change to satisfy
+// |wait->trigger|, until the wait is canceled with |async_cancel_wait()| or
+// the dispatcher shuts down. A wait that is already satisfied when it begins is
+// reported right away. This avoids reissuing the wait after every
+// notification, which is a system call on most dispatchers.
+//
+// The handler is not invoked again while the signals stay asserted, so it must
+// consume whatever caused them, such as by reading a channel until it is empty,
+// before returning.
+//
+// Canceling a repeating wait from a thread other than the one running its
+// handler can race with a notification that has already been dequeued, so
+// clients of multi-threaded dispatchers should only cancel repeating waits
+// from within their handler.
+//
+// Returns |ZX_OK| if the wait was successfully begun.
+// Returns |ZX_ERR_ACCESS_DENIED| if the object does not have |ZX_RIGHT_WAIT|.
+// Returns |ZX_ERR_BAD_STATE| if the dispatcher is shutting down.
+// Returns |ZX_ERR_NOT_SUPPORTED| if not supported by the dispatcher.
+//
+// This operation is thread-safe.
+zx_status_t async_begin_repeating_wait(async_dispatcher_t* dispatcher, async_wait_t* wait);
+
 // Cancels the wait associated with |wait|.
 //
 // If successful, the wait's handler will not run.
@@ -69,6 +96,28 @@ zx_status_t async_begin_wait(async_dispatcher_t* dispatcher, async_wait_t* wait)
 // This operation is thread-safe.
 zx_status_t async_cancel_wait(async_dispatcher_t* dispatcher, async_wait_t* wait);
 
+// Cancels the |count| waits in |waits|, as if by calling |async_cancel_wait()|
+// for each of them in order.
+//
+// Clients tearing down many waits at once, such as a server closing all of its
+// connections, should prefer this to a loop of |async_cancel_wait()| calls:
+// dispatchers can take their locks once for the whole array.  Dispatchers that
+// predate this operation get one |async_cancel_wait()| call per wait.
+//
+// Waits that are not pending are skipped, as |async_cancel_wait()| would
+// return |ZX_ERR_NOT_FOUND| for them.  If |out_canceled| is not NULL, it is
+// set to the number of waits that were canceled, whose handlers will not run
+// again and which can be released immediately.
+//
+// Returns |ZX_OK| once every wait has been canceled or skipped.
+// Returns |ZX_ERR_NOT_SUPPORTED| if not supported by the dispatcher.
+// Returns the status of the first wait that could not be canceled otherwise,
+// in which case none of the waits after it are canceled.
+//
+// This operation is thread-safe.
+zx_status_t async_cancel_waits(async_dispatcher_t* dispatcher, async_wait_t* const* waits,
+                               size_t count, size_t* out_canceled);
+
 __END_CDECLS
 
 #endif  // LIB_ASYNC_WAIT_H_
\ No newline at end of file
@@ -16,10 +16,37 @@ zx_status_t async_begin_wait(async_dispatcher_t* dispatcher, async_wait_t* wait)
     return dispatcher->ops->v1.begin_wait(dispatcher, wait);
 }
 
+zx_status_t async_begin_repeating_wait(async_dispatcher_t* dispatcher, async_wait_t* wait) {
+    if (dispatcher->ops->version < ASYNC_OPS_V3)
+        return ZX_ERR_NOT_SUPPORTED;
+    return dispatcher->ops->v3.begin_repeating_wait(dispatcher, wait);
+}
+
 zx_status_t async_cancel_wait(async_dispatcher_t* dispatcher, async_wait_t* wait) {
     return dispatcher->ops->v1.cancel_wait(dispatcher, wait);
 }
 
+zx_status_t async_cancel_waits(async_dispatcher_t* dispatcher, async_wait_t* const* waits,
+                               size_t count, size_t* out_canceled) {
+    if (dispatcher->ops->version >= ASYNC_OPS_V5)
+        return dispatcher->ops->v5.cancel_waits(dispatcher, waits, count, out_canceled);
+
+    zx_status_t status = ZX_OK;
+    size_t canceled = 0u;
+    for (size_t i = 0u; i < count; i++) {
+        zx_status_t wait_status = dispatcher->ops->v1.cancel_wait(dispatcher, waits[i]);
+        if (wait_status == ZX_OK) {
+            canceled++;
+        } else if (wait_status != ZX_ERR_NOT_FOUND) {
+            status = wait_status;
+            break;
+        }
+    }
+    if (out_canceled)
+        *out_canceled = canceled;
+    return status;
+}
+
 zx_status_t async_post_task(async_dispatcher_t* dispatcher, async_task_t* task) {
     return dispatcher->ops->v1.post_task(dispatcher, task);
 }
@@ -33,6 +60,24 @@ zx_status_t async_queue_packet(async_dispatcher_t* dispatcher, async_receiver_t*
     return dispatcher->ops->v1.queue_packet(dispatcher, receiver, data);
 }
 
+zx_status_t async_queue_packets(async_dispatcher_t* dispatcher, const async_packet_t* packets,
+                                size_t count, size_t* out_queued) {
+    if (dispatcher->ops->version >= ASYNC_OPS_V4)
+        return dispatcher->ops->v4.queue_packets(dispatcher, packets, count, out_queued);
+
+    zx_status_t status = ZX_OK;
+    size_t queued = 0u;
+    for (; queued < count; queued++) {
+        status = dispatcher->ops->v1.queue_packet(dispatcher, packets[queued].receiver,
+                                                  packets[queued].data);
+        if (status != ZX_OK)
+            break;
+    }
+    if (out_queued)
+        *out_queued = queued;
+    return status;
+}
+
 zx_status_t async_set_guest_bell_trap(async_dispatcher_t* dispatcher, async_guest_bell_trap_t* trap,
                                       zx_handle_t guest, zx_vaddr_t addr, size_t length) {
     return dispatcher->ops->v1.set_guest_bell_trap(dispatcher, trap, guest, addr, length);
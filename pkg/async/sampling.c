@@ -0,0 +1,25 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/async/sampling.h>
+
+__thread const async_handler_frame_t* async_handler_slot_
+    __attribute__((tls_model("initial-exec")));
+
+static inline const char* thread_pointer(void) {
+#if defined(__x86_64__)
+    // The thread pointer points to itself.
+    const char* tp;
+    __asm__("mov %%fs:0, %0" : "=r"(tp));
+    return tp;
+#elif defined(__aarch64__)
+    return (const char*)__builtin_thread_pointer();
+#else
+#error what architecture?
+#endif
+}
+
+ptrdiff_t async_get_handler_slot_offset(void) {
+    return (const char*)&async_handler_slot_ - thread_pointer();
+}
@@ -0,0 +1,144 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/async/cpp/deadline.h>
+
+#include <mutex>
+
+#include <lib/async/task.h>
+#include <lib/async/time.h>
+#include <lib/fit/thread_safety.h>
+
+namespace async {
+
+// The posted dispatcher task.
+//
+// It is owned by the |DeadlineTimer| until the handler runs, unless the
+// timer is destroyed first without managing to cancel it, in which case the
+// handler deletes it.
+class DeadlineTimer::Record final : public async_task_t {
+public:
+    explicit Record(zx::time deadline)
+        : async_task_t{{ASYNC_STATE_INIT}, &Record::Handler, deadline.get(), 0} {}
+
+    // Sets the task to resume once the deadline passes.
+    // Returns false if the handler has run already.
+    //
+    // Takes a fresh ticket each time, since the one taken by an earlier
+    // poll may have been resumed already.
+    bool Arm(fit::context& context) {
+        fit::suspended_task previous; // released outside of the lock
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (handled_)
+            return false;
+        previous = std::move(task_);
+        task_ = context.suspend_task();
+        return true;
+    }
+
+    void Destroy(async_dispatcher_t* dispatcher) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // Cancel under the lock so that the handler cannot delete the
+            // record in the meantime.  Failing to cancel means the handler is
+            // about to run and will take care of it.
+            if (!handled_ && async_cancel_task(dispatcher, this) != ZX_OK) {
+                abandoned_ = true;
+                return;
+            }
+        }
+        delete this;
+    }
+
+private:
+    static void Handler(async_dispatcher_t* dispatcher, async_task_t* task,
+                        zx_status_t status) {
+        static_cast<Record*>(task)->Expire();
+    }
+
+    // Also runs if the dispatcher shuts down, at which point the deadline
+    // is considered to have passed.
+    void Expire() {
+        fit::suspended_task task; // resume outside of the lock
+        bool abandoned;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            handled_ = true;
+            abandoned = abandoned_;
+            if (!abandoned)
+                task = std::move(task_);
+        }
+        if (!abandoned) {
+            task.resume_task();
+            return;
+        }
+
+        // Must destroy self outside of the lock.
+        delete this;
+    }
+
+    std::mutex mutex_;
+    bool handled_ FIT_GUARDED(mutex_) = false;
+    bool abandoned_ FIT_GUARDED(mutex_) = false;
+    fit::suspended_task task_ FIT_GUARDED(mutex_);
+};
+
+DeadlineTimer::DeadlineTimer(async_dispatcher_t* dispatcher, zx::time deadline)
+    : dispatcher_(dispatcher), deadline_(deadline) {}
+
+DeadlineTimer::DeadlineTimer(DeadlineTimer&& other)
+    : dispatcher_(other.dispatcher_), deadline_(other.deadline_),
+      expired_(other.expired_), record_(other.record_) {
+    other.record_ = nullptr;
+}
+
+DeadlineTimer::~DeadlineTimer() {
+    if (record_)
+        record_->Destroy(dispatcher_);
+}
+
+bool DeadlineTimer::HasExpired(fit::context& context) {
+    if (expired_)
+        return true;
+    if (!record_) {
+        if (zx::time(async_now(dispatcher_)) >= deadline_) {
+            expired_ = true;
+            return true;
+        }
+        record_ = new Record(deadline_);
+        if (async_post_task(dispatcher_, record_) != ZX_OK) {
+            delete record_;
+            record_ = nullptr;
+            expired_ = true;
+            return true;
+        }
+    }
+    if (!record_->Arm(context)) {
+        expired_ = true;
+        return true;
+    }
+    return false;
+}
+
+namespace internal {
+
+DelayContinuation::DelayContinuation(async_dispatcher_t* dispatcher,
+                                     zx::duration delay)
+    : dispatcher_(dispatcher), delay_(delay) {}
+
+DelayContinuation::DelayContinuation(DelayContinuation&& other) = default;
+
+DelayContinuation::~DelayContinuation() = default;
+
+fit::result<> DelayContinuation::operator()(fit::context& context) {
+    if (!timer_)
+        timer_.emplace(DeadlineTimer(
+            dispatcher_, zx::time(async_now(dispatcher_)) + delay_));
+    if (!timer_->HasExpired(context))
+        return fit::pending();
+    return fit::ok();
+}
+
+} // namespace internal
+} // namespace async
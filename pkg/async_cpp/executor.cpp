@@ -0,0 +1,286 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/async/cpp/executor.h>
+
+#include <assert.h>
+
+#include <mutex>
+
+#include <lib/async/sampling.h>
+#include <lib/async/task.h>
+#include <lib/fit/thread_safety.h>
+
+namespace async {
+
+// The dispatcher implementation runs the executor's tasks from a dispatcher
+// task and provides the suspended task resolver.
+//
+// It outlives the |Executor| while any of the following remain:
+//
+// - tickets held by |fit::suspended_task| instances, each of which points to
+//   the resolver interface
+// - a dispatcher task that is posted or running; if the executor is destroyed
+//   before the dispatcher task can be canceled, the task finishes the job
+//
+// The object deletes itself once all of these are gone.
+class Executor::DispatcherImpl final : public async_task_t,
+                                       public fit::suspended_task::resolver {
+public:
+    DispatcherImpl(async_dispatcher_t* dispatcher, ContextImpl* context);
+
+    void Shutdown();
+    void ScheduleTask(fit::pending_task task);
+    fit::suspended_task SuspendCurrentTask();
+
+    fit::suspended_task::ticket duplicate_ticket(
+        fit::suspended_task::ticket ticket) override;
+    void resolve_ticket(
+        fit::suspended_task::ticket ticket, bool resume_task) override;
+
+private:
+    // Whether the dispatcher task is posted.
+    enum class LoopState {
+        kIdle,      // not posted, no runnable tasks
+        kScheduled, // posted, will run the runnable tasks
+        kRunning,   // running a batch of tasks
+        kStopped,   // the dispatcher shut down, nothing will run again
+    };
+
+    ~DispatcherImpl() override;
+
+    static void Handler(async_dispatcher_t* dispatcher, async_task_t* task,
+                        zx_status_t status);
+    void Dispatch(zx_status_t status);
+    void RunTask(fit::pending_task* task);
+
+    // Posts the dispatcher task if there are runnable tasks and it is not
+    // posted or running already.
+    void ScheduleDispatchLocked() FIT_REQUIRES(guarded_.mutex_);
+
+    // Returns true if nothing refers to this object anymore.
+    bool CanDeleteLocked() const FIT_REQUIRES(guarded_.mutex_);
+
+    async_dispatcher_t* const dispatcher_;
+    ContextImpl* const context_;
+
+    // Only accessed by the thread running the batch.
+    fit::suspended_task::ticket current_task_ticket_ = 0;
+
+    // A bunch of state that is guarded by a mutex.
+    struct {
+        std::mutex mutex_;
+        bool was_shutdown_ FIT_GUARDED(mutex_) = false;
+        LoopState loop_state_ FIT_GUARDED(mutex_) = LoopState::kIdle;
+        fit::subtle::scheduler scheduler_ FIT_GUARDED(mutex_);
+    } guarded_;
+};
+
+Executor::Executor(async_dispatcher_t* dispatcher)
+    : dispatcher_(dispatcher), context_(this),
+      impl_(new DispatcherImpl(dispatcher, &context_)) {}
+
+Executor::~Executor() {
+    impl_->Shutdown();
+}
+
+void Executor::schedule_task(fit::pending_task task) {
+    assert(task);
+    impl_->ScheduleTask(std::move(task));
+}
+
+Executor::ContextImpl::ContextImpl(Executor* executor)
+    : executor_(executor) {}
+
+Executor::ContextImpl::~ContextImpl() = default;
+
+Executor* Executor::ContextImpl::executor() const {
+    return executor_;
+}
+
+fit::suspended_task Executor::ContextImpl::suspend_task() {
+    return executor_->impl_->SuspendCurrentTask();
+}
+
+Executor::DispatcherImpl::DispatcherImpl(async_dispatcher_t* dispatcher,
+                                         ContextImpl* context)
+    : async_task_t{{ASYNC_STATE_INIT}, &DispatcherImpl::Handler, 0, 0},
+      dispatcher_(dispatcher), context_(context) {}
+
+Executor::DispatcherImpl::~DispatcherImpl() {
+    std::lock_guard<std::mutex> lock(guarded_.mutex_);
+    assert(guarded_.was_shutdown_);
+    assert(guarded_.loop_state_ != LoopState::kScheduled &&
+           guarded_.loop_state_ != LoopState::kRunning);
+    assert(!guarded_.scheduler_.has_runnable_tasks());
+    assert(!guarded_.scheduler_.has_suspended_tasks());
+    assert(!guarded_.scheduler_.has_outstanding_tickets());
+}
+
+void Executor::DispatcherImpl::Shutdown() {
+    fit::subtle::scheduler::task_queue tasks; // drop outside of the lock
+    {
+        std::lock_guard<std::mutex> lock(guarded_.mutex_);
+        assert(!guarded_.was_shutdown_);
+        assert(guarded_.loop_state_ != LoopState::kRunning);
+        guarded_.was_shutdown_ = true;
+        guarded_.scheduler_.take_all_tasks(&tasks);
+        if (guarded_.loop_state_ == LoopState::kScheduled &&
+            async_cancel_task(dispatcher_, this) == ZX_OK) {
+            guarded_.loop_state_ = LoopState::kIdle;
+        }
+        if (!CanDeleteLocked()) {
+            return; // can't delete self yet
+        }
+    }
+
+    // Must destroy self outside of the lock.
+    delete this;
+}
+
+void Executor::DispatcherImpl::ScheduleTask(fit::pending_task task) {
+    std::lock_guard<std::mutex> lock(guarded_.mutex_);
+    assert(!guarded_.was_shutdown_);
+    guarded_.scheduler_.schedule_task(std::move(task));
+    ScheduleDispatchLocked();
+}
+
+// Must only be called while |RunTask()| is running a task.
+// This happens when the task's continuation calls |context::suspend_task()|
+// upon the context it received as an argument.
+fit::suspended_task Executor::DispatcherImpl::SuspendCurrentTask() {
+    std::lock_guard<std::mutex> lock(guarded_.mutex_);
+    assert(!guarded_.was_shutdown_);
+    if (current_task_ticket_ == 0) {
+        current_task_ticket_ = guarded_.scheduler_.obtain_ticket(
+            2 /*initial_refs*/);
+    } else {
+        guarded_.scheduler_.duplicate_ticket(current_task_ticket_);
+    }
+    return fit::suspended_task(this, current_task_ticket_);
+}
+
+void Executor::DispatcherImpl::Handler(async_dispatcher_t* dispatcher,
+                                       async_task_t* task, zx_status_t status) {
+    static_cast<DispatcherImpl*>(task)->Dispatch(status);
+}
+
+void Executor::DispatcherImpl::Dispatch(zx_status_t status) {
+    fit::subtle::scheduler::task_queue tasks;
+    bool run_tasks = false;
+    {
+        std::lock_guard<std::mutex> lock(guarded_.mutex_);
+        assert(guarded_.loop_state_ == LoopState::kScheduled);
+        if (status != ZX_OK) {
+            // The dispatcher is shutting down.  Tasks scheduled from here on
+            // are held until the executor is destroyed.
+            guarded_.loop_state_ = LoopState::kStopped;
+            guarded_.scheduler_.take_all_tasks(&tasks);
+        } else if (guarded_.was_shutdown_) {
+            // The executor was destroyed after this task began to run.
+            guarded_.loop_state_ = LoopState::kIdle;
+        } else {
+            guarded_.loop_state_ = LoopState::kRunning;
+            guarded_.scheduler_.take_runnable_tasks(&tasks);
+            run_tasks = true;
+        }
+    }
+
+    if (run_tasks) {
+        while (!tasks.empty()) {
+            RunTask(&tasks.front());
+            tasks.pop(); // the task may be destroyed here if it was not suspended
+        }
+    } else {
+        // Abandoned tasks may resolve tickets of their own, so drop them
+        // outside of the lock.
+        tasks = fit::subtle::scheduler::task_queue();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(guarded_.mutex_);
+        if (run_tasks) {
+            // Tasks that became runnable while the batch ran go in the next
+            // batch, to give the dispatcher's other work a turn.
+            guarded_.loop_state_ = LoopState::kIdle;
+            ScheduleDispatchLocked();
+        }
+        if (!CanDeleteLocked()) {
+            return; // can't delete self yet
+        }
+    }
+
+    // Must destroy self outside of the lock.
+    delete this;
+}
+
+void Executor::DispatcherImpl::RunTask(fit::pending_task* task) {
+    assert(current_task_ticket_ == 0);
+    async_handler_frame_t frame;
+    async_push_handler_frame(&frame, ASYNC_HANDLER_KIND_PENDING_TASK,
+                             task->target_code_address(), task);
+    const bool finished = (*task)(*context_);
+    async_pop_handler_frame(&frame);
+    assert(!*task == finished);
+    (void)finished;
+    if (current_task_ticket_ == 0) {
+        return; // task was not suspended, no ticket was produced
+    }
+
+    std::lock_guard<std::mutex> lock(guarded_.mutex_);
+    assert(!guarded_.was_shutdown_);
+    guarded_.scheduler_.finalize_ticket(current_task_ticket_, task);
+    current_task_ticket_ = 0;
+}
+
+fit::suspended_task::ticket Executor::DispatcherImpl::duplicate_ticket(
+    fit::suspended_task::ticket ticket) {
+    std::lock_guard<std::mutex> lock(guarded_.mutex_);
+    guarded_.scheduler_.duplicate_ticket(ticket);
+    return ticket;
+}
+
+void Executor::DispatcherImpl::resolve_ticket(
+    fit::suspended_task::ticket ticket, bool resume_task) {
+    fit::pending_task abandoned_task; // drop outside of the lock
+    {
+        std::lock_guard<std::mutex> lock(guarded_.mutex_);
+        if (resume_task) {
+            guarded_.scheduler_.resume_task_with_ticket(ticket);
+        } else {
+            abandoned_task = guarded_.scheduler_.release_ticket(ticket);
+        }
+        if (!guarded_.was_shutdown_) {
+            ScheduleDispatchLocked();
+            return;
+        }
+        if (!CanDeleteLocked()) {
+            return; // can't delete self yet
+        }
+    }
+
+    // Must destroy self outside of the lock.
+    delete this;
+}
+
+void Executor::DispatcherImpl::ScheduleDispatchLocked() {
+    if (guarded_.loop_state_ != LoopState::kIdle ||
+        !guarded_.scheduler_.has_runnable_tasks()) {
+        return;
+    }
+    if (async_post_task(dispatcher_, this) == ZX_OK) {
+        guarded_.loop_state_ = LoopState::kScheduled;
+    } else {
+        guarded_.loop_state_ = LoopState::kStopped;
+    }
+}
+
+bool Executor::DispatcherImpl::CanDeleteLocked() const {
+    return guarded_.was_shutdown_ &&
+           guarded_.loop_state_ != LoopState::kScheduled &&
+           guarded_.loop_state_ != LoopState::kRunning &&
+           !guarded_.scheduler_.has_outstanding_tickets();
+}
+
+} // namespace async
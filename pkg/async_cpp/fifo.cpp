@@ -0,0 +1,185 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/async/cpp/fifo.h>
+
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+namespace async {
+namespace internal {
+
+FifoReaderBase::FifoReaderBase(zx_handle_t fifo, size_t elem_size,
+                               void* buffer, size_t capacity)
+    : async_wait_t{{ASYNC_STATE_INIT}, &FifoReaderBase::CallHandler, fifo,
+                   ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED},
+      elem_size_(elem_size), buffer_(buffer), capacity_(capacity) {}
+
+FifoReaderBase::~FifoReaderBase() {
+    if (destroyed_)
+        *destroyed_ = true;
+    Cancel();
+}
+
+zx_status_t FifoReaderBase::Begin(async_dispatcher_t* dispatcher) {
+    ZX_DEBUG_ASSERT(!dispatcher_);
+    zx_status_t status = async_begin_repeating_wait(dispatcher, this);
+    if (status == ZX_OK)
+        dispatcher_ = dispatcher;
+    return status;
+}
+
+void FifoReaderBase::Cancel() {
+    if (!dispatcher_)
+        return;
+    async_cancel_wait(dispatcher_, this);
+    dispatcher_ = nullptr;
+}
+
+void FifoReaderBase::CallHandler(async_dispatcher_t* dispatcher,
+                                 async_wait_t* wait, zx_status_t status,
+                                 const zx_packet_signal_t* signal) {
+    static_cast<FifoReaderBase*>(wait)->Handle(status, signal);
+}
+
+void FifoReaderBase::Handle(zx_status_t status,
+                            const zx_packet_signal_t* signal) {
+    if (status != ZX_OK) {
+        dispatcher_ = nullptr; // the dispatcher ended the wait
+        OnBatch(status, 0u);
+        return;
+    }
+
+    if (signal->observed & ZX_FIFO_READABLE) {
+        bool destroyed = false;
+        destroyed_ = &destroyed;
+        for (;;) {
+            size_t count = 0u;
+            status = zx_fifo_read(object, elem_size_, buffer_, capacity_, &count);
+            if (status == ZX_ERR_SHOULD_WAIT)
+                break;
+            if (status != ZX_OK) {
+                destroyed_ = nullptr;
+                Stop(status);
+                return;
+            }
+            OnBatch(ZX_OK, count);
+            if (destroyed)
+                return;
+            if (!dispatcher_ || count < capacity_)
+                break; // canceled by the handler, or drained
+        }
+        destroyed_ = nullptr;
+        // The wait reports the fifo again once it becomes readable, or once
+        // the peer closed it if that is what woke us.
+        if (!(signal->observed & ZX_FIFO_PEER_CLOSED) || !dispatcher_)
+            return;
+    }
+
+    // The peer closed the fifo and every element has been read.
+    Stop(ZX_ERR_PEER_CLOSED);
+}
+
+void FifoReaderBase::Stop(zx_status_t status) {
+    Cancel();
+    OnBatch(status, 0u);
+}
+
+FifoWriterBase::FifoWriterBase(zx_handle_t fifo, size_t elem_size,
+                               async_dispatcher_t* dispatcher)
+    : async_wait_t{{ASYNC_STATE_INIT}, &FifoWriterBase::CallHandler, fifo,
+                   ZX_FIFO_WRITABLE | ZX_FIFO_PEER_CLOSED},
+      elem_size_(elem_size), dispatcher_(dispatcher) {}
+
+FifoWriterBase::~FifoWriterBase() {
+    if (waiting_)
+        async_cancel_wait(dispatcher_, this);
+}
+
+zx_status_t FifoWriterBase::Write(const void* elements, size_t count) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(elements);
+    if (queue_offset_ == queue_.size()) {
+        // Nothing is queued so try to write the elements right away.
+        size_t actual = 0u;
+        zx_status_t status = zx_fifo_write(object, elem_size_, bytes, count,
+                                           &actual);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            actual = 0u;
+        } else if (status != ZX_OK) {
+            return status;
+        }
+        bytes += actual * elem_size_;
+        count -= actual;
+        if (count == 0u)
+            return ZX_OK;
+    }
+
+    Enqueue(bytes, count * elem_size_);
+    if (!waiting_) {
+        zx_status_t status = async_begin_wait(dispatcher_, this);
+        if (status != ZX_OK)
+            return status;
+        waiting_ = true;
+    }
+    return ZX_OK;
+}
+
+void FifoWriterBase::Enqueue(const uint8_t* bytes, size_t size) {
+    if (queue_offset_ == queue_.size()) {
+        queue_.clear();
+        queue_offset_ = 0u;
+    }
+    queue_.insert(queue_.end(), bytes, bytes + size);
+}
+
+void FifoWriterBase::CallHandler(async_dispatcher_t* dispatcher,
+                                 async_wait_t* wait, zx_status_t status,
+                                 const zx_packet_signal_t* signal) {
+    static_cast<FifoWriterBase*>(wait)->Handle(status, signal);
+}
+
+void FifoWriterBase::Handle(zx_status_t status,
+                            const zx_packet_signal_t* signal) {
+    waiting_ = false;
+    if (status != ZX_OK) {
+        Fail(status);
+        return;
+    }
+    if (!(signal->observed & ZX_FIFO_WRITABLE)) {
+        Fail(ZX_ERR_PEER_CLOSED);
+        return;
+    }
+
+    // Fill the fifo with as many queued elements as it has room for.
+    size_t actual = 0u;
+    status = zx_fifo_write(object, elem_size_, queue_.data() + queue_offset_,
+                           queued_count(), &actual);
+    if (status != ZX_OK && status != ZX_ERR_SHOULD_WAIT) {
+        Fail(status);
+        return;
+    }
+    if (status == ZX_OK)
+        queue_offset_ += actual * elem_size_;
+    if (queue_offset_ == queue_.size()) {
+        queue_.clear();
+        queue_offset_ = 0u;
+        return;
+    }
+
+    status = async_begin_wait(dispatcher_, this);
+    if (status != ZX_OK) {
+        Fail(status);
+        return;
+    }
+    waiting_ = true;
+}
+
+void FifoWriterBase::Fail(zx_status_t status) {
+    queue_.clear();
+    queue_offset_ = 0u;
+    OnError(status);
+}
+
+} // namespace internal
+} // namespace async
@@ -0,0 +1,167 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <assert.h>
+
+#include <type_traits>
+#include <utility>
+
+#include <lib/async/dispatcher.h>
+#include <lib/fit/optional.h>
+#include <lib/fit/promise.h>
+#include <lib/zx/time.h>
+#include <zircon/errors.h>
+
+namespace async {
+
+// Waits for a deadline on behalf of a promise, using a task posted on a
+// dispatcher so that the timer shares the dispatcher's timer heap with its
+// other tasks.
+//
+// Nothing is posted or allocated until the promise first finds the deadline
+// has yet to pass, so a promise that completes without waiting costs just
+// a clock read.
+//
+// This is a building block for |async::MakeDelayPromise()| and
+// |async::WithDeadline()|.  The timer is movable but not thread-safe; it
+// must be used by one task at a time.
+class DeadlineTimer final {
+public:
+    DeadlineTimer(async_dispatcher_t* dispatcher, zx::time deadline);
+    DeadlineTimer(DeadlineTimer&& other);
+
+    // Cancels the timer if it is posted.
+    ~DeadlineTimer();
+
+    // Gets the deadline.
+    zx::time deadline() const { return deadline_; }
+
+    // Returns true if the deadline has passed.
+    // Otherwise arranges for the task evaluating |context| to be resumed once
+    // it passes, and returns false.
+    //
+    // If the dispatcher is shutting down and cannot post the timer, the
+    // deadline is treated as having passed so the task does not wait forever.
+    bool HasExpired(fit::context& context);
+
+    DeadlineTimer(const DeadlineTimer&) = delete;
+    DeadlineTimer& operator=(const DeadlineTimer&) = delete;
+    DeadlineTimer& operator=(DeadlineTimer&&) = delete;
+
+private:
+    class Record;
+
+    async_dispatcher_t* const dispatcher_;
+    const zx::time deadline_;
+    bool expired_ = false;
+    Record* record_ = nullptr; // allocated once the timer is first posted
+};
+
+namespace internal {
+
+// The continuation produced by |async::MakeDelayPromise()|.
+class DelayContinuation final {
+public:
+    DelayContinuation(async_dispatcher_t* dispatcher, zx::duration delay);
+    DelayContinuation(DelayContinuation&& other);
+    ~DelayContinuation();
+
+    fit::result<> operator()(fit::context& context);
+
+    DelayContinuation(const DelayContinuation&) = delete;
+    DelayContinuation& operator=(const DelayContinuation&) = delete;
+    DelayContinuation& operator=(DelayContinuation&&) = delete;
+
+private:
+    async_dispatcher_t* const dispatcher_;
+    const zx::duration delay_;
+    fit::optional<DeadlineTimer> timer_; // started on first evaluation
+};
+
+// The continuation produced by |async::WithDeadline()|.
+template <typename Promise, typename TimeoutHandler>
+class DeadlineContinuation final {
+public:
+    DeadlineContinuation(async_dispatcher_t* dispatcher, zx::time deadline,
+                         Promise promise, TimeoutHandler on_timeout)
+        : timer_(dispatcher, deadline), promise_(std::move(promise)),
+          on_timeout_(std::move(on_timeout)) {}
+
+    typename Promise::result_type operator()(fit::context& context) {
+        typename Promise::result_type result = promise_(context);
+        if (!result.is_pending() || !timer_.HasExpired(context))
+            return result;
+        promise_ = Promise(); // abandon the promise
+        return on_timeout_();
+    }
+
+private:
+    DeadlineTimer timer_;
+    Promise promise_;
+    TimeoutHandler on_timeout_;
+};
+
+} // namespace internal
+
+// Returns a promise that completes successfully once |delay| has elapsed
+// on |dispatcher|'s clock, measured from when the promise first runs.
+//
+// The promise may be run by any executor but the dispatcher must outlive it.
+//
+// EXAMPLE
+//
+//     executor.schedule_task(
+//         async::MakeDelayPromise(dispatcher, zx::sec(1))
+//             .and_then([] { /* one second later */ }));
+//
+inline fit::promise_impl<internal::DelayContinuation> MakeDelayPromise(
+    async_dispatcher_t* dispatcher, zx::duration delay) {
+    return fit::make_promise_with_continuation(
+        internal::DelayContinuation(dispatcher, delay));
+}
+
+// Returns a promise that evaluates |promise| until it completes or until
+// |deadline| passes on |dispatcher|'s clock, whichever comes first.
+// If the deadline passes first, |promise| is abandoned and the result is
+// produced by invoking |on_timeout|, a callable object which takes no
+// arguments and returns the same result type as |promise|.
+//
+// The promise may be run by any executor but the dispatcher must outlive it.
+// If |promise| completes first, the timer costs no allocation unless
+// |promise| ever had to wait while the deadline was still ahead.
+//
+// EXAMPLE
+//
+//     auto fetch = async::WithDeadline(
+//         dispatcher, zx::deadline_after(zx::sec(5)), fetch_page(id),
+//         [] { return fit::error(error_type::kTimedOut); });
+//
+template <typename Promise, typename TimeoutHandler>
+inline fit::promise_impl<internal::DeadlineContinuation<Promise, TimeoutHandler>>
+WithDeadline(async_dispatcher_t* dispatcher, zx::time deadline,
+             Promise promise, TimeoutHandler on_timeout) {
+    static_assert(
+        std::is_convertible<decltype(std::declval<TimeoutHandler&>()()),
+                            typename Promise::result_type>::value,
+        "TimeoutHandler must return the promise's result type.");
+    assert(promise);
+    return fit::make_promise_with_continuation(
+        internal::DeadlineContinuation<Promise, TimeoutHandler>(
+            dispatcher, deadline, std::move(promise), std::move(on_timeout)));
+}
+
+// Like the above, but fails with |ZX_ERR_TIMED_OUT| if the deadline passes
+// first.  The promise's error type must be |zx_status_t|.
+template <typename Promise>
+inline decltype(auto) WithDeadline(async_dispatcher_t* dispatcher,
+                                   zx::time deadline, Promise promise) {
+    static_assert(std::is_same<typename Promise::error_type, zx_status_t>::value,
+                  "Promise must have an error type of zx_status_t.");
+    return WithDeadline(dispatcher, deadline, std::move(promise),
+                        [] { return fit::error(ZX_ERR_TIMED_OUT); });
+}
+
+} // namespace async
@@ -0,0 +1,79 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <lib/async/dispatcher.h>
+#include <lib/fit/promise.h>
+#include <lib/fit/scheduler.h>
+
+namespace async {
+
+// An asynchronous task executor that runs its tasks on an async dispatcher,
+// such as the thread of an |async::Loop|, alongside the dispatcher's other
+// waits, tasks, and packets.
+//
+// Rather than posting one dispatcher task for each runnable task, the
+// executor keeps at most one dispatcher task posted at a time.  When it runs,
+// it takes every task that is runnable at that moment and runs them as a
+// batch; tasks scheduled or resumed while the batch runs are picked up by the
+// next dispatcher task, so the executor never starves the rest of the loop.
+// Resuming a suspended task therefore costs a dispatcher post only when the
+// executor was idle.
+//
+// Tasks may be scheduled and resumed from any thread.  They run one at a time
+// even if the dispatcher has several threads.
+//
+// If the dispatcher shuts down, the tasks that remain are destroyed and the
+// tasks scheduled afterwards are held until the executor is destroyed.
+//
+// See documentation of |fit::promise| for more information.
+class Executor final : public fit::executor {
+public:
+    // Creates an executor that runs its tasks on |dispatcher|, which must
+    // outlive the executor.
+    explicit Executor(async_dispatcher_t* dispatcher);
+
+    // Destroys the executor along with all of its remaining scheduled tasks
+    // that have yet to complete.
+    //
+    // Must not be called from one of the executor's own tasks, nor while one
+    // of them runs on another thread of the dispatcher.
+    ~Executor() override;
+
+    // Gets the executor's dispatcher.
+    async_dispatcher_t* dispatcher() const { return dispatcher_; }
+
+    // Schedules a task for eventual execution by the executor.
+    //
+    // This method is thread-safe.
+    void schedule_task(fit::pending_task task) override;
+
+    Executor(const Executor&) = delete;
+    Executor(Executor&&) = delete;
+    Executor& operator=(const Executor&) = delete;
+    Executor& operator=(Executor&&) = delete;
+
+private:
+    class DispatcherImpl;
+
+    // The task context for tasks run by the executor.
+    class ContextImpl final : public fit::context {
+    public:
+        explicit ContextImpl(Executor* executor);
+        ~ContextImpl() override;
+
+        Executor* executor() const override;
+        fit::suspended_task suspend_task() override;
+
+    private:
+        Executor* const executor_;
+    };
+
+    async_dispatcher_t* const dispatcher_;
+    ContextImpl context_;
+    DispatcherImpl* const impl_;
+};
+
+} // namespace async
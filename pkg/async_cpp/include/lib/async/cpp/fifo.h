@@ -0,0 +1,209 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <lib/async/dispatcher.h>
+#include <lib/async/wait.h>
+#include <lib/fit/function.h>
+#include <lib/zx/fifo.h>
+
+namespace async {
+namespace internal {
+
+// The type-independent part of |async::FifoReader|.
+class FifoReaderBase : private async_wait_t {
+protected:
+    FifoReaderBase(zx_handle_t fifo, size_t elem_size, void* buffer,
+                   size_t capacity);
+    virtual ~FifoReaderBase();
+
+    zx_status_t Begin(async_dispatcher_t* dispatcher);
+    void Cancel();
+    bool is_pending() const { return dispatcher_ != nullptr; }
+
+    // Called with each batch of elements read into the buffer, or with
+    // an error and no elements once the reader stops.
+    virtual void OnBatch(zx_status_t status, size_t count) = 0;
+
+private:
+    static void CallHandler(async_dispatcher_t* dispatcher, async_wait_t* wait,
+                            zx_status_t status, const zx_packet_signal_t* signal);
+    void Handle(zx_status_t status, const zx_packet_signal_t* signal);
+    void Stop(zx_status_t status);
+
+    const size_t elem_size_;
+    void* const buffer_;
+    const size_t capacity_;
+    async_dispatcher_t* dispatcher_ = nullptr;
+    bool* destroyed_ = nullptr;
+};
+
+// The type-independent part of |async::FifoWriter|.
+class FifoWriterBase : private async_wait_t {
+protected:
+    FifoWriterBase(zx_handle_t fifo, size_t elem_size,
+                   async_dispatcher_t* dispatcher);
+    virtual ~FifoWriterBase();
+
+    zx_status_t Write(const void* elements, size_t count);
+    size_t queued_count() const {
+        return (queue_.size() - queue_offset_) / elem_size_;
+    }
+
+    // Called once the writer fails to write queued elements.
+    virtual void OnError(zx_status_t status) = 0;
+
+private:
+    static void CallHandler(async_dispatcher_t* dispatcher, async_wait_t* wait,
+                            zx_status_t status, const zx_packet_signal_t* signal);
+    void Handle(zx_status_t status, const zx_packet_signal_t* signal);
+    void Enqueue(const uint8_t* bytes, size_t size);
+    void Fail(zx_status_t status);
+
+    const size_t elem_size_;
+    async_dispatcher_t* const dispatcher_;
+    bool waiting_ = false;
+    std::vector<uint8_t> queue_;
+    size_t queue_offset_ = 0;
+};
+
+} // namespace internal
+
+// Reads elements from a fifo in batches on an async dispatcher.
+//
+// Each time the fifo becomes readable, the reader drains it with as few
+// reads as possible: each read takes up to |kBatchCapacity| elements in one
+// system call and hands them to the handler as one batch.  The wait stays
+// armed between batches so reading at a high rate does not cost a system
+// call per wakeup to re-arm it.
+//
+// The reader does not own the fifo, which must outlive it.
+//
+// This class is thread-hostile: it must be started, canceled and destroyed
+// on the dispatcher's thread, or from within its own handler.
+//
+// EXAMPLE
+//
+//     async::FifoReader<eth_fifo_entry_t> rx(
+//         rx_fifo, [this] (zx_status_t status, const eth_fifo_entry_t* entries,
+//                          size_t count) {
+//             if (status != ZX_OK) { /* peer closed or dispatcher shut down */ }
+//             for (size_t i = 0; i < count; i++) HandleEntry(entries[i]);
+//         });
+//     rx.Begin(dispatcher);
+//
+template <typename T, size_t kBatchCapacity = 64>
+class FifoReader final : private internal::FifoReaderBase {
+public:
+    static_assert(kBatchCapacity > 0, "batches must hold an element");
+
+    // Receives each batch of elements with |ZX_OK|; the elements are only
+    // valid until the handler returns.  Once the reader stops, because the
+    // peer closed the fifo or because of some other error, receives that
+    // error and no elements.
+    //
+    // The handler may destroy or cancel the reader.
+    using Handler = fit::function<void(zx_status_t status, const T* elements,
+                                       size_t count)>;
+
+    FifoReader(const zx::typed_fifo<T>& fifo, Handler handler)
+        : FifoReaderBase(fifo.get(), sizeof(T), buffer_, kBatchCapacity),
+          handler_(std::move(handler)) {}
+
+    // Cancels the wait if it is pending.
+    ~FifoReader() override = default;
+
+    // Starts reading.
+    //
+    // Returns |ZX_OK| if the wait was begun, or an error from
+    // |async_begin_repeating_wait()|.
+    zx_status_t Begin(async_dispatcher_t* dispatcher) {
+        return FifoReaderBase::Begin(dispatcher);
+    }
+
+    // Stops reading without invoking the handler.
+    void Cancel() { FifoReaderBase::Cancel(); }
+
+    // Returns true if the reader is waiting for elements.
+    bool is_pending() const { return FifoReaderBase::is_pending(); }
+
+    FifoReader(const FifoReader&) = delete;
+    FifoReader(FifoReader&&) = delete;
+    FifoReader& operator=(const FifoReader&) = delete;
+    FifoReader& operator=(FifoReader&&) = delete;
+
+private:
+    void OnBatch(zx_status_t status, size_t count) override {
+        handler_(status, buffer_, count);
+    }
+
+    T buffer_[kBatchCapacity];
+    Handler handler_;
+};
+
+// Writes elements to a fifo on an async dispatcher.
+//
+// |Write()| writes as many elements as the fifo has room for right away and
+// queues the others.  Each time the fifo becomes writable again, the writer
+// fills it with as many queued elements as fit in one system call.
+//
+// The writer does not own the fifo, which must outlive it.
+//
+// This class is thread-hostile: it must be used and destroyed on the
+// dispatcher's thread.
+template <typename T>
+class FifoWriter final : private internal::FifoWriterBase {
+public:
+    // Receives the error that stopped the writer from writing queued
+    // elements, such as |ZX_ERR_PEER_CLOSED|.  The queued elements are
+    // dropped.  The handler may destroy the writer.
+    using ErrorHandler = fit::function<void(zx_status_t status)>;
+
+    FifoWriter(const zx::typed_fifo<T>& fifo, async_dispatcher_t* dispatcher)
+        : FifoWriterBase(fifo.get(), sizeof(T), dispatcher) {}
+
+    // Cancels the wait if it is pending and drops the queued elements.
+    ~FifoWriter() override = default;
+
+    void set_error_handler(ErrorHandler error_handler) {
+        error_handler_ = std::move(error_handler);
+    }
+
+    // Writes |count| elements, preserving their order relative to elements
+    // queued earlier.
+    //
+    // Returns |ZX_OK| if the elements were written or queued, or the error
+    // that prevented it, such as |ZX_ERR_PEER_CLOSED|.
+    zx_status_t Write(const T* elements, size_t count) {
+        return FifoWriterBase::Write(elements, count);
+    }
+
+    zx_status_t WriteOne(const T& element) {
+        return FifoWriterBase::Write(&element, 1u);
+    }
+
+    // Returns how many elements are waiting for room in the fifo.
+    size_t queued_count() const { return FifoWriterBase::queued_count(); }
+
+    FifoWriter(const FifoWriter&) = delete;
+    FifoWriter(FifoWriter&&) = delete;
+    FifoWriter& operator=(const FifoWriter&) = delete;
+    FifoWriter& operator=(FifoWriter&&) = delete;
+
+private:
+    void OnError(zx_status_t status) override {
+        if (error_handler_)
+            error_handler_(status);
+    }
+
+    ErrorHandler error_handler_;
+};
+
+} // namespace async
@@ -0,0 +1,128 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <utility>
+
+#include <lib/async/receiver.h>
+#include <lib/fit/function.h>
+
+namespace async {
+
+// Holds content for a packet receiver and its handler.
+//
+// After successfully queuing packets to the receiver, the client is responsible
+// for retaining the structure in memory (and unmodified) until all packets have
+// been received by the handler or the dispatcher shuts down.  There is no way
+// to cancel a packet which has been queued.
+//
+// Multiple packets may be delivered to the same receiver concurrently.
+//
+// Concrete implementations: |async::Receiver|, |async::ReceiverMethod|.
+// Please do not create subclasses of ReceiverBase outside of this library.
+class ReceiverBase {
+protected:
+    explicit ReceiverBase(async_receiver_handler_t* handler)
+        : receiver_{{ASYNC_STATE_INIT}, handler} {}
+    ~ReceiverBase() = default;
+
+    ReceiverBase(const ReceiverBase&) = delete;
+    ReceiverBase(ReceiverBase&&) = delete;
+    ReceiverBase& operator=(const ReceiverBase&) = delete;
+    ReceiverBase& operator=(ReceiverBase&&) = delete;
+
+public:
+    // Enqueues a packet of data for delivery to a receiver.
+    //
+    // The |data| will be copied into the packet.  May be NULL to create a
+    // zero-initialized packet payload.
+    //
+    // See |async_queue_packet()| for details.
+    zx_status_t QueuePacket(async_dispatcher_t* dispatcher,
+                            const zx_packet_user_t* data = nullptr) {
+        return async_queue_packet(dispatcher, &receiver_, data);
+    }
+
+protected:
+    template <typename T>
+    static T* Dispatch(async_receiver_t* receiver) {
+        // |receiver_| is the first member of this standard-layout class, so
+        // the two share an address.
+        static_assert(offsetof(ReceiverBase, receiver_) == 0, "");
+        auto self = reinterpret_cast<ReceiverBase*>(receiver);
+        return static_cast<T*>(self);
+    }
+
+private:
+    async_receiver_t receiver_;
+};
+
+// A receiver whose handler is bound to a |async::Receiver::Handler| function.
+//
+// Prefer using |async::ReceiverMethod| instead for binding to a fixed class
+// method since it is more efficient to dispatch.
+class Receiver final : public ReceiverBase {
+public:
+    // Handles receipt of packets containing user supplied data.
+    //
+    // The |status| is |ZX_OK| if the packet was successfully delivered and
+    // |data| contains the information from the packet, otherwise |data| is
+    // null.
+    using Handler = fit::function<void(async_dispatcher_t* dispatcher,
+                                       async::Receiver* receiver,
+                                       zx_status_t status,
+                                       const zx_packet_user_t* data)>;
+
+    explicit Receiver(Handler handler = nullptr)
+        : ReceiverBase(&Receiver::CallHandler), handler_(std::move(handler)) {}
+    ~Receiver() = default;
+
+    void set_handler(Handler handler) { handler_ = std::move(handler); }
+    bool has_handler() const { return !!handler_; }
+
+private:
+    static void CallHandler(async_dispatcher_t* dispatcher, async_receiver_t* receiver,
+                            zx_status_t status, const zx_packet_user_t* data) {
+        auto self = Dispatch<Receiver>(receiver);
+        self->handler_(dispatcher, self, status, data);
+    }
+
+    Handler handler_;
+};
+
+// A receiver whose handler is bound to a fixed class method.
+//
+// Queuing packets costs no allocation, and the handler is a direct call to
+// the method.
+//
+// Usage:
+//
+// class Foo {
+//     void Handle(async_dispatcher_t* dispatcher, async::ReceiverBase* receiver,
+//                 zx_status_t status, const zx_packet_user_t* data) { ... }
+//     async::ReceiverMethod<Foo, &Foo::Handle> receiver_{this};
+// };
+template <class Class,
+          void (Class::*method)(async_dispatcher_t* dispatcher, async::ReceiverBase* receiver,
+                                zx_status_t status, const zx_packet_user_t* data)>
+class ReceiverMethod final : public ReceiverBase {
+public:
+    explicit ReceiverMethod(Class* instance)
+        : ReceiverBase(&ReceiverMethod::CallHandler), instance_(instance) {}
+    ~ReceiverMethod() = default;
+
+private:
+    static void CallHandler(async_dispatcher_t* dispatcher, async_receiver_t* receiver,
+                            zx_status_t status, const zx_packet_user_t* data) {
+        auto self = Dispatch<ReceiverMethod>(receiver);
+        (self->instance_->*method)(dispatcher, self, status, data);
+    }
+
+    Class* const instance_;
+};
+
+} // namespace async
@@ -0,0 +1,162 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <lib/async/dispatcher.h>
+#include <lib/async/wait.h>
+#include <lib/fit/function.h>
+#include <lib/zx/mapped_vmo.h>
+#include <lib/zx/socket.h>
+#include <lib/zx/vmo.h>
+
+namespace async {
+namespace internal {
+
+// The part of |async::VmoToSocketPump| and |async::SocketToVmoPump| that
+// waits for the socket.
+class SocketPumpBase : private async_wait_t {
+public:
+    // Receives the pump's final status and the number of bytes it moved.
+    // The handler may destroy the pump.
+    using CompleteHandler = fit::function<void(zx_status_t status,
+                                               uint64_t size)>;
+
+protected:
+    SocketPumpBase(const zx::socket& socket, zx_signals_t trigger,
+                   CompleteHandler handler);
+    virtual ~SocketPumpBase();
+
+    zx_status_t Begin(async_dispatcher_t* dispatcher);
+    void Cancel();
+    bool is_pending() const { return dispatcher_ != nullptr; }
+
+    zx_handle_t socket() const { return object; }
+
+    // Moves as many bytes as possible without blocking.
+    // Returns |ZX_ERR_SHOULD_WAIT| to wait for the socket again, or the
+    // status with which to complete.
+    virtual zx_status_t Transfer() = 0;
+
+    // Maps |size| bytes of |vmo| at |offset|, which need not be page-aligned.
+    static zx_status_t MapRange(const zx::vmo& vmo, uint64_t offset,
+                                uint64_t size, zx_vm_option_t options,
+                                zx::mapped_vmo* mapping, uint8_t** data);
+
+    uint64_t transferred_ = 0u;
+
+private:
+    static void CallHandler(async_dispatcher_t* dispatcher, async_wait_t* wait,
+                            zx_status_t status, const zx_packet_signal_t* signal);
+    void Handle(zx_status_t status);
+
+    async_dispatcher_t* dispatcher_ = nullptr;
+    CompleteHandler handler_;
+};
+
+} // namespace internal
+
+// Writes a range of a vmo to a socket on an async dispatcher.
+//
+// The range is mapped and written straight from the mapping, so each time
+// the socket has room the pump fills it with a single system call and the
+// bytes are copied only once, into the socket.
+//
+// The pump does not own the socket or the vmo; the socket must outlive it.
+//
+// This class is thread-hostile: it must be started, canceled and destroyed
+// on the dispatcher's thread, or from within its own handler.
+//
+// EXAMPLE
+//
+//     async::VmoToSocketPump pump(
+//         body_socket, [this] (zx_status_t status, uint64_t size) {
+//             if (status != ZX_OK) { /* the reader went away */ }
+//         });
+//     pump.Begin(dispatcher, body_vmo, 0u, body_size);
+//
+class VmoToSocketPump final : private internal::SocketPumpBase {
+public:
+    using internal::SocketPumpBase::CompleteHandler;
+
+    VmoToSocketPump(const zx::socket& socket, CompleteHandler handler);
+    ~VmoToSocketPump() override;
+
+    // Starts writing the |size| bytes of |vmo| at |offset|.  The handler
+    // receives |ZX_OK| once all of them are written.
+    //
+    // Returns |ZX_OK| if the pump started, |ZX_ERR_INVALID_ARGS| if |size|
+    // is zero, or an error from mapping the vmo or beginning the wait.
+    zx_status_t Begin(async_dispatcher_t* dispatcher, const zx::vmo& vmo,
+                      uint64_t offset, uint64_t size);
+
+    // Stops writing without invoking the handler.
+    void Cancel();
+
+    bool is_pending() const { return SocketPumpBase::is_pending(); }
+
+    VmoToSocketPump(const VmoToSocketPump&) = delete;
+    VmoToSocketPump(VmoToSocketPump&&) = delete;
+    VmoToSocketPump& operator=(const VmoToSocketPump&) = delete;
+    VmoToSocketPump& operator=(VmoToSocketPump&&) = delete;
+
+private:
+    zx_status_t Transfer() override;
+
+    zx::mapped_vmo mapping_;
+    const uint8_t* data_ = nullptr;
+    uint64_t size_ = 0u;
+};
+
+// Reads a socket into a range of a vmo on an async dispatcher until the
+// peer closes the socket.
+//
+// Each time the socket is readable, the pump reads straight into a mapping
+// of the range, taking as many bytes as the socket holds with each system
+// call.
+//
+// The pump does not own the socket or the vmo; the socket must outlive it.
+//
+// This class is thread-hostile: it must be started, canceled and destroyed
+// on the dispatcher's thread, or from within its own handler.
+class SocketToVmoPump final : private internal::SocketPumpBase {
+public:
+    using internal::SocketPumpBase::CompleteHandler;
+
+    SocketToVmoPump(const zx::socket& socket, CompleteHandler handler);
+    ~SocketToVmoPump() override;
+
+    // Starts reading into the |capacity| bytes of |vmo| at |offset|.
+    // The handler receives |ZX_OK| once the peer closes the socket or shuts
+    // it down for writing, or |ZX_ERR_BUFFER_TOO_SMALL| if the stream holds
+    // more bytes than that.
+    //
+    // Returns |ZX_OK| if the pump started, |ZX_ERR_INVALID_ARGS| if
+    // |capacity| is zero, or an error from mapping the vmo or beginning the
+    // wait.
+    zx_status_t Begin(async_dispatcher_t* dispatcher, const zx::vmo& vmo,
+                      uint64_t offset, uint64_t capacity);
+
+    // Stops reading without invoking the handler.
+    void Cancel();
+
+    bool is_pending() const { return SocketPumpBase::is_pending(); }
+
+    SocketToVmoPump(const SocketToVmoPump&) = delete;
+    SocketToVmoPump(SocketToVmoPump&&) = delete;
+    SocketToVmoPump& operator=(const SocketToVmoPump&) = delete;
+    SocketToVmoPump& operator=(SocketToVmoPump&&) = delete;
+
+private:
+    zx_status_t Transfer() override;
+
+    zx::mapped_vmo mapping_;
+    uint8_t* data_ = nullptr;
+    uint64_t capacity_ = 0u;
+};
+
+} // namespace async
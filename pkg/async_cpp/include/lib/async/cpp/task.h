@@ -0,0 +1,208 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <utility>
+
+#include <lib/async/cpp/time.h>
+#include <lib/async/task.h>
+#include <lib/fit/function.h>
+#include <lib/zx/time.h>
+
+namespace async {
+
+// Holds context for a task and its handler, with RAII semantics.
+// Automatically cancels the task when it goes out of scope.
+//
+// After successfully posting the task, the client is responsible for retaining
+// the structure in memory (and unmodified) until the task's handler runs, the
+// task is successfully canceled, or the dispatcher shuts down.  Thereafter,
+// the task may be posted again or destroyed.
+//
+// This class must only be used with single-threaded asynchronous dispatchers
+// and must only be accessed on the dispatch thread since it lacks internal
+// synchronization of its state.
+//
+// Concrete implementations: |async::Task|, |async::TaskMethod|,
+//   |async::TaskClosure|, |async::TaskClosureMethod|.
+// Please do not create subclasses of TaskBase outside of this library.
+class TaskBase {
+protected:
+    explicit TaskBase(async_task_handler_t* handler);
+    ~TaskBase();
+
+    TaskBase(const TaskBase&) = delete;
+    TaskBase(TaskBase&&) = delete;
+    TaskBase& operator=(const TaskBase&) = delete;
+    TaskBase& operator=(TaskBase&&) = delete;
+
+public:
+    // Returns true if the task has been posted and has not yet executed or
+    // been canceled.
+    bool is_pending() const { return dispatcher_ != nullptr; }
+
+    // The last deadline with which the task was posted, or |zx::time::infinite()|
+    // if it has never been posted.
+    zx::time last_deadline() const { return zx::time(task_.deadline); }
+
+    // Gets or sets how long after its deadline the task may run.  Defaults to
+    // zero.  See |async_task_t.slack| for details.
+    zx::duration slack() const { return zx::duration(task_.slack); }
+    void set_slack(zx::duration slack) { task_.slack = slack.get(); }
+
+    // Posts a task to invoke the handler on the specified dispatcher as soon
+    // as possible.
+    //
+    // See |async_post_task()| for details.
+    zx_status_t Post(async_dispatcher_t* dispatcher) {
+        return PostForTime(dispatcher, async::Now(dispatcher));
+    }
+
+    // Posts a task to invoke the handler on the specified dispatcher after
+    // the specified delay.
+    //
+    // See |async_post_task()| for details.
+    zx_status_t PostDelayed(async_dispatcher_t* dispatcher, zx::duration delay) {
+        return PostForTime(dispatcher, async::Now(dispatcher) + delay);
+    }
+
+    // Posts a task to invoke the handler on the specified dispatcher once the
+    // deadline has elapsed.
+    //
+    // See |async_post_task()| for details.
+    zx_status_t PostForTime(async_dispatcher_t* dispatcher, zx::time deadline);
+
+    // Cancels the task.
+    //
+    // See |async_cancel_task()| for details.
+    zx_status_t Cancel();
+
+protected:
+    template <typename T>
+    static T* Dispatch(async_task_t* task) {
+        // |task_| is the first member of this standard-layout class, so the
+        // two share an address.
+        static_assert(offsetof(TaskBase, task_) == 0, "");
+        auto self = reinterpret_cast<TaskBase*>(task);
+        self->dispatcher_ = nullptr;
+        return static_cast<T*>(self);
+    }
+
+private:
+    async_task_t task_;
+    async_dispatcher_t* dispatcher_ = nullptr;
+};
+
+// A task whose handler is bound to a |async::Task::Handler| function.
+//
+// Prefer using |async::TaskMethod| instead for binding to a fixed class method
+// since it is more efficient to dispatch.
+class Task final : public TaskBase {
+public:
+    // Handles execution of a posted task.
+    //
+    // The |status| is |ZX_OK| if the task's deadline elapsed and the task
+    // should run.  The |status| is |ZX_ERR_CANCELED| if the dispatcher was
+    // shut down before the task's handler ran or the task was canceled.
+    using Handler = fit::function<void(async_dispatcher_t* dispatcher,
+                                       async::Task* task, zx_status_t status)>;
+
+    explicit Task(Handler handler = nullptr);
+    ~Task();
+
+    void set_handler(Handler handler) { handler_ = std::move(handler); }
+    bool has_handler() const { return !!handler_; }
+
+private:
+    static void CallHandler(async_dispatcher_t* dispatcher, async_task_t* task,
+                            zx_status_t status);
+
+    Handler handler_;
+};
+
+// A task whose handler is bound to a fixed class method.
+//
+// Posting the task again costs no allocation, and the handler is a direct
+// call to the method.
+//
+// Usage:
+//
+// class Foo {
+//     void Handle(async_dispatcher_t* dispatcher, async::TaskBase* task,
+//                 zx_status_t status) { ... }
+//     async::TaskMethod<Foo, &Foo::Handle> task_{this};
+// };
+template <class Class,
+          void (Class::*method)(async_dispatcher_t* dispatcher, async::TaskBase* task,
+                                zx_status_t status)>
+class TaskMethod final : public TaskBase {
+public:
+    explicit TaskMethod(Class* instance)
+        : TaskBase(&TaskMethod::CallHandler), instance_(instance) {}
+    ~TaskMethod() = default;
+
+private:
+    static void CallHandler(async_dispatcher_t* dispatcher, async_task_t* task,
+                            zx_status_t status) {
+        auto self = Dispatch<TaskMethod>(task);
+        (self->instance_->*method)(dispatcher, self, status);
+    }
+
+    Class* const instance_;
+};
+
+// A task whose handler is bound to a |fit::closure| function with no
+// arguments.  The closure is not invoked when errors occur since it doesn't
+// have a |zx_status_t| argument.
+//
+// Prefer using |async::TaskClosureMethod| instead for binding to a fixed class
+// method since it is more efficient to dispatch.
+class TaskClosure final : public TaskBase {
+public:
+    explicit TaskClosure(fit::closure handler = nullptr);
+    ~TaskClosure();
+
+    void set_handler(fit::closure handler) { handler_ = std::move(handler); }
+    bool has_handler() const { return !!handler_; }
+
+private:
+    static void CallHandler(async_dispatcher_t* dispatcher, async_task_t* task,
+                            zx_status_t status);
+
+    fit::closure handler_;
+};
+
+// A task whose handler is bound to a fixed class method with no arguments.
+// The method is not invoked when errors occur since it doesn't have a
+// |zx_status_t| argument.
+//
+// Usage:
+//
+// class Foo {
+//     void Handle() { ... }
+//     async::TaskClosureMethod<Foo, &Foo::Handle> task_{this};
+// };
+template <class Class, void (Class::*method)()>
+class TaskClosureMethod final : public TaskBase {
+public:
+    explicit TaskClosureMethod(Class* instance)
+        : TaskBase(&TaskClosureMethod::CallHandler), instance_(instance) {}
+    ~TaskClosureMethod() = default;
+
+private:
+    static void CallHandler(async_dispatcher_t* dispatcher, async_task_t* task,
+                            zx_status_t status) {
+        auto self = Dispatch<TaskClosureMethod>(task); // must do this if status is not ok
+        if (status == ZX_OK) {
+            (self->instance_->*method)();
+        }
+    }
+
+    Class* const instance_;
+};
+
+} // namespace async
@@ -0,0 +1,166 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/async/cpp/socket_pump.h>
+
+#include <zircon/assert.h>
+#include <zircon/limits.h>
+#include <zircon/syscalls.h>
+
+namespace async {
+namespace internal {
+
+SocketPumpBase::SocketPumpBase(const zx::socket& socket, zx_signals_t trigger,
+                               CompleteHandler handler)
+    : async_wait_t{{ASYNC_STATE_INIT}, &SocketPumpBase::CallHandler,
+                   socket.get(), trigger},
+      handler_(std::move(handler)) {}
+
+SocketPumpBase::~SocketPumpBase() {
+    Cancel();
+}
+
+zx_status_t SocketPumpBase::Begin(async_dispatcher_t* dispatcher) {
+    ZX_DEBUG_ASSERT(!dispatcher_);
+    zx_status_t status = async_begin_repeating_wait(dispatcher, this);
+    if (status == ZX_OK)
+        dispatcher_ = dispatcher;
+    return status;
+}
+
+void SocketPumpBase::Cancel() {
+    if (!dispatcher_)
+        return;
+    async_cancel_wait(dispatcher_, this);
+    dispatcher_ = nullptr;
+}
+
+zx_status_t SocketPumpBase::MapRange(const zx::vmo& vmo, uint64_t offset,
+                                     uint64_t size, zx_vm_option_t options,
+                                     zx::mapped_vmo* mapping, uint8_t** data) {
+    uint64_t page_offset = offset % ZX_PAGE_SIZE;
+    zx_status_t status = mapping->map(vmo, offset - page_offset,
+                                      page_offset + size, options);
+    if (status != ZX_OK)
+        return status;
+    *data = mapping->data() + page_offset;
+    return ZX_OK;
+}
+
+void SocketPumpBase::CallHandler(async_dispatcher_t* dispatcher,
+                                 async_wait_t* wait, zx_status_t status,
+                                 const zx_packet_signal_t* signal) {
+    static_cast<SocketPumpBase*>(wait)->Handle(status);
+}
+
+void SocketPumpBase::Handle(zx_status_t status) {
+    if (status != ZX_OK) {
+        dispatcher_ = nullptr; // the dispatcher ended the wait
+    } else {
+        status = Transfer();
+        if (status == ZX_ERR_SHOULD_WAIT)
+            return; // the wait is still armed
+        Cancel();
+    }
+    handler_(status, transferred_);
+}
+
+} // namespace internal
+
+VmoToSocketPump::VmoToSocketPump(const zx::socket& socket,
+                                 CompleteHandler handler)
+    : SocketPumpBase(socket,
+                     ZX_SOCKET_WRITABLE | ZX_SOCKET_PEER_CLOSED |
+                         ZX_SOCKET_WRITE_DISABLED,
+                     std::move(handler)) {}
+
+VmoToSocketPump::~VmoToSocketPump() = default;
+
+zx_status_t VmoToSocketPump::Begin(async_dispatcher_t* dispatcher,
+                                   const zx::vmo& vmo, uint64_t offset,
+                                   uint64_t size) {
+    if (size == 0u)
+        return ZX_ERR_INVALID_ARGS;
+    uint8_t* data = nullptr;
+    zx_status_t status = MapRange(vmo, offset, size, ZX_VM_PERM_READ,
+                                  &mapping_, &data);
+    if (status != ZX_OK)
+        return status;
+    data_ = data;
+    size_ = size;
+    transferred_ = 0u;
+    return SocketPumpBase::Begin(dispatcher);
+}
+
+void VmoToSocketPump::Cancel() {
+    SocketPumpBase::Cancel();
+}
+
+zx_status_t VmoToSocketPump::Transfer() {
+    size_t actual = 0u;
+    zx_status_t status = zx_socket_write(socket(), 0u, data_ + transferred_,
+                                         size_ - transferred_, &actual);
+    if (status != ZX_OK)
+        return status;
+    transferred_ += actual;
+    // A short write means the socket is full, so wait for room rather than
+    // trying again right away.
+    return transferred_ == size_ ? ZX_OK : ZX_ERR_SHOULD_WAIT;
+}
+
+SocketToVmoPump::SocketToVmoPump(const zx::socket& socket,
+                                 CompleteHandler handler)
+    : SocketPumpBase(socket,
+                     ZX_SOCKET_READABLE | ZX_SOCKET_PEER_CLOSED |
+                         ZX_SOCKET_READ_DISABLED,
+                     std::move(handler)) {}
+
+SocketToVmoPump::~SocketToVmoPump() = default;
+
+zx_status_t SocketToVmoPump::Begin(async_dispatcher_t* dispatcher,
+                                   const zx::vmo& vmo, uint64_t offset,
+                                   uint64_t capacity) {
+    if (capacity == 0u)
+        return ZX_ERR_INVALID_ARGS;
+    uint8_t* data = nullptr;
+    zx_status_t status = MapRange(vmo, offset, capacity,
+                                  ZX_VM_PERM_READ | ZX_VM_PERM_WRITE,
+                                  &mapping_, &data);
+    if (status != ZX_OK)
+        return status;
+    data_ = data;
+    capacity_ = capacity;
+    transferred_ = 0u;
+    return SocketPumpBase::Begin(dispatcher);
+}
+
+void SocketToVmoPump::Cancel() {
+    SocketPumpBase::Cancel();
+}
+
+zx_status_t SocketToVmoPump::Transfer() {
+    for (;;) {
+        size_t actual = 0u;
+        zx_status_t status;
+        if (transferred_ < capacity_) {
+            status = zx_socket_read(socket(), 0u, data_ + transferred_,
+                                    capacity_ - transferred_, &actual);
+        } else {
+            // The range is full; the stream must end here to fit.
+            uint8_t extra;
+            status = zx_socket_read(socket(), 0u, &extra, 1u, &actual);
+            if (status == ZX_OK)
+                return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        // The stream ends once the peer closes the socket or shuts it down
+        // for writing, and everything it wrote has been read.
+        if (status == ZX_ERR_PEER_CLOSED || status == ZX_ERR_BAD_STATE)
+            return ZX_OK;
+        if (status != ZX_OK)
+            return status;
+        transferred_ += actual;
+    }
+}
+
+} // namespace async
@@ -0,0 +1,75 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/async/cpp/task.h>
+
+#include <zircon/assert.h>
+
+namespace async {
+
+TaskBase::TaskBase(async_task_handler_t* handler)
+    : task_{{ASYNC_STATE_INIT}, handler, ZX_TIME_INFINITE, 0} {}
+
+TaskBase::~TaskBase() {
+    if (dispatcher_) {
+        // Failure to cancel here may result in a dangling pointer...
+        zx_status_t status = async_cancel_task(dispatcher_, &task_);
+        ZX_ASSERT_MSG(status == ZX_OK, "status=%d", status);
+    }
+}
+
+zx_status_t TaskBase::PostForTime(async_dispatcher_t* dispatcher,
+                                  zx::time deadline) {
+    if (dispatcher_)
+        return ZX_ERR_ALREADY_EXISTS;
+
+    dispatcher_ = dispatcher;
+    task_.deadline = deadline.get();
+    zx_status_t status = async_post_task(dispatcher, &task_);
+    if (status != ZX_OK) {
+        dispatcher_ = nullptr;
+    }
+    return status;
+}
+
+zx_status_t TaskBase::Cancel() {
+    if (!dispatcher_)
+        return ZX_ERR_NOT_FOUND;
+
+    async_dispatcher_t* dispatcher = dispatcher_;
+    dispatcher_ = nullptr;
+
+    zx_status_t status = async_cancel_task(dispatcher, &task_);
+    // |dispatcher| is required to be single-threaded and Cancel() is only
+    // supposed to be called on its thread, so a task that was pending is
+    // still in its queue.
+    ZX_DEBUG_ASSERT(status != ZX_ERR_NOT_FOUND);
+    return status;
+}
+
+Task::Task(Handler handler)
+    : TaskBase(&Task::CallHandler), handler_(std::move(handler)) {}
+
+Task::~Task() = default;
+
+void Task::CallHandler(async_dispatcher_t* dispatcher, async_task_t* task,
+                       zx_status_t status) {
+    auto self = Dispatch<Task>(task);
+    self->handler_(dispatcher, self, status);
+}
+
+TaskClosure::TaskClosure(fit::closure handler)
+    : TaskBase(&TaskClosure::CallHandler), handler_(std::move(handler)) {}
+
+TaskClosure::~TaskClosure() = default;
+
+void TaskClosure::CallHandler(async_dispatcher_t* dispatcher, async_task_t* task,
+                              zx_status_t status) {
+    auto self = Dispatch<TaskClosure>(task); // must do this if status is not ok
+    if (status == ZX_OK) {
+        self->handler_();
+    }
+}
+
+} // namespace async
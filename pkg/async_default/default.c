@@ -0,0 +1,15 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/async/default.h>
+
+__thread async_dispatcher_t* __async_default_dispatcher;
+
+async_dispatcher_t* async_get_default_dispatcher(void) {
+    return __async_default_dispatcher;
+}
+
+void async_set_default_dispatcher(async_dispatcher_t* dispatcher) {
+    __async_default_dispatcher = dispatcher;
+}
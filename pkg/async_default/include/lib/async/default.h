@@ -18,6 +18,32 @@ __EXPORT async_dispatcher_t* async_get_default_dispatcher(void);
 // May be set to |NULL| if this thread doesn't have a default dispatcher.
 __EXPORT void async_set_default_dispatcher(async_dispatcher_t* dispatcher);
 
+#if defined(ASYNC_DEFAULT_STATIC) && ASYNC_DEFAULT_STATIC
+
+// Code built against the static variant of this library, |async_default_static|,
+// can read the default dispatcher straight out of thread-local storage with
+// |async_get_default_dispatcher_inline()|: a single TLS load rather than a call
+// through the PLT into |libasync-default.so|.
+//
+// The static variant defines |async_get_default_dispatcher()| and
+// |async_set_default_dispatcher()| itself.  Because an executable's own
+// definitions take precedence over those of the shared libraries it links
+// against, they replace |libasync-default.so|'s for all of the code linked into
+// the executable, including the SDK libraries that depend on |async_default|,
+// such as |async_loop|.  Shared libraries that are loaded at runtime and use
+// the default dispatcher still have |libasync-default.so|'s, and with it a
+// default of their own.  So only executables may depend on the static variant,
+// never libraries, and only executables that do not load such shared
+// libraries.
+extern __thread async_dispatcher_t* __async_default_dispatcher;
+
+// Behaves like |async_get_default_dispatcher()|.
+static inline async_dispatcher_t* async_get_default_dispatcher_inline(void) {
+    return __async_default_dispatcher;
+}
+
+#endif // ASYNC_DEFAULT_STATIC
+
 __END_CDECLS
 
 #endif  // LIB_ASYNC_DEFAULT_H_
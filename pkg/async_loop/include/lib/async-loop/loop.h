@@ -28,8 +28,20 @@ __BEGIN_CDECLS
 // Pointer to a message loop created using |async_loop_create()|.
 typedef struct async_loop async_loop_t;
 
+// The kinds of handlers a message loop invokes.
+typedef uint32_t async_loop_handler_type_t;
+#define ASYNC_LOOP_HANDLER_WAIT ((async_loop_handler_type_t) 0)
+#define ASYNC_LOOP_HANDLER_TASK ((async_loop_handler_type_t) 1)
+#define ASYNC_LOOP_HANDLER_PACKET ((async_loop_handler_type_t) 2)
+#define ASYNC_LOOP_HANDLER_GUEST_BELL_TRAP ((async_loop_handler_type_t) 3)
+#define ASYNC_LOOP_HANDLER_EXCEPTION ((async_loop_handler_type_t) 4)
+
 // Message loop configuration structure.
 typedef void(async_loop_callback_t)(async_loop_t* loop, void* data);
+typedef void(async_loop_slow_handler_callback_t)(async_loop_t* loop, void* data,
+                                                 async_loop_handler_type_t type,
+                                                 const void* handler,
+                                                 zx_duration_t duration);
 typedef struct async_loop_config {
     // If true, the loop will automatically register itself as the default
     // dispatcher for the thread upon which it was created and will
@@ -50,8 +62,70 @@ typedef struct async_loop_config {
     // A function to call after the dispatcher invokes each handler, or NULL if none.
     async_loop_callback_t* epilogue;
 
+    // A function to call when a thread running the loop has nothing left to
+    // dispatch and is about to block waiting for more, or NULL if none.
+    //
+    // This is the place to flush work that was deferred so that it could be
+    // batched, such as coalesced events or buffered log records: it runs as
+    // soon as the loop goes idle, without the extra wake-up that posting a
+    // task to do the flush would cost.  Anything the function posts or queues
+    // is dispatched before the thread blocks.  It is not called by
+    // |async_loop_run_until_idle()| or other runs with a zero deadline, which
+    // never block.  When set, the loop checks for queued packets without
+    // blocking before each wait, which costs an extra system call per wait.
+    async_loop_callback_t* before_wait;
+
     // Data to pass to the callback functions.
     void* data;
+
+    // If true, each thread started by |async_loop_start_thread()| keeps the
+    // tasks it posts that are already due in a run queue of its own, and
+    // steals tasks from the other threads' queues when it runs out.  Other
+    // threads that run the loop take tasks from the queues too, so the tasks
+    // a thread leaves behind when it exits still run.  Waits, delayed tasks
+    // and tasks posted from other threads still go through the shared port
+    // and queues.
+    //
+    // This lets a loop with many threads scale under heavy posting, but local
+    // tasks lose the serial ordering the loop otherwise guarantees: they may
+    // run concurrently with each other and with other tasks, in any order.
+    bool work_stealing;
+
+    // The most higher priority tasks that run while lower priority tasks are
+    // due, before the highest priority of those gets a turn.  Also the most
+    // high priority tasks that join an iteration of due tasks after it began.
+    // Zero selects a default of 16.
+    //
+    // See |async_loop_post_task_with_priority()|.
+    uint32_t priority_starvation_limit;
+
+    // If true, the loop counts and times the handlers it invokes, see
+    // |async_loop_get_stats()|.  This costs two clock reads and a few atomic
+    // operations per handler.
+    bool collect_stats;
+
+    // A function to call after a handler has run for at least
+    // |slow_handler_threshold|, or NULL if none.  It receives the kind of
+    // handler and the handler function itself (for example the
+    // |async_wait_handler_t| of the wait), which can be symbolized, since the
+    // object that held it may have been destroyed by then.
+    //
+    // The check is done when the handler returns, so it costs two clock reads
+    // per handler and cannot catch a handler that never returns.  The
+    // function is called on the thread that ran the handler, before the
+    // |epilogue|, and must not block.
+    async_loop_slow_handler_callback_t* slow_handler;
+    zx_duration_t slow_handler_threshold;
+
+    // A profile to apply to each thread started by |async_loop_start_thread()|,
+    // or |ZX_HANDLE_INVALID| to leave the threads with the default scheduling
+    // parameters.  Use this to give the threads of a latency sensitive loop,
+    // such as one that services audio or input, a higher priority than those
+    // of background loops.  See |zx_profile_create()|.
+    //
+    // The loop does not take ownership of the handle, which must stay valid
+    // for as long as threads are being started.
+    zx_handle_t thread_profile;
 } async_loop_config_t;
 
 // Simple config that when passed to async_loop_create will create a loop
@@ -156,6 +230,71 @@ typedef uint32_t async_loop_state_t;
 #define ASYNC_LOOP_SHUTDOWN ((async_loop_state_t) 2)
 async_loop_state_t async_loop_get_state(async_loop_t* loop);
 
+// The priority of a task posted with |async_loop_post_task_with_priority()|.
+// Tasks posted with |async_post_task()| have the default priority.
+typedef uint32_t async_loop_priority_t;
+#define ASYNC_LOOP_PRIORITY_LOW ((async_loop_priority_t) 0)
+#define ASYNC_LOOP_PRIORITY_DEFAULT ((async_loop_priority_t) 1)
+#define ASYNC_LOOP_PRIORITY_HIGH ((async_loop_priority_t) 2)
+
+// Statistics about a message loop created with |collect_stats| set.
+//
+// To tell whether a loop is saturated, sample the statistics twice and divide
+// the growth of |handler_time| by the time in between: a loop with one thread
+// that is close to 100% busy cannot keep up.  A growing |max_task_lateness|
+// tells the same story from the point of view of the tasks.  The fields are
+// plain counters, so they are easy to export, for example as trace counters
+// from a periodic task.
+typedef struct async_loop_stats {
+    // The number of wait, packet, guest bell trap and exception handlers
+    // invoked, and the number of task handlers invoked.
+    uint64_t packets_dispatched;
+    uint64_t tasks_dispatched;
+
+    // The total and the longest time spent in a handler.
+    zx_duration_t handler_time;
+    zx_duration_t max_handler_time;
+
+    // The total and the longest delay between a task's deadline and the
+    // invocation of its handler.
+    zx_duration_t task_lateness;
+    zx_duration_t max_task_lateness;
+
+    // The number of tasks and waits pending at the time of the call.  Tasks
+    // posted very recently may not be counted yet.
+    uint64_t pending_tasks;
+    uint64_t pending_waits;
+} async_loop_stats_t;
+
+// Gets the current statistics of the message loop.
+//
+// Returns |ZX_OK| on success.
+// Returns |ZX_ERR_NOT_SUPPORTED| if the loop was not created with
+// |collect_stats| set.
+zx_status_t async_loop_get_stats(async_loop_t* loop, async_loop_stats_t* out_stats);
+
+// Posts a task to the message loop with the given |priority|, for example to
+// let input handling overtake background work on the same loop.  Otherwise
+// behaves like |async_post_task()|.
+//
+// Due tasks run highest priority first, and tasks of equal priority run in
+// deadline order.  Up to |priority_starvation_limit| high priority tasks that
+// are posted while the loop is dispatching due tasks, and are due, run before
+// the lower priority tasks that were already due; any more wait for the next
+// round of due tasks, as tasks of other priorities do.  While tasks of a
+// priority are due, one of them runs at least after every
+// |priority_starvation_limit| tasks of higher priorities, so a task waits
+// behind at most that many higher priority tasks for each task of its own
+// priority ahead of it.
+// Waits and packets are not prioritized: they are dispatched in the order the
+// kernel delivers them.
+//
+// Returns |ZX_ERR_INVALID_ARGS| if |priority| is not one of the
+// |ASYNC_LOOP_PRIORITY_*| values.
+// Returns |ZX_ERR_BAD_STATE| if the loop is shutting down.
+zx_status_t async_loop_post_task_with_priority(async_loop_t* loop, async_task_t* task,
+                                               async_loop_priority_t priority);
+
 // Starts a message loop running on a new thread.
 // The thread will run until the loop quits.
 //
@@ -165,6 +304,9 @@ async_loop_state_t async_loop_get_state(async_loop_t* loop);
 // Returns |ZX_OK| on success.
 // Returns |ZX_ERR_BAD_STATE| if the loop was shut down with |async_loop_shutdown()|.
 // Returns |ZX_ERR_NO_MEMORY| if allocation or thread creation failed.
+// Returns the status of |zx_object_set_profile()| if |thread_profile| could
+// not be applied.  The thread then exits without dispatching anything and has
+// been joined before this returns.
 zx_status_t async_loop_start_thread(async_loop_t* loop, const char* name,
                                     thrd_t* out_thread);
 
@@ -10,29 +10,74 @@
 #include <assert.h>
 #include <stdatomic.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <zircon/assert.h>
 #include <zircon/listnode.h>
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/hypervisor.h>
+#include <zircon/threads.h>
 
 #include <lib/async/default.h>
 #include <lib/async/exception.h>
 #include <lib/async/receiver.h>
+#include <lib/async/sampling.h>
 #include <lib/async/task.h>
 #include <lib/async/trap.h>
 #include <lib/async/wait.h>
+#include <lib/sync/completion.h>
+#include <trace/event.h>
 
 // The port wait key associated with the dispatcher's control messages.
 #define KEY_CONTROL (0u)
 
+// The first word of the user packets queued with |KEY_CONTROL|.
+#define CONTROL_WAKE (0u) // wake up a thread, for example to quit
+#define CONTROL_TASKS_QUEUED (1u) // immediately due tasks were queued
+#define CONTROL_STEAL (2u) // a thread has a backlog of local tasks
+
+// The most threads with their own run queue when work stealing is enabled.
+#define ASYNC_LOOP_MAX_WORKERS (64u)
+
+// The number of tasks a thread's run queue holds.  Tasks posted to a full
+// queue go to the shared queues instead.
+#define WORKER_QUEUE_CAPACITY (256u)
+
+// The number of local tasks a thread dispatches in a row before it checks the
+// port, so that a stream of tasks cannot starve waits.
+#define WORKER_TASK_STREAK (16u)
+
+// The most packets a thread reads from the port before dispatching them.
+#define PACKET_BATCH_SIZE (16u)
+
+// The number of wake-ups that find a single packet after which a thread that
+// is not reading in batches checks once whether more packets are queued.
+#define PACKET_BATCH_PROBE_INTERVAL (8u)
+
+// The number of priority lanes, see |async_loop_priority_t|.
+#define PRIORITY_LANES (ASYNC_LOOP_PRIORITY_HIGH + 1u)
+
+// The default for |async_loop_config_t.priority_starvation_limit|.
+#define DEFAULT_STARVATION_LIMIT (16u)
+
+// The most tasks examined to coalesce the timer wake-up of tasks with slack.
+#define TIMER_COALESCE_MAX_TASKS (64u)
+
 static zx_time_t async_loop_now(async_dispatcher_t* dispatcher);
 static zx_status_t async_loop_begin_wait(async_dispatcher_t* dispatcher, async_wait_t* wait);
 static zx_status_t async_loop_cancel_wait(async_dispatcher_t* dispatcher, async_wait_t* wait);
+static zx_status_t async_loop_cancel_waits(async_dispatcher_t* dispatcher,
+                                           async_wait_t* const* waits, size_t count,
+                                           size_t* out_canceled);
+static zx_status_t async_loop_begin_repeating_wait(async_dispatcher_t* dispatcher,
+                                                   async_wait_t* wait);
 static zx_status_t async_loop_post_task(async_dispatcher_t* dispatcher, async_task_t* task);
 static zx_status_t async_loop_cancel_task(async_dispatcher_t* dispatcher, async_task_t* task);
 static zx_status_t async_loop_queue_packet(async_dispatcher_t* dispatcher, async_receiver_t* receiver,
                                            const zx_packet_user_t* data);
+static zx_status_t async_loop_queue_packets(async_dispatcher_t* dispatcher,
+                                            const async_packet_t* packets, size_t count,
+                                            size_t* out_queued);
 static zx_status_t async_loop_set_guest_bell_trap(
     async_dispatcher_t* dispatcher, async_guest_bell_trap_t* trap,
     zx_handle_t guest, zx_vaddr_t addr, size_t length);
@@ -46,7 +91,7 @@ static zx_status_t async_loop_resume_from_exception(async_dispatcher_t* async,
                                                     uint32_t options);
 
 static const async_ops_t async_loop_ops = {
-    .version = ASYNC_OPS_V2,
+    .version = ASYNC_OPS_V5,
     .reserved = 0,
     .v1 = {
         .now = async_loop_now,
@@ -62,13 +107,63 @@ static const async_ops_t async_loop_ops = {
         .unbind_exception_port = async_loop_unbind_exception_port,
         .resume_from_exception = async_loop_resume_from_exception,
     },
+    .v3 = {
+        .begin_repeating_wait = async_loop_begin_repeating_wait,
+    },
+    .v4 = {
+        .queue_packets = async_loop_queue_packets,
+    },
+    .v5 = {
+        .cancel_waits = async_loop_cancel_waits,
+    },
 };
 
 typedef struct thread_record {
     list_node_t node;
     thrd_t thread;
+    async_loop_t* loop;
+    // Signaled once |thread_profile| has been applied to the thread, which
+    // waits for it before dispatching anything.
+    sync_completion_t profile_applied;
+    zx_status_t profile_status;
 } thread_record_t;
 
+// The run queue of a thread started by |async_loop_start_thread| when work
+// stealing is enabled.
+typedef struct async_loop_worker {
+    struct async_loop* loop; // immutable
+    uint32_t index; // immutable, the position in the loop's |workers|
+    atomic_bool owned; // whether a thread is using this queue
+    uint32_t streak; // local tasks dispatched in a row, owner only
+    mtx_t lock; // guards the queue
+    uint64_t head; // position of the oldest task in |queue|
+    uint64_t tail; // position after the newest task in |queue|
+    async_task_t* queue[WORKER_QUEUE_CAPACITY]; // canceled tasks are NULL
+} async_loop_worker_t;
+
+// Packets a thread has read from the port but not dispatched yet.  A batch is
+// listed in |batch_list| while it is being dispatched so that canceling a
+// wait or unbinding an exception port can void the packets it already holds
+// for the object.  A one-shot wait records where its packet is, see
+// |wait_batch|.  Repeating waits and exceptions stay in their lists, so their
+// packets are looked up by key.  A packet is claimed by setting its |claimed|
+// flag, either by the thread dispatching it or by whoever voids it.
+typedef struct async_loop_batch {
+    list_node_t node;
+    uint32_t count; // number of packets read
+    uint32_t listed_count; // packets for repeating waits and exceptions
+    bool drain; // whether to keep reading packets without blocking next time
+    uint32_t single_wakeups; // wake-ups since the last check for more packets
+    atomic_bool claimed[PACKET_BATCH_SIZE];
+    zx_port_packet_t packets[PACKET_BATCH_SIZE];
+} async_loop_batch_t;
+
+// The run queue of the current thread, if it has one.
+static _Thread_local async_loop_worker_t* g_current_worker;
+
+// Tasks taken from run queues in a row by a thread that has none of its own.
+static _Thread_local uint32_t g_steal_streak;
+
 const async_loop_config_t kAsyncLoopConfigAttachToThread = {
     .make_default_for_current_thread = true};
 const async_loop_config_t kAsyncLoopConfigNoAttachToThread = {
@@ -82,22 +177,66 @@ typedef struct async_loop {
 
     _Atomic async_loop_state_t state;
     atomic_uint active_threads; // number of active dispatch threads
+    atomic_uint idle_threads; // number of threads that may be blocked in |zx_port_wait|
 
-    mtx_t lock; // guards the lists and the dispatching tasks flag
+    // Statistics, only kept if |config.collect_stats| is set.
+    _Atomic uint64_t packets_dispatched;
+    _Atomic uint64_t tasks_dispatched;
+    _Atomic zx_duration_t handler_time;
+    _Atomic zx_duration_t max_handler_time;
+    _Atomic zx_duration_t task_lateness;
+    _Atomic zx_duration_t max_task_lateness;
+
+    mtx_t lock; // guards the lists, the task heap and the dispatching tasks flag
     bool dispatching_tasks; // true while the loop is busy dispatching tasks
     list_node_t wait_list; // most recently added first
-    list_node_t task_list; // pending tasks, earliest deadline first
-    list_node_t due_list; // due tasks, earliest deadline first
+    async_task_t** task_heap; // pending tasks, a binary min-heap by deadline then sequence
+    size_t task_count; // number of tasks in |task_heap|
+    size_t task_capacity; // number of slots allocated in |task_heap|
+    uint64_t next_task_seq; // sequence number of the next posted task
+    zx_time_t timer_deadline; // latest time the armed timer fires, or infinite
+    list_node_t due_lists[PRIORITY_LANES]; // due tasks by priority, earliest deadline first
+    // Higher priority tasks run since each lane with due tasks last had a turn.
+    uint32_t lane_waits[PRIORITY_LANES];
+    // High priority tasks that joined the current iteration of due tasks.
+    uint32_t high_priority_joins;
+    // Immediately due tasks posted without taking |lock|, most recent first.
+    // Moved into |task_heap| with |lock| held.
+    _Atomic(async_task_t*) incoming_tasks;
+    // Slots of |task_heap| set aside for |incoming_tasks|, so that moving them
+    // never allocates.  Posters claim one from |incoming_room| before pushing
+    // a task; |incoming_reserved| counts both the unclaimed slots and those of
+    // tasks still in the queue, and is only used with |lock| held.
+    atomic_size_t incoming_room;
+    size_t incoming_reserved;
+
+    // The run queues of the loop's threads when work stealing is enabled.
+    // Queues are added under |lock| and never removed until the loop is
+    // destroyed.
+    _Atomic(async_loop_worker_t*) workers[ASYNC_LOOP_MAX_WORKERS];
+    atomic_uint worker_count;
+    atomic_bool steal_wake_pending; // whether a CONTROL_STEAL packet is queued
     list_node_t thread_list; // earliest created thread first
     list_node_t exception_list; // most recently added first
+    list_node_t batch_list; // batches of packets being dispatched
 } async_loop_t;
 
-static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline);
+static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline,
+                                       async_loop_batch_t* batch);
+static zx_status_t async_loop_dispatch_port_packet(async_loop_t* loop,
+                                                   const zx_port_packet_t* packet,
+                                                   bool batched);
+static zx_status_t async_loop_dispatch_batch(async_loop_t* loop, async_loop_batch_t* batch);
+static bool async_loop_void_batched_packets_locked(async_loop_t* loop, uintptr_t key);
+static bool async_loop_cancel_batched_wait_locked(async_loop_t* loop, async_wait_t* wait);
+static zx_status_t async_loop_cancel_wait_locked(async_loop_t* loop, async_wait_t* wait);
 static zx_status_t async_loop_dispatch_wait(async_loop_t* loop, async_wait_t* wait,
                                             zx_status_t status, const zx_packet_signal_t* signal);
 static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop);
 static void async_loop_dispatch_task(async_loop_t* loop, async_task_t* task,
                                      zx_status_t status);
+static async_task_t* async_loop_next_due_task_locked(async_loop_t* loop);
+static bool async_loop_join_due_tasks_locked(async_loop_t* loop, async_task_t* task);
 static zx_status_t async_loop_dispatch_packet(async_loop_t* loop, async_receiver_t* receiver,
                                               zx_status_t status, const zx_packet_user_t* data);
 static zx_status_t async_loop_dispatch_guest_bell_trap(async_loop_t* loop,
@@ -109,10 +248,25 @@ static zx_status_t async_loop_dispatch_exception(async_loop_t* loop,
                                                  zx_status_t status,
                                                  const zx_port_packet_t* report);
 static void async_loop_wake_threads(async_loop_t* loop);
-static void async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task);
+static void async_loop_record_max(_Atomic zx_duration_t* max, _Atomic zx_duration_t* total,
+                                  zx_duration_t value);
+static zx_status_t async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task);
+static void async_loop_remove_task_locked(async_loop_t* loop, size_t index);
+static bool async_loop_claim_incoming_slot(async_loop_t* loop);
+static void async_loop_push_incoming_task(async_loop_t* loop, async_task_t* task);
+static void async_loop_refill_incoming_room_locked(async_loop_t* loop);
+static void async_loop_merge_incoming_tasks_locked(async_loop_t* loop);
+static bool async_loop_push_local_task(async_loop_worker_t* worker, async_task_t* task);
+static async_task_t* async_loop_pop_local_task(async_loop_worker_t* worker);
+static bool async_loop_cancel_local_task(async_loop_worker_t* worker, async_task_t* task);
+static async_task_t* async_loop_take_local_task(async_loop_t* loop, async_loop_worker_t* worker);
 static void async_loop_restart_timer_locked(async_loop_t* loop);
-static void async_loop_invoke_prologue(async_loop_t* loop);
-static void async_loop_invoke_epilogue(async_loop_t* loop);
+static zx_time_t async_loop_invoke_prologue(async_loop_t* loop, async_handler_frame_t* frame,
+                                            async_loop_handler_type_t type, const void* handler,
+                                            const void* object);
+static void async_loop_invoke_epilogue(async_loop_t* loop, const async_handler_frame_t* frame,
+                                       zx_time_t start,
+                                       async_loop_handler_type_t type, const void* handler);
 
 static_assert(sizeof(list_node_t) <= sizeof(async_state_t),
               "async_state_t too small");
@@ -128,6 +282,64 @@ static inline async_wait_t* node_to_wait(list_node_t* node) {
     return FROM_NODE(async_wait_t, node);
 }
 
+// A pending wait is either in the wait list, with a list node in its |state|,
+// or, once a batch has read its one-shot packet, records that batch tagged
+// with |WAIT_TAG_BATCHED| and the packet's index.  List pointers leave the tag
+// bit clear.  The batch is only valid while it is in |batch_list|: the record
+// is not cleared when the packet is dispatched, so it may be stale.
+static_assert(_Alignof(async_loop_batch_t) >= 2, "batch pointers have no room for tags");
+
+#define WAIT_TAG_BATCHED ((uintptr_t)1u)
+
+static inline async_loop_batch_t* wait_batch(const async_wait_t* wait) {
+    uintptr_t tag = wait->state.reserved[0];
+    return (tag & WAIT_TAG_BATCHED) ? (async_loop_batch_t*)(tag & ~WAIT_TAG_BATCHED) : NULL;
+}
+
+static inline void wait_set_batch(async_wait_t* wait, async_loop_batch_t* batch,
+                                  uint32_t index) {
+    wait->state.reserved[0] = (uintptr_t)batch | WAIT_TAG_BATCHED;
+    wait->state.reserved[1] = index;
+}
+
+// A pending task records its position in the task heap and its priority and
+// sequence number in its |state|. The position is stored shifted left by one
+// with the low bit set, so a zeroed state means the task is not pending.  A
+// task that is still in the incoming queue instead records the next task in
+// the queue, tagged with |TASK_TAG_INCOMING|, and its priority.  A task in a
+// thread's run queue records that queue, tagged with |TASK_TAG_LOCAL|, and its
+// position in it.  A task that is due and waiting in one of the due lists
+// holds a list node, whose pointers leave the tag bits clear.
+static_assert(sizeof(uintptr_t) >= sizeof(uint64_t), "task sequence numbers do not fit");
+static_assert(_Alignof(async_task_t) >= 8, "task pointers have no room for tags");
+static_assert(_Alignof(async_loop_worker_t) >= 8, "worker pointers have no room for tags");
+
+#define TASK_NOT_PENDING SIZE_MAX
+#define TASK_TAG_HEAP ((uintptr_t)1u)
+#define TASK_TAG_INCOMING ((uintptr_t)2u)
+#define TASK_TAG_LOCAL ((uintptr_t)4u)
+#define TASK_TAG_MASK ((uintptr_t)7u)
+#define TASK_PRIORITY_SHIFT (62u)
+#define TASK_SEQ_MASK ((UINT64_C(1) << TASK_PRIORITY_SHIFT) - 1u)
+
+static inline size_t task_heap_index(const async_task_t* task) {
+    uintptr_t tag = task->state.reserved[0];
+    return (tag & TASK_TAG_HEAP) ? (size_t)(tag >> 1) : TASK_NOT_PENDING;
+}
+
+static inline uint64_t task_seq(const async_task_t* task) {
+    return task->state.reserved[1] & TASK_SEQ_MASK;
+}
+
+static inline async_loop_priority_t task_priority(const async_task_t* task) {
+    return (async_loop_priority_t)(task->state.reserved[1] >> TASK_PRIORITY_SHIFT);
+}
+
+static inline bool task_in_due_list(const async_task_t* task) {
+    uintptr_t tag = task->state.reserved[0];
+    return tag != 0u && (tag & TASK_TAG_MASK) == 0u;
+}
+
 static inline list_node_t* task_to_node(async_task_t* task) {
     return TO_NODE(async_task_t, task);
 }
@@ -136,6 +348,22 @@ static inline async_task_t* node_to_task(list_node_t* node) {
     return FROM_NODE(async_task_t, node);
 }
 
+// The latest time |task| may run.
+static inline zx_time_t task_latest(const async_task_t* task) {
+    if (task->slack <= 0)
+        return task->deadline;
+    if (task->deadline > ZX_TIME_INFINITE - task->slack)
+        return ZX_TIME_INFINITE;
+    return task->deadline + task->slack;
+}
+
+// Tasks run in deadline order, and in posting order when deadlines are equal.
+static inline bool task_before(const async_task_t* a, const async_task_t* b) {
+    if (a->deadline != b->deadline)
+        return a->deadline < b->deadline;
+    return task_seq(a) < task_seq(b);
+}
+
 static inline list_node_t* exception_to_node(async_exception_t* exception) {
     return TO_NODE(async_exception_t, exception);
 }
@@ -153,19 +381,28 @@ zx_status_t async_loop_create(const async_loop_config_t* config, async_loop_t**
         return ZX_ERR_NO_MEMORY;
     atomic_init(&loop->state, ASYNC_LOOP_RUNNABLE);
     atomic_init(&loop->active_threads, 0u);
+    atomic_init(&loop->idle_threads, 0u);
+    loop->timer_deadline = ZX_TIME_INFINITE;
+    for (uint32_t i = 0u; i < PRIORITY_LANES; i++)
+        list_initialize(&loop->due_lists[i]);
+    atomic_init(&loop->incoming_tasks, NULL);
+    atomic_init(&loop->incoming_room, 0u);
+    atomic_init(&loop->worker_count, 0u);
+    atomic_init(&loop->steal_wake_pending, false);
 
     loop->dispatcher.ops = &async_loop_ops;
     loop->config = *config;
+    if (loop->config.priority_starvation_limit == 0u)
+        loop->config.priority_starvation_limit = DEFAULT_STARVATION_LIMIT;
     mtx_init(&loop->lock, mtx_plain);
     list_initialize(&loop->wait_list);
-    list_initialize(&loop->task_list);
-    list_initialize(&loop->due_list);
     list_initialize(&loop->thread_list);
+    list_initialize(&loop->batch_list);
     list_initialize(&loop->exception_list);
 
     zx_status_t status = zx_port_create(0u, &loop->port);
     if (status == ZX_OK)
-        status = zx_timer_create(0u, ZX_CLOCK_MONOTONIC, &loop->timer);
+        status = zx_timer_create(ZX_TIMER_SLACK_EARLY, ZX_CLOCK_MONOTONIC, &loop->timer);
     if (status == ZX_OK) {
         status = zx_object_wait_async(loop->timer, loop->port, KEY_CONTROL,
                                       ZX_TIMER_SIGNALED,
@@ -192,6 +429,14 @@ void async_loop_destroy(async_loop_t* loop) {
     zx_handle_close(loop->port);
     zx_handle_close(loop->timer);
     mtx_destroy(&loop->lock);
+    free(loop->task_heap);
+    uint32_t worker_count = atomic_load_explicit(&loop->worker_count, memory_order_acquire);
+    for (uint32_t i = 0u; i < worker_count; i++) {
+        async_loop_worker_t* worker = atomic_load_explicit(&loop->workers[i],
+                                                           memory_order_relaxed);
+        mtx_destroy(&worker->lock);
+        free(worker);
+    }
     free(loop);
 }
 
@@ -212,13 +457,50 @@ void async_loop_shutdown(async_loop_t* loop) {
         async_wait_t* wait = node_to_wait(node);
         async_loop_dispatch_wait(loop, wait, ZX_ERR_CANCELED, NULL);
     }
-    while ((node = list_remove_head(&loop->due_list))) {
-        async_task_t* task = node_to_task(node);
-        async_loop_dispatch_task(loop, task, ZX_ERR_CANCELED);
+    mtx_lock(&loop->lock);
+    // A handler that shuts the loop down may be running in the middle of a
+    // batch.  One-shot waits whose packets the batch still holds are no
+    // longer in the wait list, so they are canceled here.  Everything else
+    // in the batch is canceled with its own list or dropped.
+    async_loop_batch_t* batch;
+    list_for_every_entry (&loop->batch_list, batch, async_loop_batch_t, node) {
+        for (uint32_t i = 0u; i < batch->count; i++) {
+            const zx_port_packet_t* packet = &batch->packets[i];
+            if (packet->key == KEY_CONTROL ||
+                atomic_exchange_explicit(&batch->claimed[i], true, memory_order_relaxed))
+                continue;
+            if (packet->type == ZX_PKT_TYPE_SIGNAL_ONE) {
+                mtx_unlock(&loop->lock);
+                async_loop_dispatch_wait(loop, (async_wait_t*)(uintptr_t)packet->key,
+                                         ZX_ERR_CANCELED, NULL);
+                mtx_lock(&loop->lock);
+            }
+        }
+    }
+    for (uint32_t i = PRIORITY_LANES; i-- > 0u;) {
+        while ((node = list_remove_head(&loop->due_lists[i]))) {
+            mtx_unlock(&loop->lock);
+            async_loop_dispatch_task(loop, node_to_task(node), ZX_ERR_CANCELED);
+            mtx_lock(&loop->lock);
+        }
     }
-    while ((node = list_remove_head(&loop->task_list))) {
-        async_task_t* task = node_to_task(node);
+    async_loop_merge_incoming_tasks_locked(loop);
+    while (loop->task_count > 0u) {
+        async_task_t* task = loop->task_heap[0];
+        async_loop_remove_task_locked(loop, 0u);
+        mtx_unlock(&loop->lock);
         async_loop_dispatch_task(loop, task, ZX_ERR_CANCELED);
+        mtx_lock(&loop->lock);
+        async_loop_merge_incoming_tasks_locked(loop);
+    }
+    mtx_unlock(&loop->lock);
+    uint32_t worker_count = atomic_load_explicit(&loop->worker_count, memory_order_acquire);
+    for (uint32_t i = 0u; i < worker_count; i++) {
+        async_loop_worker_t* worker = atomic_load_explicit(&loop->workers[i],
+                                                           memory_order_acquire);
+        async_task_t* task;
+        while ((task = async_loop_pop_local_task(worker)))
+            async_loop_dispatch_task(loop, task, ZX_ERR_CANCELED);
     }
     while ((node = list_remove_head(&loop->exception_list))) {
         async_exception_t* exception = node_to_exception(node);
@@ -234,10 +516,16 @@ void async_loop_shutdown(async_loop_t* loop) {
 zx_status_t async_loop_run(async_loop_t* loop, zx_time_t deadline, bool once) {
     ZX_DEBUG_ASSERT(loop);
 
+    // Only a loop that keeps running reads packets in batches, since a
+    // single unit of work cannot be more than one packet.
+    async_loop_batch_t batch;
+    batch.drain = false;
+    batch.single_wakeups = 0u;
+
     zx_status_t status;
     atomic_fetch_add_explicit(&loop->active_threads, 1u, memory_order_acq_rel);
     do {
-        status = async_loop_run_once(loop, deadline);
+        status = async_loop_run_once(loop, deadline, once ? NULL : &batch);
     } while (status == ZX_OK && !once);
     atomic_fetch_sub_explicit(&loop->active_threads, 1u, memory_order_acq_rel);
     return status;
@@ -251,56 +539,236 @@ zx_status_t async_loop_run_until_idle(async_loop_t* loop) {
     return status;
 }
 
-static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline) {
+static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline,
+                                       async_loop_batch_t* batch) {
     async_loop_state_t state = atomic_load_explicit(&loop->state, memory_order_acquire);
     if (state == ASYNC_LOOP_SHUTDOWN)
         return ZX_ERR_BAD_STATE;
     if (state != ASYNC_LOOP_RUNNABLE)
         return ZX_ERR_CANCELED;
 
+    // Threads with their own run queue drain it, or help other threads with
+    // theirs, before blocking on the port.  Every few tasks they poll the
+    // port instead, so waits and timers keep being serviced.  Threads without
+    // one, such as a thread calling |async_loop_run()| itself, help too, so
+    // the tasks left in the queues of threads that have exited still run.
+    bool polling = false;
+    async_loop_worker_t* worker = g_current_worker;
+    if (worker && worker->loop != loop)
+        worker = NULL;
+    if (worker || loop->config.work_stealing) {
+        uint32_t* streak = worker ? &worker->streak : &g_steal_streak;
+        if (*streak < WORKER_TASK_STREAK) {
+            async_task_t* task = async_loop_take_local_task(loop, worker);
+            if (task) {
+                (*streak)++;
+                async_loop_dispatch_task(loop, task, ZX_OK);
+                return ZX_OK;
+            }
+        } else {
+            polling = true;
+        }
+        *streak = 0u;
+    }
+
+    // Let the client flush deferred work right before the thread blocks.
+    // Check that there is nothing queued first, so that the hook does not run
+    // between packets that are ready to be dispatched.
     zx_port_packet_t packet;
-    zx_status_t status = zx_port_wait(loop->port, deadline, &packet);
-    if (status != ZX_OK)
-        return status;
+    zx_status_t status = ZX_ERR_TIMED_OUT;
+    if (loop->config.before_wait && !polling && deadline != 0) {
+        status = zx_port_wait(loop->port, 0, &packet);
+        if (status == ZX_ERR_TIMED_OUT)
+            loop->config.before_wait(loop, loop->config.data);
+        else if (status != ZX_OK)
+            return status;
+    }
+
+    if (status != ZX_OK) {
+        // Count ourselves as idle before checking the state one last time, so
+        // that a concurrent |async_loop_wake_threads| either sees us or we see
+        // the new state.
+        atomic_fetch_add(&loop->idle_threads, 1u);
+        if (atomic_load(&loop->state) != ASYNC_LOOP_RUNNABLE) {
+            atomic_fetch_sub(&loop->idle_threads, 1u);
+            return ZX_OK;
+        }
+        status = zx_port_wait(loop->port, polling ? 0 : deadline, &packet);
+        atomic_fetch_sub_explicit(&loop->idle_threads, 1u, memory_order_relaxed);
+        if (status == ZX_ERR_TIMED_OUT && polling)
+            return ZX_OK;
+        if (status != ZX_OK)
+            return status;
+    }
+
+    // The kernel hands out one packet per |zx_port_wait|.  While packets
+    // keep arriving faster than they are dispatched, keep reading without
+    // blocking and dispatch what was read as a batch, so that the bookkeeping
+    // for the whole batch is done under the lock at once rather than per
+    // packet.  A batch of one turns batching off again, and from then on only
+    // every few wake-ups check for more packets, so a lightly loaded loop
+    // rarely pays for the extra read.
+    if (!batch)
+        return async_loop_dispatch_port_packet(loop, &packet, false);
+    if (!batch->drain) {
+        if (++batch->single_wakeups < PACKET_BATCH_PROBE_INTERVAL)
+            return async_loop_dispatch_port_packet(loop, &packet, false);
+        batch->single_wakeups = 0u;
+    }
+    batch->packets[0] = packet;
+    batch->count = 1u;
+    while (batch->count < PACKET_BATCH_SIZE &&
+           zx_port_wait(loop->port, 0, &batch->packets[batch->count]) == ZX_OK)
+        batch->count++;
+    batch->drain = batch->count > 1u;
+    if (!batch->drain)
+        return async_loop_dispatch_port_packet(loop, &batch->packets[0], false);
+    return async_loop_dispatch_batch(loop, batch);
+}
+
+static zx_status_t async_loop_dispatch_batch(async_loop_t* loop, async_loop_batch_t* batch) {
+    // One-shot waits leave the wait list now and point at the batch, which
+    // is listed so that they can still be canceled until they are dispatched.
+    mtx_lock(&loop->lock);
+    batch->listed_count = 0u;
+    for (uint32_t i = 0u; i < batch->count; i++) {
+        const zx_port_packet_t* packet = &batch->packets[i];
+        atomic_init(&batch->claimed[i], false);
+        if (packet->key == KEY_CONTROL)
+            continue;
+        if (packet->type == ZX_PKT_TYPE_SIGNAL_ONE) {
+            async_wait_t* wait = (async_wait_t*)(uintptr_t)packet->key;
+            list_delete(wait_to_node(wait));
+            wait_set_batch(wait, batch, i);
+        } else if (packet->type == ZX_PKT_TYPE_SIGNAL_REP || ZX_PKT_IS_EXCEPTION(packet->type)) {
+            batch->listed_count++;
+        }
+    }
+    list_add_tail(&loop->batch_list, &batch->node);
+    mtx_unlock(&loop->lock);
+
+    for (uint32_t i = 0u; i < batch->count; i++) {
+        const zx_port_packet_t* packet = &batch->packets[i];
+        if (packet->key != KEY_CONTROL &&
+            atomic_exchange_explicit(&batch->claimed[i], true, memory_order_acquire))
+            continue; // voided
+
+        // The packets were read, so they are dispatched even if the loop
+        // quits in the meantime.  If it shuts down, the one-shot waits are
+        // canceled like those still in the wait list.
+        async_loop_state_t state = atomic_load_explicit(&loop->state, memory_order_acquire);
+        if (state == ASYNC_LOOP_SHUTDOWN) {
+            if (packet->key != KEY_CONTROL && packet->type == ZX_PKT_TYPE_SIGNAL_ONE)
+                async_loop_dispatch_wait(loop, (async_wait_t*)(uintptr_t)packet->key,
+                                         ZX_ERR_CANCELED, NULL);
+            continue;
+        }
+        async_loop_dispatch_port_packet(loop, packet, true);
+    }
+
+    mtx_lock(&loop->lock);
+    list_delete(&batch->node);
+    mtx_unlock(&loop->lock);
+    return ZX_OK;
+}
+
+static bool async_loop_void_batched_packets_locked(async_loop_t* loop, uintptr_t key) {
+    // Only batches that hold packets for repeating waits or exceptions need
+    // to be searched, which outside of a burst of such packets is none.
+    bool voided = false;
+    async_loop_batch_t* batch;
+    list_for_every_entry (&loop->batch_list, batch, async_loop_batch_t, node) {
+        if (batch->listed_count == 0u)
+            continue;
+        for (uint32_t i = 0u; i < batch->count; i++) {
+            if (batch->packets[i].key == key &&
+                !atomic_exchange_explicit(&batch->claimed[i], true, memory_order_relaxed))
+                voided = true;
+        }
+    }
+    return voided;
+}
+
+static bool async_loop_cancel_batched_wait_locked(async_loop_t* loop, async_wait_t* wait) {
+    // The record may be stale, so check that the batch is still being
+    // dispatched and still holds the wait's packet before touching it.  There
+    // is at most one batch per dispatching thread.
+    async_loop_batch_t* batch = wait_batch(wait);
+    uint32_t index = (uint32_t)wait->state.reserved[1];
+    async_loop_batch_t* live;
+    list_for_every_entry (&loop->batch_list, live, async_loop_batch_t, node) {
+        if (live != batch)
+            continue;
+        if (index >= batch->count || batch->packets[index].key != (uintptr_t)wait ||
+            batch->packets[index].type != ZX_PKT_TYPE_SIGNAL_ONE)
+            return false;
+        if (atomic_exchange_explicit(&batch->claimed[index], true, memory_order_relaxed))
+            return false; // already dispatched or being dispatched
+        wait->state.reserved[0] = 0u;
+        wait->state.reserved[1] = 0u;
+        return true;
+    }
+    return false;
+}
 
-    if (packet.key == KEY_CONTROL) {
-        // Handle wake-up packets.
-        if (packet.type == ZX_PKT_TYPE_USER)
+static zx_status_t async_loop_dispatch_port_packet(async_loop_t* loop,
+                                                   const zx_port_packet_t* packet,
+                                                   bool batched) {
+    if (packet->key == KEY_CONTROL) {
+        // Handle wake-up packets and immediately due tasks.
+        if (packet->type == ZX_PKT_TYPE_USER) {
+            if (packet->user.u64[0] == CONTROL_TASKS_QUEUED)
+                return async_loop_dispatch_tasks(loop);
+            if (packet->user.u64[0] == CONTROL_STEAL) {
+                // The next iteration looks for tasks to steal.
+                atomic_store_explicit(&loop->steal_wake_pending, false, memory_order_release);
+            }
             return ZX_OK;
+        }
 
         // Handle task timer expirations.
-        if (packet.type == ZX_PKT_TYPE_SIGNAL_REP &&
-            packet.signal.observed & ZX_TIMER_SIGNALED) {
+        if (packet->type == ZX_PKT_TYPE_SIGNAL_REP &&
+            packet->signal.observed & ZX_TIMER_SIGNALED) {
             return async_loop_dispatch_tasks(loop);
         }
     } else {
         // Handle wait completion packets.
-        if (packet.type == ZX_PKT_TYPE_SIGNAL_ONE) {
-            async_wait_t* wait = (void*)(uintptr_t)packet.key;
-            mtx_lock(&loop->lock);
-            list_delete(wait_to_node(wait));
-            mtx_unlock(&loop->lock);
-            return async_loop_dispatch_wait(loop, wait, packet.status, &packet.signal);
+        if (packet->type == ZX_PKT_TYPE_SIGNAL_ONE) {
+            // A batch has already taken the wait out of the wait list.
+            async_wait_t* wait = (void*)(uintptr_t)packet->key;
+            if (!batched) {
+                mtx_lock(&loop->lock);
+                list_delete(wait_to_node(wait));
+                mtx_unlock(&loop->lock);
+            }
+            return async_loop_dispatch_wait(loop, wait, packet->status, &packet->signal);
+        }
+
+        // Handle repeating wait notifications.  The wait stays in the wait list
+        // until it is canceled.
+        if (packet->type == ZX_PKT_TYPE_SIGNAL_REP) {
+            async_wait_t* wait = (void*)(uintptr_t)packet->key;
+            return async_loop_dispatch_wait(loop, wait, packet->status, &packet->signal);
         }
 
         // Handle queued user packets.
-        if (packet.type == ZX_PKT_TYPE_USER) {
-            async_receiver_t* receiver = (void*)(uintptr_t)packet.key;
-            return async_loop_dispatch_packet(loop, receiver, packet.status, &packet.user);
+        if (packet->type == ZX_PKT_TYPE_USER) {
+            async_receiver_t* receiver = (void*)(uintptr_t)packet->key;
+            return async_loop_dispatch_packet(loop, receiver, packet->status, &packet->user);
         }
 
         // Handle guest bell trap packets.
-        if (packet.type == ZX_PKT_TYPE_GUEST_BELL) {
-            async_guest_bell_trap_t* trap = (void*)(uintptr_t)packet.key;
+        if (packet->type == ZX_PKT_TYPE_GUEST_BELL) {
+            async_guest_bell_trap_t* trap = (void*)(uintptr_t)packet->key;
             return async_loop_dispatch_guest_bell_trap(
-                loop, trap, packet.status, &packet.guest_bell);
+                loop, trap, packet->status, &packet->guest_bell);
         }
 
         // Handle exception packets.
-        if (ZX_PKT_IS_EXCEPTION(packet.type)) {
-            async_exception_t* exception = (void*)(uintptr_t)packet.key;
-            return async_loop_dispatch_exception(loop, exception, packet.status,
-                                                 &packet);
+        if (ZX_PKT_IS_EXCEPTION(packet->type)) {
+            async_exception_t* exception = (void*)(uintptr_t)packet->key;
+            return async_loop_dispatch_exception(loop, exception, packet->status,
+                                                 packet);
         }
     }
 
@@ -321,17 +789,27 @@ static zx_status_t async_loop_dispatch_guest_bell_trap(async_loop_t* loop,
                                                        async_guest_bell_trap_t* trap,
                                                        zx_status_t status,
                                                        const zx_packet_guest_bell_t* bell) {
-    async_loop_invoke_prologue(loop);
+    // Note the handler first, since the object might be destroyed.
+    const void* handler = (const void*)trap->handler;
+    TRACE_DURATION("async", "async::GuestBellTrap", "handler", handler);
+    async_handler_frame_t frame;
+    zx_time_t start = async_loop_invoke_prologue(loop, &frame, ASYNC_LOOP_HANDLER_GUEST_BELL_TRAP,
+                                                 handler, trap);
     trap->handler((async_dispatcher_t*)loop, trap, status, bell);
-    async_loop_invoke_epilogue(loop);
+    async_loop_invoke_epilogue(loop, &frame, start, ASYNC_LOOP_HANDLER_GUEST_BELL_TRAP, handler);
     return ZX_OK;
 }
 
 static zx_status_t async_loop_dispatch_wait(async_loop_t* loop, async_wait_t* wait,
                                             zx_status_t status, const zx_packet_signal_t* signal) {
-    async_loop_invoke_prologue(loop);
+    // Note the handler first, since the object might be destroyed.
+    const void* handler = (const void*)wait->handler;
+    TRACE_DURATION("async", "async::Wait", "handler", handler);
+    async_handler_frame_t frame;
+    zx_time_t start = async_loop_invoke_prologue(loop, &frame, ASYNC_LOOP_HANDLER_WAIT,
+                                                 handler, wait);
     wait->handler((async_dispatcher_t*)loop, wait, status, signal);
-    async_loop_invoke_epilogue(loop);
+    async_loop_invoke_epilogue(loop, &frame, start, ASYNC_LOOP_HANDLER_WAIT, handler);
     return ZX_OK;
 }
 
@@ -344,45 +822,50 @@ static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop) {
     if (!loop->dispatching_tasks) {
         loop->dispatching_tasks = true;
 
-        // Extract all of the tasks that are due into |due_list| for dispatch
-        // unless we already have some waiting from a previous iteration which
-        // we would like to process in order.
-        list_node_t* node;
-        if (list_is_empty(&loop->due_list)) {
-            zx_time_t due_time = async_loop_now((async_dispatcher_t*)loop);
-            list_node_t* tail = NULL;
-            list_for_every(&loop->task_list, node) {
-                if (node_to_task(node)->deadline > due_time)
-                    break;
-                tail = node;
-            }
-            if (tail) {
-                list_node_t* head = loop->task_list.next;
-                loop->task_list.next = tail->next;
-                tail->next->prev = &loop->task_list;
-                loop->due_list.next = head;
-                head->prev = &loop->due_list;
-                loop->due_list.prev = tail;
-                tail->next = &loop->due_list;
-            }
+        // Move the tasks that are due now into the due lists of their
+        // priority, earliest deadline first.  Tasks posted from here on wait
+        // for the next iteration even if they are already due, so a task that
+        // keeps reposting itself cannot starve the rest of the loop.  The
+        // exception is high priority tasks, which join the current iteration
+        // as soon as they are posted, so that latency-critical work does not
+        // sit behind a backlog of background tasks.  Only so many join an
+        // iteration, so a high priority task that keeps reposting itself
+        // cannot starve the rest of the loop either.
+        loop->high_priority_joins = 0u;
+        for (uint32_t lane = 0u; lane < PRIORITY_LANES; lane++)
+            loop->lane_waits[lane] = 0u;
+        async_loop_merge_incoming_tasks_locked(loop);
+        zx_time_t due_time = async_loop_now((async_dispatcher_t*)loop);
+        uint64_t due_seq = loop->next_task_seq;
+        while (loop->task_count > 0u) {
+            async_task_t* task = loop->task_heap[0];
+            if (task->deadline > due_time || task_seq(task) >= due_seq)
+                break;
+            async_loop_priority_t priority = task_priority(task);
+            async_loop_remove_task_locked(loop, 0u);
+            list_add_tail(&loop->due_lists[priority], task_to_node(task));
         }
 
-        // Dispatch all due tasks.  Note that they might be canceled concurrently
-        // so we need to grab the lock during each iteration to fetch the next
-        // item from the list.
-        while ((node = list_remove_head(&loop->due_list))) {
+        // Dispatch the due tasks, highest priority first.  Note that they
+        // might be canceled concurrently so we need to grab the lock during
+        // each iteration to fetch the next one.
+        async_task_t* task;
+        while ((task = async_loop_next_due_task_locked(loop))) {
             mtx_unlock(&loop->lock);
 
             // Invoke the handler.  Note that it might destroy itself.
-            async_task_t* task = node_to_task(node);
             async_loop_dispatch_task(loop, task, ZX_OK);
 
             mtx_lock(&loop->lock);
             async_loop_state_t state = atomic_load_explicit(&loop->state, memory_order_acquire);
             if (state != ASYNC_LOOP_RUNNABLE)
                 break;
+            async_loop_merge_incoming_tasks_locked(loop);
         }
 
+        // Pick up the tasks that were posted while we were dispatching, so
+        // the timer fires right away if any of them are due.
+        async_loop_merge_incoming_tasks_locked(loop);
         loop->dispatching_tasks = false;
         async_loop_restart_timer_locked(loop);
     }
@@ -390,21 +873,76 @@ static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop) {
     return ZX_OK;
 }
 
+static async_task_t* async_loop_next_due_task_locked(async_loop_t* loop) {
+    // Give a turn to the lowest lane whose tasks have waited behind
+    // |priority_starvation_limit| higher priority tasks, if any has, and
+    // otherwise take from the highest lane that has tasks.  A lower lane's
+    // turn does not count against the higher lanes, so no lane ever waits
+    // behind more than that many tasks of higher lanes.
+    uint32_t lane = PRIORITY_LANES;
+    for (uint32_t i = 0u; i < PRIORITY_LANES; i++) {
+        if (!list_is_empty(&loop->due_lists[i]) &&
+            loop->lane_waits[i] >= loop->config.priority_starvation_limit) {
+            lane = i;
+            break;
+        }
+    }
+    if (lane == PRIORITY_LANES) {
+        while (lane > 0u && list_is_empty(&loop->due_lists[lane - 1u]))
+            lane--;
+        if (lane == 0u)
+            return NULL;
+        lane--;
+    }
+    loop->lane_waits[lane] = 0u;
+    for (uint32_t i = 0u; i < lane; i++) {
+        if (list_is_empty(&loop->due_lists[i])) {
+            loop->lane_waits[i] = 0u;
+        } else {
+            loop->lane_waits[i]++;
+        }
+    }
+    return node_to_task(list_remove_head(&loop->due_lists[lane]));
+}
+
+// Lets a high priority task that is due join the iteration of due tasks that
+// is being dispatched, until as many have joined as the starvation limit.
+// Returns false if the task must wait in the task heap instead.
+static bool async_loop_join_due_tasks_locked(async_loop_t* loop, async_task_t* task) {
+    if (!loop->dispatching_tasks || task_priority(task) != ASYNC_LOOP_PRIORITY_HIGH ||
+        loop->high_priority_joins >= loop->config.priority_starvation_limit)
+        return false;
+    loop->high_priority_joins++;
+    list_add_tail(&loop->due_lists[ASYNC_LOOP_PRIORITY_HIGH], task_to_node(task));
+    return true;
+}
+
 static void async_loop_dispatch_task(async_loop_t* loop,
                                      async_task_t* task,
                                      zx_status_t status) {
     // Invoke the handler.  Note that it might destroy itself.
-    async_loop_invoke_prologue(loop);
+    const void* handler = (const void*)task->handler;
+    TRACE_DURATION("async", "async::Task", "handler", handler);
+    async_handler_frame_t frame;
+    zx_time_t start = async_loop_invoke_prologue(loop, &frame, ASYNC_LOOP_HANDLER_TASK,
+                                                 handler, task);
+    if (start && loop->config.collect_stats && status == ZX_OK)
+        async_loop_record_max(&loop->max_task_lateness, &loop->task_lateness,
+                              start > task->deadline ? start - task->deadline : 0);
     task->handler((async_dispatcher_t*)loop, task, status);
-    async_loop_invoke_epilogue(loop);
+    async_loop_invoke_epilogue(loop, &frame, start, ASYNC_LOOP_HANDLER_TASK, handler);
 }
 
 static zx_status_t async_loop_dispatch_packet(async_loop_t* loop, async_receiver_t* receiver,
                                               zx_status_t status, const zx_packet_user_t* data) {
     // Invoke the handler.  Note that it might destroy itself.
-    async_loop_invoke_prologue(loop);
+    const void* handler = (const void*)receiver->handler;
+    TRACE_DURATION("async", "async::Receiver", "handler", handler);
+    async_handler_frame_t frame;
+    zx_time_t start = async_loop_invoke_prologue(loop, &frame, ASYNC_LOOP_HANDLER_PACKET,
+                                                 handler, receiver);
     receiver->handler((async_dispatcher_t*)loop, receiver, status, data);
-    async_loop_invoke_epilogue(loop);
+    async_loop_invoke_epilogue(loop, &frame, start, ASYNC_LOOP_HANDLER_PACKET, handler);
     return ZX_OK;
 }
 
@@ -413,9 +951,13 @@ static zx_status_t async_loop_dispatch_exception(async_loop_t* loop,
                                                  zx_status_t status,
                                                  const zx_port_packet_t* report) {
     // Invoke the handler.  Note that it might destroy itself.
-    async_loop_invoke_prologue(loop);
+    const void* handler = (const void*)exception->handler;
+    TRACE_DURATION("async", "async::Exception", "handler", handler);
+    async_handler_frame_t frame;
+    zx_time_t start = async_loop_invoke_prologue(loop, &frame, ASYNC_LOOP_HANDLER_EXCEPTION,
+                                                 handler, exception);
     exception->handler((async_dispatcher_t*)loop, exception, status, report);
-    async_loop_invoke_epilogue(loop);
+    async_loop_invoke_epilogue(loop, &frame, start, ASYNC_LOOP_HANDLER_EXCEPTION, handler);
     return ZX_OK;
 }
 
@@ -432,12 +974,15 @@ void async_loop_quit(async_loop_t* loop) {
 }
 
 static void async_loop_wake_threads(async_loop_t* loop) {
-    // Queue enough packets to awaken all active threads.
-    // This is safe because any new threads which join the pool first increment the
-    // active thread count then check the loop state, so the count we observe here
-    // cannot be less than the number of threads which might be blocked in |port_wait|.
-    // Issuing too many packets is also harmless.
-    uint32_t n = atomic_load_explicit(&loop->active_threads, memory_order_acquire);
+    // Queue enough packets to awaken the threads blocked in |port_wait|.
+    // Threads that are busy dispatching see the new state before they wait
+    // again, so they need no packet.  This is safe because a thread counts
+    // itself as idle before it checks the loop state for the last time, and
+    // the state has been changed before we read the count, so the count we
+    // observe here cannot be less than the number of threads which might
+    // block without noticing.  Issuing too many packets is harmless.
+    atomic_thread_fence(memory_order_seq_cst);
+    uint32_t n = atomic_load(&loop->idle_threads);
     for (uint32_t i = 0u; i < n; i++) {
         zx_port_packet_t packet = {
             .key = KEY_CONTROL,
@@ -478,12 +1023,61 @@ async_loop_state_t async_loop_get_state(async_loop_t* loop) {
     return atomic_load_explicit(&loop->state, memory_order_acquire);
 }
 
+zx_status_t async_loop_get_stats(async_loop_t* loop, async_loop_stats_t* out_stats) {
+    ZX_DEBUG_ASSERT(loop);
+    ZX_DEBUG_ASSERT(out_stats);
+
+    if (!loop->config.collect_stats)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    out_stats->packets_dispatched =
+        atomic_load_explicit(&loop->packets_dispatched, memory_order_relaxed);
+    out_stats->tasks_dispatched =
+        atomic_load_explicit(&loop->tasks_dispatched, memory_order_relaxed);
+    out_stats->handler_time = atomic_load_explicit(&loop->handler_time, memory_order_relaxed);
+    out_stats->max_handler_time =
+        atomic_load_explicit(&loop->max_handler_time, memory_order_relaxed);
+    out_stats->task_lateness = atomic_load_explicit(&loop->task_lateness, memory_order_relaxed);
+    out_stats->max_task_lateness =
+        atomic_load_explicit(&loop->max_task_lateness, memory_order_relaxed);
+
+    // The queues are counted rather than tracked so that keeping them up to
+    // date costs nothing.  Tasks posted since the loop last looked at its
+    // incoming queue are not counted.
+    mtx_lock(&loop->lock);
+    uint64_t pending_tasks = loop->task_count;
+    for (uint32_t i = 0u; i < PRIORITY_LANES; i++)
+        pending_tasks += list_length(&loop->due_lists[i]);
+    out_stats->pending_waits = list_length(&loop->wait_list);
+    mtx_unlock(&loop->lock);
+    uint32_t worker_count = atomic_load_explicit(&loop->worker_count, memory_order_acquire);
+    for (uint32_t i = 0u; i < worker_count; i++) {
+        async_loop_worker_t* worker = atomic_load_explicit(&loop->workers[i],
+                                                           memory_order_acquire);
+        mtx_lock(&worker->lock);
+        pending_tasks += worker->tail - worker->head;
+        mtx_unlock(&worker->lock);
+    }
+    out_stats->pending_tasks = pending_tasks;
+    return ZX_OK;
+}
+
+static void async_loop_record_max(_Atomic zx_duration_t* max, _Atomic zx_duration_t* total,
+                                  zx_duration_t value) {
+    atomic_fetch_add_explicit(total, value, memory_order_relaxed);
+    zx_duration_t prior = atomic_load_explicit(max, memory_order_relaxed);
+    while (value > prior &&
+           !atomic_compare_exchange_weak_explicit(max, &prior, value, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
 zx_time_t async_loop_now(async_dispatcher_t* dispatcher) {
     return zx_clock_get_monotonic();
 }
 
-static zx_status_t async_loop_begin_wait(async_dispatcher_t* async, async_wait_t* wait) {
-    async_loop_t* loop = (async_loop_t*)async;
+static zx_status_t async_loop_begin_wait_with_options(async_loop_t* loop, async_wait_t* wait,
+                                                      uint32_t options) {
     ZX_DEBUG_ASSERT(loop);
     ZX_DEBUG_ASSERT(wait);
 
@@ -493,7 +1087,7 @@ static zx_status_t async_loop_begin_wait(async_dispatcher_t* async, async_wait_t
     mtx_lock(&loop->lock);
 
     zx_status_t status = zx_object_wait_async(
-        wait->object, loop->port, (uintptr_t)wait, wait->trigger, ZX_WAIT_ASYNC_ONCE);
+        wait->object, loop->port, (uintptr_t)wait, wait->trigger, options);
     if (status == ZX_OK) {
         list_add_head(&loop->wait_list, wait_to_node(wait));
     } else {
@@ -505,6 +1099,16 @@ static zx_status_t async_loop_begin_wait(async_dispatcher_t* async, async_wait_t
     return status;
 }
 
+static zx_status_t async_loop_begin_wait(async_dispatcher_t* async, async_wait_t* wait) {
+    return async_loop_begin_wait_with_options((async_loop_t*)async, wait, ZX_WAIT_ASYNC_ONCE);
+}
+
+static zx_status_t async_loop_begin_repeating_wait(async_dispatcher_t* async,
+                                                   async_wait_t* wait) {
+    return async_loop_begin_wait_with_options((async_loop_t*)async, wait,
+                                              ZX_WAIT_ASYNC_REPEATING);
+}
+
 static zx_status_t async_loop_cancel_wait(async_dispatcher_t* async, async_wait_t* wait) {
     async_loop_t* loop = (async_loop_t*)async;
     ZX_DEBUG_ASSERT(loop);
@@ -515,49 +1119,125 @@ static zx_status_t async_loop_cancel_wait(async_dispatcher_t* async, async_wait_
     // invoked again past this point.
 
     mtx_lock(&loop->lock);
+    zx_status_t status = async_loop_cancel_wait_locked(loop, wait);
+    mtx_unlock(&loop->lock);
+    return status;
+}
 
-    // First, confirm that the wait is actually pending.
+static zx_status_t async_loop_cancel_waits(async_dispatcher_t* async,
+                                           async_wait_t* const* waits, size_t count,
+                                           size_t* out_canceled) {
+    async_loop_t* loop = (async_loop_t*)async;
+    ZX_DEBUG_ASSERT(loop);
+    ZX_DEBUG_ASSERT(waits || count == 0u);
+
+    // Take the lock once for the whole array, which is what makes tearing
+    // down many waits cheaper than canceling them one by one.
+    size_t canceled = 0u;
+    mtx_lock(&loop->lock);
+    for (size_t i = 0u; i < count; i++) {
+        if (async_loop_cancel_wait_locked(loop, waits[i]) == ZX_OK)
+            canceled++;
+    }
+    mtx_unlock(&loop->lock);
+
+    if (out_canceled)
+        *out_canceled = canceled;
+    return ZX_OK;
+}
+
+static zx_status_t async_loop_cancel_wait_locked(async_loop_t* loop, async_wait_t* wait) {
+    ZX_DEBUG_ASSERT(wait);
+
+    // First, handle a one-shot wait whose packet a batch has read.  It is no
+    // longer in the wait list but is pending until the batch dispatches it.
+    if (wait_batch(wait))
+        return async_loop_cancel_batched_wait_locked(loop, wait) ? ZX_OK : ZX_ERR_NOT_FOUND;
+
+    // Next, confirm that the wait is actually pending.
     list_node_t* node = wait_to_node(wait);
-    if (!list_in_list(node)) {
-        mtx_unlock(&loop->lock);
+    if (!list_in_list(node))
         return ZX_ERR_NOT_FOUND;
-    }
+
+    // A repeating wait stays in the wait list, so a batch may also hold
+    // packets for it.
+    bool batched = async_loop_void_batched_packets_locked(loop, (uintptr_t)wait);
 
     // Next, cancel the wait.  This may be racing with another thread that
     // has read the wait's packet but not yet dispatched it.  So if we fail
     // to cancel then we assume we lost the race.
     zx_status_t status = zx_port_cancel(loop->port, wait->object,
                                         (uintptr_t)wait);
-    if (status == ZX_OK) {
+    if (status == ZX_OK || batched) {
         list_delete(node);
+        status = ZX_OK;
     } else {
         ZX_ASSERT_MSG(status == ZX_ERR_NOT_FOUND,
                       "zx_port_cancel: status=%d", status);
     }
-
-    mtx_unlock(&loop->lock);
     return status;
 }
 
 static zx_status_t async_loop_post_task(async_dispatcher_t* async, async_task_t* task) {
-    async_loop_t* loop = (async_loop_t*)async;
+    return async_loop_post_task_with_priority((async_loop_t*)async, task,
+                                              ASYNC_LOOP_PRIORITY_DEFAULT);
+}
+
+zx_status_t async_loop_post_task_with_priority(async_loop_t* loop, async_task_t* task,
+                                               async_loop_priority_t priority) {
+    async_dispatcher_t* async = (async_dispatcher_t*)loop;
     ZX_DEBUG_ASSERT(loop);
     ZX_DEBUG_ASSERT(task);
 
+    if (priority > ASYNC_LOOP_PRIORITY_HIGH)
+        return ZX_ERR_INVALID_ARGS;
+
     if (atomic_load_explicit(&loop->state, memory_order_acquire) == ASYNC_LOOP_SHUTDOWN)
         return ZX_ERR_BAD_STATE;
 
+    task->state.reserved[1] = (uint64_t)priority << TASK_PRIORITY_SHIFT;
+
+    // Tasks that are already due, which is how most tasks are posted from
+    // other threads, skip the lock so that they do not contend with waits and
+    // timers.
+    const bool due = task->deadline <= async_loop_now(async);
+    if (due) {
+        // With work stealing, the loop's own threads keep the tasks they post
+        // in their own run queue.
+        // Only default priority tasks go there, since the run queues are
+        // drained in order.
+        async_loop_worker_t* worker = g_current_worker;
+        if (worker && worker->loop == loop && priority == ASYNC_LOOP_PRIORITY_DEFAULT &&
+            async_loop_push_local_task(worker, task))
+            return ZX_OK;
+        if (async_loop_claim_incoming_slot(loop)) {
+            async_loop_push_incoming_task(loop, task);
+            return ZX_OK;
+        }
+        // No slot is set aside for the task.  Post it under the lock, which
+        // also sets aside slots for the tasks posted after it.
+    }
+
     mtx_lock(&loop->lock);
 
-    async_loop_insert_task_locked(loop, task);
-    if (!loop->dispatching_tasks &&
-        task_to_node(task)->prev == &loop->task_list) {
-        // Task inserted at head.  Earliest deadline changed.
+    // Sequence the task after the due tasks that were posted before it.
+    async_loop_merge_incoming_tasks_locked(loop);
+    if (due && async_loop_join_due_tasks_locked(loop, task)) {
+        mtx_unlock(&loop->lock);
+        return ZX_OK;
+    }
+    zx_status_t status = async_loop_insert_task_locked(loop, task);
+    if (status == ZX_OK)
+        async_loop_refill_incoming_room_locked(loop);
+    if (status == ZX_OK && !loop->dispatching_tasks &&
+        (task_heap_index(task) == 0u || task_latest(task) < loop->timer_deadline)) {
+        // Task inserted at head, or it cannot wait as long as the timer was
+        // going to.  The wake-up time changed.
         async_loop_restart_timer_locked(loop);
     }
 
     mtx_unlock(&loop->lock);
-    return ZX_OK;
+    return status;
 }
 
 static zx_status_t async_loop_cancel_task(async_dispatcher_t* async, async_task_t* task) {
@@ -567,25 +1247,34 @@ static zx_status_t async_loop_cancel_task(async_dispatcher_t* async, async_task_
 
     // Note: We need to process cancelations even while the loop is being
     // destroyed in case the client is counting on the handler not being
-    // invoked again past this point.  Also, the task we're removing here
-    // might be present in the dispatcher's |due_list| if it is pending
-    // dispatch instead of in the loop's |task_list| as usual.  The same
-    // logic works in both cases.
+    // invoked again past this point.
 
     mtx_lock(&loop->lock);
-    list_node_t* node = task_to_node(task);
-    if (!list_in_list(node)) {
+    async_loop_merge_incoming_tasks_locked(loop);
+    size_t index = task_heap_index(task);
+    if (index == TASK_NOT_PENDING && task_in_due_list(task)) {
+        list_delete(task_to_node(task));
         mtx_unlock(&loop->lock);
-        return ZX_ERR_NOT_FOUND;
+        return ZX_OK;
+    }
+    if (index == TASK_NOT_PENDING) {
+        // The task may be in a thread's run queue.  Which one is read without
+        // that queue's lock and checked again once it is held.
+        uintptr_t tag = task->state.reserved[0];
+        bool canceled = (tag & TASK_TAG_MASK) == TASK_TAG_LOCAL &&
+                        async_loop_cancel_local_task(
+                            (async_loop_worker_t*)(tag & ~TASK_TAG_MASK), task);
+        mtx_unlock(&loop->lock);
+        return canceled ? ZX_OK : ZX_ERR_NOT_FOUND;
     }
 
     // Determine whether the head task was canceled and following task has
     // a later deadline.  If so, we will bump the timer along to that deadline.
+    async_loop_remove_task_locked(loop, index);
     bool must_restart = !loop->dispatching_tasks &&
-                        node->prev == &loop->task_list &&
-                        node->next != &loop->task_list &&
-                        node_to_task(node->next)->deadline > task->deadline;
-    list_delete(node);
+                        index == 0u &&
+                        loop->task_count > 0u &&
+                        loop->task_heap[0]->deadline > task->deadline;
     if (must_restart)
         async_loop_restart_timer_locked(loop);
 
@@ -611,6 +1300,41 @@ static zx_status_t async_loop_queue_packet(async_dispatcher_t* async, async_rece
     return zx_port_queue(loop->port, &packet);
 }
 
+static zx_status_t async_loop_queue_packets(async_dispatcher_t* async,
+                                            const async_packet_t* packets, size_t count,
+                                            size_t* out_queued) {
+    async_loop_t* loop = (async_loop_t*)async;
+    ZX_DEBUG_ASSERT(loop);
+    ZX_DEBUG_ASSERT(packets || count == 0u);
+
+    // The port takes one packet at a time, but the state only needs to be
+    // checked once, and the packet template is built once.
+    zx_status_t status = ZX_OK;
+    size_t queued = 0u;
+    if (atomic_load_explicit(&loop->state, memory_order_acquire) == ASYNC_LOOP_SHUTDOWN) {
+        status = ZX_ERR_BAD_STATE;
+    } else {
+        zx_port_packet_t packet = {
+            .type = ZX_PKT_TYPE_USER,
+            .status = ZX_OK};
+        for (; queued < count; queued++) {
+            ZX_DEBUG_ASSERT(packets[queued].receiver);
+            packet.key = (uintptr_t)packets[queued].receiver;
+            if (packets[queued].data) {
+                packet.user = *packets[queued].data;
+            } else {
+                memset(&packet.user, 0, sizeof(packet.user));
+            }
+            status = zx_port_queue(loop->port, &packet);
+            if (status != ZX_OK)
+                break;
+        }
+    }
+    if (out_queued)
+        *out_queued = queued;
+    return status;
+}
+
 static zx_status_t async_loop_set_guest_bell_trap(
     async_dispatcher_t* async, async_guest_bell_trap_t* trap,
     zx_handle_t guest, zx_vaddr_t addr, size_t length) {
@@ -681,6 +1405,7 @@ static zx_status_t async_loop_unbind_exception_port(async_dispatcher_t* async,
 
     if (status == ZX_OK) {
         list_delete(node);
+        async_loop_void_batched_packets_locked(loop, key);
     }
 
     mtx_unlock(&loop->lock);
@@ -701,52 +1426,418 @@ static zx_status_t async_loop_resume_from_exception(async_dispatcher_t* async,
     return zx_task_resume_from_exception(task, loop->port, options);
 }
 
-static void async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task) {
-    // TODO(ZX-976): We assume that tasks are inserted in quasi-monotonic order and
-    // that insertion into the task queue will typically take no more than a few steps.
-    // If this assumption proves false and the cost of insertion becomes a problem, we
-    // should consider using a more efficient representation for maintaining order.
-    list_node_t* node;
-    for (node = loop->task_list.prev; node != &loop->task_list; node = node->prev) {
-        if (task->deadline >= node_to_task(node)->deadline)
+static void async_loop_set_task_locked(async_loop_t* loop, size_t index, async_task_t* task) {
+    loop->task_heap[index] = task;
+    task->state.reserved[0] = ((uintptr_t)index << 1) | 1u;
+}
+
+static void async_loop_sift_up_locked(async_loop_t* loop, size_t index) {
+    async_task_t* task = loop->task_heap[index];
+    while (index > 0u) {
+        size_t parent = (index - 1u) / 2u;
+        if (!task_before(task, loop->task_heap[parent]))
             break;
+        async_loop_set_task_locked(loop, index, loop->task_heap[parent]);
+        index = parent;
     }
-    list_add_after(node, task_to_node(task));
+    async_loop_set_task_locked(loop, index, task);
+}
+
+static void async_loop_sift_down_locked(async_loop_t* loop, size_t index) {
+    async_task_t* task = loop->task_heap[index];
+    for (;;) {
+        size_t child = index * 2u + 1u;
+        if (child >= loop->task_count)
+            break;
+        if (child + 1u < loop->task_count &&
+            task_before(loop->task_heap[child + 1u], loop->task_heap[child]))
+            child++;
+        if (!task_before(loop->task_heap[child], task))
+            break;
+        async_loop_set_task_locked(loop, index, loop->task_heap[child]);
+        index = child;
+    }
+    async_loop_set_task_locked(loop, index, task);
+}
+
+static zx_status_t async_loop_grow_task_heap_locked(async_loop_t* loop) {
+    size_t capacity = loop->task_capacity ? loop->task_capacity * 2u : 16u;
+    async_task_t** heap = realloc(loop->task_heap, capacity * sizeof(async_task_t*));
+    if (!heap)
+        return ZX_ERR_NO_MEMORY;
+    loop->task_heap = heap;
+    loop->task_capacity = capacity;
+    return ZX_OK;
+}
+
+// Adds |task| to the task heap, which must have a free slot for it.
+static void async_loop_add_task_locked(async_loop_t* loop, async_task_t* task) {
+    ZX_DEBUG_ASSERT(loop->task_count < loop->task_capacity);
+    task->state.reserved[1] = (task->state.reserved[1] & ~TASK_SEQ_MASK) |
+                              (loop->next_task_seq++ & TASK_SEQ_MASK);
+    size_t index = loop->task_count++;
+    loop->task_heap[index] = task;
+    async_loop_sift_up_locked(loop, index);
+}
+
+static zx_status_t async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task) {
+    // Pending tasks are kept in a binary heap so that posting and canceling
+    // stay O(log n) even with thousands of outstanding timeouts.  The slots
+    // set aside for incoming tasks are not available here.
+    if (loop->task_count + loop->incoming_reserved >= loop->task_capacity) {
+        zx_status_t status = async_loop_grow_task_heap_locked(loop);
+        if (status != ZX_OK)
+            return status;
+    }
+    async_loop_add_task_locked(loop, task);
+    return ZX_OK;
+}
+
+static void async_loop_remove_task_locked(async_loop_t* loop, size_t index) {
+    async_task_t* task = loop->task_heap[index];
+    task->state.reserved[0] = 0u;
+    task->state.reserved[1] = 0u;
+    size_t last = --loop->task_count;
+    if (index == last)
+        return;
+    async_task_t* moved = loop->task_heap[last];
+    loop->task_heap[index] = moved;
+    if (index > 0u && task_before(moved, loop->task_heap[(index - 1u) / 2u])) {
+        async_loop_sift_up_locked(loop, index);
+    } else {
+        async_loop_sift_down_locked(loop, index);
+    }
+}
+
+static bool async_loop_claim_incoming_slot(async_loop_t* loop) {
+    size_t room = atomic_load_explicit(&loop->incoming_room, memory_order_relaxed);
+    while (room > 0u) {
+        if (atomic_compare_exchange_weak_explicit(&loop->incoming_room, &room, room - 1u,
+                                                  memory_order_relaxed, memory_order_relaxed))
+            return true;
+    }
+    return false;
+}
+
+// Sets aside the free slots of the task heap for incoming tasks, growing the
+// heap first if there are none.  Leaves the room empty if the heap cannot
+// grow, so that posters keep taking the lock and see the failure.
+static void async_loop_refill_incoming_room_locked(async_loop_t* loop) {
+    if (loop->task_count + loop->incoming_reserved >= loop->task_capacity &&
+        async_loop_grow_task_heap_locked(loop) != ZX_OK)
+        return;
+    size_t room = loop->task_capacity - loop->task_count - loop->incoming_reserved;
+    loop->incoming_reserved += room;
+    atomic_fetch_add_explicit(&loop->incoming_room, room, memory_order_relaxed);
+}
+
+static void async_loop_push_incoming_task(async_loop_t* loop, async_task_t* task) {
+    async_task_t* head = atomic_load_explicit(&loop->incoming_tasks, memory_order_relaxed);
+    do {
+        task->state.reserved[0] = (uintptr_t)head | TASK_TAG_INCOMING;
+    } while (!atomic_compare_exchange_weak_explicit(&loop->incoming_tasks, &head, task,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+
+    // Only the task that makes the queue non-empty needs to wake the loop.
+    // Whoever empties the queue holds |lock| and dispatches or reschedules
+    // every task it took.
+    if (head == NULL) {
+        zx_port_packet_t packet = {
+            .key = KEY_CONTROL,
+            .type = ZX_PKT_TYPE_USER,
+            .status = ZX_OK,
+            .user.u64[0] = CONTROL_TASKS_QUEUED};
+        zx_status_t status = zx_port_queue(loop->port, &packet);
+        ZX_ASSERT_MSG(status == ZX_OK, "zx_port_queue: status=%d", status);
+    }
+}
+
+static void async_loop_merge_incoming_tasks_locked(async_loop_t* loop) {
+    async_task_t* task = atomic_exchange_explicit(&loop->incoming_tasks, NULL,
+                                                  memory_order_acquire);
+    if (!task)
+        return;
+
+    // The queue is most recent first.  Reverse it so that tasks are sequenced
+    // in the order they were posted.
+    async_task_t* fifo = NULL;
+    while (task) {
+        async_task_t* next = (async_task_t*)(task->state.reserved[0] & ~TASK_TAG_INCOMING);
+        task->state.reserved[0] = (uintptr_t)fifo;
+        fifo = task;
+        task = next;
+    }
+    // Each task was posted into a slot set aside for it, so none of this
+    // allocates.
+    while (fifo) {
+        async_task_t* next = (async_task_t*)fifo->state.reserved[0];
+        fifo->state.reserved[0] = 0u;
+        ZX_DEBUG_ASSERT(loop->incoming_reserved > 0u);
+        loop->incoming_reserved--;
+        // Tasks in the queue were due when they were posted.
+        if (!async_loop_join_due_tasks_locked(loop, fifo))
+            async_loop_add_task_locked(loop, fifo);
+        fifo = next;
+    }
+}
+
+static async_loop_worker_t* async_loop_claim_worker(async_loop_t* loop) {
+    // Reuse the queue of a thread that has exited, if there is one, so that
+    // restarting threads does not use up the slots.
+    uint32_t count = atomic_load_explicit(&loop->worker_count, memory_order_acquire);
+    for (uint32_t i = 0u; i < count; i++) {
+        async_loop_worker_t* worker = atomic_load_explicit(&loop->workers[i],
+                                                           memory_order_acquire);
+        bool expected = false;
+        if (worker && atomic_compare_exchange_strong(&worker->owned, &expected, true))
+            return worker;
+    }
+
+    async_loop_worker_t* worker = calloc(1u, sizeof(async_loop_worker_t));
+    if (!worker)
+        return NULL;
+    worker->loop = loop;
+    mtx_init(&worker->lock, mtx_plain);
+    atomic_init(&worker->owned, true);
+
+    mtx_lock(&loop->lock);
+    uint32_t index = atomic_load_explicit(&loop->worker_count, memory_order_relaxed);
+    if (index < ASYNC_LOOP_MAX_WORKERS) {
+        worker->index = index;
+        atomic_store_explicit(&loop->workers[index], worker, memory_order_release);
+        atomic_store_explicit(&loop->worker_count, index + 1u, memory_order_release);
+    }
+    mtx_unlock(&loop->lock);
+
+    if (index >= ASYNC_LOOP_MAX_WORKERS) {
+        // This thread takes its tasks from the shared queues like any other.
+        mtx_destroy(&worker->lock);
+        free(worker);
+        return NULL;
+    }
+    return worker;
+}
+
+static bool async_loop_push_local_task(async_loop_worker_t* worker, async_task_t* task) {
+    mtx_lock(&worker->lock);
+    uint64_t backlog = worker->tail - worker->head;
+    if (backlog == WORKER_QUEUE_CAPACITY) {
+        mtx_unlock(&worker->lock);
+        return false;
+    }
+    worker->queue[worker->tail % WORKER_QUEUE_CAPACITY] = task;
+    task->state.reserved[0] = (uintptr_t)worker | TASK_TAG_LOCAL;
+    task->state.reserved[1] = worker->tail;
+    worker->tail++;
+    mtx_unlock(&worker->lock);
+
+    // The owner will get to this task once it is done with the current one.
+    // If it already had a backlog, let one idle thread come and help; it
+    // goes on to steal as long as there is work left.
+    if (backlog > 0u &&
+        atomic_load_explicit(&worker->loop->idle_threads, memory_order_relaxed) > 0u &&
+        !atomic_exchange_explicit(&worker->loop->steal_wake_pending, true,
+                                  memory_order_acq_rel)) {
+        zx_port_packet_t packet = {
+            .key = KEY_CONTROL,
+            .type = ZX_PKT_TYPE_USER,
+            .status = ZX_OK,
+            .user.u64[0] = CONTROL_STEAL};
+        zx_status_t status = zx_port_queue(worker->loop->port, &packet);
+        ZX_ASSERT_MSG(status == ZX_OK, "zx_port_queue: status=%d", status);
+    }
+    return true;
+}
+
+static async_task_t* async_loop_pop_local_task(async_loop_worker_t* worker) {
+    async_task_t* task = NULL;
+    mtx_lock(&worker->lock);
+    while (!task && worker->head != worker->tail) {
+        // Canceled tasks leave a hole behind.
+        task = worker->queue[worker->head % WORKER_QUEUE_CAPACITY];
+        worker->head++;
+    }
+    if (task) {
+        task->state.reserved[0] = 0u;
+        task->state.reserved[1] = 0u;
+    }
+    mtx_unlock(&worker->lock);
+    return task;
+}
+
+static bool async_loop_cancel_local_task(async_loop_worker_t* worker, async_task_t* task) {
+    bool canceled = false;
+    mtx_lock(&worker->lock);
+    // The task may have been taken by a thread in the meantime.
+    uint64_t position = task->state.reserved[1];
+    if ((task->state.reserved[0] & TASK_TAG_MASK) == TASK_TAG_LOCAL &&
+        position - worker->head < worker->tail - worker->head &&
+        worker->queue[position % WORKER_QUEUE_CAPACITY] == task) {
+        worker->queue[position % WORKER_QUEUE_CAPACITY] = NULL;
+        task->state.reserved[0] = 0u;
+        task->state.reserved[1] = 0u;
+        canceled = true;
+    }
+    mtx_unlock(&worker->lock);
+    return canceled;
+}
+
+// Takes a task from |worker|'s queue, or from another queue if it is empty.
+// |worker| is NULL for threads that have no queue of their own.
+static async_task_t* async_loop_take_local_task(async_loop_t* loop, async_loop_worker_t* worker) {
+    async_task_t* task;
+    if (worker && (task = async_loop_pop_local_task(worker)))
+        return task;
+
+    // Steal the oldest task of another thread, starting with the next one so
+    // that thieves spread out.
+    uint32_t count = atomic_load_explicit(&loop->worker_count, memory_order_acquire);
+    uint32_t first = worker ? worker->index + 1u : 0u;
+    for (uint32_t i = 0u; i < count; i++) {
+        if (worker && i == count - 1u)
+            break; // Back at |worker|'s own queue.
+        async_loop_worker_t* victim = atomic_load_explicit(
+            &loop->workers[(first + i) % count], memory_order_acquire);
+        if (victim && (task = async_loop_pop_local_task(victim)))
+            return task;
+    }
+    return NULL;
+}
+
+// Returns the latest time the timer can fire without running any task later
+// than its slack allows.
+static zx_time_t async_loop_coalesce_deadline_locked(async_loop_t* loop) {
+    // Only the tasks due before the wake-up matter, and in a heap every task's
+    // ancestors are due no later than it is, so the search stops at the first
+    // task of each subtree that is due after the wake-up.  If it would take
+    // too long, give up on coalescing.
+    async_task_t* head = loop->task_heap[0];
+    zx_time_t fire = task_latest(head);
+    if (fire == head->deadline)
+        return fire;
+    size_t stack[TIMER_COALESCE_MAX_TASKS];
+    size_t depth = 0u;
+    size_t examined = 0u;
+    stack[depth++] = 0u;
+    while (depth > 0u) {
+        size_t index = stack[--depth];
+        async_task_t* task = loop->task_heap[index];
+        if (task->deadline > fire)
+            continue;
+        if (++examined > TIMER_COALESCE_MAX_TASKS)
+            return head->deadline;
+        zx_time_t latest = task_latest(task);
+        if (latest < fire)
+            fire = latest;
+        for (size_t child = index * 2u + 1u; child <= index * 2u + 2u; child++) {
+            if (child >= loop->task_count)
+                break;
+            if (depth == TIMER_COALESCE_MAX_TASKS)
+                return head->deadline;
+            stack[depth++] = child;
+        }
+    }
+    return fire;
 }
 
 static void async_loop_restart_timer_locked(async_loop_t* loop) {
-    zx_time_t deadline;
-    if (list_is_empty(&loop->due_list)) {
-        list_node_t* head = list_peek_head(&loop->task_list);
-        if (!head)
-            return;
-        async_task_t* task = node_to_task(head);
-        deadline = task->deadline;
-        if (deadline == ZX_TIME_INFINITE)
+    loop->timer_deadline = ZX_TIME_INFINITE;
+    for (uint32_t i = 0u; i < PRIORITY_LANES; i++) {
+        if (!list_is_empty(&loop->due_lists[i])) {
+            // Tasks were left behind by an interrupted iteration.  Fire now.
+            loop->timer_deadline = 0;
+            zx_status_t status = zx_timer_set(loop->timer, 0, 0);
+            ZX_ASSERT_MSG(status == ZX_OK, "zx_timer_set: status=%d", status);
             return;
-    } else {
-        // Fire now.
-        deadline = 0ULL;
+        }
     }
+    if (loop->task_count == 0u)
+        return;
+
+    // If the earliest task is already due, the timer fires right away.
+    zx_time_t deadline = loop->task_heap[0]->deadline;
+    if (deadline == ZX_TIME_INFINITE)
+        return;
 
-    zx_status_t status = zx_timer_set(loop->timer, deadline, 0);
+    // Tasks with slack let the timer fire as late as the least patient of
+    // them allows, so that nearby deadlines are served by one wake-up.  The
+    // timer uses early slack, so the kernel may also fire it sooner, though
+    // never before the earliest deadline, to coalesce it with other timers.
+    zx_time_t fire = async_loop_coalesce_deadline_locked(loop);
+    loop->timer_deadline = fire;
+    zx_status_t status = zx_timer_set(loop->timer, fire, fire - deadline);
     ZX_ASSERT_MSG(status == ZX_OK, "zx_timer_set: status=%d", status);
 }
 
-static void async_loop_invoke_prologue(async_loop_t* loop) {
+static async_handler_kind_t async_loop_handler_kind(async_loop_handler_type_t type) {
+    switch (type) {
+    case ASYNC_LOOP_HANDLER_WAIT:
+        return ASYNC_HANDLER_KIND_WAIT;
+    case ASYNC_LOOP_HANDLER_TASK:
+        return ASYNC_HANDLER_KIND_TASK;
+    case ASYNC_LOOP_HANDLER_PACKET:
+        return ASYNC_HANDLER_KIND_RECEIVER;
+    case ASYNC_LOOP_HANDLER_GUEST_BELL_TRAP:
+        return ASYNC_HANDLER_KIND_GUEST_BELL_TRAP;
+    default:
+        return ASYNC_HANDLER_KIND_EXCEPTION;
+    }
+}
+
+// Returns the time the handler is invoked at, or zero if neither statistics
+// nor the slow handler callback need it.
+static zx_time_t async_loop_invoke_prologue(async_loop_t* loop, async_handler_frame_t* frame,
+                                            async_loop_handler_type_t type, const void* handler,
+                                            const void* object) {
     if (loop->config.prologue)
         loop->config.prologue(loop, loop->config.data);
+    // Publish the handler for sampling profilers, see <lib/async/sampling.h>.
+    async_push_handler_frame(frame, async_loop_handler_kind(type), handler, object);
+    if (!loop->config.collect_stats && !loop->config.slow_handler)
+        return 0;
+    return zx_clock_get_monotonic();
 }
 
-static void async_loop_invoke_epilogue(async_loop_t* loop) {
+static void async_loop_invoke_epilogue(async_loop_t* loop, const async_handler_frame_t* frame,
+                                       zx_time_t start,
+                                       async_loop_handler_type_t type, const void* handler) {
+    async_pop_handler_frame(frame);
+    if (start) {
+        zx_duration_t duration = zx_clock_get_monotonic() - start;
+        if (loop->config.collect_stats) {
+            async_loop_record_max(&loop->max_handler_time, &loop->handler_time, duration);
+            atomic_fetch_add_explicit(type == ASYNC_LOOP_HANDLER_TASK ? &loop->tasks_dispatched
+                                                                      : &loop->packets_dispatched,
+                                      1u, memory_order_relaxed);
+        }
+        if (loop->config.slow_handler && duration >= loop->config.slow_handler_threshold) {
+            loop->config.slow_handler(loop, loop->config.data, type, handler, duration);
+        }
+    }
     if (loop->config.epilogue)
         loop->config.epilogue(loop, loop->config.data);
 }
 
 static int async_loop_run_thread(void* data) {
-    async_loop_t* loop = (async_loop_t*)data;
+    thread_record_t* rec = (thread_record_t*)data;
+    async_loop_t* loop = rec->loop;
+    if (loop->config.thread_profile != ZX_HANDLE_INVALID) {
+        sync_completion_wait(&rec->profile_applied, ZX_TIME_INFINITE);
+        if (rec->profile_status != ZX_OK)
+            return 0;
+    }
     async_set_default_dispatcher(&loop->dispatcher);
+    if (loop->config.work_stealing)
+        g_current_worker = async_loop_claim_worker(loop);
     async_loop_run(loop, ZX_TIME_INFINITE, false);
+    if (g_current_worker) {
+        // Whatever is left in the queue can still be stolen, by the other
+        // threads or by any thread that runs the loop later, and the queue
+        // goes to the next thread that starts.
+        atomic_store_explicit(&g_current_worker->owned, false, memory_order_release);
+        g_current_worker = NULL;
+    }
     return 0;
 }
 
@@ -763,11 +1854,25 @@ zx_status_t async_loop_start_thread(async_loop_t* loop, const char* name, thrd_t
     if (!rec)
         return ZX_ERR_NO_MEMORY;
 
-    if (thrd_create_with_name(&rec->thread, async_loop_run_thread, loop, name) != thrd_success) {
+    rec->loop = loop;
+    if (thrd_create_with_name(&rec->thread, async_loop_run_thread, rec, name) != thrd_success) {
         free(rec);
         return ZX_ERR_NO_MEMORY;
     }
 
+    if (loop->config.thread_profile != ZX_HANDLE_INVALID) {
+        zx_status_t status = zx_object_set_profile(thrd_get_zx_handle(rec->thread),
+                                                   loop->config.thread_profile, 0u);
+        rec->profile_status = status;
+        sync_completion_signal(&rec->profile_applied);
+        if (status != ZX_OK) {
+            // The thread returns without running the loop.
+            thrd_join(rec->thread, NULL);
+            free(rec);
+            return status;
+        }
+    }
+
     mtx_lock(&loop->lock);
     list_add_tail(&loop->thread_list, &rec->node);
     mtx_unlock(&loop->lock);
@@ -787,10 +1892,10 @@ void async_loop_join_threads(async_loop_t* loop) {
             break;
 
         mtx_unlock(&loop->lock);
-        thrd_t thread = rec->thread;
-        free(rec);
-        int result = thrd_join(thread, NULL);
+        // The thread may still be reading its record as it starts.
+        int result = thrd_join(rec->thread, NULL);
         ZX_DEBUG_ASSERT(result == thrd_success);
+        free(rec);
         mtx_lock(&loop->lock);
     }
     mtx_unlock(&loop->lock);
@@ -99,6 +99,16 @@ public:
     // Returns the current state of the message loop.
     async_loop_state_t GetState() const;
 
+    // Gets the current statistics of the message loop.
+    //
+    // See |async_loop_get_stats()| for details.
+    zx_status_t GetStats(async_loop_stats_t* out_stats) const;
+
+    // Posts a task to the message loop with the given |priority|.
+    //
+    // See |async_loop_post_task_with_priority()| for details.
+    zx_status_t PostTaskWithPriority(async_task_t* task, async_loop_priority_t priority);
+
     // Starts a message loop running on a new thread.
     // The thread will run until the loop quits.
     //
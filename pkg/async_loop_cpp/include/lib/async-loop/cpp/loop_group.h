@@ -0,0 +1,113 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <lib/async-loop/cpp/loop.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace async {
+
+// A group of message loops, each run by a thread of its own, among which
+// work is spread.
+//
+// A single loop run by several threads shares one port and one lock among
+// them, and hands the events of one channel to whichever thread is free, so
+// a connection's state bounces between cores.  A group instead gives each
+// thread a loop of its own: work placed on a loop, such as a connection
+// bound with |AddBinding()|, stays on that loop's thread.
+//
+// The kernel does not yet let threads be pinned to a core, so the group
+// only makes one loop per core and lets the scheduler spread their threads.
+//
+// This class is thread-safe, except for destruction.
+class LoopGroup {
+public:
+    // How |Pick()| chooses a loop.
+    enum class Policy {
+        // Each loop in turn.  Costs one atomic increment.
+        kRoundRobin,
+        // The loop with the fewest pending tasks and waits.  Reads the
+        // statistics of every loop, so suits placing long-lived work such as
+        // connections rather than posting individual tasks.
+        kLeastLoaded,
+    };
+
+    // Creates |count| loops, or one per CPU if |count| is zero.  None is
+    // attached to the current thread.
+    explicit LoopGroup(size_t count = 0u, Policy policy = Policy::kRoundRobin);
+
+    LoopGroup(const LoopGroup&) = delete;
+    LoopGroup(LoopGroup&&) = delete;
+    LoopGroup& operator=(const LoopGroup&) = delete;
+    LoopGroup& operator=(LoopGroup&&) = delete;
+
+    // Destroys the loops.
+    // Implicitly calls |Shutdown()|.
+    ~LoopGroup();
+
+    // Gets the number of loops in the group.
+    size_t size() const { return loops_.size(); }
+
+    // Gets the loop at |index|, which must be less than |size()|.
+    Loop& loop(size_t index) const { return *loops_[index]; }
+
+    // Gets the dispatcher of the loop at |index|.
+    async_dispatcher_t* dispatcher(size_t index) const { return loops_[index]->dispatcher(); }
+
+    // Starts one thread running each loop.
+    //
+    // |name| is the prefix of the threads' names, which are suffixed with
+    // the index of their loop.  May be NULL.
+    //
+    // Returns |ZX_OK| on success, or the error of the first thread that
+    // failed to start, in which case the threads already started keep
+    // running.
+    zx_status_t StartThreads(const char* name = nullptr);
+
+    // Quits every loop.
+    //
+    // See |Loop::Quit()| for details.
+    void Quit();
+
+    // Blocks until the threads started with |StartThreads()| have
+    // terminated.
+    void JoinThreads();
+
+    // Shuts down every loop, joining the threads started with
+    // |StartThreads()|.
+    //
+    // See |Loop::Shutdown()| for details.
+    void Shutdown();
+
+    // Chooses a loop according to the group's policy and returns its index.
+    size_t PickIndex();
+
+    // Chooses a loop according to the group's policy and returns its
+    // dispatcher.
+    async_dispatcher_t* Pick() { return dispatcher(PickIndex()); }
+
+    // Binds |request| to |impl| on the loop that |Pick()| chooses.
+    //
+    // |bindings| is any set of bindings taking a dispatcher per binding, such
+    // as |fidl::ThreadSafeBindingSet| or |fidl::ShardedThreadSafeBindingSet|,
+    // which must be safe to add to from the calling thread.  Its binding then
+    // dispatches the connection's messages on that loop's thread only.
+    template <typename BindingSet, typename ImplPtr, typename Request>
+    void AddBinding(BindingSet* bindings, ImplPtr&& impl, Request request) {
+        bindings->AddBinding(std::forward<ImplPtr>(impl), std::move(request), Pick());
+    }
+
+private:
+    const Policy policy_;
+    std::vector<std::unique_ptr<Loop>> loops_;
+    std::atomic<size_t> next_{0u};
+};
+
+} // namespace async
@@ -0,0 +1,88 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/async-loop/cpp/loop_group.h>
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+namespace async {
+
+LoopGroup::LoopGroup(size_t count, Policy policy)
+    : policy_(policy) {
+    if (count == 0u)
+        count = zx_system_get_num_cpus();
+    ZX_DEBUG_ASSERT(count > 0u);
+
+    async_loop_config_t config = kAsyncLoopConfigNoAttachToThread;
+    // Only the least-loaded policy reads the statistics, so the others don't
+    // pay for keeping them.
+    config.collect_stats = policy_ == Policy::kLeastLoaded;
+
+    loops_.reserve(count);
+    for (size_t i = 0u; i < count; i++)
+        loops_.push_back(std::make_unique<Loop>(&config));
+}
+
+LoopGroup::~LoopGroup() {
+    Shutdown();
+}
+
+zx_status_t LoopGroup::StartThreads(const char* name) {
+    for (size_t i = 0u; i < loops_.size(); i++) {
+        // Thread names are truncated to |ZX_MAX_NAME_LEN| by the kernel.
+        char thread_name[ZX_MAX_NAME_LEN];
+        if (name)
+            snprintf(thread_name, sizeof(thread_name), "%s-%zu", name, i);
+        zx_status_t status = loops_[i]->StartThread(name ? thread_name : nullptr);
+        if (status != ZX_OK)
+            return status;
+    }
+    return ZX_OK;
+}
+
+void LoopGroup::Quit() {
+    for (auto& loop : loops_)
+        loop->Quit();
+}
+
+void LoopGroup::JoinThreads() {
+    for (auto& loop : loops_)
+        loop->JoinThreads();
+}
+
+void LoopGroup::Shutdown() {
+    for (auto& loop : loops_)
+        loop->Shutdown();
+}
+
+size_t LoopGroup::PickIndex() {
+    // Start each scan where the last one left off, so that ties are broken
+    // in turn rather than always in favor of the first loop.
+    size_t start = next_.fetch_add(1u, std::memory_order_relaxed) % loops_.size();
+    if (policy_ == Policy::kRoundRobin)
+        return start;
+
+    size_t best = start;
+    uint64_t best_load = UINT64_MAX;
+    for (size_t n = 0u; n < loops_.size(); n++) {
+        size_t i = (start + n) % loops_.size();
+        async_loop_stats_t stats;
+        if (loops_[i]->GetStats(&stats) != ZX_OK)
+            continue;
+        uint64_t load = stats.pending_tasks + stats.pending_waits;
+        if (load < best_load) {
+            best = i;
+            best_load = load;
+            if (load == 0u)
+                break;
+        }
+    }
+    return best;
+}
+
+} // namespace async
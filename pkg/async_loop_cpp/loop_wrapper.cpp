@@ -41,6 +41,14 @@ async_loop_state_t Loop::GetState() const {
     return async_loop_get_state(loop_);
 }
 
+zx_status_t Loop::GetStats(async_loop_stats_t* out_stats) const {
+    return async_loop_get_stats(loop_, out_stats);
+}
+
+zx_status_t Loop::PostTaskWithPriority(async_task_t* task, async_loop_priority_t priority) {
+    return async_loop_post_task_with_priority(loop_, task, priority);
+}
+
 zx_status_t Loop::StartThread(const char* name, thrd_t* out_thread) {
     return async_loop_start_thread(loop_, name, out_thread);
 }
@@ -0,0 +1,138 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <lib/async/dispatcher.h>
+#include <lib/zx/port.h>
+#include <lib/zx/time.h>
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <utility>
+
+namespace async {
+
+// A dispatcher with virtual time for tests and benchmarks that must not depend
+// on the scheduler or the clock.
+//
+// Time only moves when |RunUntil()| or |RunFor()| moves it, and then instantly,
+// so code that waits for a timeout of an hour runs as fast as code that does
+// not wait at all.  Work is always dispatched in the same order: queued
+// packets in the order they were queued, then signaled waits in the order the
+// kernel reported them, then due tasks by deadline and then in posting order.
+// Nothing runs except from within the |Run*()| methods.
+//
+// Waits are real waits on kernel objects, checked without blocking each time
+// the dispatcher looks for work.  Guest bell traps and exceptions are not
+// supported.
+//
+// This class is not thread-safe: it must only be used on the thread that
+// runs it.
+class TestDispatcher : public async_dispatcher_t {
+public:
+    // The number of handlers of each kind the dispatcher has invoked,
+    // including those invoked with |ZX_ERR_CANCELED|.
+    struct Stats {
+        uint64_t tasks_dispatched = 0u;
+        uint64_t waits_dispatched = 0u;
+        uint64_t packets_dispatched = 0u;
+    };
+
+    // Creates a dispatcher whose virtual time starts at zero.
+    TestDispatcher();
+
+    TestDispatcher(const TestDispatcher&) = delete;
+    TestDispatcher(TestDispatcher&&) = delete;
+    TestDispatcher& operator=(const TestDispatcher&) = delete;
+    TestDispatcher& operator=(TestDispatcher&&) = delete;
+
+    // Implicitly calls |Shutdown()|.
+    ~TestDispatcher();
+
+    // Gets the asynchronous dispatch interface.
+    async_dispatcher_t* dispatcher() { return this; }
+
+    // The current virtual time.
+    zx::time Now() const { return now_; }
+
+    // The handlers invoked so far.
+    const Stats& stats() const { return stats_; }
+
+    // Forgets the handlers invoked so far.
+    void ResetStats() { stats_ = Stats(); }
+
+    // Dispatches work until there is nothing left that can run without
+    // advancing time.
+    //
+    // Returns true if any handler was invoked.
+    bool RunUntilIdle();
+
+    // Dispatches work while advancing time to |deadline|, jumping straight
+    // from one task deadline to the next.  Time is left at |deadline|, or
+    // unchanged if it is in the past.
+    //
+    // Returns true if any handler was invoked.
+    bool RunUntil(zx::time deadline);
+
+    // Same as |RunUntil(Now() + duration)|.
+    bool RunFor(zx::duration duration) { return RunUntil(now_ + duration); }
+
+    // Invokes the handlers of all pending waits and then of all pending tasks
+    // with |ZX_ERR_CANCELED|, each in the order they were begun or posted, and
+    // drops queued packets.  From then on, new work is refused with
+    // |ZX_ERR_BAD_STATE|.
+    //
+    // Does nothing if already shut down.
+    void Shutdown();
+
+private:
+    static zx_time_t Now(async_dispatcher_t* dispatcher);
+    static zx_status_t BeginWait(async_dispatcher_t* dispatcher, async_wait_t* wait);
+    static zx_status_t BeginRepeatingWait(async_dispatcher_t* dispatcher, async_wait_t* wait);
+    static zx_status_t CancelWait(async_dispatcher_t* dispatcher, async_wait_t* wait);
+    static zx_status_t PostTask(async_dispatcher_t* dispatcher, async_task_t* task);
+    static zx_status_t CancelTask(async_dispatcher_t* dispatcher, async_task_t* task);
+    static zx_status_t QueuePacket(async_dispatcher_t* dispatcher, async_receiver_t* receiver,
+                                   const zx_packet_user_t* data);
+    static zx_status_t QueuePackets(async_dispatcher_t* dispatcher,
+                                    const async_packet_t* packets, size_t count,
+                                    size_t* out_queued);
+    static zx_status_t SetGuestBellTrap(async_dispatcher_t* dispatcher,
+                                        async_guest_bell_trap_t* trap, zx_handle_t guest,
+                                        zx_vaddr_t addr, size_t length);
+    static zx_status_t BindExceptionPort(async_dispatcher_t* dispatcher,
+                                         async_exception_t* exception);
+    static zx_status_t UnbindExceptionPort(async_dispatcher_t* dispatcher,
+                                           async_exception_t* exception);
+    static zx_status_t ResumeFromException(async_dispatcher_t* dispatcher,
+                                           async_exception_t* exception, zx_handle_t task,
+                                           uint32_t options);
+
+    static const async_ops_t kOps;
+
+    zx_status_t BeginWaitWithOptions(async_wait_t* wait, uint32_t options);
+
+    // Each dispatches the next piece of work of its kind, if there is one.
+    // Returns true if a handler was invoked.
+    bool DispatchNextPacket();
+    bool DispatchNextWait();
+    bool DispatchNextTask();
+
+    zx::time now_;
+    bool shutdown_ = false;
+    Stats stats_;
+    zx::port port_;
+
+    // Every pending task and wait records its sequence number, which is never
+    // zero, in its |state|.  Tasks are ordered by deadline and then by
+    // sequence number, and waits by sequence number.
+    uint64_t next_seq_ = 1u;
+    std::map<std::pair<zx_time_t, uint64_t>, async_task_t*> tasks_;
+    std::map<uint64_t, async_wait_t*> waits_;
+    std::deque<std::pair<async_receiver_t*, zx_packet_user_t>> packets_;
+};
+
+} // namespace async
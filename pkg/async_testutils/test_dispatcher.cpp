@@ -0,0 +1,262 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/async-testutils/test_dispatcher.h>
+
+#include <lib/async/receiver.h>
+#include <lib/async/task.h>
+#include <lib/async/wait.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+namespace async {
+namespace {
+
+// A wait records its sequence number in |reserved[0]| and whether it repeats
+// in |reserved[1]|.  A task records its sequence number in |reserved[0]|.
+constexpr uintptr_t kRepeating = 1u;
+
+} // namespace
+
+const async_ops_t TestDispatcher::kOps = {
+    .version = ASYNC_OPS_V4,
+    .reserved = 0,
+    .v1 = {
+        .now = &TestDispatcher::Now,
+        .begin_wait = &TestDispatcher::BeginWait,
+        .cancel_wait = &TestDispatcher::CancelWait,
+        .post_task = &TestDispatcher::PostTask,
+        .cancel_task = &TestDispatcher::CancelTask,
+        .queue_packet = &TestDispatcher::QueuePacket,
+        .set_guest_bell_trap = &TestDispatcher::SetGuestBellTrap,
+    },
+    .v2 = {
+        .bind_exception_port = &TestDispatcher::BindExceptionPort,
+        .unbind_exception_port = &TestDispatcher::UnbindExceptionPort,
+        .resume_from_exception = &TestDispatcher::ResumeFromException,
+    },
+    .v3 = {
+        .begin_repeating_wait = &TestDispatcher::BeginRepeatingWait,
+    },
+    .v4 = {
+        .queue_packets = &TestDispatcher::QueuePackets,
+    },
+    // Not supported: |async_cancel_waits()| cancels the waits one at a time.
+    .v5 = {},
+};
+
+TestDispatcher::TestDispatcher()
+    : async_dispatcher_t{&kOps} {
+    zx_status_t status = zx::port::create(0u, &port_);
+    ZX_ASSERT_MSG(status == ZX_OK, "status=%d", status);
+}
+
+TestDispatcher::~TestDispatcher() {
+    Shutdown();
+}
+
+bool TestDispatcher::RunUntilIdle() {
+    bool did_work = false;
+    while (DispatchNextPacket() || DispatchNextWait() || DispatchNextTask())
+        did_work = true;
+    return did_work;
+}
+
+bool TestDispatcher::RunUntil(zx::time deadline) {
+    bool did_work = RunUntilIdle();
+    while (!tasks_.empty() && tasks_.begin()->first.first <= deadline.get()) {
+        // Jump to the next deadline.  A task might be due already if it was
+        // posted in the past by a handler of the last iteration.
+        if (tasks_.begin()->first.first > now_.get())
+            now_ = zx::time(tasks_.begin()->first.first);
+        did_work |= RunUntilIdle();
+    }
+    if (deadline > now_) {
+        now_ = deadline;
+        did_work |= RunUntilIdle();
+    }
+    return did_work;
+}
+
+void TestDispatcher::Shutdown() {
+    if (shutdown_)
+        return;
+    shutdown_ = true;
+
+    // Handlers invoked from here on might cancel other work, so fetch one at
+    // a time.
+    while (!waits_.empty()) {
+        async_wait_t* wait = waits_.begin()->second;
+        zx_port_cancel(port_.get(), wait->object, waits_.begin()->first);
+        waits_.erase(waits_.begin());
+        wait->state = ASYNC_STATE_INIT;
+        stats_.waits_dispatched++;
+        wait->handler(this, wait, ZX_ERR_CANCELED, nullptr);
+    }
+    while (!tasks_.empty()) {
+        async_task_t* task = tasks_.begin()->second;
+        tasks_.erase(tasks_.begin());
+        task->state = ASYNC_STATE_INIT;
+        stats_.tasks_dispatched++;
+        task->handler(this, task, ZX_ERR_CANCELED);
+    }
+    packets_.clear();
+}
+
+bool TestDispatcher::DispatchNextPacket() {
+    if (packets_.empty())
+        return false;
+    auto packet = packets_.front();
+    packets_.pop_front();
+    stats_.packets_dispatched++;
+    packet.first->handler(this, packet.first, ZX_OK, &packet.second);
+    return true;
+}
+
+bool TestDispatcher::DispatchNextWait() {
+    zx_port_packet_t packet;
+    for (;;) {
+        if (port_.wait(zx::time(0), &packet) != ZX_OK)
+            return false;
+        // The wait may have been canceled after its packet was queued.
+        auto it = waits_.find(packet.key);
+        if (it == waits_.end())
+            continue;
+        async_wait_t* wait = it->second;
+        if (wait->state.reserved[1] != kRepeating) {
+            waits_.erase(it);
+            wait->state = ASYNC_STATE_INIT;
+        }
+        stats_.waits_dispatched++;
+        wait->handler(this, wait, packet.status, &packet.signal);
+        return true;
+    }
+}
+
+bool TestDispatcher::DispatchNextTask() {
+    if (tasks_.empty() || tasks_.begin()->first.first > now_.get())
+        return false;
+    async_task_t* task = tasks_.begin()->second;
+    tasks_.erase(tasks_.begin());
+    task->state = ASYNC_STATE_INIT;
+    stats_.tasks_dispatched++;
+    task->handler(this, task, ZX_OK);
+    return true;
+}
+
+zx_status_t TestDispatcher::BeginWaitWithOptions(async_wait_t* wait, uint32_t options) {
+    if (shutdown_)
+        return ZX_ERR_BAD_STATE;
+    uint64_t seq = next_seq_++;
+    zx_status_t status = zx_object_wait_async(wait->object, port_.get(), seq,
+                                              wait->trigger, options);
+    if (status != ZX_OK)
+        return status;
+    wait->state.reserved[0] = static_cast<uintptr_t>(seq);
+    wait->state.reserved[1] = options == ZX_WAIT_ASYNC_REPEATING ? kRepeating : 0u;
+    waits_.emplace(seq, wait);
+    return ZX_OK;
+}
+
+zx_time_t TestDispatcher::Now(async_dispatcher_t* dispatcher) {
+    return static_cast<TestDispatcher*>(dispatcher)->now_.get();
+}
+
+zx_status_t TestDispatcher::BeginWait(async_dispatcher_t* dispatcher, async_wait_t* wait) {
+    return static_cast<TestDispatcher*>(dispatcher)->BeginWaitWithOptions(wait,
+                                                                          ZX_WAIT_ASYNC_ONCE);
+}
+
+zx_status_t TestDispatcher::BeginRepeatingWait(async_dispatcher_t* dispatcher,
+                                               async_wait_t* wait) {
+    return static_cast<TestDispatcher*>(dispatcher)->BeginWaitWithOptions(
+        wait, ZX_WAIT_ASYNC_REPEATING);
+}
+
+zx_status_t TestDispatcher::CancelWait(async_dispatcher_t* dispatcher, async_wait_t* wait) {
+    auto self = static_cast<TestDispatcher*>(dispatcher);
+    auto it = self->waits_.find(wait->state.reserved[0]);
+    if (wait->state.reserved[0] == 0u || it == self->waits_.end() || it->second != wait)
+        return ZX_ERR_NOT_FOUND;
+    // The packet, if one is queued, is removed along with the observer.
+    // Should the object have been closed in the meantime, any packet left
+    // behind is skipped when it is read.
+    zx_port_cancel(self->port_.get(), wait->object, it->first);
+    self->waits_.erase(it);
+    wait->state = ASYNC_STATE_INIT;
+    return ZX_OK;
+}
+
+zx_status_t TestDispatcher::PostTask(async_dispatcher_t* dispatcher, async_task_t* task) {
+    auto self = static_cast<TestDispatcher*>(dispatcher);
+    if (self->shutdown_)
+        return ZX_ERR_BAD_STATE;
+    uint64_t seq = self->next_seq_++;
+    task->state.reserved[0] = static_cast<uintptr_t>(seq);
+    self->tasks_.emplace(std::make_pair(task->deadline, seq), task);
+    return ZX_OK;
+}
+
+zx_status_t TestDispatcher::CancelTask(async_dispatcher_t* dispatcher, async_task_t* task) {
+    auto self = static_cast<TestDispatcher*>(dispatcher);
+    if (task->state.reserved[0] == 0u)
+        return ZX_ERR_NOT_FOUND;
+    auto it = self->tasks_.find(std::make_pair(task->deadline, task->state.reserved[0]));
+    if (it == self->tasks_.end() || it->second != task)
+        return ZX_ERR_NOT_FOUND;
+    self->tasks_.erase(it);
+    task->state = ASYNC_STATE_INIT;
+    return ZX_OK;
+}
+
+zx_status_t TestDispatcher::QueuePacket(async_dispatcher_t* dispatcher,
+                                        async_receiver_t* receiver,
+                                        const zx_packet_user_t* data) {
+    async_packet_t packet = {receiver, data};
+    return QueuePackets(dispatcher, &packet, 1u, nullptr);
+}
+
+zx_status_t TestDispatcher::QueuePackets(async_dispatcher_t* dispatcher,
+                                         const async_packet_t* packets, size_t count,
+                                         size_t* out_queued) {
+    auto self = static_cast<TestDispatcher*>(dispatcher);
+    if (out_queued)
+        *out_queued = 0u;
+    if (self->shutdown_)
+        return ZX_ERR_BAD_STATE;
+    for (size_t i = 0u; i < count; i++) {
+        zx_packet_user_t data = {};
+        if (packets[i].data)
+            data = *packets[i].data;
+        self->packets_.emplace_back(packets[i].receiver, data);
+    }
+    if (out_queued)
+        *out_queued = count;
+    return ZX_OK;
+}
+
+zx_status_t TestDispatcher::SetGuestBellTrap(async_dispatcher_t* dispatcher,
+                                             async_guest_bell_trap_t* trap,
+                                             zx_handle_t guest, zx_vaddr_t addr,
+                                             size_t length) {
+    return ZX_ERR_NOT_SUPPORTED;
+}
+
+zx_status_t TestDispatcher::BindExceptionPort(async_dispatcher_t* dispatcher,
+                                              async_exception_t* exception) {
+    return ZX_ERR_NOT_SUPPORTED;
+}
+
+zx_status_t TestDispatcher::UnbindExceptionPort(async_dispatcher_t* dispatcher,
+                                                async_exception_t* exception) {
+    return ZX_ERR_NOT_SUPPORTED;
+}
+
+zx_status_t TestDispatcher::ResumeFromException(async_dispatcher_t* dispatcher,
+                                                async_exception_t* exception,
+                                                zx_handle_t task, uint32_t options) {
+    return ZX_ERR_NOT_SUPPORTED;
+}
+
+} // namespace async
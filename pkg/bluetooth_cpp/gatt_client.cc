@@ -0,0 +1,125 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/bluetooth/cpp/gatt_client.h"
+
+#include <lib/async/cpp/time.h>
+#include <zircon/assert.h>
+
+#include <stdint.h>
+
+#include <utility>
+
+namespace bluetooth {
+
+GattClient::GattClient(fuchsia::bluetooth::gatt::RemoteServicePtr service,
+                       async_dispatcher_t* dispatcher, Options options)
+    : service_(std::move(service)),
+      dispatcher_(dispatcher),
+      options_(options) {
+  ZX_DEBUG_ASSERT(service_);
+  ZX_DEBUG_ASSERT(dispatcher_);
+  ZX_DEBUG_ASSERT(options_.max_burst > 0u);
+
+  // Wait for the channel to drain rather than failing when a burst fills
+  // it.
+  service_.set_max_in_flight_calls(UINT32_MAX);
+  service_.set_error_handler(
+      [this](zx_status_t status) { OnError(status); });
+  service_.events().OnCharacteristicValueUpdated =
+      [this](uint64_t id, fidl::VectorPtr<uint8_t> value) {
+        OnNotification(id, value.take());
+      };
+}
+
+GattClient::~GattClient() = default;
+
+void GattClient::WriteWithoutResponse(uint64_t id,
+                                      std::vector<uint8_t> value) {
+  if (options_.coalesce_writes) {
+    auto it = queued_by_id_.find(id);
+    if (it != queued_by_id_.end()) {
+      it->second->value = std::move(value);
+      return;
+    }
+  }
+  writes_.push_back(Write{id, std::move(value)});
+  if (options_.coalesce_writes)
+    queued_by_id_[id] = &writes_.back();
+  ScheduleBurst();
+}
+
+void GattClient::ScheduleBurst() {
+  if (burst_task_.is_pending() || writes_.empty())
+    return;
+  // Let the writes of this turn join the burst, but wait for the interval
+  // to pass since the last one.
+  zx::time now = async::Now(dispatcher_);
+  if (next_burst_ <= now) {
+    burst_task_.Post(dispatcher_);
+  } else {
+    burst_task_.PostForTime(dispatcher_, next_burst_);
+  }
+}
+
+void GattClient::SendBurst() {
+  if (!service_)
+    return;
+  for (size_t sent = 0u; sent < options_.max_burst && !writes_.empty();
+       ++sent) {
+    Write& write = writes_.front();
+    if (options_.coalesce_writes)
+      queued_by_id_.erase(write.id);
+    service_->WriteCharacteristicWithoutResponse(
+        write.id, fidl::VectorPtr<uint8_t>(std::move(write.value)));
+    writes_.pop_front();
+  }
+  next_burst_ = async::Now(dispatcher_) + options_.burst_interval;
+  ScheduleBurst();
+}
+
+void GattClient::OnNotification(uint64_t id, std::vector<uint8_t> value) {
+  Notifications& notifications = notifications_[id];
+  if (notifications.count == 0u)
+    notified_ids_.push_back(id);
+  if (options_.latest_notification_only)
+    notifications.count = 0u;
+  // Reuse the slots of earlier windows.
+  if (notifications.count < notifications.values.size()) {
+    notifications.values[notifications.count] = std::move(value);
+  } else {
+    notifications.values.push_back(std::move(value));
+  }
+  ++notifications.count;
+
+  if (!notification_task_.is_pending())
+    notification_task_.PostDelayed(dispatcher_, options_.notification_window);
+}
+
+void GattClient::DeliverNotifications() {
+  // Notifications arriving during delivery wait for the next window.
+  std::vector<uint64_t> ids;
+  ids.swap(notified_ids_);
+  for (uint64_t id : ids) {
+    Notifications& notifications = notifications_[id];
+    size_t count = notifications.count;
+    notifications.count = 0u;
+    if (notification_handler_)
+      notification_handler_(id, notifications.values.data(), count);
+  }
+  // Hand the storage back for the next window.
+  ids.clear();
+  if (notified_ids_.empty())
+    notified_ids_.swap(ids);
+}
+
+void GattClient::OnError(zx_status_t status) {
+  burst_task_.Cancel();
+  writes_.clear();
+  queued_by_id_.clear();
+  if (error_handler_)
+    error_handler_(status);
+}
+
+}  // namespace bluetooth
@@ -0,0 +1,142 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_BLUETOOTH_CPP_GATT_CLIENT_H_
+#define LIB_BLUETOOTH_CPP_GATT_CLIENT_H_
+
+#include <fuchsia/bluetooth/gatt/cpp/fidl.h>
+#include <lib/async/cpp/task.h>
+#include <lib/async/dispatcher.h>
+#include <lib/fit/function.h>
+#include <lib/zx/time.h>
+#include <zircon/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace bluetooth {
+
+// A client of a |fuchsia::bluetooth::gatt::RemoteService| for high-rate
+// traffic.
+//
+// Writes without response are queued and sent in bursts of at most
+// |Options::max_burst| writes, one burst per |Options::burst_interval|, so
+// that the host is handed about as many as the link carries per connection
+// event instead of a write per call or an unbounded flood that it would
+// buffer or drop. Writes made within one turn of the dispatcher leave in the
+// same burst. With |Options::coalesce_writes|, a write replaces the one to
+// the same characteristic still queued, for values where only the latest
+// matters.
+//
+// Notifications and indications are held for |Options::notification_window|
+// and delivered per characteristic, all the values that arrived for it in
+// one call, or only the latest one with |Options::latest_notification_only|.
+// Their storage is reused from one window to the next.
+//
+// Other calls are made directly on |service()|.
+//
+// The client must be used on the thread of |dispatcher|. Its handlers must
+// not destroy it.
+class GattClient {
+ public:
+  struct Options {
+    // The most writes without response sent at once. Match it to the ACL
+    // data packets the controller buffers for the link.
+    size_t max_burst = 8u;
+
+    // The time from one burst to the next. Match it to the connection
+    // interval.
+    zx::duration burst_interval = zx::msec(15);
+
+    // Whether a write replaces a queued write to the same characteristic.
+    bool coalesce_writes = false;
+
+    // How long notifications are held before being delivered. Zero delivers
+    // them after the current turn of the dispatcher.
+    zx::duration notification_window = zx::duration(0);
+
+    // Whether only the latest notification of each characteristic in a
+    // window is delivered.
+    bool latest_notification_only = false;
+  };
+
+  // Called with the |count| values notified for the characteristic |id|
+  // during a window, oldest first. The handler may move the values out.
+  using NotificationHandler =
+      fit::function<void(uint64_t id, std::vector<uint8_t>* values,
+                         size_t count)>;
+
+  GattClient(fuchsia::bluetooth::gatt::RemoteServicePtr service,
+             async_dispatcher_t* dispatcher, Options options);
+  ~GattClient();
+
+  GattClient(const GattClient&) = delete;
+  GattClient& operator=(const GattClient&) = delete;
+
+  // The service, for the calls the client does not wrap.
+  fuchsia::bluetooth::gatt::RemoteService* service() { return service_.get(); }
+
+  void set_notification_handler(NotificationHandler handler) {
+    notification_handler_ = std::move(handler);
+  }
+
+  // Called with the error that closed the service's channel, after which
+  // queued writes are dropped.
+  void set_error_handler(fit::function<void(zx_status_t)> error_handler) {
+    error_handler_ = std::move(error_handler);
+  }
+
+  // Queues a write of |value| to the characteristic |id| without response.
+  void WriteWithoutResponse(uint64_t id, std::vector<uint8_t> value);
+
+  // The writes queued and not yet sent.
+  size_t queued_writes() const { return writes_.size(); }
+
+ private:
+  struct Write {
+    uint64_t id;
+    std::vector<uint8_t> value;
+  };
+
+  struct Notifications {
+    std::vector<std::vector<uint8_t>> values;
+    size_t count = 0u;
+  };
+
+  void ScheduleBurst();
+  void SendBurst();
+  void OnNotification(uint64_t id, std::vector<uint8_t> value);
+  void DeliverNotifications();
+  void OnError(zx_status_t status);
+
+  fuchsia::bluetooth::gatt::RemoteServicePtr service_;
+  async_dispatcher_t* const dispatcher_;
+  const Options options_;
+  NotificationHandler notification_handler_;
+  fit::function<void(zx_status_t)> error_handler_;
+
+  // Queued writes, oldest first. References to them stay valid as writes are
+  // added and sent, so |queued_by_id_| can point at them.
+  std::deque<Write> writes_;
+  // The queued write to each characteristic, with |Options::coalesce_writes|.
+  std::unordered_map<uint64_t, Write*> queued_by_id_;
+  zx::time next_burst_;
+  async::TaskClosureMethod<GattClient, &GattClient::SendBurst> burst_task_{
+      this};
+
+  std::unordered_map<uint64_t, Notifications> notifications_;
+  // The characteristics with notifications held, in order of arrival.
+  std::vector<uint64_t> notified_ids_;
+  async::TaskClosureMethod<GattClient, &GattClient::DeliverNotifications>
+      notification_task_{this};
+};
+
+}  // namespace bluetooth
+
+#endif  // LIB_BLUETOOTH_CPP_GATT_CLIENT_H_
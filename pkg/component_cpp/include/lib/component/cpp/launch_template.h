@@ -0,0 +1,103 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_COMPONENT_CPP_LAUNCH_TEMPLATE_H_
+#define LIB_COMPONENT_CPP_LAUNCH_TEMPLATE_H_
+
+#include <fuchsia/sys/cpp/fidl.h>
+#include <lib/fidl/cpp/interface_request.h>
+#include <lib/zx/channel.h>
+#include <lib/zx/handle.h>
+#include <zircon/types.h>
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+namespace component {
+
+// A template for launching many instances of the same component.
+//
+// Each |fuchsia::sys::Launcher::CreateComponent| call builds, encodes and
+// validates the whole |LaunchInfo|, with its url, arguments and namespace
+// paths. A template captures the encoded message once, so that each launch
+// only copies it, fills in fresh handles and writes it to the launcher.
+//
+// The handles of the template are handed to each launch as follows:
+//
+//  * Channels, such as the directories of the flat namespace and the host
+//    directory of the additional services, are cloned with a pipelined
+//    |fuchsia.io.Node.Clone|, so a launch never waits on their servers.
+//  * Other handles, such as the sockets of |out| and |err|, are duplicated.
+//  * The |directory_request| of the template, if any, only marks its place:
+//    each launch passes its own.
+//
+// The additional services of a template must be served from a host
+// directory rather than a |ServiceProvider|, which cannot be cloned.
+//
+// Launching from a template is thread-safe.
+//
+// # Example
+//
+//   std::unique_ptr<component::LaunchTemplate> tmpl;
+//   zx_status_t status =
+//       component::LaunchTemplate::Create(std::move(launch_info), &tmpl);
+//   ...
+//   fuchsia::sys::ComponentControllerPtr controller;
+//   status = tmpl->Launch(launcher.channel(), zx::channel(),
+//                         controller.NewRequest());
+class LaunchTemplate {
+ public:
+  ~LaunchTemplate();
+
+  LaunchTemplate(const LaunchTemplate&) = delete;
+  LaunchTemplate& operator=(const LaunchTemplate&) = delete;
+
+  // Creates a template that launches components as |info| describes.
+  //
+  // Fails with |ZX_ERR_NOT_SUPPORTED| if the additional services of |info|
+  // have a provider.
+  static zx_status_t Create(fuchsia::sys::LaunchInfo info,
+                            std::unique_ptr<LaunchTemplate>* out_template);
+
+  // Whether each launch takes a |directory_request|.
+  bool has_directory_request() const { return has_directory_request_; }
+
+  // Launches a component from the template through |launcher|, the channel of
+  // a |fuchsia::sys::Launcher|.
+  //
+  // |directory_request| is served the component's outgoing directory. It is
+  // required if |has_directory_request()| and ignored otherwise.
+  // |controller| is required, since the launch is pipelined and the
+  // controller is what reports its failure; detach it to let the component
+  // outlive it.
+  zx_status_t Launch(
+      const zx::channel& launcher, zx::channel directory_request,
+      fidl::InterfaceRequest<fuchsia::sys::ComponentController> controller)
+      const;
+
+ private:
+  enum class Slot : uint8_t {
+    kDuplicate,
+    kClone,
+    kDirectoryRequest,
+    kController,
+  };
+
+  LaunchTemplate();
+
+  // The encoded |CreateComponent| request.
+  std::vector<uint8_t> bytes_;
+  // The handles of the request, in order, and how each launch fills them in.
+  // The handles of the |kDirectoryRequest| and |kController| slots are
+  // invalid.
+  std::vector<zx::handle> handles_;
+  std::vector<Slot> slots_;
+  bool has_directory_request_ = false;
+};
+
+}  // namespace component
+
+#endif  // LIB_COMPONENT_CPP_LAUNCH_TEMPLATE_H_
@@ -0,0 +1,150 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/component/cpp/launch_template.h"
+
+#include <lib/fdio/util.h>
+#include <lib/fidl/cpp/synchronous_interface_ptr.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+
+#include <utility>
+
+namespace component {
+namespace {
+
+zx_koid_t GetKoid(zx_handle_t handle) {
+  zx_info_handle_basic_t info;
+  zx_status_t status = zx_object_get_info(handle, ZX_INFO_HANDLE_BASIC, &info,
+                                          sizeof(info), nullptr, nullptr);
+  return status == ZX_OK ? info.koid : ZX_KOID_INVALID;
+}
+
+}  // namespace
+
+LaunchTemplate::LaunchTemplate() = default;
+
+LaunchTemplate::~LaunchTemplate() = default;
+
+zx_status_t LaunchTemplate::Create(
+    fuchsia::sys::LaunchInfo info,
+    std::unique_ptr<LaunchTemplate>* out_template) {
+  if (info.additional_services && info.additional_services->provider)
+    return ZX_ERR_NOT_SUPPORTED;
+
+  // The per-launch handles are recognized by their koids once the request is
+  // encoded.
+  zx::channel controller_request, controller;
+  zx_status_t status = zx::channel::create(0u, &controller_request,
+                                           &controller);
+  if (status != ZX_OK)
+    return status;
+  zx_koid_t controller_koid = GetKoid(controller_request.get());
+  zx_koid_t directory_request_koid =
+      info.directory_request ? GetKoid(info.directory_request.get())
+                             : ZX_KOID_INVALID;
+
+  // Let the generated bindings encode and validate the request once, into a
+  // channel of our own.
+  fuchsia::sys::LauncherSyncPtr capture;
+  zx::channel captured = capture.NewRequest().TakeChannel();
+  status = capture->CreateComponent(
+      std::move(info),
+      fidl::InterfaceRequest<fuchsia::sys::ComponentController>(
+          std::move(controller_request)));
+  if (status != ZX_OK)
+    return status;
+
+  std::unique_ptr<LaunchTemplate> tmpl(new LaunchTemplate());
+  uint32_t actual_bytes = 0u, actual_handles = 0u;
+  tmpl->bytes_.resize(ZX_CHANNEL_MAX_MSG_BYTES);
+  zx_handle_t handles[ZX_CHANNEL_MAX_MSG_HANDLES];
+  status = captured.read(0u, tmpl->bytes_.data(), ZX_CHANNEL_MAX_MSG_BYTES,
+                         &actual_bytes, handles, ZX_CHANNEL_MAX_MSG_HANDLES,
+                         &actual_handles);
+  if (status != ZX_OK)
+    return status;
+  tmpl->bytes_.resize(actual_bytes);
+  tmpl->bytes_.shrink_to_fit();
+
+  tmpl->handles_.reserve(actual_handles);
+  tmpl->slots_.reserve(actual_handles);
+  for (uint32_t i = 0u; i < actual_handles; ++i) {
+    zx::handle handle(handles[i]);
+    zx_info_handle_basic_t basic;
+    status = handle.get_info(ZX_INFO_HANDLE_BASIC, &basic, sizeof(basic),
+                             nullptr, nullptr);
+    if (status != ZX_OK) {
+      zx_handle_close_many(handles + i + 1u, actual_handles - i - 1u);
+      return status;
+    }
+    Slot slot = Slot::kDuplicate;
+    if (basic.koid == controller_koid) {
+      slot = Slot::kController;
+      handle.reset();
+    } else if (basic.koid == directory_request_koid) {
+      slot = Slot::kDirectoryRequest;
+      tmpl->has_directory_request_ = true;
+      handle.reset();
+    } else if (basic.type == ZX_OBJ_TYPE_CHANNEL) {
+      slot = Slot::kClone;
+    }
+    tmpl->handles_.push_back(std::move(handle));
+    tmpl->slots_.push_back(slot);
+  }
+  *out_template = std::move(tmpl);
+  return ZX_OK;
+}
+
+zx_status_t LaunchTemplate::Launch(
+    const zx::channel& launcher, zx::channel directory_request,
+    fidl::InterfaceRequest<fuchsia::sys::ComponentController> controller)
+    const {
+  if (!controller || (has_directory_request_ && !directory_request))
+    return ZX_ERR_INVALID_ARGS;
+
+  zx_handle_t handles[ZX_CHANNEL_MAX_MSG_HANDLES];
+  size_t count = 0u;
+  zx_status_t status = ZX_OK;
+  for (; count < slots_.size(); ++count) {
+    zx_handle_t source = handles_[count].get();
+    switch (slots_[count]) {
+      case Slot::kDuplicate:
+        status = zx_handle_duplicate(source, ZX_RIGHT_SAME_RIGHTS,
+                                     &handles[count]);
+        break;
+      case Slot::kClone: {
+        zx_handle_t server;
+        status = zx_channel_create(0u, &handles[count], &server);
+        if (status == ZX_OK) {
+          // Pipelined: the server binds the clone when it reads the request.
+          status = fdio_service_clone_to(source, server);
+          if (status != ZX_OK)
+            zx_handle_close(handles[count]);
+        }
+        break;
+      }
+      case Slot::kDirectoryRequest:
+        handles[count] = directory_request.release();
+        break;
+      case Slot::kController:
+        handles[count] = controller.TakeChannel().release();
+        break;
+    }
+    if (status != ZX_OK)
+      break;
+  }
+  if (status != ZX_OK) {
+    zx_handle_close_many(handles, count);
+    return status;
+  }
+
+  // The request is one-way, so its transaction id stays zero. The handles are
+  // consumed even if the write fails.
+  return launcher.write(0u, bytes_.data(),
+                        static_cast<uint32_t>(bytes_.size()), handles,
+                        static_cast<uint32_t>(count));
+}
+
+}  // namespace component
@@ -0,0 +1,304 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ethernet/cpp/client.h"
+
+#include <lib/async/time.h>
+#include <lib/zx/vmo.h>
+#include <string.h>
+#include <zircon/assert.h>
+
+#include <limits>
+
+namespace ethernet {
+
+Client::Client(async_dispatcher_t* dispatcher, Options options,
+               RxHandler rx_handler)
+    : async_task_t{{ASYNC_STATE_INIT}, &Client::Handler, ZX_TIME_INFINITE,
+                   0},
+      dispatcher_(dispatcher),
+      options_(options),
+      rx_handler_(std::move(rx_handler)) {
+  ZX_DEBUG_ASSERT(dispatcher_ || options_.busy_poll);
+  ZX_DEBUG_ASSERT(options_.buffer_size > 0u);
+  ZX_DEBUG_ASSERT(options_.buffer_size <=
+                  std::numeric_limits<uint16_t>::max());
+}
+
+Client::~Client() {
+  if (task_posted_)
+    async_cancel_task(dispatcher_, this);
+}
+
+zx_status_t Client::Start(zircon::ethernet::DeviceSyncPtr* device) {
+  ZX_DEBUG_ASSERT(!device_);
+  zx_status_t call_status = ZX_OK;
+  std::unique_ptr<zircon::ethernet::Fifos> fifos;
+  zx_status_t status = (*device)->GetFifos(&call_status, &fifos);
+  if (status == ZX_OK)
+    status = call_status;
+  if (status != ZX_OK)
+    return status;
+  if (!fifos || fifos->rx_depth == 0u || fifos->tx_depth == 0u)
+    return ZX_ERR_INTERNAL;
+
+  // Commit the buffer up front, so that neither the device nor the client
+  // faults on the first frame through each buffer.
+  rx_count_ = fifos->rx_depth;
+  tx_count_ = fifos->tx_depth;
+  const size_t size =
+      (static_cast<size_t>(rx_count_) + tx_count_) * options_.buffer_size;
+  if (size > std::numeric_limits<uint32_t>::max())
+    return ZX_ERR_OUT_OF_RANGE;
+  status = zx::mapped_vmo::create(
+      size, ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, &io_buffer_, 0u,
+      zx::mapped_vmo::commit_policy::up_front);
+  if (status != ZX_OK)
+    return status;
+  zx::vmo vmo;
+  status = io_buffer_.vmo().duplicate(ZX_RIGHT_SAME_RIGHTS, &vmo);
+  if (status != ZX_OK)
+    return status;
+  status = (*device)->SetIOBuffer(std::move(vmo), &call_status);
+  if (status == ZX_OK)
+    status = call_status;
+  if (status != ZX_OK)
+    return status;
+
+  rx_fifo_ = zx::typed_fifo<FifoEntry>(fifos->rx.release());
+  tx_fifo_ = zx::typed_fifo<FifoEntry>(fifos->tx.release());
+
+  // The rx fifo has room for every rx buffer, so one write hands them all
+  // to the device.
+  std::vector<FifoEntry> entries(rx_count_);
+  for (uint32_t i = 0u; i < rx_count_; ++i) {
+    entries[i].offset = i * options_.buffer_size;
+    entries[i].length = static_cast<uint16_t>(options_.buffer_size);
+    entries[i].cookie = i;
+  }
+  status = rx_fifo_.write(entries.data(), entries.size(), nullptr);
+  if (status != ZX_OK)
+    return status;
+  free_tx_.clear();
+  free_tx_.reserve(tx_count_);
+  for (uint32_t i = 0u; i < tx_count_; ++i)
+    free_tx_.push_back(rx_count_ + tx_count_ - 1u - i);
+  tx_batch_.reserve(tx_count_);
+
+  status = (*device)->Start(&call_status);
+  if (status == ZX_OK)
+    status = call_status;
+  if (status != ZX_OK)
+    return status;
+  device_ = device;
+
+  if (options_.busy_poll)
+    return ZX_OK;
+  rx_reader_ = std::make_unique<async::FifoReader<FifoEntry, kBatchSize>>(
+      rx_fifo_, [this](zx_status_t status, const FifoEntry* entries,
+                       size_t count) {
+        if (status != ZX_OK) {
+          OnError(status);
+          return;
+        }
+        HandleRx(entries, count);
+      });
+  tx_reader_ = std::make_unique<async::FifoReader<FifoEntry, kBatchSize>>(
+      tx_fifo_, [this](zx_status_t status, const FifoEntry* entries,
+                       size_t count) {
+        if (status != ZX_OK) {
+          OnError(status);
+          return;
+        }
+        HandleTxDone(entries, count);
+      });
+  status = rx_reader_->Begin(dispatcher_);
+  if (status == ZX_OK)
+    status = tx_reader_->Begin(dispatcher_);
+  return status;
+}
+
+void Client::Stop() {
+  if (!device_)
+    return;
+  (*device_)->Stop();
+  device_ = nullptr;
+  rx_reader_.reset();
+  tx_reader_.reset();
+  if (task_posted_) {
+    async_cancel_task(dispatcher_, this);
+    task_posted_ = false;
+  }
+  rx_fifo_.reset();
+  tx_fifo_.reset();
+  tx_batch_.clear();
+  free_tx_.clear();
+  tx_exhausted_ = false;
+  io_buffer_.unmap();
+}
+
+uint8_t* Client::AllocTx() {
+  if (free_tx_.empty()) {
+    tx_exhausted_ = true;
+    return nullptr;
+  }
+  uint8_t* buffer = BufferAt(free_tx_.back());
+  free_tx_.pop_back();
+  return buffer;
+}
+
+void Client::FreeTx(uint8_t* buffer) {
+  uint32_t index = 0u;
+  if (IsTxBuffer(buffer, &index))
+    free_tx_.push_back(index);
+}
+
+zx_status_t Client::Send(uint8_t* buffer, size_t size) {
+  uint32_t index = 0u;
+  if (!IsTxBuffer(buffer, &index))
+    return ZX_ERR_INVALID_ARGS;
+  if (size > options_.buffer_size) {
+    free_tx_.push_back(index);
+    return ZX_ERR_OUT_OF_RANGE;
+  }
+
+  FifoEntry entry;
+  entry.offset = index * options_.buffer_size;
+  entry.length = static_cast<uint16_t>(size);
+  entry.cookie = index;
+  tx_batch_.push_back(entry);
+  if (options_.busy_poll || task_posted_)
+    return ZX_OK;
+  deadline = async_now(dispatcher_);
+  zx_status_t status = async_post_task(dispatcher_, this);
+  if (status != ZX_OK)
+    return Flush();
+  task_posted_ = true;
+  return ZX_OK;
+}
+
+zx_status_t Client::SendCopy(const void* data, size_t size) {
+  if (size > options_.buffer_size)
+    return ZX_ERR_OUT_OF_RANGE;
+  uint8_t* buffer = AllocTx();
+  if (!buffer)
+    return ZX_ERR_SHOULD_WAIT;
+  memcpy(buffer, data, size);
+  return Send(buffer, size);
+}
+
+zx_status_t Client::Flush() {
+  if (tx_batch_.empty())
+    return ZX_OK;
+  // There is a tx buffer for each entry of the fifo, so the fifo has room
+  // for every frame sent.
+  size_t actual = 0u;
+  zx_status_t status =
+      tx_fifo_.write(tx_batch_.data(), tx_batch_.size(), &actual);
+  if (status != ZX_OK)
+    return status;
+  ZX_DEBUG_ASSERT(actual == tx_batch_.size());
+  tx_batch_.clear();
+  return ZX_OK;
+}
+
+zx_status_t Client::Poll() {
+  ZX_DEBUG_ASSERT(device_);
+  zx_status_t status = PollFifo(rx_fifo_, &Client::HandleRx);
+  if (status == ZX_OK)
+    status = PollFifo(tx_fifo_, &Client::HandleTxDone);
+  if (status == ZX_OK)
+    status = Flush();
+  return status;
+}
+
+zx_status_t Client::PollFifo(const zx::typed_fifo<FifoEntry>& fifo,
+                             void (Client::*handle)(const FifoEntry*,
+                                                    size_t)) {
+  FifoEntry entries[kBatchSize];
+  for (;;) {
+    size_t count = 0u;
+    zx_status_t status = fifo.read(entries, kBatchSize, &count);
+    if (status == ZX_ERR_SHOULD_WAIT)
+      return ZX_OK;
+    if (status != ZX_OK)
+      return status;
+    (this->*handle)(entries, count);
+    if (count < kBatchSize)
+      return ZX_OK;
+  }
+}
+
+void Client::Handler(async_dispatcher_t* dispatcher, async_task_t* task,
+                     zx_status_t status) {
+  Client* client = static_cast<Client*>(task);
+  client->task_posted_ = false;
+  if (status != ZX_OK)
+    return;
+  status = client->Flush();
+  if (status != ZX_OK)
+    client->OnError(status);
+}
+
+void Client::HandleRx(const FifoEntry* entries, size_t count) {
+  FifoEntry requeue[kBatchSize];
+  size_t requeue_count = 0u;
+  for (size_t i = 0u; i < count; ++i) {
+    const FifoEntry& entry = entries[i];
+    if (entry.cookie >= rx_count_)
+      continue;
+    if ((entry.flags & zircon::ethernet::FIFO_RX_OK) &&
+        entry.length <= options_.buffer_size && rx_handler_) {
+      rx_handler_(BufferAt(entry.cookie), entry.length, entry.flags);
+    }
+    FifoEntry& next = requeue[requeue_count++];
+    next.offset = static_cast<uint32_t>(entry.cookie) * options_.buffer_size;
+    next.length = static_cast<uint16_t>(options_.buffer_size);
+    next.cookie = entry.cookie;
+  }
+  if (requeue_count == 0u)
+    return;
+  zx_status_t status = rx_fifo_.write(requeue, requeue_count, nullptr);
+  if (status != ZX_OK && status != ZX_ERR_PEER_CLOSED)
+    OnError(status);
+}
+
+void Client::HandleTxDone(const FifoEntry* entries, size_t count) {
+  for (size_t i = 0u; i < count; ++i) {
+    const uint64_t index = entries[i].cookie;
+    if (index >= rx_count_ && index < rx_count_ + tx_count_)
+      free_tx_.push_back(static_cast<uint32_t>(index));
+  }
+  if (tx_exhausted_ && !free_tx_.empty()) {
+    tx_exhausted_ = false;
+    if (tx_ready_handler_)
+      tx_ready_handler_();
+  }
+}
+
+void Client::OnError(zx_status_t status) {
+  rx_reader_.reset();
+  tx_reader_.reset();
+  if (error_handler_)
+    error_handler_(status);
+}
+
+uint8_t* Client::BufferAt(uint64_t index) const {
+  return static_cast<uint8_t*>(io_buffer_.data()) +
+         index * options_.buffer_size;
+}
+
+bool Client::IsTxBuffer(const uint8_t* buffer, uint32_t* index) const {
+  const uint8_t* tx_start = BufferAt(rx_count_);
+  const uint8_t* tx_end = BufferAt(rx_count_ + tx_count_);
+  if (buffer < tx_start || buffer >= tx_end)
+    return false;
+  const size_t offset = buffer - tx_start;
+  if (offset % options_.buffer_size != 0u)
+    return false;
+  *index = rx_count_ + static_cast<uint32_t>(offset / options_.buffer_size);
+  return true;
+}
+
+}  // namespace ethernet
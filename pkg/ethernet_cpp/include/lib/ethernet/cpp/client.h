@@ -0,0 +1,164 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_ETHERNET_CPP_CLIENT_H_
+#define LIB_ETHERNET_CPP_CLIENT_H_
+
+#include <lib/async/cpp/fifo.h>
+#include <lib/async/dispatcher.h>
+#include <lib/async/task.h>
+#include <lib/fit/function.h>
+#include <lib/zx/fifo.h>
+#include <lib/zx/mapped_vmo.h>
+#include <zircon/ethernet/cpp/fidl.h>
+#include <zircon/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace ethernet {
+
+// Sends and receives frames on a |zircon::ethernet::Device| through its
+// fifos.
+//
+// The client maps one IO buffer, shared with the device, and carves it into
+// buffers of |buffer_size| bytes: one for each entry of the rx fifo and one
+// for each entry of the tx fifo. Every rx buffer is given to the device at
+// start and given back as soon as the frame in it has been handled. A tx
+// buffer returns to a free list once the device reports its frame sent.
+// Frames are built and read in place, without copies or allocations.
+//
+// Fifo entries move in batches: each read takes as many entries as the fifo
+// holds, the rx buffers of a batch are handed back in one write, and frames
+// sent within one turn of the dispatcher reach the device in one write.
+//
+// By default the client waits on the fifos on |dispatcher|. In busy-poll
+// mode it never waits; the caller calls |Poll()| in a loop instead, trading
+// a spinning thread for latency.
+//
+// The client must be used on the thread of |dispatcher|, or in busy-poll
+// mode on one thread. Its handlers must not destroy it.
+class Client : private async_task_t {
+ public:
+  using FifoEntry = zircon::ethernet::FifoEntry;
+
+  // Called with each frame received, which is valid only during the call,
+  // and its |zircon::ethernet::FIFO_*| flags.
+  using RxHandler =
+      fit::function<void(const uint8_t* data, size_t size, uint16_t flags)>;
+
+  struct Options {
+    // The size of each buffer, which bounds the frames sent and received.
+    uint32_t buffer_size = zircon::ethernet::DEFAULT_BUFFER_SIZE;
+
+    // Whether the caller polls the fifos with |Poll()| rather than the
+    // client waiting on them.
+    bool busy_poll = false;
+  };
+
+  // |dispatcher| may be null in busy-poll mode.
+  Client(async_dispatcher_t* dispatcher, Options options,
+         RxHandler rx_handler);
+  ~Client() override;
+
+  Client(const Client&) = delete;
+  Client& operator=(const Client&) = delete;
+
+  // Called once a fifo closes or can no longer be waited on. The client
+  // stops receiving.
+  void set_error_handler(fit::function<void(zx_status_t status)> handler) {
+    error_handler_ = std::move(handler);
+  }
+
+  // Called once a tx buffer is free again after |AllocTx()| has run out.
+  void set_tx_ready_handler(fit::closure handler) {
+    tx_ready_handler_ = std::move(handler);
+  }
+
+  // Gets the fifos of |device|, gives it the IO buffer, hands it every rx
+  // buffer and starts it. |device| must outlive the client.
+  zx_status_t Start(zircon::ethernet::DeviceSyncPtr* device);
+
+  // Stops the device and the client, dropping the frames not yet sent.
+  void Stop();
+
+  // Returns a free tx buffer of |buffer_size| bytes to build a frame in, or
+  // null if every tx buffer is in flight.
+  uint8_t* AllocTx();
+
+  // Returns |buffer|, from |AllocTx()|, to the free list without sending it.
+  void FreeTx(uint8_t* buffer);
+
+  // Sends the first |size| bytes of |buffer|, from |AllocTx()|, which
+  // returns to the free list once the device is done with it. The frame is
+  // written to the fifo with the others sent in the same turn of the
+  // dispatcher, or by the next |Poll()| or |Flush()|.
+  //
+  // Returns |ZX_ERR_OUT_OF_RANGE|, and frees |buffer|, if |size| exceeds
+  // |buffer_size|.
+  zx_status_t Send(uint8_t* buffer, size_t size);
+
+  // Copies |size| bytes from |data| into a free tx buffer and sends it.
+  //
+  // Returns |ZX_ERR_SHOULD_WAIT| if every tx buffer is in flight.
+  zx_status_t SendCopy(const void* data, size_t size);
+
+  // Writes the frames sent since the last write to the fifo now.
+  zx_status_t Flush();
+
+  // Handles every received frame and sent buffer that the device has
+  // reported, then flushes, without blocking. For busy-poll mode.
+  //
+  // Returns |ZX_OK|, or the error of a fifo, such as |ZX_ERR_PEER_CLOSED|.
+  zx_status_t Poll();
+
+  uint32_t buffer_size() const { return options_.buffer_size; }
+  size_t tx_available() const { return free_tx_.size(); }
+
+ private:
+  // The most entries read from a fifo at a time.
+  static constexpr size_t kBatchSize = 64u;
+
+  static void Handler(async_dispatcher_t* dispatcher, async_task_t* task,
+                      zx_status_t status);
+
+  zx_status_t PollFifo(const zx::typed_fifo<FifoEntry>& fifo,
+                       void (Client::*handle)(const FifoEntry*, size_t));
+  void HandleRx(const FifoEntry* entries, size_t count);
+  void HandleTxDone(const FifoEntry* entries, size_t count);
+  void OnError(zx_status_t status);
+  uint8_t* BufferAt(uint64_t index) const;
+  bool IsTxBuffer(const uint8_t* buffer, uint32_t* index) const;
+
+  async_dispatcher_t* const dispatcher_;
+  const Options options_;
+  RxHandler rx_handler_;
+  fit::function<void(zx_status_t)> error_handler_;
+  fit::closure tx_ready_handler_;
+
+  zircon::ethernet::DeviceSyncPtr* device_ = nullptr;
+  zx::typed_fifo<FifoEntry> rx_fifo_;
+  zx::typed_fifo<FifoEntry> tx_fifo_;
+  std::unique_ptr<async::FifoReader<FifoEntry, kBatchSize>> rx_reader_;
+  std::unique_ptr<async::FifoReader<FifoEntry, kBatchSize>> tx_reader_;
+
+  // Rx buffers come first, then tx buffers.
+  zx::mapped_vmo io_buffer_;
+  uint32_t rx_count_ = 0u;
+  uint32_t tx_count_ = 0u;
+  std::vector<uint32_t> free_tx_;
+  bool tx_exhausted_ = false;
+
+  // Frames sent but not yet written to the fifo.
+  std::vector<FifoEntry> tx_batch_;
+  bool task_posted_ = false;
+};
+
+}  // namespace ethernet
+
+#endif  // LIB_ETHERNET_CPP_CLIENT_H_
@@ -0,0 +1,230 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/fdio/async_watcher.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lib/async/wait.h>
+#include <lib/fdio/watcher.h>
+#include <zircon/syscalls.h>
+
+#include "io_wire.h"
+
+#define WATCH_MASK                                                   \
+    (fuchsia_io_WATCH_MASK_ADDED | fuchsia_io_WATCH_MASK_REMOVED |   \
+     fuchsia_io_WATCH_MASK_EXISTING | fuchsia_io_WATCH_MASK_IDLE)
+
+struct fdio_async_watcher {
+    // Waits for the messages of |watcher|, repeatedly.
+    async_wait_t wait;
+    // Waits for the reply to Directory.Watch on |dir|.
+    async_wait_t reply_wait;
+    async_dispatcher_t* dispatcher;
+    zx_handle_t dir;
+    zx_handle_t watcher;
+    fdio_async_watch_func_t func;
+    void* cookie;
+    bool watching;
+    bool reply_pending;
+    fdio_watch_event_t events[FDIO_ASYNC_WATCHER_MAX_BATCH];
+    // One message, and room to terminate its last name.
+    uint8_t buffer[fuchsia_io_MAX_BUF + 1u];
+};
+
+static void stop(fdio_async_watcher_t* watcher) {
+    if (watcher->reply_pending) {
+        async_cancel_wait(watcher->dispatcher, &watcher->reply_wait);
+        watcher->reply_pending = false;
+    }
+    if (watcher->watching) {
+        async_cancel_wait(watcher->dispatcher, &watcher->wait);
+        watcher->watching = false;
+    }
+    zx_handle_close(watcher->dir);
+    zx_handle_close(watcher->watcher);
+    watcher->dir = ZX_HANDLE_INVALID;
+    watcher->watcher = ZX_HANDLE_INVALID;
+}
+
+// Stops watching and makes the last call of the callback, which may destroy
+// the watcher.
+static void finish(fdio_async_watcher_t* watcher, zx_status_t status) {
+    stop(watcher);
+    watcher->func(status, NULL, 0u, watcher->cookie);
+}
+
+// Delivers the events of the message of |size| bytes in |watcher->buffer|,
+// a batch at a time.
+//
+// Each name is terminated in place, over the first byte of the event that
+// follows it, once that event has been read.
+static void deliver_message(fdio_async_watcher_t* watcher, size_t size) {
+    uint8_t* buffer = watcher->buffer;
+    uint8_t* name_end = NULL;
+    size_t count = 0u;
+    size_t offset = 0u;
+    while (size - offset >= sizeof(fuchsia_io_watched_event_t)) {
+        uint8_t event = buffer[offset];
+        uint8_t len = buffer[offset + 1u];
+        if (name_end != NULL)
+            *name_end = '\0';
+        name_end = NULL;
+        if (count == FDIO_ASYNC_WATCHER_MAX_BATCH) {
+            watcher->func(ZX_OK, watcher->events, count, watcher->cookie);
+            count = 0u;
+        }
+
+        offset += sizeof(fuchsia_io_watched_event_t);
+        if (len > size - offset)
+            break;
+        char* name = (char*)buffer + offset;
+        offset += len;
+
+        int fdio_event;
+        switch (event) {
+        case fuchsia_io_WATCH_EVENT_ADDED:
+        case fuchsia_io_WATCH_EVENT_EXISTING:
+            fdio_event = WATCH_EVENT_ADD_FILE;
+            break;
+        case fuchsia_io_WATCH_EVENT_REMOVED:
+            fdio_event = WATCH_EVENT_REMOVE_FILE;
+            break;
+        case fuchsia_io_WATCH_EVENT_IDLE:
+            fdio_event = WATCH_EVENT_IDLE;
+            break;
+        default:
+            // Deletion of the directory is reported when the server closes
+            // the watcher.
+            continue;
+        }
+        name_end = (uint8_t*)name + len;
+        watcher->events[count].event = fdio_event;
+        watcher->events[count].name = name;
+        count++;
+    }
+    if (name_end != NULL)
+        *name_end = '\0';
+    if (count > 0u)
+        watcher->func(ZX_OK, watcher->events, count, watcher->cookie);
+}
+
+static void handle_events(async_dispatcher_t* dispatcher, async_wait_t* wait,
+                          zx_status_t status,
+                          const zx_packet_signal_t* signal) {
+    fdio_async_watcher_t* watcher = (fdio_async_watcher_t*)wait;
+    if (status != ZX_OK) {
+        watcher->watching = false;
+        finish(watcher, status);
+        return;
+    }
+    // The wait repeats, so the channel is drained before returning.
+    for (;;) {
+        uint32_t actual_bytes, actual_handles;
+        status = zx_channel_read(watcher->watcher, 0u, watcher->buffer, NULL,
+                                 fuchsia_io_MAX_BUF, 0u, &actual_bytes,
+                                 &actual_handles);
+        if (status == ZX_ERR_SHOULD_WAIT)
+            return;
+        if (status != ZX_OK) {
+            finish(watcher, status == ZX_ERR_BUFFER_TOO_SMALL ? ZX_ERR_IO
+                                                              : status);
+            return;
+        }
+        deliver_message(watcher, actual_bytes);
+    }
+}
+
+static void handle_reply(async_dispatcher_t* dispatcher, async_wait_t* wait,
+                         zx_status_t status,
+                         const zx_packet_signal_t* signal) {
+    fdio_async_watcher_t* watcher =
+        (fdio_async_watcher_t*)((char*)wait -
+                                offsetof(fdio_async_watcher_t, reply_wait));
+    watcher->reply_pending = false;
+    if (status == ZX_OK) {
+        fuchsia_io_DirectoryWatchResponse response;
+        uint32_t actual_bytes, actual_handles;
+        status = zx_channel_read(watcher->dir, 0u, &response, NULL,
+                                 sizeof(response), 0u, &actual_bytes,
+                                 &actual_handles);
+        if (status == ZX_OK) {
+            if (actual_bytes < sizeof(response) || response.hdr.txid != 1u ||
+                response.hdr.ordinal != fuchsia_io_DirectoryWatchOrdinal) {
+                status = ZX_ERR_IO;
+            } else {
+                status = response.s;
+            }
+        } else if (status == ZX_ERR_BUFFER_TOO_SMALL) {
+            status = ZX_ERR_IO;
+        }
+    }
+    if (status != ZX_OK)
+        finish(watcher, status);
+}
+
+zx_status_t fdio_async_watcher_create(int dirfd,
+                                      async_dispatcher_t* dispatcher,
+                                      fdio_async_watch_func_t func,
+                                      void* cookie,
+                                      fdio_async_watcher_t** out_watcher) {
+    // calloc leaves the waits in ASYNC_STATE_INIT.
+    fdio_async_watcher_t* watcher = calloc(1, sizeof(*watcher));
+    if (watcher == NULL)
+        return ZX_ERR_NO_MEMORY;
+    watcher->dispatcher = dispatcher;
+    watcher->func = func;
+    watcher->cookie = cookie;
+
+    zx_handle_t server = ZX_HANDLE_INVALID;
+    zx_status_t status = fdio_wire_clone(
+        dirfd, fuchsia_io_OPEN_RIGHT_READABLE, &watcher->dir);
+    if (status == ZX_OK)
+        status = zx_channel_create(0u, &watcher->watcher, &server);
+    if (status == ZX_OK) {
+        // Pipelined: the events are read as they come, not after the reply.
+        fuchsia_io_DirectoryWatchRequest request;
+        memset(&request, 0, sizeof(request));
+        request.hdr.txid = 1u;
+        request.hdr.ordinal = fuchsia_io_DirectoryWatchOrdinal;
+        request.mask = WATCH_MASK;
+        request.options = 0u;
+        request.watcher = FIDL_HANDLE_PRESENT;
+        status = zx_channel_write(watcher->dir, 0u, &request, sizeof(request),
+                                  &server, 1u);
+    } else {
+        zx_handle_close(server);
+    }
+
+    if (status == ZX_OK) {
+        watcher->reply_wait.handler = handle_reply;
+        watcher->reply_wait.object = watcher->dir;
+        watcher->reply_wait.trigger =
+            ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED;
+        status = async_begin_wait(dispatcher, &watcher->reply_wait);
+        watcher->reply_pending = status == ZX_OK;
+    }
+    if (status == ZX_OK) {
+        watcher->wait.handler = handle_events;
+        watcher->wait.object = watcher->watcher;
+        watcher->wait.trigger = ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED;
+        status = async_begin_repeating_wait(dispatcher, &watcher->wait);
+        watcher->watching = status == ZX_OK;
+    }
+    if (status != ZX_OK) {
+        stop(watcher);
+        free(watcher);
+        return status;
+    }
+    *out_watcher = watcher;
+    return ZX_OK;
+}
+
+void fdio_async_watcher_destroy(fdio_async_watcher_t* watcher) {
+    stop(watcher);
+    free(watcher);
+}
@@ -0,0 +1,235 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/fdio/dirscan.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <zircon/syscalls.h>
+
+#include "io_wire.h"
+
+// The most entries a ReadDirents reply can hold, each having a name of at
+// least one byte.
+#define MAX_ENTRIES (fuchsia_io_MAX_BUF / (sizeof(fuchsia_io_dirent_t) + 1u))
+
+// The Open request of an entry with the longest name.
+#define MAX_OPEN_REQUEST_SIZE \
+    (sizeof(fuchsia_io_DirectoryOpenRequest) + \
+     FIDL_ALIGN(fuchsia_io_MAX_FILENAME))
+
+struct fdio_dirscan {
+    zx_handle_t channel;
+    size_t count;
+    fdio_dirent_attr_t entries[MAX_ENTRIES];
+    zx_handle_t nodes[MAX_ENTRIES];
+    // The names of the entries, each null-terminated.
+    char names[fuchsia_io_MAX_BUF + MAX_ENTRIES];
+    union {
+        fuchsia_io_DirectoryReadDirentsResponse response;
+        uint8_t bytes[sizeof(fuchsia_io_DirectoryReadDirentsResponse) +
+                      fuchsia_io_MAX_BUF];
+    } dirents;
+};
+
+static void close_nodes(fdio_dirscan_t* scanner) {
+    for (size_t i = 0; i < scanner->count; ++i) {
+        if (scanner->nodes[i] != ZX_HANDLE_INVALID) {
+            zx_handle_close(scanner->nodes[i]);
+            scanner->nodes[i] = ZX_HANDLE_INVALID;
+        }
+    }
+}
+
+// Reads the next batch of entries into |scanner->entries|, without their
+// attributes.
+static zx_status_t read_dirents(fdio_dirscan_t* scanner) {
+    fuchsia_io_DirectoryReadDirentsRequest request;
+    memset(&request, 0, sizeof(request));
+    request.hdr.ordinal = fuchsia_io_DirectoryReadDirentsOrdinal;
+    request.max_bytes = fuchsia_io_MAX_BUF;
+    zx_channel_call_args_t args = {
+        .wr_bytes = &request,
+        .wr_handles = NULL,
+        .rd_bytes = scanner->dirents.bytes,
+        .rd_handles = NULL,
+        .wr_num_bytes = sizeof(request),
+        .wr_num_handles = 0u,
+        .rd_num_bytes = sizeof(scanner->dirents),
+        .rd_num_handles = 0u,
+    };
+    uint32_t actual_bytes, actual_handles;
+    zx_status_t status = zx_channel_call(scanner->channel, 0u,
+                                         ZX_TIME_INFINITE, &args,
+                                         &actual_bytes, &actual_handles);
+    if (status != ZX_OK)
+        return status == ZX_ERR_BUFFER_TOO_SMALL ? ZX_ERR_IO : status;
+
+    const fuchsia_io_DirectoryReadDirentsResponse* response =
+        &scanner->dirents.response;
+    if (actual_bytes < sizeof(*response) ||
+        response->hdr.ordinal != fuchsia_io_DirectoryReadDirentsOrdinal)
+        return ZX_ERR_IO;
+    if (response->s != ZX_OK)
+        return response->s;
+    size_t size = response->dirents.count;
+    if (size > fuchsia_io_MAX_BUF ||
+        actual_bytes < sizeof(*response) + FIDL_ALIGN(size))
+        return ZX_ERR_IO;
+
+    const uint8_t* data = scanner->dirents.bytes + sizeof(*response);
+    char* name = scanner->names;
+    size_t offset = 0u;
+    while (offset < size) {
+        fuchsia_io_dirent_t dirent;
+        if (size - offset < sizeof(dirent))
+            return ZX_ERR_IO;
+        memcpy(&dirent, data + offset, sizeof(dirent));
+        offset += sizeof(dirent);
+        if (dirent.size == 0u || size - offset < dirent.size)
+            return ZX_ERR_IO;
+
+        fdio_dirent_attr_t* entry = &scanner->entries[scanner->count++];
+        memset(entry, 0, sizeof(*entry));
+        memcpy(name, data + offset, dirent.size);
+        name[dirent.size] = '\0';
+        entry->name = name;
+        entry->ino = dirent.ino;
+        entry->type = dirent.type;
+        name += dirent.size + 1u;
+        offset += dirent.size;
+    }
+    return ZX_OK;
+}
+
+// Opens a connection to |entry| and sends GetAttr on it, without waiting
+// for the server to reply to either.
+static zx_status_t request_attributes(fdio_dirscan_t* scanner,
+                                      fdio_dirent_attr_t* entry,
+                                      zx_handle_t* out_node) {
+    zx_handle_t client, server;
+    zx_status_t status = zx_channel_create(0u, &client, &server);
+    if (status != ZX_OK)
+        return status;
+
+    size_t name_size = strlen(entry->name);
+    union {
+        fuchsia_io_DirectoryOpenRequest request;
+        uint8_t bytes[MAX_OPEN_REQUEST_SIZE];
+    } open;
+    memset(&open, 0, sizeof(open));
+    open.request.hdr.ordinal = fuchsia_io_DirectoryOpenOrdinal;
+    // A node reference can only be described and have its attributes read,
+    // so opening it never has side effects, like opening a device does.
+    open.request.flags = fuchsia_io_OPEN_FLAG_NODE_REFERENCE;
+    open.request.path.size = name_size;
+    open.request.path.data = (char*)FIDL_ALLOC_PRESENT;
+    open.request.object = FIDL_HANDLE_PRESENT;
+    memcpy(open.bytes + sizeof(open.request), entry->name, name_size);
+    status = zx_channel_write(
+        scanner->channel, 0u, &open,
+        (uint32_t)(sizeof(open.request) + FIDL_ALIGN(name_size)), &server, 1u);
+    if (status != ZX_OK) {
+        zx_handle_close(client);
+        return status;
+    }
+
+    // The server reads this once it has bound the connection.
+    fuchsia_io_NodeGetAttrRequest request;
+    memset(&request, 0, sizeof(request));
+    request.hdr.txid = 1u;
+    request.hdr.ordinal = fuchsia_io_NodeGetAttrOrdinal;
+    status = zx_channel_write(client, 0u, &request, sizeof(request), NULL, 0u);
+    if (status != ZX_OK) {
+        zx_handle_close(client);
+        return status;
+    }
+    *out_node = client;
+    return ZX_OK;
+}
+
+static zx_status_t receive_attributes(zx_handle_t node,
+                                      fdio_node_attributes_t* attributes) {
+    zx_signals_t observed;
+    zx_status_t status = zx_object_wait_one(
+        node, ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED, ZX_TIME_INFINITE,
+        &observed);
+    if (status != ZX_OK)
+        return status;
+
+    fuchsia_io_NodeGetAttrResponse response;
+    uint32_t actual_bytes, actual_handles;
+    status = zx_channel_read(node, 0u, &response, NULL, sizeof(response), 0u,
+                             &actual_bytes, &actual_handles);
+    if (status == ZX_ERR_PEER_CLOSED) {
+        // The server closes the connection if the open fails.
+        return ZX_ERR_NOT_FOUND;
+    }
+    if (status != ZX_OK)
+        return status == ZX_ERR_BUFFER_TOO_SMALL ? ZX_ERR_IO : status;
+    if (actual_bytes < sizeof(response) || response.hdr.txid != 1u ||
+        response.hdr.ordinal != fuchsia_io_NodeGetAttrOrdinal)
+        return ZX_ERR_IO;
+    if (response.s != ZX_OK)
+        return response.s;
+
+    attributes->mode = response.attributes.mode;
+    attributes->id = response.attributes.id;
+    attributes->content_size = response.attributes.content_size;
+    attributes->storage_size = response.attributes.storage_size;
+    attributes->link_count = response.attributes.link_count;
+    attributes->creation_time = response.attributes.creation_time;
+    attributes->modification_time = response.attributes.modification_time;
+    return ZX_OK;
+}
+
+zx_status_t fdio_dirscan_create(int dirfd, fdio_dirscan_t** out_scanner) {
+    fdio_dirscan_t* scanner = calloc(1, sizeof(*scanner));
+    if (scanner == NULL)
+        return ZX_ERR_NO_MEMORY;
+    zx_status_t status = fdio_wire_clone(
+        dirfd, fuchsia_io_OPEN_RIGHT_READABLE, &scanner->channel);
+    if (status != ZX_OK) {
+        free(scanner);
+        return status;
+    }
+    *out_scanner = scanner;
+    return ZX_OK;
+}
+
+zx_status_t fdio_dirscan_next(fdio_dirscan_t* scanner,
+                              const fdio_dirent_attr_t** out_entries,
+                              size_t* out_count) {
+    scanner->count = 0u;
+    zx_status_t status = read_dirents(scanner);
+    if (status != ZX_OK) {
+        scanner->count = 0u;
+        return status;
+    }
+
+    // Send every request before waiting for any reply, so the server handles
+    // them while the replies are read.
+    for (size_t i = 0; i < scanner->count; ++i) {
+        scanner->nodes[i] = ZX_HANDLE_INVALID;
+        scanner->entries[i].status = request_attributes(
+            scanner, &scanner->entries[i], &scanner->nodes[i]);
+    }
+    for (size_t i = 0; i < scanner->count; ++i) {
+        if (scanner->nodes[i] == ZX_HANDLE_INVALID)
+            continue;
+        scanner->entries[i].status = receive_attributes(
+            scanner->nodes[i], &scanner->entries[i].attributes);
+    }
+    close_nodes(scanner);
+
+    *out_entries = scanner->entries;
+    *out_count = scanner->count;
+    return ZX_OK;
+}
+
+void fdio_dirscan_destroy(fdio_dirscan_t* scanner) {
+    zx_handle_close(scanner->channel);
+    free(scanner);
+}
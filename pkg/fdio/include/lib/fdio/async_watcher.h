@@ -0,0 +1,68 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <lib/async/dispatcher.h>
+#include <zircon/compiler.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// The most events delivered in one call of a watcher's callback.
+#define FDIO_ASYNC_WATCHER_MAX_BATCH ((size_t)128u)
+
+// An event of a watched directory.
+typedef struct fdio_watch_event {
+    // WATCH_EVENT_ADD_FILE, WATCH_EVENT_REMOVE_FILE or WATCH_EVENT_IDLE, as
+    // for fdio_watch_directory().
+    int event;
+
+    // The name of the file, null-terminated, or "" for WATCH_EVENT_IDLE.
+    const char* name;
+} fdio_watch_event_t;
+
+// Called with the |count| events of a directory that arrived together, which
+// are valid until the callback returns.
+//
+// Once watching ends, the callback is called one last time with the reason
+// in |status| and no events: ZX_ERR_PEER_CLOSED once the directory is
+// deleted or its server goes away, or the error with which the server
+// refused the watch.  The watcher may be destroyed from that last call, and
+// only from that one.
+typedef void (*fdio_async_watch_func_t)(zx_status_t status,
+                                        const fdio_watch_event_t* events,
+                                        size_t count, void* cookie);
+
+// Watches a directory on an async dispatcher, without a thread of its own.
+//
+// Unlike fdio_watch_directory(), which blocks its thread and calls back for
+// each event, a watcher waits for the messages of its fuchsia.io watcher
+// channel on a dispatcher and hands the events of each message, parsed in
+// place, to its callback in one call.  The watch is requested with a
+// pipelined Directory.Watch, so events may arrive before its reply.
+//
+// A watcher must be created, used and destroyed on the thread of its
+// dispatcher.
+typedef struct fdio_async_watcher fdio_async_watcher_t;
+
+// Starts watching the directory open as |dirfd|, reporting the files that
+// exist, then WATCH_EVENT_IDLE, then the files added and removed.
+//
+// The watcher has its own connection to the directory, so |dirfd| may be
+// closed afterwards.
+//
+// Returns ZX_ERR_NOT_SUPPORTED if |dirfd| is not a remote directory.
+zx_status_t fdio_async_watcher_create(int dirfd,
+                                      async_dispatcher_t* dispatcher,
+                                      fdio_async_watch_func_t func,
+                                      void* cookie,
+                                      fdio_async_watcher_t** out_watcher);
+
+// Stops watching, if the watcher still is, and frees it.
+void fdio_async_watcher_destroy(fdio_async_watcher_t* watcher);
+
+__END_CDECLS
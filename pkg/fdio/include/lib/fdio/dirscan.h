@@ -0,0 +1,80 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zircon/types.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// The attributes of a node, as returned by fuchsia.io Node.GetAttr.
+//
+// |mode| holds the type of the node in the same bits as the S_IF* values of
+// <sys/stat.h>, and its times are nanoseconds since the Unix epoch.
+typedef struct fdio_node_attributes {
+    uint32_t mode;
+    uint64_t id;
+    uint64_t content_size;
+    uint64_t storage_size;
+    uint64_t link_count;
+    uint64_t creation_time;
+    uint64_t modification_time;
+} fdio_node_attributes_t;
+
+// An entry of a directory, with its attributes.
+typedef struct fdio_dirent_attr {
+    // The name of the entry, null-terminated.
+    const char* name;
+
+    // The inode number and the DT_* type of the entry, as listed by the
+    // directory.
+    uint64_t ino;
+    uint8_t type;
+
+    // The result of getting the attributes of the entry.  ZX_ERR_NOT_FOUND
+    // usually means that the entry was removed since it was listed.
+    zx_status_t status;
+
+    // The attributes of the entry, if |status| is ZX_OK.
+    fdio_node_attributes_t attributes;
+} fdio_dirent_attr_t;
+
+// Enumerates a directory and gets the attributes of its entries in bulk.
+//
+// readdir() followed by stat() of each entry costs a round trip to the
+// server per entry for each of Directory.Open, Node.GetAttr and Node.Close.
+// A scanner reads entries a batch at a time with Directory.ReadDirents, then
+// sends the Open and GetAttr requests of every entry in the batch before it
+// waits for any reply, so a batch costs about two round trips however many
+// entries it has.
+//
+// A scanner is not thread-safe.
+typedef struct fdio_dirscan fdio_dirscan_t;
+
+// Creates a scanner of the directory open as |dirfd|.
+//
+// The scanner has its own connection to the directory, so it starts at the
+// first entry and does not change the position of |dirfd|, which may be
+// closed while the scanner is in use.
+//
+// Returns ZX_ERR_NOT_SUPPORTED if |dirfd| is not a remote directory.
+zx_status_t fdio_dirscan_create(int dirfd, fdio_dirscan_t** out_scanner);
+
+// Reads the next batch of entries and their attributes.
+//
+// On success, |*out_entries| points to |*out_count| entries, which the
+// scanner owns and which, with their names, stay valid until the next call.
+// |*out_count| is 0 once all the entries have been read.
+zx_status_t fdio_dirscan_next(fdio_dirscan_t* scanner,
+                              const fdio_dirent_attr_t** out_entries,
+                              size_t* out_count);
+
+// Closes the connection of the scanner and frees it.
+void fdio_dirscan_destroy(fdio_dirscan_t* scanner);
+
+__END_CDECLS
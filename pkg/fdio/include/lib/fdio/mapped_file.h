@@ -0,0 +1,48 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zircon/types.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// A read-only view of the contents of a file, mapped into the address space
+// of the process.
+typedef struct fdio_mapped_file {
+    // The contents of the file, or NULL if the file is empty.
+    const void* data;
+
+    // The size of the file in bytes.
+    size_t size;
+
+    // Private state, for fdio_unmap_file().
+    zx_vaddr_t mapping_addr;
+    size_t mapping_len;
+} fdio_mapped_file_t;
+
+// Maps the contents of the file at |path| read-only.
+//
+// When the server can provide a clone of the file's VMO, the mapping is a
+// copy-on-write view of it, so no bytes are copied and pages are only read
+// as they are touched.  Otherwise, the contents are read into a new VMO,
+// which is then mapped read-only.
+//
+// Returns ZX_ERR_NOT_FILE if |path| is not a regular file, or an error from
+// opening, reading or mapping the file.
+zx_status_t fdio_map_file(const char* path, fdio_mapped_file_t* out_file);
+
+// Maps the contents of the file open as |fd|, like fdio_map_file().
+// This does not close |fd| or change its file offset.
+zx_status_t fdio_map_fd(int fd, fdio_mapped_file_t* out_file);
+
+// Unmaps a file mapped by fdio_map_file() or fdio_map_fd(), and resets
+// |file| to be empty.
+void fdio_unmap_file(fdio_mapped_file_t* file);
+
+__END_CDECLS
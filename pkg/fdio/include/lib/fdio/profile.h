@@ -0,0 +1,124 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <lib/fdio/namespace.h>
+#include <zircon/types.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// Opt-in timing of the operations that dominate the cold start of a
+// component: setting up its namespace, loading its shared libraries through
+// the loader service, and connecting to the services in /svc.
+//
+// While profiling is enabled, each instrumented operation records how long
+// it took, how many times it waited for a reply from a server, and the path
+// it involved.  Records are kept in a buffer that can be read or dumped on
+// demand, and emitted as duration events in the "fdio:startup" trace
+// category when that category is enabled.
+//
+// The fdio_profile_* wrappers below instrument the corresponding fdio
+// functions, whose implementations are in the prebuilt library.  The
+// service cache and spawn templates record their operations themselves.
+// When profiling is disabled, each instrumented operation costs one load.
+
+// Kinds of operations.
+typedef uint32_t fdio_profile_op_t;
+#define FDIO_PROFILE_OP_NS_BIND ((fdio_profile_op_t)1u)
+#define FDIO_PROFILE_OP_NS_INSTALL ((fdio_profile_op_t)2u)
+#define FDIO_PROFILE_OP_LDSVC_LOAD_OBJECT ((fdio_profile_op_t)3u)
+#define FDIO_PROFILE_OP_LDSVC_CLONE ((fdio_profile_op_t)4u)
+#define FDIO_PROFILE_OP_SERVICE_CONNECT ((fdio_profile_op_t)5u)
+
+// Options for fdio_profile_enable().
+#define FDIO_PROFILE_RECORD ((uint32_t)1u) // keep records in the buffer
+#define FDIO_PROFILE_TRACE ((uint32_t)2u)  // emit trace events
+
+// The longest path a record keeps, including its null terminator.  Longer
+// paths are truncated.
+#define FDIO_PROFILE_PATH_MAX 128
+
+typedef struct fdio_profile_record {
+    fdio_profile_op_t op;
+
+    // The result of the operation.
+    zx_status_t status;
+
+    // When the operation started, and how long it took, in ticks.
+    zx_ticks_t start;
+    zx_ticks_t duration;
+
+    // How many times the operation waited for a reply from a server.
+    uint32_t round_trips;
+
+    char path[FDIO_PROFILE_PATH_MAX];
+} fdio_profile_record_t;
+
+// Starts profiling the operations of the process with |options|.  With
+// FDIO_PROFILE_RECORD, the buffer keeps the last |capacity| records,
+// replacing any records from before.
+//
+// Returns ZX_ERR_INVALID_ARGS if |options| is empty, or |capacity| is zero
+// with FDIO_PROFILE_RECORD.
+zx_status_t fdio_profile_enable(uint32_t options, size_t capacity);
+
+// Stops profiling.  The records in the buffer stay readable until profiling
+// is enabled again.
+void fdio_profile_disable(void);
+
+// Copies up to |count| records from the buffer to |records|, oldest first,
+// and returns how many it copied.  |out_dropped| receives the number of
+// records that were replaced before they could be read, if it is not NULL.
+size_t fdio_profile_read(fdio_profile_record_t* records, size_t count,
+                         size_t* out_dropped);
+
+// Writes the records in the buffer to |fd| as text, one per line, followed
+// by the total time, round trips and count of each kind of operation.
+void fdio_profile_dump(int fd);
+
+// Instrumentation ------------------------------------------------------------
+
+// Starts timing an operation.  Returns the tick count to pass to
+// fdio_profile_end(), or 0 if profiling is disabled.
+zx_ticks_t fdio_profile_begin(void);
+
+// Records an operation on |path| that started at |start|, unless |start| is
+// 0.  Libraries that set up components use this to profile their own
+// operations alongside those of fdio.
+void fdio_profile_end(fdio_profile_op_t op, const char* path,
+                      zx_ticks_t start, uint32_t round_trips,
+                      zx_status_t status);
+
+// Instrumented wrappers ------------------------------------------------------
+
+// Calls fdio_ns_bind(), and records it.
+zx_status_t fdio_profile_ns_bind(fdio_ns_t* ns, const char* path,
+                                 zx_handle_t h);
+
+// Calls fdio_ns_install(), and records it.
+zx_status_t fdio_profile_ns_install(fdio_ns_t* ns);
+
+// Calls fdio_service_connect(), and records it.
+zx_status_t fdio_profile_service_connect(const char* svcpath, zx_handle_t h);
+
+// Calls fdio_service_connect_at(), and records it.
+zx_status_t fdio_profile_service_connect_at(zx_handle_t dir, const char* path,
+                                            zx_handle_t h);
+
+// Asks the loader service |loader| for the shared library |name| with
+// fuchsia.ldsvc.Loader.LoadObject, and records it.
+//
+// Returns the status the loader replies with, or an error from talking to
+// it.
+zx_status_t fdio_profile_loader_load_object(zx_handle_t loader,
+                                            const char* name,
+                                            zx_handle_t* out_vmo);
+
+__END_CDECLS
@@ -0,0 +1,54 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zircon/types.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// The most requests that a reader keeps in flight.
+#define FDIO_READAHEAD_MAX_DEPTH ((uint32_t)16u)
+
+// A sequential reader of a remote file that reads ahead.
+//
+// read() on a remote file without a VMO makes one synchronous File.Read call
+// of at most fuchsia.io MAX_BUF bytes, so reading a large file sequentially
+// costs a round trip to the server per 8 KiB.  A reader keeps up to |depth|
+// File.ReadAt calls of MAX_BUF bytes each in flight on its own connection to
+// the file, and serves reads from the replies as they arrive.
+//
+// A reader is not thread-safe.
+typedef struct fdio_readahead fdio_readahead_t;
+
+// Creates a reader of the file open as |fd|, with up to |depth| requests in
+// flight, starting at the current offset of |fd|.
+//
+// The reader has its own connection to the file, so it does not change the
+// offset of |fd|, and |fd| may be closed while the reader is in use.
+//
+// Returns ZX_ERR_NOT_SUPPORTED if |fd| is not a remote file, and
+// ZX_ERR_INVALID_ARGS if |depth| is 0 or more than FDIO_READAHEAD_MAX_DEPTH.
+zx_status_t fdio_readahead_create(int fd, uint32_t depth,
+                                  fdio_readahead_t** out_reader);
+
+// Reads up to |capacity| bytes into |buffer|, blocking until |capacity| bytes
+// have been read or the end of the file is reached.  Returns the number of
+// bytes read in |out_actual|, which is 0 at the end of the file.
+//
+// After an error, the reader returns the same error until it is seeked.
+zx_status_t fdio_readahead_read(fdio_readahead_t* reader, void* buffer,
+                                size_t capacity, size_t* out_actual);
+
+// Moves the reader to |offset|, discarding whatever it has read ahead.
+void fdio_readahead_seek(fdio_readahead_t* reader, uint64_t offset);
+
+// Closes the connection of the reader and frees it.
+void fdio_readahead_destroy(fdio_readahead_t* reader);
+
+__END_CDECLS
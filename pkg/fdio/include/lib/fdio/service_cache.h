@@ -0,0 +1,58 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <zircon/types.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// fdio_service_connect() cleans its path and resolves it through the bind
+// table of the installed namespace every time.  The functions below resolve
+// the directory that contains a service once, keep a connection to it in a
+// small per-process cache keyed by the directory's path, and connect later
+// requests for services in the same directory with a single Directory.Open
+// on that connection.
+//
+// A cached directory stays in use while its server keeps the connection
+// open, so call fdio_service_cache_flush() after rebinding a path of the
+// installed namespace.
+
+// The most directories in the cache.
+#define FDIO_SERVICE_CACHE_SIZE 8
+
+// Connects |h| to the service at the absolute path |svcpath|, like
+// fdio_service_connect(), through the cached connection to its directory.
+//
+// Takes ownership of |h| whether or not it succeeds.
+zx_status_t fdio_service_connect_cached(const char* svcpath, zx_handle_t h);
+
+// A service to connect by fdio_service_connect_many().
+typedef struct fdio_service_connection {
+    // The name of the service in the directory, which may contain '/'.
+    const char* name;
+
+    // The channel to connect to the service.
+    zx_handle_t request;
+} fdio_service_connection_t;
+
+// Connects each of |count| channels to a service in the directory at the
+// absolute path |dirpath|, such as "/svc".
+//
+// The connections are sent in one burst on the cached connection to the
+// directory, without waiting for the server between them.
+//
+// Takes ownership of every request whether or not it succeeds, and returns
+// the first error, if any.
+zx_status_t fdio_service_connect_many(const char* dirpath,
+                                      const fdio_service_connection_t* services,
+                                      size_t count);
+
+// Closes the cached connections to all directories.
+void fdio_service_cache_flush(void);
+
+__END_CDECLS
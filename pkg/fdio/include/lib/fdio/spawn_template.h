@@ -0,0 +1,56 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <lib/fdio/spawn.h>
+#include <zircon/compiler.h>
+#include <zircon/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+__BEGIN_CDECLS
+
+// A template for spawning many processes from the same executable.
+//
+// Each call to |fdio_spawn_etc| loads the executable, clones the loader
+// service with a round trip to it, and exports and clones the namespace of
+// the running process. A template does the loading, resolving and exporting
+// once, so that each launch only duplicates the executable, sends pipelined
+// clones of the loader and the namespace, and creates the process.
+//
+// A template reflects the executable, loader and namespace at the time it is
+// created. Launching from a template is thread-safe.
+typedef struct fdio_spawn_template fdio_spawn_template_t;
+
+// Creates a template for spawning the executable at |path|.
+//
+// |flags| are the |FDIO_SPAWN_*| flags that every launch uses. The loader
+// service of |FDIO_SPAWN_DEFAULT_LDSVC| and the namespace of
+// |FDIO_SPAWN_CLONE_NAMESPACE| are captured when the template is created.
+zx_status_t fdio_spawn_template_create(uint32_t flags,
+                                       const char* path,
+                                       fdio_spawn_template_t** out_template);
+
+// Spawns a process from |tmpl| in the given job.
+//
+// Takes the same arguments as |fdio_spawn_etc|, except for the flags and the
+// path, which come from |tmpl|. |actions| are applied after those of the
+// template, so an |FDIO_SPAWN_ACTION_ADD_NS_ENTRY| action adds an entry to
+// the captured namespace.
+zx_status_t fdio_spawn_template_launch(fdio_spawn_template_t* tmpl,
+                                       zx_handle_t job,
+                                       const char* const* argv,
+                                       const char* const* environ,
+                                       size_t action_count,
+                                       const fdio_spawn_action_t* actions,
+                                       zx_handle_t* process_out,
+                                       char err_msg_out[FDIO_SPAWN_ERR_MSG_MAX_LENGTH]);
+
+// Releases the executable, loader and namespace captured by |tmpl|, and
+// frees it.
+void fdio_spawn_template_destroy(fdio_spawn_template_t* tmpl);
+
+__END_CDECLS
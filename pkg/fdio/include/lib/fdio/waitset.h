@@ -0,0 +1,92 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <lib/async/dispatcher.h>
+#include <zircon/types.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// A set of file descriptors to wait on for readiness, like epoll.
+//
+// poll() and fdio_wait_fd() build a list of handles to wait on every time
+// they are called, and poll() waits with zx_object_wait_many(), which is
+// limited to ZX_WAIT_MANY_MAX_ITEMS handles.  A wait set registers each fd
+// once, with an asynchronous wait on a port, so a wait costs time in the
+// number of ready fds rather than the number of registered ones.
+//
+// A wait set holds a reference to the fdio object behind each registered fd
+// until the fd is removed from the set, so the fd should be removed before
+// it is closed.
+typedef struct fdio_waitset fdio_waitset_t;
+
+// An fd that is ready.
+typedef struct fdio_waitset_event {
+    int fd;
+
+    // The FDIO_EVT_* events that the fd is ready for, among those it was
+    // registered for.
+    uint32_t events;
+
+    // The cookie that the fd was registered with.
+    void* cookie;
+} fdio_waitset_event_t;
+
+// Called on the dispatcher of a wait set created by
+// fdio_waitset_create_on_dispatcher() when a registered fd is ready.
+//
+// |status| is ZX_OK, or ZX_ERR_CANCELED if the dispatcher is shutting down,
+// in which case |event->events| is 0.
+typedef void(fdio_waitset_handler_t)(fdio_waitset_t* set,
+                                     zx_status_t status,
+                                     const fdio_waitset_event_t* event);
+
+// Creates a wait set that is waited on with fdio_waitset_wait().
+//
+// Its waits are edge-triggered: an fd is reported once each time one of its
+// events becomes pending, and not again until another one does, so the
+// caller should do the I/O until it would block before waiting again.
+zx_status_t fdio_waitset_create(fdio_waitset_t** out_set);
+
+// Creates a wait set that calls |handler| on |dispatcher| for each ready fd.
+//
+// The dispatcher's waits are one-shot, so the set rearms each fd after its
+// handler returns, and the handler is called again while the fd stays
+// ready: these waits are level-triggered.  The set must be used from the
+// dispatcher's thread, and destroyed before the dispatcher is.
+zx_status_t fdio_waitset_create_on_dispatcher(async_dispatcher_t* dispatcher,
+                                              fdio_waitset_handler_t* handler,
+                                              fdio_waitset_t** out_set);
+
+// Registers |fd| for the FDIO_EVT_* |events|, to be reported with |cookie|.
+// Registering an fd that is in the set already replaces its registration.
+//
+// Returns ZX_ERR_BAD_HANDLE if |fd| is not open, and ZX_ERR_NOT_SUPPORTED
+// if it cannot be waited on.
+zx_status_t fdio_waitset_add(fdio_waitset_t* set, int fd, uint32_t events,
+                             void* cookie);
+
+// Unregisters |fd|.  Returns ZX_ERR_NOT_FOUND if it is not in the set.
+zx_status_t fdio_waitset_remove(fdio_waitset_t* set, int fd);
+
+// Waits until at least one registered fd is ready or |deadline| passes, then
+// returns up to |capacity| ready fds in |events|, and their number in
+// |out_count|.
+//
+// Returns ZX_ERR_TIMED_OUT if no fd is ready by |deadline|, and
+// ZX_ERR_BAD_STATE for a wait set created on a dispatcher.  Thread-safe with
+// respect to fdio_waitset_add() and fdio_waitset_remove().
+zx_status_t fdio_waitset_wait(fdio_waitset_t* set, fdio_waitset_event_t* events,
+                              size_t capacity, zx_time_t deadline,
+                              size_t* out_count);
+
+// Unregisters every fd and frees |set|.
+void fdio_waitset_destroy(fdio_waitset_t* set);
+
+__END_CDECLS
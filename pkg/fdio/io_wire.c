@@ -0,0 +1,47 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "io_wire.h"
+
+#include <string.h>
+
+#include <lib/fdio/unsafe.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+
+zx_status_t fdio_wire_clone(int fd, uint32_t flags, zx_handle_t* out_channel) {
+    fdio_t* io = fdio_unsafe_fd_to_io(fd);
+    if (io == NULL)
+        return ZX_ERR_BAD_HANDLE;
+
+    // fdio borrows the socket of a socket, and nothing for a pipe.
+    zx_handle_t channel = fdio_unsafe_borrow_channel(io);
+    zx_info_handle_basic_t info;
+    zx_status_t status = ZX_ERR_NOT_SUPPORTED;
+    if (channel != ZX_HANDLE_INVALID &&
+        zx_object_get_info(channel, ZX_INFO_HANDLE_BASIC, &info, sizeof(info),
+                           NULL, NULL) == ZX_OK &&
+        info.type == ZX_OBJ_TYPE_CHANNEL) {
+        zx_handle_t client, server;
+        status = zx_channel_create(0u, &client, &server);
+        if (status == ZX_OK) {
+            // Clone is one-way, so this does not race with the calls fdio
+            // makes on the same channel.
+            fuchsia_io_NodeCloneRequest request;
+            memset(&request, 0, sizeof(request));
+            request.hdr.ordinal = fuchsia_io_NodeCloneOrdinal;
+            request.flags = flags;
+            request.object = FIDL_HANDLE_PRESENT;
+            status = zx_channel_write(channel, 0u, &request, sizeof(request),
+                                      &server, 1u);
+            if (status == ZX_OK) {
+                *out_channel = client;
+            } else {
+                zx_handle_close(client);
+            }
+        }
+    }
+    fdio_unsafe_release(io);
+    return status;
+}
@@ -0,0 +1,151 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+// The subset of the fuchsia.io wire format that the source parts of fdio
+// speak directly, for requests that the prebuilt library cannot pipeline.
+//
+// The names and ordinals match those of the C bindings that fidlc generates
+// for //fidl/fuchsia_io/io.fidl, which are not part of the SDK.
+
+#include <stdint.h>
+
+#include <zircon/compiler.h>
+#include <zircon/fidl.h>
+#include <zircon/types.h>
+
+#define fuchsia_io_OPEN_RIGHT_READABLE ((uint32_t)0x00000001u)
+#define fuchsia_io_OPEN_RIGHT_WRITABLE ((uint32_t)0x00000002u)
+#define fuchsia_io_OPEN_FLAG_DIRECTORY ((uint32_t)0x00080000u)
+#define fuchsia_io_OPEN_FLAG_NODE_REFERENCE ((uint32_t)0x00400000u)
+#define fuchsia_io_MAX_BUF ((uint64_t)8192u)
+#define fuchsia_io_MAX_FILENAME ((uint64_t)255u)
+
+#define fuchsia_io_NodeCloneOrdinal ((uint32_t)0x17fe6a4c)
+#define fuchsia_io_NodeGetAttrOrdinal ((uint32_t)0x4585e7c8)
+#define fuchsia_io_FileReadAtOrdinal ((uint32_t)0x7c724dc4)
+#define fuchsia_io_DirectoryOpenOrdinal ((uint32_t)0x77e4cceb)
+#define fuchsia_io_DirectoryReadDirentsOrdinal ((uint32_t)0x2ea53c2d)
+#define fuchsia_io_DirectoryWatchOrdinal ((uint32_t)0x5ac28f34)
+
+#define fuchsia_io_WATCH_EVENT_DELETED ((uint8_t)0u)
+#define fuchsia_io_WATCH_EVENT_ADDED ((uint8_t)1u)
+#define fuchsia_io_WATCH_EVENT_REMOVED ((uint8_t)2u)
+#define fuchsia_io_WATCH_EVENT_EXISTING ((uint8_t)3u)
+#define fuchsia_io_WATCH_EVENT_IDLE ((uint8_t)4u)
+
+#define fuchsia_io_WATCH_MASK_ADDED ((uint32_t)0x00000002u)
+#define fuchsia_io_WATCH_MASK_REMOVED ((uint32_t)0x00000004u)
+#define fuchsia_io_WATCH_MASK_EXISTING ((uint32_t)0x00000008u)
+#define fuchsia_io_WATCH_MASK_IDLE ((uint32_t)0x00000010u)
+
+typedef struct fuchsia_io_NodeAttributes {
+    uint32_t mode;
+    uint64_t id;
+    uint64_t content_size;
+    uint64_t storage_size;
+    uint64_t link_count;
+    uint64_t creation_time;
+    uint64_t modification_time;
+} fuchsia_io_NodeAttributes;
+
+typedef struct fuchsia_io_NodeCloneRequest {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    uint32_t flags;
+    zx_handle_t object;
+} fuchsia_io_NodeCloneRequest;
+
+typedef struct fuchsia_io_NodeGetAttrRequest {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+} fuchsia_io_NodeGetAttrRequest;
+
+typedef struct fuchsia_io_NodeGetAttrResponse {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    zx_status_t s;
+    fuchsia_io_NodeAttributes attributes;
+} fuchsia_io_NodeGetAttrResponse;
+
+typedef struct fuchsia_io_FileReadAtRequest {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    uint64_t count;
+    uint64_t offset;
+} fuchsia_io_FileReadAtRequest;
+
+typedef struct fuchsia_io_FileReadAtResponse {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    zx_status_t s;
+    fidl_vector_t data;
+} fuchsia_io_FileReadAtResponse;
+
+// Followed by the bytes of |path|, padded to FIDL_ALIGNMENT.
+typedef struct fuchsia_io_DirectoryOpenRequest {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    uint32_t flags;
+    uint32_t mode;
+    fidl_string_t path;
+    zx_handle_t object;
+} fuchsia_io_DirectoryOpenRequest;
+
+typedef struct fuchsia_io_DirectoryReadDirentsRequest {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    uint64_t max_bytes;
+} fuchsia_io_DirectoryReadDirentsRequest;
+
+// Followed by the bytes of |dirents|, a sequence of packed entries of the
+// form of |fuchsia_io_dirent_t|.
+typedef struct fuchsia_io_DirectoryReadDirentsResponse {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    zx_status_t s;
+    fidl_vector_t dirents;
+} fuchsia_io_DirectoryReadDirentsResponse;
+
+typedef struct fuchsia_io_DirectoryWatchRequest {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    uint32_t mask;
+    uint32_t options;
+    zx_handle_t watcher;
+} fuchsia_io_DirectoryWatchRequest;
+
+typedef struct fuchsia_io_DirectoryWatchResponse {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    zx_status_t s;
+} fuchsia_io_DirectoryWatchResponse;
+
+// The header of an event sent on a watcher channel, followed by the |len|
+// bytes of its unterminated name. The events of a message are packed one
+// after the other.
+typedef struct fuchsia_io_watched_event {
+    uint8_t event;
+    uint8_t len;
+} __PACKED fuchsia_io_watched_event_t;
+
+// The header of an entry returned by ReadDirents, followed by the |size|
+// bytes of its unterminated name.
+typedef struct fuchsia_io_dirent {
+    uint64_t ino;
+    uint8_t size;
+    uint8_t type;
+} __PACKED fuchsia_io_dirent_t;
+
+__BEGIN_CDECLS
+
+// Opens a new connection to the node that |fd| refers to, with |flags|,
+// by sending Node.Clone on the connection of |fd|.
+//
+// Returns ZX_ERR_NOT_SUPPORTED if |fd| is not backed by a fuchsia.io
+// channel, such as a pipe or a socket.
+zx_status_t fdio_wire_clone(int fd, uint32_t flags, zx_handle_t* out_channel);
+
+__END_CDECLS
@@ -0,0 +1,139 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/fdio/mapped_file.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <lib/fdio/io.h>
+#include <zircon/limits.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+
+static zx_status_t status_from_errno(int error) {
+    switch (error) {
+    case ENOENT:
+        return ZX_ERR_NOT_FOUND;
+    case EACCES:
+    case EPERM:
+        return ZX_ERR_ACCESS_DENIED;
+    case EISDIR:
+        return ZX_ERR_NOT_FILE;
+    case ENOTDIR:
+        return ZX_ERR_NOT_DIR;
+    case ENOMEM:
+        return ZX_ERR_NO_MEMORY;
+    case EINVAL:
+        return ZX_ERR_INVALID_ARGS;
+    default:
+        return ZX_ERR_IO;
+    }
+}
+
+// Maps a clone of the file's VMO, which shares its pages with the server.
+static zx_status_t map_vmo_clone(int fd, size_t len, zx_vaddr_t* out_addr) {
+    zx_handle_t vmo;
+    zx_status_t status = fdio_get_vmo_clone(fd, &vmo);
+    if (status != ZX_OK)
+        return status;
+    status = zx_vmar_map(zx_vmar_root_self(), ZX_VM_PERM_READ, 0u, vmo, 0u,
+                         len, out_addr);
+    zx_handle_close(vmo);
+    return status;
+}
+
+// Reads the file into a new VMO and maps it read-only.  Returns the number
+// of bytes read in |out_size|, which is less than |size| if the file shrank.
+static zx_status_t map_copy(int fd, size_t size, size_t len,
+                            zx_vaddr_t* out_addr, size_t* out_size) {
+    zx_handle_t vmo;
+    zx_status_t status = zx_vmo_create(len, 0u, &vmo);
+    if (status != ZX_OK)
+        return status;
+    zx_vaddr_t addr;
+    status = zx_vmar_map(zx_vmar_root_self(),
+                         ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, 0u, vmo, 0u, len,
+                         &addr);
+    zx_handle_close(vmo);
+    if (status != ZX_OK)
+        return status;
+
+    // Read straight into the mapping, so the bytes are copied only once.
+    size_t offset = 0u;
+    while (offset < size) {
+        ssize_t actual = pread(fd, (char*)addr + offset, size - offset,
+                               (off_t)offset);
+        if (actual < 0) {
+            if (errno == EINTR)
+                continue;
+            status = status_from_errno(errno);
+            break;
+        }
+        if (actual == 0)
+            break;
+        offset += (size_t)actual;
+    }
+    if (status == ZX_OK)
+        status = zx_vmar_protect(zx_vmar_root_self(), ZX_VM_PERM_READ, addr,
+                                 len);
+    if (status != ZX_OK) {
+        zx_vmar_unmap(zx_vmar_root_self(), addr, len);
+        return status;
+    }
+    *out_addr = addr;
+    *out_size = offset;
+    return ZX_OK;
+}
+
+zx_status_t fdio_map_fd(int fd, fdio_mapped_file_t* out_file) {
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+        return status_from_errno(errno);
+    if (!S_ISREG(st.st_mode))
+        return ZX_ERR_NOT_FILE;
+
+    memset(out_file, 0, sizeof(*out_file));
+    if (st.st_size <= 0)
+        return ZX_OK;
+    if ((uint64_t)st.st_size > SIZE_MAX - ZX_PAGE_SIZE)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    size_t size = (size_t)st.st_size;
+    size_t len = (size + ZX_PAGE_SIZE - 1u) & ~(size_t)ZX_PAGE_MASK;
+    zx_vaddr_t addr;
+    zx_status_t status = map_vmo_clone(fd, len, &addr);
+    if (status != ZX_OK) {
+        // The server cannot share the file's VMO, or its VMO is smaller than
+        // the file claims to be.
+        status = map_copy(fd, size, len, &addr, &size);
+        if (status != ZX_OK)
+            return status;
+    }
+
+    out_file->data = size ? (const void*)addr : NULL;
+    out_file->size = size;
+    out_file->mapping_addr = addr;
+    out_file->mapping_len = len;
+    return ZX_OK;
+}
+
+zx_status_t fdio_map_file(const char* path, fdio_mapped_file_t* out_file) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return status_from_errno(errno);
+    zx_status_t status = fdio_map_fd(fd, out_file);
+    close(fd);
+    return status;
+}
+
+void fdio_unmap_file(fdio_mapped_file_t* file) {
+    if (file->mapping_len)
+        zx_vmar_unmap(zx_vmar_root_self(), file->mapping_addr,
+                      file->mapping_len);
+    memset(file, 0, sizeof(*file));
+}
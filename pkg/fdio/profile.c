@@ -0,0 +1,311 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef _ALL_SOURCE
+#define _ALL_SOURCE // Enables MTX_INIT in <threads.h>.
+#endif
+
+#include <lib/fdio/profile.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include <lib/fdio/util.h>
+#include <trace-engine/context.h>
+#include <trace-engine/instrumentation.h>
+#include <zircon/fidl.h>
+#include <zircon/syscalls.h>
+
+#define PROFILE_CATEGORY "fdio:startup"
+
+// fuchsia.ldsvc.Loader.LoadObject, whose ordinal is explicit in the library.
+#define LDSVC_LOAD_OBJECT_ORDINAL ((uint32_t)2u)
+#define LDSVC_MAX_NAME ((size_t)1024u)
+
+typedef struct ldsvc_load_object_msg {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    fidl_string_t object_name;
+} ldsvc_load_object_msg_t;
+
+typedef struct ldsvc_load_object_reply {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    zx_status_t rv;
+    zx_handle_t object;
+} ldsvc_load_object_reply_t;
+
+// Read without the lock on every instrumented operation.
+static uint32_t g_options;
+
+static mtx_t g_lock = MTX_INIT;
+static fdio_profile_record_t* g_records; // guarded by g_lock
+static size_t g_capacity;                // guarded by g_lock
+static size_t g_written;                 // guarded by g_lock
+static size_t g_read;                    // guarded by g_lock
+
+static const char* op_name(fdio_profile_op_t op) {
+    switch (op) {
+    case FDIO_PROFILE_OP_NS_BIND:
+        return "ns_bind";
+    case FDIO_PROFILE_OP_NS_INSTALL:
+        return "ns_install";
+    case FDIO_PROFILE_OP_LDSVC_LOAD_OBJECT:
+        return "ldsvc_load_object";
+    case FDIO_PROFILE_OP_LDSVC_CLONE:
+        return "ldsvc_clone";
+    case FDIO_PROFILE_OP_SERVICE_CONNECT:
+        return "service_connect";
+    default:
+        return "unknown";
+    }
+}
+
+zx_status_t fdio_profile_enable(uint32_t options, size_t capacity) {
+    options &= FDIO_PROFILE_RECORD | FDIO_PROFILE_TRACE;
+    if (options == 0u || ((options & FDIO_PROFILE_RECORD) && capacity == 0u))
+        return ZX_ERR_INVALID_ARGS;
+
+    fdio_profile_record_t* records = NULL;
+    if (options & FDIO_PROFILE_RECORD) {
+        records = calloc(capacity, sizeof(*records));
+        if (records == NULL)
+            return ZX_ERR_NO_MEMORY;
+    } else {
+        capacity = 0u;
+    }
+
+    mtx_lock(&g_lock);
+    free(g_records);
+    g_records = records;
+    g_capacity = capacity;
+    g_written = 0u;
+    g_read = 0u;
+    __atomic_store_n(&g_options, options, __ATOMIC_RELAXED);
+    mtx_unlock(&g_lock);
+    return ZX_OK;
+}
+
+void fdio_profile_disable(void) {
+    __atomic_store_n(&g_options, 0u, __ATOMIC_RELAXED);
+}
+
+size_t fdio_profile_read(fdio_profile_record_t* records, size_t count,
+                         size_t* out_dropped) {
+    mtx_lock(&g_lock);
+    size_t oldest = g_written > g_capacity ? g_written - g_capacity : 0u;
+    size_t dropped = 0u;
+    if (g_read < oldest) {
+        dropped = oldest - g_read;
+        g_read = oldest;
+    }
+    size_t copied = 0u;
+    for (; copied < count && g_read < g_written; ++copied, ++g_read)
+        records[copied] = g_records[g_read % g_capacity];
+    mtx_unlock(&g_lock);
+    if (out_dropped != NULL)
+        *out_dropped = dropped;
+    return copied;
+}
+
+void fdio_profile_dump(int fd) {
+    struct {
+        zx_ticks_t duration;
+        uint64_t round_trips;
+        size_t count;
+    } totals[FDIO_PROFILE_OP_SERVICE_CONNECT + 1u];
+    memset(totals, 0, sizeof(totals));
+    zx_ticks_t ticks_per_us = zx_ticks_per_second() / 1000000;
+    if (ticks_per_us == 0)
+        ticks_per_us = 1;
+
+    mtx_lock(&g_lock);
+    size_t first = g_written > g_capacity ? g_written - g_capacity : 0u;
+    for (size_t i = first; i < g_written; ++i) {
+        const fdio_profile_record_t* record = &g_records[i % g_capacity];
+        dprintf(fd, "%-18s %8" PRId64 " us %3u rt %5d %s\n",
+                op_name(record->op), record->duration / ticks_per_us,
+                record->round_trips, record->status, record->path);
+        if (record->op <= FDIO_PROFILE_OP_SERVICE_CONNECT) {
+            totals[record->op].duration += record->duration;
+            totals[record->op].round_trips += record->round_trips;
+            totals[record->op].count++;
+        }
+    }
+    if (first > 0u)
+        dprintf(fd, "(%zu earlier records were replaced)\n", first);
+    mtx_unlock(&g_lock);
+
+    for (fdio_profile_op_t op = 1u; op <= FDIO_PROFILE_OP_SERVICE_CONNECT;
+         ++op) {
+        if (totals[op].count == 0u)
+            continue;
+        dprintf(fd, "total %-12s %8" PRId64 " us %5" PRIu64 " rt %5zu ops\n",
+                op_name(op), totals[op].duration / ticks_per_us,
+                totals[op].round_trips, totals[op].count);
+    }
+}
+
+// Instrumentation ------------------------------------------------------------
+
+zx_ticks_t fdio_profile_begin(void) {
+    if (__atomic_load_n(&g_options, __ATOMIC_RELAXED) == 0u)
+        return 0;
+    return zx_ticks_get();
+}
+
+static void emit_trace_event(fdio_profile_op_t op, const char* path,
+                             zx_ticks_t start, zx_ticks_t end,
+                             uint32_t round_trips, zx_status_t status) {
+    trace_string_ref_t category_ref;
+    trace_context_t* context =
+        trace_acquire_context_for_category(PROFILE_CATEGORY, &category_ref);
+    if (context == NULL)
+        return;
+
+    trace_thread_ref_t thread_ref;
+    trace_string_ref_t name_ref;
+    trace_context_register_current_thread(context, &thread_ref);
+    trace_context_register_string_literal(context, op_name(op), &name_ref);
+
+    trace_string_ref_t path_name_ref, round_trips_name_ref, status_name_ref;
+    trace_context_register_string_literal(context, "path", &path_name_ref);
+    trace_context_register_string_literal(context, "round_trips",
+                                          &round_trips_name_ref);
+    trace_context_register_string_literal(context, "status",
+                                          &status_name_ref);
+    trace_arg_t args[] = {
+        trace_make_arg(path_name_ref, trace_make_string_arg_value(
+                                          trace_make_inline_c_string_ref(path))),
+        trace_make_arg(round_trips_name_ref,
+                       trace_make_uint32_arg_value(round_trips)),
+        trace_make_arg(status_name_ref, trace_make_int32_arg_value(status)),
+    };
+    trace_context_write_duration_event_record(
+        context, start, end, &thread_ref, &category_ref, &name_ref, args,
+        sizeof(args) / sizeof(args[0]));
+    trace_release_context(context);
+}
+
+void fdio_profile_end(fdio_profile_op_t op, const char* path,
+                      zx_ticks_t start, uint32_t round_trips,
+                      zx_status_t status) {
+    if (start == 0)
+        return;
+    zx_ticks_t end = zx_ticks_get();
+    if (path == NULL)
+        path = "";
+
+    uint32_t options = __atomic_load_n(&g_options, __ATOMIC_RELAXED);
+    if (options & FDIO_PROFILE_TRACE)
+        emit_trace_event(op, path, start, end, round_trips, status);
+    if (!(options & FDIO_PROFILE_RECORD))
+        return;
+
+    mtx_lock(&g_lock);
+    if (g_capacity > 0u) {
+        fdio_profile_record_t* record = &g_records[g_written++ % g_capacity];
+        record->op = op;
+        record->status = status;
+        record->start = start;
+        record->duration = end - start;
+        record->round_trips = round_trips;
+        strncpy(record->path, path, sizeof(record->path) - 1u);
+        record->path[sizeof(record->path) - 1u] = '\0';
+    }
+    mtx_unlock(&g_lock);
+}
+
+// Instrumented wrappers ------------------------------------------------------
+
+zx_status_t fdio_profile_ns_bind(fdio_ns_t* ns, const char* path,
+                                 zx_handle_t h) {
+    zx_ticks_t start = fdio_profile_begin();
+    zx_status_t status = fdio_ns_bind(ns, path, h);
+    fdio_profile_end(FDIO_PROFILE_OP_NS_BIND, path, start, 0u, status);
+    return status;
+}
+
+zx_status_t fdio_profile_ns_install(fdio_ns_t* ns) {
+    zx_ticks_t start = fdio_profile_begin();
+    zx_status_t status = fdio_ns_install(ns);
+    fdio_profile_end(FDIO_PROFILE_OP_NS_INSTALL, "/", start, 0u, status);
+    return status;
+}
+
+zx_status_t fdio_profile_service_connect(const char* svcpath, zx_handle_t h) {
+    zx_ticks_t start = fdio_profile_begin();
+    zx_status_t status = fdio_service_connect(svcpath, h);
+    fdio_profile_end(FDIO_PROFILE_OP_SERVICE_CONNECT, svcpath, start, 0u,
+                     status);
+    return status;
+}
+
+zx_status_t fdio_profile_service_connect_at(zx_handle_t dir, const char* path,
+                                            zx_handle_t h) {
+    zx_ticks_t start = fdio_profile_begin();
+    zx_status_t status = fdio_service_connect_at(dir, path, h);
+    fdio_profile_end(FDIO_PROFILE_OP_SERVICE_CONNECT, path, start, 0u,
+                     status);
+    return status;
+}
+
+zx_status_t fdio_profile_loader_load_object(zx_handle_t loader,
+                                            const char* name,
+                                            zx_handle_t* out_vmo) {
+    zx_ticks_t start = fdio_profile_begin();
+    size_t length = name ? strlen(name) : 0u;
+    if (length == 0u || length > LDSVC_MAX_NAME) {
+        fdio_profile_end(FDIO_PROFILE_OP_LDSVC_LOAD_OBJECT, name, start, 0u,
+                         ZX_ERR_INVALID_ARGS);
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    struct {
+        ldsvc_load_object_msg_t msg;
+        char name[FIDL_ALIGN(LDSVC_MAX_NAME)];
+    } request;
+    memset(&request, 0, sizeof(request.msg) + FIDL_ALIGN(length));
+    request.msg.hdr.ordinal = LDSVC_LOAD_OBJECT_ORDINAL;
+    request.msg.object_name.size = length;
+    request.msg.object_name.data = (char*)FIDL_ALLOC_PRESENT;
+    memcpy(request.name, name, length);
+
+    ldsvc_load_object_reply_t reply;
+    zx_handle_t handle = ZX_HANDLE_INVALID;
+    zx_channel_call_args_t args = {
+        .wr_bytes = &request,
+        .wr_handles = NULL,
+        .rd_bytes = &reply,
+        .rd_handles = &handle,
+        .wr_num_bytes = (uint32_t)(sizeof(request.msg) + FIDL_ALIGN(length)),
+        .wr_num_handles = 0u,
+        .rd_num_bytes = sizeof(reply),
+        .rd_num_handles = 1u,
+    };
+    uint32_t actual_bytes, actual_handles;
+    zx_status_t status = zx_channel_call(loader, 0u, ZX_TIME_INFINITE, &args,
+                                         &actual_bytes, &actual_handles);
+    if (status == ZX_OK) {
+        if (actual_bytes != sizeof(reply) ||
+            reply.hdr.ordinal != LDSVC_LOAD_OBJECT_ORDINAL) {
+            status = ZX_ERR_IO;
+        } else if (reply.rv != ZX_OK) {
+            status = reply.rv;
+        } else if (actual_handles != 1u) {
+            status = ZX_ERR_IO;
+        }
+    }
+    if (status == ZX_OK) {
+        *out_vmo = handle;
+    } else {
+        zx_handle_close(handle);
+    }
+    fdio_profile_end(FDIO_PROFILE_OP_LDSVC_LOAD_OBJECT, name, start, 1u,
+                     status);
+    return status;
+}
@@ -0,0 +1,251 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/fdio/readahead.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <zircon/syscalls.h>
+
+#include "io_wire.h"
+
+#define CHUNK_SIZE fuchsia_io_MAX_BUF
+
+// The largest reply to a ReadAt call of CHUNK_SIZE bytes.
+#define MAX_REPLY_SIZE (sizeof(fuchsia_io_FileReadAtResponse) + CHUNK_SIZE)
+
+typedef struct readahead_slot {
+    // The transaction of the request for this slot, or 0 if the slot is
+    // free.
+    zx_txid_t txid;
+    uint64_t offset;
+    bool received;
+
+    // The reply, once received.
+    zx_status_t status;
+    uint32_t actual;
+    uint32_t consumed;
+    union {
+        fuchsia_io_FileReadAtResponse response;
+        uint8_t bytes[MAX_REPLY_SIZE];
+    } reply;
+} readahead_slot_t;
+
+struct fdio_readahead {
+    zx_handle_t channel;
+    zx_status_t status;
+    zx_txid_t last_txid;
+
+    // The slots in use form a ring of requests for consecutive chunks,
+    // starting at |head|.
+    uint32_t depth;
+    uint32_t head;
+    uint32_t in_flight;
+
+    // The offset of the next request to issue.
+    uint64_t request_offset;
+    bool eof;
+
+    readahead_slot_t slots[];
+};
+
+static zx_txid_t next_txid(fdio_readahead_t* reader) {
+    // Never 0, and never reused by requests still in the channel.
+    reader->last_txid = (reader->last_txid + 1u) & 0x7fffffffu;
+    if (reader->last_txid == 0u)
+        reader->last_txid = 1u;
+    return reader->last_txid;
+}
+
+static zx_status_t issue(fdio_readahead_t* reader) {
+    readahead_slot_t* slot =
+        &reader->slots[(reader->head + reader->in_flight) % reader->depth];
+    fuchsia_io_FileReadAtRequest request;
+    memset(&request, 0, sizeof(request));
+    request.hdr.txid = next_txid(reader);
+    request.hdr.ordinal = fuchsia_io_FileReadAtOrdinal;
+    request.count = CHUNK_SIZE;
+    request.offset = reader->request_offset;
+    zx_status_t status = zx_channel_write(reader->channel, 0u, &request,
+                                          sizeof(request), NULL, 0u);
+    if (status != ZX_OK)
+        return status;
+    slot->txid = request.hdr.txid;
+    slot->offset = request.offset;
+    slot->received = false;
+    reader->in_flight++;
+    reader->request_offset += CHUNK_SIZE;
+    return ZX_OK;
+}
+
+static readahead_slot_t* find_slot(fdio_readahead_t* reader, zx_txid_t txid) {
+    for (uint32_t i = 0; i < reader->in_flight; ++i) {
+        readahead_slot_t* slot =
+            &reader->slots[(reader->head + i) % reader->depth];
+        if (slot->txid == txid)
+            return slot;
+    }
+    return NULL;
+}
+
+static zx_status_t decode(readahead_slot_t* slot, uint32_t actual_bytes) {
+    const fuchsia_io_FileReadAtResponse* response = &slot->reply.response;
+    if (actual_bytes < sizeof(*response) ||
+        response->hdr.ordinal != fuchsia_io_FileReadAtOrdinal)
+        return ZX_ERR_IO;
+    slot->received = true;
+    slot->status = response->s;
+    slot->actual = 0u;
+    slot->consumed = 0u;
+    if (slot->status != ZX_OK)
+        return ZX_OK;
+    if (response->data.count > CHUNK_SIZE ||
+        (uintptr_t)response->data.data != FIDL_ALLOC_PRESENT ||
+        actual_bytes < sizeof(*response) + FIDL_ALIGN(response->data.count))
+        return ZX_ERR_IO;
+    slot->actual = (uint32_t)response->data.count;
+    return ZX_OK;
+}
+
+// Waits for the reply to the request of |slot|, and stores replies to other
+// requests in flight that arrive first in their own slots.
+static zx_status_t receive(fdio_readahead_t* reader, readahead_slot_t* slot) {
+    while (!slot->received) {
+        zx_signals_t observed;
+        zx_status_t status = zx_object_wait_one(
+            reader->channel, ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED,
+            ZX_TIME_INFINITE, &observed);
+        if (status != ZX_OK)
+            return status;
+
+        // Replies should arrive in order, straight into their slot.
+        uint32_t actual_bytes, actual_handles;
+        status = zx_channel_read(reader->channel, 0u, slot->reply.bytes, NULL,
+                                 sizeof(slot->reply), 0u, &actual_bytes,
+                                 &actual_handles);
+        if (status == ZX_ERR_SHOULD_WAIT)
+            continue;
+        if (status != ZX_OK)
+            return status == ZX_ERR_BUFFER_TOO_SMALL ? ZX_ERR_IO : status;
+        if (actual_bytes < sizeof(fidl_message_header_t))
+            return ZX_ERR_IO;
+
+        zx_txid_t txid = slot->reply.response.hdr.txid;
+        readahead_slot_t* target = find_slot(reader, txid);
+        if (target == NULL)
+            continue; // The reply to a request issued before a seek.
+        if (target != slot)
+            memcpy(target->reply.bytes, slot->reply.bytes, actual_bytes);
+        status = decode(target, actual_bytes);
+        if (status != ZX_OK)
+            return status;
+    }
+    return ZX_OK;
+}
+
+// Frees the slots of all requests in flight.  Their replies are discarded
+// as they arrive.
+static void discard(fdio_readahead_t* reader) {
+    for (uint32_t i = 0; i < reader->depth; ++i)
+        reader->slots[i].txid = 0u;
+    reader->head = 0u;
+    reader->in_flight = 0u;
+}
+
+zx_status_t fdio_readahead_create(int fd, uint32_t depth,
+                                  fdio_readahead_t** out_reader) {
+    if (depth == 0u || depth > FDIO_READAHEAD_MAX_DEPTH)
+        return ZX_ERR_INVALID_ARGS;
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    if (offset < 0)
+        return errno == EBADF ? ZX_ERR_BAD_HANDLE : ZX_ERR_NOT_SUPPORTED;
+
+    fdio_readahead_t* reader =
+        calloc(1, sizeof(*reader) + depth * sizeof(readahead_slot_t));
+    if (reader == NULL)
+        return ZX_ERR_NO_MEMORY;
+    zx_status_t status = fdio_wire_clone(fd, fuchsia_io_OPEN_RIGHT_READABLE,
+                                         &reader->channel);
+    if (status != ZX_OK) {
+        free(reader);
+        return status;
+    }
+    reader->status = ZX_OK;
+    reader->depth = depth;
+    reader->request_offset = (uint64_t)offset;
+    *out_reader = reader;
+    return ZX_OK;
+}
+
+zx_status_t fdio_readahead_read(fdio_readahead_t* reader, void* buffer,
+                                size_t capacity, size_t* out_actual) {
+    size_t actual = 0u;
+    while (reader->status == ZX_OK && actual < capacity) {
+        while (!reader->eof && reader->in_flight < reader->depth) {
+            reader->status = issue(reader);
+            if (reader->status != ZX_OK)
+                break;
+        }
+        if (reader->status != ZX_OK || reader->in_flight == 0u)
+            break;
+
+        readahead_slot_t* slot = &reader->slots[reader->head];
+        reader->status = receive(reader, slot);
+        if (reader->status == ZX_OK)
+            reader->status = slot->status;
+        if (reader->status != ZX_OK)
+            break;
+
+        size_t count = slot->actual - slot->consumed;
+        if (count > capacity - actual)
+            count = capacity - actual;
+        memcpy((uint8_t*)buffer + actual,
+               slot->reply.bytes + sizeof(fuchsia_io_FileReadAtResponse) +
+                   slot->consumed,
+               count);
+        actual += count;
+        slot->consumed += (uint32_t)count;
+        if (slot->consumed < slot->actual)
+            break;
+
+        bool short_read = slot->actual < CHUNK_SIZE;
+        uint64_t end = slot->offset + slot->actual;
+        slot->txid = 0u;
+        reader->head = (reader->head + 1u) % reader->depth;
+        reader->in_flight--;
+        if (short_read) {
+            // Either the end of the file, or a server that returned less
+            // than it was asked for.  Either way, the requests after this one
+            // are for the wrong offsets, so reissue them from here, and stop
+            // once the server returns nothing.
+            discard(reader);
+            reader->request_offset = end;
+            reader->eof = slot->actual == 0u;
+        }
+    }
+
+    if (actual > 0u) {
+        // Return what was read, and any error on the next read.
+        *out_actual = actual;
+        return ZX_OK;
+    }
+    *out_actual = 0u;
+    return reader->status;
+}
+
+void fdio_readahead_seek(fdio_readahead_t* reader, uint64_t offset) {
+    discard(reader);
+    reader->status = ZX_OK;
+    reader->request_offset = offset;
+    reader->eof = false;
+}
+
+void fdio_readahead_destroy(fdio_readahead_t* reader) {
+    zx_handle_close(reader->channel);
+    free(reader);
+}
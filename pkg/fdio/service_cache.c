@@ -0,0 +1,162 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef _ALL_SOURCE
+#define _ALL_SOURCE // Enables MTX_INIT in <threads.h>.
+#endif
+
+#include <lib/fdio/service_cache.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include <lib/fdio/profile.h>
+#include <lib/fdio/util.h>
+#include <zircon/syscalls.h>
+
+#include "io_wire.h"
+
+// The rights fdio_service_connect() opens services with, which the
+// directory needs for its children to be opened with them too.
+#define SERVICE_DIR_FLAGS \
+    (fuchsia_io_OPEN_RIGHT_READABLE | fuchsia_io_OPEN_RIGHT_WRITABLE | \
+     fuchsia_io_OPEN_FLAG_DIRECTORY)
+
+typedef struct service_dir {
+    char* path;
+    zx_handle_t channel;
+} service_dir_t;
+
+static mtx_t g_lock = MTX_INIT;
+static service_dir_t g_dirs[FDIO_SERVICE_CACHE_SIZE]; // guarded by g_lock
+static size_t g_next_victim;                          // guarded by g_lock
+
+static void evict_locked(service_dir_t* dir) {
+    free(dir->path);
+    dir->path = NULL;
+    zx_handle_close(dir->channel);
+    dir->channel = ZX_HANDLE_INVALID;
+}
+
+static bool is_open(zx_handle_t channel) {
+    zx_signals_t pending;
+    return zx_object_wait_one(channel, ZX_CHANNEL_PEER_CLOSED, 0u,
+                              &pending) == ZX_ERR_TIMED_OUT;
+}
+
+// Returns a borrowed connection to the directory at |path|, |length| bytes
+// long, opening and caching one if needed.  Must be called with g_lock held.
+static zx_status_t resolve_locked(const char* path, size_t length,
+                                  zx_handle_t* out_channel) {
+    for (size_t i = 0; i < FDIO_SERVICE_CACHE_SIZE; ++i) {
+        service_dir_t* dir = &g_dirs[i];
+        if (dir->path == NULL || strncmp(dir->path, path, length) != 0 ||
+            dir->path[length] != '\0')
+            continue;
+        if (is_open(dir->channel)) {
+            *out_channel = dir->channel;
+            return ZX_OK;
+        }
+        // The server went away, so resolve the path again.
+        evict_locked(dir);
+    }
+
+    char* key = strndup(path, length);
+    if (key == NULL)
+        return ZX_ERR_NO_MEMORY;
+    zx_handle_t client, server;
+    zx_status_t status = zx_channel_create(0u, &client, &server);
+    if (status == ZX_OK) {
+        status = fdio_open(key, SERVICE_DIR_FLAGS, server);
+        if (status != ZX_OK)
+            zx_handle_close(client);
+    }
+    if (status != ZX_OK) {
+        free(key);
+        return status;
+    }
+
+    service_dir_t* dir = NULL;
+    for (size_t i = 0; i < FDIO_SERVICE_CACHE_SIZE && dir == NULL; ++i) {
+        if (g_dirs[i].path == NULL)
+            dir = &g_dirs[i];
+    }
+    if (dir == NULL) {
+        dir = &g_dirs[g_next_victim];
+        g_next_victim = (g_next_victim + 1u) % FDIO_SERVICE_CACHE_SIZE;
+        evict_locked(dir);
+    }
+    dir->path = key;
+    dir->channel = client;
+    *out_channel = client;
+    return ZX_OK;
+}
+
+zx_status_t fdio_service_connect_cached(const char* svcpath, zx_handle_t h) {
+    zx_ticks_t start = fdio_profile_begin();
+    const char* slash = svcpath ? strrchr(svcpath, '/') : NULL;
+    if (slash == NULL || svcpath[0] != '/' || slash[1] == '\0') {
+        zx_handle_close(h);
+        return ZX_ERR_INVALID_ARGS;
+    }
+    // The directory of "/name" is "/".
+    size_t length = slash == svcpath ? 1u : (size_t)(slash - svcpath);
+
+    mtx_lock(&g_lock);
+    zx_handle_t dir;
+    zx_status_t status = resolve_locked(svcpath, length, &dir);
+    if (status == ZX_OK) {
+        status = fdio_service_connect_at(dir, slash + 1, h);
+    } else {
+        zx_handle_close(h);
+    }
+    mtx_unlock(&g_lock);
+    fdio_profile_end(FDIO_PROFILE_OP_SERVICE_CONNECT, svcpath, start, 0u,
+                     status);
+    return status;
+}
+
+zx_status_t fdio_service_connect_many(const char* dirpath,
+                                      const fdio_service_connection_t* services,
+                                      size_t count) {
+    zx_ticks_t start = fdio_profile_begin();
+    zx_status_t status = ZX_ERR_INVALID_ARGS;
+    size_t length = dirpath ? strlen(dirpath) : 0u;
+    // Look up "/svc/" as "/svc".
+    while (length > 1u && dirpath[length - 1u] == '/')
+        length--;
+
+    mtx_lock(&g_lock);
+    zx_handle_t dir = ZX_HANDLE_INVALID;
+    if (length > 0u && dirpath[0] == '/')
+        status = resolve_locked(dirpath, length, &dir);
+    for (size_t i = 0; i < count; ++i) {
+        if (dir == ZX_HANDLE_INVALID) {
+            zx_handle_close(services[i].request);
+            continue;
+        }
+        // Each connection is a single one-way write, so they all reach the
+        // server back to back.
+        zx_status_t connect_status = fdio_service_connect_at(
+            dir, services[i].name, services[i].request);
+        if (status == ZX_OK)
+            status = connect_status;
+    }
+    mtx_unlock(&g_lock);
+    fdio_profile_end(FDIO_PROFILE_OP_SERVICE_CONNECT, dirpath, start, 0u,
+                     status);
+    return status;
+}
+
+void fdio_service_cache_flush(void) {
+    mtx_lock(&g_lock);
+    for (size_t i = 0; i < FDIO_SERVICE_CACHE_SIZE; ++i) {
+        if (g_dirs[i].path != NULL)
+            evict_locked(&g_dirs[i]);
+    }
+    g_next_victim = 0u;
+    mtx_unlock(&g_lock);
+}
@@ -0,0 +1,219 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/fdio/spawn_template.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <unistd.h>
+
+#include <lib/fdio/io.h>
+#include <lib/fdio/namespace.h>
+#include <lib/fdio/profile.h>
+#include <lib/fdio/util.h>
+#include <zircon/dlfcn.h>
+#include <zircon/fidl.h>
+#include <zircon/processargs.h>
+#include <zircon/syscalls.h>
+
+// fuchsia.ldsvc.Loader.Clone, whose ordinal is explicit in the library.
+#define LDSVC_CLONE_ORDINAL ((uint32_t)5u)
+
+typedef struct ldsvc_clone_msg {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    zx_handle_t loader;
+} ldsvc_clone_msg_t;
+
+typedef struct ldsvc_clone_reply {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    zx_status_t rv;
+} ldsvc_clone_reply_t;
+
+struct fdio_spawn_template {
+    uint32_t flags;
+    zx_handle_t executable;
+    zx_handle_t loader;
+    fdio_flat_namespace_t* ns;
+
+    mtx_t lock; // guards the loader channel
+};
+
+static void report(char* err_msg_out, const char* what, zx_status_t status) {
+    if (err_msg_out != NULL)
+        snprintf(err_msg_out, FDIO_SPAWN_ERR_MSG_MAX_LENGTH, "%s: %d", what,
+                 status);
+}
+
+// Closes the handles that |actions| would have passed to fdio_spawn_vmo,
+// which consumes them, when it is not reached.
+static void close_action_handles(size_t action_count,
+                                 const fdio_spawn_action_t* actions) {
+    for (size_t i = 0; i < action_count; ++i) {
+        if (actions[i].action == FDIO_SPAWN_ACTION_ADD_NS_ENTRY)
+            zx_handle_close(actions[i].ns.handle);
+        else if (actions[i].action == FDIO_SPAWN_ACTION_ADD_HANDLE)
+            zx_handle_close(actions[i].h.handle);
+    }
+}
+
+// Sends Loader.Clone for a new connection to the loader of the template,
+// without waiting for the reply, which reports nothing the new connection
+// would not.  The replies to previous clones are discarded first.
+static zx_status_t clone_loader(fdio_spawn_template_t* tmpl,
+                                zx_handle_t* out_loader) {
+    zx_ticks_t start = fdio_profile_begin();
+    zx_handle_t client, server;
+    zx_status_t status = zx_channel_create(0u, &client, &server);
+    if (status != ZX_OK) {
+        fdio_profile_end(FDIO_PROFILE_OP_LDSVC_CLONE, NULL, start, 0u, status);
+        return status;
+    }
+
+    mtx_lock(&tmpl->lock);
+    ldsvc_clone_reply_t reply;
+    uint32_t actual_bytes, actual_handles;
+    while (zx_channel_read(tmpl->loader, 0u, &reply, NULL, sizeof(reply), 0u,
+                           &actual_bytes, &actual_handles) == ZX_OK)
+        continue;
+
+    ldsvc_clone_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.hdr.txid = 1u;
+    msg.hdr.ordinal = LDSVC_CLONE_ORDINAL;
+    msg.loader = FIDL_HANDLE_PRESENT;
+    status = zx_channel_write(tmpl->loader, 0u, &msg, sizeof(msg), &server,
+                              1u);
+    mtx_unlock(&tmpl->lock);
+    fdio_profile_end(FDIO_PROFILE_OP_LDSVC_CLONE, NULL, start, 0u, status);
+
+    if (status != ZX_OK) {
+        zx_handle_close(client);
+        return status;
+    }
+    *out_loader = client;
+    return ZX_OK;
+}
+
+zx_status_t fdio_spawn_template_create(uint32_t flags,
+                                       const char* path,
+                                       fdio_spawn_template_t** out_template) {
+    fdio_spawn_template_t* tmpl = calloc(1, sizeof(*tmpl));
+    if (tmpl == NULL)
+        return ZX_ERR_NO_MEMORY;
+    tmpl->flags = flags;
+    tmpl->executable = ZX_HANDLE_INVALID;
+    tmpl->loader = ZX_HANDLE_INVALID;
+    mtx_init(&tmpl->lock, mtx_plain);
+
+    zx_status_t status = ZX_ERR_NOT_FOUND;
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        status = fdio_get_vmo_clone(fd, &tmpl->executable);
+        close(fd);
+    }
+    if (status == ZX_OK) {
+        const char* name = strrchr(path, '/');
+        name = name ? name + 1 : path;
+        zx_object_set_property(tmpl->executable, ZX_PROP_NAME, name,
+                               strlen(name));
+    }
+    if (status == ZX_OK && (flags & FDIO_SPAWN_DEFAULT_LDSVC))
+        status = dl_clone_loader_service(&tmpl->loader);
+    if (status == ZX_OK && (flags & FDIO_SPAWN_CLONE_NAMESPACE))
+        status = fdio_ns_export_root(&tmpl->ns);
+    if (status != ZX_OK) {
+        fdio_spawn_template_destroy(tmpl);
+        return status;
+    }
+    *out_template = tmpl;
+    return ZX_OK;
+}
+
+zx_status_t fdio_spawn_template_launch(fdio_spawn_template_t* tmpl,
+                                       zx_handle_t job,
+                                       const char* const* argv,
+                                       const char* const* environ,
+                                       size_t action_count,
+                                       const fdio_spawn_action_t* actions,
+                                       zx_handle_t* process_out,
+                                       char err_msg_out[FDIO_SPAWN_ERR_MSG_MAX_LENGTH]) {
+    size_t ns_count = tmpl->ns ? tmpl->ns->count : 0u;
+    size_t total = ns_count + 1u + action_count;
+    fdio_spawn_action_t* all = calloc(total, sizeof(*all));
+    if (all == NULL) {
+        close_action_handles(action_count, actions);
+        report(err_msg_out, "out of memory", ZX_ERR_NO_MEMORY);
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // Clones of the namespace and loader are pipelined: the servers bind
+    // them while the process is created.
+    size_t count = 0u;
+    zx_status_t status = ZX_OK;
+    for (size_t i = 0; i < ns_count && status == ZX_OK; ++i) {
+        zx_handle_t dir = fdio_service_clone(tmpl->ns->handle[i]);
+        if (dir == ZX_HANDLE_INVALID) {
+            status = ZX_ERR_BAD_HANDLE;
+            report(err_msg_out, "failed to clone namespace", status);
+            break;
+        }
+        all[count].action = FDIO_SPAWN_ACTION_ADD_NS_ENTRY;
+        all[count].ns.prefix = tmpl->ns->path[i];
+        all[count].ns.handle = dir;
+        ++count;
+    }
+    if (status == ZX_OK && tmpl->loader != ZX_HANDLE_INVALID) {
+        zx_handle_t loader;
+        status = clone_loader(tmpl, &loader);
+        if (status == ZX_OK) {
+            all[count].action = FDIO_SPAWN_ACTION_ADD_HANDLE;
+            all[count].h.id = PA_HND(PA_LDSVC_LOADER, 0);
+            all[count].h.handle = loader;
+            ++count;
+        } else {
+            report(err_msg_out, "failed to clone loader service", status);
+        }
+    }
+    zx_handle_t executable = ZX_HANDLE_INVALID;
+    if (status == ZX_OK) {
+        status = zx_handle_duplicate(tmpl->executable, ZX_RIGHT_SAME_RIGHTS,
+                                     &executable);
+        if (status != ZX_OK)
+            report(err_msg_out, "failed to duplicate executable", status);
+    }
+    if (status != ZX_OK) {
+        close_action_handles(count, all);
+        close_action_handles(action_count, actions);
+        free(all);
+        return status;
+    }
+
+    if (action_count > 0u)
+        memcpy(&all[count], actions, action_count * sizeof(*actions));
+    count += action_count;
+
+    uint32_t flags =
+        tmpl->flags & ~(FDIO_SPAWN_DEFAULT_LDSVC | FDIO_SPAWN_CLONE_NAMESPACE);
+    status = fdio_spawn_vmo(job, flags, executable, argv, environ, count, all,
+                            process_out, err_msg_out);
+    free(all);
+    return status;
+}
+
+void fdio_spawn_template_destroy(fdio_spawn_template_t* tmpl) {
+    zx_handle_close(tmpl->executable);
+    zx_handle_close(tmpl->loader);
+    if (tmpl->ns != NULL) {
+        for (size_t i = 0; i < tmpl->ns->count; ++i)
+            zx_handle_close(tmpl->ns->handle[i]);
+        free(tmpl->ns);
+    }
+    mtx_destroy(&tmpl->lock);
+    free(tmpl);
+}
@@ -0,0 +1,249 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/fdio/waitset.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#include <lib/async/wait.h>
+#include <lib/fdio/limits.h>
+#include <lib/fdio/unsafe.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+typedef struct registration {
+    // For a set on a dispatcher.  Must be first, see |on_signal()|.
+    async_wait_t wait;
+
+    fdio_waitset_t* set;
+    fdio_t* io;
+    int fd;
+    uint32_t events;
+    void* cookie;
+    zx_handle_t handle;
+    zx_signals_t signals;
+    uint32_t generation;
+} registration_t;
+
+struct fdio_waitset {
+    // Exactly one of |port| and |dispatcher| is valid.
+    zx_handle_t port;
+    async_dispatcher_t* dispatcher;
+    fdio_waitset_handler_t* handler;
+
+    mtx_t lock; // guards the registrations and the generation
+    uint32_t generation;
+    registration_t* registrations[FDIO_MAX_FD];
+};
+
+// The key of the port packets of |reg|.  The generation tells packets of a
+// registration apart from those of the one it replaced, which may still be in
+// the queue.
+static uint64_t key_of(const registration_t* reg) {
+    return ((uint64_t)reg->generation << 32) | (uint32_t)reg->fd;
+}
+
+static void on_signal(async_dispatcher_t* dispatcher, async_wait_t* wait,
+                      zx_status_t status, const zx_packet_signal_t* signal);
+
+static zx_status_t arm(fdio_waitset_t* set, registration_t* reg) {
+    if (set->dispatcher == NULL) {
+        return zx_object_wait_async(reg->handle, set->port, key_of(reg),
+                                    reg->signals, ZX_WAIT_ASYNC_REPEATING);
+    }
+    reg->wait = (async_wait_t){{ASYNC_STATE_INIT}, on_signal, reg->handle,
+                               reg->signals};
+    return async_begin_wait(set->dispatcher, &reg->wait);
+}
+
+static void release(registration_t* reg) {
+    fdio_unsafe_release(reg->io);
+    free(reg);
+}
+
+// Stops the wait of |reg|, which must have been armed.  Packets that are
+// already queued are dropped when they are dequeued.
+static void disarm_and_release(fdio_waitset_t* set, registration_t* reg) {
+    if (set->dispatcher == NULL) {
+        zx_port_cancel(set->port, reg->handle, key_of(reg));
+    } else {
+        async_cancel_wait(set->dispatcher, &reg->wait);
+    }
+    release(reg);
+}
+
+static uint32_t ready_events(const registration_t* reg,
+                             zx_signals_t observed) {
+    uint32_t events = 0u;
+    fdio_unsafe_wait_end(reg->io, observed, &events);
+    return events & reg->events;
+}
+
+static void on_signal(async_dispatcher_t* dispatcher, async_wait_t* wait,
+                      zx_status_t status, const zx_packet_signal_t* signal) {
+    registration_t* reg = (registration_t*)wait;
+    fdio_waitset_t* set = reg->set;
+    fdio_waitset_event_t event = {
+        .fd = reg->fd,
+        .events = status == ZX_OK ? ready_events(reg, signal->observed) : 0u,
+        .cookie = reg->cookie,
+    };
+    if (status != ZX_OK) {
+        if (set->registrations[reg->fd] == reg)
+            set->registrations[reg->fd] = NULL;
+        release(reg);
+        set->handler(set, ZX_ERR_CANCELED, &event);
+        return;
+    }
+
+    // The handler may remove or replace this registration, so rearm it only
+    // if it is still the current one.
+    uint32_t generation = reg->generation;
+    int fd = reg->fd;
+    if (event.events != 0u)
+        set->handler(set, ZX_OK, &event);
+    reg = set->registrations[fd];
+    if (reg != NULL && reg->generation == generation &&
+        arm(set, reg) != ZX_OK) {
+        set->registrations[fd] = NULL;
+        release(reg);
+    }
+}
+
+static zx_status_t create(async_dispatcher_t* dispatcher,
+                          fdio_waitset_handler_t* handler,
+                          fdio_waitset_t** out_set) {
+    fdio_waitset_t* set = calloc(1, sizeof(*set));
+    if (set == NULL)
+        return ZX_ERR_NO_MEMORY;
+    set->port = ZX_HANDLE_INVALID;
+    set->dispatcher = dispatcher;
+    set->handler = handler;
+    if (dispatcher == NULL) {
+        zx_status_t status = zx_port_create(0u, &set->port);
+        if (status != ZX_OK) {
+            free(set);
+            return status;
+        }
+    }
+    mtx_init(&set->lock, mtx_plain);
+    *out_set = set;
+    return ZX_OK;
+}
+
+zx_status_t fdio_waitset_create(fdio_waitset_t** out_set) {
+    return create(NULL, NULL, out_set);
+}
+
+zx_status_t fdio_waitset_create_on_dispatcher(async_dispatcher_t* dispatcher,
+                                              fdio_waitset_handler_t* handler,
+                                              fdio_waitset_t** out_set) {
+    if (dispatcher == NULL || handler == NULL)
+        return ZX_ERR_INVALID_ARGS;
+    return create(dispatcher, handler, out_set);
+}
+
+zx_status_t fdio_waitset_add(fdio_waitset_t* set, int fd, uint32_t events,
+                             void* cookie) {
+    if (fd < 0 || fd >= FDIO_MAX_FD)
+        return ZX_ERR_BAD_HANDLE;
+    registration_t* reg = calloc(1, sizeof(*reg));
+    if (reg == NULL)
+        return ZX_ERR_NO_MEMORY;
+    reg->io = fdio_unsafe_fd_to_io(fd);
+    if (reg->io == NULL) {
+        free(reg);
+        return ZX_ERR_BAD_HANDLE;
+    }
+    fdio_unsafe_wait_begin(reg->io, events, &reg->handle, &reg->signals);
+    if (reg->handle == ZX_HANDLE_INVALID) {
+        release(reg);
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    reg->set = set;
+    reg->fd = fd;
+    reg->events = events;
+    reg->cookie = cookie;
+
+    mtx_lock(&set->lock);
+    registration_t* old = set->registrations[fd];
+    if (old != NULL)
+        disarm_and_release(set, old);
+    reg->generation = ++set->generation;
+    zx_status_t status = arm(set, reg);
+    if (status == ZX_OK) {
+        set->registrations[fd] = reg;
+    } else {
+        set->registrations[fd] = NULL;
+        release(reg);
+    }
+    mtx_unlock(&set->lock);
+    return status;
+}
+
+zx_status_t fdio_waitset_remove(fdio_waitset_t* set, int fd) {
+    if (fd < 0 || fd >= FDIO_MAX_FD)
+        return ZX_ERR_NOT_FOUND;
+    mtx_lock(&set->lock);
+    registration_t* reg = set->registrations[fd];
+    if (reg != NULL) {
+        set->registrations[fd] = NULL;
+        disarm_and_release(set, reg);
+    }
+    mtx_unlock(&set->lock);
+    return reg != NULL ? ZX_OK : ZX_ERR_NOT_FOUND;
+}
+
+zx_status_t fdio_waitset_wait(fdio_waitset_t* set, fdio_waitset_event_t* events,
+                              size_t capacity, zx_time_t deadline,
+                              size_t* out_count) {
+    if (set->dispatcher != NULL)
+        return ZX_ERR_BAD_STATE;
+    if (capacity == 0u)
+        return ZX_ERR_INVALID_ARGS;
+
+    size_t count = 0u;
+    while (count == 0u) {
+        // Block for the first packet only, then take those already queued.
+        zx_port_packet_t packet;
+        zx_status_t status = zx_port_wait(set->port, deadline, &packet);
+        if (status != ZX_OK)
+            return status;
+
+        mtx_lock(&set->lock);
+        do {
+            if (packet.type != ZX_PKT_TYPE_SIGNAL_REP)
+                continue;
+            uint32_t fd = (uint32_t)packet.key;
+            registration_t* reg =
+                fd < FDIO_MAX_FD ? set->registrations[fd] : NULL;
+            if (reg == NULL || key_of(reg) != packet.key)
+                continue;
+            uint32_t ready = ready_events(reg, packet.signal.observed);
+            if (ready == 0u)
+                continue;
+            events[count].fd = reg->fd;
+            events[count].events = ready;
+            events[count].cookie = reg->cookie;
+            ++count;
+        } while (count < capacity &&
+                 zx_port_wait(set->port, 0, &packet) == ZX_OK);
+        mtx_unlock(&set->lock);
+    }
+    *out_count = count;
+    return ZX_OK;
+}
+
+void fdio_waitset_destroy(fdio_waitset_t* set) {
+    for (int fd = 0; fd < FDIO_MAX_FD; ++fd) {
+        registration_t* reg = set->registrations[fd];
+        if (reg != NULL)
+            disarm_and_release(set, reg);
+    }
+    zx_handle_close(set->port);
+    mtx_destroy(&set->lock);
+    free(set);
+}
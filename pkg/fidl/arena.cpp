@@ -0,0 +1,78 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/fidl/llcpp/arena.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lib/fidl/internal.h>
+#include <zircon/assert.h>
+
+namespace fidl {
+
+Arena::Arena(void* buffer, uint32_t capacity, uint32_t overflow_size)
+    : buffer_(static_cast<uint8_t*>(buffer)), capacity_(capacity),
+      overflow_size_(static_cast<uint32_t>(FidlAlign(overflow_size))),
+      at_(buffer_), end_(buffer_ + capacity) {
+    ZX_DEBUG_ASSERT(reinterpret_cast<uintptr_t>(buffer) % FIDL_ALIGNMENT == 0);
+}
+
+Arena::~Arena() {
+    Reset();
+}
+
+StringView Arena::CopyStringView(const char* data, uint64_t size) {
+    StringView view;
+    if (size > ZX_CHANNEL_MAX_MSG_BYTES)
+        return view;
+    // Empty strings still get a non-null pointer, so they are not mistaken for
+    // absent ones.
+    if (void* ptr = Allocate(static_cast<uint32_t>(size))) {
+        memcpy(ptr, data, size);
+        view.set_data(static_cast<char*>(ptr));
+        view.set_size(size);
+    }
+    return view;
+}
+
+void* Arena::Allocate(uint32_t size) {
+    const uint32_t aligned_size = static_cast<uint32_t>(FidlAlign(size));
+    if (aligned_size > static_cast<uintptr_t>(end_ - at_))
+        return AllocateOverflow(aligned_size);
+    uint8_t* result = at_;
+    memset(result, 0, aligned_size);
+    at_ += aligned_size;
+    allocated_bytes_ += aligned_size;
+    return result;
+}
+
+void* Arena::AllocateOverflow(uint32_t aligned_size) {
+    if (overflow_size_ == 0u)
+        return nullptr;
+    const uint32_t capacity = aligned_size > overflow_size_ ? aligned_size : overflow_size_;
+    Chunk* chunk = static_cast<Chunk*>(malloc(sizeof(Chunk) + capacity));
+    if (chunk == nullptr)
+        return nullptr;
+    chunk->next = overflow_;
+    overflow_ = chunk;
+    // Whatever is left of the previous region is abandoned. Allocations are
+    // usually much smaller than a chunk, so little is wasted.
+    at_ = chunk->data();
+    end_ = at_ + capacity;
+    return Allocate(aligned_size);
+}
+
+void Arena::Reset() {
+    while (overflow_ != nullptr) {
+        Chunk* next = overflow_->next;
+        free(overflow_);
+        overflow_ = next;
+    }
+    at_ = buffer_;
+    end_ = buffer_ + capacity_;
+    allocated_bytes_ = 0u;
+}
+
+} // namespace fidl
@@ -0,0 +1,87 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/fidl/cpp/arena_builder.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lib/fidl/coding.h>
+#include <lib/fidl/internal.h>
+#include <zircon/assert.h>
+
+namespace fidl {
+
+ArenaBuilder::ArenaBuilder(uint32_t chunk_size)
+    : chunk_size_(static_cast<uint32_t>(FidlAlign(chunk_size))) {}
+
+ArenaBuilder::~ArenaBuilder() {
+    FreeChunks(head_);
+}
+
+uint32_t ArenaBuilder::high_water_mark() const {
+    return allocated_bytes_ > high_water_mark_ ? allocated_bytes_ : high_water_mark_;
+}
+
+void* ArenaBuilder::Allocate(uint32_t size) {
+    const uint32_t aligned_size = static_cast<uint32_t>(FidlAlign(size));
+    if (tail_ == nullptr || aligned_size > tail_->capacity - tail_->at) {
+        const uint32_t capacity = aligned_size > chunk_size_ ? aligned_size : chunk_size_;
+        Chunk* chunk = static_cast<Chunk*>(malloc(sizeof(Chunk) + capacity));
+        if (chunk == nullptr)
+            return nullptr;
+        chunk->next = nullptr;
+        chunk->capacity = capacity;
+        chunk->at = 0u;
+        if (tail_ == nullptr) {
+            head_ = chunk;
+        } else {
+            tail_->next = chunk;
+        }
+        tail_ = chunk;
+    }
+    uint8_t* result = tail_->data() + tail_->at;
+    memset(result, 0, aligned_size);
+    tail_->at += aligned_size;
+    allocated_bytes_ += aligned_size;
+    return result;
+}
+
+BytePart ArenaBuilder::Finalize() {
+    ZX_ASSERT_MSG(is_contiguous(), "ArenaBuilder::Finalize() requires contiguous storage");
+    if (head_ == nullptr)
+        return BytePart();
+    return BytePart(head_->data(), head_->capacity, head_->at);
+}
+
+zx_status_t ArenaBuilder::Linearize(const fidl_type_t* type, const void* value,
+                                    BytePart* bytes, const char** error_msg_out) {
+    uint32_t actual = 0u;
+    zx_status_t status = fidl_linearize(type, value, bytes->data(), bytes->capacity(),
+                                        &actual, error_msg_out);
+    if (status == ZX_OK)
+        bytes->set_actual(actual);
+    return status;
+}
+
+void ArenaBuilder::Reset() {
+    high_water_mark_ = high_water_mark();
+    allocated_bytes_ = 0u;
+    if (head_ == nullptr)
+        return;
+    FreeChunks(head_->next);
+    head_->next = nullptr;
+    head_->at = 0u;
+    tail_ = head_;
+}
+
+void ArenaBuilder::FreeChunks(Chunk* chunk) {
+    while (chunk != nullptr) {
+        Chunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+} // namespace fidl
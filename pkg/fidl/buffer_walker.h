@@ -4,6 +4,14 @@
 
 #pragma once
 
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 namespace fidl {
 namespace internal {
 
@@ -16,6 +24,123 @@ static_assert(offsetof(fidl_vector_t, data) == 8u, "");
 
 static_assert(ZX_HANDLE_INVALID == FIDL_HANDLE_ABSENT, "");
 
+// Returns true if |type| is a pointer-free struct (see |FidlCodedStruct|)
+// whose encoding occupies exactly |num_bytes|.
+//
+// Such a message has no out-of-line data and no handles, so encoding, decoding,
+// and validating it succeed without walking the message at all. Callers fall
+// back to a full walk when this returns false so that errors are reported
+// exactly as before.
+inline bool IsPointerFreeStructOfSize(const fidl_type_t* type, uint32_t num_bytes) {
+    return type != nullptr &&
+           type->type_tag == fidl::kFidlTypeStruct &&
+           type->coded_struct.pointer_free &&
+           fidl::FidlAlign(type->coded_struct.size) == num_bytes;
+}
+
+// Kernels for runs of contiguous handles, such as the elements of a
+// vector<handle>. They process one 128-bit register (four handles) at a time
+// where the target supports it, and finish the tail one handle at a time.
+
+// Returns true if every one of the |count| handles at |handles| is |value|.
+inline bool AllHandlesEqual(const zx_handle_t* handles, uint32_t count, zx_handle_t value) {
+    uint32_t i = 0u;
+#if defined(__SSE2__)
+    const __m128i expected = _mm_set1_epi32(static_cast<int>(value));
+    for (; i + 4u <= count; i += 4u) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(handles + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(chunk, expected)) != 0xffff) {
+            return false;
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint32x4_t expected = vdupq_n_u32(value);
+    for (; i + 4u <= count; i += 4u) {
+        if (vminvq_u32(vceqq_u32(vld1q_u32(handles + i), expected)) == 0u) {
+            return false;
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        if (handles[i] != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns true if none of the |count| handles at |handles| is
+// ZX_HANDLE_INVALID.
+inline bool NoHandlesInvalid(const zx_handle_t* handles, uint32_t count) {
+    uint32_t i = 0u;
+#if defined(__SSE2__)
+    const __m128i invalid = _mm_setzero_si128();
+    for (; i + 4u <= count; i += 4u) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(handles + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(chunk, invalid)) != 0) {
+            return false;
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 4u <= count; i += 4u) {
+        if (vminvq_u32(vld1q_u32(handles + i)) == 0u) {
+            return false;
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        if (handles[i] == ZX_HANDLE_INVALID) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Stores |value| into each of the |count| handles at |handles|.
+inline void FillHandles(zx_handle_t* handles, uint32_t count, zx_handle_t value) {
+    uint32_t i = 0u;
+#if defined(__SSE2__)
+    const __m128i fill = _mm_set1_epi32(static_cast<int>(value));
+    for (; i + 4u <= count; i += 4u) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(handles + i), fill);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint32x4_t fill = vdupq_n_u32(value);
+    for (; i + 4u <= count; i += 4u) {
+        vst1q_u32(handles + i, fill);
+    }
+#endif
+    for (; i < count; ++i) {
+        handles[i] = value;
+    }
+}
+
+// Returns the inline size of an object of |type|.
+inline uint32_t TypeSize(const fidl_type_t* type) {
+    switch (type->type_tag) {
+    case fidl::kFidlTypeStructPointer:
+    case fidl::kFidlTypeTablePointer:
+    case fidl::kFidlTypeUnionPointer:
+        return sizeof(uint64_t);
+    case fidl::kFidlTypeHandle:
+        return sizeof(zx_handle_t);
+    case fidl::kFidlTypeStruct:
+        return type->coded_struct.size;
+    case fidl::kFidlTypeTable:
+        return sizeof(fidl_vector_t);
+    case fidl::kFidlTypeUnion:
+        return type->coded_union.size;
+    case fidl::kFidlTypeString:
+        return sizeof(fidl_string_t);
+    case fidl::kFidlTypeArray:
+        return type->coded_array.array_size;
+    case fidl::kFidlTypeVector:
+        return sizeof(fidl_vector_t);
+    }
+    abort();
+    return 0;
+}
+
 template <bool kConst, class U>
 struct SetPtrConst;
 
@@ -46,6 +171,12 @@ struct SetPtrConst<true, U> {
 //      - returns true if a legally points to b
 //   void UnclaimedHandle(zx_handle_t*) - notes that a handle was skipped
 //   void ClaimedHandle(zx_handle_t*, uint32_t idx) - notes that a handle was claimed
+//   bool AllHandlesPresent(const zx_handle_t*, uint32_t count)
+//      - returns true if a run of contiguous handles can be claimed as a whole
+//   void ClaimedHandles(zx_handle_t*, uint32_t count, uint32_t idx)
+//      - notes that a run of contiguous present handles was claimed starting at idx
+//   bool ValidateStringData(const char* data, uint64_t size)
+//      - returns true if the contents of a string are acceptable
 //   PointerState GetPointerState(const void* ptr) - returns whether a pointer is present or not
 //   HandleState GetHandleState(zx_handle_t) - returns if a handle is present or not
 //   void UpdatePointer(T**p, T*v) - mutates a pointer representation for a present pointer
@@ -91,6 +222,69 @@ public:
             return;
         }
 
+        // Size the stack of frames from the depth recorded in the coding
+        // table: one frame per level of nesting plus the done sentinel. Most
+        // messages are shallow and fit in a few cache lines.
+        if (FrameCount(type_) <= kShallowFrameCount) {
+            WalkWithFrames<kShallowFrameCount>();
+        } else {
+            WalkWithFrames<FIDL_RECURSION_DEPTH>();
+        }
+    }
+
+protected:
+    void SetError(const char* error_msg) {
+        derived()->SetError(error_msg);
+    }
+
+    template <typename T>
+    typename SetPtrConst<!kMutating, T>::type TypedAt(uint32_t offset) const {
+        return reinterpret_cast<typename SetPtrConst<!kMutating, T>::type>(bytes() + offset);
+    }
+
+    enum class PointerState : uintptr_t {
+        PRESENT = FIDL_ALLOC_PRESENT,
+        ABSENT = FIDL_ALLOC_ABSENT,
+        INVALID = 1 // *OR* *ANY* non PRESENT/ABSENT value.
+    };
+
+    enum class HandleState : zx_handle_t {
+        PRESENT = FIDL_HANDLE_PRESENT,
+        ABSENT = FIDL_HANDLE_ABSENT,
+        INVALID = 1 // *OR* *ANY* non PRESENT/ABSENT value.
+    };
+
+    uint32_t handle_idx() const { return handle_idx_; }
+
+private:
+    struct Frame;
+
+    // The number of frames used for types whose recorded depth is small.
+    static constexpr uint32_t kShallowFrameCount = 4u;
+
+    // Returns the number of frames needed to walk a message of |type|, which
+    // must be a struct or a table.
+    static uint32_t FrameCount(const fidl_type_t* type) {
+        const uint32_t max_depth = type->type_tag == fidl::kFidlTypeStruct
+                                       ? type->coded_struct.max_depth
+                                       : type->coded_table.max_depth;
+        return max_depth < FIDL_RECURSION_DEPTH ? max_depth + 1u : FIDL_RECURSION_DEPTH;
+    }
+
+    // Provides storage for |kFrameCount| frames on the stack for the duration
+    // of the walk. Kept out of line so that each instantiation only reserves
+    // its own storage.
+    template <uint32_t kFrameCount>
+    __NO_INLINE void WalkWithFrames() {
+        Frame frames[kFrameCount];
+        decoding_frames_ = frames;
+        frame_capacity_ = kFrameCount;
+        WalkFrames();
+        decoding_frames_ = nullptr;
+        frame_capacity_ = 0u;
+    }
+
+    __NO_INLINE void WalkFrames() {
         Push(Frame::DoneSentinel());
         Push(Frame(type_, 0u));
 
@@ -371,6 +565,10 @@ public:
                     FIDL_POP_AND_CONTINUE_OR_RETURN;
                 }
                 UpdatePointer(&string_ptr->data, TypedAt<char>(string_data_offset));
+                if (!derived()->ValidateStringData(TypedAt<char>(string_data_offset), size)) {
+                    SetError("message tried to decode a string that is not valid UTF-8");
+                    FIDL_POP_AND_CONTINUE_OR_RETURN;
+                }
                 Pop();
                 continue;
             }
@@ -435,7 +633,13 @@ public:
                     FIDL_POP_AND_CONTINUE_OR_RETURN;
                 }
                 UpdatePointer(&vector_ptr->data, TypedAt<void>(frame->offset));
-                if (frame->vector_state.element) {
+                if (frame->vector_state.element &&
+                    frame->vector_state.element->type_tag == fidl::kFidlTypeHandle &&
+                    ClaimHandleRun(TypedAt<zx_handle_t>(frame->offset),
+                                   static_cast<uint32_t>(vector_ptr->count))) {
+                    // Every element was a present handle and has been claimed.
+                    Pop();
+                } else if (frame->vector_state.element) {
                     // Continue by decoding the vector elements as an array.
                     *frame = Frame(frame->vector_state.element, size,
                                    frame->vector_state.element_size, frame->offset);
@@ -459,31 +663,6 @@ public:
 #undef FIDL_POP_AND_CONTINUE_OR_RETURN
     }
 
-protected:
-    void SetError(const char* error_msg) {
-        derived()->SetError(error_msg);
-    }
-
-    template <typename T>
-    typename SetPtrConst<!kMutating, T>::type TypedAt(uint32_t offset) const {
-        return reinterpret_cast<typename SetPtrConst<!kMutating, T>::type>(bytes() + offset);
-    }
-
-    enum class PointerState : uintptr_t {
-        PRESENT = FIDL_ALLOC_PRESENT,
-        ABSENT = FIDL_ALLOC_ABSENT,
-        INVALID = 1 // *OR* *ANY* non PRESENT/ABSENT value.
-    };
-
-    enum class HandleState : zx_handle_t {
-        PRESENT = FIDL_HANDLE_PRESENT,
-        ABSENT = FIDL_HANDLE_ABSENT,
-        INVALID = 1 // *OR* *ANY* non PRESENT/ABSENT value.
-    };
-
-    uint32_t handle_idx() const { return handle_idx_; }
-
-private:
     Derived* derived() {
         return static_cast<Derived*>(this);
     }
@@ -536,6 +715,24 @@ private:
         return true;
     }
 
+    // Claims |count| contiguous handles at once. Returns false without
+    // claiming anything if any of them is not present or there are not enough
+    // handles left, in which case the caller walks them one at a time so that
+    // errors and cleanup are handled exactly as for a single handle.
+    template <class ZxHandleTPointer>
+    bool ClaimHandleRun(ZxHandleTPointer handles, uint32_t count) {
+        if (count == 0u) {
+            return true;
+        }
+        if (count > num_handles() - handle_idx_ ||
+            !derived()->AllHandlesPresent(handles, count)) {
+            return false;
+        }
+        derived()->ClaimedHandles(handles, count, handle_idx_);
+        handle_idx_ += count;
+        return true;
+    }
+
     // Returns true when the buffer space is claimed, and false when
     // the requested claim is too large for bytes_.
     bool ClaimOutOfLineStorage(uint32_t size, const void* storage, uint32_t* out_offset) {
@@ -563,35 +760,10 @@ private:
         return true;
     }
 
-    uint32_t TypeSize(const fidl_type_t* type) {
-        switch (type->type_tag) {
-        case fidl::kFidlTypeStructPointer:
-        case fidl::kFidlTypeTablePointer:
-        case fidl::kFidlTypeUnionPointer:
-            return sizeof(uint64_t);
-        case fidl::kFidlTypeHandle:
-            return sizeof(zx_handle_t);
-        case fidl::kFidlTypeStruct:
-            return type->coded_struct.size;
-        case fidl::kFidlTypeTable:
-            return sizeof(fidl_vector_t);
-        case fidl::kFidlTypeUnion:
-            return type->coded_union.size;
-        case fidl::kFidlTypeString:
-            return sizeof(fidl_string_t);
-        case fidl::kFidlTypeArray:
-            return type->coded_array.array_size;
-        case fidl::kFidlTypeVector:
-            return sizeof(fidl_vector_t);
-        }
-        abort();
-        return 0;
-    }
-
     // Functions that manipulate the decoding stack frames.
     struct Frame {
         Frame(const fidl_type_t* fidl_type, uint32_t offset)
-            : offset(offset) {
+            : offset(offset), field(0u) {
             switch (fidl_type->type_tag) {
             case fidl::kFidlTypeStruct:
                 state = kStateStruct;
@@ -648,21 +820,21 @@ private:
         }
 
         Frame(const fidl::FidlCodedStruct* coded_struct, uint32_t offset)
-            : offset(offset) {
+            : offset(offset), field(0u) {
             state = kStateStruct;
             struct_state.fields = coded_struct->fields;
             struct_state.field_count = coded_struct->field_count;
         }
 
         Frame(const fidl::FidlCodedTable* coded_table, uint32_t offset)
-            : offset(offset) {
+            : offset(offset), field(0u) {
             state = kStateStruct;
             table_state.fields = coded_table->fields;
             table_state.field_count = coded_table->field_count;
         }
 
         Frame(const fidl::FidlCodedUnion* coded_union, uint32_t offset)
-            : offset(offset) {
+            : offset(offset), field(0u) {
             state = kStateUnion;
             union_state.types = coded_union->types;
             union_state.type_count = coded_union->type_count;
@@ -671,14 +843,15 @@ private:
 
         Frame(const fidl_type_t* element, uint32_t array_size, uint32_t element_size,
               uint32_t offset)
-            : offset(offset) {
+            : offset(offset), field(0u) {
             state = kStateArray;
             array_state.element = element;
             array_state.array_size = array_size;
             array_state.element_size = element_size;
         }
 
-        // The default constructor does nothing when initializing the stack of frames.
+        // The default constructor does nothing when initializing the stack of
+        // frames, so that unused frames are never touched.
         Frame() {}
 
         static Frame DoneSentinel() {
@@ -770,12 +943,12 @@ private:
             } vector_state;
         };
 
-        uint32_t field = 0u;
+        uint32_t field;
     };
 
     // Returns true on success and false on recursion overflow.
     bool Push(Frame frame) {
-        if (depth_ == FIDL_RECURSION_DEPTH) {
+        if (depth_ == frame_capacity_) {
             return false;
         }
         decoding_frames_[depth_] = frame;
@@ -800,9 +973,10 @@ private:
     uint32_t handle_idx_ = 0u;
     uint32_t out_of_line_offset_ = 0u;
 
-    // Decoding stack state.
+    // Decoding stack state. The frames live on the stack of |WalkWithFrames|.
     uint32_t depth_ = 0u;
-    Frame decoding_frames_[FIDL_RECURSION_DEPTH];
+    uint32_t frame_capacity_ = 0u;
+    Frame* decoding_frames_ = nullptr;
 };
 
 } // namespace internal
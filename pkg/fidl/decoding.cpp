@@ -7,6 +7,7 @@
 #include <stdalign.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <lib/fidl/internal.h>
 #include <zircon/assert.h>
@@ -17,6 +18,7 @@
 #endif
 
 #include "buffer_walker.h"
+#include "utf8.h"
 
 // TODO(kulakowski) Design zx_status_t error values.
 
@@ -27,9 +29,11 @@ class FidlDecoder final : public fidl::internal::BufferWalker<FidlDecoder, true,
 
 public:
     FidlDecoder(const fidl_type_t* type, void* bytes, uint32_t num_bytes,
-                const zx_handle_t* handles, uint32_t num_handles, const char** out_error_msg)
+                const zx_handle_t* handles, uint32_t num_handles, uint32_t options,
+                const char** out_error_msg)
         : Super(type), bytes_(static_cast<uint8_t*>(bytes)), num_bytes_(num_bytes),
-          handles_(handles), num_handles_(num_handles), out_error_msg_(out_error_msg) {}
+          handles_(handles), num_handles_(num_handles), options_(options),
+          out_error_msg_(out_error_msg) {}
 
     void Walk() {
         if (handles_ == nullptr && num_handles_ != 0u) {
@@ -50,6 +54,11 @@ public:
         return true;
     }
 
+    bool ValidateStringData(const char* data, uint64_t size) const {
+        return (options_ & FIDL_CODING_CHECK_UTF8) == 0u ||
+               fidl::internal::IsValidUtf8(data, size);
+    }
+
     void UnclaimedHandle(zx_handle_t* out_handle) {}
     void ClaimedHandle(zx_handle_t* out_handle, uint32_t idx) {
         if (out_handle != nullptr) {
@@ -61,6 +70,12 @@ public:
 #endif
         }
     }
+    bool AllHandlesPresent(const zx_handle_t* handles, uint32_t count) const {
+        return fidl::internal::AllHandlesEqual(handles, count, FIDL_HANDLE_PRESENT);
+    }
+    void ClaimedHandles(zx_handle_t* handles, uint32_t count, uint32_t idx) {
+        memcpy(handles, &handles_[idx], count * sizeof(zx_handle_t));
+    }
 
     PointerState GetPointerState(const void* ptr) const {
         return static_cast<PointerState>(*static_cast<const uintptr_t*>(ptr));
@@ -94,6 +109,7 @@ private:
     const uint32_t num_bytes_;
     const zx_handle_t* const handles_;
     const uint32_t num_handles_;
+    const uint32_t options_;
     const char** const out_error_msg_;
     zx_status_t status_ = ZX_OK;
 };
@@ -103,7 +119,17 @@ private:
 zx_status_t fidl_decode(const fidl_type_t* type, void* bytes, uint32_t num_bytes,
                         const zx_handle_t* handles, uint32_t num_handles,
                         const char** out_error_msg) {
-    FidlDecoder decoder(type, bytes, num_bytes, handles, num_handles, out_error_msg);
+    return fidl_decode_etc(type, bytes, num_bytes, handles, num_handles, 0u, out_error_msg);
+}
+
+zx_status_t fidl_decode_etc(const fidl_type_t* type, void* bytes, uint32_t num_bytes,
+                            const zx_handle_t* handles, uint32_t num_handles,
+                            uint32_t options, const char** out_error_msg) {
+    if (bytes != nullptr && num_handles == 0u &&
+        fidl::internal::IsPointerFreeStructOfSize(type, num_bytes)) {
+        return ZX_OK;
+    }
+    FidlDecoder decoder(type, bytes, num_bytes, handles, num_handles, options, out_error_msg);
     decoder.Walk();
     return decoder.status();
 }
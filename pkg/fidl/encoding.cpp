@@ -7,6 +7,7 @@
 #include <stdalign.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <lib/fidl/internal.h>
 #include <zircon/assert.h>
@@ -57,6 +58,10 @@ public:
         return a == b;
     }
 
+    bool ValidateStringData(const char* data, uint64_t size) const {
+        return true;
+    }
+
     void UnclaimedHandle(zx_handle_t* out_handle) {
 #ifdef __Fuchsia__
         // Return value intentionally ignored: this is best-effort cleanup.
@@ -68,6 +73,13 @@ public:
         handles_[idx] = *out_handle;
         *out_handle = FIDL_HANDLE_PRESENT;
     }
+    bool AllHandlesPresent(const zx_handle_t* handles, uint32_t count) const {
+        return fidl::internal::NoHandlesInvalid(handles, count);
+    }
+    void ClaimedHandles(zx_handle_t* handles, uint32_t count, uint32_t idx) {
+        memcpy(&handles_[idx], handles, count * sizeof(zx_handle_t));
+        fidl::internal::FillHandles(handles, count, FIDL_HANDLE_PRESENT);
+    }
 
     PointerState GetPointerState(const void* ptr) const {
         return *static_cast<const uintptr_t*>(ptr) == 0
@@ -121,6 +133,12 @@ private:
 zx_status_t fidl_encode(const fidl_type_t* type, void* bytes, uint32_t num_bytes,
                         zx_handle_t* handles, uint32_t max_handles, uint32_t* out_actual_handles,
                         const char** out_error_msg) {
+    if (bytes != nullptr && out_actual_handles != nullptr &&
+        (handles != nullptr || max_handles == 0u) &&
+        fidl::internal::IsPointerFreeStructOfSize(type, num_bytes)) {
+        *out_actual_handles = 0u;
+        return ZX_OK;
+    }
     FidlEncoder encoder(type, bytes, num_bytes, handles, max_handles, out_actual_handles,
                         out_error_msg);
     encoder.Walk();
@@ -8,6 +8,8 @@
 #include <stdarg.h>
 #include <string.h>
 
+#include <atomic>
+
 #include <lib/fidl/internal.h>
 #include <zircon/assert.h>
 #include <zircon/compiler.h>
@@ -204,6 +206,59 @@ void FormatTypeName(StringBuilder* str, const fidl_type_t* type) {
     }
 }
 
+// Formatted names are cached so that reporting the same type repeatedly, as
+// happens when a peer keeps sending bad messages, does not reformat it.
+//
+// The cache is an open-addressed table keyed by type. Slots are claimed with a
+// compare-and-swap and never released, and the names themselves are stored in
+// a fixed pool, so lookups take no locks and the cache never allocates. Once
+// the table or the pool is full, names are formatted on every call as before.
+constexpr size_t kNameCacheSlots = 256u;
+constexpr size_t kNameCacheStorage = 32u * 1024u;
+constexpr size_t kMaxCachedNameLength = 1024u;
+
+struct CachedName {
+    std::atomic<const fidl_type_t*> type;
+    // Set after |length| and the name bytes are written.
+    std::atomic<const char*> name;
+    std::atomic<size_t> length;
+};
+
+CachedName g_name_cache[kNameCacheSlots];
+char g_name_storage[kNameCacheStorage];
+std::atomic<size_t> g_name_storage_used;
+
+size_t CacheSlot(const fidl_type_t* type) {
+    uintptr_t key = reinterpret_cast<uintptr_t>(type);
+    key ^= key >> 17;
+    key *= 0x9e3779b97f4a7c15ull;
+    return static_cast<size_t>(key >> 32) % kNameCacheSlots;
+}
+
+// Returns the cache entry for |type|, claiming one if needed, or nullptr if
+// the table is full.
+CachedName* FindCachedName(const fidl_type_t* type) {
+    const size_t start = CacheSlot(type);
+    for (size_t i = 0; i < kNameCacheSlots; ++i) {
+        CachedName* entry = &g_name_cache[(start + i) % kNameCacheSlots];
+        const fidl_type_t* key = entry->type.load(std::memory_order_acquire);
+        if (key == nullptr &&
+            entry->type.compare_exchange_strong(key, type, std::memory_order_acq_rel)) {
+            return entry;
+        }
+        if (key == type) {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+size_t CopyName(const char* name, size_t length, char* buffer, size_t capacity) {
+    size_t count = length < capacity ? length : capacity;
+    memcpy(buffer, name, count);
+    return count;
+}
+
 } // namespace
 
 size_t fidl_format_type_name(const fidl_type_t* type,
@@ -212,7 +267,30 @@ size_t fidl_format_type_name(const fidl_type_t* type,
         return 0u;
     }
 
-    StringBuilder str(buffer, capacity);
+    CachedName* entry = FindCachedName(type);
+    if (entry != nullptr) {
+        if (const char* name = entry->name.load(std::memory_order_acquire)) {
+            return CopyName(name, entry->length.load(std::memory_order_relaxed),
+                            buffer, capacity);
+        }
+    }
+
+    char name[kMaxCachedNameLength];
+    StringBuilder str(name, sizeof(name));
     FormatTypeName(&str, type);
-    return str.length();
+    const size_t length = str.length();
+
+    // Only the thread that wins the storage publishes the name. Others racing
+    // to format the same type just use their own copy.
+    if (entry != nullptr && length < sizeof(name)) {
+        const size_t offset = g_name_storage_used.fetch_add(length, std::memory_order_relaxed);
+        if (offset + length <= kNameCacheStorage) {
+            memcpy(&g_name_storage[offset], name, length);
+            entry->length.store(length, std::memory_order_relaxed);
+            const char* expected = nullptr;
+            entry->name.compare_exchange_strong(expected, &g_name_storage[offset],
+                                                std::memory_order_release);
+        }
+    }
+    return CopyName(name, length, buffer, capacity);
 }
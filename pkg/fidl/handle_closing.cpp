@@ -32,6 +32,7 @@ public:
 
     void Walk() {
         Super::Walk();
+        FlushPendingHandles();
     }
 
     uint8_t* bytes() const { return bytes_; }
@@ -42,6 +43,10 @@ public:
         return true;
     }
 
+    bool ValidateStringData(const char* data, uint64_t size) const {
+        return true;
+    }
+
     void UnclaimedHandle(zx_handle_t* out_handle) {
         // This will never happen since we are returning numeric_limits::max() in num_handles.
         // We want to claim (close) all the handles.
@@ -50,11 +55,24 @@ public:
 
     void ClaimedHandle(zx_handle_t* out_handle, uint32_t idx) {
         if (*out_handle != ZX_HANDLE_INVALID) {
-            zx_handle_close(*out_handle);
+            if (pending_count_ == kMaxPendingHandles) {
+                FlushPendingHandles();
+            }
+            pending_handles_[pending_count_++] = *out_handle;
         }
         *out_handle = ZX_HANDLE_INVALID;
     }
 
+    bool AllHandlesPresent(const zx_handle_t* handles, uint32_t count) const {
+        // Invalid handles are skipped by zx_handle_close_many.
+        return true;
+    }
+    void ClaimedHandles(zx_handle_t* handles, uint32_t count, uint32_t idx) {
+        // Return value intentionally ignored: this is best-effort cleanup.
+        zx_handle_close_many(handles, count);
+        fidl::internal::FillHandles(handles, count, ZX_HANDLE_INVALID);
+    }
+
     template <class T>
     void UpdatePointer(T* const* p, T* v) {}
 
@@ -79,11 +97,25 @@ public:
     zx_status_t status() const { return status_; }
 
 private:
+    // Handles found one at a time are gathered here and closed together.
+    static constexpr uint32_t kMaxPendingHandles = 64u;
+
+    void FlushPendingHandles() {
+        if (pending_count_ != 0u) {
+            // Return value intentionally ignored: this is best-effort cleanup.
+            zx_handle_close_many(pending_handles_, pending_count_);
+            pending_count_ = 0u;
+        }
+    }
+
     // Message state passed in to the constructor.
     uint8_t* const bytes_;
     const uint32_t num_bytes_;
     const char** const out_error_msg_;
     zx_status_t status_ = ZX_OK;
+
+    uint32_t pending_count_ = 0u;
+    zx_handle_t pending_handles_[kMaxPendingHandles];
 };
 
 } // namespace
@@ -93,6 +125,9 @@ private:
 zx_status_t fidl_close_handles(const fidl_type_t* type, void* bytes, uint32_t num_bytes,
                                const char** out_error_msg) {
 #if __Fuchsia__
+    if (bytes != nullptr && fidl::internal::IsPointerFreeStructOfSize(type, num_bytes)) {
+        return ZX_OK;  // there are no handles to close
+    }
     FidlHandleCloser handle_closer(type, bytes, num_bytes, out_error_msg);
     handle_closer.Walk();
     return handle_closer.status();
@@ -16,7 +16,19 @@ __BEGIN_CDECLS
 // vectors) counts as one step in the recursion depth.
 #define FIDL_RECURSION_DEPTH 32
 
+// Options for |fidl_decode_etc| and |fidl_validate_etc|.
+//
+// FIDL_CODING_CHECK_UTF8 rejects messages containing a string that is not
+// well-formed UTF-8. The check reads every byte of every string, so callers on
+// latency-critical paths may prefer to leave it off and check only the strings
+// they care about.
+#define FIDL_CODING_CHECK_UTF8 ((uint32_t)1u)
+
 // See https://fuchsia.googlesource.com/docs/+/master/development/languages/fidl/languages/c.md#fidl_encode-fidl_encode_msg
+//
+// Encoding checks bounds, handle counts, and out-of-line claims as it walks
+// the message, so a successful encode produces bytes and handles that
+// |fidl_validate| would accept. Callers need not validate the result again.
 zx_status_t fidl_encode(const fidl_type_t* type, void* bytes, uint32_t num_bytes,
                         zx_handle_t* handles, uint32_t max_handles,
                         uint32_t* out_actual_handles, const char** out_error_msg);
@@ -27,6 +39,11 @@ zx_status_t fidl_encode_msg(const fidl_type_t* type, fidl_msg_t* msg,
 zx_status_t fidl_decode(const fidl_type_t* type, void* bytes, uint32_t num_bytes,
                         const zx_handle_t* handles, uint32_t num_handles,
                         const char** error_msg_out);
+// As |fidl_decode|, with additional checks selected by |options|, a bitwise
+// OR of FIDL_CODING_* flags.
+zx_status_t fidl_decode_etc(const fidl_type_t* type, void* bytes, uint32_t num_bytes,
+                            const zx_handle_t* handles, uint32_t num_handles,
+                            uint32_t options, const char** error_msg_out);
 zx_status_t fidl_decode_msg(const fidl_type_t* type, fidl_msg_t* msg,
                             const char** out_error_msg);
 
@@ -35,18 +52,37 @@ zx_status_t fidl_decode_msg(const fidl_type_t* type, fidl_msg_t* msg,
 // The |bytes| are not modified.
 zx_status_t fidl_validate(const fidl_type_t* type, const void* bytes, uint32_t num_bytes,
                           uint32_t num_handles, const char** error_msg_out);
+// As |fidl_validate|, with additional checks selected by |options|, a bitwise
+// OR of FIDL_CODING_* flags.
+zx_status_t fidl_validate_etc(const fidl_type_t* type, const void* bytes, uint32_t num_bytes,
+                              uint32_t num_handles, uint32_t options,
+                              const char** error_msg_out);
 zx_status_t fidl_validate_msg(const fidl_type_t* type, const fidl_msg_t* msg,
                               const char** out_error_msg);
 
 // Traverses a linearized FIDL message, closing all handles within it.
 // This function is a no-op on host side.
 //
-// Handle values in |bytes| are replaced with ZX_HANDLE_INVALID.
+// Handle values in |bytes| are replaced with ZX_HANDLE_INVALID. The handles are
+// closed in batches with |zx_handle_close_many| rather than one at a time.
 zx_status_t fidl_close_handles(const fidl_type_t* type, void* bytes, uint32_t num_bytes,
                                const char** out_error_msg);
 zx_status_t fidl_close_handles_msg(const fidl_type_t* type, const fidl_msg_t* msg,
                                    const char** out_error_msg);
 
+// Copies the decoded object |value| of the given |type| into |bytes|, laying
+// out its out-of-line objects contiguously in the order |fidl_encode| expects
+// and pointing each pointer in the copy at the copied object. The source
+// object's out-of-line parts may live anywhere in memory. Table envelope
+// sizes are recomputed for known fields.
+//
+// On success, stores the number of bytes used in |out_num_bytes|. Returns
+// ZX_ERR_BUFFER_TOO_SMALL if the linearized object does not fit in
+// |num_bytes|.
+zx_status_t fidl_linearize(const fidl_type_t* type, const void* value, void* bytes,
+                           uint32_t num_bytes, uint32_t* out_num_bytes,
+                           const char** out_error_msg);
+
 // Stores the name of a fidl type into the provided buffer.
 // Truncates the name if it is too long to fit into the buffer.
 // Returns the number of characters written into the buffer.
@@ -0,0 +1,127 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_ARENA_BUILDER_H_
+#define LIB_FIDL_CPP_ARENA_BUILDER_H_
+
+#include <new>  // For placement new.
+#include <stdalign.h>
+#include <stdint.h>
+
+#include <lib/fidl/cpp/message_part.h>
+#include <zircon/compiler.h>
+#include <zircon/fidl.h>
+#include <zircon/types.h>
+
+namespace fidl {
+
+// ArenaBuilder helps FIDL clients store decoded objects whose total size is
+// not known in advance.
+//
+// Like |Builder|, objects are allocated sequentially with appropriate alignment
+// for in-place encoding. Unlike |Builder|, an |ArenaBuilder| owns its storage
+// and never runs out: when the current chunk is full, it chains a new one.
+// Objects that span several chunks are not contiguous, so the message is made
+// contiguous at the end with |Linearize|. If everything fit in the first
+// chunk, |Finalize| hands out that chunk directly and no copy is needed.
+//
+// |high_water_mark| reports the most bytes ever allocated between resets, which
+// callers can use to size the first chunk of later builders.
+class ArenaBuilder {
+public:
+    static constexpr uint32_t kDefaultChunkSize = 4096u;
+
+    // Creates a builder whose first chunk holds |chunk_size| bytes. Later
+    // chunks are at least this size.
+    explicit ArenaBuilder(uint32_t chunk_size = kDefaultChunkSize);
+    ~ArenaBuilder();
+
+    ArenaBuilder(const ArenaBuilder& other) = delete;
+    ArenaBuilder& operator=(const ArenaBuilder& other) = delete;
+
+    // Allocates storage of sufficient size to store an object of type |T|.
+    // The object must have alignment constraints that are compatible with
+    // FIDL messages.
+    //
+    // Returns nullptr only if memory is exhausted.
+    template <typename T>
+    T* New() {
+        static_assert(alignof(T) <= FIDL_ALIGNMENT, "");
+        static_assert(sizeof(T) <= ZX_CHANNEL_MAX_MSG_BYTES, "");
+        if (void* ptr = Allocate(sizeof(T)))
+            return new (ptr) T;
+        return nullptr;
+    }
+
+    // Allocates storage of sufficient size to store |count| objects of type
+    // |T|. The object must have alignment constraints that are compatible with
+    // FIDL messages.
+    //
+    // Returns nullptr if the array would not fit in a channel message or if
+    // memory is exhausted.
+    template <typename T>
+    T* NewArray(uint32_t count) {
+        static_assert(alignof(T) <= FIDL_ALIGNMENT, "");
+        static_assert(sizeof(T) <= ZX_CHANNEL_MAX_MSG_BYTES, "");
+        if (sizeof(T) * static_cast<uint64_t>(count) > ZX_CHANNEL_MAX_MSG_BYTES)
+            return nullptr;
+        if (void* ptr = Allocate(static_cast<uint32_t>(sizeof(T) * count)))
+            return new (ptr) T[count];
+        return nullptr;
+    }
+
+    // The number of bytes allocated since construction or the last |Reset|,
+    // including alignment padding. A linearized message is never larger.
+    uint32_t allocated_bytes() const { return allocated_bytes_; }
+
+    // The largest value |allocated_bytes| has reached over the lifetime of
+    // this builder.
+    uint32_t high_water_mark() const;
+
+    // Whether every object allocated so far lives in the first chunk, in
+    // allocation order.
+    bool is_contiguous() const { return head_ == nullptr || head_->next == nullptr; }
+
+    // Returns a |BytePart| containing the allocated objects, without copying.
+    //
+    // Requires |is_contiguous()|. The bytes remain owned by this builder and
+    // are valid until it is reset or destroyed.
+    BytePart Finalize();
+
+    // Copies the object of the given |type| rooted at |value|, which must have
+    // been allocated from this builder, into |bytes|, laying it out
+    // contiguously as a FIDL message expects. Sets the actual size of |bytes|
+    // on success.
+    //
+    // See |fidl_linearize|.
+    zx_status_t Linearize(const fidl_type_t* type, const void* value, BytePart* bytes,
+                          const char** error_msg_out);
+
+    // Discards all allocated objects, keeping the first chunk for reuse.
+    void Reset();
+
+private:
+    struct Chunk {
+        Chunk* next;
+        uint32_t capacity;
+        uint32_t at;
+
+        uint8_t* data() { return reinterpret_cast<uint8_t*>(this + 1); }
+    };
+    static_assert(sizeof(Chunk) % FIDL_ALIGNMENT == 0, "");
+
+    // Returns |size| bytes of zeroed memory aligned to at least FIDL_ALIGNMENT
+    void* Allocate(uint32_t size);
+    void FreeChunks(Chunk* chunk);
+
+    const uint32_t chunk_size_;
+    Chunk* head_ = nullptr;
+    Chunk* tail_ = nullptr;
+    uint32_t allocated_bytes_ = 0u;
+    uint32_t high_water_mark_ = 0u;
+};
+
+} // namespace fidl
+
+#endif //  LIB_FIDL_CPP_ARENA_BUILDER_H_
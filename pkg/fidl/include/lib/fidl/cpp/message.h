@@ -94,7 +94,10 @@ public:
     // The storage for the bytes of the message.
     BytePart& bytes() { return bytes_; }
     const BytePart& bytes() const { return bytes_; }
-    void set_bytes(BytePart bytes) { bytes_ = static_cast<BytePart&&>(bytes); }
+    void set_bytes(BytePart bytes) {
+        bytes_ = static_cast<BytePart&&>(bytes);
+        encoded_type_ = nullptr;
+    }
 
     // The storage for the handles of the message.
     //
@@ -109,6 +112,10 @@ public:
     // The message must previously have been in a decoded state, for example,
     // either by being built in a decoded state using a |Builder| or having been
     // decoded using the |Decode| method.
+    //
+    // The encoding walk checks bounds, handle counts, and out-of-line claims,
+    // so a successful |Encode| also marks the message as validated against
+    // |type|. See |Validate|.
     zx_status_t Encode(const fidl_type_t* type, const char** error_msg_out);
 
     // Decodes the message in-place.
@@ -124,13 +131,29 @@ public:
     // being read from a zx_channel_t or having been created in that state.
     //
     // Does not modify the message.
+    //
+    // If the message was produced by a successful call to |Encode| with the
+    // same |type|, the message is already known to be valid and this method
+    // returns ZX_OK without walking the message again. Callers that mutate
+    // the encoded bytes after |Encode| void that guarantee and must call
+    // |set_bytes| or |Encode| again.
     zx_status_t Validate(const fidl_type_t* type, const char** error_msg_out) const;
 
+    // Whether this message is known to be a valid encoding of |type| because
+    // it was produced by a successful |Encode| with that type.
+    bool is_encoded_as(const fidl_type_t* type) const {
+        return type != nullptr && encoded_type_ == type;
+    }
+
     // Read a message from the given channel.
     //
     // The bytes read from the channel are stored in bytes() and the handles
     // read from the channel are stored in handles(). Existing data in these
     // buffers is overwritten.
+    //
+    // If the next message does not fit in these buffers, returns
+    // ZX_ERR_BUFFER_TOO_SMALL and, unless |flags| says otherwise, leaves the
+    // message in the channel so that it can be read into larger buffers.
     zx_status_t Read(zx_handle_t channel, uint32_t flags);
 
     // Writes a message to the given channel.
@@ -142,6 +165,19 @@ public:
     // consumed by this operation.
     zx_status_t Write(zx_handle_t channel, uint32_t flags);
 
+    // Writes a message to the given channel whose bytes are the concatenation
+    // of the |part_count| parts in |parts|, in place of bytes().
+    //
+    // Lets a proxy send a large payload that is stored elsewhere without first
+    // copying it into bytes(). A single part is written in place. Otherwise the
+    // parts are copied once, into a buffer on the stack for small messages or
+    // into one from the calling thread's message buffer pool.
+    //
+    // The handles stored in handles() are written to the channel. As with
+    // |Write|, handles() will be empty afterwards, even if the write fails.
+    zx_status_t WriteGather(zx_handle_t channel, uint32_t flags,
+                            const BytePart* parts, size_t part_count);
+
     // Issues a synchronous send and receive transaction on the given channel.
     //
     // The bytes stored in bytes() are written to the channel and the handles
@@ -165,6 +201,10 @@ public:
 private:
     BytePart bytes_;
     HandlePart handles_;
+
+    // The type against which |bytes_| and |handles_| were last encoded, or
+    // nullptr if the message is not known to be a valid encoded message.
+    const fidl_type_t* encoded_type_ = nullptr;
 };
 
 } // namespace fidl
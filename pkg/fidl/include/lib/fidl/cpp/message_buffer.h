@@ -9,11 +9,53 @@
 
 #include <lib/fidl/cpp/builder.h>
 #include <lib/fidl/cpp/message.h>
+#include <lib/fidl/message_buffer_pool.h>
 #include <zircon/fidl.h>
 #include <zircon/types.h>
 
 namespace fidl {
 
+// A cache of buffers large enough for any channel message, owned by a single
+// thread. See <lib/fidl/message_buffer_pool.h>.
+class MessageBufferPool {
+public:
+    // The number of buffers a pool keeps for reuse. Releasing a buffer into a
+    // full pool frees it.
+    static constexpr uint32_t kMaxCachedBuffers = 4u;
+
+    // The size of each buffer.
+    static constexpr size_t kBufferSize =
+        FIDL_MESSAGE_BUFFER_POOL_HANDLES_OFFSET +
+        ZX_CHANNEL_MAX_MSG_HANDLES * sizeof(zx_handle_t);
+
+    MessageBufferPool();
+    ~MessageBufferPool();
+
+    MessageBufferPool(const MessageBufferPool&) = delete;
+    MessageBufferPool& operator=(const MessageBufferPool&) = delete;
+
+    // Returns the pool for the calling thread.
+    static MessageBufferPool* GetForCurrentThread();
+
+    // Returns a cached buffer, or allocates a new one if none is cached.
+    uint8_t* Acquire();
+
+    // Caches |buffer| for reuse, or frees it if the pool is full.
+    void Release(uint8_t* buffer);
+
+    // The number of calls to |Acquire| that reused a cached buffer.
+    uint64_t hit_count() const { return hit_count_; }
+
+    // The number of calls to |Acquire| that allocated a new buffer.
+    uint64_t miss_count() const { return miss_count_; }
+
+private:
+    uint8_t* cached_[kMaxCachedBuffers];
+    uint32_t cached_count_ = 0u;
+    uint64_t hit_count_ = 0u;
+    uint64_t miss_count_ = 0u;
+};
+
 class MessageBuffer {
 public:
     // Creates a |MessageBuffer| that allocates buffers for message of the
@@ -24,7 +66,15 @@ public:
         uint32_t bytes_capacity = ZX_CHANNEL_MAX_MSG_BYTES,
         uint32_t handles_capacity = ZX_CHANNEL_MAX_MSG_HANDLES);
 
-    // The memory that backs the message is freed by this destructor.
+    // Creates a |MessageBuffer| of ZX_CHANNEL_MAX_MSG_BYTES bytes and
+    // ZX_CHANNEL_MAX_MSG_HANDLES handles backed by a buffer from |pool|.
+    //
+    // The buffer is returned to |pool| when the |MessageBuffer| is destructed,
+    // which must happen on the thread that owns |pool|.
+    explicit MessageBuffer(MessageBufferPool* pool);
+
+    // The memory that backs the message is freed by this destructor, or
+    // returned to the pool it came from.
     ~MessageBuffer();
 
     // The memory in which bytes can be stored in this buffer.
@@ -48,6 +98,7 @@ public:
     Builder CreateBuilder();
 
 private:
+    MessageBufferPool* const pool_;
     uint8_t* const buffer_;
     const uint32_t bytes_capacity_;
     const uint32_t handles_capacity_;
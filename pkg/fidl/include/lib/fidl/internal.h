@@ -66,15 +66,33 @@ enum FidlTypeTag : uint32_t {
 
 // Though the |size| is implied by the fields, computing that information is not the purview of this
 // library. It's easier for the compiler to stash it.
+//
+// Fields with no interesting coding information are elided from |fields|, so a
+// struct with no out-of-line data and no handles has no fields at all. Such a
+// struct is |pointer_free|: its encoded and decoded forms are identical and
+// coding it reduces to a size check.
+//
+// |max_depth| is the most frames the coders stack at once to walk the struct:
+// one for the struct itself and one for each field with coding information on
+// the way down to the deepest such field, whether that field is an aggregate
+// or a leaf, such as a string or a handle. Each element of an array takes a
+// frame below the array's. A pointer, a vector or a union shares its frame
+// with what it points to or contains. The coders size their stack of frames
+// from it when this struct is the top-level type of a message.
+// The compiler emits the real depth; tables that omit it, or types that recurse
+// through pointers, get FIDL_RECURSION_DEPTH.
 struct FidlCodedStruct {
     const FidlField* const fields;
     const uint32_t field_count;
     const uint32_t size;
     const char* name; // may be nullptr if omitted at compile time
+    const bool pointer_free;
+    const uint32_t max_depth;
 
     constexpr FidlCodedStruct(const FidlField* fields, uint32_t field_count, uint32_t size,
-                              const char* name)
-        : fields(fields), field_count(field_count), size(size), name(name) {}
+                              const char* name, uint32_t max_depth = FIDL_RECURSION_DEPTH)
+        : fields(fields), field_count(field_count), size(size), name(name),
+          pointer_free(field_count == 0u), max_depth(field_count == 0u ? 1u : max_depth) {}
 };
 
 struct FidlCodedStructPointer {
@@ -84,14 +102,16 @@ struct FidlCodedStructPointer {
         : struct_type(struct_type) {}
 };
 
+// |max_depth| has the same meaning as for |FidlCodedStruct|.
 struct FidlCodedTable {
     const FidlTableField* const fields;
     const uint32_t field_count;
     const char* name; // may be nullptr if omitted at compile time
+    const uint32_t max_depth;
 
     constexpr FidlCodedTable(const FidlTableField* fields, uint32_t field_count,
-                             const char* name)
-        : fields(fields), field_count(field_count), name(name) {}
+                             const char* name, uint32_t max_depth = FIDL_RECURSION_DEPTH)
+        : fields(fields), field_count(field_count), name(name), max_depth(max_depth) {}
 };
 
 struct FidlCodedTablePointer {
@@ -0,0 +1,143 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_LLCPP_ARENA_H_
+#define LIB_FIDL_LLCPP_ARENA_H_
+
+#include <new>  // For placement new.
+#include <stdint.h>
+#include <string.h>
+
+#include <lib/fidl/cpp/string_view.h>
+#include <lib/fidl/cpp/vector_view.h>
+#include <zircon/fidl.h>
+#include <zircon/types.h>
+
+namespace fidl {
+
+// Arena is a bump-pointer allocator for the out-of-line parts of LLCPP
+// messages: the contents of |VectorView| and |StringView| members and the
+// structs that nullable members point to.
+//
+// Allocations are carved sequentially out of a fixed buffer, usually on the
+// stack (see |InlineArena|). If an overflow size was given, an allocation that
+// does not fit in the buffer is placed in a heap chunk instead, so a message
+// that is usually small still works when it is occasionally large. Nothing is
+// freed individually: everything is released at once by |Reset| or when the
+// arena is destroyed, typically right after the message has been sent.
+//
+// Objects are never destroyed, so only types that are trivially destructible
+// should be allocated here, which is true of every LLCPP type.
+class Arena {
+public:
+    // Creates an arena over the |capacity| bytes at |buffer|, which must be
+    // aligned to FIDL_ALIGNMENT and outlive the arena. If |overflow_size| is
+    // zero, allocations fail once the buffer is full. Otherwise, heap chunks
+    // of at least |overflow_size| bytes are added as needed.
+    Arena(void* buffer, uint32_t capacity, uint32_t overflow_size = 0u);
+    ~Arena();
+
+    Arena(const Arena& other) = delete;
+    Arena& operator=(const Arena& other) = delete;
+
+    // Allocates a zeroed object of type |T|.
+    //
+    // Returns nullptr if the arena is full or memory is exhausted.
+    template <typename T>
+    T* New() {
+        static_assert(alignof(T) <= FIDL_ALIGNMENT, "");
+        if (void* ptr = Allocate(sizeof(T)))
+            return new (ptr) T;
+        return nullptr;
+    }
+
+    // Allocates |count| zeroed objects of type |T| and returns a view of them.
+    // A |count| of zero still yields a non-null view, so it is not mistaken for
+    // an absent vector.
+    //
+    // Returns a null view if the arena is full or memory is exhausted.
+    template <typename T>
+    VectorView<T> NewVectorView(uint64_t count) {
+        static_assert(alignof(T) <= FIDL_ALIGNMENT, "");
+        VectorView<T> view;
+        if (count > ZX_CHANNEL_MAX_MSG_BYTES / sizeof(T))
+            return view;
+        if (void* ptr = Allocate(static_cast<uint32_t>(sizeof(T) * count))) {
+            view.set_data(new (ptr) T[count]);
+            view.set_count(count);
+        }
+        return view;
+    }
+
+    // Copies |count| objects of type |T| from |data| into the arena and returns
+    // a view of the copy.
+    //
+    // Returns a null view if the arena is full or memory is exhausted.
+    template <typename T>
+    VectorView<T> CopyVectorView(const T* data, uint64_t count) {
+        VectorView<T> view = NewVectorView<T>(count);
+        if (!view.is_null() && count != 0u)
+            memcpy(view.mutable_data(), data, sizeof(T) * count);
+        return view;
+    }
+
+    // Copies the |size| bytes at |data| into the arena and returns a view of
+    // the copy. The copy is not null-terminated.
+    //
+    // Returns a null view if the arena is full or memory is exhausted.
+    StringView CopyStringView(const char* data, uint64_t size);
+
+    // The number of bytes allocated since construction or the last |Reset|,
+    // including alignment padding.
+    uint32_t allocated_bytes() const { return allocated_bytes_; }
+
+    // Whether any allocation has spilled out of the fixed buffer.
+    bool has_overflowed() const { return overflow_ != nullptr; }
+
+    // Releases everything allocated so far, freeing the overflow chunks. Views
+    // and pointers handed out by the arena must not be used afterwards.
+    void Reset();
+
+private:
+    struct Chunk {
+        Chunk* next;
+        uint64_t reserved;
+
+        uint8_t* data() { return reinterpret_cast<uint8_t*>(this + 1); }
+    };
+    static_assert(sizeof(Chunk) % FIDL_ALIGNMENT == 0, "");
+
+    // Returns |size| bytes of zeroed memory aligned to at least FIDL_ALIGNMENT.
+    void* Allocate(uint32_t size);
+    void* AllocateOverflow(uint32_t aligned_size);
+
+    uint8_t* const buffer_;
+    const uint32_t capacity_;
+    const uint32_t overflow_size_;
+
+    // Where the next allocation goes, and where the current region ends. The
+    // current region is either the fixed buffer or the newest overflow chunk.
+    uint8_t* at_;
+    uint8_t* end_;
+
+    Chunk* overflow_ = nullptr;
+    uint32_t allocated_bytes_ = 0u;
+};
+
+// An |Arena| whose fixed buffer of |Size| bytes is stored inline, so an
+// |InlineArena| declared as a local variable needs no heap until it overflows.
+template <uint32_t Size, uint32_t OverflowSize = 0u>
+class InlineArena : public Arena {
+    static_assert(Size % FIDL_ALIGNMENT == 0, "Size must be a multiple of FIDL_ALIGNMENT");
+
+public:
+    InlineArena() : Arena(buffer_, Size, OverflowSize) {}
+
+private:
+    alignas(FIDL_ALIGNMENT) uint8_t buffer_[Size];
+};
+
+} // namespace fidl
+
+#endif // LIB_FIDL_LLCPP_ARENA_H_
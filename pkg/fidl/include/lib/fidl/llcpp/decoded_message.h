@@ -11,6 +11,10 @@
 #include <type_traits>
 #include <zircon/fidl.h>
 
+#ifdef __Fuchsia__
+#include <lib/zx/channel.h>
+#endif
+
 namespace fidl {
 
 // `DecodedMessage` manages a linearized FIDL message in decoded form.
@@ -54,6 +58,25 @@ public:
         bytes_ = std::move(bytes);
     }
 
+    // Closes the handles that were not consumed and forgets the buffer region,
+    // leaving the message empty. The buffer itself is not touched.
+    void Reset() {
+        CloseHandles();
+        bytes_ = BytePart();
+    }
+
+    // Closes the handles that were not consumed and returns the buffer region,
+    // with no actual bytes, so the next message can be read into it.
+    //
+    // A server loop can pass the result straight back to |ReadAndDecode| to
+    // decode message after message into the same storage without clearing it.
+    BytePart ReleaseBuffer() {
+        CloseHandles();
+        BytePart bytes = std::move(bytes_);
+        bytes.set_actual(0);
+        return bytes;
+    }
+
     // Consumes an encoded message object containing FIDL encoded bytes and handles.
     // The current buffer region in DecodedMessage is always released.
     // Uses the FIDL encoding tables to deserialize the message in-place.
@@ -104,7 +127,8 @@ private:
     // destroy the handles it contains.
     void CloseHandles() {
 #ifdef __Fuchsia__
-        if (bytes_.data()) {
+        // Types without handles do not need to be walked.
+        if (FidlType::MaxNumHandles > 0 && bytes_.data()) {
             fidl_close_handles(FidlType::type, bytes_.data(), bytes_.actual(), nullptr);
         }
 #endif
@@ -114,6 +138,49 @@ private:
     BytePart bytes_;
 };
 
+#ifdef __Fuchsia__
+
+// Reads one message from |channel| into |buffer| and decodes it in place into
+// |out_message|, which then owns the message's handles.
+//
+// The handles are read straight into the handle table of an |EncodedMessage|,
+// which is sized at compile time, and the bytes are decoded where they were
+// read, so nothing is copied and no memory is allocated. On success,
+// |out_message| refers to |buffer|, which must outlive it.
+//
+// To reuse the same storage for the next message, pass
+// |out_message->ReleaseBuffer()| as |buffer|. If this fails, |out_message| is
+// left empty and the caller provides the buffer again.
+//
+// Returns ZX_ERR_SHOULD_WAIT if the channel is empty, and the errors of
+// |zx_channel_read| and |fidl_decode| otherwise. A message that has more
+// bytes or handles than |T| allows fails with ZX_ERR_BUFFER_TOO_SMALL and is
+// left in the channel.
+template <typename FidlType>
+zx_status_t ReadAndDecode(const zx::channel& channel, BytePart buffer,
+                          DecodedMessage<FidlType>* out_message,
+                          const char** out_error_msg) {
+    EncodedMessage<FidlType> encoded;
+    zx_status_t status = encoded.Initialize([&](BytePart& bytes, HandlePart& handles) {
+        bytes = std::move(buffer);
+        uint32_t actual_bytes = 0u;
+        uint32_t actual_handles = 0u;
+        zx_status_t status = channel.read(0u, bytes.data(), bytes.capacity(), &actual_bytes,
+                                          handles.data(), handles.capacity(), &actual_handles);
+        if (status == ZX_OK) {
+            bytes.set_actual(actual_bytes);
+            handles.set_actual(actual_handles);
+        }
+        return status;
+    });
+    if (status != ZX_OK) {
+        return status;
+    }
+    return out_message->DecodeFrom(&encoded, out_error_msg);
+}
+
+#endif
+
 }  // namespace fidl
 
 #endif // LIB_FIDL_LLCPP_DECODED_MESSAGE_H_
@@ -81,10 +81,25 @@ public:
 
     const HandlePart& handles() const { return handles_; }
 
+    // Empties the message so it can be filled again, for example by a server
+    // loop that reads message after message into the same storage.
+    //
+    // The handles are closed with a single |zx_handle_close_many|. The bytes
+    // part keeps pointing at the same buffer, with no actual bytes; neither
+    // the buffer nor the handle table is cleared.
+    void Reset() {
+        CloseHandles();
+        bytes_.set_actual(0);
+    }
+
     // Clears the contents of the EncodedMessage then invokes Callback
     // to initialize the EncodedMessage in-place then returns the callback's
     // result.
     //
+    // The bytes part handed to |callback| is the buffer from the previous use
+    // of this message, if any, with no actual bytes, so a message can be read
+    // again into the same buffer. |callback| may also replace it.
+    //
     // |callback| is a callable object whose arguments are (BytePart&, HandlePart&).
     template <typename Callback>
     decltype(auto) Initialize(Callback callback) {
@@ -97,8 +112,7 @@ public:
                 HandlePart&,
                 typename fit::template callable_traits<Callback>::args::template at<1>>::value,
             "Callback signature must be: T(BytePart&, HandlePart&).");
-        bytes_ = BytePart();
-        CloseHandles();
+        Reset();
         return callback(bytes_, handles_);
     }
 
@@ -0,0 +1,154 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_LLCPP_SYNC_CALL_H_
+#define LIB_FIDL_LLCPP_SYNC_CALL_H_
+
+#include <memory>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+
+#include <lib/fidl/cpp/message_part.h>
+#include <lib/fidl/llcpp/decoded_message.h>
+#include <lib/fidl/llcpp/encoded_message.h>
+#include <lib/fidl/llcpp/traits.h>
+#include <lib/zx/channel.h>
+#include <lib/zx/time.h>
+#include <zircon/fidl.h>
+
+#ifdef __Fuchsia__
+#include <zircon/syscalls.h>
+#endif
+
+namespace fidl {
+
+// Messages whose maximum size is at most this many bytes are stored inline by
+// |MessageStorage|, which typically puts them on the stack.
+constexpr uint32_t kMaxInlineMessageStorage = 8192u;
+
+namespace internal {
+
+template <uint32_t Size, bool Inline>
+class MessageStorageImpl;
+
+template <uint32_t Size>
+class MessageStorageImpl<Size, true> {
+public:
+    uint8_t* data() { return data_; }
+
+private:
+    alignas(FIDL_ALIGNMENT) uint8_t data_[Size];
+};
+
+template <uint32_t Size>
+class MessageStorageImpl<Size, false> {
+public:
+    MessageStorageImpl() : data_(new uint8_t[Size]) {}
+
+    uint8_t* data() { return data_.get(); }
+
+private:
+    // operator new[] returns memory aligned for any fundamental type, which
+    // satisfies FIDL_ALIGNMENT.
+    std::unique_ptr<uint8_t[]> data_;
+};
+
+} // namespace internal
+
+// Storage large enough for any message of type |FidlType|.
+//
+// The size is computed at compile time from |FidlType::MaxSize|. Types whose
+// messages fit in |kMaxInlineMessageStorage| bytes are stored inline, so a
+// |MessageStorage| declared as a local variable needs no heap. Larger and
+// unbounded types fall back to a heap buffer, capped at the largest message a
+// channel can carry.
+template <typename FidlType>
+class MessageStorage {
+    static_assert(IsFidlType<FidlType>::value, "Only FIDL types allowed here");
+    static_assert(FidlType::MaxSize > 0, "Positive message size");
+
+public:
+    // The number of bytes available.
+    static constexpr uint32_t kSize = FidlType::MaxSize < ZX_CHANNEL_MAX_MSG_BYTES
+                                          ? FidlType::MaxSize
+                                          : ZX_CHANNEL_MAX_MSG_BYTES;
+
+    // Whether the storage is inline rather than on the heap.
+    static constexpr bool kIsInline = FidlType::MaxSize <= kMaxInlineMessageStorage;
+
+    MessageStorage() = default;
+    MessageStorage(const MessageStorage&) = delete;
+    MessageStorage& operator=(const MessageStorage&) = delete;
+
+    // A view of the whole storage, with nothing in it yet.
+    BytePart view() { return BytePart(storage_.data(), kSize); }
+
+private:
+    internal::MessageStorageImpl<kSize, kIsInline> storage_;
+};
+
+#ifdef __Fuchsia__
+
+// Encodes |request| in place, writes it to |channel|, and waits until
+// |deadline| for the response, which is read into |response_buffer| and
+// decoded in place into |out_response|.
+//
+// No memory is allocated: the request is encoded in the buffer it was built
+// in, the request and response handle tables are sized at compile time from
+// |MaxNumHandles|, and the caller provides the response bytes, typically from a
+// |MessageStorage<ResponseType>| on the stack.
+//
+// |request| is consumed, even on failure. On success, |out_response| refers to
+// |response_buffer|, which must outlive it.
+template <typename RequestType, typename ResponseType>
+zx_status_t Call(const zx::channel& channel, DecodedMessage<RequestType> request,
+                 BytePart response_buffer, DecodedMessage<ResponseType>* out_response,
+                 zx::time deadline, const char** out_error_msg) {
+    static_assert(IsFidlMessage<RequestType>::value, "Request must be a transactional message");
+    static_assert(IsFidlMessage<ResponseType>::value, "Response must be a transactional message");
+
+    EncodedMessage<RequestType> encoded_request;
+    zx_status_t status = request.EncodeTo(&encoded_request, out_error_msg);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    EncodedMessage<ResponseType> encoded_response;
+    status = encoded_response.Initialize(
+        [&](BytePart& bytes, HandlePart& handles) {
+            bytes = std::move(response_buffer);
+            zx_channel_call_args_t args;
+            args.wr_bytes = encoded_request.bytes().data();
+            args.wr_handles = encoded_request.handles().data();
+            args.rd_bytes = bytes.data();
+            args.rd_handles = handles.data();
+            args.wr_num_bytes = encoded_request.bytes().actual();
+            args.wr_num_handles = encoded_request.handles().actual();
+            args.rd_num_bytes = bytes.capacity();
+            args.rd_num_handles = handles.capacity();
+            uint32_t actual_bytes = 0u;
+            uint32_t actual_handles = 0u;
+            zx_status_t status = channel.call(0u, deadline, &args, &actual_bytes,
+                                              &actual_handles);
+            // The request's handles have been consumed whether or not the
+            // call succeeded.
+            encoded_request.ReleaseBytesAndHandles();
+            if (status == ZX_OK) {
+                bytes.set_actual(actual_bytes);
+                handles.set_actual(actual_handles);
+            }
+            return status;
+        });
+    if (status != ZX_OK) {
+        return status;
+    }
+    return out_response->DecodeFrom(&encoded_response, out_error_msg);
+}
+
+#endif
+
+} // namespace fidl
+
+#endif // LIB_FIDL_LLCPP_SYNC_CALL_H_
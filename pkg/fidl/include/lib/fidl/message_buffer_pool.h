@@ -0,0 +1,54 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_MESSAGE_BUFFER_POOL_H_
+#define LIB_FIDL_MESSAGE_BUFFER_POOL_H_
+
+#include <stdint.h>
+
+#include <zircon/compiler.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// A per-thread cache of buffers large enough for any channel message.
+//
+// Each buffer holds ZX_CHANNEL_MAX_MSG_BYTES bytes followed by
+// ZX_CHANNEL_MAX_MSG_HANDLES handles, starting at
+// FIDL_MESSAGE_BUFFER_POOL_HANDLES_OFFSET. Reading a message into a recycled
+// buffer avoids a large allocation every time a channel becomes readable.
+//
+// A buffer must be released on the thread that acquired it.
+#define FIDL_MESSAGE_BUFFER_POOL_HANDLES_OFFSET ZX_CHANNEL_MAX_MSG_BYTES
+
+// The number of bytes a reader should try to read a message into before
+// falling back to a pooled buffer.
+//
+// Most messages are far smaller than ZX_CHANNEL_MAX_MSG_BYTES. Readers first
+// read into a buffer of this size on the stack; if zx_channel_read reports
+// ZX_ERR_BUFFER_TOO_SMALL, the message stays in the channel and they read it
+// again into a buffer from the pool.
+#define FIDL_MESSAGE_INLINE_READ_BYTES 512u
+
+// Returns a buffer from the calling thread's pool, allocating one if the pool
+// is empty. Never returns NULL.
+uint8_t* fidl_message_buffer_pool_acquire(void);
+
+// Returns |buffer| to the calling thread's pool, or frees it if the pool is
+// full.
+void fidl_message_buffer_pool_release(uint8_t* buffer);
+
+typedef struct fidl_message_buffer_pool_stats {
+    // The number of acquisitions that reused a cached buffer.
+    uint64_t hits;
+    // The number of acquisitions that had to allocate a buffer.
+    uint64_t misses;
+} fidl_message_buffer_pool_stats_t;
+
+// Reports the counters of the calling thread's pool.
+void fidl_message_buffer_pool_get_stats(fidl_message_buffer_pool_stats_t* out_stats);
+
+__END_CDECLS
+
+#endif // LIB_FIDL_MESSAGE_BUFFER_POOL_H_
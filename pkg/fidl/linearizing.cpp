@@ -0,0 +1,293 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/fidl/coding.h>
+
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lib/fidl/internal.h>
+#include <zircon/assert.h>
+#include <zircon/compiler.h>
+
+#include "buffer_walker.h"
+
+namespace {
+
+// The layout of a table envelope: the sizes of the field's data followed by a
+// pointer to it.
+struct Envelope {
+    uint32_t num_bytes;
+    uint32_t num_handles;
+    void* data;
+};
+
+static_assert(sizeof(Envelope) == 2 * sizeof(uint64_t), "");
+
+// Copies a decoded object whose out-of-line parts may be scattered in memory
+// into a single buffer, laying the out-of-line parts out in the depth-first
+// order that |fidl_encode| expects and rewriting each pointer to refer to the
+// copy.
+class FidlLinearizer {
+public:
+    FidlLinearizer(uint8_t* buffer, uint32_t capacity, const char** out_error_msg)
+        : buffer_(buffer), capacity_(capacity), out_error_msg_(out_error_msg) {}
+
+    zx_status_t Linearize(const fidl_type_t* type, const void* value, uint32_t* out_num_bytes) {
+        if (type == nullptr) {
+            return Fail("Cannot linearize a null fidl type");
+        }
+        if (value == nullptr || buffer_ == nullptr) {
+            return Fail("Cannot linearize null bytes");
+        }
+        if (type->type_tag != fidl::kFidlTypeStruct && type->type_tag != fidl::kFidlTypeTable) {
+            return Fail("Message must be a struct or a table");
+        }
+        uint32_t offset;
+        if (!Copy(value, fidl::internal::TypeSize(type), &offset) ||
+            !Visit(type, offset, 0u)) {
+            return status_;
+        }
+        if (out_num_bytes != nullptr) {
+            *out_num_bytes = at_;
+        }
+        return ZX_OK;
+    }
+
+private:
+    template <typename T>
+    T* At(uint32_t offset) {
+        return reinterpret_cast<T*>(buffer_ + offset);
+    }
+
+    zx_status_t Fail(const char* error_msg) {
+        status_ = ZX_ERR_INVALID_ARGS;
+        if (out_error_msg_ != nullptr) {
+            *out_error_msg_ = error_msg;
+        }
+        return status_;
+    }
+
+    // Appends |size| bytes from |src| to the buffer, padded with zeros to
+    // FIDL_ALIGNMENT, and stores the offset of the copy in |out_offset|.
+    bool Copy(const void* src, uint64_t size, uint32_t* out_offset) {
+        constexpr uint64_t alignment_mask = FIDL_ALIGNMENT - 1;
+        const uint64_t limit = size > capacity_ - at_
+                                   ? UINT64_MAX
+                                   : (at_ + size + alignment_mask) & ~alignment_mask;
+        if (limit > capacity_) {
+            status_ = ZX_ERR_BUFFER_TOO_SMALL;
+            if (out_error_msg_ != nullptr) {
+                *out_error_msg_ = "Linearized message does not fit in the buffer";
+            }
+            return false;
+        }
+        memcpy(buffer_ + at_, src, static_cast<size_t>(size));
+        memset(buffer_ + at_ + size, 0, static_cast<size_t>(limit - at_ - size));
+        *out_offset = at_;
+        at_ = static_cast<uint32_t>(limit);
+        return true;
+    }
+
+    // Copies the object that |*ptr| points to, of |size| bytes, and points
+    // |*ptr| at the copy. |*out_offset| is left untouched if |*ptr| is null.
+    bool CopyPointee(void** ptr, uint64_t size, uint32_t* out_offset) {
+        if (*ptr == nullptr) {
+            return true;
+        }
+        if (!Copy(*ptr, size, out_offset)) {
+            return false;
+        }
+        *ptr = At<void>(*out_offset);
+        return true;
+    }
+
+    bool VisitStruct(const fidl::FidlCodedStruct* coded_struct, uint32_t offset, uint32_t depth) {
+        for (uint32_t i = 0; i < coded_struct->field_count; ++i) {
+            const fidl::FidlField& field = coded_struct->fields[i];
+            if (!Visit(field.type, offset + field.offset, depth)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool VisitTable(const fidl::FidlCodedTable* coded_table, uint32_t offset, uint32_t depth) {
+        auto envelopes_ptr = At<fidl_vector_t>(offset);
+        if (envelopes_ptr->data == nullptr) {
+            Fail("Table data cannot be absent");
+            return false;
+        }
+        uint64_t envelopes_size;
+        if (mul_overflow(envelopes_ptr->count, sizeof(Envelope), &envelopes_size)) {
+            Fail("integer overflow calculating table size");
+            return false;
+        }
+        const uint64_t count = envelopes_ptr->count;
+        uint32_t envelopes_offset = 0u;
+        if (!CopyPointee(&envelopes_ptr->data, envelopes_size, &envelopes_offset)) {
+            return false;
+        }
+        uint32_t known_index = 0u;
+        for (uint64_t i = 0; i < count; ++i) {
+            const uint32_t envelope_offset =
+                static_cast<uint32_t>(envelopes_offset + i * sizeof(Envelope));
+            const fidl::FidlTableField* known_field = nullptr;
+            if (known_index < coded_table->field_count &&
+                coded_table->fields[known_index].ordinal == i + 1) {
+                known_field = &coded_table->fields[known_index++];
+            }
+            auto envelope = At<Envelope>(envelope_offset);
+            if (envelope->data == nullptr) {
+                continue;
+            }
+            if (known_field == nullptr) {
+                // Unknown data is opaque: it is copied as it stands, with the
+                // size the envelope already records.
+                uint32_t data_offset;
+                if (!CopyPointee(&envelope->data, envelope->num_bytes, &data_offset)) {
+                    return false;
+                }
+                continue;
+            }
+            const uint32_t start_at = at_;
+            const uint32_t start_handles = handle_count_;
+            uint32_t data_offset;
+            if (!CopyPointee(&envelope->data, fidl::internal::TypeSize(known_field->type),
+                             &data_offset) ||
+                !Visit(known_field->type, data_offset, depth)) {
+                return false;
+            }
+            envelope->num_bytes = at_ - start_at;
+            envelope->num_handles = handle_count_ - start_handles;
+        }
+        return true;
+    }
+
+    bool VisitUnion(const fidl::FidlCodedUnion* coded_union, uint32_t offset, uint32_t depth) {
+        const fidl_union_tag_t tag = *At<fidl_union_tag_t>(offset);
+        if (tag >= coded_union->type_count) {
+            Fail("Tried to linearize a bad union discriminant");
+            return false;
+        }
+        const fidl_type_t* member = coded_union->types[tag];
+        if (member == nullptr) {
+            return true;
+        }
+        return Visit(member, offset + coded_union->data_offset, depth);
+    }
+
+    bool VisitElements(const fidl_type_t* element, uint64_t count, uint32_t element_size,
+                       uint32_t offset, uint32_t depth) {
+        for (uint64_t i = 0; i < count; ++i) {
+            if (!Visit(element, static_cast<uint32_t>(offset + i * element_size), depth)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Fixes up the out-of-line parts of the inline object of |type| that has
+    // already been copied to |offset|.
+    bool Visit(const fidl_type_t* type, uint32_t offset, uint32_t depth) {
+        if (++depth > FIDL_RECURSION_DEPTH) {
+            Fail("recursion depth exceeded linearizing message");
+            return false;
+        }
+        switch (type->type_tag) {
+        case fidl::kFidlTypeStruct:
+            return VisitStruct(&type->coded_struct, offset, depth);
+        case fidl::kFidlTypeStructPointer: {
+            const fidl::FidlCodedStruct* coded_struct = type->coded_struct_pointer.struct_type;
+            uint32_t struct_offset;
+            void** ptr = At<void*>(offset);
+            if (*ptr == nullptr) {
+                return true;
+            }
+            return CopyPointee(ptr, coded_struct->size, &struct_offset) &&
+                   VisitStruct(coded_struct, struct_offset, depth);
+        }
+        case fidl::kFidlTypeTable:
+            return VisitTable(&type->coded_table, offset, depth);
+        case fidl::kFidlTypeTablePointer: {
+            uint32_t table_offset;
+            void** ptr = At<void*>(offset);
+            if (*ptr == nullptr) {
+                return true;
+            }
+            return CopyPointee(ptr, sizeof(fidl_vector_t), &table_offset) &&
+                   VisitTable(type->coded_table_pointer.table_type, table_offset, depth);
+        }
+        case fidl::kFidlTypeUnion:
+            return VisitUnion(&type->coded_union, offset, depth);
+        case fidl::kFidlTypeUnionPointer: {
+            const fidl::FidlCodedUnion* coded_union = type->coded_union_pointer.union_type;
+            uint32_t union_offset;
+            void** ptr = At<void*>(offset);
+            if (*ptr == nullptr) {
+                return true;
+            }
+            return CopyPointee(ptr, coded_union->size, &union_offset) &&
+                   VisitUnion(coded_union, union_offset, depth);
+        }
+        case fidl::kFidlTypeArray:
+            return VisitElements(type->coded_array.element,
+                                 type->coded_array.array_size / type->coded_array.element_size,
+                                 type->coded_array.element_size, offset, depth);
+        case fidl::kFidlTypeString: {
+            auto string_ptr = At<fidl_string_t>(offset);
+            uint32_t data_offset;
+            return CopyPointee(reinterpret_cast<void**>(&string_ptr->data), string_ptr->size,
+                               &data_offset);
+        }
+        case fidl::kFidlTypeHandle:
+            if (*At<zx_handle_t>(offset) != ZX_HANDLE_INVALID) {
+                ++handle_count_;
+            }
+            return true;
+        case fidl::kFidlTypeVector: {
+            auto vector_ptr = At<fidl_vector_t>(offset);
+            if (vector_ptr->data == nullptr) {
+                return true;
+            }
+            const fidl::FidlCodedVector& coded_vector = type->coded_vector;
+            uint64_t size;
+            if (mul_overflow(vector_ptr->count, coded_vector.element_size, &size)) {
+                Fail("integer overflow calculating vector size");
+                return false;
+            }
+            const uint64_t count = vector_ptr->count;
+            uint32_t data_offset;
+            if (!CopyPointee(&vector_ptr->data, size, &data_offset)) {
+                return false;
+            }
+            if (coded_vector.element == nullptr) {
+                return true;
+            }
+            return VisitElements(coded_vector.element, count, coded_vector.element_size,
+                                 data_offset, depth);
+        }
+        }
+        Fail("Tried to linearize an unknown type");
+        return false;
+    }
+
+    uint8_t* const buffer_;
+    const uint32_t capacity_;
+    const char** const out_error_msg_;
+    uint32_t at_ = 0u;
+    uint32_t handle_count_ = 0u;
+    zx_status_t status_ = ZX_OK;
+};
+
+} // namespace
+
+zx_status_t fidl_linearize(const fidl_type_t* type, const void* value, void* bytes,
+                           uint32_t num_bytes, uint32_t* out_num_bytes,
+                           const char** out_error_msg) {
+    FidlLinearizer linearizer(static_cast<uint8_t*>(bytes), num_bytes, out_error_msg);
+    return linearizer.Linearize(type, value, out_num_bytes);
+}
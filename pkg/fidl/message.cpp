@@ -8,6 +8,7 @@
 
 #include <lib/fidl/coding.h>
 #include <lib/fidl/cpp/builder.h>
+#include <lib/fidl/message_buffer_pool.h>
 
 #ifdef __Fuchsia__
 #include <zircon/syscalls.h>
@@ -30,11 +31,16 @@ Message::~Message() {
 
 Message::Message(Message&& other)
     : bytes_(static_cast<BytePart&&>(other.bytes_)),
-      handles_(static_cast<HandlePart&&>(other.handles_)) {}
+      handles_(static_cast<HandlePart&&>(other.handles_)),
+      encoded_type_(other.encoded_type_) {
+    other.encoded_type_ = nullptr;
+}
 
 Message& Message::operator=(Message&& other) {
     bytes_ = static_cast<BytePart&&>(other.bytes_);
     handles_ = static_cast<HandlePart&&>(other.handles_);
+    encoded_type_ = other.encoded_type_;
+    other.encoded_type_ = nullptr;
     return *this;
 }
 
@@ -44,8 +50,14 @@ zx_status_t Message::Encode(const fidl_type_t* type,
     zx_status_t status = fidl_encode(type, bytes_.data(), bytes_.actual(),
                                      handles_.data(), handles_.capacity(),
                                      &actual_handles, error_msg_out);
-    if (status == ZX_OK)
+    if (status == ZX_OK) {
         handles_.set_actual(actual_handles);
+        // fidl_encode performs every check fidl_validate would perform on the
+        // result, so there is no need to walk the message a second time.
+        encoded_type_ = type;
+    } else {
+        encoded_type_ = nullptr;
+    }
     return status;
 }
 
@@ -55,11 +67,14 @@ zx_status_t Message::Decode(const fidl_type_t* type,
                                      handles_.data(), handles_.actual(),
                                      error_msg_out);
     ClearHandlesUnsafe();
+    encoded_type_ = nullptr;
     return status;
 }
 
 zx_status_t Message::Validate(const fidl_type_t* type,
                               const char** error_msg_out) const {
+    if (is_encoded_as(type))
+        return ZX_OK;
     return fidl_validate(type, bytes_.data(), bytes_.actual(),
                          handles_.actual(), error_msg_out);
 }
@@ -71,6 +86,7 @@ zx_status_t Message::Read(zx_handle_t channel, uint32_t flags) {
     zx_status_t status = zx_channel_read(
         channel, flags, bytes_.data(), handles_.data(), bytes_.capacity(),
         handles_.capacity(), &actual_bytes, &actual_handles);
+    encoded_type_ = nullptr;
     if (status == ZX_OK) {
         bytes_.set_actual(actual_bytes);
         handles_.set_actual(actual_handles);
@@ -86,6 +102,38 @@ zx_status_t Message::Write(zx_handle_t channel, uint32_t flags) {
     return status;
 }
 
+zx_status_t Message::WriteGather(zx_handle_t channel, uint32_t flags,
+                                 const BytePart* parts, size_t part_count) {
+    size_t size = 0u;
+    for (size_t i = 0u; i < part_count; i++)
+        size += parts[i].actual();
+    zx_status_t status;
+    if (size > ZX_CHANNEL_MAX_MSG_BYTES) {
+        zx_handle_close_many(handles_.data(), handles_.actual());
+        status = ZX_ERR_OUT_OF_RANGE;
+    } else if (part_count == 1u) {
+        status = zx_channel_write(channel, flags, parts[0].data(),
+                                  parts[0].actual(), handles_.data(),
+                                  handles_.actual());
+    } else {
+        uint8_t inline_bytes[FIDL_MESSAGE_INLINE_READ_BYTES];
+        uint8_t* bytes = size <= sizeof(inline_bytes)
+                             ? inline_bytes
+                             : fidl_message_buffer_pool_acquire();
+        uint32_t offset = 0u;
+        for (size_t i = 0u; i < part_count; i++) {
+            memcpy(bytes + offset, parts[i].data(), parts[i].actual());
+            offset += parts[i].actual();
+        }
+        status = zx_channel_write(channel, flags, bytes, offset,
+                                  handles_.data(), handles_.actual());
+        if (bytes != inline_bytes)
+            fidl_message_buffer_pool_release(bytes);
+    }
+    ClearHandlesUnsafe();
+    return status;
+}
+
 zx_status_t Message::Call(zx_handle_t channel, uint32_t flags,
                           zx_time_t deadline, Message* response) {
     zx_channel_call_args_t args;
@@ -102,6 +150,7 @@ zx_status_t Message::Call(zx_handle_t channel, uint32_t flags,
     zx_status_t status = zx_channel_call(channel, flags, deadline, &args,
                                          &actual_bytes, &actual_handles);
     ClearHandlesUnsafe();
+    response->encoded_type_ = nullptr;
     if (status == ZX_OK) {
         response->bytes_.set_actual(actual_bytes);
         response->handles_.set_actual(actual_handles);
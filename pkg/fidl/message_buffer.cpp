@@ -10,7 +10,7 @@
 namespace fidl {
 namespace {
 
-uint64_t AddPadding(uint32_t offset) {
+constexpr uint64_t AddPadding(uint32_t offset) {
     constexpr uint32_t kMask = alignof(zx_handle_t) - 1;
     // Cast before addition to avoid overflow.
     return static_cast<uint64_t>(offset) + static_cast<uint64_t>(offset & kMask);
@@ -22,16 +22,62 @@ size_t GetAllocSize(uint32_t bytes_capacity, uint32_t handles_capacity) {
 
 } // namespace
 
+static_assert(FIDL_MESSAGE_BUFFER_POOL_HANDLES_OFFSET == AddPadding(ZX_CHANNEL_MAX_MSG_BYTES),
+              "pooled buffers must use the MessageBuffer layout");
+
+MessageBufferPool::MessageBufferPool() = default;
+
+MessageBufferPool::~MessageBufferPool() {
+    for (uint32_t i = 0; i < cached_count_; ++i) {
+        free(cached_[i]);
+    }
+}
+
+MessageBufferPool* MessageBufferPool::GetForCurrentThread() {
+    static thread_local MessageBufferPool pool;
+    return &pool;
+}
+
+uint8_t* MessageBufferPool::Acquire() {
+    if (cached_count_ > 0u) {
+        ++hit_count_;
+        return cached_[--cached_count_];
+    }
+    ++miss_count_;
+    uint8_t* buffer = static_cast<uint8_t*>(malloc(kBufferSize));
+    ZX_ASSERT_MSG(buffer, "malloc returned NULL in MessageBufferPool::Acquire()");
+    return buffer;
+}
+
+void MessageBufferPool::Release(uint8_t* buffer) {
+    if (cached_count_ == kMaxCachedBuffers) {
+        free(buffer);
+        return;
+    }
+    cached_[cached_count_++] = buffer;
+}
+
 MessageBuffer::MessageBuffer(uint32_t bytes_capacity,
                              uint32_t handles_capacity)
-    : buffer_(static_cast<uint8_t*>(malloc(GetAllocSize(bytes_capacity, handles_capacity)))),
+    : pool_(nullptr),
+      buffer_(static_cast<uint8_t*>(malloc(GetAllocSize(bytes_capacity, handles_capacity)))),
       bytes_capacity_(bytes_capacity),
       handles_capacity_(handles_capacity) {
     ZX_ASSERT_MSG(buffer_, "malloc returned NULL in MessageBuffer::MessageBuffer()");
 }
 
+MessageBuffer::MessageBuffer(MessageBufferPool* pool)
+    : pool_(pool),
+      buffer_(pool->Acquire()),
+      bytes_capacity_(ZX_CHANNEL_MAX_MSG_BYTES),
+      handles_capacity_(ZX_CHANNEL_MAX_MSG_HANDLES) {}
+
 MessageBuffer::~MessageBuffer() {
-    free(buffer_);
+    if (pool_) {
+        pool_->Release(buffer_);
+    } else {
+        free(buffer_);
+    }
 }
 
 zx_handle_t* MessageBuffer::handles() const {
@@ -48,3 +94,17 @@ Builder MessageBuffer::CreateBuilder() {
 }
 
 } // namespace fidl
+
+uint8_t* fidl_message_buffer_pool_acquire(void) {
+    return fidl::MessageBufferPool::GetForCurrentThread()->Acquire();
+}
+
+void fidl_message_buffer_pool_release(uint8_t* buffer) {
+    fidl::MessageBufferPool::GetForCurrentThread()->Release(buffer);
+}
+
+void fidl_message_buffer_pool_get_stats(fidl_message_buffer_pool_stats_t* out_stats) {
+    const fidl::MessageBufferPool* pool = fidl::MessageBufferPool::GetForCurrentThread();
+    out_stats->hits = pool->hit_count();
+    out_stats->misses = pool->miss_count();
+}
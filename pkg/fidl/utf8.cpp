@@ -0,0 +1,118 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "utf8.h"
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace fidl {
+namespace internal {
+namespace {
+
+// Returns the number of leading ASCII bytes in |s|, rounded down to the
+// width of the vector kernel. The scalar loop below picks up from there.
+uint64_t SkipAscii(const uint8_t* s, uint64_t size) {
+    uint64_t i = 0u;
+#if defined(__AVX2__)
+    for (; i + 32u <= size; i += 32u) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        if (_mm256_movemask_epi8(chunk) != 0) {
+            break;
+        }
+    }
+#elif defined(__SSE2__)
+    for (; i + 16u <= size; i += 16u) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        if (_mm_movemask_epi8(chunk) != 0) {
+            break;
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 16u <= size; i += 16u) {
+        if (vmaxvq_u8(vld1q_u8(s + i)) >= 0x80u) {
+            break;
+        }
+    }
+#else
+    for (; i + 8u <= size; i += 8u) {
+        uint64_t chunk;
+        memcpy(&chunk, s + i, sizeof(chunk));
+        if ((chunk & UINT64_C(0x8080808080808080)) != 0u) {
+            break;
+        }
+    }
+#endif
+    return i;
+}
+
+bool IsContinuation(uint8_t byte) {
+    return (byte & 0xc0u) == 0x80u;
+}
+
+} // namespace
+
+bool IsValidUtf8(const char* data, uint64_t size) {
+    const uint8_t* s = reinterpret_cast<const uint8_t*>(data);
+    uint64_t i = 0u;
+    while (i < size) {
+        i += SkipAscii(s + i, size - i);
+        if (i == size) {
+            return true;
+        }
+        const uint8_t byte = s[i];
+        if (byte < 0x80u) {
+            ++i;
+            continue;
+        }
+        // The second byte of a multi-byte sequence has a narrower range
+        // than other continuation bytes for some leading bytes; this is what
+        // excludes overlong encodings, surrogates, and values past U+10FFFF.
+        uint64_t length;
+        uint8_t second_min = 0x80u;
+        uint8_t second_max = 0xbfu;
+        if (byte >= 0xc2u && byte <= 0xdfu) {
+            length = 2u;
+        } else if (byte >= 0xe0u && byte <= 0xefu) {
+            length = 3u;
+            if (byte == 0xe0u) {
+                second_min = 0xa0u;
+            } else if (byte == 0xedu) {
+                second_max = 0x9fu;
+            }
+        } else if (byte >= 0xf0u && byte <= 0xf4u) {
+            length = 4u;
+            if (byte == 0xf0u) {
+                second_min = 0x90u;
+            } else if (byte == 0xf4u) {
+                second_max = 0x8fu;
+            }
+        } else {
+            return false;
+        }
+        if (size - i < length) {
+            return false;
+        }
+        if (s[i + 1] < second_min || s[i + 1] > second_max) {
+            return false;
+        }
+        for (uint64_t j = 2u; j < length; ++j) {
+            if (!IsContinuation(s[i + j])) {
+                return false;
+            }
+        }
+        i += length;
+    }
+    return true;
+}
+
+} // namespace internal
+} // namespace fidl
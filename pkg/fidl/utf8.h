@@ -0,0 +1,20 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+namespace fidl {
+namespace internal {
+
+// Returns true if the |size| bytes at |data| are well-formed UTF-8.
+//
+// Overlong encodings, surrogate code points (U+D800 through U+DFFF) and code
+// points above U+10FFFF are rejected. Runs of ASCII are skipped a vector
+// register at a time where the target supports it.
+bool IsValidUtf8(const char* data, uint64_t size);
+
+} // namespace internal
+} // namespace fidl
@@ -13,6 +13,7 @@
 #include <zircon/compiler.h>
 
 #include "buffer_walker.h"
+#include "utf8.h"
 
 // TODO(kulakowski) Design zx_status_t error values.
 
@@ -23,9 +24,9 @@ class FidlValidator final : public fidl::internal::BufferWalker<FidlValidator, f
 
 public:
     FidlValidator(const fidl_type_t* type, const void* bytes, uint32_t num_bytes,
-                  uint32_t num_handles, const char** out_error_msg)
+                  uint32_t num_handles, uint32_t options, const char** out_error_msg)
         : Super(type), bytes_(static_cast<const uint8_t*>(bytes)), num_bytes_(num_bytes),
-          num_handles_(num_handles), out_error_msg_(out_error_msg) {}
+          num_handles_(num_handles), options_(options), out_error_msg_(out_error_msg) {}
 
     void Walk() {
         Super::Walk();
@@ -43,8 +44,17 @@ public:
         return true;
     }
 
+    bool ValidateStringData(const char* data, uint64_t size) const {
+        return (options_ & FIDL_CODING_CHECK_UTF8) == 0u ||
+               fidl::internal::IsValidUtf8(data, size);
+    }
+
     void UnclaimedHandle(const zx_handle_t* out_handle) {}
     void ClaimedHandle(const zx_handle_t* out_handle, uint32_t idx) {}
+    bool AllHandlesPresent(const zx_handle_t* handles, uint32_t count) const {
+        return fidl::internal::AllHandlesEqual(handles, count, FIDL_HANDLE_PRESENT);
+    }
+    void ClaimedHandles(const zx_handle_t* handles, uint32_t count, uint32_t idx) {}
 
     template <class T>
     void UpdatePointer(const T* const* p, const T* v) {}
@@ -70,6 +80,7 @@ private:
     const uint8_t* const bytes_;
     const uint32_t num_bytes_;
     const uint32_t num_handles_;
+    const uint32_t options_;
     const char** const out_error_msg_;
     zx_status_t status_ = ZX_OK;
 };
@@ -78,7 +89,17 @@ private:
 
 zx_status_t fidl_validate(const fidl_type_t* type, const void* bytes, uint32_t num_bytes,
                           uint32_t num_handles, const char** out_error_msg) {
-    FidlValidator validator(type, bytes, num_bytes, num_handles, out_error_msg);
+    return fidl_validate_etc(type, bytes, num_bytes, num_handles, 0u, out_error_msg);
+}
+
+zx_status_t fidl_validate_etc(const fidl_type_t* type, const void* bytes, uint32_t num_bytes,
+                              uint32_t num_handles, uint32_t options,
+                              const char** out_error_msg) {
+    if (bytes != nullptr && num_handles == 0u &&
+        fidl::internal::IsPointerFreeStructOfSize(type, num_bytes)) {
+        return ZX_OK;
+    }
+    FidlValidator validator(type, bytes, num_bytes, num_handles, options, out_error_msg);
     validator.Walk();
     return validator.status();
 }
@@ -4,16 +4,27 @@
 
 #include <lib/async/wait.h>
 #include <lib/fidl-async/bind.h>
+#include <lib/fidl/message_buffer_pool.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <zircon/syscalls.h>
 
 typedef struct fidl_binding {
     async_wait_t wait;
+    // One reference for the wait, or for the exclusive asynchronous
+    // transaction that took it over, plus one for each outstanding
+    // concurrent transaction. The channel is closed when the last goes away.
+    atomic_uint ref_count;
     fidl_dispatch_t* dispatch;
     async_dispatcher_t* dispatcher;
     void* ctx;
     const void* ops;
+    uint8_t* buffer;
+    uint32_t buffer_capacity;
+    uint32_t max_messages;
 } fidl_binding_t;
 
 typedef struct fidl_connection {
@@ -36,11 +47,32 @@ static zx_status_t fidl_reply(fidl_txn_t* txn, const fidl_msg_t* msg) {
                             msg->handles, msg->num_handles);
 }
 
-static void fidl_binding_destroy(fidl_binding_t* binding) {
+static void fidl_binding_release(fidl_binding_t* binding) {
+    if (atomic_fetch_sub_explicit(&binding->ref_count, 1u, memory_order_acq_rel) != 1u)
+        return;
     zx_handle_close(binding->wait.object);
     free(binding);
 }
 
+// Reads one message from |channel| into |bytes|, or into a pooled buffer
+// returned in |*out_buffer| if it does not fit.
+static zx_status_t fidl_channel_read_msg(zx_handle_t channel, uint8_t* bytes,
+                                         uint32_t capacity, fidl_msg_t* msg,
+                                         uint8_t** out_buffer) {
+    msg->bytes = bytes;
+    zx_status_t status = zx_channel_read(channel, 0, bytes, msg->handles,
+                                         capacity, ZX_CHANNEL_MAX_MSG_HANDLES,
+                                         &msg->num_bytes, &msg->num_handles);
+    if (status == ZX_ERR_BUFFER_TOO_SMALL) {
+        *out_buffer = fidl_message_buffer_pool_acquire();
+        msg->bytes = *out_buffer;
+        status = zx_channel_read(channel, 0, *out_buffer, msg->handles,
+                                 ZX_CHANNEL_MAX_MSG_BYTES, ZX_CHANNEL_MAX_MSG_HANDLES,
+                                 &msg->num_bytes, &msg->num_handles);
+    }
+    return status;
+}
+
 static void fidl_message_handler(async_dispatcher_t* dispatcher,
                                  async_wait_t* wait,
                                  zx_status_t status,
@@ -51,23 +83,38 @@ static void fidl_message_handler(async_dispatcher_t* dispatcher,
     }
 
     if (signal->observed & ZX_CHANNEL_READABLE) {
-        char bytes[ZX_CHANNEL_MAX_MSG_BYTES];
+        // Most messages fit in a small buffer on the stack, or in the buffer
+        // the binding was given. A message that does not is left in the
+        // channel and read again into a pooled buffer.
+        uint8_t inline_bytes[FIDL_MESSAGE_INLINE_READ_BYTES];
         zx_handle_t handles[ZX_CHANNEL_MAX_MSG_HANDLES];
-        for (uint64_t i = 0; i < signal->count; i++) {
+        uint8_t* bytes = inline_bytes;
+        uint32_t capacity = sizeof(inline_bytes);
+        if (binding->buffer) {
+            bytes = binding->buffer;
+            capacity = binding->buffer_capacity;
+        }
+        // Keep reading until the channel is empty or the budget runs out. The
+        // count in |signal| is only a snapshot and may be stale.
+        for (uint32_t i = 0; i < binding->max_messages; i++) {
             fidl_msg_t msg = {
                 .bytes = bytes,
                 .handles = handles,
                 .num_bytes = 0u,
                 .num_handles = 0u,
             };
-            status = zx_channel_read(wait->object, 0, bytes, handles,
-                                     ZX_CHANNEL_MAX_MSG_BYTES,
-                                     ZX_CHANNEL_MAX_MSG_HANDLES,
-                                     &msg.num_bytes, &msg.num_handles);
+            uint8_t* buffer = NULL;
+            status = fidl_channel_read_msg(wait->object, bytes, capacity, &msg, &buffer);
             if (status == ZX_ERR_SHOULD_WAIT) {
+                if (buffer) {
+                    fidl_message_buffer_pool_release(buffer);
+                }
                 break;
             }
             if (status != ZX_OK || msg.num_bytes < sizeof(fidl_message_header_t)) {
+                if (buffer) {
+                    fidl_message_buffer_pool_release(buffer);
+                }
                 goto shutdown;
             }
             fidl_message_header_t* hdr = (fidl_message_header_t*)msg.bytes;
@@ -78,27 +125,40 @@ static void fidl_message_handler(async_dispatcher_t* dispatcher,
                 .binding = binding,
             };
             status = binding->dispatch(binding->ctx, &conn.txn, &msg, binding->ops);
+            if (buffer) {
+                fidl_message_buffer_pool_release(buffer);
+            }
             switch (status) {
             case ZX_OK:
-                status = async_begin_wait(dispatcher, wait);
-                if (status != ZX_OK) {
-                    goto shutdown;
-                }
-                return;
+                continue;
             case ZX_ERR_ASYNC:
+                // The binding now belongs to the asynchronous transaction.
                 return;
             default:
                 goto shutdown;
             }
         }
+        // If the budget ran out with messages still queued, the channel is
+        // still readable and the wait fires again right away, after other
+        // waits on the dispatcher have had a turn.
+        status = async_begin_wait(dispatcher, wait);
+        if (status == ZX_OK) {
+            return;
+        }
     }
 
 shutdown:
-    fidl_binding_destroy(binding);
+    fidl_binding_release(binding);
 }
 
 zx_status_t fidl_bind(async_dispatcher_t* dispatcher, zx_handle_t channel,
                       fidl_dispatch_t* dispatch, void* ctx, const void* ops) {
+    return fidl_bind_etc(dispatcher, channel, dispatch, ctx, ops, NULL);
+}
+
+zx_status_t fidl_bind_etc(async_dispatcher_t* dispatcher, zx_handle_t channel,
+                          fidl_dispatch_t* dispatch, void* ctx, const void* ops,
+                          const fidl_bind_options_t* options) {
     fidl_binding_t* binding = calloc(1, sizeof(fidl_binding_t));
     binding->wait.handler = fidl_message_handler;
     binding->wait.object = channel;
@@ -107,23 +167,55 @@ zx_status_t fidl_bind(async_dispatcher_t* dispatcher, zx_handle_t channel,
     binding->dispatcher = dispatcher;
     binding->ctx = ctx;
     binding->ops = ops;
+    binding->max_messages = 1u;
+    atomic_init(&binding->ref_count, 1u);
+    if (options) {
+        if (options->buffer && options->buffer_capacity > 0u) {
+            binding->buffer = options->buffer;
+            binding->buffer_capacity = options->buffer_capacity;
+        }
+        if (options->max_messages > 0u) {
+            binding->max_messages = options->max_messages;
+        }
+    }
     zx_status_t status = async_begin_wait(dispatcher, &binding->wait);
     if (status != ZX_OK) {
-        fidl_binding_destroy(binding);
+        fidl_binding_release(binding);
     }
     return status;
 }
 
 typedef struct fidl_async_txn {
     fidl_connection_t connection;
+    bool concurrent;
 } fidl_async_txn_t;
 
-fidl_async_txn_t* fidl_async_txn_create(fidl_txn_t* txn) {
+static fidl_async_txn_t* fidl_async_txn_create_impl(fidl_txn_t* txn, bool concurrent) {
     fidl_connection_t* connection = (fidl_connection_t*) txn;
+    if (connection->binding == NULL) {
+        // Channels in a binding group cannot reply asynchronously.
+        return NULL;
+    }
 
     fidl_async_txn_t* async_txn = calloc(1, sizeof(fidl_async_txn_t));
     memcpy(&async_txn->connection, connection, sizeof(*connection));
+    async_txn->concurrent = concurrent;
 
+    // The reply now belongs to |async_txn|.
+    connection->txid = 0u;
+    return async_txn;
+}
+
+fidl_async_txn_t* fidl_async_txn_create(fidl_txn_t* txn) {
+    return fidl_async_txn_create_impl(txn, false);
+}
+
+fidl_async_txn_t* fidl_async_txn_create_concurrent(fidl_txn_t* txn) {
+    fidl_async_txn_t* async_txn = fidl_async_txn_create_impl(txn, true);
+    if (async_txn == NULL)
+        return NULL;
+    atomic_fetch_add_explicit(&async_txn->connection.binding->ref_count, 1u,
+                              memory_order_relaxed);
     return async_txn;
 }
 
@@ -132,16 +224,184 @@ fidl_txn_t* fidl_async_txn_borrow(fidl_async_txn_t* async_txn) {
 }
 
 zx_status_t fidl_async_txn_complete(fidl_async_txn_t* async_txn, bool rebind) {
+    fidl_binding_t* binding = async_txn->connection.binding;
+    bool concurrent = async_txn->concurrent;
+    free(async_txn);
+
     zx_status_t status = ZX_OK;
-    if (rebind) {
-        status = async_begin_wait(async_txn->connection.binding->dispatcher,
-                                  &async_txn->connection.binding->wait);
+    if (rebind && !concurrent) {
+        status = async_begin_wait(binding->dispatcher, &binding->wait);
         if (status == ZX_OK) {
             return ZX_OK;
         }
     }
 
-    fidl_binding_destroy(async_txn->connection.binding);
-    free(async_txn);
+    fidl_binding_release(binding);
     return status;
 }
+
+typedef struct fidl_binding_group_entry {
+    async_wait_t wait;
+    void* ctx;
+    // The position of this entry in the group's slab.
+    uint32_t index;
+    // The next entry in the free list, if this entry is free.
+    uint32_t next_free;
+} fidl_binding_group_entry_t;
+
+#define FIDL_BINDING_GROUP_NO_ENTRY UINT32_MAX
+
+struct fidl_binding_group {
+    async_dispatcher_t* dispatcher;
+    fidl_dispatch_t* dispatch;
+    const void* ops;
+    mtx_t lock; // guards the free list and the count
+    uint32_t free_head;
+    uint32_t count;
+    uint32_t capacity;
+    fidl_binding_group_entry_t entries[];
+};
+
+static fidl_binding_group_t* fidl_binding_group_from_entry(fidl_binding_group_entry_t* entry) {
+    return (fidl_binding_group_t*)((uint8_t*)(entry - entry->index) -
+                                   offsetof(fidl_binding_group_t, entries));
+}
+
+// Closes the channel of |entry| and returns the entry to the free list.
+static void fidl_binding_group_release_entry(fidl_binding_group_t* group,
+                                             fidl_binding_group_entry_t* entry) {
+    zx_handle_close(entry->wait.object);
+    entry->wait.object = ZX_HANDLE_INVALID;
+    entry->ctx = NULL;
+    mtx_lock(&group->lock);
+    entry->next_free = group->free_head;
+    group->free_head = entry->index;
+    group->count--;
+    mtx_unlock(&group->lock);
+}
+
+static void fidl_binding_group_handler(async_dispatcher_t* dispatcher,
+                                       async_wait_t* wait,
+                                       zx_status_t status,
+                                       const zx_packet_signal_t* signal) {
+    fidl_binding_group_entry_t* entry = (fidl_binding_group_entry_t*)wait;
+    fidl_binding_group_t* group = fidl_binding_group_from_entry(entry);
+    if (status == ZX_OK && (signal->observed & ZX_CHANNEL_READABLE)) {
+        uint8_t inline_bytes[FIDL_MESSAGE_INLINE_READ_BYTES];
+        zx_handle_t handles[ZX_CHANNEL_MAX_MSG_HANDLES];
+        fidl_msg_t msg = {
+            .bytes = inline_bytes,
+            .handles = handles,
+            .num_bytes = 0u,
+            .num_handles = 0u,
+        };
+        uint8_t* buffer = NULL;
+        status = fidl_channel_read_msg(wait->object, inline_bytes, sizeof(inline_bytes),
+                                       &msg, &buffer);
+        if (status == ZX_OK && msg.num_bytes >= sizeof(fidl_message_header_t)) {
+            fidl_message_header_t* hdr = (fidl_message_header_t*)msg.bytes;
+            fidl_connection_t conn = {
+                .txn.reply = fidl_reply,
+                .channel = wait->object,
+                .txid = hdr->txid,
+                .binding = NULL,
+            };
+            status = group->dispatch(entry->ctx, &conn.txn, &msg, group->ops);
+        } else if (status == ZX_OK) {
+            status = ZX_ERR_INVALID_ARGS;
+        }
+        if (buffer) {
+            fidl_message_buffer_pool_release(buffer);
+        }
+        if (status == ZX_OK || status == ZX_ERR_SHOULD_WAIT) {
+            status = async_begin_wait(dispatcher, wait);
+            if (status == ZX_OK) {
+                return;
+            }
+        }
+    }
+    fidl_binding_group_release_entry(group, entry);
+}
+
+zx_status_t fidl_binding_group_create(async_dispatcher_t* dispatcher,
+                                      fidl_dispatch_t* dispatch, const void* ops,
+                                      uint32_t capacity, fidl_binding_group_t** out_group) {
+    if (capacity == 0u || capacity == FIDL_BINDING_GROUP_NO_ENTRY)
+        return ZX_ERR_INVALID_ARGS;
+    fidl_binding_group_t* group = calloc(1, sizeof(fidl_binding_group_t) +
+                                                capacity * sizeof(fidl_binding_group_entry_t));
+    if (group == NULL)
+        return ZX_ERR_NO_MEMORY;
+    group->dispatcher = dispatcher;
+    group->dispatch = dispatch;
+    group->ops = ops;
+    mtx_init(&group->lock, mtx_plain);
+    group->capacity = capacity;
+    for (uint32_t i = 0; i < capacity; i++) {
+        fidl_binding_group_entry_t* entry = &group->entries[i];
+        entry->wait.handler = fidl_binding_group_handler;
+        entry->wait.object = ZX_HANDLE_INVALID;
+        entry->wait.trigger = ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED;
+        entry->index = i;
+        entry->next_free = i + 1 < capacity ? i + 1 : FIDL_BINDING_GROUP_NO_ENTRY;
+    }
+    group->free_head = 0u;
+    *out_group = group;
+    return ZX_OK;
+}
+
+zx_status_t fidl_binding_group_add(fidl_binding_group_t* group, zx_handle_t channel,
+                                   void* ctx, uint32_t* out_index) {
+    mtx_lock(&group->lock);
+    uint32_t index = group->free_head;
+    if (index == FIDL_BINDING_GROUP_NO_ENTRY) {
+        mtx_unlock(&group->lock);
+        zx_handle_close(channel);
+        return ZX_ERR_NO_RESOURCES;
+    }
+    fidl_binding_group_entry_t* entry = &group->entries[index];
+    group->free_head = entry->next_free;
+    group->count++;
+    mtx_unlock(&group->lock);
+
+    entry->wait.object = channel;
+    entry->ctx = ctx;
+    zx_status_t status = async_begin_wait(group->dispatcher, &entry->wait);
+    if (status != ZX_OK) {
+        fidl_binding_group_release_entry(group, entry);
+        return status;
+    }
+    if (out_index)
+        *out_index = index;
+    return ZX_OK;
+}
+
+zx_status_t fidl_binding_group_remove(fidl_binding_group_t* group, uint32_t index) {
+    if (index >= group->capacity || group->entries[index].wait.object == ZX_HANDLE_INVALID)
+        return ZX_ERR_NOT_FOUND;
+    fidl_binding_group_entry_t* entry = &group->entries[index];
+    zx_status_t status = async_cancel_wait(group->dispatcher, &entry->wait);
+    if (status != ZX_OK)
+        return status;
+    fidl_binding_group_release_entry(group, entry);
+    return ZX_OK;
+}
+
+uint32_t fidl_binding_group_count(fidl_binding_group_t* group) {
+    mtx_lock(&group->lock);
+    uint32_t count = group->count;
+    mtx_unlock(&group->lock);
+    return count;
+}
+
+void fidl_binding_group_destroy(fidl_binding_group_t* group) {
+    for (uint32_t i = 0; i < group->capacity; i++) {
+        fidl_binding_group_entry_t* entry = &group->entries[i];
+        if (entry->wait.object == ZX_HANDLE_INVALID)
+            continue;
+        async_cancel_wait(group->dispatcher, &entry->wait);
+        zx_handle_close(entry->wait.object);
+    }
+    mtx_destroy(&group->lock);
+    free(group);
+}
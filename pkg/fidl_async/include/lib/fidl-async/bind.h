@@ -44,7 +44,12 @@ typedef zx_status_t(fidl_dispatch_t)(void* ctx, fidl_txn_t* txn,
 // object must be called synchronously within the |dispatch| call.
 //
 // If a client wishes to reply to the message asynchronously, |fidl_async_txn_create|
-// must be invoked on |fidl_txn_t|, and ZX_ERR_ASYNC must be returned.
+// must be invoked on |fidl_txn_t|, and ZX_ERR_ASYNC must be returned. No
+// further messages are dispatched until the transaction is completed.
+//
+// To keep dispatching messages while the reply is pending, for example to
+// have I/O outstanding for many requests on one channel, invoke
+// |fidl_async_txn_create_concurrent| instead and return ZX_OK.
 //
 // Returns whether |fidl_bind| was able to begin waiting on the given |channel|.
 // Upon any error, |channel| is closed and the binding is terminated. Shutting down
@@ -58,6 +63,36 @@ typedef zx_status_t(fidl_dispatch_t)(void* ctx, fidl_txn_t* txn,
 zx_status_t fidl_bind(async_dispatcher_t* dispatcher, zx_handle_t channel,
                       fidl_dispatch_t* dispatch, void* ctx, const void* ops);
 
+// Options for |fidl_bind_etc|.
+//
+// A zero-initialized |fidl_bind_options_t| gives the behavior of |fidl_bind|.
+typedef struct fidl_bind_options {
+    // If not NULL, messages are read into these |buffer_capacity| bytes
+    // instead of into a small buffer on the stack. A message that does not fit
+    // is read into a buffer from the calling thread's message buffer pool.
+    //
+    // Drivers on small stacks can give each binding its own buffer, sized for
+    // the largest message they expect. The buffer must outlive the binding,
+    // and the |fidl_msg_t| passed to |dispatch| points into it, so a
+    // dispatcher with several threads must not complete an asynchronous
+    // transaction while the dispatch function is still reading the message.
+    uint8_t* buffer;
+    uint32_t buffer_capacity;
+
+    // The most messages dispatched each time the channel becomes readable,
+    // before the binding waits again. Reading stops early when the channel is
+    // empty. Zero means one, which gives other waits on the dispatcher a turn
+    // between every message.
+    uint32_t max_messages;
+} fidl_bind_options_t;
+
+// Like |fidl_bind|, but configured by |options|, which may be NULL.
+//
+// |options| is copied and need not outlive the call.
+zx_status_t fidl_bind_etc(async_dispatcher_t* dispatcher, zx_handle_t channel,
+                          fidl_dispatch_t* dispatch, void* ctx, const void* ops,
+                          const fidl_bind_options_t* options);
+
 // An asynchronous FIDL txn.
 //
 // This is an opaque wrapper around |fidl_txn_t| which can extend the lifetime
@@ -70,9 +105,23 @@ typedef struct fidl_async_txn fidl_async_txn_t;
 // If this function is invoked within a dispatched function, that function
 // must return ZX_ERR_ASYNC.
 //
+// Returns NULL if |txn| belongs to a channel in a |fidl_binding_group_t|.
+//
 // The result must be destroyed with a call to |fidl_async_txn_complete|.
 fidl_async_txn_t* fidl_async_txn_create(fidl_txn_t* txn);
 
+// Like |fidl_async_txn_create|, but the binding keeps dispatching messages
+// while the transaction is outstanding.
+//
+// The dispatch function that invokes this must return ZX_OK. Any number of
+// concurrent transactions can be outstanding on one binding, and they can be
+// completed in any order and on any thread. If the binding shuts down, the
+// channel stays open until the last of them is completed; replies sent after
+// the peer has closed its end fail with ZX_ERR_PEER_CLOSED.
+//
+// The result must be destroyed with a call to |fidl_async_txn_complete|.
+fidl_async_txn_t* fidl_async_txn_create_concurrent(fidl_txn_t* txn);
+
 // Acquire a reference to the |fidl_txn_t| backing this txn object.
 //
 // It is unsafe to use this |fidl_txn_t| after |async_txn| is completed.
@@ -84,9 +133,62 @@ fidl_txn_t* fidl_async_txn_borrow(fidl_async_txn_t* async_txn);
 // Returns an error if |rebind| is true and the transaction could not be
 // re-bound.
 //
+// For transactions created with |fidl_async_txn_create_concurrent|, the
+// binding was never paused, so |rebind| is ignored and ZX_OK is returned.
+//
 // In all cases, the |async_txn| object is consumed.
 zx_status_t fidl_async_txn_complete(fidl_async_txn_t* async_txn, bool rebind);
 
+// A group of channels served by the same |dispatch| function and |ops| table.
+//
+// Binding each channel with |fidl_bind| allocates a binding per channel. A
+// binding group instead holds the waits for up to a fixed number of channels
+// in one allocation, made when the group is created, and identifies each
+// channel by its index in the group. Servers with thousands of channels, such
+// as service directories and device hosts, use less memory and allocate less.
+//
+// Each message is dispatched with the |ctx| the channel was added with and
+// must be replied to synchronously: asynchronous transactions are not
+// supported on channels in a group, and a |dispatch| function that returns
+// ZX_ERR_ASYNC closes the channel. As with |fidl_bind|, a channel is closed
+// when |dispatch| returns an error, when its peer closes, and when the
+// dispatcher shuts down, at which point its slot becomes free again.
+typedef struct fidl_binding_group fidl_binding_group_t;
+
+// Creates a group that can hold up to |capacity| channels at once, waiting on
+// them with |dispatcher|.
+//
+// Returns ZX_ERR_INVALID_ARGS if |capacity| is zero or UINT32_MAX, and
+// ZX_ERR_NO_MEMORY if the group could not be allocated.
+zx_status_t fidl_binding_group_create(async_dispatcher_t* dispatcher,
+                                      fidl_dispatch_t* dispatch, const void* ops,
+                                      uint32_t capacity, fidl_binding_group_t** out_group);
+
+// Adds |channel| to |group|, dispatching its messages with |ctx|, and returns
+// its index in |out_index|, which may be NULL.
+//
+// Returns ZX_ERR_NO_RESOURCES if the group is full. Upon any error, |channel|
+// is closed.
+zx_status_t fidl_binding_group_add(fidl_binding_group_t* group, zx_handle_t channel,
+                                   void* ctx, uint32_t* out_index);
+
+// Removes the channel at |index| from |group| and closes it.
+//
+// Returns ZX_ERR_NOT_FOUND if there is no channel at |index|, and the errors
+// of |async_cancel_wait|, for example if a message for the channel is being
+// dispatched on another thread.
+zx_status_t fidl_binding_group_remove(fidl_binding_group_t* group, uint32_t index);
+
+// Returns the number of channels in |group|.
+uint32_t fidl_binding_group_count(fidl_binding_group_t* group);
+
+// Closes every channel in |group| and destroys it.
+//
+// Must not be called while a message is being dispatched for the group, for
+// example from a dispatch function, or from another thread of a dispatcher
+// with several threads.
+void fidl_binding_group_destroy(fidl_binding_group_t* group);
+
 __END_CDECLS
 
 #endif // LIB_FIDL_BIND_H_
@@ -212,7 +212,8 @@ class Binding {
   // For example, the error handler will be called if the remote side of the
   // channel sends an invalid message. When the error handler is called, the
   // |Binding| will no longer be bound to the channel.
-  void set_error_handler(fit::function<void(zx_status_t)> error_handler) {
+  void set_error_handler(
+      fit::callback_function<void(zx_status_t)> error_handler) {
     controller_.reader().set_error_handler(std::move(error_handler));
   }
 
@@ -222,6 +223,50 @@ class Binding {
   // The interface for sending events back to the client.
   typename Interface::EventSender_& events() { return stub_; }
 
+  // Queues the events sent through |events()|, and the replies sent in the
+  // meantime, until the matching |EndBatch|, which writes them to the channel
+  // back-to-back in the order they were sent.
+  //
+  // Use around code that emits a burst of events so the client is woken once
+  // for the burst rather than once per event. Batches nest.
+  //
+  // See |internal::StubController::BeginBatch|.
+  void BeginBatch() { controller_.BeginBatch(); }
+
+  // Ends a batch started with |BeginBatch|.
+  //
+  // Returns an error if the queued events could not be written to the channel.
+  zx_status_t EndBatch() { return controller_.EndBatch(); }
+
+  // Dispatches messages to the implementation on |dispatcher|, which may be
+  // serviced by several threads, rather than on the dispatcher the channel is
+  // bound to.
+  //
+  // Opt in only for implementations that are safe to call concurrently and do
+  // not depend on the order of calls on the channel. The binding must still be
+  // bound, unbound, and destroyed on the dispatcher the channel is bound to.
+  //
+  // See |internal::StubController::set_concurrent_dispatcher|.
+  void set_concurrent_dispatcher(async_dispatcher_t* dispatcher) {
+    controller_.set_concurrent_dispatcher(dispatcher);
+  }
+
+  // Records statistics about the messages this |Binding| reads and dispatches
+  // into |stats|, which must outlive the binding or be cleared with nullptr.
+  //
+  // See |DispatchStats|.
+  void set_dispatch_stats(DispatchStats* stats) {
+    controller_.reader().set_dispatch_stats(stats);
+  }
+
+  // Records the messages this |Binding| reads into |capture|, which must
+  // outlive the binding or be cleared with nullptr.
+  //
+  // See |MessageCapture|.
+  void set_message_capture(MessageCapture* capture) {
+    controller_.reader().set_message_capture(capture);
+  }
+
   // Whether this |Binding| is currently listening to a channel.
   bool is_bound() const { return controller_.reader().is_bound(); }
 
@@ -229,6 +274,11 @@ class Binding {
   const zx::channel& channel() const { return controller_.reader().channel(); }
 
  private:
+  template <typename I, typename P>
+  friend class BindingSet;
+  template <typename I, typename P>
+  friend class CompactBindingSet;
+
   const ImplPtr impl_;
   typename Interface::Stub_ stub_;
   internal::StubController controller_;
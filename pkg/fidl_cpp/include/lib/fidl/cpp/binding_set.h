@@ -5,7 +5,8 @@
 #ifndef LIB_FIDL_CPP_BINDING_SET_H_
 #define LIB_FIDL_CPP_BINDING_SET_H_
 
-#include <algorithm>
+#include <iterator>
+#include <list>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -22,6 +23,10 @@ namespace fidl {
 // allowing the use of smart pointer types such as |std::unique_ptr<>| to
 // reference the implementation.
 //
+// Each binding is constructed in place in a node of the set's storage, so adding
+// one costs a single allocation. Bindings never move, and removing one takes
+// constant time regardless of the size of the set.
+//
 // See also:
 //
 //  * |InterfacePtrSet|, which is the client analog of |BindingSet|.
@@ -29,12 +34,16 @@ template <typename Interface, typename ImplPtr = Interface*>
 class BindingSet {
  public:
   using Binding = ::fidl::Binding<Interface, ImplPtr>;
-  using StorageType = std::vector<std::unique_ptr<Binding>>;
+  // This used to be |std::vector<std::unique_ptr<Binding>>|. Its elements are
+  // now the bindings themselves; see |bindings()|.
+  using StorageType = std::list<Binding>;
 
   using iterator = typename StorageType::iterator;
 
   BindingSet() = default;
 
+  ~BindingSet() { CloseAll(); }
+
   BindingSet(const BindingSet&) = delete;
   BindingSet& operator=(const BindingSet&) = delete;
 
@@ -52,14 +61,13 @@ class BindingSet {
   // |~unique_ptr|, which deletes |impl|.
   void AddBinding(ImplPtr impl, InterfaceRequest<Interface> request,
                   async_dispatcher_t* dispatcher = nullptr) {
-    bindings_.push_back(std::make_unique<Binding>(
-        std::forward<ImplPtr>(impl), std::move(request), dispatcher));
-    auto* binding = bindings_.back().get();
+    bindings_.emplace_back(std::forward<ImplPtr>(impl), std::move(request),
+                           dispatcher);
+    iterator it = std::prev(bindings_.end());
     // Set the connection error handler for the newly added Binding to be a
-    // function that will erase it from the vector.
-    binding->set_error_handler([binding, this](zx_status_t status) {
-      this->RemoveOnError(binding);
-    });
+    // function that will erase it from the list.
+    it->set_error_handler(
+        [it, this](zx_status_t status) { this->RemoveOnError(it); });
   }
 
   // Adds a binding to the set for the given implementation.
@@ -107,6 +115,16 @@ class BindingSet {
   void CloseAll() {
     auto bindings_local = std::move(bindings_);
     bindings_.clear();
+    CloseMany(&bindings_local, false, ZX_OK);
+  }
+
+  // Sends an Epitaph with |epitaph_value| over each of the channels
+  // associated with this |BindingSet|, then removes all the bindings from the
+  // set as |CloseAll()| does.
+  void CloseAll(zx_status_t epitaph_value) {
+    auto bindings_local = std::move(bindings_);
+    bindings_.clear();
+    CloseMany(&bindings_local, true, epitaph_value);
   }
 
   // The number of bindings in this |BindingSet|.
@@ -124,29 +142,42 @@ class BindingSet {
   // This collection of bindings can be invalidated when a |Binding| in the
   // set encounters a connection error because connection errors causes the
   // |BindingSet| to remove the |Binding| from the set.
+  //
+  // API change: the elements are |Binding| objects, no longer
+  // |std::unique_ptr<Binding>|, so callers that iterated with
+  // |binding->| or |binding.get()| now use |binding.| and |&binding|, and the
+  // collection can no longer be indexed.
   const StorageType& bindings() const { return bindings_; }
 
  private:
   // Called when a binding has an error to remove the binding from the set.
-  void RemoveOnError(Binding* binding) {
-    auto it = std::find_if(bindings_.begin(), bindings_.end(),
-                           [binding](const std::unique_ptr<Binding>& b) {
-                             return b.get() == binding;
-                           });
-    ZX_DEBUG_ASSERT(it != bindings_.end());
-
+  void RemoveOnError(iterator it) {
     {
-      // Move ownership of binding out of storage, such that the binding is
+      // Move the binding's node out of storage, such that the binding is
       // destroyed AFTER it is removed from the bindings.
-      auto binding_local = std::move(*it);
-      binding_local->set_error_handler(nullptr);
-      bindings_.erase(it);
+      StorageType binding_local;
+      binding_local.splice(binding_local.begin(), bindings_, it);
+      it->set_error_handler(nullptr);
     }
 
     if (bindings_.empty() && empty_set_handler_)
       empty_set_handler_();
   }
 
+  // Closes the channels of |bindings| in bulk. See
+  // |internal::MessageReader::CloseMany|.
+  static void CloseMany(StorageType* bindings, bool send_epitaph,
+                        zx_status_t epitaph_value) {
+    if (bindings->empty())
+      return;
+    std::vector<internal::MessageReader*> readers;
+    readers.reserve(bindings->size());
+    for (Binding& binding : *bindings)
+      readers.push_back(&binding.controller_.reader());
+    internal::MessageReader::CloseMany(readers.data(), readers.size(),
+                                       send_epitaph, epitaph_value);
+  }
+
   StorageType bindings_;
   fit::closure empty_set_handler_;
 };
@@ -0,0 +1,133 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_DISPATCH_STATS_H_
+#define LIB_FIDL_CPP_DISPATCH_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace fidl {
+
+// A histogram of non-negative values, bucketed by powers of two.
+//
+// Bucket zero counts the value zero, and bucket |i| counts the values in
+// [2^(i-1), 2^i). The last bucket also counts everything larger.
+class DispatchHistogram {
+ public:
+  static constexpr size_t kBucketCount = 40u;
+
+  void Record(uint64_t value) {
+    size_t bucket = 0u;
+    if (value)
+      bucket = std::min<size_t>(64u - __builtin_clzll(value), kBucketCount - 1);
+    ++buckets_[bucket];
+    ++count_;
+    total_ += value;
+    max_ = std::max(max_, value);
+  }
+
+  // The number of values recorded in |bucket|.
+  uint64_t bucket(size_t bucket) const { return buckets_[bucket]; }
+
+  // The number of values recorded.
+  uint64_t count() const { return count_; }
+
+  // The sum of the values recorded.
+  uint64_t total() const { return total_; }
+
+  // The largest value recorded.
+  uint64_t max() const { return max_; }
+
+ private:
+  uint64_t buckets_[kBucketCount] = {};
+  uint64_t count_ = 0u;
+  uint64_t total_ = 0u;
+  uint64_t max_ = 0u;
+};
+
+// Statistics about the messages a |MessageReader| reads and dispatches.
+//
+// Attach a |DispatchStats| to a |Binding| or an |InterfacePtr| with
+// |set_dispatch_stats| to find out how deep the channel's queue is when the
+// reader wakes up, and how long each ordinal takes to read and to dispatch.
+// Dispatching includes decoding the message and running the handler. Times
+// are recorded in nanoseconds.
+//
+// A |DispatchStats| is not thread-safe. It must be read on the thread that
+// services the dispatcher the reader is bound to, for example from a task that
+// exports the histograms to inspect or as trace counters. Several readers can
+// share one |DispatchStats| if they are bound to the same single-threaded
+// dispatcher.
+class DispatchStats {
+ public:
+  // The statistics for one ordinal.
+  struct OrdinalStats {
+    uint32_t ordinal;
+    DispatchHistogram read_time;
+    DispatchHistogram dispatch_time;
+  };
+
+  // The number of messages waiting in the channel each time the reader woke
+  // up, as reported by the dispatcher.
+  const DispatchHistogram& queue_depth() const { return queue_depth_; }
+
+  // The statistics for every ordinal seen, sorted by ordinal.
+  const std::vector<OrdinalStats>& ordinals() const { return ordinals_; }
+
+  // The statistics for |ordinal|, or nullptr if it has not been seen.
+  const OrdinalStats* Find(uint32_t ordinal) const {
+    auto it = LowerBound(ordinal);
+    if (it == ordinals_.end() || it->ordinal != ordinal)
+      return nullptr;
+    return &*it;
+  }
+
+  void RecordWakeup(uint64_t queue_depth) { queue_depth_.Record(queue_depth); }
+
+  void RecordMessage(uint32_t ordinal, uint64_t read_time,
+                     uint64_t dispatch_time) {
+    // Most protocols have a handful of ordinals, and a reader usually sees the
+    // same ones over and over, so a sorted vector is cheaper than a map.
+    auto it = LowerBound(ordinal);
+    if (it == ordinals_.end() || it->ordinal != ordinal) {
+      it = ordinals_.insert(it, OrdinalStats());
+      it->ordinal = ordinal;
+    }
+    it->read_time.Record(read_time);
+    it->dispatch_time.Record(dispatch_time);
+  }
+
+  // Forgets everything recorded so far.
+  void Reset() {
+    queue_depth_ = DispatchHistogram();
+    ordinals_.clear();
+  }
+
+ private:
+  std::vector<OrdinalStats>::const_iterator LowerBound(uint32_t ordinal) const {
+    return std::lower_bound(
+        ordinals_.begin(), ordinals_.end(), ordinal,
+        [](const OrdinalStats& stats, uint32_t ordinal) {
+          return stats.ordinal < ordinal;
+        });
+  }
+  std::vector<OrdinalStats>::iterator LowerBound(uint32_t ordinal) {
+    return std::lower_bound(
+        ordinals_.begin(), ordinals_.end(), ordinal,
+        [](const OrdinalStats& stats, uint32_t ordinal) {
+          return stats.ordinal < ordinal;
+        });
+  }
+
+  DispatchHistogram queue_depth_;
+  std::vector<OrdinalStats> ordinals_;
+};
+
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_DISPATCH_STATS_H_
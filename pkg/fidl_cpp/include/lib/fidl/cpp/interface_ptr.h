@@ -177,6 +177,33 @@ class InterfacePtr {
     return InterfaceHandle<Interface>(impl_->controller.reader().Unbind());
   }
 
+  // Limits the number of calls awaiting a response to |max_in_flight_calls|,
+  // queuing later calls until responses arrive, and waits for the channel to
+  // become writable instead of failing when it is full.
+  //
+  // Zero, the default, writes every call immediately. See
+  // |internal::ProxyController::set_max_in_flight_calls|.
+  void set_max_in_flight_calls(uint32_t max_in_flight_calls) {
+    impl_->controller.set_max_in_flight_calls(max_in_flight_calls);
+  }
+
+  // Records statistics about the responses and events this |InterfacePtr|
+  // reads and dispatches into |stats|, which must outlive the |InterfacePtr| or
+  // be cleared with nullptr.
+  //
+  // See |DispatchStats|.
+  void set_dispatch_stats(DispatchStats* stats) {
+    impl_->controller.reader().set_dispatch_stats(stats);
+  }
+
+  // Records the messages this |InterfacePtr| writes and reads into |capture|,
+  // which must outlive the |InterfacePtr| or be cleared with nullptr.
+  //
+  // See |MessageCapture|.
+  void set_message_capture(MessageCapture* capture) {
+    impl_->controller.reader().set_message_capture(capture);
+  }
+
   // Whether this |InterfacePtr| is currently bound to a channel.
   //
   // If the |InterfacePtr| is bound to a channel, the |InterfacePtr| has
@@ -270,7 +297,8 @@ class InterfacePtr {
   // For example, the error handler will be called if the remote side of the
   // channel sends an invalid message. When the error handler is called, the
   // |Binding| will no longer be bound to the channel.
-  void set_error_handler(fit::function<void(zx_status_t)> error_handler) {
+  void set_error_handler(
+      fit::callback_function<void(zx_status_t)> error_handler) {
     impl_->controller.reader().set_error_handler(std::move(error_handler));
   }
 
@@ -288,6 +316,9 @@ class InterfacePtr {
   }
 
  private:
+  template <typename I>
+  friend class InterfacePtrSet;
+
   struct Impl;
 
   std::unique_ptr<Impl> impl_;
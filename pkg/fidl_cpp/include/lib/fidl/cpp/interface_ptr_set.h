@@ -5,10 +5,13 @@
 #ifndef LIB_FIDL_CPP_INTERFACE_PTR_SET_H_
 #define LIB_FIDL_CPP_INTERFACE_PTR_SET_H_
 
+#include <lib/fidl/cpp/message.h>
 #include <zircon/assert.h>
 #include <vector>
 
 #include "lib/fidl/cpp/interface_ptr.h"
+#include "lib/fidl/cpp/internal/logging.h"
+#include "lib/fidl/cpp/send_validation.h"
 
 namespace fidl {
 
@@ -33,6 +36,8 @@ class InterfacePtrSet {
   // Creates an empty |InterfacePtrSet|.
   InterfacePtrSet() = default;
 
+  ~InterfacePtrSet() { CloseAll(); }
+
   InterfacePtrSet(const InterfacePtrSet& other) = delete;
   InterfacePtrSet& operator=(const InterfacePtrSet& other) = delete;
 
@@ -59,10 +64,50 @@ class InterfacePtrSet {
   // |InterfacePtrSet| to remove the |InterfacePtr| from the set.
   const StorageType& ptrs() const { return ptrs_; }
 
+  // Writes |message| to the channel of every |InterfacePtr| in the set.
+  //
+  // |message| must be an encoded one-way message of the given |type| without
+  // handles, built with an |Encoder| the way the generated proxies build their
+  // messages. The message is validated once and the same bytes are written to
+  // every channel, which is much cheaper than calling the method on each
+  // |InterfacePtr| when the set is large. Messages with handles cannot be
+  // shared between channels; send those through each |InterfacePtr|.
+  //
+  // Returns an error without writing anything if |message| expects a
+  // response, carries handles, or fails validation. Failures to write to
+  // individual channels are reported through their error handlers, as they
+  // are for calls made through the |InterfacePtr|.
+  zx_status_t Broadcast(const fidl_type_t* type, Message message) {
+    if (!message.has_header() || message.txid() != 0u ||
+        message.handles().actual() != 0u)
+      return ZX_ERR_INVALID_ARGS;
+    if (internal::ShouldValidateSend()) {
+      const char* error_msg = nullptr;
+      zx_status_t status = message.Validate(type, &error_msg);
+      if (status != ZX_OK) {
+        FIDL_REPORT_ENCODING_ERROR(message, type, error_msg);
+        return status;
+      }
+    }
+    const BytePart& bytes = message.bytes();
+    for (const auto& ptr : ptrs_) {
+      ptr->impl_->controller.SendValidated(
+          type, Message(BytePart(bytes.data(), bytes.actual(), bytes.actual()),
+                        HandlePart()));
+    }
+    return ZX_OK;
+  }
+
   // Closes all channels associated with |InterfacePtr| objects in the set.
   //
+  // The channels are closed in bulk rather than one |InterfacePtr| at a time.
   // After this method returns, the set is empty.
-  void CloseAll() { ptrs_.clear(); }
+  void CloseAll() { CloseMany(false, ZX_OK); }
+
+  // Sends an Epitaph with |epitaph_value| over each of the channels
+  // associated with |InterfacePtr| objects in the set, then closes them as
+  // |CloseAll()| does.
+  void CloseAll(zx_status_t epitaph_value) { CloseMany(true, epitaph_value); }
 
   // The number of |InterfacePtr| objects in the set.
   //
@@ -84,6 +129,21 @@ class InterfacePtrSet {
     ptrs_.erase(it);
   }
 
+  // Empties the set, closing the channels of its |InterfacePtr| objects in
+  // bulk. See |internal::MessageReader::CloseMany|.
+  void CloseMany(bool send_epitaph, zx_status_t epitaph_value) {
+    StorageType ptrs_local = std::move(ptrs_);
+    ptrs_.clear();
+    if (ptrs_local.empty())
+      return;
+    std::vector<internal::MessageReader*> readers;
+    readers.reserve(ptrs_local.size());
+    for (const auto& ptr : ptrs_local)
+      readers.push_back(&ptr->impl_->controller.reader());
+    internal::MessageReader::CloseMany(readers.data(), readers.size(),
+                                       send_epitaph, epitaph_value);
+  }
+
   // We use |unique_ptr| rather than just |InterfacePtr| so that we can keep
   // track of the |InterfacePtr| objects after the |vector| resizes and moves
   // its contents to its new buffer.
@@ -6,11 +6,15 @@
 #define LIB_FIDL_CPP_INTERNAL_MESSAGE_READER_H_
 
 #include <lib/async/wait.h>
+#include <lib/fidl/cpp/dispatch_stats.h>
+#include <lib/fidl/cpp/message_capture.h>
 #include <lib/fidl/cpp/message.h>
 #include <lib/fidl/cpp/message_buffer.h>
 #include <lib/fit/function.h>
 #include <lib/zx/channel.h>
+#include <lib/zx/time.h>
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <utility>
@@ -69,6 +73,28 @@ class MessageReader {
   // The return value can be any of the return values of zx_channel_write.
   zx_status_t Close(zx_status_t epitaph_value);
 
+  // Unbinds each of the |count| |readers| and closes their channels, first
+  // sending an epitaph with |epitaph_value| if |send_epitaph| is true.
+  //
+  // Does what |Close| or destroying each reader would, but cancels their waits
+  // in batches with |async_cancel_waits| and closes their channels with
+  // |zx_handle_close_many|, so tearing down many connections takes a few
+  // dispatcher locks and system calls rather than several per connection.
+  // Readers that are not bound are skipped. The error handlers are not
+  // called.
+  static void CloseMany(MessageReader* const* readers, size_t count,
+                        bool send_epitaph, zx_status_t epitaph_value);
+
+  // Unbinds and calls the error handler with |status| from the dispatcher the
+  // |MessageReader| is bound to, as if reading or dispatching a message had
+  // failed with |status|.
+  //
+  // Unlike the other methods, this method may be called from any thread, as
+  // long as the |MessageReader| cannot be unbound or destroyed concurrently
+  // with the call. Used to report errors from messages dispatched on other
+  // threads. Only the first error reported before the reader unbinds is kept.
+  void DeferError(zx_status_t status);
+
   // Whether the |MessageReader| is currently bound.
   //
   // See |Bind()| and |Unbind()|.
@@ -77,6 +103,9 @@ class MessageReader {
   // The channel to which this |MessageReader| is bound, if any.
   const zx::channel& channel() const { return channel_; }
 
+  // The dispatcher on which this |MessageReader| waits for messages, if bound.
+  async_dispatcher_t* dispatcher() const { return dispatcher_; }
+
   // Synchronously waits on |channel()| until either a message is available or
   // the peer closes. If the channel is readable, reads a single message from
   // the channel and dispatches it to the message handler.
@@ -120,25 +149,109 @@ class MessageReader {
   // |Binding| will no longer be bound to the channel.
   //
   // The handler can destroy the |MessageReader|.
-  void set_error_handler(fit::function<void(zx_status_t)> error_handler) {
-    error_handler_ = std::move(error_handler);
+  //
+  // The handler is stored out of line, allocated the first time one is set,
+  // so readers without one stay small. Replaces the error callback.
+  void set_error_handler(
+      fit::callback_function<void(zx_status_t)> error_handler);
+
+  // Called with |context| and the error whenever the |MessageReader|
+  // encounters an error on the channel.
+  using ErrorCallback = void (*)(void* context, zx_status_t status);
+
+  // Sets a callback to call in place of an error handler, which costs
+  // nothing beyond the two pointers every reader has.
+  //
+  // Meant for owners of many readers that handle their errors alike, such as
+  // |CompactBindingSet|, which share one handler and pass each reader's own
+  // |context|. The callback can destroy the |MessageReader|. Replaces the
+  // error handler.
+  void set_error_callback(ErrorCallback callback, void* context);
+
+  // Bounds how much work the |MessageReader| does each time the dispatcher
+  // reports that the channel is readable.
+  //
+  // By default, the |MessageReader| reads as many messages as the wakeup
+  // reported, which is usually one, and then waits again. With a budget, it
+  // keeps reading until the channel is empty, until it has dispatched
+  // |max_messages| messages, or until |max_time| has passed since the wakeup,
+  // whichever comes first. Bursts of messages then cost one wait on the
+  // dispatcher rather than one per message, while a busy channel still yields
+  // to other work on the dispatcher once its budget is spent.
+  //
+  // A |max_messages| of zero restores the default behavior.
+  void set_dispatch_budget(uint32_t max_messages,
+                           zx::duration max_time = zx::duration::infinite()) {
+    max_messages_per_wakeup_ = max_messages;
+    max_time_per_wakeup_ = max_time;
+  }
+
+  // Whether the |MessageReader| keeps a single repeating wait armed on the
+  // channel instead of beginning a new wait after every wakeup.
+  //
+  // A quiet channel then costs nothing to keep armed and a busy one does not
+  // pay a wait per message. Each wakeup reads the channel until it is empty.
+  // If a dispatch budget runs out first, the reader falls back to a one-shot
+  // wait until the channel has been drained.
+  //
+  // Only takes effect on dispatchers that support
+  // |async_begin_repeating_wait|, and only for dispatchers serviced by a
+  // single thread. Applies the next time a wait begins.
+  void set_use_repeating_wait(bool use_repeating_wait) {
+    use_repeating_wait_ = use_repeating_wait;
   }
 
+  // Records how deep the channel's queue is at each wakeup and how long each
+  // message takes to read and to dispatch into |stats|, which must outlive the
+  // |MessageReader| or be cleared with nullptr first.
+  //
+  // Timing costs three clock reads per message, before the read, before the
+  // dispatch and after it, so it is off unless |stats| is non-null.
+  void set_dispatch_stats(DispatchStats* stats) { stats_ = stats; }
+
+  // Records every message the |MessageReader| reads into |capture|, which
+  // must outlive the |MessageReader| or be cleared with nullptr first.
+  //
+  // Owners that write to the channel record what they write there too.
+  void set_message_capture(MessageCapture* capture) { capture_ = capture; }
+  MessageCapture* message_capture() const { return capture_; }
+
  private:
   static void CallHandler(async_dispatcher_t* dispatcher, async_wait_t* wait,
                           zx_status_t status, const zx_packet_signal_t* signal);
   void OnHandleReady(async_dispatcher_t* dispatcher, zx_status_t status,
                      const zx_packet_signal_t* signal);
-  zx_status_t ReadAndDispatchMessage(MessageBuffer* buffer);
+  zx_status_t BeginWait(async_dispatcher_t* dispatcher);
+  zx_status_t ReadAndDispatchMessage();
+  zx_status_t DispatchMessage(zx_status_t read_status, Message message,
+                              zx::time read_start);
   void NotifyError(zx_status_t epitaph_value);
   void Stop();
 
+  using ErrorHandler = fit::callback_function<void(zx_status_t)>;
+
+  // The |ErrorCallback| of handlers set with |set_error_handler|, whose
+  // context is the |ErrorHandler|.
+  static void CallErrorHandler(void* context, zx_status_t status);
+  void ClearErrorCallback();
+
+  // Ordered to leave no padding: every connection has a reader.
   async_wait_t wait_;  // Must be first.
   zx::channel channel_;
+  std::atomic<zx_status_t> deferred_error_{ZX_OK};  // See |DeferError|.
   async_dispatcher_t* dispatcher_;
   bool* should_stop_;  // See |Canary| in message_reader.cc.
   MessageHandler* message_handler_;
-  fit::function<void(zx_status_t)> error_handler_;
+  ErrorCallback error_callback_ = nullptr;
+  void* error_context_ = nullptr;
+  DispatchStats* stats_ = nullptr;
+  MessageCapture* capture_ = nullptr;
+  zx::duration max_time_per_wakeup_ = zx::duration::infinite();
+  uint32_t max_messages_per_wakeup_ = 0u;
+  bool use_repeating_wait_ = false;
+  bool wait_is_repeating_ = false;
+  // Whether |error_context_| is an |ErrorHandler| the reader owns.
+  bool owns_error_context_ = false;
 };
 
 }  // namespace internal
@@ -23,6 +23,14 @@ class WeakStubController;
 // unbound from the underlying channel (e.g., due to an error), the stub can
 // still safely call |Send|, but the response will not actually be sent to the
 // client.
+//
+// |Send| must be called on the thread of the dispatcher the |StubController|
+// is bound to, unless the controller dispatches through
+// |StubController::set_concurrent_dispatcher|, in which case it may be called
+// from any thread. Each reply is then written to the channel as a single
+// message tagged with the transaction ID of the message it answers, so replies
+// sent concurrently never interleave and the client matches them to its calls
+// regardless of the order they arrive in.
 class PendingResponse {
  public:
   // Creates a |PendingResponse| that does not need a response.
@@ -5,11 +5,14 @@
 #ifndef LIB_FIDL_CPP_INTERNAL_PROXY_CONTROLLER_H_
 #define LIB_FIDL_CPP_INTERNAL_PROXY_CONTROLLER_H_
 
+#include <lib/async/wait.h>
 #include <lib/fidl/cpp/message.h>
 #include <lib/fidl/cpp/message_builder.h>
+#include <lib/fit/function.h>
 
-#include <map>
+#include <deque>
 #include <memory>
+#include <vector>
 
 #include "lib/fidl/cpp/internal/message_handler.h"
 #include "lib/fidl/cpp/internal/message_reader.h"
@@ -35,6 +38,17 @@ class ProxyController : public MessageHandler {
   ProxyController(ProxyController&&);
   ProxyController& operator=(ProxyController&&);
 
+  // The number of bytes a |ResponseHandler| stores inline, which is enough
+  // for a lambda that captures a |fit::function| callback and a pointer.
+  static constexpr size_t kResponseHandlerInlineSize = 4 * sizeof(void*);
+
+  // Receives the response to a message sent with |SendWithResponseHandler|.
+  //
+  // The handler is stored inline in the table of pending responses, so
+  // sending a message with one does not allocate.
+  using ResponseHandler =
+      fit::inline_function<zx_status_t(Message), kResponseHandlerInlineSize>;
+
   // The |MessageReader| that is listening for responses to messages sent by
   // this object.
   MessageReader& reader() { return reader_; }
@@ -63,6 +77,49 @@ class ProxyController : public MessageHandler {
   zx_status_t Send(const fidl_type_t* type, Message message,
                    std::unique_ptr<MessageHandler> response_handler);
 
+  // Send a message over the channel, and call |response_handler| with the
+  // response once it arrives.
+  //
+  // Behaves like |Send| except that |response_handler|, which must not be
+  // null, is stored without a heap allocation.
+  zx_status_t SendWithResponseHandler(const fidl_type_t* type,
+                                      Message message,
+                                      ResponseHandler response_handler);
+
+  // Send a message that expects no response and has already been validated
+  // against |type|, without validating it again.
+  //
+  // Used to send one encoded message to many channels, validating it once.
+  zx_status_t SendValidated(const fidl_type_t* type, Message message);
+
+  // Limits the number of calls awaiting a response to |max_in_flight_calls|
+  // and holds back messages while the channel is not writable.
+  //
+  // Calls sent beyond the limit are validated and queued, with their response
+  // handlers registered, and written in order as responses to earlier calls
+  // arrive. Once a message is queued, later messages queue behind it, so
+  // messages are always written in the order they were sent. If the channel
+  // reports |ZX_ERR_SHOULD_WAIT|, or a message carrying handles finds the
+  // channel not writable, the queue waits for |ZX_CHANNEL_WRITABLE| on the
+  // dispatcher of the |reader()| instead of failing the channel. Queued
+  // messages are discarded if the channel goes away.
+  //
+  // Zero, the default, turns flow control off: every message is written
+  // immediately and a full channel is an error. Use UINT32_MAX to wait for the
+  // channel to become writable without limiting the number of calls.
+  void set_max_in_flight_calls(uint32_t max_in_flight_calls) {
+    max_in_flight_calls_ = max_in_flight_calls;
+  }
+
+  // The number of calls that have been written to the channel and are
+  // awaiting a response.
+  uint32_t in_flight_calls() const { return in_flight_calls_; }
+
+  // The number of messages held back by flow control.
+  size_t queued_messages() const {
+    return send_queue_ ? send_queue_->messages.size() : 0u;
+  }
+
   // Clears all the state associated with this |ProxyController|.
   //
   // After this method returns, the |ProxyController| is in the same state it
@@ -84,10 +141,105 @@ class ProxyController : public MessageHandler {
   // reset its transition identifiers.
   void ClearPendingHandlers();
 
+  // Writes |message| with the transaction identifier |txid|, which is zero
+  // for messages that expect no response. Releases the pending handler for
+  // |txid| if the message cannot be sent.
+  zx_status_t SendWithTxid(const fidl_type_t* type, Message message,
+                           zx_txid_t txid);
+
+  // The part of |SendWithTxid| that follows validation. |type| is used only
+  // to report errors.
+  zx_status_t WriteWithTxid(const fidl_type_t* type, Message message,
+                            zx_txid_t txid);
+
+  // A message held back by flow control.
+  struct QueuedMessage {
+    QueuedMessage(Message* message, zx_txid_t txid);
+    ~QueuedMessage();
+    QueuedMessage(QueuedMessage&&) = default;
+    QueuedMessage& operator=(QueuedMessage&&) = default;
+
+    std::vector<uint8_t> bytes;
+    // Closed on destruction unless they have been written.
+    std::vector<zx_handle_t> handles;
+    zx_txid_t txid;
+  };
+
+  // Whether a message with transaction identifier |txid| must be queued
+  // rather than written immediately.
+  bool MustQueue(zx_txid_t txid) const;
+
+  // Moves |message| to the back of the send queue.
+  void Enqueue(Message* message, zx_txid_t txid);
+
+  // Writes as many queued messages as flow control allows.
+  //
+  // Returns an error if a message could not be written for a reason other
+  // than the channel being full.
+  zx_status_t FlushSendQueue();
+
+  // Whether the channel can be written to without |ZX_ERR_SHOULD_WAIT|.
+  bool IsWritable() const;
+
+  // Waits for the channel to become writable and then flushes the queue.
+  zx_status_t BeginWritableWait();
+  void CancelWritableWait();
+
+  // Called when the channel becomes writable.
+  static void OnWritable(async_dispatcher_t* dispatcher, async_wait_t* wait,
+                         zx_status_t status, const zx_packet_signal_t* signal);
+
+  // An |async_wait_t| that knows which |ProxyController| it belongs to.
+  struct WritableWait : public async_wait_t {
+    ProxyController* controller;
+  };
+
+  // The messages held back by flow control and the wait for the channel to
+  // become writable. Allocated when the first message is held back, so that
+  // proxies which never queue do not carry it.
+  struct SendQueue {
+    explicit SendQueue(ProxyController* controller);
+
+    std::deque<QueuedMessage> messages;
+    WritableWait writable_wait;
+    // The dispatcher |writable_wait| was begun on, or null if it is not
+    // pending.
+    async_dispatcher_t* writable_wait_dispatcher = nullptr;
+  };
+
+  // Stores |handler| in a free slot and returns the transaction identifier
+  // that refers to it, or zero if every slot is in use.
+  zx_txid_t AddPendingHandler(ResponseHandler handler);
+
+  // Removes and returns the handler for |txid|, or null if there is none.
+  // Stores the id of the call's trace flow in |flow_id|, if not null.
+  ResponseHandler TakePendingHandler(zx_txid_t txid,
+                                     uint64_t* flow_id = nullptr);
+
+  // Generates the id of the trace flow of the call |txid|.
+  uint64_t BeginFlow(zx_txid_t txid);
+
+  // A pending response handler, indexed by the low bits of its transaction
+  // identifier. The high bits hold the slot's |generation|, which changes
+  // every time the slot is freed, so a stale or duplicate response never
+  // matches a later call that reuses the slot.
+  struct PendingHandler {
+    ResponseHandler handler;
+    uint32_t generation = 1u;
+    // The id of the call's trace flow, or zero if it is not traced.
+    uint64_t flow_id = 0u;
+  };
+
   MessageReader reader_;
   Proxy* proxy_ = nullptr;
-  std::map<zx_txid_t, std::unique_ptr<MessageHandler>> handlers_;
-  zx_txid_t next_txid_;
+  std::vector<PendingHandler> handlers_;
+  // Indices of the unused entries of |handlers_|, most recently freed last.
+  std::vector<uint32_t> free_slots_;
+
+  // Flow control. See |set_max_in_flight_calls|.
+  uint32_t max_in_flight_calls_ = 0u;
+  uint32_t in_flight_calls_ = 0u;
+  std::unique_ptr<SendQueue> send_queue_;
 };
 
 }  // namespace internal
@@ -6,7 +6,9 @@
 #define LIB_FIDL_CPP_INTERNAL_STUB_CONTROLLER_H_
 
 #include <memory>
+#include <vector>
 
+#include <lib/async/dispatcher.h>
 #include <lib/fidl/cpp/message.h>
 #include <lib/zx/channel.h>
 
@@ -45,12 +47,67 @@ class StubController : public MessageHandler {
   Stub* stub() const { return stub_; }
   void set_stub(Stub* stub) { stub_ = stub; }
 
+  // Dispatches messages on |dispatcher| instead of on the dispatcher the
+  // |reader()| is bound to.
+  //
+  // The |reader()| still reads every message, but rather than calling the
+  // |stub()| itself, it copies each message and posts it as a task to
+  // |dispatcher|. If several threads service |dispatcher|, a slow method no
+  // longer holds up the messages behind it, so the implementation must be
+  // safe to call concurrently and must not rely on messages being dispatched
+  // in the order they were sent. Replies may be sent from any thread.
+  //
+  // Messages that fail to dispatch are reported to the error handler of the
+  // |reader()| from the reader's dispatcher. Unbinding or destroying the
+  // |StubController| waits for messages that are being dispatched on other
+  // threads to return, and drops messages that have not started.
+  //
+  // Passing null restores dispatching on the reader's dispatcher.
+  void set_concurrent_dispatcher(async_dispatcher_t* dispatcher) {
+    concurrent_dispatcher_ = dispatcher;
+  }
+
   // Send a message over the channel.
   //
   // Returns an error if the message fails to encode properly or if the message
   // cannot be written to the channel.
+  //
+  // Between |BeginBatch| and |EndBatch|, the message is validated and queued
+  // instead, and this method returns ZX_OK unless validation fails.
   zx_status_t Send(const fidl_type_t* type, Message message);
 
+  // Starts queuing the messages passed to |Send| instead of writing each one
+  // to the channel as it is sent.
+  //
+  // Events are the only messages sent through |Send|, so a stub that emits a
+  // burst of events can queue them and have them written back-to-back when
+  // the batch ends, rather than interleaving a channel write with the work
+  // that produces each event. A reader that drains the channel then wakes once
+  // for the whole burst. Messages are never merged: each event is still its
+  // own message, written in the order it was sent.
+  //
+  // Replies sent through a |PendingResponse| during a batch are queued too,
+  // behind the events sent before them, so the client sees events and replies
+  // in the order the stub sent them. The exception is a controller that
+  // dispatches through |set_concurrent_dispatcher|: its replies may be sent
+  // from any thread, so they are written right away, possibly ahead of
+  // queued events.
+  //
+  // Batches nest. The queued messages are written when the outermost batch
+  // ends.
+  void BeginBatch() {
+    if (!batch_)
+      batch_ = std::make_unique<Batch>();
+    ++batch_depth_;
+  }
+
+  // Ends a batch started with |BeginBatch|, writing the queued messages if this
+  // ends the outermost batch.
+  //
+  // Returns the first error encountered writing the queued messages. The
+  // handles in messages that could not be written are closed.
+  zx_status_t EndBatch();
+
  private:
   // Called by the |MessageReader| when a message arrives on the channel from
   // the client.
@@ -69,9 +126,46 @@ class StubController : public MessageHandler {
   // |PendingResponse| objects from sending messages.
   void InvalidateWeakIfNeeded();
 
+  // A message queued by |Send| during a batch. Its bytes and handles are
+  // stored back-to-back with those of the other queued messages in
+  // |Batch::bytes| and |Batch::handles|.
+  struct BatchedMessage {
+    uint32_t num_bytes;
+    uint32_t num_handles;
+  };
+
+  // The messages queued during a batch. Allocated by the first batch and then
+  // kept, so that stubs which never batch do not carry it.
+  struct Batch {
+    std::vector<BatchedMessage> messages;
+    std::vector<uint8_t> bytes;
+    std::vector<zx_handle_t> handles;
+  };
+
+  friend class PendingResponse;
+
+  // Writes |message| to the channel, or queues it during a batch.
+  zx_status_t Write(Message message);
+
+  // Writes a reply sent through a |PendingResponse|, which is queued like an
+  // event unless replies may come from other threads.
+  zx_status_t WriteReply(Message message);
+
+  // Writes the queued messages to the channel and empties the queue.
+  zx_status_t FlushBatch();
+
+  // Closes the handles of the queued messages and empties the queue.
+  void DiscardBatch();
+
+  // Copies |message| and posts it to the |concurrent_dispatcher_|.
+  zx_status_t PostMessage(Message message, WeakStubController* weak);
+
   WeakStubController* weak_;
   MessageReader reader_;
   Stub* stub_;
+  async_dispatcher_t* concurrent_dispatcher_ = nullptr;
+  std::unique_ptr<Batch> batch_;
+  uint32_t batch_depth_ = 0u;
 };
 
 }  // namespace internal
@@ -7,6 +7,10 @@
 
 #include <stdint.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
 namespace fidl {
 namespace internal {
 class StubController;
@@ -17,6 +21,13 @@ class StubController;
 // |StubController| is destroyed (or unbound from the underling channel), the
 // weak reference is invalidated, preventing outstanding |PendingResponse|
 // objects from referencing the |StubController|.
+//
+// By default, a |WeakStubController| is used only on the thread that owns its
+// |StubController|, and taking a reference or a |Use| is a plain memory
+// operation, with no atomics or locks on the request/response path. After
+// |set_thread_safe|, the reference count is atomic and the link to the
+// |StubController| is guarded by a lock, so the |WeakStubController| can be
+// shared by threads that dispatch messages and send replies concurrently.
 class WeakStubController {
  public:
   // Creates a weak reference to a |StubController|.
@@ -25,6 +36,19 @@ class WeakStubController {
   // the creator is responsible for calling |Release| exactly once.
   explicit WeakStubController(StubController* controller);
 
+  // Makes this object safe to use from several threads at once.
+  //
+  // Must be called on the thread that owns the |StubController|, before the
+  // object is shared with other threads. Cannot be undone.
+  //
+  // |thread_safe_| is a plain |bool| that other threads read without
+  // synchronization, so it is written only this once and never again.
+  void set_thread_safe() { thread_safe_ = true; }
+
+  // Whether |set_thread_safe| has been called. Only meaningful on the thread
+  // that owns the |StubController|.
+  bool is_thread_safe() const { return thread_safe_; }
+
   // Increment the refernence count for this object.
   //
   // Each call to this method imposes a requirement to eventually call |Release|
@@ -38,19 +62,53 @@ class WeakStubController {
 
   // Break the connection between this object and the |StubController|.
   //
-  // After calling this method, |controller()| will return nullptr.
+  // After calling this method, new |Use| objects will see a null controller.
+  // If other threads are using the |StubController| through a |Use|, blocks
+  // until they are done. Uses held by the calling thread do not block.
   void Invalidate();
 
-  // The |StubController| to which this weak reference refers.
+  // Keeps the |StubController| from being invalidated while in scope.
   //
-  // After the weak reference has been invalidated, this method returns nullptr.
-  StubController* controller() const { return controller_; }
+  // Threads other than the one that owns the |StubController| must hold a
+  // |Use| for as long as they touch the |StubController|.
+  class Use {
+   public:
+    explicit Use(WeakStubController* weak);
+    ~Use();
+
+    Use(const Use&) = delete;
+    Use& operator=(const Use&) = delete;
+
+    // The |StubController| to which the weak reference referred when this
+    // |Use| was created, or nullptr if it had already been invalidated.
+    StubController* controller() const { return controller_; }
+
+   private:
+    friend class WeakStubController;
+
+    WeakStubController* const weak_;
+    // Whether |weak_| was thread-safe, and so this |Use| counted, when it was
+    // created.
+    const bool counted_;
+    StubController* const controller_;
+    Use* const previous_;  // The next older counted |Use| on this thread.
+  };
 
  private:
   ~WeakStubController();
 
-  uint32_t ref_count_;  // starts at one
+  // The number of |Use| objects held by the calling thread for this object
+  // that refer to a live controller.
+  uint32_t CountUsesOnCurrentThread() const;
+
+  std::atomic<uint32_t> ref_count_;  // starts at one
+  bool thread_safe_ = false;
+
+  std::mutex mutex_;
+  std::condition_variable uses_done_;
+  // Guarded by |mutex_| once |thread_safe_|.
   StubController* controller_;
+  uint32_t use_count_;
 };
 
 }  // namespace internal
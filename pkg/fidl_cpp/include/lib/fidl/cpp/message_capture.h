@@ -0,0 +1,128 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_MESSAGE_CAPTURE_H_
+#define LIB_FIDL_CPP_MESSAGE_CAPTURE_H_
+
+#include <lib/fidl/cpp/message.h>
+#include <lib/zx/time.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zircon/types.h>
+
+#include <memory>
+#include <vector>
+
+namespace fidl {
+
+// A capture file starts with a |MessageCaptureHeader|. Each message follows
+// as a |MessageCaptureRecord|, then its bytes, then the |zx_obj_type_t| of
+// each of its handles as a |uint32_t|, the bytes and the types each padded to
+// eight bytes. Everything is in the byte order of the device.
+struct MessageCaptureHeader {
+  // |kMagic|.
+  uint64_t magic;
+  // |kVersion|.
+  uint32_t version;
+  uint32_t reserved;
+
+  static constexpr uint64_t kMagic = 0x317061636c646966;  // "fidlcap1"
+  static constexpr uint32_t kVersion = 1u;
+};
+
+struct MessageCaptureRecord {
+  // The time since the first message of the capture, in nanoseconds.
+  uint64_t time;
+  // A |MessageCapture::Direction|.
+  uint32_t direction;
+  uint32_t num_bytes;
+  uint32_t num_handles;
+  uint32_t reserved;
+};
+
+// Records the messages of a channel to a file, to be replayed later by
+// |fidl::MessageReplay| with the production mix of messages and timing.
+//
+// Attach a capture to a |Binding| or an |InterfacePtr| with
+// |set_message_capture|. It records the bytes and handle types of each
+// message the reader reads, and of each message an |InterfacePtr| writes,
+// with the time it was seen. The handles themselves are not recorded.
+//
+// Records are buffered and written to the file in large writes. Once a write
+// fails, the capture stops recording and |status()| reports the error.
+//
+// A |MessageCapture| records one channel, and is not thread-safe.
+class MessageCapture {
+ public:
+  enum Direction : uint32_t {
+    // Read from the channel.
+    kRead = 0u,
+    // Written to the channel.
+    kWritten = 1u,
+  };
+
+  // Writes the capture to |fd|, which the capture owns.
+  explicit MessageCapture(int fd);
+
+  // Flushes the capture and closes the file.
+  ~MessageCapture();
+
+  MessageCapture(const MessageCapture&) = delete;
+  MessageCapture& operator=(const MessageCapture&) = delete;
+
+  // Creates a capture written to the file at |path|, which is truncated.
+  //
+  // Returns null if the file cannot be opened.
+  static std::unique_ptr<MessageCapture> Create(const char* path);
+
+  // The types of the handles of a message.
+  struct HandleTypes {
+    uint32_t count = 0u;
+    // The |zx_obj_type_t| of each handle.
+    uint32_t types[ZX_CHANNEL_MAX_MSG_HANDLES];
+  };
+
+  // Looks up the type of each of |handles|, which costs a system call each.
+  //
+  // Writers call this before the write that consumes the handles, and record
+  // the message only once the write has succeeded.
+  static void GetHandleTypes(const zx_handle_t* handles, uint32_t num_handles,
+                             HandleTypes* handle_types);
+
+  // Records a message seen going in |direction|.
+  void Record(Direction direction, const uint8_t* bytes, uint32_t num_bytes,
+              const HandleTypes& handle_types);
+  void Record(Direction direction, const uint8_t* bytes, uint32_t num_bytes,
+              const zx_handle_t* handles, uint32_t num_handles) {
+    HandleTypes handle_types;
+    GetHandleTypes(handles, num_handles, &handle_types);
+    Record(direction, bytes, num_bytes, handle_types);
+  }
+  void Record(Direction direction, const Message& message) {
+    Record(direction, message.bytes().data(), message.bytes().actual(),
+           message.handles().data(), message.handles().actual());
+  }
+
+  // Writes the buffered records to the file.
+  zx_status_t Flush();
+
+  // The number of messages recorded.
+  uint64_t message_count() const { return message_count_; }
+
+  // |ZX_OK|, or the error that stopped the capture.
+  zx_status_t status() const { return status_; }
+
+ private:
+  void Append(const void* data, size_t size);
+
+  int fd_;
+  std::vector<uint8_t> buffer_;
+  zx::time start_;
+  uint64_t message_count_ = 0u;
+  zx_status_t status_ = ZX_OK;
+};
+
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_MESSAGE_CAPTURE_H_
@@ -0,0 +1,202 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_PIPELINE_H_
+#define LIB_FIDL_CPP_PIPELINE_H_
+
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <lib/fit/bridge.h>
+#include <lib/fit/function.h>
+#include <lib/fit/promise.h>
+#include <zircon/types.h>
+
+#include "lib/fidl/cpp/interface_ptr.h"
+#include "lib/fidl/cpp/interface_request.h"
+
+namespace fidl {
+namespace internal {
+
+// The value of a promise of a reply with |Args|: nothing, the one argument,
+// or a tuple of them all.
+template <typename... Args>
+struct PipelineReply {
+  using value_type = std::tuple<Args...>;
+  static auto Bind(fit::completer<value_type, zx_status_t>* completer) {
+    return completer->bind_tuple();
+  }
+};
+
+template <typename Arg>
+struct PipelineReply<Arg> {
+  using value_type = Arg;
+  static auto Bind(fit::completer<value_type, zx_status_t>* completer) {
+    return completer->bind();
+  }
+};
+
+template <>
+struct PipelineReply<> {
+  using value_type = void;
+  static auto Bind(fit::completer<value_type, zx_status_t>* completer) {
+    return completer->bind();
+  }
+};
+
+}  // namespace internal
+
+// A chain of pipelined calls, such as opening an interface with one call and
+// calling it at once, which fails as a whole as soon as any stage fails.
+//
+// Each stage's interface is opened with |NewRequest|, so that its calls can be
+// made before the previous stage has answered; the pipeline fails with the
+// error or epitaph that closes any of its channels. The replies of stages that
+// only report a status are checked with |Expect|, and the last call's reply
+// is received as a promise with |Reply|. That promise fails with the first
+// error of any stage, so a chain of calls costs one wait for the last reply
+// rather than a round trip per stage.
+//
+// # Example
+//
+// With |namespace ledger = fuchsia::ledger|:
+//
+//   fidl::Pipeline pipeline;
+//   ledger::PagePtr page;
+//   ledger::PageSnapshotPtr snapshot;
+//   ledger_->GetPage(nullptr, pipeline.NewRequest(&page),
+//                    pipeline.Expect(ledger::Status::OK, ZX_ERR_NOT_FOUND));
+//   page->GetSnapshot(pipeline.NewRequest(&snapshot), nullptr, nullptr,
+//                     pipeline.Expect(ledger::Status::OK, ZX_ERR_IO));
+//   auto promise =
+//       pipeline
+//           .Reply<ledger::Status, fuchsia::mem::BufferPtr>(
+//               [&](auto callback) {
+//                 snapshot->Get(key, std::move(callback));
+//               })
+//           .and_then([page = std::move(page), snapshot = std::move(snapshot)](
+//                         auto& reply) { ... });
+//   executor.schedule_task(std::move(promise));
+//
+// The interface pointers must be kept alive, here by the promise, until the
+// last reply arrives.
+//
+// Copies of a |Pipeline| refer to the same chain. This class is
+// thread-hostile, as are the |InterfacePtr|s of its stages.
+class Pipeline {
+ public:
+  Pipeline() : state_(std::make_shared<State>()) {}
+
+  // The error with which the pipeline failed, or |ZX_OK| while it has not.
+  zx_status_t status() const { return state_->status; }
+
+  // Binds |ptr| to a new channel, as |InterfacePtr::NewRequest| does, and
+  // returns its request. The pipeline fails with the error that closes the
+  // channel, which is the epitaph the remote end sent if any, or with
+  // |ZX_ERR_INTERNAL| if the channel cannot be made.
+  //
+  // Replaces the error handler of |ptr|.
+  template <typename Interface>
+  InterfaceRequest<Interface> NewRequest(
+      InterfacePtr<Interface>* ptr, async_dispatcher_t* dispatcher = nullptr) {
+    InterfaceRequest<Interface> request = ptr->NewRequest(dispatcher);
+    if (!request) {
+      Fail(ZX_ERR_INTERNAL);
+      return request;
+    }
+    ptr->set_error_handler(
+        [state = state_](zx_status_t status) { Fail(state, status); });
+    return request;
+  }
+
+  // Returns a callback for a reply that only carries a status, which fails
+  // the pipeline with |error| unless the status is |ok|.
+  template <typename Status>
+  fit::function<void(Status)> Expect(Status ok, zx_status_t error) {
+    return [state = state_, ok, error](Status status) {
+      if (!(status == ok))
+        Fail(state, error);
+    };
+  }
+
+  // Makes the last call of the chain and returns a promise of its reply.
+  //
+  // |call| is invoked at once with the callback to pass the call, which
+  // takes |Args|. The promise completes with the reply: nothing, its one
+  // argument, or a tuple of its arguments. It fails with the first error of
+  // any stage, or with |ZX_ERR_PEER_CLOSED| if the reply never comes.
+  template <typename... Args, typename Call>
+  fit::promise<typename internal::PipelineReply<Args...>::value_type,
+               zx_status_t>
+  Reply(Call call) {
+    using Traits = internal::PipelineReply<Args...>;
+    fit::bridge<typename Traits::value_type, zx_status_t> bridge;
+    call(Traits::Bind(&bridge.completer()));
+    return Guard(bridge.consumer().promise_or(fit::error(ZX_ERR_PEER_CLOSED)));
+  }
+
+  // Returns a promise with the outcome of |promise|, unless the pipeline
+  // fails first, in which case it fails with the pipeline's error.
+  //
+  // |promise| is any promise whose error type is |zx_status_t|.
+  template <typename Promise>
+  fit::promise<typename Promise::value_type, zx_status_t> Guard(
+      Promise promise) {
+    using Result = typename Promise::result_type;
+    static_assert(
+        std::is_same<typename Promise::error_type, zx_status_t>::value,
+        "The promise must fail with a zx_status_t");
+    return fit::make_promise(
+        [state = state_, promise = std::move(promise),
+         waiter = std::shared_ptr<fit::suspended_task>()](
+            fit::context& context) mutable -> Result {
+          // Check the pipeline first: a channel that closes drops its pending
+          // replies too, and its epitaph says more than their abandonment.
+          if (state->status != ZX_OK)
+            return fit::error(state->status);
+          Result result = promise(context);
+          if (!result.is_pending())
+            return result;
+          if (!waiter) {
+            waiter = std::make_shared<fit::suspended_task>();
+            state->waiters.push_back(waiter);
+          }
+          *waiter = context.suspend_task();
+          return fit::pending();
+        });
+  }
+
+  // Fails the pipeline with |status| unless it has already failed.
+  void Fail(zx_status_t status) { Fail(state_, status); }
+
+ private:
+  struct State {
+    zx_status_t status = ZX_OK;
+    // The tasks of the promises returned by |Guard|, to resume when the
+    // pipeline fails.
+    std::vector<std::weak_ptr<fit::suspended_task>> waiters;
+  };
+
+  static void Fail(const std::shared_ptr<State>& state, zx_status_t status) {
+    if (state->status != ZX_OK)
+      return;
+    // Even an epitaph of |ZX_OK| closes a channel the pipeline needs.
+    state->status = status != ZX_OK ? status : ZX_ERR_PEER_CLOSED;
+    std::vector<std::weak_ptr<fit::suspended_task>> waiters;
+    waiters.swap(state->waiters);
+    for (auto& weak : waiters) {
+      if (auto waiter = weak.lock())
+        waiter->resume_task();
+    }
+  }
+
+  std::shared_ptr<State> state_;
+};
+
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_PIPELINE_H_
@@ -5,11 +5,14 @@
 #ifndef LIB_FIDL_CPP_THREAD_SAFE_BINDING_SET_H_
 #define LIB_FIDL_CPP_THREAD_SAFE_BINDING_SET_H_
 
-#include <algorithm>
+#include <stdint.h>
+
+#include <array>
+#include <iterator>
+#include <list>
 #include <memory>
 #include <mutex>
 #include <utility>
-#include <vector>
 
 #include <lib/async/dispatcher.h>
 #include <zircon/compiler.h>
@@ -26,6 +29,9 @@ namespace fidl {
 //
 // This class is thread-safe; bindings may be added or cleared from any thread.
 //
+// Like |BindingSet|, bindings live in list nodes and are removed in constant
+// time. Removed bindings are destroyed after the lock is released.
+//
 // See also:
 //
 //  * |BindingSet|, which is the thread-hostile analog that offers more
@@ -35,7 +41,10 @@ template <typename Interface, typename ImplPtr = Interface*>
 class ThreadSafeBindingSet {
  public:
   using Binding = ::fidl::Binding<Interface, ImplPtr>;
-  using StorageType = std::vector<std::unique_ptr<Binding>>;
+  // This used to be |std::vector<std::unique_ptr<Binding>>|, as for
+  // |BindingSet|.
+  using StorageType = std::list<Binding>;
+  using iterator = typename StorageType::iterator;
 
   ThreadSafeBindingSet() = default;
 
@@ -62,13 +71,13 @@ class ThreadSafeBindingSet {
   void AddBinding(ImplPtr impl, InterfaceRequest<Interface> request,
                   async_dispatcher_t* dispatcher) {
     std::lock_guard<std::mutex> guard(lock_);
-    bindings_.push_back(std::make_unique<Binding>(
-        std::forward<ImplPtr>(impl), std::move(request), dispatcher));
-    auto* binding = bindings_.back().get();
+    bindings_.emplace_back(std::forward<ImplPtr>(impl), std::move(request),
+                           dispatcher);
+    iterator it = std::prev(bindings_.end());
     // Set the connection error handler for the newly added Binding to be a
-    // function that will erase it from the vector.
-    binding->set_error_handler(
-        [binding, this](zx_status_t status) { this->RemoveOnError(binding); });
+    // function that will erase it from the list.
+    it->set_error_handler(
+        [it, this](zx_status_t status) { this->RemoveOnError(it); });
   }
 
   // Adds a binding to the set for the given implementation.
@@ -101,27 +110,135 @@ class ThreadSafeBindingSet {
   //
   // Closes all the channels associated with this |BindingSet|.
   void CloseAll() {
-    std::lock_guard<std::mutex> guard(lock_);
-    bindings_.clear();
+    StorageType bindings_local;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      bindings_local.swap(bindings_);
+    }
   }
 
  private:
   // Called when a binding has an error to remove the binding from the set.
-  void RemoveOnError(Binding* binding) {
-    std::lock_guard<std::mutex> guard(lock_);
-    auto it = std::find_if(bindings_.begin(), bindings_.end(),
-                           [binding](const std::unique_ptr<Binding>& b) {
-                             return b.get() == binding;
-                           });
-    ZX_DEBUG_ASSERT(it != bindings_.end());
-    (*it)->set_error_handler(nullptr);
-    bindings_.erase(it);
+  void RemoveOnError(iterator it) {
+    StorageType binding_local;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      binding_local.splice(binding_local.begin(), bindings_, it);
+    }
+    it->set_error_handler(nullptr);
   }
 
   std::mutex lock_;
   StorageType bindings_ __TA_GUARDED(lock_);
 };
 
+// A |ThreadSafeBindingSet| whose bindings are partitioned by dispatcher.
+//
+// Bindings are spread across |kShardCount| shards according to the dispatcher
+// they are bound to, and each shard has its own lock. Servers that run one
+// loop per core and add and remove bindings from each loop's thread therefore
+// mostly take locks that no other thread contends for, rather than a single
+// lock shared by every loop.
+//
+// This class is thread-safe; bindings may be added or cleared from any thread.
+template <typename Interface, typename ImplPtr = Interface*>
+class ShardedThreadSafeBindingSet {
+ public:
+  using Binding = ::fidl::Binding<Interface, ImplPtr>;
+
+  static constexpr size_t kShardCount = 16;
+
+  ShardedThreadSafeBindingSet() = default;
+
+  ShardedThreadSafeBindingSet(const ShardedThreadSafeBindingSet&) = delete;
+  ShardedThreadSafeBindingSet& operator=(const ShardedThreadSafeBindingSet&) =
+      delete;
+
+  // Adds a binding to the shard for |dispatcher|.
+  //
+  // See |ThreadSafeBindingSet::AddBinding|.
+  void AddBinding(ImplPtr impl, InterfaceRequest<Interface> request,
+                  async_dispatcher_t* dispatcher) {
+    Shard* shard = &shards_[ShardIndex(dispatcher)];
+    std::lock_guard<std::mutex> guard(shard->lock);
+    shard->bindings.emplace_back(std::forward<ImplPtr>(impl),
+                                 std::move(request), dispatcher);
+    iterator it = std::prev(shard->bindings.end());
+    it->set_error_handler([shard, it](zx_status_t status) {
+      ShardedThreadSafeBindingSet::RemoveOnError(shard, it);
+    });
+  }
+
+  // Adds a binding to the shard for |dispatcher| for the given
+  // implementation.
+  //
+  // See |ThreadSafeBindingSet::AddBinding|.
+  InterfaceHandle<Interface> AddBinding(ImplPtr impl,
+                                        async_dispatcher_t* dispatcher) {
+    InterfaceHandle<Interface> handle;
+    InterfaceRequest<Interface> request = handle.NewRequest();
+    if (!request)
+      return nullptr;
+    AddBinding(std::forward<ImplPtr>(impl), std::move(request), dispatcher);
+    return handle;
+  }
+
+  // Removes all the bindings from the set, one shard at a time.
+  //
+  // Closes all the channels associated with this set. Each shard's lock is
+  // held only while its bindings are taken out, not while they are destroyed.
+  void CloseAll() {
+    for (Shard& shard : shards_) {
+      StorageType bindings_local;
+      {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        bindings_local.swap(shard.bindings);
+      }
+    }
+  }
+
+  // The number of bindings in this set.
+  //
+  // Bindings may be added or removed concurrently, so the count may be out of
+  // date by the time it is returned.
+  size_t size() {
+    size_t size = 0u;
+    for (Shard& shard : shards_) {
+      std::lock_guard<std::mutex> guard(shard.lock);
+      size += shard.bindings.size();
+    }
+    return size;
+  }
+
+ private:
+  using StorageType = std::list<Binding>;
+  using iterator = typename StorageType::iterator;
+
+  struct Shard {
+    std::mutex lock;
+    StorageType bindings __TA_GUARDED(lock);
+  };
+
+  // Dispatchers are aligned heap objects whose low address bits are all zero,
+  // so the address is mixed before picking a shard.
+  static size_t ShardIndex(async_dispatcher_t* dispatcher) {
+    uint64_t address = reinterpret_cast<uintptr_t>(dispatcher);
+    return static_cast<size_t>((address * 0x9e3779b97f4a7c15ull) >> 32) %
+           kShardCount;
+  }
+
+  static void RemoveOnError(Shard* shard, iterator it) {
+    StorageType binding_local;
+    {
+      std::lock_guard<std::mutex> guard(shard->lock);
+      binding_local.splice(binding_local.begin(), shard->bindings, it);
+    }
+    it->set_error_handler(nullptr);
+  }
+
+  std::array<Shard, kShardCount> shards_;
+};
+
 }  // namespace fidl
 
 #endif  // LIB_FIDL_CPP_THREAD_SAFE_BINDING_SET_H_
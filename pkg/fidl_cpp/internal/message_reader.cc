@@ -7,13 +7,19 @@
 #include <lib/async/default.h>
 #include <lib/fidl/cpp/message_buffer.h>
 #include <lib/fidl/epitaph.h>
+#include <trace/event.h>
 #include <zircon/assert.h>
+#include <zircon/syscalls.h>
 
 namespace fidl {
 namespace internal {
 namespace {
 
-constexpr zx_signals_t kSignals = ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED;
+// Raised on the local end of the channel by |DeferError|.
+constexpr zx_signals_t kDeferredErrorSignal = ZX_USER_SIGNAL_0;
+
+constexpr zx_signals_t kSignals =
+    ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED | kDeferredErrorSignal;
 
 // |Canary| is a stack-allocated object that observes when a |MessageReader| is
 // destroyed or unbound from the current channel.
@@ -70,6 +76,11 @@ class Canary {
 static_assert(std::is_standard_layout<MessageReader>::value,
               "We need offsetof to work");
 
+// Every |Binding| and |InterfacePtr| has a reader, so a server with many idle
+// connections pays this for each of them.
+static_assert(sizeof(void*) != 8 || sizeof(MessageReader) <= 112,
+              "MessageReader must stay within 112 bytes on 64-bit targets");
+
 MessageReader::MessageReader(MessageHandler* message_handler)
     : wait_{{ASYNC_STATE_INIT},
             &MessageReader::CallHandler,
@@ -77,13 +88,49 @@ MessageReader::MessageReader(MessageHandler* message_handler)
             kSignals},
       dispatcher_(nullptr),
       should_stop_(nullptr),
-      message_handler_(message_handler),
-      error_handler_(nullptr) {}
+      message_handler_(message_handler) {}
 
 MessageReader::~MessageReader() {
   Stop();
   if (dispatcher_)
     async_cancel_wait(dispatcher_, &wait_);
+  ClearErrorCallback();
+}
+
+void MessageReader::set_error_handler(
+    fit::callback_function<void(zx_status_t)> error_handler) {
+  if (owns_error_context_) {
+    // Assign in place, as a handler may replace itself while it runs.
+    *static_cast<ErrorHandler*>(error_context_) = std::move(error_handler);
+    return;
+  }
+  ClearErrorCallback();
+  if (!error_handler)
+    return;
+  error_callback_ = &MessageReader::CallErrorHandler;
+  error_context_ = new ErrorHandler(std::move(error_handler));
+  owns_error_context_ = true;
+}
+
+void MessageReader::set_error_callback(ErrorCallback callback,
+                                       void* context) {
+  ClearErrorCallback();
+  error_callback_ = callback;
+  error_context_ = context;
+}
+
+void MessageReader::CallErrorHandler(void* context, zx_status_t status) {
+  ErrorHandler& error_handler = *static_cast<ErrorHandler*>(context);
+  if (error_handler)
+    error_handler(status);
+}
+
+void MessageReader::ClearErrorCallback() {
+  if (owns_error_context_)
+    delete static_cast<ErrorHandler*>(error_context_);
+  error_callback_ = nullptr;
+  error_context_ = nullptr;
+  owns_error_context_ = false;
 }
 
 zx_status_t MessageReader::Bind(zx::channel channel,
@@ -103,7 +150,7 @@ zx_status_t MessageReader::Bind(zx::channel channel,
                 "|async_get_default_dispatcher| must "
                 "be configured to return a non-null value");
   wait_.object = channel_.get();
-  zx_status_t status = async_begin_wait(dispatcher_, &wait_);
+  zx_status_t status = BeginWait(dispatcher_);
   if (status != ZX_OK)
     Unbind();
   return status;
@@ -115,16 +162,23 @@ zx::channel MessageReader::Unbind() {
   Stop();
   async_cancel_wait(dispatcher_, &wait_);
   wait_.object = ZX_HANDLE_INVALID;
+  wait_is_repeating_ = false;
   dispatcher_ = nullptr;
-  zx::channel channel = std::move(channel_);
+  // The handler hears about the channel going away before the channel is
+  // moved out, so threads that the handler lets use the channel are done with
+  // it before it changes.
   if (message_handler_)
     message_handler_->OnChannelGone();
-  return channel;
+  // Only now can no thread defer another error, so the error cleared here
+  // does not come back to fail the channel's next binding.
+  if (deferred_error_.exchange(ZX_OK) != ZX_OK)
+    channel_.signal(kDeferredErrorSignal, 0);
+  return std::move(channel_);
 }
 
 void MessageReader::Reset() {
   Unbind();
-  error_handler_ = nullptr;
+  ClearErrorCallback();
 }
 
 zx_status_t MessageReader::TakeChannelAndErrorHandlerFrom(
@@ -132,7 +186,13 @@ zx_status_t MessageReader::TakeChannelAndErrorHandlerFrom(
   zx_status_t status = Bind(other->Unbind(), other->dispatcher_);
   if (status != ZX_OK)
     return status;
-  error_handler_ = std::move(other->error_handler_);
+  ClearErrorCallback();
+  error_callback_ = other->error_callback_;
+  error_context_ = other->error_context_;
+  owns_error_context_ = other->owns_error_context_;
+  other->error_callback_ = nullptr;
+  other->error_context_ = nullptr;
+  other->owns_error_context_ = false;
   return ZX_OK;
 }
 
@@ -148,11 +208,15 @@ zx_status_t MessageReader::WaitAndDispatchOneMessageUntil(zx::time deadline) {
     return status;
   }
 
-  if (pending & ZX_CHANNEL_READABLE) {
-    MessageBuffer buffer;
-    return ReadAndDispatchMessage(&buffer);
+  if (pending & kDeferredErrorSignal) {
+    status = deferred_error_.load();
+    NotifyError(status);
+    return status;
   }
 
+  if (pending & ZX_CHANNEL_READABLE)
+    return ReadAndDispatchMessage();
+
   ZX_DEBUG_ASSERT(pending & ZX_CHANNEL_PEER_CLOSED);
   NotifyError(ZX_ERR_PEER_CLOSED);
   return ZX_ERR_PEER_CLOSED;
@@ -175,10 +239,28 @@ void MessageReader::OnHandleReady(async_dispatcher_t* dispatcher,
     return;
   }
 
+  if (signal->observed & kDeferredErrorSignal) {
+    NotifyError(deferred_error_.load());
+    return;
+  }
+
   if (signal->observed & ZX_CHANNEL_READABLE) {
-    MessageBuffer buffer;
-    for (uint64_t i = 0; i < signal->count; i++) {
-      status = ReadAndDispatchMessage(&buffer);
+    if (stats_)
+      stats_->RecordWakeup(signal->count);
+    // A repeating wait does not fire again for messages already in the
+    // channel, so those wakeups drain the channel.
+    uint64_t max_messages = wait_is_repeating_ ? UINT64_MAX : signal->count;
+    zx::time deadline = zx::time::infinite();
+    if (max_messages_per_wakeup_) {
+      max_messages = max_messages_per_wakeup_;
+      if (max_time_per_wakeup_ != zx::duration::infinite())
+        deadline = zx::deadline_after(max_time_per_wakeup_);
+    }
+    for (uint64_t i = 0; i < max_messages; i++) {
+      if (i && deadline != zx::time::infinite() &&
+          zx::clock::get_monotonic() >= deadline)
+        break;
+      status = ReadAndDispatchMessage();
       // If ReadAndDispatchMessage returns ZX_ERR_STOP, that means the message
       // handler has destroyed this object and we need to unwind without
       // touching |this|.
@@ -187,7 +269,18 @@ void MessageReader::OnHandleReady(async_dispatcher_t* dispatcher,
       if (status != ZX_OK)
         return;
     }
-    status = async_begin_wait(dispatcher, &wait_);
+    if (wait_is_repeating_) {
+      if (status == ZX_ERR_SHOULD_WAIT)
+        return;
+      // The budget ran out before the channel was drained. Wait once so that
+      // the remaining messages wake us up again, and resume the repeating
+      // wait after they have been read.
+      async_cancel_wait(dispatcher, &wait_);
+      wait_is_repeating_ = false;
+      status = async_begin_wait(dispatcher, &wait_);
+    } else {
+      status = BeginWait(dispatcher);
+    }
     if (status != ZX_OK) {
       NotifyError(status);
     }
@@ -200,15 +293,50 @@ void MessageReader::OnHandleReady(async_dispatcher_t* dispatcher,
   NotifyError(ZX_ERR_PEER_CLOSED);
 }
 
-zx_status_t MessageReader::ReadAndDispatchMessage(MessageBuffer* buffer) {
-  Message message = buffer->CreateEmptyMessage();
+zx_status_t MessageReader::BeginWait(async_dispatcher_t* dispatcher) {
+  if (use_repeating_wait_) {
+    zx_status_t status = async_begin_repeating_wait(dispatcher, &wait_);
+    if (status != ZX_ERR_NOT_SUPPORTED) {
+      wait_is_repeating_ = status == ZX_OK;
+      return status;
+    }
+  }
+  wait_is_repeating_ = false;
+  return async_begin_wait(dispatcher, &wait_);
+}
+
+zx_status_t MessageReader::ReadAndDispatchMessage() {
+  TRACE_DURATION("fidl", "fidl::MessageReader::ReadAndDispatchMessage");
+  // Try a small buffer on the stack first. A message that does not fit is left
+  // in the channel, and we read it again into a buffer from the pool.
+  zx::time read_start;
+  if (stats_)
+    read_start = zx::clock::get_monotonic();
+  uint8_t bytes[FIDL_MESSAGE_INLINE_READ_BYTES];
+  zx_handle_t handles[ZX_CHANNEL_MAX_MSG_HANDLES];
+  Message message(BytePart(bytes, sizeof(bytes)),
+                  HandlePart(handles, ZX_CHANNEL_MAX_MSG_HANDLES));
   zx_status_t status = message.Read(channel_.get(), 0);
+  if (status == ZX_ERR_BUFFER_TOO_SMALL) {
+    MessageBuffer buffer(MessageBufferPool::GetForCurrentThread());
+    Message large_message = buffer.CreateEmptyMessage();
+    status = large_message.Read(channel_.get(), 0);
+    return DispatchMessage(status, std::move(large_message), read_start);
+  }
+  return DispatchMessage(status, std::move(message), read_start);
+}
+
+zx_status_t MessageReader::DispatchMessage(zx_status_t status,
+                                           Message message,
+                                           zx::time read_start) {
   if (status == ZX_ERR_SHOULD_WAIT)
     return status;
   if (status != ZX_OK) {
     NotifyError(status);
     return status;
   }
+  if (capture_)
+    capture_->Record(MessageCapture::kRead, message);
 
   if (message.has_header() && message.ordinal() == FIDL_EPITAPH_ORDINAL) {
     // This indicates the message is an epitaph, and that any epitaph-friendly
@@ -228,10 +356,21 @@ zx_status_t MessageReader::ReadAndDispatchMessage(MessageBuffer* buffer) {
 
   if (!message_handler_)
     return ZX_OK;
+  DispatchStats* stats = stats_;
+  uint32_t ordinal = 0u;
+  zx::time dispatch_start;
+  if (stats) {
+    ordinal = message.has_header() ? message.ordinal() : 0u;
+    dispatch_start = zx::clock::get_monotonic();
+  }
   Canary canary(&should_stop_);
   status = message_handler_->OnMessage(std::move(message));
   if (canary.should_stop())
     return ZX_ERR_STOP;
+  if (stats) {
+    stats->RecordMessage(ordinal, (dispatch_start - read_start).get(),
+                         (zx::clock::get_monotonic() - dispatch_start).get());
+  }
   if (status != ZX_OK)
     NotifyError(status);
   return status;
@@ -250,11 +389,67 @@ zx_status_t MessageReader::Close(zx_status_t epitaph_value) {
   return ZX_OK;
 }
 
+void MessageReader::CloseMany(MessageReader* const* readers, size_t count,
+                              bool send_epitaph, zx_status_t epitaph_value) {
+  // Large enough to amortize the calls, small enough for the stack.
+  constexpr size_t kBatchSize = 64u;
+  async_wait_t* waits[kBatchSize];
+  zx_handle_t handles[kBatchSize];
+  MessageReader* batch[kBatchSize];
+
+  size_t next = 0u;
+  while (next < count) {
+    // Gather bound readers sharing a dispatcher, which is usually all of them.
+    size_t batch_count = 0u;
+    async_dispatcher_t* dispatcher = nullptr;
+    for (; next < count && batch_count < kBatchSize; ++next) {
+      MessageReader* reader = readers[next];
+      if (!reader->is_bound())
+        continue;
+      if (batch_count > 0u && reader->dispatcher_ != dispatcher)
+        break;
+      dispatcher = reader->dispatcher_;
+      if (send_epitaph)
+        fidl_epitaph_write(reader->channel_.get(), epitaph_value);
+      reader->Stop();
+      waits[batch_count] = &reader->wait_;
+      batch[batch_count] = reader;
+      ++batch_count;
+    }
+    if (batch_count == 0u)
+      break;
+
+    // The waits must be canceled while their channels are still open.
+    async_cancel_waits(dispatcher, waits, batch_count, nullptr);
+
+    for (size_t i = 0u; i < batch_count; ++i) {
+      MessageReader* reader = batch[i];
+      reader->wait_.object = ZX_HANDLE_INVALID;
+      reader->wait_is_repeating_ = false;
+      reader->dispatcher_ = nullptr;
+      // As in |Unbind|, the handler hears about the channel going away while
+      // the channel is still there.
+      if (reader->message_handler_)
+        reader->message_handler_->OnChannelGone();
+      // The channel is closed, so there is no deferred error signal to clear.
+      reader->deferred_error_.store(ZX_OK);
+      handles[i] = reader->channel_.release();
+    }
+    zx_handle_close_many(handles, batch_count);
+  }
+}
+
+void MessageReader::DeferError(zx_status_t status) {
+  ZX_DEBUG_ASSERT(status != ZX_OK);
+  zx_status_t expected = ZX_OK;
+  if (deferred_error_.compare_exchange_strong(expected, status))
+    channel_.signal(0, kDeferredErrorSignal);
+}
+
 void MessageReader::NotifyError(zx_status_t epitaph_value) {
   Unbind();
-  if (error_handler_) {
-    error_handler_(epitaph_value);
-  }
+  if (error_callback_)
+    error_callback_(error_context_, epitaph_value);
 }
 
 void MessageReader::Stop() {
@@ -7,6 +7,7 @@
 #include "lib/fidl/cpp/internal/logging.h"
 #include "lib/fidl/cpp/internal/stub_controller.h"
 #include "lib/fidl/cpp/internal/weak_stub_controller.h"
+#include "lib/fidl/cpp/send_validation.h"
 
 namespace fidl {
 namespace internal {
@@ -59,18 +60,22 @@ PendingResponse& PendingResponse::operator=(PendingResponse&& other) {
 zx_status_t PendingResponse::Send(const fidl_type_t* type, Message message) {
   if (!weak_controller_)
     return ZX_ERR_BAD_STATE;
-  StubController* controller = weak_controller_->controller();
+  // Replies can be sent from any thread, so keep the controller and its
+  // channel alive until the message has been written.
+  WeakStubController::Use use(weak_controller_);
+  StubController* controller = use.controller();
   if (!controller)
     return ZX_ERR_BAD_STATE;
   message.set_txid(txid_);
-  const char* error_msg = nullptr;
-  zx_status_t status = message.Validate(type, &error_msg);
-  if (status != ZX_OK) {
-    FIDL_REPORT_ENCODING_ERROR(message, type, error_msg);
-    return status;
+  if (ShouldValidateSend()) {
+    const char* error_msg = nullptr;
+    zx_status_t status = message.Validate(type, &error_msg);
+    if (status != ZX_OK) {
+      FIDL_REPORT_ENCODING_ERROR(message, type, error_msg);
+      return status;
+    }
   }
-  zx_handle_t channel = controller->reader().channel().get();
-  return message.Write(channel, 0);
+  return controller->WriteReply(std::move(message));
 }
 
 }  // namespace internal
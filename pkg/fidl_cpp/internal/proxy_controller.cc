@@ -4,36 +4,65 @@
 
 #include "lib/fidl/cpp/internal/proxy_controller.h"
 
+#include <trace/event.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
 #include <utility>
 
 #include "lib/fidl/cpp/internal/logging.h"
+#include "lib/fidl/cpp/send_validation.h"
 
 namespace fidl {
 namespace internal {
 namespace {
 
-constexpr uint32_t kUserspaceTxidMask = 0x7FFFFFFF;
+// Userspace transaction identifiers have the high bit clear. The remaining
+// bits hold a slot index in the low |kTxidSlotBits| and the slot's generation
+// above them. Generations are never zero, so neither is a txid.
+constexpr uint32_t kTxidSlotBits = 20;
+constexpr uint32_t kTxidSlotMask = (1u << kTxidSlotBits) - 1;
+constexpr uint32_t kTxidGenerationMask = 0x7FFFFFFF >> kTxidSlotBits;
 
 }  // namespace
 
-ProxyController::ProxyController() : reader_(this), next_txid_(1) {}
+// See the size of |MessageReader| in message_reader.cc.
+static_assert(sizeof(void*) != 8 || sizeof(ProxyController) <= 192,
+              "ProxyController must stay within 192 bytes on 64-bit targets");
+
+ProxyController::ProxyController() : reader_(this) {}
+
+ProxyController::SendQueue::SendQueue(ProxyController* controller)
+    : writable_wait{{{ASYNC_STATE_INIT},
+                     &ProxyController::OnWritable,
+                     ZX_HANDLE_INVALID,
+                     ZX_CHANNEL_WRITABLE | ZX_CHANNEL_PEER_CLOSED},
+                    controller} {}
 
-ProxyController::~ProxyController() = default;
+ProxyController::~ProxyController() { CancelWritableWait(); }
 
 ProxyController::ProxyController(ProxyController&& other)
-    : reader_(this),
-      handlers_(std::move(other.handlers_)),
-      next_txid_(other.next_txid_) {
-  reader_.TakeChannelAndErrorHandlerFrom(&other.reader());
-  other.Reset();
+    : ProxyController() {
+  *this = std::move(other);
 }
 
 ProxyController& ProxyController::operator=(ProxyController&& other) {
   if (this != &other) {
+    CancelWritableWait();
+    const bool was_waiting =
+        other.send_queue_ && other.send_queue_->writable_wait_dispatcher;
+    other.CancelWritableWait();
     reader_.TakeChannelAndErrorHandlerFrom(&other.reader());
     handlers_ = std::move(other.handlers_);
-    next_txid_ = other.next_txid_;
+    free_slots_ = std::move(other.free_slots_);
+    max_in_flight_calls_ = other.max_in_flight_calls_;
+    in_flight_calls_ = other.in_flight_calls_;
+    send_queue_ = std::move(other.send_queue_);
+    if (send_queue_)
+      send_queue_->writable_wait.controller = this;
     other.Reset();
+    if (was_waiting)
+      BeginWritableWait();
   }
   return *this;
 }
@@ -41,29 +70,213 @@ ProxyController& ProxyController::operator=(ProxyController&& other) {
 zx_status_t ProxyController::Send(
     const fidl_type_t* type, Message message,
     std::unique_ptr<MessageHandler> response_handler) {
-  zx_txid_t txid = 0;
-  if (response_handler) {
-    txid = next_txid_++ & kUserspaceTxidMask;
-    while (!txid || handlers_.find(txid) != handlers_.end())
-      txid = next_txid_++ & kUserspaceTxidMask;
+  if (!response_handler)
+    return SendWithTxid(type, std::move(message), 0u);
+  // A unique_ptr fits in the inline storage of a |ResponseHandler|.
+  return SendWithResponseHandler(
+      type, std::move(message),
+      [handler = std::move(response_handler)](Message response) {
+        return handler->OnMessage(std::move(response));
+      });
+}
+
+zx_status_t ProxyController::SendWithResponseHandler(
+    const fidl_type_t* type, Message message,
+    ResponseHandler response_handler) {
+  ZX_DEBUG_ASSERT(response_handler);
+  zx_txid_t txid = AddPendingHandler(std::move(response_handler));
+  if (!txid)
+    return ZX_ERR_NO_RESOURCES;
+  return SendWithTxid(type, std::move(message), txid);
+}
+
+zx_status_t ProxyController::SendWithTxid(const fidl_type_t* type,
+                                          Message message, zx_txid_t txid) {
+  TRACE_DURATION("fidl", "fidl::ProxyController::Send");
+  if (txid) {
     message.set_txid(txid);
+    // The flow id is only generated if the category is enabled.
+    TRACE_FLOW_BEGIN("fidl", "fidl::Call", BeginFlow(txid), "ordinal",
+                     message.ordinal());
   }
-  const char* error_msg = nullptr;
-  zx_status_t status = message.Validate(type, &error_msg);
-  if (status != ZX_OK) {
-    FIDL_REPORT_ENCODING_ERROR(message, type, error_msg);
-    return status;
+  if (ShouldValidateSend()) {
+    const char* error_msg = nullptr;
+    zx_status_t status = message.Validate(type, &error_msg);
+    if (status != ZX_OK) {
+      FIDL_REPORT_ENCODING_ERROR(message, type, error_msg);
+      if (txid)
+        TakePendingHandler(txid);
+      return status;
+    }
+  }
+  return WriteWithTxid(type, std::move(message), txid);
+}
+
+zx_status_t ProxyController::SendValidated(const fidl_type_t* type,
+                                           Message message) {
+  return WriteWithTxid(type, std::move(message), 0u);
+}
+
+zx_status_t ProxyController::WriteWithTxid(const fidl_type_t* type,
+                                           Message message, zx_txid_t txid) {
+  if (max_in_flight_calls_) {
+    // A message that carries handles cannot be retried after
+    // |ZX_ERR_SHOULD_WAIT|, because the write consumes its handles, so check
+    // that the channel is writable first.
+    if (MustQueue(txid)) {
+      Enqueue(&message, txid);
+      return ZX_OK;
+    }
+    if (message.handles().actual() && !IsWritable()) {
+      Enqueue(&message, txid);
+      return BeginWritableWait();
+    }
+  }
+  const uint32_t num_handles = message.handles().actual();
+  // The write consumes the handles, so their types are looked up first, but
+  // the message is recorded only once it has been written. A message that is
+  // queued instead is recorded when the queue is flushed.
+  MessageCapture* capture = reader_.message_capture();
+  MessageCapture::HandleTypes handle_types;
+  if (capture) {
+    MessageCapture::GetHandleTypes(message.handles().data(), num_handles,
+                                   &handle_types);
+  }
+  zx_status_t status = message.Write(reader_.channel().get(), 0);
+  if (status == ZX_ERR_SHOULD_WAIT && max_in_flight_calls_ && !num_handles) {
+    Enqueue(&message, txid);
+    return BeginWritableWait();
   }
-  status = message.Write(reader_.channel().get(), 0);
   if (status != ZX_OK) {
     FIDL_REPORT_CHANNEL_WRITING_ERROR(message, type, status);
+    if (txid)
+      TakePendingHandler(txid);
     return status;
   }
-  if (response_handler)
-    handlers_.emplace(txid, std::move(response_handler));
+  if (capture) {
+    capture->Record(MessageCapture::kWritten, message.bytes().data(),
+                    message.bytes().actual(), handle_types);
+  }
+  if (txid)
+    ++in_flight_calls_;
+  return ZX_OK;
+}
+
+ProxyController::QueuedMessage::QueuedMessage(Message* message,
+                                              zx_txid_t txid)
+    : bytes(message->bytes().data(),
+            message->bytes().data() + message->bytes().actual()),
+      handles(message->handles().data(),
+              message->handles().data() + message->handles().actual()),
+      txid(txid) {
+  // The queue owns the handles now.
+  message->ClearHandlesUnsafe();
+}
+
+ProxyController::QueuedMessage::~QueuedMessage() {
+  if (!handles.empty())
+    zx_handle_close_many(handles.data(), handles.size());
+}
+
+bool ProxyController::MustQueue(zx_txid_t txid) const {
+  if (send_queue_ && (!send_queue_->messages.empty() ||
+                      send_queue_->writable_wait_dispatcher))
+    return true;
+  return txid && in_flight_calls_ >= max_in_flight_calls_;
+}
+
+void ProxyController::Enqueue(Message* message, zx_txid_t txid) {
+  if (!send_queue_)
+    send_queue_ = std::make_unique<SendQueue>(this);
+  send_queue_->messages.emplace_back(message, txid);
+}
+
+zx_status_t ProxyController::FlushSendQueue() {
+  if (!send_queue_)
+    return ZX_OK;
+  std::deque<QueuedMessage>& queue = send_queue_->messages;
+  while (!queue.empty() && !send_queue_->writable_wait_dispatcher) {
+    QueuedMessage& message = queue.front();
+    if (message.txid && in_flight_calls_ >= max_in_flight_calls_)
+      return ZX_OK;
+    if (!message.handles.empty() && !IsWritable())
+      return BeginWritableWait();
+    const uint32_t num_handles = static_cast<uint32_t>(message.handles.size());
+    MessageCapture* capture = reader_.message_capture();
+    MessageCapture::HandleTypes handle_types;
+    if (capture) {
+      MessageCapture::GetHandleTypes(message.handles.data(), num_handles,
+                                     &handle_types);
+    }
+    zx_status_t status = zx_channel_write(
+        reader_.channel().get(), 0, message.bytes.data(),
+        static_cast<uint32_t>(message.bytes.size()), message.handles.data(),
+        num_handles);
+    if (status == ZX_ERR_SHOULD_WAIT && !num_handles)
+      return BeginWritableWait();
+    if (capture && status == ZX_OK) {
+      capture->Record(MessageCapture::kWritten, message.bytes.data(),
+                      static_cast<uint32_t>(message.bytes.size()),
+                      handle_types);
+    }
+    // The write consumed the handles, whether or not it succeeded.
+    message.handles.clear();
+    const zx_txid_t txid = message.txid;
+    queue.pop_front();
+    if (status != ZX_OK) {
+      if (txid)
+        TakePendingHandler(txid);
+      return status;
+    }
+    if (txid)
+      ++in_flight_calls_;
+  }
   return ZX_OK;
 }
 
+bool ProxyController::IsWritable() const {
+  zx_signals_t pending = ZX_SIGNAL_NONE;
+  reader_.channel().wait_one(ZX_CHANNEL_WRITABLE, zx::time(), &pending);
+  return pending & ZX_CHANNEL_WRITABLE;
+}
+
+zx_status_t ProxyController::BeginWritableWait() {
+  // Only messages in the queue are waited for.
+  ZX_DEBUG_ASSERT(send_queue_);
+  if (send_queue_->writable_wait_dispatcher)
+    return ZX_OK;
+  async_dispatcher_t* dispatcher = reader_.dispatcher();
+  if (!dispatcher)
+    return ZX_ERR_BAD_STATE;
+  send_queue_->writable_wait.object = reader_.channel().get();
+  zx_status_t status =
+      async_begin_wait(dispatcher, &send_queue_->writable_wait);
+  if (status == ZX_OK)
+    send_queue_->writable_wait_dispatcher = dispatcher;
+  return status;
+}
+
+void ProxyController::CancelWritableWait() {
+  if (!send_queue_ || !send_queue_->writable_wait_dispatcher)
+    return;
+  async_cancel_wait(send_queue_->writable_wait_dispatcher,
+                    &send_queue_->writable_wait);
+  send_queue_->writable_wait_dispatcher = nullptr;
+}
+
+void ProxyController::OnWritable(async_dispatcher_t* dispatcher,
+                                 async_wait_t* wait, zx_status_t status,
+                                 const zx_packet_signal_t* signal) {
+  ProxyController* controller = static_cast<WritableWait*>(wait)->controller;
+  controller->send_queue_->writable_wait_dispatcher = nullptr;
+  if (status == ZX_OK)
+    status = controller->FlushSendQueue();
+  // Report the error the same way a failed read would be reported, from the
+  // reader's own wakeup.
+  if (status != ZX_OK && controller->reader_.is_bound())
+    controller->reader_.DeferError(status);
+}
+
 void ProxyController::Reset() {
   reader_.Reset();
   ClearPendingHandlers();
@@ -78,19 +291,72 @@ zx_status_t ProxyController::OnMessage(Message message) {
       return ZX_ERR_NOT_SUPPORTED;
     return proxy_->Dispatch_(std::move(message));
   }
-  auto it = handlers_.find(txid);
-  if (it == handlers_.end())
+  uint64_t flow_id = 0u;
+  ResponseHandler handler = TakePendingHandler(txid, &flow_id);
+  if (!handler)
     return ZX_ERR_NOT_FOUND;
-  std::unique_ptr<MessageHandler> handler = std::move(it->second);
-  handlers_.erase(it);
-  return handler->OnMessage(std::move(message));
+  if (flow_id)
+    TRACE_FLOW_END("fidl", "fidl::Call", flow_id);
+  if (in_flight_calls_)
+    --in_flight_calls_;
+  // Write the calls that were waiting for this one to finish before running
+  // the handler, which might destroy this object.
+  if (send_queue_ && !send_queue_->messages.empty()) {
+    zx_status_t status = FlushSendQueue();
+    if (status != ZX_OK)
+      return status;
+  }
+  return handler(std::move(message));
 }
 
 void ProxyController::OnChannelGone() { ClearPendingHandlers(); }
 
 void ProxyController::ClearPendingHandlers() {
+  CancelWritableWait();
+  send_queue_.reset();
+  in_flight_calls_ = 0u;
   handlers_.clear();
-  next_txid_ = 1;
+  free_slots_.clear();
+}
+
+zx_txid_t ProxyController::AddPendingHandler(ResponseHandler handler) {
+  uint32_t slot;
+  if (!free_slots_.empty()) {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  } else if (handlers_.size() <= kTxidSlotMask) {
+    slot = static_cast<uint32_t>(handlers_.size());
+    handlers_.emplace_back();
+  } else {
+    return 0u;
+  }
+  PendingHandler& pending = handlers_[slot];
+  pending.handler = std::move(handler);
+  return (pending.generation << kTxidSlotBits) | slot;
+}
+
+ProxyController::ResponseHandler ProxyController::TakePendingHandler(
+    zx_txid_t txid, uint64_t* flow_id) {
+  uint32_t slot = txid & kTxidSlotMask;
+  if (slot >= handlers_.size())
+    return nullptr;
+  PendingHandler& pending = handlers_[slot];
+  if (!pending.handler || pending.generation != txid >> kTxidSlotBits)
+    return nullptr;
+  if (flow_id)
+    *flow_id = pending.flow_id;
+  pending.flow_id = 0u;
+  ResponseHandler handler = std::move(pending.handler);
+  pending.generation =
+      pending.generation == kTxidGenerationMask ? 1u : pending.generation + 1;
+  free_slots_.push_back(slot);
+  return handler;
+}
+
+uint64_t ProxyController::BeginFlow(zx_txid_t txid) {
+  uint64_t flow_id = TRACE_NONCE();
+  handlers_[txid & kTxidSlotMask].flow_id = flow_id;
+  return flow_id;
 }
 
 }  // namespace internal
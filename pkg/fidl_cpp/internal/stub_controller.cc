@@ -4,25 +4,165 @@
 
 #include "lib/fidl/cpp/internal/stub_controller.h"
 
+#include <lib/async/task.h>
+#include <lib/async/time.h>
+#include <lib/fidl/cpp/message_buffer.h>
+#include <string.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
 #include "lib/fidl/cpp/internal/logging.h"
 #include "lib/fidl/cpp/internal/pending_response.h"
 #include "lib/fidl/cpp/internal/weak_stub_controller.h"
+#include "lib/fidl/cpp/send_validation.h"
 
 namespace fidl {
 namespace internal {
+namespace {
+
+// A message copied out of the |MessageReader|'s buffer so that it can be
+// dispatched from a task on another thread.
+class ConcurrentMessage : public async_task_t {
+ public:
+  ConcurrentMessage(Message* message, WeakStubController* weak)
+      : async_task_t{{ASYNC_STATE_INIT}, &ConcurrentMessage::Handler, 0, 0},
+        buffer_(message->bytes().actual(), message->handles().actual()),
+        message_(buffer_.CreateEmptyMessage()),
+        weak_(weak) {
+    memcpy(message_.bytes().data(), message->bytes().data(),
+           message->bytes().actual());
+    message_.bytes().set_actual(message->bytes().actual());
+    memcpy(message_.handles().data(), message->handles().data(),
+           message->handles().actual() * sizeof(zx_handle_t));
+    message_.handles().set_actual(message->handles().actual());
+    message->ClearHandlesUnsafe();
+    weak_->AddRef();
+  }
+
+  ~ConcurrentMessage() { weak_->Release(); }
+
+ private:
+  static void Handler(async_dispatcher_t* dispatcher, async_task_t* task,
+                      zx_status_t status) {
+    std::unique_ptr<ConcurrentMessage> self(
+        static_cast<ConcurrentMessage*>(task));
+    if (status == ZX_OK)
+      self->Dispatch();
+  }
+
+  void Dispatch() {
+    zx_status_t status;
+    {
+      WeakStubController::Use use(weak_);
+      StubController* controller = use.controller();
+      if (!controller)
+        return;
+      zx_txid_t txid = message_.txid();
+      status = controller->stub()->Dispatch_(
+          std::move(message_), PendingResponse(txid, txid ? weak_ : nullptr));
+    }
+    if (status == ZX_OK)
+      return;
+    // The implementation might have unbound or destroyed the controller while
+    // handling the message, so look it up again before reporting the error.
+    WeakStubController::Use use(weak_);
+    if (StubController* controller = use.controller())
+      controller->reader().DeferError(status);
+  }
+
+  MessageBuffer buffer_;
+  Message message_;
+  WeakStubController* const weak_;
+};
+
+}  // namespace
+
+// See the size of |MessageReader| in message_reader.cc.
+static_assert(sizeof(void*) != 8 || sizeof(StubController) <= 160,
+              "StubController must stay within 160 bytes on 64-bit targets");
 
 StubController::StubController() : weak_(nullptr), reader_(this) {}
 
-StubController::~StubController() { InvalidateWeakIfNeeded(); }
+StubController::~StubController() {
+  DiscardBatch();
+  InvalidateWeakIfNeeded();
+}
 
 zx_status_t StubController::Send(const fidl_type_t* type, Message message) {
-  const char* error_msg = nullptr;
-  zx_status_t status = message.Validate(type, &error_msg);
-  if (status != ZX_OK) {
-    FIDL_REPORT_ENCODING_ERROR(message, type, error_msg);
-    return status;
+  if (ShouldValidateSend()) {
+    const char* error_msg = nullptr;
+    zx_status_t status = message.Validate(type, &error_msg);
+    if (status != ZX_OK) {
+      FIDL_REPORT_ENCODING_ERROR(message, type, error_msg);
+      return status;
+    }
+  }
+  return Write(std::move(message));
+}
+
+zx_status_t StubController::Write(Message message) {
+  if (!batch_depth_)
+    return message.Write(reader_.channel().get(), 0);
+  const BytePart& bytes = message.bytes();
+  const HandlePart& handles = message.handles();
+  batch_->messages.push_back(BatchedMessage{bytes.actual(), handles.actual()});
+  batch_->bytes.insert(batch_->bytes.end(), bytes.data(),
+                       bytes.data() + bytes.actual());
+  batch_->handles.insert(batch_->handles.end(), handles.data(),
+                         handles.data() + handles.actual());
+  message.ClearHandlesUnsafe();
+  return ZX_OK;
+}
+
+zx_status_t StubController::WriteReply(Message message) {
+  // Batches belong to the controller's thread, which concurrent replies may
+  // not be sent from.
+  if (concurrent_dispatcher_)
+    return message.Write(reader_.channel().get(), 0);
+  return Write(std::move(message));
+}
+
+zx_status_t StubController::EndBatch() {
+  ZX_DEBUG_ASSERT(batch_depth_ > 0u);
+  if (--batch_depth_)
+    return ZX_OK;
+  return FlushBatch();
+}
+
+zx_status_t StubController::FlushBatch() {
+  if (!reader_.is_bound()) {
+    DiscardBatch();
+    return ZX_ERR_BAD_STATE;
+  }
+  zx_handle_t channel = reader_.channel().get();
+  zx_status_t result = ZX_OK;
+  const uint8_t* bytes = batch_->bytes.data();
+  const zx_handle_t* handles = batch_->handles.data();
+  for (const BatchedMessage& message : batch_->messages) {
+    // The handles are consumed by the write whether or not it succeeds.
+    if (result == ZX_OK) {
+      result = zx_channel_write(channel, 0, bytes, message.num_bytes, handles,
+                                message.num_handles);
+    } else if (message.num_handles) {
+      zx_handle_close_many(handles, message.num_handles);
+    }
+    bytes += message.num_bytes;
+    handles += message.num_handles;
   }
-  return message.Write(reader_.channel().get(), 0);
+  batch_->messages.clear();
+  batch_->bytes.clear();
+  batch_->handles.clear();
+  return result;
+}
+
+void StubController::DiscardBatch() {
+  if (!batch_)
+    return;
+  if (!batch_->handles.empty())
+    zx_handle_close_many(batch_->handles.data(), batch_->handles.size());
+  batch_->messages.clear();
+  batch_->bytes.clear();
+  batch_->handles.clear();
 }
 
 zx_status_t StubController::OnMessage(Message message) {
@@ -30,15 +170,35 @@ zx_status_t StubController::OnMessage(Message message) {
     return ZX_ERR_INVALID_ARGS;
   zx_txid_t txid = message.txid();
   WeakStubController* weak = nullptr;
-  if (txid) {
+  if (txid || concurrent_dispatcher_) {
     if (!weak_)
       weak_ = new WeakStubController(this);
     weak = weak_;
   }
+  if (concurrent_dispatcher_)
+    return PostMessage(std::move(message), weak);
   return stub_->Dispatch_(std::move(message), PendingResponse(txid, weak));
 }
 
-void StubController::OnChannelGone() { InvalidateWeakIfNeeded(); }
+zx_status_t StubController::PostMessage(Message message,
+                                        WeakStubController* weak) {
+  // Set once, before the first message is posted: the worker threads read
+  // the flag while later messages arrive, so it must not be written again.
+  if (!weak->is_thread_safe())
+    weak->set_thread_safe();
+  auto task = std::make_unique<ConcurrentMessage>(&message, weak);
+  task->deadline = async_now(concurrent_dispatcher_);
+  zx_status_t status = async_post_task(concurrent_dispatcher_, task.get());
+  if (status != ZX_OK)
+    return status;
+  task.release();
+  return ZX_OK;
+}
+
+void StubController::OnChannelGone() {
+  DiscardBatch();
+  InvalidateWeakIfNeeded();
+}
 
 void StubController::InvalidateWeakIfNeeded() {
   if (!weak_)
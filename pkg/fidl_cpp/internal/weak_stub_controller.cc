@@ -6,20 +6,89 @@
 
 namespace fidl {
 namespace internal {
+namespace {
+
+// The most recent |Use| created on this thread. Each |Use| links to the one
+// before it, so |Invalidate| can tell which uses belong to its caller.
+thread_local WeakStubController::Use* g_current_use = nullptr;
+
+}  // namespace
 
 WeakStubController::WeakStubController(StubController* controller)
-    : ref_count_(1u), controller_(controller) {}
+    : ref_count_(1u), controller_(controller), use_count_(0u) {}
 
 WeakStubController::~WeakStubController() = default;
 
-void WeakStubController::AddRef() { ++ref_count_; }
+// Without |thread_safe_|, the reference count is only touched by one thread,
+// so relaxed loads and stores suffice and compile to plain memory accesses.
+
+void WeakStubController::AddRef() {
+  if (thread_safe_) {
+    ref_count_.fetch_add(1u, std::memory_order_relaxed);
+  } else {
+    ref_count_.store(ref_count_.load(std::memory_order_relaxed) + 1u,
+                     std::memory_order_relaxed);
+  }
+}
 
 void WeakStubController::Release() {
-  if (--ref_count_ == 0)
+  uint32_t previous;
+  if (thread_safe_) {
+    previous = ref_count_.fetch_sub(1u, std::memory_order_acq_rel);
+  } else {
+    previous = ref_count_.load(std::memory_order_relaxed);
+    ref_count_.store(previous - 1u, std::memory_order_relaxed);
+  }
+  if (previous == 1u)
     delete this;
 }
 
-void WeakStubController::Invalidate() { controller_ = nullptr; }
+void WeakStubController::Invalidate() {
+  if (!thread_safe_) {
+    controller_ = nullptr;
+    return;
+  }
+  const uint32_t own_uses = CountUsesOnCurrentThread();
+  std::unique_lock<std::mutex> lock(mutex_);
+  controller_ = nullptr;
+  uses_done_.wait(lock, [this, own_uses] { return use_count_ <= own_uses; });
+}
+
+uint32_t WeakStubController::CountUsesOnCurrentThread() const {
+  uint32_t count = 0u;
+  for (const Use* use = g_current_use; use; use = use->previous_) {
+    if (use->weak_ == this && use->controller_)
+      ++count;
+  }
+  return count;
+}
+
+WeakStubController::Use::Use(WeakStubController* weak)
+    : weak_(weak),
+      counted_(weak->thread_safe_),
+      controller_([weak] {
+        if (!weak->thread_safe_)
+          return weak->controller_;
+        std::lock_guard<std::mutex> lock(weak->mutex_);
+        if (weak->controller_)
+          ++weak->use_count_;
+        return weak->controller_;
+      }()),
+      previous_(counted_ ? g_current_use : nullptr) {
+  if (counted_)
+    g_current_use = this;
+}
+
+WeakStubController::Use::~Use() {
+  if (!counted_)
+    return;
+  g_current_use = previous_;
+  if (!controller_)
+    return;
+  std::lock_guard<std::mutex> lock(weak_->mutex_);
+  --weak_->use_count_;
+  weak_->uses_done_.notify_all();
+}
 
 }  // namespace internal
 }  // namespace fidl
@@ -0,0 +1,99 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/message_capture.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+
+namespace fidl {
+namespace {
+
+// Records are written once this much is buffered.
+constexpr size_t kFlushThreshold = 64u * 1024u;
+
+constexpr size_t kAlignment = 8u;
+
+}  // namespace
+
+MessageCapture::MessageCapture(int fd) : fd_(fd) {
+  buffer_.reserve(kFlushThreshold);
+  MessageCaptureHeader header = {MessageCaptureHeader::kMagic,
+                                 MessageCaptureHeader::kVersion, 0u};
+  Append(&header, sizeof(header));
+}
+
+MessageCapture::~MessageCapture() {
+  Flush();
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+std::unique_ptr<MessageCapture> MessageCapture::Create(const char* path) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return nullptr;
+  return std::make_unique<MessageCapture>(fd);
+}
+
+void MessageCapture::GetHandleTypes(const zx_handle_t* handles,
+                                    uint32_t num_handles,
+                                    HandleTypes* handle_types) {
+  ZX_DEBUG_ASSERT(num_handles <= ZX_CHANNEL_MAX_MSG_HANDLES);
+  handle_types->count = num_handles;
+  for (uint32_t i = 0u; i < num_handles; ++i) {
+    zx_info_handle_basic_t info;
+    handle_types->types[i] = ZX_OBJ_TYPE_NONE;
+    if (zx_object_get_info(handles[i], ZX_INFO_HANDLE_BASIC, &info,
+                           sizeof(info), nullptr, nullptr) == ZX_OK)
+      handle_types->types[i] = info.type;
+  }
+}
+
+void MessageCapture::Record(Direction direction, const uint8_t* bytes,
+                            uint32_t num_bytes,
+                            const HandleTypes& handle_types) {
+  if (status_ != ZX_OK)
+    return;
+  zx::time now = zx::clock::get_monotonic();
+  if (message_count_++ == 0u)
+    start_ = now;
+
+  MessageCaptureRecord record = {static_cast<uint64_t>((now - start_).get()),
+                                 direction, num_bytes, handle_types.count, 0u};
+  Append(&record, sizeof(record));
+  Append(bytes, num_bytes);
+  Append(handle_types.types, handle_types.count * sizeof(uint32_t));
+  if (buffer_.size() >= kFlushThreshold)
+    Flush();
+}
+
+// Appends |size| bytes and pads them to |kAlignment|.
+void MessageCapture::Append(const void* data, size_t size) {
+  const uint8_t* begin = static_cast<const uint8_t*>(data);
+  buffer_.insert(buffer_.end(), begin, begin + size);
+  buffer_.resize((buffer_.size() + kAlignment - 1) & ~(kAlignment - 1));
+}
+
+zx_status_t MessageCapture::Flush() {
+  size_t written = 0u;
+  while (status_ == ZX_OK && written < buffer_.size()) {
+    ssize_t result = write(fd_, buffer_.data() + written,
+                           buffer_.size() - written);
+    if (result < 0) {
+      if (errno != EINTR)
+        status_ = ZX_ERR_IO;
+      continue;
+    }
+    written += result;
+  }
+  buffer_.clear();
+  return status_;
+}
+
+}  // namespace fidl
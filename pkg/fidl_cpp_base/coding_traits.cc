@@ -4,6 +4,8 @@
 
 #include "lib/fidl/cpp/coding_traits.h"
 
+#include <algorithm>
+
 namespace fidl {
 
 void EncodeNullVector(Encoder* encoder, size_t offset) {
@@ -18,4 +20,82 @@ void EncodeVectorPointer(Encoder* encoder, size_t count, size_t offset) {
   vector->data = reinterpret_cast<void*>(FIDL_ALLOC_PRESENT);
 }
 
+namespace {
+
+// Eight bools on the wire. Fuchsia targets are little-endian, so element |i|
+// of a group is byte |i| of its word.
+constexpr uint64_t kAllTrue = 0x0101010101010101u;
+constexpr size_t kGroupSize = sizeof(uint64_t);
+
+}  // namespace
+
+void CodingTraits<VectorPtr<bool>>::Encode(Encoder* encoder,
+                                           VectorPtr<bool>* value,
+                                           size_t offset) {
+  if (value->is_null())
+    return EncodeNullVector(encoder, offset);
+  const std::vector<bool>& bits = **value;
+  size_t count = bits.size();
+  EncodeVectorPointer(encoder, count, offset);
+  uint8_t* bytes = encoder->GetPtr<uint8_t>(encoder->Alloc(count));
+
+  size_t i = 0u;
+  while (i < count) {
+    // Runs of equal flags, as in masks, are found with std::find, which libc++
+    // runs a storage word of |bits| at a time, and written with one memset.
+    const bool flag = bits[i];
+    const size_t run_end =
+        std::find(bits.begin() + i, bits.end(), !flag) - bits.begin();
+    if (run_end - i >= kGroupSize) {
+      memset(bytes + i, flag, run_end - i);
+      i = run_end;
+      continue;
+    }
+    // Other groups are read element by element, as std::vector<bool> offers
+    // no bulk conversion to bytes, and stored as one wire word.
+    if (i + kGroupSize > count) {
+      for (; i < count; ++i)
+        bytes[i] = bits[i];
+      break;
+    }
+    uint64_t word = 0u;
+    for (size_t j = 0u; j < kGroupSize; ++j)
+      word |= static_cast<uint64_t>(bits[i + j]) << (8u * j);
+    memcpy(bytes + i, &word, sizeof(word));
+    i += kGroupSize;
+  }
+}
+
+void CodingTraits<VectorPtr<bool>>::Decode(Decoder* decoder,
+                                           VectorPtr<bool>* value,
+                                           size_t offset) {
+  fidl_vector_t* encoded = decoder->GetPtr<fidl_vector_t>(offset);
+  if (!encoded->data) {
+    value->reset();
+    return;
+  }
+  size_t count = encoded->count;
+  const uint8_t* bytes = decoder->GetPtr<uint8_t>(
+      decoder->GetOffset(encoded->data));
+  value->resize(count);
+  std::vector<bool>& bits = **value;
+
+  size_t i = 0u;
+  for (; i + kGroupSize <= count; i += kGroupSize) {
+    uint64_t word;
+    memcpy(&word, bytes + i, sizeof(word));
+    // Runs of equal flags, as in masks, fill whole groups at once.
+    if (word == 0u || word == kAllTrue) {
+      std::fill(bits.begin() + i, bits.begin() + i + kGroupSize,
+                word != 0u);
+      continue;
+    }
+    // Mixed groups are written element by element.
+    for (size_t j = 0u; j < kGroupSize; ++j)
+      bits[i + j] = (word >> (8u * j)) & 0xffu;
+  }
+  for (; i < count; ++i)
+    bits[i] = bytes[i] != 0u;
+}
+
 }  // namespace fidl
@@ -10,17 +10,14 @@ namespace fidl {
 
 Decoder::Decoder(Message message) : message_(std::move(message)) {}
 
-Decoder::~Decoder() = default;
-
-size_t Decoder::GetOffset(void* ptr) {
-  return GetOffset(reinterpret_cast<uintptr_t>(ptr));
-}
-
-size_t Decoder::GetOffset(uintptr_t ptr) {
-  // The |ptr| value comes from the message buffer, which we've already
-  // validated. That means it should coorespond to a valid offset within the
-  // message.
-  return ptr - reinterpret_cast<uintptr_t>(message_.bytes().data());
+Decoder::~Decoder() {
+  // Materializing a table can link the tables nested in it, which are then
+  // materialized in turn.
+  while (lazy_tables_) {
+    internal::LazyTableLink* table = lazy_tables_;
+    table->OnDecoderDestroyed();
+    table->Unlink();
+  }
 }
 
 #ifdef __Fuchsia__
@@ -31,8 +28,28 @@ void Decoder::DecodeHandle(zx::object_base* value, size_t offset) {
 }
 #endif
 
-uint8_t* Decoder::InternalGetPtr(size_t offset) {
-  return message_.bytes().data() + offset;
+namespace internal {
+
+void LazyTableLink::Link(Decoder* decoder) {
+  if (decoder_) {
+    if (prev_) {
+      prev_->next_ = next_;
+    } else {
+      decoder_->lazy_tables_ = next_;
+    }
+    if (next_)
+      next_->prev_ = prev_;
+    prev_ = nullptr;
+    next_ = nullptr;
+  }
+  decoder_ = decoder;
+  if (decoder_) {
+    next_ = decoder_->lazy_tables_;
+    if (next_)
+      next_->prev_ = this;
+    decoder_->lazy_tables_ = this;
+  }
 }
 
+}  // namespace internal
 }  // namespace fidl
@@ -4,6 +4,8 @@
 
 #include "lib/fidl/cpp/encoder.h"
 
+#include <string.h>
+
 #include <zircon/assert.h>
 #include <zircon/fidl.h>
 
@@ -19,21 +21,76 @@ size_t Align(size_t size) {
 
 Encoder::Encoder(uint32_t ordinal) { EncodeMessageHeader(ordinal); }
 
+Encoder::Encoder(uint32_t ordinal, BytePart bytes, HandlePart handles)
+    : bytes_data_(bytes.data()),
+      bytes_capacity_(bytes.capacity()),
+      handles_data_(handles.data()),
+      handles_capacity_(handles.capacity()) {
+  EncodeMessageHeader(ordinal);
+}
+
+Encoder::Encoder(uint32_t ordinal, MessageBuffer* buffer)
+    : Encoder(ordinal, BytePart(buffer->bytes(), buffer->bytes_capacity()),
+              HandlePart(buffer->handles(), buffer->handles_capacity())) {}
+
 Encoder::~Encoder() = default;
 
 size_t Encoder::Alloc(size_t size) {
-  size_t offset = bytes_.size();
-  size_t new_size = bytes_.size() + Align(size);
+  size_t offset = bytes_size_;
+  size_t new_size = bytes_size_ + Align(size);
   ZX_ASSERT(new_size >= offset);
-  bytes_.resize(new_size);
+  if (new_size > bytes_capacity_)
+    MoveBytesToHeap(new_size > 2 * bytes_capacity_ ? new_size
+                                                   : 2 * bytes_capacity_);
+  if (is_on_heap()) {
+    heap_bytes_.resize(new_size);
+  } else {
+    memset(bytes_data_ + offset, 0, new_size - offset);
+  }
+  bytes_size_ = new_size;
   return offset;
 }
 
+void Encoder::Reserve(const EncodingSize& size) {
+  if (bytes_size_ + size.bytes > bytes_capacity_)
+    MoveBytesToHeap(bytes_size_ + size.bytes);
+  if (handles_size_ + size.handles > handles_capacity_)
+    MoveHandlesToHeap(handles_size_ + size.handles);
+}
+
+void Encoder::MoveBytesToHeap(size_t capacity) {
+  if (!is_on_heap()) {
+    heap_bytes_.reserve(capacity);
+    heap_bytes_.assign(bytes_data_, bytes_data_ + bytes_size_);
+  } else {
+    heap_bytes_.reserve(capacity);
+  }
+  bytes_data_ = heap_bytes_.data();
+  bytes_capacity_ = heap_bytes_.capacity();
+}
+
+void Encoder::MoveHandlesToHeap(size_t capacity) {
+  if (handles_data_ != heap_handles_.data()) {
+    heap_handles_.reserve(capacity);
+    heap_handles_.assign(handles_data_, handles_data_ + handles_size_);
+  } else {
+    heap_handles_.reserve(capacity);
+  }
+  handles_data_ = heap_handles_.data();
+  handles_capacity_ = heap_handles_.capacity();
+}
+
 #ifdef __Fuchsia__
 void Encoder::EncodeHandle(zx::object_base* value, size_t offset) {
   if (value->is_valid()) {
     *GetPtr<zx_handle_t>(offset) = FIDL_HANDLE_PRESENT;
-    handles_.push_back(value->release());
+    if (handles_size_ == handles_capacity_)
+      MoveHandlesToHeap(handles_capacity_ ? 2 * handles_capacity_ : 4u);
+    if (handles_data_ == heap_handles_.data())
+      heap_handles_.push_back(value->release());
+    else
+      handles_data_[handles_size_] = value->release();
+    ++handles_size_;
   } else {
     *GetPtr<zx_handle_t>(offset) = FIDL_HANDLE_ABSENT;
   }
@@ -41,16 +98,40 @@ void Encoder::EncodeHandle(zx::object_base* value, size_t offset) {
 #endif
 
 Message Encoder::GetMessage() {
-  return Message(BytePart(bytes_.data(), bytes_.size(), bytes_.size()),
-                 HandlePart(handles_.data(), handles_.size(), handles_.size()));
+  return Message(
+      BytePart(bytes_data_, static_cast<uint32_t>(bytes_capacity_),
+               static_cast<uint32_t>(bytes_size_)),
+      HandlePart(handles_data_, static_cast<uint32_t>(handles_capacity_),
+                 static_cast<uint32_t>(handles_size_)));
+}
+
+std::vector<uint8_t> Encoder::TakeBytes() {
+  std::vector<uint8_t> bytes;
+  if (is_on_heap()) {
+    heap_bytes_.resize(bytes_size_);
+    bytes = std::move(heap_bytes_);
+  } else {
+    bytes.assign(bytes_data_, bytes_data_ + bytes_size_);
+  }
+  heap_bytes_.clear();
+  bytes_data_ = heap_bytes_.data();
+  bytes_size_ = 0u;
+  bytes_capacity_ = heap_bytes_.capacity();
+  return bytes;
 }
 
 void Encoder::Reset(uint32_t ordinal) {
-  bytes_.clear();
-  handles_.clear();
+  Reset(NO_HEADER);
   EncodeMessageHeader(ordinal);
 }
 
+void Encoder::Reset(NoHeader) {
+  heap_bytes_.clear();
+  heap_handles_.clear();
+  bytes_size_ = 0u;
+  handles_size_ = 0u;
+}
+
 void Encoder::EncodeMessageHeader(uint32_t ordinal) {
   size_t offset = Alloc(sizeof(fidl_message_header_t));
   fidl_message_header_t* header = GetPtr<fidl_message_header_t>(offset);
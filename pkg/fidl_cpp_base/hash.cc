@@ -0,0 +1,45 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/hash.h"
+
+#include <string.h>
+
+namespace fidl {
+namespace internal {
+namespace {
+
+constexpr uint64_t kMultiplier = 0xc6a4a7935bd1e995ull;
+constexpr int kShift = 47;
+
+inline uint64_t Mix(uint64_t word) {
+  word *= kMultiplier;
+  word ^= word >> kShift;
+  return word * kMultiplier;
+}
+
+}  // namespace
+
+size_t HashBytes(const void* data, size_t size, size_t seed) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  uint64_t hash = seed ^ (size * kMultiplier);
+  for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, bytes, sizeof(word));
+    hash = (hash ^ Mix(word)) * kMultiplier;
+    bytes += sizeof(word);
+  }
+  if (size) {
+    uint64_t word = 0u;
+    memcpy(&word, bytes, size);
+    hash = (hash ^ word) * kMultiplier;
+  }
+  hash ^= hash >> kShift;
+  hash *= kMultiplier;
+  hash ^= hash >> kShift;
+  return static_cast<size_t>(hash);
+}
+
+}  // namespace internal
+}  // namespace fidl
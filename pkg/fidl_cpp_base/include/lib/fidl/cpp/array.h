@@ -50,12 +50,7 @@ class Array {
 
 template <typename T, size_t N>
 bool operator==(const Array<T, N>& lhs, const Array<T, N>& rhs) {
-  for (size_t i = 0; i < N; ++i) {
-    if (!Equals(lhs[i], rhs[i])) {
-      return false;
-    }
-  }
-  return true;
+  return internal::ElementsEqual(lhs, rhs, N, IsMemcmpCompatible<T>());
 }
 
 template <typename T, size_t N>
@@ -6,6 +6,7 @@
 #define LIB_FIDL_CPP_CLONE_H_
 
 #include <lib/fidl/cpp/array.h>
+#include <string.h>
 #include <zircon/assert.h>
 #include <memory>
 #include "lib/fidl/cpp/string.h"
@@ -34,6 +35,55 @@ CloneKernelObject(const zx::object<T>& object, zx::object<T>* result) {
 }  // namespace internal
 #endif  // __Fuchsia__
 
+namespace internal {
+
+// Whether |T| is a handle type whose objects can be duplicated.
+template <typename T, class Enable = void>
+struct IsDuplicableHandle : public std::false_type {};
+
+#ifdef __Fuchsia__
+template <typename T>
+struct IsDuplicableHandle<
+    T, typename std::enable_if<std::is_base_of<zx::object_base, T>::value &&
+                               zx::object_traits<T>::supports_duplication>::type>
+    : public std::true_type {};
+
+// Duplicates every handle in |value| before storing any of them in |result|.
+// If a duplication fails, the duplicates made so far are closed with a single
+// |zx_handle_close_many| and |result| is left untouched.
+template <typename T>
+zx_status_t CloneVectorElements(const std::vector<T>& value,
+                                VectorPtr<T>* result,
+                                std::true_type is_duplicable_handle) {
+  std::vector<zx_handle_t> duplicates(value.size(), ZX_HANDLE_INVALID);
+  for (size_t i = 0; i < value.size(); ++i) {
+    if (!value[i])
+      continue;
+    zx_status_t status = zx_handle_duplicate(
+        value[i].get(), ZX_RIGHT_SAME_RIGHTS, &duplicates[i]);
+    if (status != ZX_OK) {
+      zx_handle_close_many(duplicates.data(), i);
+      return status;
+    }
+  }
+  std::vector<T> clone;
+  clone.reserve(duplicates.size());
+  for (zx_handle_t handle : duplicates)
+    clone.emplace_back(handle);
+  result->reset(std::move(clone));
+  return ZX_OK;
+}
+
+#endif  // __Fuchsia__
+
+// Clones element by element. Defined below, after every |Clone| overload.
+template <typename T>
+zx_status_t CloneVectorElements(const std::vector<T>& value,
+                                VectorPtr<T>* result,
+                                std::false_type is_duplicable_handle);
+
+}  // namespace internal
+
 // Deep copies the contents of |value| into |result|.
 // This operation also attempts to duplicate any handles the value contains.
 //
@@ -91,13 +141,8 @@ inline typename std::enable_if<!IsPrimitive<T>::value, zx_status_t>::type Clone(
     *result = VectorPtr<T>();
     return ZX_OK;
   }
-  result->resize(value->size());
-  for (size_t i = 0; i < value->size(); ++i) {
-    zx_status_t status = Clone(value->at(i), &(*result)->at(i));
-    if (status != ZX_OK)
-      return status;
-  }
-  return ZX_OK;
+  return internal::CloneVectorElements(*value, result,
+                                       internal::IsDuplicableHandle<T>());
 }
 
 template <typename T>
@@ -112,7 +157,9 @@ inline typename std::enable_if<IsPrimitive<T>::value, zx_status_t>::type Clone(
 }
 
 template <typename T, size_t N>
-inline zx_status_t Clone(const Array<T, N>& value, Array<T, N>* result) {
+inline typename std::enable_if<!IsMemcpyCompatible<T>::value,
+                               zx_status_t>::type
+Clone(const Array<T, N>& value, Array<T, N>* result) {
   for (size_t i = 0; i < N; ++i) {
     zx_status_t status = Clone(value[i], &result->at(i));
     if (status != ZX_OK)
@@ -121,8 +168,32 @@ inline zx_status_t Clone(const Array<T, N>& value, Array<T, N>* result) {
   return ZX_OK;
 }
 
+template <typename T, size_t N>
+inline typename std::enable_if<IsMemcpyCompatible<T>::value, zx_status_t>::type
+Clone(const Array<T, N>& value, Array<T, N>* result) {
+  memcpy(result->data(), value.data(), sizeof(T) * N);
+  return ZX_OK;
+}
+
 zx_status_t Clone(const StringPtr& value, StringPtr* result);
 
+namespace internal {
+
+template <typename T>
+zx_status_t CloneVectorElements(const std::vector<T>& value,
+                                VectorPtr<T>* result,
+                                std::false_type is_duplicable_handle) {
+  result->resize(value.size());
+  for (size_t i = 0; i < value.size(); ++i) {
+    zx_status_t status = Clone(value[i], &(*result)->at(i));
+    if (status != ZX_OK)
+      return status;
+  }
+  return ZX_OK;
+}
+
+}  // namespace internal
+
 // Returns a deep copy of |value|.
 // This operation also attempts to duplicate any handles the value contains.
 //
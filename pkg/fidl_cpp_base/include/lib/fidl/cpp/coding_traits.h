@@ -6,6 +6,7 @@
 #define LIB_FIDL_CPP_CODING_TRAITS_H_
 
 #include <lib/fidl/cpp/array.h>
+#include <string.h>
 
 #include <memory>
 
@@ -19,20 +20,122 @@ namespace fidl {
 template <typename T, class Enable = void>
 struct CodingTraits;
 
+// Every |CodingTraits<T>| provides
+//
+//   static void EncodedSize(const T& value, EncodingSize* size);
+//
+// which adds the out-of-line bytes and the handles that encoding |value|
+// needs to |size|. The inline part is accounted for by the enclosing object.
+//
+// Every |CodingTraits<T>| also provides the compile-time upper bounds
+//
+//   static constexpr uint32_t max_out_of_line;
+//   static constexpr uint32_t max_handles;
+//
+// on the out-of-line bytes and the handles that encoding any |T| needs, or
+// |kUnbounded| if there is no bound. The C++ types do not record the bounds of
+// vectors and strings, so anything containing one has unbounded out-of-line
+// size, although its handle count may still be bounded. Types whose bounds
+// are both finite can be encoded into a buffer of
+// |AlignedSize(encoded_size) + max_out_of_line| bytes and |max_handles|
+// handles on the stack, without touching the heap.
+constexpr uint32_t kUnbounded = UINT32_MAX;
+
+namespace internal {
+
+constexpr size_t AlignedSize(size_t size) {
+  return (size + FIDL_ALIGNMENT - 1) & ~static_cast<size_t>(FIDL_ALIGNMENT - 1);
+}
+
+// Arithmetic on |max_out_of_line| and |max_handles| that saturates at
+// |kUnbounded|.
+constexpr uint32_t SaturatingAdd(uint64_t a, uint64_t b) {
+  return a + b >= kUnbounded ? kUnbounded : static_cast<uint32_t>(a + b);
+}
+
+constexpr uint32_t SaturatingMul(uint64_t a, uint64_t b) {
+  return a * b >= kUnbounded ? kUnbounded : static_cast<uint32_t>(a * b);
+}
+
+// Types encoded by a member |Encode| report their out-of-line size through a
+// member |EncodedSize(EncodingSize*) const| when they have one. Those without
+// contribute nothing, which makes the total a lower bound.
+template <typename T>
+auto AddEncodedSize(const T& value, EncodingSize* size, int)
+    -> decltype(value.EncodedSize(size), void()) {
+  value.EncodedSize(size);
+}
+
+template <typename T>
+void AddEncodedSize(const T& value, EncodingSize* size, long) {}
+
+// Encodes or decodes |count| elements starting at |elements| to or from the
+// message at |offset|, either element by element or, when |T| is
+// memcpy-compatible, with a single copy.
+template <typename T>
+void EncodeElements(Encoder* encoder, T* elements, size_t count, size_t offset,
+                    std::true_type is_memcpy_compatible) {
+  static_assert(CodingTraits<T>::encoded_size == sizeof(T), "");
+  if (count)
+    memcpy(encoder->GetPtr<T>(offset), elements, count * sizeof(T));
+}
+
+template <typename T>
+void EncodeElements(Encoder* encoder, T* elements, size_t count, size_t offset,
+                    std::false_type is_memcpy_compatible) {
+  size_t stride = CodingTraits<T>::encoded_size;
+  for (size_t i = 0; i < count; ++i)
+    CodingTraits<T>::Encode(encoder, &elements[i], offset + i * stride);
+}
+
+template <typename T>
+void DecodeElements(Decoder* decoder, T* elements, size_t count, size_t offset,
+                    std::true_type is_memcpy_compatible) {
+  static_assert(CodingTraits<T>::encoded_size == sizeof(T), "");
+  if (count)
+    memcpy(elements, decoder->GetPtr<T>(offset), count * sizeof(T));
+}
+
+template <typename T>
+void DecodeElements(Decoder* decoder, T* elements, size_t count, size_t offset,
+                    std::false_type is_memcpy_compatible) {
+  size_t stride = CodingTraits<T>::encoded_size;
+  for (size_t i = 0; i < count; ++i)
+    CodingTraits<T>::Decode(decoder, &elements[i], offset + i * stride);
+}
+
+template <typename T, typename Container>
+void AddElementsEncodedSize(const Container& elements, EncodingSize* size,
+                            std::true_type is_primitive) {}
+
+template <typename T, typename Container>
+void AddElementsEncodedSize(const Container& elements, EncodingSize* size,
+                            std::false_type is_primitive) {
+  for (const auto& element : elements)
+    CodingTraits<T>::EncodedSize(element, size);
+}
+
+}  // namespace internal
+
 template <typename T>
 struct CodingTraits<T, typename std::enable_if<IsPrimitive<T>::value>::type> {
   static constexpr size_t encoded_size = sizeof(T);
+  static constexpr uint32_t max_out_of_line = 0u;
+  static constexpr uint32_t max_handles = 0u;
   inline static void Encode(Encoder* encoder, T* value, size_t offset) {
     *encoder->GetPtr<T>(offset) = *value;
   }
   inline static void Decode(Decoder* decoder, T* value, size_t offset) {
     *value = *decoder->GetPtr<T>(offset);
   }
+  inline static void EncodedSize(const T& value, EncodingSize* size) {}
 };
 
 template <>
 struct CodingTraits<bool> {
   static constexpr size_t encoded_size = sizeof(bool);
+  static constexpr uint32_t max_out_of_line = 0u;
+  static constexpr uint32_t max_handles = 0u;
   inline static void Encode(Encoder* encoder, bool* value, size_t offset) {
     *encoder->GetPtr<bool>(offset) = *value;
   }
@@ -47,6 +150,7 @@ struct CodingTraits<bool> {
                             size_t offset) {
     *value = *decoder->GetPtr<bool>(offset);
   }
+  inline static void EncodedSize(bool value, EncodingSize* size) {}
 };
 
 #ifdef __Fuchsia__
@@ -54,18 +158,28 @@ template <typename T>
 struct CodingTraits<T, typename std::enable_if<
                            std::is_base_of<zx::object_base, T>::value>::type> {
   static constexpr size_t encoded_size = sizeof(zx_handle_t);
+  static constexpr uint32_t max_out_of_line = 0u;
+  static constexpr uint32_t max_handles = 1u;
   static void Encode(Encoder* encoder, zx::object_base* value, size_t offset) {
     encoder->EncodeHandle(value, offset);
   }
   static void Decode(Decoder* decoder, zx::object_base* value, size_t offset) {
     decoder->DecodeHandle(value, offset);
   }
+  static void EncodedSize(const zx::object_base& value, EncodingSize* size) {
+    if (value.is_valid())
+      ++size->handles;
+  }
 };
 #endif
 
 template <typename T>
 struct CodingTraits<std::unique_ptr<T>> {
   static constexpr size_t encoded_size = sizeof(uintptr_t);
+  static constexpr uint32_t max_out_of_line = internal::SaturatingAdd(
+      internal::AlignedSize(CodingTraits<T>::encoded_size),
+      CodingTraits<T>::max_out_of_line);
+  static constexpr uint32_t max_handles = CodingTraits<T>::max_handles;
   static void Encode(Encoder* encoder, std::unique_ptr<T>* value,
                      size_t offset) {
     if (value->get()) {
@@ -84,6 +198,13 @@ struct CodingTraits<std::unique_ptr<T>> {
     *value = std::make_unique<T>();
     CodingTraits<T>::Decode(decoder, value->get(), decoder->GetOffset(ptr));
   }
+  static void EncodedSize(const std::unique_ptr<T>& value,
+                          EncodingSize* size) {
+    if (!value)
+      return;
+    size->bytes += internal::AlignedSize(CodingTraits<T>::encoded_size);
+    CodingTraits<T>::EncodedSize(*value, size);
+  }
 };
 
 void EncodeNullVector(Encoder* encoder, size_t offset);
@@ -92,6 +213,9 @@ void EncodeVectorPointer(Encoder* encoder, size_t count, size_t offset);
 template <typename T>
 struct CodingTraits<VectorPtr<T>> {
   static constexpr size_t encoded_size = sizeof(fidl_vector_t);
+  static constexpr uint32_t max_out_of_line = kUnbounded;
+  static constexpr uint32_t max_handles =
+      CodingTraits<T>::max_handles == 0u ? 0u : kUnbounded;
   static void Encode(Encoder* encoder, VectorPtr<T>* value, size_t offset) {
     if (value->is_null())
       return EncodeNullVector(encoder, offset);
@@ -99,48 +223,149 @@ struct CodingTraits<VectorPtr<T>> {
     EncodeVectorPointer(encoder, count, offset);
     size_t stride = CodingTraits<T>::encoded_size;
     size_t base = encoder->Alloc(count * stride);
-    for (size_t i = 0; i < count; ++i)
-      CodingTraits<T>::Encode(encoder, &(*value)->at(i), base + i * stride);
+    EncodeVectorElements(encoder, value, count, base, IsMemcpyCompatible<T>());
   }
   static void Decode(Decoder* decoder, VectorPtr<T>* value, size_t offset) {
     fidl_vector_t* encoded = decoder->GetPtr<fidl_vector_t>(offset);
     if (!encoded->data) {
-      *value = VectorPtr<T>();
+      // Keep the capacity, for objects that are decoded into again.
+      value->reset();
       return;
     }
     value->resize(encoded->count);
-    size_t stride = CodingTraits<T>::encoded_size;
     size_t base = decoder->GetOffset(encoded->data);
     size_t count = encoded->count;
+    DecodeVectorElements(decoder, value, count, base, IsMemcpyCompatible<T>());
+  }
+  static void EncodedSize(const VectorPtr<T>& value, EncodingSize* size) {
+    if (value.is_null())
+      return;
+    size->bytes +=
+        internal::AlignedSize(value->size() * CodingTraits<T>::encoded_size);
+    internal::AddElementsEncodedSize<T>(*value, size, IsPrimitive<T>());
+  }
+
+ private:
+  // Vectors whose elements are not memcpy-compatible are coded element by
+  // element.
+  static void EncodeVectorElements(Encoder* encoder, VectorPtr<T>* value,
+                                   size_t count, size_t base,
+                                   std::true_type is_memcpy_compatible) {
+    internal::EncodeElements(encoder, (*value)->data(), count, base,
+                             is_memcpy_compatible);
+  }
+  static void EncodeVectorElements(Encoder* encoder, VectorPtr<T>* value,
+                                   size_t count, size_t base,
+                                   std::false_type is_memcpy_compatible) {
+    size_t stride = CodingTraits<T>::encoded_size;
+    for (size_t i = 0; i < count; ++i)
+      CodingTraits<T>::Encode(encoder, &(*value)->at(i), base + i * stride);
+  }
+  static void DecodeVectorElements(Decoder* decoder, VectorPtr<T>* value,
+                                   size_t count, size_t base,
+                                   std::true_type is_memcpy_compatible) {
+    internal::DecodeElements(decoder, (*value)->data(), count, base,
+                             is_memcpy_compatible);
+  }
+  static void DecodeVectorElements(Decoder* decoder, VectorPtr<T>* value,
+                                   size_t count, size_t base,
+                                   std::false_type is_memcpy_compatible) {
+    size_t stride = CodingTraits<T>::encoded_size;
     for (size_t i = 0; i < count; ++i)
       CodingTraits<T>::Decode(decoder, &(*value)->at(i), base + i * stride);
   }
 };
 
+// A vector of bools is a byte per element on the wire but a bit per element
+// in |std::vector<bool>|. Runs of equal elements are converted in bulk, and
+// the wire is read and written a word of eight elements at a time; elements
+// in mixed groups still go through their bit references one by one.
+template <>
+struct CodingTraits<VectorPtr<bool>> {
+  static constexpr size_t encoded_size = sizeof(fidl_vector_t);
+  static constexpr uint32_t max_out_of_line = kUnbounded;
+  static constexpr uint32_t max_handles = 0u;
+  static void Encode(Encoder* encoder, VectorPtr<bool>* value, size_t offset);
+  static void Decode(Decoder* decoder, VectorPtr<bool>* value, size_t offset);
+  static void EncodedSize(const VectorPtr<bool>& value, EncodingSize* size) {
+    if (value.is_null())
+      return;
+    size->bytes += internal::AlignedSize(value->size());
+  }
+};
+
+// A |VectorView<T>| borrows its elements instead of owning them. Decoding
+// points the view at the elements in the message held by the |Decoder|, so
+// the view is valid only as long as that |Decoder| is alive. The generated
+// dispatch code keeps the |Decoder| alive for the duration of the callback that
+// receives the decoded arguments, which means views must not be retained past
+// that callback. Copy the elements out, e.g. into a |VectorPtr|, to keep them.
+//
+// Encoding copies the elements the view refers to into the message.
+template <typename T>
+struct CodingTraits<VectorView<T>> {
+  static_assert(IsMemcpyCompatible<T>::value,
+                "VectorView can only borrow memcpy-compatible elements");
+  static constexpr size_t encoded_size = sizeof(fidl_vector_t);
+  static constexpr uint32_t max_out_of_line = kUnbounded;
+  static constexpr uint32_t max_handles = 0u;
+  static void Encode(Encoder* encoder, VectorView<T>* value, size_t offset) {
+    if (value->is_null())
+      return EncodeNullVector(encoder, offset);
+    size_t count = value->count();
+    EncodeVectorPointer(encoder, count, offset);
+    size_t base = encoder->Alloc(count * sizeof(T));
+    internal::EncodeElements(encoder, value->mutable_data(), count, base,
+                             std::true_type());
+  }
+  static void Decode(Decoder* decoder, VectorView<T>* value, size_t offset) {
+    fidl_vector_t* encoded = decoder->GetPtr<fidl_vector_t>(offset);
+    value->set_data(static_cast<T*>(encoded->data));
+    value->set_count(encoded->data ? encoded->count : 0u);
+  }
+  static void EncodedSize(const VectorView<T>& value, EncodingSize* size) {
+    if (!value.is_null())
+      size->bytes += internal::AlignedSize(value.count() * sizeof(T));
+  }
+};
+
 template <typename T, size_t N>
 struct CodingTraits<Array<T, N>> {
   static constexpr size_t encoded_size = CodingTraits<T>::encoded_size * N;
+  static constexpr uint32_t max_out_of_line =
+      internal::SaturatingMul(CodingTraits<T>::max_out_of_line, N);
+  static constexpr uint32_t max_handles =
+      internal::SaturatingMul(CodingTraits<T>::max_handles, N);
   static void Encode(Encoder* encoder, Array<T, N>* value, size_t offset) {
-    size_t stride = CodingTraits<T>::encoded_size;
-    for (size_t i = 0; i < N; ++i)
-      CodingTraits<T>::Encode(encoder, &value->at(i), offset + i * stride);
+    internal::EncodeElements(encoder, value->data(), N, offset,
+                             IsMemcpyCompatible<T>());
   }
   static void Decode(Decoder* decoder, Array<T, N>* value, size_t offset) {
-    size_t stride = CodingTraits<T>::encoded_size;
-    for (size_t i = 0; i < N; ++i)
-      CodingTraits<T>::Decode(decoder, &value->at(i), offset + i * stride);
+    internal::DecodeElements(decoder, value->data(), N, offset,
+                             IsMemcpyCompatible<T>());
+  }
+  static void EncodedSize(const Array<T, N>& value, EncodingSize* size) {
+    internal::AddElementsEncodedSize<T>(value, size, IsPrimitive<T>());
   }
 };
 
-template <typename T, size_t EncodedSize>
+// |MaxOutOfLine| and |MaxHandles| default to |kUnbounded|; generated code
+// passes the bounds it computes from the FIDL declaration.
+template <typename T, size_t InlineSize, uint32_t MaxOutOfLine = kUnbounded,
+          uint32_t MaxHandles = kUnbounded>
 struct EncodableCodingTraits {
-  static constexpr size_t encoded_size = EncodedSize;
+  static constexpr size_t encoded_size = InlineSize;
+  static constexpr uint32_t max_out_of_line = MaxOutOfLine;
+  static constexpr uint32_t max_handles = MaxHandles;
   static void Encode(Encoder* encoder, T* value, size_t offset) {
     value->Encode(encoder, offset);
   }
   static void Decode(Decoder* decoder, T* value, size_t offset) {
     T::Decode(decoder, value, offset);
   }
+  static void EncodedSize(const T& value, EncodingSize* size) {
+    internal::AddEncodedSize(value, size, 0);
+  }
 };
 
 template <typename T>
@@ -153,6 +378,16 @@ void Decode(Decoder* decoder, T* value, size_t offset) {
   CodingTraits<T>::Decode(decoder, value, offset);
 }
 
+// Returns the number of bytes and handles needed to encode |value| as an
+// out-of-line object, including its inline part.
+template <typename T>
+EncodingSize EncodedSize(const T& value) {
+  EncodingSize size;
+  size.bytes = internal::AlignedSize(CodingTraits<T>::encoded_size);
+  CodingTraits<T>::EncodedSize(value, &size);
+  return size;
+}
+
 template <typename T>
 T DecodeAs(Decoder* decoder, size_t offset) {
   T value;
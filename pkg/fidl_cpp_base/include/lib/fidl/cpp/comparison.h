@@ -5,7 +5,12 @@
 #ifndef GARNET_PUBLIC_LIB_FIDL_CPP_COMPARISON_H_
 #define GARNET_PUBLIC_LIB_FIDL_CPP_COMPARISON_H_
 
+#include <string.h>
+
 #include <memory>
+#include <type_traits>
+
+#include "lib/fidl/cpp/traits.h"
 
 // Comparisons that uses structure equality on on std::unique_ptr instead of
 // pointer equality.
@@ -25,6 +30,31 @@ inline bool Equals(const std::unique_ptr<T>& lhs,
   return Equals<T>(*lhs, *rhs);
 }
 
+namespace internal {
+
+// Compares the first |count| elements of two vectors or arrays, with one
+// memcmp if their elements are |IsMemcmpCompatible| and one by one with
+// |Equals| otherwise.
+template <class Container>
+inline bool ElementsEqual(const Container& lhs, const Container& rhs,
+                          size_t count, std::true_type is_memcmp_compatible) {
+  return count == 0u ||
+         memcmp(lhs.data(), rhs.data(), count * sizeof(lhs[0])) == 0;
+}
+
+template <class Container>
+inline bool ElementsEqual(const Container& lhs, const Container& rhs,
+                          size_t count, std::false_type is_memcmp_compatible) {
+  for (size_t i = 0; i < count; ++i) {
+    if (!Equals(lhs[i], rhs[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace internal
+
 }  // namespace fidl
 
 #endif  // GARNET_PUBLIC_LIB_FIDL_CPP_COMPARISON_H_
@@ -0,0 +1,126 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_DECODE_POOL_H_
+#define LIB_FIDL_CPP_DECODE_POOL_H_
+
+#include <lib/fidl/cpp/message.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zircon/types.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "lib/fidl/cpp/coding_traits.h"
+#include "lib/fidl/cpp/decoder.h"
+
+namespace fidl {
+
+// Decodes objects of the struct type |T| into storage reused from one object
+// to the next.
+//
+// Decoding a |VectorPtr| or |StringPtr| assigns into the capacity the field
+// already has, and decoding a vector of structs decodes into the elements it
+// already holds, so an object decoded into storage left by a similar object
+// allocates only for the parts that have grown. The pool keeps up to
+// |max_retained| objects once their owners are done with them and decodes the
+// next objects into those, so that a stream of deep objects, such as diffs or
+// story graphs, stops paying an allocation for each nested vector and string
+// and a free for each when the object goes away. Everything is released at
+// once when the pool is destroyed or trimmed.
+//
+// Only vectors and strings reuse their storage: a nullable struct, held in a
+// |std::unique_ptr|, is allocated afresh each time it is decoded, along with
+// everything nested in it.
+//
+// The |Decoder| used by |Decode| does not outlive the call, so any
+// |LazyTable| member of |T| is materialized before |Decode| returns and
+// decoding through a pool gains nothing from it.
+//
+// A retained object keeps the capacity of the largest object decoded into it,
+// so size |max_retained| to the number of objects alive at once.
+//
+// Decoded objects are owned by |Ptr|s, which must not outlive the pool. The
+// pool is thread-hostile.
+template <typename T>
+class DecodePool {
+ public:
+  // Hands an object back to the pool it was decoded by.
+  class Deleter {
+   public:
+    explicit Deleter(DecodePool* pool = nullptr) : pool_(pool) {}
+
+    void operator()(T* object) const {
+      if (pool_) {
+        pool_->Recycle(object);
+      } else {
+        delete object;
+      }
+    }
+
+   private:
+    DecodePool* pool_;
+  };
+
+  using Ptr = std::unique_ptr<T, Deleter>;
+
+  explicit DecodePool(size_t max_retained = 4u)
+      : max_retained_(max_retained) {}
+
+  DecodePool(const DecodePool&) = delete;
+  DecodePool& operator=(const DecodePool&) = delete;
+
+  // Validates and decodes the object in the |bytes_length| bytes at |bytes|,
+  // encoded without a message header, as |DecodeObject| does, and stores it
+  // in |object|.
+  //
+  // The bytes are decoded in place, so they are modified.
+  zx_status_t Decode(uint8_t* bytes, size_t bytes_length, Ptr* object,
+                     const char** error_msg_out) {
+    Message message(BytePart(bytes, bytes_length, bytes_length), HandlePart());
+    zx_status_t status = message.Decode(T::FidlType, error_msg_out);
+    if (status != ZX_OK)
+      return status;
+    Ptr decoded = Take();
+    {
+      // Materializes the lazy tables of |decoded| as it goes away.
+      Decoder decoder(std::move(message));
+      T::Decode(&decoder, decoded.get(), 0);
+    }
+    *object = std::move(decoded);
+    return ZX_OK;
+  }
+
+  // The number of objects waiting to be decoded into.
+  size_t retained() const { return retained_.size(); }
+
+  // Frees the objects waiting to be decoded into.
+  void Trim() { retained_.clear(); }
+
+ private:
+  Ptr Take() {
+    if (retained_.empty())
+      return Ptr(new T(), Deleter(this));
+    Ptr object(retained_.back().release(), Deleter(this));
+    retained_.pop_back();
+    return object;
+  }
+
+  void Recycle(T* object) {
+    if (retained_.size() < max_retained_) {
+      retained_.emplace_back(object);
+    } else {
+      delete object;
+    }
+  }
+
+  const size_t max_retained_;
+  std::vector<std::unique_ptr<T>> retained_;
+};
+
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_DECODE_POOL_H_
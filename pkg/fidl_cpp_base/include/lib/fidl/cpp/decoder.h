@@ -6,6 +6,7 @@
 #define LIB_FIDL_CPP_DECODER_H_
 
 #include <lib/fidl/cpp/message.h>
+#include <zircon/assert.h>
 #include <zircon/fidl.h>
 
 #ifdef __Fuchsia__
@@ -14,6 +15,48 @@
 
 namespace fidl {
 
+class Decoder;
+
+namespace internal {
+
+// The part of a |LazyTable| by which the |Decoder| it reads from keeps track
+// of it, so that the |Decoder| can materialize the table before the message
+// goes away.
+class LazyTableLink {
+ protected:
+  LazyTableLink() = default;
+  ~LazyTableLink() { Unlink(); }
+
+  LazyTableLink(const LazyTableLink&) = delete;
+  LazyTableLink& operator=(const LazyTableLink&) = delete;
+
+  // Starts reading from |decoder|, or stops reading from any if it is null.
+  void Link(Decoder* decoder);
+  void Unlink() { Link(nullptr); }
+
+  Decoder* decoder() const { return decoder_; }
+
+  // Called by the |Decoder| as it is destroyed, before it unlinks the table.
+  virtual void OnDecoderDestroyed() = 0;
+
+ private:
+  friend class ::fidl::Decoder;
+
+  Decoder* decoder_ = nullptr;
+  LazyTableLink* prev_ = nullptr;
+  LazyTableLink* next_ = nullptr;
+};
+
+}  // namespace internal
+
+// Decodes HLCPP objects out of a message that |fidl_decode| has already
+// validated.
+//
+// Because the whole message has been checked against its coding table, every
+// offset and pointer the generated |Decode| methods pass in is known to lie
+// within the message. The accessors are therefore inline and unchecked in
+// release builds, so decoding a field compiles down to a pointer read. Debug
+// builds still assert that each access stays inside the message.
 class Decoder {
  public:
   explicit Decoder(Message message);
@@ -21,20 +64,34 @@ class Decoder {
 
   template <typename T>
   T* GetPtr(size_t offset) {
-    return reinterpret_cast<T*>(InternalGetPtr(offset));
+    ZX_DEBUG_ASSERT(offset + sizeof(T) <= message_.bytes().actual());
+    return reinterpret_cast<T*>(message_.bytes().data() + offset);
   }
 
-  size_t GetOffset(void* ptr);
-  size_t GetOffset(uintptr_t ptr);
+  size_t GetOffset(void* ptr) {
+    return GetOffset(reinterpret_cast<uintptr_t>(ptr));
+  }
+
+  size_t GetOffset(uintptr_t ptr) {
+    // The |ptr| value comes from the message buffer, which we've already
+    // validated. That means it should coorespond to a valid offset within the
+    // message.
+    uintptr_t base = reinterpret_cast<uintptr_t>(message_.bytes().data());
+    ZX_DEBUG_ASSERT(ptr >= base && ptr - base <= message_.bytes().actual());
+    return ptr - base;
+  }
 
 #ifdef __Fuchsia__
   void DecodeHandle(zx::object_base* value, size_t offset);
 #endif
 
  private:
-  uint8_t* InternalGetPtr(size_t offset);
+  friend class internal::LazyTableLink;
 
   Message message_;
+  // The |LazyTable|s that read from |message_|, which are materialized when
+  // the |Decoder| is destroyed.
+  internal::LazyTableLink* lazy_tables_ = nullptr;
 };
 
 }  // namespace fidl
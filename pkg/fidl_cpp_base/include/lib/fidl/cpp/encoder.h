@@ -6,6 +6,7 @@
 #define LIB_FIDL_CPP_ENCODER_H_
 
 #include <lib/fidl/cpp/message.h>
+#include <lib/fidl/cpp/message_buffer.h>
 
 #ifdef __Fuchsia__
 #include <lib/zx/object.h>
@@ -17,19 +18,49 @@
 
 namespace fidl {
 
+// The number of bytes and handles needed to encode a value.
+//
+// See |fidl::EncodedSize| in <lib/fidl/cpp/coding_traits.h>, which computes
+// this by walking a value so that an |Encoder| can reserve its storage once
+// rather than growing it as each out-of-line object is allocated.
+struct EncodingSize {
+  size_t bytes = 0u;
+  size_t handles = 0u;
+};
+
 class Encoder {
  public:
   enum NoHeader { NO_HEADER };
 
   explicit Encoder(uint32_t ordinal);
   explicit Encoder(NoHeader) {}
+
+  // Creates an |Encoder| that encodes into the given storage, which it does
+  // not own, when the message fits. If the message outgrows |bytes| or
+  // |handles|, the encoder moves its contents to the heap and continues there.
+  //
+  // The storage must outlive the |Encoder| and any |Message| obtained from
+  // |GetMessage|.
+  Encoder(uint32_t ordinal, BytePart bytes, HandlePart handles);
+
+  // Creates an |Encoder| that encodes into |buffer|, for example one borrowed
+  // from a |MessageBufferPool|. See above.
+  Encoder(uint32_t ordinal, MessageBuffer* buffer);
+
   ~Encoder();
 
+  Encoder(const Encoder&) = delete;
+  Encoder& operator=(const Encoder&) = delete;
+
   size_t Alloc(size_t size);
 
+  // Ensures that |Alloc| can provide |size.bytes| more bytes, and that
+  // |size.handles| more handles can be encoded, without reallocating.
+  void Reserve(const EncodingSize& size);
+
   template <typename T>
   T* GetPtr(size_t offset) {
-    return reinterpret_cast<T*>(bytes_.data() + offset);
+    return reinterpret_cast<T*>(bytes_data_ + offset);
   }
 
 #ifdef __Fuchsia__
@@ -40,17 +71,36 @@ class Encoder {
 
   void Reset(uint32_t ordinal);
 
-  size_t CurrentLength() const { return bytes_.size(); }
+  // Discards everything encoded so far, keeping any heap storage for reuse,
+  // so that the encoder can encode another value without a message header.
+  void Reset(NoHeader);
+
+  size_t CurrentLength() const { return bytes_size_; }
 
-  size_t CurrentHandleCount() const { return handles_.size(); }
+  size_t CurrentHandleCount() const { return handles_size_; }
 
-  std::vector<uint8_t> TakeBytes() { return std::move(bytes_); }
+  // Whether the message has outgrown the storage given to the constructor,
+  // if any, and now lives on the heap.
+  bool is_on_heap() const { return bytes_data_ == heap_bytes_.data(); }
+
+  std::vector<uint8_t> TakeBytes();
 
  private:
   void EncodeMessageHeader(uint32_t ordinal);
-
-  std::vector<uint8_t> bytes_;
-  std::vector<zx_handle_t> handles_;
+  void MoveBytesToHeap(size_t capacity);
+  void MoveHandlesToHeap(size_t capacity);
+
+  // The bytes and handles encoded so far. They live either in caller-provided
+  // storage or in |heap_bytes_| and |heap_handles_|.
+  uint8_t* bytes_data_ = nullptr;
+  size_t bytes_size_ = 0u;
+  size_t bytes_capacity_ = 0u;
+  zx_handle_t* handles_data_ = nullptr;
+  size_t handles_size_ = 0u;
+  size_t handles_capacity_ = 0u;
+
+  std::vector<uint8_t> heap_bytes_;
+  std::vector<zx_handle_t> heap_handles_;
 };
 
 }  // namespace fidl
@@ -0,0 +1,151 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_HASH_H_
+#define LIB_FIDL_CPP_HASH_H_
+
+#include <lib/fidl/cpp/array.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+#include <type_traits>
+
+#include "lib/fidl/cpp/string.h"
+#include "lib/fidl/cpp/traits.h"
+#include "lib/fidl/cpp/vector.h"
+
+namespace fidl {
+namespace internal {
+
+// A fast, non-cryptographic hash of |size| bytes that consumes eight bytes at
+// a time. Not suitable for hashing untrusted input into tables that must
+// resist collision attacks.
+size_t HashBytes(const void* data, size_t size, size_t seed);
+
+// Mixes |value| into |seed|.
+inline size_t HashCombine(size_t seed, size_t value) {
+  return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+// Whether elements of type |T| are equal exactly when their bytes are, so
+// that a contiguous run of them can be hashed as raw memory. Floating-point
+// types are excluded because 0.0 and -0.0 compare equal.
+template <typename T>
+struct IsHashableAsBytes
+    : public std::integral_constant<bool, IsMemcpyCompatible<T>::value &&
+                                              std::is_integral<T>::value> {};
+
+}  // namespace internal
+
+// Hashes |value| consistently with |fidl::Equals|: values that compare equal
+// have the same hash.
+//
+// There are many overloads of this function with the following signature:
+//   size_t Hash(const T& value);
+//
+// Generated structs, tables and unions provide a |size_t Hash() const| member
+// that combines the hashes of their fields.
+template <typename T>
+inline typename std::enable_if<IsPrimitive<T>::value || std::is_enum<T>::value,
+                               size_t>::type
+Hash(const T& value) {
+  // Normalize -0.0 to 0.0 so that values that compare equal hash the same.
+  T normalized = value == T() ? T() : value;
+  return internal::HashBytes(&normalized, sizeof(normalized), 0u);
+}
+
+template <typename T>
+inline
+#ifdef __Fuchsia__
+    typename std::enable_if<!IsPrimitive<T>::value && !std::is_enum<T>::value &&
+                                !std::is_base_of<zx::object_base, T>::value,
+                            size_t>::type
+#else   // __Fuchsia__
+    typename std::enable_if<!IsPrimitive<T>::value && !std::is_enum<T>::value,
+                            size_t>::type
+#endif  // __Fuchsia__
+    Hash(const T& value) {
+  return value.Hash();
+}
+
+#ifdef __Fuchsia__
+template <typename T>
+inline size_t Hash(const zx::object<T>& value) {
+  zx_handle_t handle = value.get();
+  return internal::HashBytes(&handle, sizeof(handle), 0u);
+}
+#endif  // __Fuchsia__
+
+template <typename T>
+inline size_t Hash(const std::unique_ptr<T>& value) {
+  return value ? internal::HashCombine(1u, Hash(*value)) : 0u;
+}
+
+inline size_t Hash(const StringPtr& value) {
+  if (value.is_null())
+    return 0u;
+  return internal::HashBytes(value->data(), value->size(), 1u);
+}
+
+namespace internal {
+
+template <typename T>
+inline size_t HashElements(const T* elements, size_t count, size_t seed,
+                           std::true_type is_hashable_as_bytes) {
+  return HashBytes(elements, count * sizeof(T), seed);
+}
+
+template <typename T>
+inline size_t HashElements(const T* elements, size_t count, size_t seed,
+                           std::false_type is_hashable_as_bytes) {
+  size_t hash = seed;
+  for (size_t i = 0; i < count; ++i)
+    hash = HashCombine(hash, Hash(elements[i]));
+  return hash;
+}
+
+// std::vector<bool> has no contiguous storage.
+inline size_t HashElements(const std::vector<bool>& elements, size_t seed) {
+  size_t hash = seed;
+  for (bool element : elements)
+    hash = HashCombine(hash, element);
+  return hash;
+}
+
+template <typename T>
+inline size_t HashElements(const std::vector<T>& elements, size_t seed) {
+  return HashElements(elements.data(), elements.size(), seed,
+                      IsHashableAsBytes<T>());
+}
+
+}  // namespace internal
+
+template <typename T>
+inline size_t Hash(const VectorPtr<T>& value) {
+  if (value.is_null())
+    return 0u;
+  return internal::HashElements(*value, 1u);
+}
+
+template <typename T, size_t N>
+inline size_t Hash(const Array<T, N>& value) {
+  return internal::HashElements(value.data(), N, 0u,
+                                internal::IsHashableAsBytes<T>());
+}
+
+// A hash function object for using FIDL types as keys in unordered
+// containers, e.g. |std::unordered_map<PageId, Entry, fidl::Hasher<PageId>>|.
+//
+// The container's default |std::equal_to| works for types with |operator==|,
+// as generated types have.
+template <typename T>
+struct Hasher {
+  size_t operator()(const T& value) const { return Hash(value); }
+};
+
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_HASH_H_
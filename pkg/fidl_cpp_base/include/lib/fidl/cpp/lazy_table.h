@@ -0,0 +1,172 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_LAZY_TABLE_H_
+#define LIB_FIDL_CPP_LAZY_TABLE_H_
+
+#include <stdint.h>
+#include <zircon/assert.h>
+#include <zircon/fidl.h>
+
+#include <utility>
+
+#include "lib/fidl/cpp/coding_traits.h"
+
+namespace fidl {
+
+// A FIDL table of type |T| that is decoded on first access rather than when
+// the enclosing message is decoded.
+//
+// Decoding a |LazyTable| only records where the table lives in the message.
+// The table is materialized into a |T| the first time |get| or |operator->| is
+// called, and individual members can be decoded without materializing the
+// rest of the table with |DecodeMember|. Handlers that read one or two members
+// of a large table, or none at all, skip decoding the others.
+//
+// Materializing reads from the message held by the |Decoder|, so a table
+// that has not been materialized when its |Decoder| is destroyed is
+// materialized by the |Decoder|'s destructor. A table that outlives its
+// |Decoder|, such as one moved into a posted task, therefore loses its
+// laziness but never reads freed memory. Because that materialization writes
+// to the table, a table must not be handed to another thread while its
+// |Decoder| is alive without being materialized first.
+//
+// Tables that carry handles are materialized eagerly while decoding, so every
+// handle is claimed from the message and none can leak if the table is never
+// accessed.
+template <typename T>
+class LazyTable final : private internal::LazyTableLink {
+ public:
+  LazyTable() = default;
+  explicit LazyTable(T value)
+      : value_(std::move(value)), is_materialized_(true) {}
+
+  ~LazyTable() = default;
+
+  // Moving an unmaterialized table moves its place in the message.
+  LazyTable(LazyTable&& other)
+      : value_(std::move(other.value_)),
+        offset_(other.offset_),
+        is_materialized_(other.is_materialized_) {
+    Link(other.decoder());
+    other.Unlink();
+    other.is_materialized_ = true;
+  }
+  LazyTable& operator=(LazyTable&& other) {
+    if (this != &other) {
+      value_ = std::move(other.value_);
+      offset_ = other.offset_;
+      is_materialized_ = other.is_materialized_;
+      Link(other.decoder());
+      other.Unlink();
+      other.is_materialized_ = true;
+    }
+    return *this;
+  }
+
+  // Whether the table has been decoded into a |T|.
+  bool is_materialized() const { return is_materialized_; }
+
+  // Decodes the table if it has not been decoded yet and returns it.
+  T& get() {
+    Materialize();
+    return value_;
+  }
+  const T& get() const {
+    Materialize();
+    return value_;
+  }
+
+  T* operator->() { return &get(); }
+  const T* operator->() const { return &get(); }
+  T& operator*() { return get(); }
+  const T& operator*() const { return get(); }
+
+  // Decodes the member with the given |ordinal| into |value| without
+  // materializing the table. Returns false if the member is absent.
+  //
+  // The member must not carry handles, and the |Decoder| the table was
+  // decoded with must still be alive, which is asserted. Members are decoded
+  // afresh on every call.
+  template <typename M>
+  bool DecodeMember(uint64_t ordinal, M* value) {
+    Decoder* decoder = this->decoder();
+    ZX_ASSERT_MSG(decoder != nullptr,
+                  "LazyTable members can only be decoded while the table's "
+                  "Decoder is alive");
+    const fidl_vector_t* envelopes = decoder->GetPtr<fidl_vector_t>(offset_);
+    if (ordinal == 0u || ordinal > envelopes->count)
+      return false;
+    const Envelope* envelope =
+        static_cast<const Envelope*>(envelopes->data) + (ordinal - 1);
+    if (!envelope->data)
+      return false;
+    ZX_ASSERT_MSG(envelope->num_handles == 0u,
+                  "LazyTable members with handles must be read through get()");
+    CodingTraits<M>::Decode(decoder, value,
+                            decoder->GetOffset(envelope->data));
+    return true;
+  }
+
+  void Encode(Encoder* encoder, size_t offset) {
+    CodingTraits<T>::Encode(encoder, &get(), offset);
+  }
+
+  static void Decode(Decoder* decoder, LazyTable* value, size_t offset) {
+    value->Link(decoder);
+    value->offset_ = offset;
+    value->is_materialized_ = false;
+    if (HasHandles(decoder, offset))
+      value->Materialize();
+  }
+
+  void EncodedSize(EncodingSize* size) const {
+    CodingTraits<T>::EncodedSize(get(), size);
+  }
+
+ private:
+  // The layout of a table envelope.
+  struct Envelope {
+    uint32_t num_bytes;
+    uint32_t num_handles;
+    void* data;
+  };
+
+  static bool HasHandles(Decoder* decoder, size_t offset) {
+    const fidl_vector_t* envelopes = decoder->GetPtr<fidl_vector_t>(offset);
+    const Envelope* envelope = static_cast<const Envelope*>(envelopes->data);
+    for (uint64_t i = 0; i < envelopes->count; ++i) {
+      if (envelope[i].num_handles != 0u)
+        return true;
+    }
+    return false;
+  }
+
+  // Materializing does not change the value the table represents, so it is
+  // allowed through const accessors. The table stays linked to its |Decoder|
+  // so that |DecodeMember| keeps working until the |Decoder| goes away.
+  void Materialize() const {
+    if (is_materialized_)
+      return;
+    CodingTraits<T>::Decode(decoder(), &value_, offset_);
+    is_materialized_ = true;
+  }
+
+  // |internal::LazyTableLink|:
+  void OnDecoderDestroyed() override { Materialize(); }
+
+  mutable T value_;
+  size_t offset_ = 0u;
+  mutable bool is_materialized_ = true;
+};
+
+template <typename T>
+struct CodingTraits<LazyTable<T>>
+    : public EncodableCodingTraits<LazyTable<T>, sizeof(fidl_vector_t),
+                                   CodingTraits<T>::max_out_of_line,
+                                   CodingTraits<T>::max_handles> {};
+
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_LAZY_TABLE_H_
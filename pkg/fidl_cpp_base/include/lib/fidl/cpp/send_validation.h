@@ -0,0 +1,37 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_SEND_VALIDATION_H_
+#define LIB_FIDL_CPP_SEND_VALIDATION_H_
+
+#include <stdint.h>
+
+namespace fidl {
+
+// Controls how often bindings validate a message before writing it to a
+// channel.
+//
+// Messages sent through proxies, stubs, and synchronous proxies are produced
+// by the |CodingTraits| encoder, which cannot produce an invalid layout, so
+// validating them again before every write is a redundant walk of the
+// message. With a rate of |one_in|, one message in every |one_in| sent on each
+// thread is validated. A rate of one validates every message, and a rate of
+// zero validates none.
+//
+// The default is one, unless the library is built with FIDL_TRUST_ENCODER
+// defined and debug assertions disabled, in which case it is zero.
+void SetSendValidationRate(uint32_t one_in);
+
+// The current rate. See |SetSendValidationRate|.
+uint32_t GetSendValidationRate();
+
+namespace internal {
+
+// Whether the message about to be sent on this thread should be validated.
+bool ShouldValidateSend();
+
+}  // namespace internal
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_SEND_VALIDATION_H_
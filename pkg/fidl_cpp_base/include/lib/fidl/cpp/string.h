@@ -25,6 +25,12 @@ namespace fidl {
 // the second state, operations that return an std::string return the empty
 // std::string. The null and empty states can be distinguished using the
 // |is_null| and |operator bool| methods.
+//
+// Strings short enough for the small-string buffer of std::string (22
+// characters with libc++) are decoded without allocating.
+//
+// A |StringView| decodes without copying by borrowing the characters from the
+// message for as long as the |Decoder| is alive.
 class StringPtr {
  public:
   StringPtr();
@@ -179,7 +185,29 @@ inline std::ostream& operator<<(std::ostream& out, const StringPtr& str) {
 
 template <>
 struct CodingTraits<StringPtr>
-    : public EncodableCodingTraits<StringPtr, sizeof(fidl_string_t)> {};
+    : public EncodableCodingTraits<StringPtr, sizeof(fidl_string_t),
+                                   kUnbounded, 0u> {
+  static void EncodedSize(const StringPtr& value, EncodingSize* size) {
+    if (!value.is_null())
+      size->bytes += internal::AlignedSize(value->size());
+  }
+};
+
+// A |StringView| borrows its characters from the message held by the
+// |Decoder| it was decoded with. See |CodingTraits<VectorView<T>>| for the
+// lifetime rules.
+template <>
+struct CodingTraits<StringView> {
+  static constexpr size_t encoded_size = sizeof(fidl_string_t);
+  static constexpr uint32_t max_out_of_line = kUnbounded;
+  static constexpr uint32_t max_handles = 0u;
+  static void Encode(Encoder* encoder, StringView* value, size_t offset);
+  static void Decode(Decoder* decoder, StringView* value, size_t offset);
+  static void EncodedSize(const StringView& value, EncodingSize* size) {
+    if (!value.is_null())
+      size->bytes += internal::AlignedSize(value.size());
+  }
+};
 
 }  // namespace fidl
 
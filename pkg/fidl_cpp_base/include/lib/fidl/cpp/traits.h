@@ -30,6 +30,31 @@ template <> struct IsPrimitive<float> : public std::true_type {};
 template <> struct IsPrimitive<double> : public std::true_type {};
 // clang-format on
 
+// Whether a contiguous sequence of |T| has the same layout in memory as on the
+// wire, so that vectors and arrays of |T| can be encoded and decoded with a
+// single memcpy.
+//
+// True for the primitive types other than bool, whose std::vector is packed.
+// Generated code may specialize this for structs made only of such fields
+// with no padding.
+template <typename T>
+struct IsMemcpyCompatible
+    : public std::integral_constant<bool, IsPrimitive<T>::value &&
+                                              !std::is_same<T, bool>::value> {};
+
+// Whether two contiguous sequences of |T| are equal exactly when their bytes
+// are, so that vectors and arrays of |T| can be compared with a single
+// memcmp.
+//
+// True for the integer types. Not for bool, whose std::vector is packed, nor
+// for floating-point types, whose NaNs differ from themselves and whose zeros
+// compare equal with different bytes. Generated code may specialize this for
+// structs made only of such fields with no padding.
+template <typename T>
+struct IsMemcmpCompatible
+    : public std::integral_constant<bool, IsMemcpyCompatible<T>::value &&
+                                              std::is_integral<T>::value> {};
+
 }  // namespace fidl
 
 #endif  // LIB_FIDL_CPP_TRAITS_H_
@@ -22,6 +22,11 @@ namespace fidl {
 //
 // A VectorPtr has three states: (1) null, (2) empty, (3) contains data.  You
 // can check for the null state using the |is_null| method.
+//
+// Decoding into a VectorPtr copies the elements out of the message. Messages
+// that carry large vectors of primitives can declare the field as a
+// |VectorView<T>| instead, which borrows the elements from the message for as
+// long as the |Decoder| is alive.
 template <typename T>
 class VectorPtr {
  public:
@@ -139,12 +144,8 @@ inline bool operator==(const VectorPtr<T>& lhs, const VectorPtr<T>& rhs) {
   if (lhs->size() != rhs->size()) {
     return false;
   }
-  for (size_t i = 0; i < lhs->size(); ++i) {
-    if (!Equals(lhs->at(i), rhs->at(i))) {
-      return false;
-    }
-  }
-  return true;
+  return internal::ElementsEqual(*lhs, *rhs, lhs->size(),
+                                 IsMemcmpCompatible<T>());
 }
 
 template <class T>
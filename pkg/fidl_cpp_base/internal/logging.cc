@@ -8,43 +8,138 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <atomic>
+#include <chrono>
+
 namespace fidl {
 namespace internal {
+namespace {
+
+// Errors are reported at most |kMaxReportsPerWindow| times per type in each
+// |kReportWindow|, so that a peer that keeps sending bad messages cannot turn
+// error reporting into a hot path. The number of reports dropped is printed
+// with the next report that gets through.
+constexpr uint32_t kMaxReportsPerWindow = 10u;
+constexpr std::chrono::nanoseconds kReportWindow = std::chrono::seconds(1);
+constexpr size_t kReportCounterSlots = 128u;
+
+struct ReportCounter {
+  std::atomic<const fidl_type_t*> type;
+  std::atomic<int64_t> window_start;
+  std::atomic<uint32_t> reports;
+  std::atomic<uint64_t> suppressed;
+};
+
+ReportCounter g_report_counters[kReportCounterSlots];
+
+// Returns the counter for |type|, claiming one if needed, or nullptr if the
+// table is full. Slots are never released.
+ReportCounter* FindReportCounter(const fidl_type_t* type) {
+  uintptr_t key = reinterpret_cast<uintptr_t>(type);
+  key ^= key >> 17;
+  const size_t start = static_cast<size_t>(key) % kReportCounterSlots;
+  for (size_t i = 0; i < kReportCounterSlots; ++i) {
+    ReportCounter* counter =
+        &g_report_counters[(start + i) % kReportCounterSlots];
+    const fidl_type_t* current = counter->type.load(std::memory_order_acquire);
+    if (current == nullptr &&
+        counter->type.compare_exchange_strong(current, type,
+                                              std::memory_order_acq_rel)) {
+      return counter;
+    }
+    if (current == type)
+      return counter;
+  }
+  return nullptr;
+}
+
+// Returns whether an error about |type| should be printed now. If so, stores
+// the number of errors about |type| that were dropped since the last one
+// printed in |out_suppressed|.
+bool ShouldReport(const fidl_type_t* type, uint64_t* out_suppressed) {
+  *out_suppressed = 0u;
+  ReportCounter* counter = type ? FindReportCounter(type) : nullptr;
+  if (!counter)
+    return true;
+  const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now().time_since_epoch())
+                          .count();
+  int64_t window_start = counter->window_start.load(std::memory_order_relaxed);
+  if (now - window_start >= kReportWindow.count() &&
+      counter->window_start.compare_exchange_strong(
+          window_start, now, std::memory_order_relaxed)) {
+    counter->reports.store(0u, std::memory_order_relaxed);
+  }
+  if (counter->reports.fetch_add(1u, std::memory_order_relaxed) <
+      kMaxReportsPerWindow) {
+    *out_suppressed = counter->suppressed.exchange(0u, std::memory_order_relaxed);
+    return true;
+  }
+  counter->suppressed.fetch_add(1u, std::memory_order_relaxed);
+  return false;
+}
+
+// Formats a note about dropped reports into |buffer|, or returns an empty
+// string if none were dropped.
+const char* SuppressedSuffix(uint64_t suppressed, char* buffer, size_t size) {
+  if (suppressed == 0u)
+    return "";
+  snprintf(buffer, size, " (%" PRIu64 " similar errors suppressed)",
+           suppressed);
+  return buffer;
+}
+
+}  // namespace
 
 void ReportEncodingError(const Message& message, const fidl_type_t* type,
                          const char* error_msg, const char* file, int line) {
+  uint64_t suppressed;
+  if (!ShouldReport(type, &suppressed))
+    return;
+  char suffix[64];
   char type_name[1024];
   size_t type_name_length =
       fidl_format_type_name(type, type_name, sizeof(type_name));
   fprintf(stderr,
           "fidl encoding error at %s:%d: %s, "
-          "type %.*s, %" PRIu32 " bytes, %" PRIu32 " handles\n",
+          "type %.*s, %" PRIu32 " bytes, %" PRIu32 " handles%s\n",
           file, line, error_msg, static_cast<int>(type_name_length), type_name,
-          message.bytes().actual(), message.handles().actual());
+          message.bytes().actual(), message.handles().actual(),
+          SuppressedSuffix(suppressed, suffix, sizeof(suffix)));
 }
 
 void ReportDecodingError(const Message& message, const fidl_type_t* type,
                          const char* error_msg, const char* file, int line) {
+  uint64_t suppressed;
+  if (!ShouldReport(type, &suppressed))
+    return;
+  char suffix[64];
   char type_name[1024];
   size_t type_name_length =
       fidl_format_type_name(type, type_name, sizeof(type_name));
   fprintf(stderr,
           "fidl decoding error at %s:%d: %s, "
-          "type %.*s, %" PRIu32 " bytes, %" PRIu32 " handles\n",
+          "type %.*s, %" PRIu32 " bytes, %" PRIu32 " handles%s\n",
           file, line, error_msg, static_cast<int>(type_name_length), type_name,
-          message.bytes().actual(), message.handles().actual());
+          message.bytes().actual(), message.handles().actual(),
+          SuppressedSuffix(suppressed, suffix, sizeof(suffix)));
 }
 
 void ReportChannelWritingError(const Message& message, const fidl_type_t* type,
                                zx_status_t status, const char* file, int line) {
+  uint64_t suppressed;
+  if (!ShouldReport(type, &suppressed))
+    return;
+  char suffix[64];
   char type_name[1024];
   size_t type_name_length =
       fidl_format_type_name(type, type_name, sizeof(type_name));
   fprintf(stderr,
           "fidl channel writing error at %s:%d: zx_status_t %d, "
-          "type %.*s, %" PRIu32 " bytes, %" PRIu32 " handles\n",
+          "type %.*s, %" PRIu32 " bytes, %" PRIu32 " handles%s\n",
           file, line, status, static_cast<int>(type_name_length), type_name,
-          message.bytes().actual(), message.handles().actual());
+          message.bytes().actual(), message.handles().actual(),
+          SuppressedSuffix(suppressed, suffix, sizeof(suffix)));
 }
 
 }  // namespace internal
@@ -0,0 +1,50 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/send_validation.h"
+
+#include <zircon/assert.h>
+
+#include <atomic>
+
+namespace fidl {
+namespace {
+
+#if defined(FIDL_TRUST_ENCODER) && !ZX_DEBUG_ASSERT_IMPLEMENTED
+constexpr uint32_t kDefaultSendValidationRate = 0u;
+#else
+constexpr uint32_t kDefaultSendValidationRate = 1u;
+#endif
+
+std::atomic<uint32_t> g_send_validation_rate{kDefaultSendValidationRate};
+
+// Counted per thread so that sampling does not contend between threads.
+thread_local uint32_t g_sends_until_validation = 0u;
+
+}  // namespace
+
+void SetSendValidationRate(uint32_t one_in) {
+  g_send_validation_rate.store(one_in, std::memory_order_relaxed);
+}
+
+uint32_t GetSendValidationRate() {
+  return g_send_validation_rate.load(std::memory_order_relaxed);
+}
+
+namespace internal {
+
+bool ShouldValidateSend() {
+  const uint32_t rate = g_send_validation_rate.load(std::memory_order_relaxed);
+  if (rate <= 1u)
+    return rate == 1u;
+  if (g_sends_until_validation == 0u || g_sends_until_validation > rate) {
+    g_sends_until_validation = rate - 1u;
+    return true;
+  }
+  --g_sends_until_validation;
+  return false;
+}
+
+}  // namespace internal
+}  // namespace fidl
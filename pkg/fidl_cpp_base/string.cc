@@ -52,10 +52,36 @@ void StringPtr::Encode(Encoder* encoder, size_t offset) {
 void StringPtr::Decode(Decoder* decoder, StringPtr* value, size_t offset) {
   fidl_string_t* string = decoder->GetPtr<fidl_string_t>(offset);
   if (string->data) {
-    value->reset(std::string(string->data, string->size));
+    // Assign in place rather than building a temporary std::string: short
+    // strings land directly in the inline buffer of |str_| and longer ones
+    // reuse whatever capacity |value| already has.
+    value->str_.assign(string->data, string->size);
+    value->is_null_ = false;
   } else {
-    *value = StringPtr();
+    value->reset();
   }
 }
 
+void CodingTraits<StringView>::Encode(Encoder* encoder, StringView* value,
+                                      size_t offset) {
+  fidl_string_t* string = encoder->GetPtr<fidl_string_t>(offset);
+  if (value->is_null()) {
+    string->size = 0u;
+    string->data = reinterpret_cast<char*>(FIDL_ALLOC_ABSENT);
+  } else {
+    string->size = value->size();
+    string->data = reinterpret_cast<char*>(FIDL_ALLOC_PRESENT);
+    size_t base = encoder->Alloc(value->size());
+    char* payload = encoder->GetPtr<char>(base);
+    memcpy(payload, value->data(), value->size());
+  }
+}
+
+void CodingTraits<StringView>::Decode(Decoder* decoder, StringView* value,
+                                      size_t offset) {
+  fidl_string_t* string = decoder->GetPtr<fidl_string_t>(offset);
+  value->set_data(string->data);
+  value->set_size(string->data ? string->size : 0u);
+}
+
 }  // namespace fidl
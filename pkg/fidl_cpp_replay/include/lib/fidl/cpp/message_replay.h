@@ -0,0 +1,117 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_MESSAGE_REPLAY_H_
+#define LIB_FIDL_CPP_MESSAGE_REPLAY_H_
+
+#include <lib/async-testutils/test_dispatcher.h>
+#include <lib/fidl/cpp/binding.h>
+#include <lib/fidl/cpp/dispatch_stats.h>
+#include <lib/fidl/cpp/message_capture.h>
+#include <lib/zx/channel.h>
+#include <lib/zx/handle.h>
+#include <lib/zx/time.h>
+#include <stdint.h>
+#include <zircon/types.h>
+
+#include <vector>
+
+namespace fidl {
+
+// Replays a capture made by |MessageCapture| into a |Binding|, to load a
+// server with the messages and timing of production in a test or benchmark.
+//
+// The binding is bound to a channel on an |async::TestDispatcher|, whose
+// virtual time advances to the time of each message before it is sent, so the
+// server's timers fire as they did when the capture was made, without waiting
+// for them. Everything else about a run is deterministic too. Each handle of
+// a captured message is replaced with a new object of the same type; the
+// peers of channels, sockets and event pairs are kept open until the replay is
+// destroyed. Messages with handles of other types are skipped. The server's
+// replies and events are read and discarded.
+//
+// How long each ordinal took to read and to dispatch, which includes decoding
+// the message and running the handler, is recorded in |stats()| on the real
+// clock.
+//
+// # Example
+//
+//   async::TestDispatcher dispatcher;
+//   fidl::Binding<fuchsia::ledger::Page> binding(&page_impl);
+//   fidl::MessageReplay replay(&dispatcher);
+//   replay.Bind(&binding);
+//   fidl::MessageReplay::Summary summary;
+//   zx_status_t status = replay.Run("/data/page.fidlcap", {}, &summary);
+//   for (const auto& ordinal : replay.stats().ordinals()) { ... }
+//
+// This class is thread-hostile.
+class MessageReplay {
+ public:
+  struct Options {
+    // The messages of the capture to send: those read, for a capture of a
+    // |Binding|, or those written, for a capture of an |InterfacePtr|.
+    MessageCapture::Direction direction = MessageCapture::kRead;
+
+    // Whether to wait until the time of each message before sending it.
+    // Otherwise messages are sent as fast as the server takes them.
+    bool keep_timing = true;
+  };
+
+  struct Summary {
+    uint64_t messages_sent = 0u;
+    // Messages that carried a handle of a type that cannot be made.
+    uint64_t messages_skipped = 0u;
+    // Replies and events read from the server.
+    uint64_t messages_received = 0u;
+    // The virtual time the replay took.
+    zx::duration duration;
+  };
+
+  explicit MessageReplay(async::TestDispatcher* dispatcher);
+  ~MessageReplay();
+
+  MessageReplay(const MessageReplay&) = delete;
+  MessageReplay& operator=(const MessageReplay&) = delete;
+
+  // Binds |binding| to a new channel on the dispatcher to replay messages
+  // into, and records its dispatch statistics into |stats()|.
+  template <typename Interface, typename ImplPtr>
+  zx_status_t Bind(Binding<Interface, ImplPtr>* binding) {
+    zx::channel server;
+    zx_status_t status = zx::channel::create(0u, &client_, &server);
+    if (status != ZX_OK)
+      return status;
+    binding->set_dispatch_stats(&stats_);
+    return binding->Bind(std::move(server), dispatcher_);
+  }
+
+  // Sends the messages of the capture at |path| to the bound server, running
+  // the dispatcher after each one, and adds up what happened in |summary|.
+  //
+  // Returns |ZX_ERR_NOT_FOUND| if the capture cannot be opened, |ZX_ERR_IO| if
+  // it is malformed or truncated, or the error that writing a message failed
+  // with, such as |ZX_ERR_PEER_CLOSED| once the server has closed the channel.
+  zx_status_t Run(const char* path, const Options& options, Summary* summary);
+
+  // The dispatch statistics of the bound server.
+  const DispatchStats& stats() const { return stats_; }
+
+ private:
+  // Makes a new object of the |zx_obj_type_t| |type| in |handle|.
+  zx_status_t MakeHandle(uint32_t type, zx_handle_t* handle);
+
+  // Reads and discards the messages the server has sent.
+  void DrainMessages(Summary* summary);
+
+  async::TestDispatcher* const dispatcher_;
+  zx::channel client_;
+  DispatchStats stats_;
+  // The peers of the handles sent, kept open so the server can use them.
+  std::vector<zx::handle> peers_;
+  std::vector<uint8_t> buffer_;
+};
+
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_MESSAGE_REPLAY_H_
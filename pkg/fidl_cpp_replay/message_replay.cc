@@ -0,0 +1,165 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fidl/cpp/message_replay.h"
+
+#include <lib/zx/event.h>
+#include <lib/zx/eventpair.h>
+#include <lib/zx/socket.h>
+#include <lib/zx/vmo.h>
+#include <stdio.h>
+#include <zircon/syscalls.h>
+
+#include <utility>
+
+namespace fidl {
+namespace {
+
+constexpr size_t kAlignment = 8u;
+
+// The size of the VMOs sent in place of captured ones.
+constexpr uint64_t kVmoSize = 4096u;
+
+size_t Align(size_t size) { return (size + kAlignment - 1) & ~(kAlignment - 1); }
+
+bool ReadFully(FILE* file, void* data, size_t size) {
+  return size == 0u || fread(data, size, 1u, file) == 1u;
+}
+
+}  // namespace
+
+MessageReplay::MessageReplay(async::TestDispatcher* dispatcher)
+    : dispatcher_(dispatcher), buffer_(ZX_CHANNEL_MAX_MSG_BYTES) {}
+
+MessageReplay::~MessageReplay() = default;
+
+zx_status_t MessageReplay::Run(const char* path, const Options& options,
+                               Summary* summary) {
+  FILE* file = fopen(path, "rb");
+  if (!file)
+    return ZX_ERR_NOT_FOUND;
+  MessageCaptureHeader header;
+  if (!ReadFully(file, &header, sizeof(header)) ||
+      header.magic != MessageCaptureHeader::kMagic ||
+      header.version != MessageCaptureHeader::kVersion) {
+    fclose(file);
+    return ZX_ERR_IO;
+  }
+
+  const zx::time start = dispatcher_->Now();
+  std::vector<uint8_t> bytes(Align(ZX_CHANNEL_MAX_MSG_BYTES));
+  uint32_t types[ZX_CHANNEL_MAX_MSG_HANDLES];
+  zx_handle_t handles[ZX_CHANNEL_MAX_MSG_HANDLES];
+  zx_status_t status = ZX_OK;
+  MessageCaptureRecord record;
+  while (ReadFully(file, &record, sizeof(record))) {
+    if (record.num_bytes > ZX_CHANNEL_MAX_MSG_BYTES ||
+        record.num_handles > ZX_CHANNEL_MAX_MSG_HANDLES ||
+        !ReadFully(file, bytes.data(), Align(record.num_bytes)) ||
+        !ReadFully(file, types,
+                   Align(record.num_handles * sizeof(uint32_t)))) {
+      status = ZX_ERR_IO;
+      break;
+    }
+    if (record.direction != options.direction)
+      continue;
+
+    uint32_t num_handles = 0u;
+    for (; num_handles < record.num_handles; ++num_handles) {
+      if (MakeHandle(types[num_handles], &handles[num_handles]) != ZX_OK)
+        break;
+    }
+    if (num_handles < record.num_handles) {
+      zx_handle_close_many(handles, num_handles);
+      ++summary->messages_skipped;
+      continue;
+    }
+
+    if (options.keep_timing)
+      dispatcher_->RunUntil(start + zx::nsec(record.time));
+    // The write consumes the handles, whether or not it succeeds.
+    status = client_.write(0u, bytes.data(), record.num_bytes, handles,
+                           num_handles);
+    if (status != ZX_OK)
+      break;
+    ++summary->messages_sent;
+    dispatcher_->RunUntilIdle();
+    DrainMessages(summary);
+  }
+  fclose(file);
+
+  dispatcher_->RunUntilIdle();
+  DrainMessages(summary);
+  summary->duration += dispatcher_->Now() - start;
+  return status;
+}
+
+zx_status_t MessageReplay::MakeHandle(uint32_t type, zx_handle_t* handle) {
+  zx_status_t status;
+  switch (type) {
+    case ZX_OBJ_TYPE_CHANNEL: {
+      zx::channel channel, peer;
+      status = zx::channel::create(0u, &channel, &peer);
+      if (status != ZX_OK)
+        return status;
+      peers_.emplace_back(peer.release());
+      *handle = channel.release();
+      return ZX_OK;
+    }
+    case ZX_OBJ_TYPE_SOCKET: {
+      zx::socket socket, peer;
+      status = zx::socket::create(0u, &socket, &peer);
+      if (status != ZX_OK)
+        return status;
+      peers_.emplace_back(peer.release());
+      *handle = socket.release();
+      return ZX_OK;
+    }
+    case ZX_OBJ_TYPE_EVENTPAIR: {
+      zx::eventpair eventpair, peer;
+      status = zx::eventpair::create(0u, &eventpair, &peer);
+      if (status != ZX_OK)
+        return status;
+      peers_.emplace_back(peer.release());
+      *handle = eventpair.release();
+      return ZX_OK;
+    }
+    case ZX_OBJ_TYPE_EVENT: {
+      zx::event event;
+      status = zx::event::create(0u, &event);
+      if (status != ZX_OK)
+        return status;
+      *handle = event.release();
+      return ZX_OK;
+    }
+    case ZX_OBJ_TYPE_VMO: {
+      zx::vmo vmo;
+      status = zx::vmo::create(kVmoSize, 0u, &vmo);
+      if (status != ZX_OK)
+        return status;
+      *handle = vmo.release();
+      return ZX_OK;
+    }
+    default:
+      return ZX_ERR_NOT_SUPPORTED;
+  }
+}
+
+void MessageReplay::DrainMessages(Summary* summary) {
+  zx_handle_t handles[ZX_CHANNEL_MAX_MSG_HANDLES];
+  for (;;) {
+    uint32_t num_bytes = 0u;
+    uint32_t num_handles = 0u;
+    zx_status_t status =
+        client_.read(0u, buffer_.data(), static_cast<uint32_t>(buffer_.size()),
+                     &num_bytes, handles, ZX_CHANNEL_MAX_MSG_HANDLES,
+                     &num_handles);
+    if (status != ZX_OK)
+      return;
+    zx_handle_close_many(handles, num_handles);
+    ++summary->messages_received;
+  }
+}
+
+}  // namespace fidl
@@ -169,7 +169,13 @@ bool operator>=(const InterfaceHandle<T>& lhs, const InterfaceHandle<T>& rhs) {
 
 template <typename T>
 struct CodingTraits<InterfaceHandle<T>>
-    : public EncodableCodingTraits<InterfaceHandle<T>, sizeof(zx_handle_t)> {};
+    : public EncodableCodingTraits<InterfaceHandle<T>, sizeof(zx_handle_t), 0u,
+                                   1u> {
+  static void EncodedSize(const InterfaceHandle<T>& value, EncodingSize* size) {
+    if (value.is_valid())
+      ++size->handles;
+  }
+};
 
 template <typename T>
 inline zx_status_t Clone(const InterfaceHandle<T>& value,
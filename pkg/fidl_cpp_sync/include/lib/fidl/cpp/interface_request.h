@@ -116,9 +116,12 @@ class InterfaceRequest {
 // request should be "accepted", then it should "connect" ("take ownership
 // of") request. Otherwise, it can simply drop |request| (as implied by the
 // interface).
+//
+// Handlers often capture a binding set or another function, so they are given
+// room to store such targets inline.
 template <typename Interface>
 using InterfaceRequestHandler =
-    fit::function<void(fidl::InterfaceRequest<Interface> request)>;
+    fit::callback_function<void(fidl::InterfaceRequest<Interface> request)>;
 
 // Equality.
 template <typename T>
@@ -154,7 +157,13 @@ bool operator>=(const InterfaceRequest<T>& lhs,
 
 template <typename T>
 struct CodingTraits<InterfaceRequest<T>>
-    : public EncodableCodingTraits<InterfaceRequest<T>, sizeof(zx_handle_t)> {};
+    : public EncodableCodingTraits<InterfaceRequest<T>, sizeof(zx_handle_t), 0u,
+                                   1u> {
+  static void EncodedSize(const InterfaceRequest<T>& value, EncodingSize* size) {
+    if (value.is_valid())
+      ++size->handles;
+  }
+};
 
 template <typename T>
 inline zx_status_t Clone(const InterfaceRequest<T>& value,
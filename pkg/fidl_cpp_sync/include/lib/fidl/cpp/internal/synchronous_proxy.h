@@ -7,11 +7,35 @@
 
 #include <lib/fidl/cpp/message.h>
 #include <lib/zx/channel.h>
+#include <lib/zx/time.h>
 #include <zircon/fidl.h>
 
+#include <atomic>
+#include <mutex>
+
 namespace fidl {
 namespace internal {
 
+// One call in a batch sent with |SynchronousProxy::CallMany|.
+struct SynchronousCall {
+  // The type of |request|, which is validated before it is sent.
+  const fidl_type_t* request_type;
+
+  // The type the response is decoded as.
+  const fidl_type_t* response_type;
+
+  // The encoded request. Its transaction ID is assigned by |CallMany|.
+  Message request;
+
+  // Receives the decoded response. The memory that backs it must be large
+  // enough for the response.
+  Message* response;
+
+  // Set by |CallMany| to the outcome of this call: ZX_OK if |response| holds
+  // the decoded response.
+  zx_status_t status;
+};
+
 // Manages the client state for a synchronous interface.
 //
 // A |SynchronousProxy| manages the client state for a sychronous interface.
@@ -47,12 +71,54 @@ class SynchronousProxy {
   // Blocks until the remote endpoint replied.
   //
   // Returns an error if validation, writing, reading, or decoding fails.
+  //
+  // The response is read into the memory that backs |response|, so callers
+  // that make many calls can avoid allocating a worst-case buffer for each
+  // one by backing |response| with a |MessageBuffer| drawn from
+  // |MessageBufferPool::GetForCurrentThread()|, or with a buffer they reuse.
   zx_status_t Call(const fidl_type_t* request_type,
                    const fidl_type_t* response_type, Message request,
                    Message* response);
 
+  // Like |Call|, but stops waiting for the response at |deadline|.
+  //
+  // Returns ZX_ERR_TIMED_OUT if no response arrived by |deadline|. Later
+  // calls match responses by transaction ID, so they never mistake a response
+  // that arrives after the deadline for their own.
+  zx_status_t Call(const fidl_type_t* request_type,
+                   const fidl_type_t* response_type, Message request,
+                   Message* response, zx::time deadline);
+
+  // Sends every request in |calls| and then waits for all of their responses,
+  // so independent calls cost one round trip instead of one each.
+  //
+  // The requests are written back-to-back, each with its own transaction ID,
+  // and the responses are matched to their calls by transaction ID in
+  // whatever order they arrive. Each call reports its own outcome in its
+  // |status|. Calls still unanswered at |deadline| fail with
+  // ZX_ERR_TIMED_OUT.
+  //
+  // Returns the first error among the calls, or ZX_OK if every call
+  // succeeded. Batches from different threads are serialized, but can run
+  // alongside |Call|.
+  zx_status_t CallMany(SynchronousCall* calls, size_t count,
+                       zx::time deadline = zx::time::infinite());
+
  private:
+  // Reads the messages waiting in the channel and hands each response to the
+  // unanswered call in |calls| with the same transaction ID. Decrements
+  // |*pending| for each call answered. Other messages are discarded.
+  zx_status_t ReadResponses(SynchronousCall* calls, size_t count,
+                            size_t* pending);
+
   zx::channel channel_;
+
+  // Serializes |CallMany|, which reads responses from the channel directly.
+  std::mutex call_many_mutex_;
+
+  // Transaction IDs handed out by |CallMany|. They have the high bit clear,
+  // so they never collide with the IDs the kernel assigns in |Call|.
+  std::atomic<uint32_t> next_txid_{1u};
 };
 
 }  // namespace internal
@@ -0,0 +1,98 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_SHARED_SYNCHRONOUS_INTERFACE_PTR_H_
+#define LIB_FIDL_CPP_SHARED_SYNCHRONOUS_INTERFACE_PTR_H_
+
+#include <lib/zx/channel.h>
+
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "lib/fidl/cpp/interface_handle.h"
+
+namespace fidl {
+
+// A synchronous client interface to a remote implementation of |Interface|
+// that many threads can share, including while it is rebound.
+//
+// Calls on a bound |SynchronousInterfacePtr| can already be made from several
+// threads at once: synchronous calls use |zx_channel_call|, and the kernel
+// routes each reply to the thread waiting for its transaction ID, so any
+// number of threads can share one channel without a reader thread or a table
+// of waiters in userspace. What a |SynchronousInterfacePtr| cannot do is be
+// bound or reset while other threads are calling through it.
+//
+// A |SharedSynchronousInterfacePtr| can. |get| returns a reference to the
+// current proxy that keeps it alive for as long as the caller holds it, so
+// rebinding or resetting the pointer on one thread never destroys a proxy that
+// another thread is in the middle of calling. The old channel is closed once
+// the last such reference is released.
+//
+// This class is thread-safe.
+template <typename Interface>
+class SharedSynchronousInterfacePtr {
+ public:
+  using InterfaceSync = typename Interface::Sync_;
+
+  // Creates an unbound |SharedSynchronousInterfacePtr|.
+  SharedSynchronousInterfacePtr() = default;
+
+  // Creates a |SharedSynchronousInterfacePtr| bound to |handle|.
+  explicit SharedSynchronousInterfacePtr(InterfaceHandle<Interface> handle) {
+    Bind(std::move(handle));
+  }
+
+  SharedSynchronousInterfacePtr(const SharedSynchronousInterfacePtr&) = delete;
+  SharedSynchronousInterfacePtr& operator=(
+      const SharedSynchronousInterfacePtr&) = delete;
+
+  // Binds to |channel|, which must speak |Interface|, replacing the current
+  // binding. An invalid |channel| unbinds.
+  //
+  // Threads still calling through the previous binding finish their calls on
+  // the previous channel.
+  void Bind(zx::channel channel) {
+    std::shared_ptr<typename InterfaceSync::Proxy_> proxy;
+    if (channel)
+      proxy = std::make_shared<typename InterfaceSync::Proxy_>(
+          std::move(channel));
+    std::lock_guard<std::mutex> lock(mutex_);
+    proxy_.swap(proxy);
+    // The previous proxy, now in |proxy|, is released outside the lock.
+  }
+
+  // Binds to |handle|, replacing the current binding. See |Bind|.
+  void Bind(InterfaceHandle<Interface> handle) { Bind(handle.TakeChannel()); }
+
+  // Unbinds. The channel is closed once no thread is calling through it.
+  void Reset() { Bind(zx::channel()); }
+
+  // Whether this |SharedSynchronousInterfacePtr| is currently bound.
+  bool is_bound() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<bool>(proxy_);
+  }
+
+  // The current proxy, or null if unbound.
+  //
+  // Hold the returned pointer for the duration of a call, or of a series of
+  // calls that should go to the same channel:
+  //
+  //   if (auto table = shared_table.get())
+  //     table->Describe(&description);
+  std::shared_ptr<InterfaceSync> get() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return proxy_;
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::shared_ptr<typename InterfaceSync::Proxy_> proxy_;
+};
+
+}  // namespace fidl
+
+#endif  // LIB_FIDL_CPP_SHARED_SYNCHRONOUS_INTERFACE_PTR_H_
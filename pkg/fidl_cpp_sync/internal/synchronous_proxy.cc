@@ -4,10 +4,14 @@
 
 #include "lib/fidl/cpp/internal/synchronous_proxy.h"
 
+#include <lib/fidl/cpp/message_buffer.h>
+#include <string.h>
+
 #include <memory>
 #include <utility>
 
 #include "lib/fidl/cpp/internal/logging.h"
+#include "lib/fidl/cpp/send_validation.h"
 
 namespace fidl {
 namespace internal {
@@ -20,11 +24,13 @@ SynchronousProxy::~SynchronousProxy() = default;
 zx::channel SynchronousProxy::TakeChannel() { return std::move(channel_); }
 
 zx_status_t SynchronousProxy::Send(const fidl_type_t* type, Message message) {
-  const char* error_msg = nullptr;
-  zx_status_t status = message.Validate(type, &error_msg);
-  if (status != ZX_OK) {
-    FIDL_REPORT_ENCODING_ERROR(message, type, error_msg);
-    return status;
+  if (ShouldValidateSend()) {
+    const char* error_msg = nullptr;
+    zx_status_t status = message.Validate(type, &error_msg);
+    if (status != ZX_OK) {
+      FIDL_REPORT_ENCODING_ERROR(message, type, error_msg);
+      return status;
+    }
   }
   return message.Write(channel_.get(), 0);
 }
@@ -32,15 +38,27 @@ zx_status_t SynchronousProxy::Send(const fidl_type_t* type, Message message) {
 zx_status_t SynchronousProxy::Call(const fidl_type_t* request_type,
                                    const fidl_type_t* response_type,
                                    Message request, Message* response) {
-  const char* error_msg = nullptr;
-  zx_status_t status = request.Validate(request_type, &error_msg);
-  if (status != ZX_OK) {
-    FIDL_REPORT_ENCODING_ERROR(request, request_type, error_msg);
-    return status;
+  return Call(request_type, response_type, std::move(request), response,
+              zx::time::infinite());
+}
+
+zx_status_t SynchronousProxy::Call(const fidl_type_t* request_type,
+                                   const fidl_type_t* response_type,
+                                   Message request, Message* response,
+                                   zx::time deadline) {
+  if (ShouldValidateSend()) {
+    const char* error_msg = nullptr;
+    zx_status_t status = request.Validate(request_type, &error_msg);
+    if (status != ZX_OK) {
+      FIDL_REPORT_ENCODING_ERROR(request, request_type, error_msg);
+      return status;
+    }
   }
-  status = request.Call(channel_.get(), 0, ZX_TIME_INFINITE, response);
+  zx_status_t status =
+      request.Call(channel_.get(), 0, deadline.get(), response);
   if (status != ZX_OK)
     return status;
+  const char* error_msg = nullptr;
   status = response->Decode(response_type, &error_msg);
   if (status != ZX_OK) {
     FIDL_REPORT_DECODING_ERROR(*response, response_type, error_msg);
@@ -49,5 +67,117 @@ zx_status_t SynchronousProxy::Call(const fidl_type_t* request_type,
   return ZX_OK;
 }
 
+zx_status_t SynchronousProxy::CallMany(SynchronousCall* calls, size_t count,
+                                       zx::time deadline) {
+  std::lock_guard<std::mutex> lock(call_many_mutex_);
+
+  // Unanswered calls hold ZX_ERR_TIMED_OUT, which is also what they report if
+  // they are still unanswered at the deadline.
+  size_t pending = 0u;
+  zx_status_t write_status = ZX_OK;
+  for (size_t i = 0; i < count; ++i) {
+    SynchronousCall& call = calls[i];
+    if (write_status != ZX_OK) {
+      call.status = write_status;
+      continue;
+    }
+    if (ShouldValidateSend()) {
+      const char* error_msg = nullptr;
+      call.status = call.request.Validate(call.request_type, &error_msg);
+      if (call.status != ZX_OK) {
+        FIDL_REPORT_ENCODING_ERROR(call.request, call.request_type, error_msg);
+        continue;
+      }
+    }
+    zx_txid_t txid;
+    do {
+      txid = next_txid_.fetch_add(1u, std::memory_order_relaxed) & 0x7FFFFFFF;
+    } while (!txid);
+    call.request.set_txid(txid);
+    write_status = call.request.Write(channel_.get(), 0);
+    if (write_status != ZX_OK) {
+      call.status = write_status;
+      continue;
+    }
+    call.status = ZX_ERR_TIMED_OUT;
+    ++pending;
+  }
+
+  while (pending) {
+    zx_signals_t observed = ZX_SIGNAL_NONE;
+    zx_status_t status = channel_.wait_one(
+        ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED, deadline, &observed);
+    if (status == ZX_OK) {
+      if (observed & ZX_CHANNEL_READABLE) {
+        status = ReadResponses(calls, count, &pending);
+        if (status == ZX_OK)
+          continue;
+      } else {
+        status = ZX_ERR_PEER_CLOSED;
+      }
+    }
+    if (status != ZX_ERR_TIMED_OUT) {
+      for (size_t i = 0; i < count; ++i) {
+        if (calls[i].status == ZX_ERR_TIMED_OUT)
+          calls[i].status = status;
+      }
+    }
+    break;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    if (calls[i].status != ZX_OK)
+      return calls[i].status;
+  }
+  return ZX_OK;
+}
+
+zx_status_t SynchronousProxy::ReadResponses(SynchronousCall* calls,
+                                            size_t count, size_t* pending) {
+  MessageBuffer buffer(MessageBufferPool::GetForCurrentThread());
+  while (*pending) {
+    Message message = buffer.CreateEmptyMessage();
+    zx_status_t status = message.Read(channel_.get(), 0);
+    if (status == ZX_ERR_SHOULD_WAIT)
+      return ZX_OK;
+    if (status != ZX_OK)
+      return status;
+    if (!message.has_header())
+      continue;
+    SynchronousCall* call = nullptr;
+    for (size_t i = 0; i < count; ++i) {
+      if (calls[i].status == ZX_ERR_TIMED_OUT &&
+          calls[i].request.txid() == message.txid()) {
+        call = &calls[i];
+        break;
+      }
+    }
+    // A response to a call that has already given up, or an event, neither
+    // of which this batch is waiting for.
+    if (!call)
+      continue;
+    --*pending;
+    Message* response = call->response;
+    const uint32_t num_bytes = message.bytes().actual();
+    const uint32_t num_handles = message.handles().actual();
+    if (num_bytes > response->bytes().capacity() ||
+        num_handles > response->handles().capacity()) {
+      call->status = ZX_ERR_BUFFER_TOO_SMALL;
+      continue;
+    }
+    memcpy(response->bytes().data(), message.bytes().data(), num_bytes);
+    response->bytes().set_actual(num_bytes);
+    memcpy(response->handles().data(), message.handles().data(),
+           num_handles * sizeof(zx_handle_t));
+    response->handles().set_actual(num_handles);
+    message.ClearHandlesUnsafe();
+    const char* error_msg = nullptr;
+    call->status = response->Decode(call->response_type, &error_msg);
+    if (call->status != ZX_OK)
+      FIDL_REPORT_DECODING_ERROR(*response, call->response_type, error_msg);
+  }
+  return ZX_OK;
+}
+
 }  // namespace internal
 }  // namespace fidl
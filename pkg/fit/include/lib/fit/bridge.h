@@ -172,6 +172,57 @@ private:
     consumer_type consumer_;
 };
 
+// A |fit::bridge| whose shared state is recycled rather than allocated.
+//
+// The state is taken from a small pool kept by the calling thread, and
+// returned to the pool of whichever thread releases it last.  When the
+// completer and consumer live on the same thread, such as when both are used
+// by tasks of one |fit::single_threaded_executor|, creating a bridge thus
+// allocates no memory once the pool has warmed up.  This suits code that
+// creates a bridge for each of many short round trips.
+//
+// The completer and consumer are ordinary |fit::completer| and |fit::consumer|
+// instances and have the same semantics as those of a |fit::bridge|.  They
+// may still be used from different threads, but states released on a thread
+// other than the one that created them only help that other thread's pool.
+template <typename V, typename E>
+class local_bridge final {
+    using bridge_state = ::fit::internal::bridge_state<V, E>;
+
+public:
+    using value_type = V;
+    using error_type = E;
+    using result_type = result<value_type, error_type>;
+    using completer_type = ::fit::completer<V, E>;
+    using consumer_type = ::fit::consumer<V, E>;
+
+    local_bridge() {
+        bridge_state::create_pooled(&completer_.completion_ref_,
+                                    &consumer_.consumption_ref_);
+    }
+    local_bridge(local_bridge&& other) = default;
+    ~local_bridge() = default;
+
+    local_bridge& operator=(local_bridge&& other) = default;
+
+    // Gets a reference to the bridge's completer capability.
+    // The completer can be moved out of the bridge, if desired.
+    completer_type& completer() { return completer_; }
+    const completer_type& completer() const { return completer_; }
+
+    // Gets a reference to the bridge's consumer capability.
+    // The consumer can be moved out of the bridge, if desired.
+    consumer_type& consumer() { return consumer_; }
+    const consumer_type& consumer() const { return consumer_; }
+
+    local_bridge(const local_bridge& other) = delete;
+    local_bridge& operator=(const local_bridge& other) = delete;
+
+private:
+    completer_type completer_;
+    consumer_type consumer_;
+};
+
 // Provides a result upon completion of an asynchronous task.
 //
 // Instances of this class have single-ownership of a unique capability for
@@ -316,6 +367,7 @@ public:
 
 private:
     friend class bridge<V, E>;
+    friend class local_bridge<V, E>;
 
     completion_ref completion_ref_;
 };
@@ -415,6 +467,7 @@ public:
 
 private:
     friend class bridge<V, E>;
+    friend class local_bridge<V, E>;
 
     consumption_ref consumption_ref_;
 };
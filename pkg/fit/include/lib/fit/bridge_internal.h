@@ -5,15 +5,16 @@
 #ifndef LIB_FIT_BRIDGE_INTERNAL_H_
 #define LIB_FIT_BRIDGE_INTERNAL_H_
 
+#include <stddef.h>
+
 #include <atomic>
-#include <mutex>
+#include <new>
 #include <tuple>
 #include <type_traits>
 #include <utility>
 
 #include "promise.h"
 #include "result.h"
-#include "thread_safety.h"
 
 namespace fit {
 namespace internal {
@@ -34,6 +35,14 @@ namespace internal {
 // - When a full rendezvous between completer and consumer takes place,
 //   the bridge's disposition becomes "returned".
 // - When both refs are dropped, the bridge state is destroyed.
+//
+// The disposition lives in an atomic word and no lock is taken.  Each side
+// owns the data it writes: the completer owns |result_| until it publishes
+// it by setting |completed|, and the consumer owns |result_if_abandoned_|.
+// The consumer owns |task_| except while the |waiting| flag is set, during
+// which the completer may take it to wake the consumer; the consumer must
+// clear the flag before touching |task_| again, which fails once the
+// completer has finished.
 template <typename V, typename E>
 class bridge_state final {
 public:
@@ -48,6 +57,11 @@ public:
     static void create(completion_ref* out_completion_ref,
                        consumption_ref* out_consumption_ref);
 
+    // Same as |create()| except that the state is taken from, and eventually
+    // returned to, the pool of the thread that drops the last ref.
+    static void create_pooled(completion_ref* out_completion_ref,
+                              consumption_ref* out_consumption_ref);
+
     bool was_canceled() const;
     bool was_abandoned() const;
     void complete_or_abandon(completion_ref ref, result_type result);
@@ -58,13 +72,39 @@ public:
     bridge_state& operator=(bridge_state&&) = delete;
 
 private:
-    enum class disposition {
-        pending,
-        abandoned,
-        completed,
-        canceled,
-        returned
+    // Bits of |disposition_|.  The disposition is "pending" while none of
+    // |abandoned|, |completed|, |canceled| and |returned| is set.
+    enum disposition : uint32_t {
+        abandoned = 1u << 0,
+        completed = 1u << 1,
+        canceled = 1u << 2,
+        returned = 1u << 3,
+        // The consumer has stored its suspended task in |task_|.
+        waiting = 1u << 4,
     };
+    static constexpr uint32_t finished = abandoned | completed;
+
+    // A per-thread free list of storage for states created by
+    // |create_pooled()|, which keeps at most |max_count| of them.
+    struct pool {
+        static constexpr size_t max_count = 16;
+
+        ~pool() {
+            while (head) {
+                void* next = *static_cast<void**>(head);
+                ::operator delete(head);
+                head = next;
+            }
+            count = 0;
+        }
+
+        void* head = nullptr;
+        size_t count = 0;
+    };
+    static pool& thread_pool() {
+        static thread_local pool instance;
+        return instance;
+    }
 
     bridge_state() = default;
 
@@ -73,25 +113,28 @@ private:
     void drop_ref_and_maybe_delete_self();
     void set_result_if_abandoned(result_type result_if_abandoned);
     result_type await_result(consumption_ref* ref, ::fit::context& context);
-    void deliver_result() FIT_REQUIRES(mutex_);
-
-    mutable std::mutex mutex_;
+    result_type take_result(uint32_t prior);
 
     // Ref-count for completion and consumption.
     // There can only be one of each ref type so the initial count is 2.
     std::atomic<uint32_t> ref_count_{2};
 
     // The disposition of the bridge.
-    disposition disposition_ FIT_GUARDED(mutex_) = {disposition::pending};
+    std::atomic<uint32_t> disposition_{0};
 
     // The suspended task.
-    // Invariant: Only valid when disposition is |pending|.
-    suspended_task task_ FIT_GUARDED(mutex_);
+    // Invariant: Only valid when the disposition is |waiting|.
+    suspended_task task_;
+
+    // The result produced by the completer.
+    // Invariant: Only valid when the disposition is |completed|.
+    result_type result_;
+
+    // The result to return if the completer is abandoned, or pending.
+    result_type result_if_abandoned_;
 
-    // The result in flight.
-    // Invariant: Only valid when disposition is |pending|, |completed|,
-    // or |abandoned|.
-    result_type result_ FIT_GUARDED(mutex_);
+    // True if the state was created by |create_pooled()|.
+    bool pooled_ = false;
 };
 
 // The unique capability held by a bridge's completer.
@@ -265,28 +308,50 @@ void bridge_state<V, E>::create(completion_ref* out_completion_ref,
     *out_consumption_ref = consumption_ref(state);
 }
 
+template <typename V, typename E>
+void bridge_state<V, E>::create_pooled(completion_ref* out_completion_ref,
+                                       consumption_ref* out_consumption_ref) {
+    static_assert(alignof(bridge_state) <= alignof(max_align_t),
+                  "Over-aligned results cannot be pooled.");
+    static_assert(sizeof(bridge_state) >= sizeof(void*), "");
+    pool& p = thread_pool();
+    void* storage = p.head;
+    if (storage) {
+        p.head = *static_cast<void**>(storage);
+        p.count--;
+    } else {
+        storage = ::operator new(sizeof(bridge_state));
+    }
+    bridge_state* state = new (storage) bridge_state();
+    state->pooled_ = true;
+    *out_completion_ref = completion_ref(state);
+    *out_consumption_ref = consumption_ref(state);
+}
+
 template <typename V, typename E>
 bool bridge_state<V, E>::was_canceled() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return disposition_ == disposition::canceled;
+    return disposition_.load(std::memory_order_acquire) & canceled;
 }
 
 template <typename V, typename E>
 bool bridge_state<V, E>::was_abandoned() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return disposition_ == disposition::abandoned;
+    return disposition_.load(std::memory_order_acquire) & abandoned;
 }
 
 template <typename V, typename E>
 void bridge_state<V, E>::drop_completion_ref(bool was_completed) {
     if (!was_completed) {
         // The task was abandoned.
-        std::lock_guard<std::mutex> lock(mutex_);
-        assert(disposition_ == disposition::pending ||
-               disposition_ == disposition::canceled);
-        if (disposition_ == disposition::pending) {
-            disposition_ = disposition::abandoned;
-            deliver_result();
+        uint32_t prior = disposition_.fetch_or(abandoned,
+                                               std::memory_order_acq_rel);
+        assert(!(prior & (finished | returned)));
+        if (prior & waiting) {
+            // The consumer is asleep and cannot touch |task_| anymore.
+            if (result_if_abandoned_.is_pending()) {
+                task_.reset(); // the task has been canceled
+            } else {
+                task_.resume_task(); // we have a result so wake up the task
+            }
         }
     }
     drop_ref_and_maybe_delete_self();
@@ -295,15 +360,17 @@ void bridge_state<V, E>::drop_completion_ref(bool was_completed) {
 template <typename V, typename E>
 void bridge_state<V, E>::drop_consumption_ref(bool was_consumed) {
     if (!was_consumed) {
-        // The task was canceled.
-        std::lock_guard<std::mutex> lock(mutex_);
-        assert(disposition_ == disposition::pending ||
-               disposition_ == disposition::completed ||
-               disposition_ == disposition::abandoned);
-        if (disposition_ == disposition::pending) {
-            disposition_ = disposition::canceled;
-            result_ = ::fit::pending();
-            task_.reset(); // there is no task to wake up anymore
+        // The task was canceled, unless the completer already finished.
+        uint32_t prior = disposition_.load(std::memory_order_acquire);
+        while (!(prior & finished)) {
+            assert(!(prior & (canceled | returned)));
+            if (disposition_.compare_exchange_weak(
+                    prior, (prior & ~waiting) | canceled,
+                    std::memory_order_acq_rel, std::memory_order_acquire)) {
+                if (prior & waiting)
+                    task_.reset(); // there is no task to wake up anymore
+                break;
+            }
         }
     }
     drop_ref_and_maybe_delete_self();
@@ -311,11 +378,22 @@ void bridge_state<V, E>::drop_consumption_ref(bool was_consumed) {
 
 template <typename V, typename E>
 void bridge_state<V, E>::drop_ref_and_maybe_delete_self() {
-    uint32_t count = ref_count_.fetch_sub(1u, std::memory_order_release) - 1u;
+    uint32_t count = ref_count_.fetch_sub(1u, std::memory_order_acq_rel) - 1u;
     assert(count >= 0);
     if (count == 0) {
-        std::atomic_thread_fence(std::memory_order_acquire);
-        delete this;
+        if (!pooled_) {
+            delete this;
+            return;
+        }
+        this->~bridge_state();
+        pool& p = thread_pool();
+        if (p.count == pool::max_count) {
+            ::operator delete(this);
+            return;
+        }
+        *reinterpret_cast<void**>(this) = p.head;
+        p.head = this;
+        p.count++;
     }
 }
 
@@ -326,17 +404,15 @@ void bridge_state<V, E>::complete_or_abandon(completion_ref ref,
     if (result.is_pending())
         return; // let the ref go out of scope to abandon the task
 
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        assert(disposition_ == disposition::pending ||
-               disposition_ == disposition::canceled);
-        if (disposition_ == disposition::pending) {
-            disposition_ = disposition::completed;
-            result_ = std::move(result);
-            deliver_result();
+    if (!(disposition_.load(std::memory_order_acquire) & canceled)) {
+        result_ = std::move(result);
+        uint32_t prior = disposition_.fetch_or(completed,
+                                               std::memory_order_acq_rel);
+        assert(!(prior & (finished | returned)));
+        if ((prior & waiting) && !(prior & canceled)) {
+            task_.resume_task(); // we have a result so wake up the task
         }
     }
-    // drop the reference ouside of the lock
     ref.drop_after_completion();
 }
 
@@ -346,45 +422,49 @@ void bridge_state<V, E>::set_result_if_abandoned(
     if (result_if_abandoned.is_pending())
         return; // nothing to do
 
-    std::lock_guard<std::mutex> lock(mutex_);
-    assert(disposition_ == disposition::pending ||
-           disposition_ == disposition::completed ||
-           disposition_ == disposition::abandoned);
-    if (disposition_ == disposition::pending ||
-        disposition_ == disposition::abandoned) {
-        result_ = std::move(result_if_abandoned);
-    }
+    assert(!(disposition_.load(std::memory_order_relaxed) &
+             (canceled | returned | waiting)));
+    result_if_abandoned_ = std::move(result_if_abandoned);
 }
 
 template <typename V, typename E>
 typename bridge_state<V, E>::result_type bridge_state<V, E>::await_result(
     consumption_ref* ref, ::fit::context& context) {
     assert(ref->get() == this);
-    result_type result;
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        assert(disposition_ == disposition::pending ||
-               disposition_ == disposition::completed ||
-               disposition_ == disposition::abandoned);
-        if (disposition_ == disposition::pending) {
-            task_ = context.suspend_task();
-            return ::fit::pending();
+    uint32_t prior = disposition_.load(std::memory_order_acquire);
+    for (;;) {
+        assert(!(prior & (canceled | returned)));
+        if (prior & finished)
+            break;
+        if (prior & waiting) {
+            // The task ran again for some other reason.  Take back |task_|
+            // to replace it, unless the completer is finishing right now.
+            if (!disposition_.compare_exchange_weak(
+                    prior, prior & ~waiting,
+                    std::memory_order_acq_rel, std::memory_order_acquire))
+                continue;
         }
-        disposition_ = disposition::returned;
-        result = std::move(result_);
+        task_ = context.suspend_task();
+        prior = disposition_.fetch_or(waiting, std::memory_order_acq_rel);
+        if (!(prior & finished))
+            return ::fit::pending();
+        // The completer finished without seeing |waiting|, so |task_| is
+        // still ours and there is no need to suspend.
+        task_.reset();
+        break;
     }
-    // drop the reference ouside of the lock
+    result_type result = take_result(prior);
     ref->drop_after_consumption();
     return result;
 }
 
 template <typename V, typename E>
-void bridge_state<V, E>::deliver_result() {
-    if (result_.is_pending()) {
-        task_.reset(); // the task has been canceled
-    } else {
-        task_.resume_task(); // we have a result so wake up the task
-    }
+typename bridge_state<V, E>::result_type bridge_state<V, E>::take_result(
+    uint32_t prior) {
+    disposition_.fetch_or(returned, std::memory_order_relaxed);
+    if (prior & completed)
+        return std::move(result_);
+    return std::move(result_if_abandoned_);
 }
 
 } // namespace internal
@@ -392,6 +472,8 @@ void bridge_state<V, E>::deliver_result() {
 template <typename V = void, typename E = void>
 class bridge;
 template <typename V = void, typename E = void>
+class local_bridge;
+template <typename V = void, typename E = void>
 class completer;
 template <typename V = void, typename E = void>
 class consumer;
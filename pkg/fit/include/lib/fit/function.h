@@ -23,6 +23,27 @@ class function_impl;
 // function.
 constexpr size_t default_inline_target_size = sizeof(void*) * 2;
 
+// A larger size allowance for callbacks, in bytes.  This allows for inline
+// storage of targets as big as eight pointers, such as a lambda that captures
+// an object pointer along with one or two |fit::function|s of its own, which
+// is typical of the handlers given to FIDL bindings.
+constexpr size_t callback_inline_target_size = sizeof(void*) * 8;
+
+// Installs a hook which is called whenever a function stores its target on
+// the heap because the target is larger than the function's inline storage,
+// returning the previously installed hook.  Pass nullptr to remove the hook.
+//
+// The hook receives a description of the target's type, which for a lambda
+// usually names where it was defined, and the target's size, so it can count
+// the spills of each call site to help pick inline sizes.  It may be called
+// concurrently from any thread.
+//
+// Only debug builds (those without NDEBUG) report anything; the hook costs
+// nothing in release builds.
+inline function_heap_hook set_function_heap_hook(function_heap_hook hook) {
+    return ::fit::internal::function_heap_hook_storage().exchange(hook);
+}
+
 // A |fit::function| is a move-only polymorphic function wrapper.
 //
 // |fit::function<T>| behaves like |std::function<T>| except that it is move-only
@@ -55,6 +76,12 @@ constexpr size_t default_inline_target_size = sizeof(void*) * 2;
 template <typename T, size_t inline_target_size = default_inline_target_size>
 using function = function_impl<inline_target_size, false, T>;
 
+// A |fit::function| with room for targets of up to
+// |callback_inline_target_size| bytes, for callbacks that capture more than
+// a couple of pointers.
+template <typename T>
+using callback_function = function<T, callback_inline_target_size>;
+
 // A move-only callable object wrapper which forces callables to be stored inline
 // and never performs heap allocation.
 //
@@ -177,13 +204,16 @@ public:
             return;
         ops_type temp_ops = ops_;
         storage_type temp_bits;
-        ops_->move(&bits_, &temp_bits);
+        ::fit::internal::relocate_target(ops_, &bits_, &temp_bits,
+                                         sizeof(storage_type));
 
         ops_ = other.ops_;
-        other.ops_->move(&other.bits_, &bits_);
+        ::fit::internal::relocate_target(other.ops_, &other.bits_, &bits_,
+                                         sizeof(storage_type));
 
         other.ops_ = temp_ops;
-        temp_ops->move(&temp_bits, &other.bits_);
+        ::fit::internal::relocate_target(temp_ops, &temp_bits, &other.bits_,
+                                         sizeof(storage_type));
     }
 
     // Returns a pointer to the function's target.
@@ -200,6 +230,19 @@ public:
         return static_cast<Callable*>(ops_->get(&bits_));
     }
 
+    // Returns the address of the code that invokes the function's target,
+    // or null if the target is empty.
+    //
+    // This identifies the target's type, so that sampling profilers can
+    // attribute time spent in the target: the code is an instantiation of
+    // |fit::internal::target<Callable, ...>::invoke|, and its symbol names
+    // |Callable|, which for a lambda includes where it was defined.
+    const void* target_code_address() const {
+        if (ops_ == &null_target_type::ops)
+            return nullptr;
+        return reinterpret_cast<const void*>(ops_->invoke);
+    }
+
     // Returns a new function object which invokes the same target.
     // The target itself is not copied; it is moved to the heap and its
     // lifetime is extended until all references have been released.
@@ -255,13 +298,14 @@ private:
 
     // leaves target uninitialized
     void destroy_target() {
-        ops_->destroy(&bits_);
+        ::fit::internal::destroy_target(ops_, &bits_);
     }
 
     // leaves other target initialized to null
     void move_target_from(function_impl&& other) {
         ops_ = other.ops_;
-        other.ops_->move(&other.bits_, &bits_);
+        ::fit::internal::relocate_target(other.ops_, &other.bits_, &bits_,
+                                         sizeof(storage_type));
         other.initialize_null_target();
     }
 
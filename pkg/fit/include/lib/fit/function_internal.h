@@ -7,14 +7,51 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include <atomic>
 #include <new>
 #include <type_traits>
 #include <utility>
 
 namespace fit {
+
+// See |fit::set_function_heap_hook()|.
+using function_heap_hook = void (*)(const char* target_type, size_t target_size);
+
 namespace internal {
 
+inline std::atomic<function_heap_hook>& function_heap_hook_storage() {
+    static std::atomic<function_heap_hook> hook{nullptr};
+    return hook;
+}
+
+// Describes |T| without relying on RTTI.  For a lambda, compilers usually
+// include where it was defined.
+template <typename T>
+const char* target_type_name() {
+    return __PRETTY_FUNCTION__;
+}
+
+// Reports a target that is being moved to the heap to the installed hook.
+// Compiled out of release builds.
+template <typename Callable>
+inline void report_heap_target() {
+#ifndef NDEBUG
+    function_heap_hook hook =
+        function_heap_hook_storage().load(std::memory_order_relaxed);
+    if (hook)
+        hook(target_type_name<Callable>(), sizeof(Callable));
+#endif
+}
+
+// The operations on a function's target.
+//
+// |move| is null for targets which are trivially relocatable, such as targets
+// stored on the heap and trivially copyable targets stored inline; these are
+// moved by copying the function's storage, so moving a function (as happens
+// to every element when a vector of functions grows) needs no indirect call.
+// Likewise, |destroy| is null for targets which need no destruction.
 template <typename Result, typename... Args>
 struct target_ops final {
     void* (*get)(void* bits);
@@ -23,6 +60,26 @@ struct target_ops final {
     void (*destroy)(void* bits);
 };
 
+// Moves the target described by |ops| from |from_bits| to |to_bits|, both of
+// which are |size| bytes of storage.  |from_bits| no longer holds a target
+// afterwards.
+template <typename Result, typename... Args>
+inline void relocate_target(const target_ops<Result, Args...>* ops,
+                            void* from_bits, void* to_bits, size_t size) {
+    if (ops->move) {
+        ops->move(from_bits, to_bits);
+    } else {
+        memcpy(to_bits, from_bits, size);
+    }
+}
+
+// Destroys the target described by |ops|.
+template <typename Result, typename... Args>
+inline void destroy_target(const target_ops<Result, Args...>* ops, void* bits) {
+    if (ops->destroy)
+        ops->destroy(bits);
+}
+
 template <typename Callable, bool is_inline, typename Result, typename... Args>
 struct target;
 
@@ -38,15 +95,13 @@ struct target<decltype(nullptr), true, Result, Args...> final {
 inline void* null_target_get(void* bits) {
     return nullptr;
 }
-inline void null_target_move(void* from_bits, void* to_bits) {}
-inline void null_target_destroy(void* bits) {}
 
 template <typename Result, typename... Args>
 constexpr target_ops<Result, Args...> target<decltype(nullptr), true, Result, Args...>::ops = {
     &null_target_get,
     &target::invoke,
-    &null_target_move,
-    &null_target_destroy};
+    nullptr,
+    nullptr};
 
 template <typename Callable, typename Result, typename... Args>
 struct target<Callable, true, Result, Args...> final {
@@ -78,24 +133,20 @@ template <typename Callable, typename Result, typename... Args>
 constexpr target_ops<Result, Args...> target<Callable, true, Result, Args...>::ops = {
     &inline_target_get,
     &target::invoke,
-    &target::move,
-    &target::destroy};
+    std::is_trivially_copyable<Callable>::value ? nullptr : &target::move,
+    std::is_trivially_destructible<Callable>::value ? nullptr : &target::destroy};
 
 template <typename Callable, typename Result, typename... Args>
 struct target<Callable, false, Result, Args...> final {
     static void initialize(void* bits, Callable&& target) {
         auto ptr = static_cast<Callable**>(bits);
+        report_heap_target<Callable>();
         *ptr = new Callable(std::move(target));
     }
     static Result invoke(void* bits, Args... args) {
         auto& target = **static_cast<Callable**>(bits);
         return target(std::forward<Args>(args)...);
     }
-    static void move(void* from_bits, void* to_bits) {
-        auto from_ptr = static_cast<Callable**>(from_bits);
-        auto to_ptr = static_cast<Callable**>(to_bits);
-        *to_ptr = *from_ptr;
-    }
     static void destroy(void* bits) {
         auto ptr = static_cast<Callable**>(bits);
         delete *ptr;
@@ -112,7 +163,7 @@ template <typename Callable, typename Result, typename... Args>
 constexpr target_ops<Result, Args...> target<Callable, false, Result, Args...>::ops = {
     &heap_target_get,
     &target::invoke,
-    &target::move,
+    nullptr, // relocated by copying the pointer
     &target::destroy};
 
 } // namespace internal
@@ -240,6 +240,9 @@ constexpr bool operator!=(const T& lhs, const nullable<U>& rhs) {
     return (is_null(lhs) == rhs.has_value()) || (rhs.has_value() && lhs != *rhs);
 }
 
+// Nullables of types with a null value, such as pointers, need no flag.
+static_assert(sizeof(nullable<void*>) == sizeof(void*), "nullable layout grew");
+
 } // namespace fit
 
 #endif // LIB_FIT_NULLABLE_H_
@@ -293,6 +293,13 @@ constexpr bool operator!=(const T& lhs, const optional<U>& rhs) {
     return !rhs.has_value() || lhs != *rhs;
 }
 
+// Optionals should be no larger than their value plus a flag, padded to the
+// value's alignment, which matches common |std::optional| implementations.
+static_assert(sizeof(optional<char>) == 2, "optional layout grew");
+static_assert(sizeof(optional<int>) == 2 * sizeof(int), "optional layout grew");
+static_assert(sizeof(optional<void*>) == 2 * sizeof(void*),
+              "optional layout grew");
+
 } // namespace fit
 
 #endif // LIB_FIT_OPTIONAL_H_
@@ -7,13 +7,16 @@
 
 #include <assert.h>
 
+#include <mutex>
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "function.h"
 #include "promise_internal.h"
 #include "result.h"
+#include "thread_safety.h"
 #include "variant.h"
 
 namespace fit {
@@ -65,6 +68,8 @@ namespace fit {
 //    |box()|: wraps the promise's continuation into a |fit::function|
 //    |fit::join_promises()|: await multiple promises, once they all complete
 //                            return a tuple of their results
+//    |fit::join_promise_vector()|: await a vector of promises, once they all
+//                                  complete return a vector of their results
 //
 // You can also create your own custom combinators by crafting new
 // types of continuations.
@@ -749,6 +754,7 @@ public:
 private:
     template <typename>
     friend class promise_impl;
+    friend class pending_task;
 
     state_type state_;
 };
@@ -865,6 +871,14 @@ make_promise(PromiseHandler handler) {
 // Returns a promise that produces a std::tuple<> containing the result
 // of each promise once they all complete.
 //
+// Each time the joined promise is polled, it only polls the promises that
+// have been woken since it last ran, so a promise that is waiting for
+// something does not run again whenever one of the others makes progress.
+// To accomplish this, each promise is evaluated with a context of its own
+// that keeps track of the suspended tasks it hands out.  That context
+// forwards to the joined promise's context, but it is not of the same type so
+// the promises must not try to convert it with |fit::context::as()|.
+//
 // EXAMPLE
 //
 //     auto get_random_number() {
@@ -887,6 +901,35 @@ join_promises(Promises... promises) {
         ::fit::internal::join_continuation<Promises...>(std::move(promises)...));
 }
 
+// Jointly evaluates a vector of promises.
+// Returns a promise that produces a std::vector<> containing the result
+// of each promise, in the same order, once they all complete.
+//
+// Like |fit::join_promises()|, this only polls the promises that have been
+// woken since it last ran, so joining N promises costs O(N) in total however
+// they resume, and the promises must not try to convert their context with
+// |fit::context::as()|.
+//
+// EXAMPLE
+//
+//     auto fetch_pages(std::vector<page_id> ids) {
+//         std::vector<fit::promise<page, error_type>> fetches;
+//         for (auto& id : ids)
+//             fetches.push_back(fetch_page(id));
+//         return fit::join_promise_vector(std::move(fetches))
+//             .and_then([] (std::vector<fit::result<page, error_type>>& results) {
+//                 ...
+//             });
+//     }
+//
+template <typename V, typename E>
+inline promise_impl<::fit::internal::join_vector_continuation<promise<V, E>>>
+join_promise_vector(std::vector<promise<V, E>> promises) {
+    return make_promise_with_continuation(
+        ::fit::internal::join_vector_continuation<promise<V, E>>(
+            std::move(promises)));
+}
+
 // Describes the status of a future.
 enum class future_state {
     // The future neither holds a result nor a promise that could produce a result.
@@ -1308,6 +1351,12 @@ public:
         return std::move(promise_);
     }
 
+    // Returns the address of the code that runs the task's continuation, or
+    // null if the task is empty.  See |fit::function::target_code_address()|.
+    const void* target_code_address() const {
+        return promise_ ? promise_.state_->target_code_address() : nullptr;
+    }
+
     pending_task(const pending_task&) = delete;
     pending_task& operator=(const pending_task&) = delete;
 
@@ -1515,6 +1564,223 @@ private:
     ticket ticket_;
 };
 
+namespace internal {
+
+// Keeps track of which child promises of a combinator have been woken since
+// the combinator last ran, so that it only has to poll those children.
+//
+// Each child is polled with a |wake_context|.  When a child suspends itself,
+// it receives a ticket from the wake set rather than from the executor.
+// Resuming such a ticket marks the child as woken and resumes the
+// combinator's own task, which the wake set holds on to while any of its
+// children's tickets are outstanding.  Releasing the last of them without
+// waking a child releases the combinator's task too, so it is abandoned
+// just as it would have been had the children suspended it themselves.
+//
+// The wake set lives until both its owner, which calls |release()|, and all
+// of the tickets it issued are gone.
+//
+// This class is thread-safe.
+class wake_set final : public suspended_task::resolver {
+public:
+    explicit wake_set(size_t child_count);
+
+    // Issues a ticket for |child|.
+    suspended_task suspend_child(size_t child);
+
+    // Moves the children which have been woken since the last call to the
+    // end of |children|.
+    void take_woken_children(std::vector<size_t>* children);
+
+    // Called after the combinator's children have been polled and before
+    // the combinator returns |fit::pending()|, with the combinator's context.
+    // Suspends the combinator's task if any of its children might be woken,
+    // or resumes it right away if some already were.  The ticket held from
+    // an earlier run is replaced, since it is stale if that run was caused
+    // by something other than one of the children.
+    void suspend_parent(context& parent);
+
+    // Releases the owner's reference.  Destroys the wake set unless some of
+    // its tickets are outstanding.
+    void release();
+
+    suspended_task::ticket duplicate_ticket(suspended_task::ticket ticket) override;
+    void resolve_ticket(suspended_task::ticket ticket, bool resume_task) override;
+
+    wake_set(const wake_set&) = delete;
+    wake_set(wake_set&&) = delete;
+    wake_set& operator=(const wake_set&) = delete;
+    wake_set& operator=(wake_set&&) = delete;
+
+private:
+    ~wake_set() override;
+
+    std::mutex mutex_;
+    bool released_ FIT_GUARDED(mutex_) = false;
+    uint64_t ticket_count_ FIT_GUARDED(mutex_) = 0;
+    suspended_task parent_task_ FIT_GUARDED(mutex_);
+    std::vector<size_t> woken_children_ FIT_GUARDED(mutex_);
+    std::vector<bool> is_woken_ FIT_GUARDED(mutex_);
+};
+
+// The context given to the children of a combinator that uses a |wake_set|.
+class wake_context final : public context {
+public:
+    wake_context(context& parent, wake_set* set, size_t child)
+        : parent_(parent), set_(set), child_(child) {}
+    ~wake_context() override = default;
+
+    class executor* executor() const override { return parent_.executor(); }
+    suspended_task suspend_task() override { return set_->suspend_child(child_); }
+
+private:
+    context& parent_;
+    wake_set* const set_;
+    const size_t child_;
+};
+
+template <typename... Promises>
+class join_continuation final {
+public:
+    explicit join_continuation(Promises... promises)
+        : promises_(std::make_tuple(std::move(promises)...)),
+          wake_set_(new wake_set(sizeof...(Promises))) {}
+
+    join_continuation(join_continuation&& other)
+        : promises_(std::move(other.promises_)),
+          pending_count_(other.pending_count_),
+          polled_(other.polled_),
+          wake_set_(other.wake_set_) {
+        other.wake_set_ = nullptr;
+    }
+
+    ~join_continuation() {
+        if (wake_set_)
+            wake_set_->release();
+    }
+
+    ::fit::result<std::tuple<typename Promises::result_type...>> operator()(
+        ::fit::context& context) {
+        return evaluate(context, std::index_sequence_for<Promises...>{});
+    }
+
+    join_continuation(const join_continuation&) = delete;
+    join_continuation& operator=(const join_continuation&) = delete;
+    join_continuation& operator=(join_continuation&&) = delete;
+
+private:
+    using poll_func = void (join_continuation::*)(::fit::context& context);
+
+    template <size_t... i>
+    ::fit::result<std::tuple<typename Promises::result_type...>> evaluate(
+        ::fit::context& context, std::index_sequence<i...>) {
+        static constexpr poll_func polls[] = {&join_continuation::poll<i>...,
+                                              nullptr};
+        if (!polled_) {
+            polled_ = true;
+            for (size_t child = 0; child < sizeof...(Promises); child++)
+                (this->*polls[child])(context);
+        } else {
+            woken_.clear();
+            wake_set_->take_woken_children(&woken_);
+            for (size_t child : woken_)
+                (this->*polls[child])(context);
+        }
+        if (pending_count_ != 0) {
+            wake_set_->suspend_parent(context);
+            return ::fit::pending();
+        }
+        return ::fit::ok(std::make_tuple(std::get<i>(promises_).take_result()...));
+    }
+
+    template <size_t i>
+    void poll(::fit::context& context) {
+        auto& future = std::get<i>(promises_);
+        if (!future.is_pending())
+            return; // completed already, a stale ticket woke it
+        wake_context child_context(context, wake_set_, i);
+        if (future(child_context))
+            pending_count_--;
+    }
+
+    std::tuple<future_impl<Promises>...> promises_;
+    size_t pending_count_ = sizeof...(Promises);
+    bool polled_ = false;
+    std::vector<size_t> woken_;
+    wake_set* wake_set_;
+};
+
+template <typename Promise>
+class join_vector_continuation final {
+public:
+    explicit join_vector_continuation(std::vector<Promise> promises)
+        : pending_count_(promises.size()),
+          wake_set_(new wake_set(promises.size())) {
+        futures_.reserve(promises.size());
+        for (auto& promise : promises) {
+            assert(promise);
+            futures_.emplace_back(std::move(promise));
+        }
+    }
+
+    join_vector_continuation(join_vector_continuation&& other)
+        : futures_(std::move(other.futures_)),
+          pending_count_(other.pending_count_),
+          polled_(other.polled_),
+          wake_set_(other.wake_set_) {
+        other.wake_set_ = nullptr;
+    }
+
+    ~join_vector_continuation() {
+        if (wake_set_)
+            wake_set_->release();
+    }
+
+    ::fit::result<std::vector<typename Promise::result_type>> operator()(
+        ::fit::context& context) {
+        if (!polled_) {
+            polled_ = true;
+            for (size_t i = 0; i < futures_.size(); i++)
+                poll(context, i);
+        } else {
+            woken_.clear();
+            wake_set_->take_woken_children(&woken_);
+            for (size_t i : woken_)
+                poll(context, i);
+        }
+        if (pending_count_ != 0) {
+            wake_set_->suspend_parent(context);
+            return ::fit::pending();
+        }
+
+        std::vector<typename Promise::result_type> results;
+        results.reserve(futures_.size());
+        for (auto& future : futures_)
+            results.push_back(future.take_result());
+        return ::fit::ok(std::move(results));
+    }
+
+    join_vector_continuation(const join_vector_continuation&) = delete;
+    join_vector_continuation& operator=(const join_vector_continuation&) = delete;
+    join_vector_continuation& operator=(join_vector_continuation&&) = delete;
+
+private:
+    void poll(::fit::context& context, size_t i) {
+        if (!futures_[i].is_pending())
+            return; // completed already, a stale ticket woke it
+        wake_context child_context(context, wake_set_, i);
+        if (futures_[i](child_context))
+            pending_count_--;
+    }
+
+    std::vector<future_impl<Promise>> futures_;
+    size_t pending_count_;
+    bool polled_ = false;
+    std::vector<size_t> woken_;
+    wake_set* wake_set_;
+};
+
+} // namespace internal
 } // namespace fit
 
 #endif // LIB_FIT_PROMISE_H_
@@ -551,39 +551,15 @@ private:
 template <typename PromiseHandler>
 using promise_continuation = context_handler_invoker<PromiseHandler>;
 
-// Returns true if all arguments are true or if there are none.
-inline bool all_true() {
-    return true;
-}
-template <typename... Ts>
-inline bool all_true(bool value, Ts... values) {
-    return value & all_true(values...);
-}
-
 // The continuation produced by |join_promises()|.
+// Defined in promise.h since it depends on |fit::context|.
 template <typename... Promises>
-class join_continuation final {
-public:
-    explicit join_continuation(Promises... promises)
-        : promises_(std::make_tuple(std::move(promises)...)) {}
-
-    ::fit::result<std::tuple<typename Promises::result_type...>> operator()(
-        ::fit::context& context) {
-        return evaluate(context, std::index_sequence_for<Promises...>{});
-    }
-
-private:
-    template <size_t... i>
-    ::fit::result<std::tuple<typename Promises::result_type...>> evaluate(
-        ::fit::context& context, std::index_sequence<i...>) {
-        bool done = all_true(std::get<i>(promises_)(context)...);
-        if (!done)
-            return ::fit::pending();
-        return ::fit::ok(std::make_tuple(std::get<i>(promises_).take_result()...));
-    }
+class join_continuation;
 
-    std::tuple<future_impl<Promises>...> promises_;
-};
+// The continuation produced by |join_promise_vector()|.
+// Defined in promise.h since it depends on |fit::context|.
+template <typename Promise>
+class join_vector_continuation;
 
 } // namespace internal
 
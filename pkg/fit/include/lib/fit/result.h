@@ -265,6 +265,15 @@ private:
         state_;
 };
 
+// Results are returned on hot paths so keep an eye on their layout: the
+// value or error followed by the variant's index and nothing else.
+static_assert(sizeof(result<>) == 2 * sizeof(size_t),
+              "result layout grew");
+static_assert(sizeof(result<int, int>) == 2 * sizeof(size_t),
+              "result layout grew");
+static_assert(sizeof(result<void*, int>) == 2 * sizeof(size_t),
+              "result layout grew");
+
 } // namespace fit
 
 #endif // LIB_FIT_RESULT_H_
@@ -5,9 +5,11 @@
 #ifndef LIB_FIT_SCHEDULER_H_
 #define LIB_FIT_SCHEDULER_H_
 
-#include <map>
+#include <stdint.h>
+
 #include <queue>
 #include <utility>
+#include <vector>
 
 #include "promise.h"
 
@@ -116,7 +118,7 @@ public:
 
     // Returns true if there are any tickets that have yet to be finalized,
     // released, or resumed.
-    bool has_outstanding_tickets() const { return !tickets_.empty(); }
+    bool has_outstanding_tickets() const { return ticket_count_ > 0; }
 
     scheduler(const scheduler&) = delete;
     scheduler(scheduler&&) = delete;
@@ -124,15 +126,28 @@ public:
     scheduler& operator=(scheduler&&) = delete;
 
 private:
+    // Tickets live in a table of reusable slots so that obtaining and
+    // resolving them takes constant time and, once the table has grown to
+    // the largest number of simultaneously outstanding tickets, allocates
+    // nothing.
+    //
+    // A ticket combines the index of its slot (low 32 bits) with the slot's
+    // generation (high 32 bits), which is bumped each time the slot is
+    // freed, so that stale tickets can be caught.  Generations start at 1,
+    // so no ticket is ever 0.
     struct ticket_record {
-        ticket_record(ref_count initial_refs)
-            : ref_count(initial_refs), was_resumed(false) {}
-
-        // The current reference count.
-        ref_count ref_count;
+        // The current reference count, or 0 if the slot is free.
+        ref_count ref_count = 0;
 
         // True if the task has been resumed using |resume_task_with_ticket()|.
-        bool was_resumed;
+        bool was_resumed = false;
+
+        // The generation of the ticket that owns the slot, or of the next
+        // ticket to own it if the slot is free.
+        uint32_t generation = 1;
+
+        // The index of the next free slot, if the slot is free.
+        uint32_t next_free = 0;
 
         // The task is initially empty when the ticket is obtained.
         // It is later set to non-empty if the task needs to be suspended when
@@ -140,12 +155,21 @@ private:
         // is moved into the runnable queue, released, or taken.
         pending_task task;
     };
-    using ticket_map = std::map<suspended_task::ticket, ticket_record>;
+
+    // Returns the record of an outstanding ticket.
+    ticket_record& find_ticket(suspended_task::ticket ticket);
+
+    // Returns the slot of a ticket whose ref-count dropped to 0 to the free
+    // list.
+    void free_ticket(suspended_task::ticket ticket, ticket_record& record);
+
+    static constexpr uint32_t no_free_slot = UINT32_MAX;
 
     task_queue runnable_tasks_;
-    ticket_map tickets_;
+    std::vector<ticket_record> tickets_;
+    uint32_t free_ticket_ = no_free_slot;
+    uint64_t ticket_count_ = 0;
     uint64_t suspended_task_count_ = 0;
-    suspended_task::ticket next_ticket_ = 1;
 };
 
 } // namespace subtle
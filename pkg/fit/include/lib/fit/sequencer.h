@@ -7,10 +7,8 @@
 
 #include <assert.h>
 
-#include <mutex>
-
-#include "bridge.h"
-#include "thread_safety.h"
+#include "promise.h"
+#include "sequencer_internal.h"
 
 namespace fit {
 
@@ -48,22 +46,12 @@ public:
     //
     // This method is thread-safe.
     template <typename Promise>
-    decltype(auto) wrap(Promise promise) {
+    promise_impl<::fit::internal::sequenced_continuation<Promise>> wrap(
+        Promise promise) {
         assert(promise);
-
-        fit::bridge<> bridge;
-        fit::consumer<> prior = swap_prior(std::move(bridge.consumer()));
-        return prior.promise_or(fit::ok())
-            .then([promise = std::move(promise),
-                   completer = std::move(bridge.completer())](
-                      fit::context& context, fit::result<>) mutable {
-                // This handler will run once the completer associated
-                // with the |prior| promise is abandoned.  Once the promise
-                // has finished, both the promise and completer will be
-                // destroyed thereby causing the next promise chained onto
-                // the |bridge|'s associated consumer to become runnable.
-                return promise(context);
-            });
+        return make_promise_with_continuation(
+            ::fit::internal::sequenced_continuation<Promise>(
+                queue_, std::move(promise)));
     }
 
     sequencer(const sequencer&) = delete;
@@ -72,12 +60,7 @@ public:
     sequencer& operator=(sequencer&&) = delete;
 
 private:
-    fit::consumer<> swap_prior(fit::consumer<> new_prior);
-
-    std::mutex mutex_;
-
-    // Holds the consumption capability of the most recently wrapped promise.
-    fit::consumer<> prior_ FIT_GUARDED(mutex_);
+    ::fit::internal::sequencer_queue* const queue_;
 };
 
 } // namespace fit
@@ -0,0 +1,116 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIT_SEQUENCER_INTERNAL_H_
+#define LIB_FIT_SEQUENCER_INTERNAL_H_
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "promise.h"
+#include "thread_safety.h"
+
+namespace fit {
+namespace internal {
+
+// The first-in-first-out queue of a |fit::sequencer|.
+//
+// Each wrapped promise is represented by a |waiter| which is linked into the
+// queue when the promise is wrapped and unlinked when the promise completes
+// or is abandoned.  Only the waiter at the head of the queue may run; the
+// others hold on to a suspended task which is resumed once they reach it.
+// The waiters are embedded in the wrapped promises' continuations so
+// sequencing does not allocate.
+//
+// The queue is reference counted so that wrapped promises may outlive
+// their sequencer.
+//
+// This class is thread-safe.
+class sequencer_queue final {
+public:
+    struct waiter {
+        waiter* prev = nullptr;
+        waiter* next = nullptr;
+        bool linked = false;
+        bool running = false;
+        suspended_task task;
+    };
+
+    sequencer_queue();
+
+    void add_ref();
+    void release();
+
+    // Links |node| at the tail of the queue.
+    void enqueue(waiter* node);
+
+    // Substitutes |node| for |other| in the queue, if |other| is linked.
+    void replace(waiter* node, waiter* other);
+
+    // Returns true if |node| is at the head of the queue and may run.
+    // Otherwise, suspends the task evaluating |node| until it reaches the head.
+    bool await_turn(waiter* node, context& context);
+
+    // Unlinks |node| from the queue, resuming the task of the next waiter
+    // if |node| was at the head.
+    void remove(waiter* node);
+
+    sequencer_queue(const sequencer_queue&) = delete;
+    sequencer_queue(sequencer_queue&&) = delete;
+    sequencer_queue& operator=(const sequencer_queue&) = delete;
+    sequencer_queue& operator=(sequencer_queue&&) = delete;
+
+private:
+    ~sequencer_queue();
+
+    std::atomic<uint32_t> ref_count_{1};
+    std::mutex mutex_;
+    waiter* head_ FIT_GUARDED(mutex_) = nullptr;
+    waiter* tail_ FIT_GUARDED(mutex_) = nullptr;
+};
+
+// The continuation produced by |fit::sequencer::wrap()|.
+template <typename Promise>
+class sequenced_continuation final {
+public:
+    sequenced_continuation(sequencer_queue* queue, Promise promise)
+        : queue_(queue), promise_(std::move(promise)) {
+        queue_->add_ref();
+        queue_->enqueue(&node_);
+    }
+
+    sequenced_continuation(sequenced_continuation&& other)
+        : queue_(other.queue_), promise_(std::move(other.promise_)) {
+        queue_->add_ref();
+        queue_->replace(&node_, &other.node_);
+    }
+
+    ~sequenced_continuation() {
+        queue_->remove(&node_);
+        queue_->release();
+    }
+
+    typename Promise::result_type operator()(::fit::context& context) {
+        if (!node_.running && !queue_->await_turn(&node_, context))
+            return ::fit::pending();
+        return promise_(context);
+    }
+
+    sequenced_continuation(const sequenced_continuation&) = delete;
+    sequenced_continuation& operator=(const sequenced_continuation&) = delete;
+    sequenced_continuation& operator=(sequenced_continuation&&) = delete;
+
+private:
+    sequencer_queue* const queue_;
+    sequencer_queue::waiter node_;
+    Promise promise_;
+};
+
+} // namespace internal
+} // namespace fit
+
+#endif // LIB_FIT_SEQUENCER_INTERNAL_H_
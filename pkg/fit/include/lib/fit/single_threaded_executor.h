@@ -5,10 +5,15 @@
 #ifndef LIB_FIT_SINGLE_THREADED_EXECUTOR_H_
 #define LIB_FIT_SINGLE_THREADED_EXECUTOR_H_
 
+#include <stdint.h>
+
+#include <atomic>
+#include <new>
 #include <utility>
 
 #include "promise.h"
 #include "scheduler.h"
+#include "task_slab.h"
 
 namespace fit {
 
@@ -27,11 +32,58 @@ public:
     // that have yet to complete.
     ~single_threaded_executor() override;
 
+    // How the promises given to the templated |schedule_task()| were stored,
+    // for tuning the size of promise chains.
+    struct task_storage_stats {
+        // Small enough to be stored in the task itself.
+        uint64_t inline_tasks = 0;
+
+        // Stored in a block of the executor's slab.
+        uint64_t slab_tasks = 0;
+
+        // Too large for the slab, so boxed on the heap.
+        uint64_t boxed_tasks = 0;
+    };
+
     // Schedules a task for eventual execution by the executor.
     //
     // This method is thread-safe.
     void schedule_task(pending_task task) override;
 
+    // Schedules a promise for eventual execution by the executor, without
+    // boxing it on the heap when it is too large to be stored inline in a
+    // |pending_task|: instead, it is moved into a block recycled by the
+    // executor.
+    //
+    // This method is thread-safe.
+    template <typename Continuation>
+    void schedule_task(promise_impl<Continuation> promise) {
+        assert(promise);
+        auto task = promise.discard_result();
+        using task_type = decltype(task);
+        if (sizeof(typename task_type::continuation_type) <=
+            default_inline_target_size) {
+            inline_tasks_.fetch_add(1u, std::memory_order_relaxed);
+            schedule_task(pending_task(task.box()));
+        } else if (void* block = slab_.allocate(sizeof(task_type))) {
+            slab_tasks_.fetch_add(1u, std::memory_order_relaxed);
+            schedule_task(pending_task(
+                make_promise_with_continuation(
+                    subtle::slab_task_continuation<task_type>(
+                        new (block) task_type(std::move(task))))
+                    .box()));
+        } else {
+            boxed_tasks_.fetch_add(1u, std::memory_order_relaxed);
+            schedule_task(pending_task(task.box()));
+        }
+    }
+
+    // Returns how the promises given to the templated |schedule_task()| have
+    // been stored so far.
+    //
+    // This method is thread-safe.
+    task_storage_stats storage_stats() const;
+
     // Runs all scheduled tasks (including additional tasks scheduled while
     // they run) until none remain.
     //
@@ -62,6 +114,13 @@ private:
 
     context_impl context_;
     dispatcher_impl* const dispatcher_;
+
+    // Every task is destroyed by the time the destructor returns, so the
+    // slab can go with the executor.
+    subtle::task_slab slab_;
+    std::atomic<uint64_t> inline_tasks_{0};
+    std::atomic<uint64_t> slab_tasks_{0};
+    std::atomic<uint64_t> boxed_tasks_{0};
 };
 
 // Creates a new |fit::single_threaded_executor|, schedules a promise as a task,
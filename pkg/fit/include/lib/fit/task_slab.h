@@ -0,0 +1,98 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIT_TASK_SLAB_H_
+#define LIB_FIT_TASK_SLAB_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <utility>
+
+#include "promise.h"
+#include "thread_safety.h"
+
+namespace fit {
+namespace subtle {
+
+// Recycles blocks of memory in which an executor can store its tasks, so
+// that scheduling a large promise does not go to the heap each time.
+// This is a low-level building block for implementing executors.
+// For a concrete implementation, see |fit::single_threaded_executor|.
+//
+// Blocks come in a few sizes of up to |max_block_size| bytes.  A freed block
+// is kept for reuse by a later task of the same size; the memory is only
+// released when the slab is destroyed, which must not happen before all of
+// its blocks have been freed.
+//
+// This class is thread-safe.
+class task_slab final {
+public:
+    // The largest block the slab hands out.
+    static constexpr size_t max_block_size = 512;
+
+    task_slab();
+    ~task_slab();
+
+    // Returns a block of at least |size| bytes, aligned for any type, or
+    // nullptr if |size| exceeds |max_block_size|.
+    void* allocate(size_t size);
+
+    // Returns a block to the slab that allocated it.
+    static void free(void* block);
+
+    task_slab(const task_slab&) = delete;
+    task_slab(task_slab&&) = delete;
+    task_slab& operator=(const task_slab&) = delete;
+    task_slab& operator=(task_slab&&) = delete;
+
+private:
+    struct block_header;
+
+    // Blocks of 32, 64, 128, 256 and 512 bytes.
+    static constexpr size_t size_class_count = 5;
+    static constexpr size_t min_block_size = max_block_size >> (size_class_count - 1);
+
+    std::mutex mutex_;
+    block_header* free_blocks_[size_class_count] FIT_GUARDED(mutex_) = {};
+    size_t allocated_block_count_ FIT_GUARDED(mutex_) = 0;
+};
+
+// The continuation of a task whose promise is stored in a |task_slab| block.
+// It is only as large as a pointer, so boxing it does not allocate.
+template <typename Promise>
+class slab_task_continuation final {
+public:
+    explicit slab_task_continuation(Promise* promise)
+        : promise_(promise) {}
+
+    slab_task_continuation(slab_task_continuation&& other)
+        : promise_(other.promise_) {
+        other.promise_ = nullptr;
+    }
+
+    ~slab_task_continuation() {
+        if (promise_) {
+            promise_->~Promise();
+            task_slab::free(promise_);
+        }
+    }
+
+    typename Promise::result_type operator()(::fit::context& context) {
+        return (*promise_)(context);
+    }
+
+    slab_task_continuation(const slab_task_continuation&) = delete;
+    slab_task_continuation& operator=(const slab_task_continuation&) = delete;
+    slab_task_continuation& operator=(slab_task_continuation&&) = delete;
+
+private:
+    Promise* promise_;
+};
+
+} // namespace subtle
+} // namespace fit
+
+#endif // LIB_FIT_TASK_SLAB_H_
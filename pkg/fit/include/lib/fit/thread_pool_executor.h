@@ -0,0 +1,72 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIT_THREAD_POOL_EXECUTOR_H_
+#define LIB_FIT_THREAD_POOL_EXECUTOR_H_
+
+#include <stddef.h>
+
+#include "promise.h"
+
+namespace fit {
+
+// A platform-independent asynchronous task executor that runs tasks on a
+// pool of threads.
+//
+// Each thread has its own queue of runnable tasks.  A thread runs the tasks
+// it queued most recently first, and when its queue is empty it steals the
+// oldest task of another thread's queue, so CPU-bound promise pipelines keep
+// every thread busy without contending on a single queue.
+//
+// Tasks scheduled or resumed by one of the executor's threads are queued on
+// that thread; tasks scheduled or resumed from elsewhere are spread over all
+// of the threads.  Suspended tasks may be resumed from any thread.
+//
+// A task only ever runs on one thread at a time, but successive runs of the
+// same task may happen on different threads, so tasks must not rely on
+// thread-local state.
+//
+// See documentation of |fit::promise| for more information.
+class thread_pool_executor final : public executor {
+public:
+    // Creates an executor and starts |thread_count| threads to run its tasks,
+    // or one per CPU if |thread_count| is zero.
+    explicit thread_pool_executor(size_t thread_count = 0);
+
+    // Stops the executor's threads, then destroys the executor along with
+    // all of its remaining scheduled tasks that have yet to complete.
+    //
+    // Must not be called from one of the executor's threads.
+    ~thread_pool_executor() override;
+
+    // The number of threads that run the executor's tasks.
+    size_t thread_count() const;
+
+    // Schedules a task for eventual execution by the executor.
+    //
+    // This method is thread-safe.
+    void schedule_task(pending_task task) override;
+
+    // Blocks until every task scheduled so far (including additional tasks
+    // scheduled while they run) has either completed or been abandoned.
+    //
+    // This method is thread-safe but must not be called from one of the
+    // executor's threads.
+    void wait_for_idle();
+
+    thread_pool_executor(const thread_pool_executor&) = delete;
+    thread_pool_executor(thread_pool_executor&&) = delete;
+    thread_pool_executor& operator=(const thread_pool_executor&) = delete;
+    thread_pool_executor& operator=(thread_pool_executor&&) = delete;
+
+private:
+    class dispatcher_impl;
+    class worker;
+
+    dispatcher_impl* const dispatcher_;
+};
+
+} // namespace fit
+
+#endif // LIB_FIT_THREAD_POOL_EXECUTOR_H_
@@ -398,6 +398,14 @@ struct variant_alternative<0, variant<T0, Ts...>> {
 template <size_t index, typename Variant>
 using variant_alternative_t = typename variant_alternative<index, Variant>::type;
 
+// Variants are used on hot return paths by way of |fit::result| so keep an
+// eye on their layout: storage for the largest alternative followed by the
+// index and nothing else.
+static_assert(sizeof(variant<monostate, int>) == 2 * sizeof(size_t),
+              "variant layout grew");
+static_assert(sizeof(variant<monostate, char, void*>) == 2 * sizeof(size_t),
+              "variant layout grew");
+
 } // namespace internal
 } // namespace fit
 
@@ -52,6 +52,110 @@ suspended_task& suspended_task::operator=(suspended_task&& other) {
     return *this;
 }
 
+namespace internal {
+
+wake_set::wake_set(size_t child_count)
+    : is_woken_(child_count, false) {}
+
+wake_set::~wake_set() = default;
+
+suspended_task wake_set::suspend_child(size_t child) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    assert(child < is_woken_.size());
+    ticket_count_++;
+    return suspended_task(this, child);
+}
+
+void wake_set::take_woken_children(std::vector<size_t>* children) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t child : woken_children_) {
+        is_woken_[child] = false;
+        children->push_back(child);
+    }
+    woken_children_.clear();
+}
+
+void wake_set::suspend_parent(context& parent) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (woken_children_.empty() && ticket_count_ == 0)
+            return; // nothing to wait for
+    }
+
+    // Take a fresh ticket each time, since the parent may have been rerun
+    // by something other than this wake set since the last one was taken,
+    // which leaves that ticket stale.  Obtain it outside of the lock since
+    // the executor may hold a lock of its own while it does so.
+    suspended_task task = parent.suspend_task();
+    suspended_task previous; // released outside of the lock
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        previous = std::move(parent_task_);
+        if (woken_children_.empty()) {
+            if (ticket_count_ != 0)
+                parent_task_ = std::move(task);
+            return; // |task| is released, if unused, without resumption
+        }
+    }
+
+    // A child was woken before its wakeup could be passed on.
+    task.resume_task();
+}
+
+void wake_set::release() {
+    suspended_task parent_task; // drop outside of the lock
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        assert(!released_);
+        released_ = true;
+        parent_task = std::move(parent_task_);
+        if (ticket_count_ != 0)
+            return; // can't delete self yet
+    }
+
+    // Must destroy self outside of the lock.
+    delete this;
+}
+
+suspended_task::ticket wake_set::duplicate_ticket(
+    suspended_task::ticket ticket) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    assert(ticket_count_ != 0);
+    ticket_count_++;
+    return ticket;
+}
+
+void wake_set::resolve_ticket(suspended_task::ticket ticket, bool resume_task) {
+    suspended_task parent_task; // resolve outside of the lock
+    bool delete_self = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        assert(ticket_count_ != 0);
+        ticket_count_--;
+        if (released_) {
+            delete_self = ticket_count_ == 0;
+        } else {
+            const size_t child = static_cast<size_t>(ticket);
+            if (resume_task && !is_woken_[child]) {
+                is_woken_[child] = true;
+                woken_children_.push_back(child);
+            }
+            // Pass the wakeup on, or give up on the parent if none of its
+            // children can be woken anymore.
+            if (resume_task || (ticket_count_ == 0 && woken_children_.empty()))
+                parent_task = std::move(parent_task_);
+        }
+    }
+
+    if (resume_task)
+        parent_task.resume_task();
+
+    // Must destroy self outside of the lock.
+    if (delete_self)
+        delete this;
+}
+
+} // namespace internal
 } // namespace fit
 
 #endif // FIT_NO_STD_FOR_ZIRCON_USERSPACE
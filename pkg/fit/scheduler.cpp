@@ -7,9 +7,9 @@
 
 #include <lib/fit/scheduler.h>
 
-#include <map>
 #include <queue>
 #include <utility>
+#include <vector>
 
 namespace fit {
 namespace subtle {
@@ -24,80 +24,85 @@ void scheduler::schedule_task(pending_task task) {
 }
 
 suspended_task::ticket scheduler::obtain_ticket(uint32_t initial_refs) {
-    suspended_task::ticket ticket = next_ticket_++;
-    tickets_.emplace(ticket, ticket_record(initial_refs));
-    return ticket;
+    assert(initial_refs > 0);
+
+    uint32_t index;
+    if (free_ticket_ != no_free_slot) {
+        index = free_ticket_;
+        free_ticket_ = tickets_[index].next_free;
+    } else {
+        assert(tickets_.size() < no_free_slot);
+        index = static_cast<uint32_t>(tickets_.size());
+        tickets_.emplace_back();
+    }
+    ticket_record& record = tickets_[index];
+    record.ref_count = initial_refs;
+    record.was_resumed = false;
+    ticket_count_++;
+    return (static_cast<suspended_task::ticket>(record.generation) << 32) | index;
 }
 
 void scheduler::finalize_ticket(suspended_task::ticket ticket,
                                 pending_task* task) {
-    auto it = tickets_.find(ticket);
-    assert(it != tickets_.end());
-    assert(!it->second.task);
-    assert(it->second.ref_count > 0);
+    ticket_record& record = find_ticket(ticket);
+    assert(!record.task);
     assert(task);
 
-    it->second.ref_count--;
+    record.ref_count--;
     if (!*task) {
         // task already finished
-    } else if (it->second.was_resumed) {
+    } else if (record.was_resumed) {
         // task immediately became runnable
         runnable_tasks_.push(std::move(*task));
-    } else if (it->second.ref_count > 0) {
+    } else if (record.ref_count > 0) {
         // task remains suspended
-        it->second.task = std::move(*task);
+        record.task = std::move(*task);
         suspended_task_count_++;
     } // else, task was abandoned and caller retains ownership of it
-    if (it->second.ref_count == 0) {
-        tickets_.erase(it);
+    if (record.ref_count == 0) {
+        free_ticket(ticket, record);
     }
 }
 
 void scheduler::duplicate_ticket(suspended_task::ticket ticket) {
-    auto it = tickets_.find(ticket);
-    assert(it != tickets_.end());
-    assert(it->second.ref_count > 0);
+    ticket_record& record = find_ticket(ticket);
 
-    it->second.ref_count++;
-    assert(it->second.ref_count != 0); // did we really make 4 billion refs?!
+    record.ref_count++;
+    assert(record.ref_count != 0); // did we really make 4 billion refs?!
 }
 
 pending_task scheduler::release_ticket(suspended_task::ticket ticket) {
-    auto it = tickets_.find(ticket);
-    assert(it != tickets_.end());
-    assert(it->second.ref_count > 0);
+    ticket_record& record = find_ticket(ticket);
 
-    it->second.ref_count--;
-    if (it->second.ref_count == 0) {
-        pending_task task = std::move(it->second.task);
+    record.ref_count--;
+    if (record.ref_count == 0) {
+        pending_task task = std::move(record.task);
         if (task) {
             assert(suspended_task_count_ > 0);
             suspended_task_count_--;
         }
-        tickets_.erase(it);
+        free_ticket(ticket, record);
         return task;
     }
     return pending_task();
 }
 
 bool scheduler::resume_task_with_ticket(suspended_task::ticket ticket) {
-    auto it = tickets_.find(ticket);
-    assert(it != tickets_.end());
-    assert(it->second.ref_count > 0);
+    ticket_record& record = find_ticket(ticket);
 
     bool did_resume = false;
-    it->second.ref_count--;
-    if (!it->second.was_resumed) {
-        it->second.was_resumed = true;
-        if (it->second.task) {
+    record.ref_count--;
+    if (!record.was_resumed) {
+        record.was_resumed = true;
+        if (record.task) {
             did_resume = true;
             assert(suspended_task_count_ > 0);
             suspended_task_count_--;
-            runnable_tasks_.push(std::move(it->second.task));
+            runnable_tasks_.push(std::move(record.task));
         }
     }
-    if (it->second.ref_count == 0) {
-        tickets_.erase(it);
+    if (record.ref_count == 0) {
+        free_ticket(ticket, record);
     }
     return did_resume;
 }
@@ -112,16 +117,40 @@ void scheduler::take_all_tasks(task_queue* tasks) {
 
     runnable_tasks_.swap(*tasks);
     if (suspended_task_count_ > 0) {
-        for (auto& item : tickets_) {
-            if (item.second.task) {
+        for (auto& record : tickets_) {
+            if (record.task) {
                 assert(suspended_task_count_ > 0);
                 suspended_task_count_--;
-                tasks->push(std::move(item.second.task));
+                tasks->push(std::move(record.task));
             }
         }
     }
 }
 
+scheduler::ticket_record& scheduler::find_ticket(suspended_task::ticket ticket) {
+    const uint32_t index = static_cast<uint32_t>(ticket);
+    assert(index < tickets_.size());
+    ticket_record& record = tickets_[index];
+    assert(record.generation == static_cast<uint32_t>(ticket >> 32));
+    assert(record.ref_count > 0);
+    return record;
+}
+
+void scheduler::free_ticket(suspended_task::ticket ticket,
+                            ticket_record& record) {
+    assert(record.ref_count == 0);
+    assert(!record.task);
+    const uint32_t index = static_cast<uint32_t>(ticket);
+    record.generation++;
+    if (record.generation == 0) {
+        record.generation = 1; // keep tickets non-zero
+    }
+    record.next_free = free_ticket_;
+    free_ticket_ = index;
+    assert(ticket_count_ > 0);
+    ticket_count_--;
+}
+
 } // namespace subtle
 } // namespace fit
 
@@ -9,23 +9,120 @@
 
 namespace fit {
 
-sequencer::sequencer() {
-    // Capture a new consumer and intentionally abandon its associated
-    // completer so that a promise chained onto the consumer using
-    // |promise_or()| will become immediately runnable.
-    fit::bridge<> bridge;
-    prior_ = std::move(bridge.consumer());
+sequencer::sequencer()
+    : queue_(new ::fit::internal::sequencer_queue()) {}
+
+sequencer::~sequencer() {
+    queue_->release();
 }
 
-sequencer::~sequencer() = default;
+namespace internal {
+
+sequencer_queue::sequencer_queue() = default;
 
-fit::consumer<> sequencer::swap_prior(fit::consumer<> new_prior) {
+sequencer_queue::~sequencer_queue() {
+    assert(!head_);
+}
+
+void sequencer_queue::add_ref() {
+    ref_count_.fetch_add(1u, std::memory_order_relaxed);
+}
+
+void sequencer_queue::release() {
+    if (ref_count_.fetch_sub(1u, std::memory_order_acq_rel) == 1u)
+        delete this;
+}
+
+void sequencer_queue::enqueue(waiter* node) {
     std::lock_guard<std::mutex> lock(mutex_);
-    fit::consumer<> old_prior = std::move(prior_);
-    prior_ = std::move(new_prior);
-    return old_prior;
+    assert(!node->linked);
+    node->linked = true;
+    node->prev = tail_;
+    node->next = nullptr;
+    if (tail_) {
+        tail_->next = node;
+    } else {
+        head_ = node;
+    }
+    tail_ = node;
+}
+
+void sequencer_queue::replace(waiter* node, waiter* other) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!other->linked)
+        return;
+    node->linked = true;
+    node->running = other->running;
+    node->prev = other->prev;
+    node->next = other->next;
+    node->task = std::move(other->task);
+    if (node->prev) {
+        node->prev->next = node;
+    } else {
+        head_ = node;
+    }
+    if (node->next) {
+        node->next->prev = node;
+    } else {
+        tail_ = node;
+    }
+    other->linked = false;
+    other->running = false;
+    other->prev = nullptr;
+    other->next = nullptr;
+}
+
+bool sequencer_queue::await_turn(waiter* node, context& context) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        assert(node->linked);
+        if (head_ == node) {
+            node->running = true;
+            return true;
+        }
+    }
+
+    // Obtain the ticket outside of the lock since the executor may hold
+    // a lock of its own while it does so.
+    suspended_task task = context.suspend_task();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (head_ != node) {
+            node->task = std::move(task);
+            return false;
+        }
+        node->running = true;
+    }
+
+    // The prior waiters finished in the meantime, so the ticket is released
+    // without resumption since the task is running anyway.
+    return true;
+}
+
+void sequencer_queue::remove(waiter* node) {
+    suspended_task next_task; // resume outside of the lock
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!node->linked)
+            return;
+        if (node->prev) {
+            node->prev->next = node->next;
+        } else {
+            head_ = node->next;
+            if (head_)
+                next_task = std::move(head_->task);
+        }
+        if (node->next) {
+            node->next->prev = node->prev;
+        } else {
+            tail_ = node->prev;
+        }
+        node->linked = false;
+    }
+    next_task.resume_task();
 }
 
+} // namespace internal
 } // namespace fit
 
 #endif // FIT_NO_STD_FOR_ZIRCON_USERSPACE
@@ -71,6 +71,15 @@ void single_threaded_executor::schedule_task(pending_task task) {
     dispatcher_->schedule_task(std::move(task));
 }
 
+single_threaded_executor::task_storage_stats
+single_threaded_executor::storage_stats() const {
+    task_storage_stats stats;
+    stats.inline_tasks = inline_tasks_.load(std::memory_order_relaxed);
+    stats.slab_tasks = slab_tasks_.load(std::memory_order_relaxed);
+    stats.boxed_tasks = boxed_tasks_.load(std::memory_order_relaxed);
+    return stats;
+}
+
 void single_threaded_executor::run() {
     dispatcher_->run(context_);
 }
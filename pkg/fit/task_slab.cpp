@@ -0,0 +1,78 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Can't compile this for Zircon userspace yet since libstdc++ isn't available.
+#ifndef FIT_NO_STD_FOR_ZIRCON_USERSPACE
+
+#include <lib/fit/task_slab.h>
+
+#include <new>
+
+namespace fit {
+namespace subtle {
+
+// Precedes each block, keeping it aligned for any type.
+struct alignas(max_align_t) task_slab::block_header {
+    task_slab* slab;
+    block_header* next_free;
+    size_t size_class;
+};
+
+task_slab::task_slab() = default;
+
+task_slab::~task_slab() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (block_header*& head : free_blocks_) {
+        while (head) {
+            block_header* next = head->next_free;
+            ::operator delete(head);
+            assert(allocated_block_count_ > 0);
+            allocated_block_count_--;
+            head = next;
+        }
+    }
+    assert(allocated_block_count_ == 0); // a block is still in use
+}
+
+void* task_slab::allocate(size_t size) {
+    if (size > max_block_size)
+        return nullptr;
+    size_t size_class = 0;
+    size_t block_size = min_block_size;
+    while (block_size < size) {
+        size_class++;
+        block_size <<= 1;
+    }
+
+    block_header* header;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        header = free_blocks_[size_class];
+        if (header) {
+            free_blocks_[size_class] = header->next_free;
+        } else {
+            allocated_block_count_++;
+        }
+    }
+    if (!header) {
+        header = static_cast<block_header*>(
+            ::operator new(sizeof(block_header) + block_size));
+        header->slab = this;
+        header->size_class = size_class;
+    }
+    return header + 1;
+}
+
+void task_slab::free(void* block) {
+    block_header* header = static_cast<block_header*>(block) - 1;
+    task_slab* slab = header->slab;
+    std::lock_guard<std::mutex> lock(slab->mutex_);
+    header->next_free = slab->free_blocks_[header->size_class];
+    slab->free_blocks_[header->size_class] = header;
+}
+
+} // namespace subtle
+} // namespace fit
+
+#endif // FIT_NO_STD_FOR_ZIRCON_USERSPACE
@@ -0,0 +1,418 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Can't compile this for Zircon userspace yet since libstdc++ isn't available.
+#ifndef FIT_NO_STD_FOR_ZIRCON_USERSPACE
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <lib/fit/scheduler.h>
+#include <lib/fit/thread_pool_executor.h>
+#include <lib/fit/thread_safety.h>
+
+namespace fit {
+
+// A worker is one of the executor's threads along with its queue of runnable
+// tasks.  It also serves as the context of the tasks it runs.
+class thread_pool_executor::worker final : public context {
+public:
+    worker(thread_pool_executor* executor, dispatcher_impl* dispatcher,
+           size_t index);
+    ~worker() override;
+
+    thread_pool_executor* executor() const override;
+    suspended_task suspend_task() override;
+
+    dispatcher_impl* const dispatcher_;
+    const size_t index_;
+    std::thread thread_;
+
+    // Only accessed by the worker's own thread.
+    suspended_task::ticket current_task_ticket_ = 0;
+
+    // The owner pushes and pops at the back, thieves take from the front.
+    struct {
+        std::mutex mutex_;
+        std::deque<pending_task> tasks_ FIT_GUARDED(mutex_);
+    } queue_;
+
+private:
+    thread_pool_executor* const executor_;
+};
+
+// The dispatcher runs the workers and provides the suspended task resolver.
+//
+// The lifetime of this object is somewhat complex since there are pointers
+// to it from multiple sources which are released in different ways.
+//
+// - |thread_pool_executor| holds a pointer in |dispatcher_| which it releases
+//   after calling |shutdown()| to inform the dispatcher of its own demise
+// - |suspended_task| holds a pointer to the dispatcher's resolver
+//   interface and the number of outstanding pointers corresponds to the
+//   number of outstanding suspended task tickets tracked by |scheduler_|.
+//
+// The dispatcher deletes itself once all pointers have been released.
+//
+// Lock ordering: |guarded_.mutex_| may be held while acquiring a worker's
+// queue mutex, never the other way around.  |sleep_mutex_| is never held
+// while acquiring another lock.
+class thread_pool_executor::dispatcher_impl final
+    : public suspended_task::resolver {
+public:
+    dispatcher_impl(thread_pool_executor* executor, size_t thread_count);
+
+    size_t thread_count() const { return workers_.size(); }
+
+    void shutdown();
+    void schedule_task(pending_task task);
+    void wait_for_idle();
+    suspended_task suspend_current_task(worker* self);
+
+    suspended_task::ticket duplicate_ticket(
+        suspended_task::ticket ticket) override;
+    void resolve_ticket(
+        suspended_task::ticket ticket, bool resume_task) override;
+
+private:
+    ~dispatcher_impl() override;
+
+    void run_worker(worker* self);
+    bool take_task(worker* self, pending_task* out_task);
+    bool wait_for_work();
+    void run_task(worker* self, pending_task* task);
+
+    // Queues a runnable task on the calling worker, or on the next worker in
+    // turn if called from another thread, and wakes a sleeping worker.
+    void push_task(pending_task task);
+
+    // Called once a task has completed or been abandoned.
+    void task_done();
+
+    std::vector<std::unique_ptr<worker>> workers_;
+    std::atomic<size_t> next_worker_{0};
+
+    // The number of tasks sitting in the workers' queues.
+    std::atomic<size_t> queued_count_{0};
+
+    // The number of tasks that are queued, running, or suspended.
+    std::atomic<size_t> outstanding_count_{0};
+
+    // Workers sleep here when there is nothing to run or steal, and
+    // |wait_for_idle()| sleeps here until |outstanding_count_| drops to zero.
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::atomic<size_t> sleeper_count_{0};
+    bool stopping_ FIT_GUARDED(sleep_mutex_) = false;
+
+    // The tickets of suspended tasks, shared by all workers.
+    struct {
+        std::mutex mutex_;
+        bool was_shutdown_ FIT_GUARDED(mutex_) = false;
+        fit::subtle::scheduler scheduler_ FIT_GUARDED(mutex_);
+    } guarded_;
+
+    // The worker whose thread is the calling thread, if any.
+    static thread_local worker* current_worker_;
+};
+
+thread_local thread_pool_executor::worker*
+    thread_pool_executor::dispatcher_impl::current_worker_ = nullptr;
+
+thread_pool_executor::thread_pool_executor(size_t thread_count)
+    : dispatcher_(new dispatcher_impl(this, thread_count)) {}
+
+thread_pool_executor::~thread_pool_executor() {
+    dispatcher_->shutdown();
+}
+
+size_t thread_pool_executor::thread_count() const {
+    return dispatcher_->thread_count();
+}
+
+void thread_pool_executor::schedule_task(pending_task task) {
+    assert(task);
+    dispatcher_->schedule_task(std::move(task));
+}
+
+void thread_pool_executor::wait_for_idle() {
+    dispatcher_->wait_for_idle();
+}
+
+thread_pool_executor::worker::worker(thread_pool_executor* executor,
+                                     dispatcher_impl* dispatcher, size_t index)
+    : dispatcher_(dispatcher), index_(index), executor_(executor) {}
+
+thread_pool_executor::worker::~worker() = default;
+
+thread_pool_executor* thread_pool_executor::worker::executor() const {
+    return executor_;
+}
+
+suspended_task thread_pool_executor::worker::suspend_task() {
+    return dispatcher_->suspend_current_task(this);
+}
+
+thread_pool_executor::dispatcher_impl::dispatcher_impl(
+    thread_pool_executor* executor, size_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::thread::hardware_concurrency();
+        if (thread_count == 0) {
+            thread_count = 1;
+        }
+    }
+
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; i++) {
+        workers_.emplace_back(new worker(executor, this, i));
+    }
+    // Start the threads only once every worker exists, since they steal
+    // from each other.
+    for (auto& w : workers_) {
+        w->thread_ = std::thread(&dispatcher_impl::run_worker, this, w.get());
+    }
+}
+
+thread_pool_executor::dispatcher_impl::~dispatcher_impl() {
+    std::lock_guard<std::mutex> lock(guarded_.mutex_);
+    assert(guarded_.was_shutdown_);
+    assert(!guarded_.scheduler_.has_runnable_tasks());
+    assert(!guarded_.scheduler_.has_suspended_tasks());
+    assert(!guarded_.scheduler_.has_outstanding_tickets());
+}
+
+void thread_pool_executor::dispatcher_impl::shutdown() {
+    assert(current_worker_ == nullptr);
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& w : workers_) {
+        w->thread_.join();
+    }
+
+    fit::subtle::scheduler::task_queue tasks; // drop outside of the lock
+    std::vector<pending_task> queued_tasks;   // ditto
+    {
+        std::lock_guard<std::mutex> lock(guarded_.mutex_);
+        assert(!guarded_.was_shutdown_);
+        guarded_.was_shutdown_ = true;
+        guarded_.scheduler_.take_all_tasks(&tasks);
+        for (auto& w : workers_) {
+            std::lock_guard<std::mutex> queue_lock(w->queue_.mutex_);
+            for (auto& task : w->queue_.tasks_) {
+                queued_tasks.push_back(std::move(task));
+            }
+            w->queue_.tasks_.clear();
+        }
+        if (guarded_.scheduler_.has_outstanding_tickets()) {
+            return; // can't delete self yet
+        }
+    }
+
+    // Must destroy self outside of the lock.
+    delete this;
+}
+
+void thread_pool_executor::dispatcher_impl::schedule_task(pending_task task) {
+    outstanding_count_.fetch_add(1);
+    push_task(std::move(task));
+}
+
+// Unfortunately std::unique_lock does not support thread-safety annotations
+void thread_pool_executor::dispatcher_impl::wait_for_idle()
+    FIT_NO_THREAD_SAFETY_ANALYSIS {
+    assert(current_worker_ == nullptr);
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    idle_.wait(lock, [this] { return outstanding_count_.load() == 0; });
+}
+
+// Must only be called while |run_task()| is running a task on |self|.
+// This happens when the task's continuation calls |context::suspend_task()|
+// upon the context it received as an argument.
+suspended_task thread_pool_executor::dispatcher_impl::suspend_current_task(
+    worker* self) {
+    assert(self == current_worker_);
+    std::lock_guard<std::mutex> lock(guarded_.mutex_);
+    assert(!guarded_.was_shutdown_);
+    if (self->current_task_ticket_ == 0) {
+        self->current_task_ticket_ = guarded_.scheduler_.obtain_ticket(
+            2 /*initial_refs*/);
+    } else {
+        guarded_.scheduler_.duplicate_ticket(self->current_task_ticket_);
+    }
+    return suspended_task(this, self->current_task_ticket_);
+}
+
+void thread_pool_executor::dispatcher_impl::run_worker(worker* self) {
+    current_worker_ = self;
+    pending_task task;
+    for (;;) {
+        if (take_task(self, &task)) {
+            run_task(self, &task);
+            task = pending_task(); // the task may be destroyed here if it was not suspended
+        } else if (!wait_for_work()) {
+            break;
+        }
+    }
+    current_worker_ = nullptr;
+}
+
+bool thread_pool_executor::dispatcher_impl::take_task(worker* self,
+                                                      pending_task* out_task) {
+    {
+        std::lock_guard<std::mutex> lock(self->queue_.mutex_);
+        if (!self->queue_.tasks_.empty()) {
+            *out_task = std::move(self->queue_.tasks_.back());
+            self->queue_.tasks_.pop_back();
+            queued_count_.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // Steal from the other workers, starting with the next one.
+    const size_t count = workers_.size();
+    for (size_t i = 1; i < count; i++) {
+        worker* victim = workers_[(self->index_ + i) % count].get();
+        std::lock_guard<std::mutex> lock(victim->queue_.mutex_);
+        if (!victim->queue_.tasks_.empty()) {
+            *out_task = std::move(victim->queue_.tasks_.front());
+            victim->queue_.tasks_.pop_front();
+            queued_count_.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns false once the executor is stopping.
+// Unfortunately std::unique_lock does not support thread-safety annotations
+bool thread_pool_executor::dispatcher_impl::wait_for_work()
+    FIT_NO_THREAD_SAFETY_ANALYSIS {
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    // |push_task()| increments |queued_count_| before it checks
+    // |sleeper_count_|, and this increments |sleeper_count_| before it checks
+    // |queued_count_|, so one of the two always sees the other.
+    sleeper_count_.fetch_add(1);
+    while (!stopping_ && queued_count_.load() == 0) {
+        wake_.wait(lock);
+    }
+    sleeper_count_.fetch_sub(1);
+    return !stopping_;
+}
+
+void thread_pool_executor::dispatcher_impl::run_task(worker* self,
+                                                     pending_task* task) {
+    assert(self->current_task_ticket_ == 0);
+    const bool finished = (*task)(*self);
+    assert(!*task == finished);
+    (void)finished;
+    if (self->current_task_ticket_ == 0) {
+        // The task was not suspended, no ticket was produced.  It is either
+        // finished or abandoned.
+        *task = pending_task();
+        task_done();
+        return;
+    }
+
+    fit::subtle::scheduler::task_queue resumed_tasks;
+    {
+        std::lock_guard<std::mutex> lock(guarded_.mutex_);
+        guarded_.scheduler_.finalize_ticket(self->current_task_ticket_, task);
+        self->current_task_ticket_ = 0;
+        // The task may have been resumed on another thread while it ran.
+        guarded_.scheduler_.take_runnable_tasks(&resumed_tasks);
+        while (!resumed_tasks.empty()) {
+            push_task(std::move(resumed_tasks.front()));
+            resumed_tasks.pop();
+        }
+    }
+    if (finished || *task) {
+        // Either finished, or abandoned since every ticket was already
+        // released: the task is ours to destroy.
+        *task = pending_task();
+        task_done();
+    }
+}
+
+// May be called with or without |guarded_.mutex_| held.
+void thread_pool_executor::dispatcher_impl::push_task(pending_task task) {
+    worker* target = current_worker_;
+    if (target == nullptr || target->dispatcher_ != this) {
+        target = workers_[next_worker_.fetch_add(1) % workers_.size()].get();
+    }
+    {
+        std::lock_guard<std::mutex> lock(target->queue_.mutex_);
+        target->queue_.tasks_.push_back(std::move(task));
+    }
+    queued_count_.fetch_add(1);
+    if (sleeper_count_.load() > 0) {
+        // Taking the lock ensures the sleeper is actually waiting.
+        { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+        wake_.notify_one();
+    }
+}
+
+void thread_pool_executor::dispatcher_impl::task_done() {
+    if (outstanding_count_.fetch_sub(1) == 1) {
+        { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+        idle_.notify_all();
+    }
+}
+
+suspended_task::ticket thread_pool_executor::dispatcher_impl::duplicate_ticket(
+    suspended_task::ticket ticket) {
+    std::lock_guard<std::mutex> lock(guarded_.mutex_);
+    guarded_.scheduler_.duplicate_ticket(ticket);
+    return ticket;
+}
+
+void thread_pool_executor::dispatcher_impl::resolve_ticket(
+    suspended_task::ticket ticket, bool resume_task) {
+    pending_task abandoned_task; // drop outside of the lock
+    bool was_shutdown;
+    {
+        std::lock_guard<std::mutex> lock(guarded_.mutex_);
+        if (resume_task) {
+            guarded_.scheduler_.resume_task_with_ticket(ticket);
+        } else {
+            abandoned_task = guarded_.scheduler_.release_ticket(ticket);
+        }
+        was_shutdown = guarded_.was_shutdown_;
+        if (!was_shutdown) {
+            // Queue the resumed task while holding the lock, so that
+            // |shutdown()| cannot miss it.
+            fit::subtle::scheduler::task_queue resumed_tasks;
+            guarded_.scheduler_.take_runnable_tasks(&resumed_tasks);
+            while (!resumed_tasks.empty()) {
+                push_task(std::move(resumed_tasks.front()));
+                resumed_tasks.pop();
+            }
+        } else if (guarded_.scheduler_.has_outstanding_tickets()) {
+            return; // can't delete self yet
+        }
+    }
+
+    if (!was_shutdown) {
+        if (abandoned_task) {
+            abandoned_task = pending_task();
+            task_done();
+        }
+        return;
+    }
+
+    // Must destroy self outside of the lock.
+    delete this;
+}
+
+} // namespace fit
+
+#endif // FIT_NO_STD_FOR_ZIRCON_USERSPACE
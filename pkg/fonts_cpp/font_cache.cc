@@ -0,0 +1,144 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/fonts/cpp/font_cache.h"
+
+#include <ctype.h>
+#include <zircon/assert.h>
+
+namespace fonts {
+namespace {
+
+void AppendUint32(std::string* key, uint32_t value) {
+  key->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Appends |value| with its length, so that no two lists of strings make the
+// same key.
+void AppendString(std::string* key, const std::string& value) {
+  AppendUint32(key, static_cast<uint32_t>(value.size()));
+  key->append(value);
+}
+
+}  // namespace
+
+FontCache::FontCache(fuchsia::fonts::ProviderSyncPtr provider, size_t budget)
+    : provider_(std::move(provider)), budget_(budget) {
+  ZX_DEBUG_ASSERT(provider_);
+}
+
+FontCache::~FontCache() = default;
+
+zx_status_t FontCache::GetFont(const fuchsia::fonts::Request& request,
+                               Font* out_font) {
+  std::string key = MakeKey(request);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto answer = answers_.find(key);
+    if (answer != answers_.end()) {
+      File& file = files_.at(answer->second.buffer_id);
+      Touch(&file);
+      out_font->data = file.data;
+      out_font->font_index = answer->second.font_index;
+      return ZX_OK;
+    }
+  }
+
+  fuchsia::fonts::Request copy;
+  zx_status_t status = request.Clone(&copy);
+  if (status != ZX_OK)
+    return status;
+  std::unique_ptr<fuchsia::fonts::Response> response;
+  status = provider_->GetFont(std::move(copy), &response);
+  if (status != ZX_OK)
+    return status;
+  if (!response) {
+    *out_font = Font();
+    return ZX_OK;
+  }
+  const uint32_t buffer_id = response->buffer_id;
+
+  // Map the file unless another request has already, outside the lock so
+  // that hits on other threads do not wait for it.
+  std::shared_ptr<const FontData> data;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto file = files_.find(buffer_id);
+    if (file != files_.end())
+      data = file->second.data;
+  }
+  if (!data) {
+    const size_t size = response->buffer.size;
+    zx::mapped_vmo mapping;
+    status = mapping.map(response->buffer.vmo, 0u, size, ZX_VM_PERM_READ);
+    if (status != ZX_OK)
+      return status;
+    data = std::make_shared<FontData>(std::move(mapping), size, buffer_id);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto file = files_.find(buffer_id);
+  if (file == files_.end()) {
+    file = files_.emplace(buffer_id, File()).first;
+    file->second.data = data;
+    lru_.push_front(buffer_id);
+    file->second.position = lru_.begin();
+    cached_bytes_ += data->size();
+  } else {
+    // Another thread mapped the file meanwhile; share its mapping.
+    data = file->second.data;
+    Touch(&file->second);
+  }
+  if (answers_.emplace(key, Answer{buffer_id, response->font_index}).second)
+    file->second.keys.push_back(std::move(key));
+  Trim();
+
+  out_font->data = std::move(data);
+  out_font->font_index = response->font_index;
+  return ZX_OK;
+}
+
+size_t FontCache::cached_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return cached_bytes_;
+}
+
+std::string FontCache::MakeKey(const fuchsia::fonts::Request& request) {
+  std::string key;
+  // Families are matched regardless of case.
+  std::string family = request.family.is_null() ? "" : request.family.get();
+  for (char& c : family)
+    c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+  AppendString(&key, family);
+  AppendUint32(&key, request.weight);
+  AppendUint32(&key, request.width);
+  AppendUint32(&key, static_cast<uint32_t>(request.slant));
+  AppendUint32(&key, request.character);
+  AppendUint32(&key, static_cast<uint32_t>(request.fallback_group));
+  AppendUint32(&key, request.flags);
+  if (!request.language.is_null()) {
+    for (const auto& language : *request.language)
+      AppendString(&key, language.is_null() ? "" : language.get());
+  }
+  return key;
+}
+
+void FontCache::Touch(File* file) {
+  lru_.splice(lru_.begin(), lru_, file->position);
+}
+
+void FontCache::Trim() {
+  // Keep the file used last even if it alone exceeds the budget.
+  while (cached_bytes_ > budget_ && lru_.size() > 1u) {
+    auto file = files_.find(lru_.back());
+    ZX_DEBUG_ASSERT(file != files_.end());
+    for (const std::string& key : file->second.keys)
+      answers_.erase(key);
+    cached_bytes_ -= file->second.data->size();
+    lru_.pop_back();
+    files_.erase(file);
+  }
+}
+
+}  // namespace fonts
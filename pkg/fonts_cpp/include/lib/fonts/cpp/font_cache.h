@@ -0,0 +1,121 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FONTS_CPP_FONT_CACHE_H_
+#define LIB_FONTS_CPP_FONT_CACHE_H_
+
+#include <fuchsia/fonts/cpp/fidl.h>
+#include <lib/zx/mapped_vmo.h>
+#include <zircon/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fonts {
+
+// The data of a font file, mapped read-only.
+class FontData {
+ public:
+  FontData(zx::mapped_vmo mapping, size_t size, uint32_t buffer_id)
+      : mapping_(std::move(mapping)), size_(size), buffer_id_(buffer_id) {}
+
+  FontData(const FontData&) = delete;
+  FontData& operator=(const FontData&) = delete;
+
+  const uint8_t* data() const {
+    return static_cast<const uint8_t*>(mapping_.data());
+  }
+  size_t size() const { return size_; }
+
+  // The |buffer_id| of the |fuchsia::fonts::Response|.
+  uint32_t buffer_id() const { return buffer_id_; }
+
+ private:
+  const zx::mapped_vmo mapping_;
+  const size_t size_;
+  const uint32_t buffer_id_;
+};
+
+// Caches the fonts returned by a |fuchsia::fonts::Provider|.
+//
+// Fonts are cached by the fields of their |fuchsia::fonts::Request|, so a
+// request made before is answered without a round trip. Each font file is
+// mapped once, read-only, and shared by every request that the provider
+// answers with it, as told by its |buffer_id|, and by every user holding it:
+// the data is never copied.
+//
+// The cache keeps the most recently used files within its memory budget. A
+// file that the cache lets go of stays mapped for as long as a user holds
+// it.
+//
+// One cache is meant to be shared by all the font users of a process. It is
+// thread-safe; misses on several threads call the provider concurrently.
+class FontCache {
+ public:
+  struct Font {
+    // Null if the provider has no font for the request.
+    std::shared_ptr<const FontData> data;
+    // The index of the font within |data|, for files holding several.
+    uint32_t font_index = 0u;
+  };
+
+  // Calls |provider|, with up to |budget| bytes of font files cached.
+  explicit FontCache(fuchsia::fonts::ProviderSyncPtr provider,
+                     size_t budget = 16u * 1024u * 1024u);
+  ~FontCache();
+
+  FontCache(const FontCache&) = delete;
+  FontCache& operator=(const FontCache&) = delete;
+
+  // Returns the font matching |request|, asking the provider for it unless
+  // cached.
+  //
+  // Returns |ZX_OK| with a null font if the provider has none, or the error
+  // that stopped the call or the mapping.
+  zx_status_t GetFont(const fuchsia::fonts::Request& request, Font* out_font);
+
+  // The bytes of font files cached.
+  size_t cached_bytes() const;
+
+ private:
+  struct File {
+    std::shared_ptr<const FontData> data;
+    // The requests answered with the file, which are forgotten with it.
+    std::vector<std::string> keys;
+    std::list<uint32_t>::iterator position;
+  };
+
+  struct Answer {
+    uint32_t buffer_id = 0u;
+    uint32_t font_index = 0u;
+  };
+
+  static std::string MakeKey(const fuchsia::fonts::Request& request);
+
+  // Must be called with |mutex_| held.
+  void Touch(File* file);
+  void Trim();
+
+  fuchsia::fonts::ProviderSyncPtr provider_;
+  const size_t budget_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Answer> answers_;
+  std::unordered_map<uint32_t, File> files_;
+  // Buffer ids, most recently used first.
+  std::list<uint32_t> lru_;
+  size_t cached_bytes_ = 0u;
+};
+
+}  // namespace fonts
+
+#endif  // LIB_FONTS_CPP_FONT_CACHE_H_
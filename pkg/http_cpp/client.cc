@@ -0,0 +1,327 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/http/cpp/client.h"
+
+#include <lib/async/wait.h>
+#include <lib/fidl/cpp/binding.h>
+#include <lib/zx/mapped_vmo.h>
+#include <lib/zx/socket.h>
+#include <zircon/assert.h>
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace http {
+namespace {
+
+// The most bytes read from a body socket at a time.
+constexpr size_t kBodyBufferSize = 64u * 1024u;
+
+// The most reads from a body socket in one turn of the dispatcher, so that
+// a fast body does not starve the dispatcher's other work.
+constexpr size_t kMaxReadsPerWakeup = 16u;
+
+}  // namespace
+
+// A request, from when it is queued until its response is complete.
+class Client::Operation {
+ public:
+  Operation(Client* client, fuchsia::net::http::Request request)
+      : client(client), request_(std::move(request)) {}
+  virtual ~Operation() = default;
+
+  // Sends the request on |connection|.
+  virtual void Run(Connection* connection) = 0;
+
+  // Ends the operation with |status| before it has a response.
+  virtual void Fail(zx_status_t status) = 0;
+
+  Client* const client;
+  // The connection the request awaits its response on, if any.
+  Connection* connection = nullptr;
+  std::list<std::unique_ptr<Operation>>::iterator position;
+
+ protected:
+  fuchsia::net::http::Request request_;
+};
+
+class Client::FetchOperation final : public Operation {
+ public:
+  using Callback = fit::function<void(zx_status_t status,
+                                      fuchsia::net::http::Response response)>;
+
+  FetchOperation(Client* client, fuchsia::net::http::Request request,
+                 Callback callback)
+      : Operation(client, std::move(request)),
+        callback_(std::move(callback)) {}
+
+  void Run(Connection* connection) override {
+    this->connection = connection;
+    connection->loader->Fetch(
+        std::move(request_), [this](fuchsia::net::http::Response response) {
+          Complete(ZX_OK, std::move(response));
+        });
+  }
+
+  void Fail(zx_status_t status) override {
+    Complete(status, fuchsia::net::http::Response());
+  }
+
+ private:
+  void Complete(zx_status_t status, fuchsia::net::http::Response response) {
+    Callback callback = std::move(callback_);
+    client->Finish(this);
+    if (callback)
+      callback(status, std::move(response));
+  }
+
+  Callback callback_;
+};
+
+class Client::StreamOperation final : public Operation,
+                                      public fuchsia::net::http::LoaderClient,
+                                      private async_wait_t {
+ public:
+  StreamOperation(Client* client, fuchsia::net::http::Request request,
+                  StreamHandlers handlers)
+      : Operation(client, std::move(request)),
+        async_wait_t{{ASYNC_STATE_INIT}, &StreamOperation::CallHandler,
+                     ZX_HANDLE_INVALID,
+                     ZX_SOCKET_READABLE | ZX_SOCKET_PEER_CLOSED |
+                         ZX_SOCKET_READ_DISABLED},
+        handlers_(std::move(handlers)),
+        binding_(this) {}
+
+  ~StreamOperation() override {
+    if (waiting_)
+      async_cancel_wait(client->dispatcher_, this);
+  }
+
+  void Run(Connection* connection) override {
+    this->connection = connection;
+    request_.response_body_mode = fuchsia::net::http::ResponseBodyMode::STREAM;
+    connection->loader->Start(std::move(request_),
+                              binding_.NewBinding(client->dispatcher_));
+    binding_.set_error_handler([this](zx_status_t status) {
+      if (!has_response_)
+        Complete(ZX_ERR_PEER_CLOSED);
+    });
+  }
+
+  void Fail(zx_status_t status) override { Complete(status); }
+
+ private:
+  // |fuchsia::net::http::LoaderClient|
+  void OnResponse(fuchsia::net::http::Response response,
+                  std::unique_ptr<fuchsia::net::http::RedirectTarget> redirect,
+                  OnResponseCallback callback) override {
+    if (redirect) {
+      if (handlers_.on_redirect)
+        handlers_.on_redirect(*redirect);
+      callback();
+      return;
+    }
+
+    // The body no longer needs the loader, so its connection may take
+    // another request.
+    has_response_ = true;
+    client->ReleaseConnection(this);
+    std::unique_ptr<fuchsia::net::http::Body> body = std::move(response.body);
+    const bool failed = response.error != nullptr;
+    if (handlers_.on_response)
+      handlers_.on_response(response);
+    callback();
+
+    if (failed) {
+      Complete(ZX_ERR_IO);
+    } else if (body && body->is_stream()) {
+      socket_ = std::move(body->stream());
+      object = socket_.get();
+      buffer_.reset(new uint8_t[kBodyBufferSize]);
+      BeginWait();
+    } else if (body && body->is_buffer()) {
+      Complete(DeliverBuffer(body->buffer()));
+    } else {
+      Complete(ZX_OK);
+    }
+  }
+
+  zx_status_t DeliverBuffer(const fuchsia::mem::Buffer& buffer) {
+    if (buffer.size == 0u)
+      return ZX_OK;
+    zx::mapped_vmo mapping;
+    zx_status_t status =
+        mapping.map(buffer.vmo, 0u, buffer.size, ZX_VM_PERM_READ);
+    if (status != ZX_OK)
+      return status;
+    if (handlers_.on_body)
+      handlers_.on_body(mapping.data(), buffer.size);
+    return ZX_OK;
+  }
+
+  void BeginWait() {
+    zx_status_t status = async_begin_wait(client->dispatcher_, this);
+    if (status != ZX_OK) {
+      Complete(status);
+      return;
+    }
+    waiting_ = true;
+  }
+
+  static void CallHandler(async_dispatcher_t* dispatcher, async_wait_t* wait,
+                          zx_status_t status,
+                          const zx_packet_signal_t* signal) {
+    static_cast<StreamOperation*>(wait)->OnReadable(status);
+  }
+
+  void OnReadable(zx_status_t status) {
+    waiting_ = false;
+    if (status != ZX_OK) {
+      Complete(status);
+      return;
+    }
+    for (size_t i = 0u; i < kMaxReadsPerWakeup; ++i) {
+      size_t actual = 0u;
+      status = socket_.read(0u, buffer_.get(), kBodyBufferSize, &actual);
+      if (status == ZX_ERR_SHOULD_WAIT)
+        break;
+      // The body ends once the loader closes the socket or shuts it down
+      // for writing, and everything it wrote has been read.
+      if (status == ZX_ERR_PEER_CLOSED || status == ZX_ERR_BAD_STATE) {
+        Complete(ZX_OK);
+        return;
+      }
+      if (status != ZX_OK) {
+        Complete(status);
+        return;
+      }
+      if (handlers_.on_body)
+        handlers_.on_body(buffer_.get(), actual);
+    }
+    BeginWait();
+  }
+
+  void Complete(zx_status_t status) {
+    fit::function<void(zx_status_t)> on_complete =
+        std::move(handlers_.on_complete);
+    client->Finish(this);
+    if (on_complete)
+      on_complete(status);
+  }
+
+  StreamHandlers handlers_;
+  fidl::Binding<fuchsia::net::http::LoaderClient> binding_;
+  bool has_response_ = false;
+  zx::socket socket_;
+  std::unique_ptr<uint8_t[]> buffer_;
+  bool waiting_ = false;
+};
+
+Client::Client(Connector connector, async_dispatcher_t* dispatcher,
+               size_t max_connections, size_t max_requests)
+    : connector_(std::move(connector)),
+      dispatcher_(dispatcher),
+      max_connections_(std::max<size_t>(max_connections, 1u)),
+      max_requests_(std::max<size_t>(max_requests, 1u)) {
+  ZX_DEBUG_ASSERT(connector_);
+}
+
+Client::~Client() = default;
+
+void Client::Start(fuchsia::net::http::Request request,
+                   StreamHandlers handlers) {
+  Enqueue(std::make_unique<StreamOperation>(this, std::move(request),
+                                            std::move(handlers)));
+}
+
+void Client::Fetch(
+    fuchsia::net::http::Request request,
+    fit::function<void(zx_status_t, fuchsia::net::http::Response)>
+        callback) {
+  Enqueue(std::make_unique<FetchOperation>(this, std::move(request),
+                                           std::move(callback)));
+}
+
+void Client::Enqueue(std::unique_ptr<Operation> operation) {
+  queued_.push_back(std::move(operation));
+  RunQueued();
+}
+
+void Client::RunQueued() {
+  while (!queued_.empty() && running_.size() < max_requests_) {
+    Connection* connection = PickConnection();
+    running_.splice(running_.end(), queued_, queued_.begin());
+    Operation* operation = running_.back().get();
+    operation->position = std::prev(running_.end());
+    if (!connection) {
+      operation->Fail(ZX_ERR_UNAVAILABLE);
+      continue;
+    }
+    ++connection->active;
+    operation->Run(connection);
+  }
+}
+
+Client::Connection* Client::PickConnection() {
+  // Prefer an idle connection, then a new one, then pipelining on the
+  // least busy one.
+  Connection* least_busy = nullptr;
+  for (const auto& connection : connections_) {
+    if (connection->active == 0u)
+      return connection.get();
+    if (!least_busy || connection->active < least_busy->active)
+      least_busy = connection.get();
+  }
+  if (connections_.size() < max_connections_) {
+    fuchsia::net::http::LoaderPtr loader = connector_();
+    if (loader.is_bound()) {
+      auto connection = std::make_unique<Connection>();
+      Connection* raw_connection = connection.get();
+      connection->loader = std::move(loader);
+      connection->loader.set_error_handler(
+          [this, raw_connection](zx_status_t status) {
+            OnConnectionError(raw_connection);
+          });
+      connections_.push_back(std::move(connection));
+      return raw_connection;
+    }
+  }
+  return least_busy;
+}
+
+void Client::ReleaseConnection(Operation* operation) {
+  if (!operation->connection)
+    return;
+  --operation->connection->active;
+  operation->connection = nullptr;
+}
+
+void Client::Finish(Operation* operation) {
+  ReleaseConnection(operation);
+  running_.erase(operation->position);
+  RunQueued();
+}
+
+void Client::OnConnectionError(Connection* connection) {
+  // Drop the connection before failing its requests, so that the requests
+  // queued behind them do not pick it.
+  std::vector<Operation*> failed;
+  for (const auto& operation : running_) {
+    if (operation->connection == connection) {
+      operation->connection = nullptr;
+      failed.push_back(operation.get());
+    }
+  }
+  connections_.erase(
+      std::find_if(connections_.begin(), connections_.end(),
+                   [connection](const std::unique_ptr<Connection>& c) {
+                     return c.get() == connection;
+                   }));
+  for (Operation* operation : failed)
+    operation->Fail(ZX_ERR_PEER_CLOSED);
+}
+
+}  // namespace http
@@ -0,0 +1,111 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_HTTP_CPP_CLIENT_H_
+#define LIB_HTTP_CPP_CLIENT_H_
+
+#include <fuchsia/net/http/cpp/fidl.h>
+#include <lib/async/dispatcher.h>
+#include <lib/fit/function.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <memory>
+#include <vector>
+
+namespace http {
+
+// Sends requests through a pool of |fuchsia::net::http::Loader| connections.
+//
+// The client opens connections as requests need them, up to
+// |max_connections|, and reuses them for later requests. Once every
+// connection is busy, further requests are pipelined on the least busy one.
+// At most |max_requests| requests run at once; the rest wait in order. A
+// request runs until its body has been read.
+//
+// |Start()| streams the response body: the client asks the loader for the
+// body as a socket, and hands the bytes to the caller as they arrive. Bodies
+// that the loader returns in a VMO anyway are mapped and handed over in one
+// piece rather than copied.
+//
+// The client must be used on the thread of |dispatcher|. Its callbacks must
+// not destroy it.
+class Client {
+ public:
+  // Opens a new connection to a loader.
+  using Connector = fit::function<fuchsia::net::http::LoaderPtr()>;
+
+  struct StreamHandlers {
+    // Called before the loader follows each redirect.
+    fit::function<void(const fuchsia::net::http::RedirectTarget&)>
+        on_redirect;
+
+    // Called with the final response, without its body.
+    fit::function<void(const fuchsia::net::http::Response&)> on_response;
+
+    // Called with each part of the body, in order. The bytes are valid
+    // only during the call.
+    fit::function<void(const uint8_t* data, size_t size)> on_body;
+
+    // Called last, with |ZX_OK| once the whole body has been read,
+    // |ZX_ERR_IO| if the response carries an error, or the error that
+    // stopped the request.
+    fit::function<void(zx_status_t status)> on_complete;
+  };
+
+  Client(Connector connector, async_dispatcher_t* dispatcher,
+         size_t max_connections = 4u, size_t max_requests = 16u);
+  ~Client();
+
+  Client(const Client&) = delete;
+  Client& operator=(const Client&) = delete;
+
+  // Sends |request| and streams its response to |handlers|.
+  void Start(fuchsia::net::http::Request request, StreamHandlers handlers);
+
+  // Sends |request| and calls |callback| with the whole response, or with
+  // |ZX_ERR_PEER_CLOSED| and an empty response if the connection closes
+  // first.
+  void Fetch(fuchsia::net::http::Request request,
+             fit::function<void(zx_status_t status,
+                                fuchsia::net::http::Response response)>
+                 callback);
+
+  // The number of requests running and waiting to run.
+  size_t running_requests() const { return running_.size(); }
+  size_t queued_requests() const { return queued_.size(); }
+
+ private:
+  class Operation;
+  class FetchOperation;
+  class StreamOperation;
+
+  struct Connection {
+    fuchsia::net::http::LoaderPtr loader;
+    // The requests sent on the connection that await their responses.
+    size_t active = 0u;
+  };
+
+  void Enqueue(std::unique_ptr<Operation> operation);
+  void RunQueued();
+  Connection* PickConnection();
+  void ReleaseConnection(Operation* operation);
+  void Finish(Operation* operation);
+  void OnConnectionError(Connection* connection);
+
+  Connector connector_;
+  async_dispatcher_t* const dispatcher_;
+  const size_t max_connections_;
+  const size_t max_requests_;
+
+  std::vector<std::unique_ptr<Connection>> connections_;
+  std::list<std::unique_ptr<Operation>> queued_;
+  std::list<std::unique_ptr<Operation>> running_;
+};
+
+}  // namespace http
+
+#endif  // LIB_HTTP_CPP_CLIENT_H_
@@ -0,0 +1,559 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/images/cpp/convert.h"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "lib/images/cpp/images.h"
+
+namespace images {
+namespace {
+
+using fuchsia::images::ImageInfo;
+using fuchsia::images::PixelFormat;
+
+// The BT.601 limited range conversions, in 8.8 fixed point:
+//
+//   R = 1.164 (Y - 16) + 1.596 (V - 128)
+//   G = 1.164 (Y - 16) - 0.391 (U - 128) - 0.813 (V - 128)
+//   B = 1.164 (Y - 16) + 2.018 (U - 128)
+//
+//   Y =  0.257 R + 0.504 G + 0.098 B + 16
+//   U = -0.148 R - 0.291 G + 0.439 B + 128
+//   V =  0.439 R - 0.368 G - 0.071 B + 128
+//
+// The vector kernels compute exactly the same values as the scalar code.
+
+uint8_t Clamp(int value) {
+  return value < 0 ? 0 : value > 255 ? 255 : static_cast<uint8_t>(value);
+}
+
+void YuvToBgra(int y, int u, int v, uint8_t* dst) {
+  const int c = 298 * (y - 16) + 128;
+  const int d = u - 128;
+  const int e = v - 128;
+  dst[0] = Clamp((c + 516 * d) >> 8);
+  dst[1] = Clamp((c - 100 * d - 208 * e) >> 8);
+  dst[2] = Clamp((c + 409 * e) >> 8);
+  dst[3] = 0xff;
+}
+
+uint8_t BgraToY(const uint8_t* src) {
+  return static_cast<uint8_t>(
+      ((66 * src[2] + 129 * src[1] + 25 * src[0] + 128) >> 8) + 16);
+}
+
+// Converts a 2x2 block of pixels, of which |src0| and |src1| each point at a
+// row of two, to chroma from the average of their colors.
+void BgraToUv(const uint8_t* src0, const uint8_t* src1, uint8_t* uv) {
+  const int b = (src0[0] + src0[4] + src1[0] + src1[4] + 2) >> 2;
+  const int g = (src0[1] + src0[5] + src1[1] + src1[5] + 2) >> 2;
+  const int r = (src0[2] + src0[6] + src1[2] + src1[6] + 2) >> 2;
+  uv[0] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+  uv[1] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+// The vector kernels each convert a run of 8 pixels, and the functions below
+// return the number of pixels of a row they converted, a multiple of 8. The
+// scalar loops pick up from there.
+#if defined(__SSE2__)
+
+bool CanStream(StoreMode store_mode, const void* dst) {
+  return store_mode == StoreMode::kNonTemporal &&
+         reinterpret_cast<uintptr_t>(dst) % 16u == 0u;
+}
+
+// Orders non-temporal stores before any later stores, such as the one that
+// tells another thread the conversion is done.
+void Fence() { _mm_sfence(); }
+
+// Stores 16 bytes, bypassing the cache if |stream|, in which case |dst| must
+// be 16-byte aligned.
+void Store16(uint8_t* dst, __m128i value, bool stream) {
+  if (stream)
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst), value);
+  else
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), value);
+}
+
+// Copies the 16-byte blocks of a row to 16-byte aligned |dst| with
+// non-temporal stores, returning the number of bytes copied.
+size_t StreamRow(const uint8_t* src, uint8_t* dst, size_t size) {
+  size_t i = 0u;
+  for (; i + 16u <= size; i += 16u) {
+    Store16(dst + i,
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), true);
+  }
+  return i;
+}
+
+// Converts 8 pixels from 16-bit Y values and interleaved 16-bit U and V
+// values, one pair for every two pixels.
+void YuvToBgra8(__m128i y, __m128i uv, uint8_t* dst, bool stream) {
+  y = _mm_sub_epi16(y, _mm_set1_epi16(16));
+  uv = _mm_sub_epi16(uv, _mm_set1_epi16(128));
+
+  // Separate the chroma samples, then duplicate each for its two pixels.
+  __m128i u = _mm_srai_epi32(_mm_slli_epi32(uv, 16), 16);
+  __m128i v = _mm_srai_epi32(uv, 16);
+  u = _mm_packs_epi32(u, u);
+  v = _mm_packs_epi32(v, v);
+  u = _mm_unpacklo_epi16(u, u);
+  v = _mm_unpacklo_epi16(v, v);
+
+  // Multiply and add pairs of terms, with the rounding term paired with a
+  // constant one.
+  const __m128i yu_lo = _mm_unpacklo_epi16(y, u);
+  const __m128i yu_hi = _mm_unpackhi_epi16(y, u);
+  const __m128i yv_lo = _mm_unpacklo_epi16(y, v);
+  const __m128i yv_hi = _mm_unpackhi_epi16(y, v);
+  const __m128i v1_lo = _mm_unpacklo_epi16(v, _mm_set1_epi16(1));
+  const __m128i v1_hi = _mm_unpackhi_epi16(v, _mm_set1_epi16(1));
+  const __m128i round = _mm_set1_epi32(128);
+  const __m128i kb = _mm_setr_epi16(298, 516, 298, 516, 298, 516, 298, 516);
+  const __m128i kg0 =
+      _mm_setr_epi16(298, -100, 298, -100, 298, -100, 298, -100);
+  const __m128i kg1 =
+      _mm_setr_epi16(-208, 128, -208, 128, -208, 128, -208, 128);
+  const __m128i kr = _mm_setr_epi16(298, 409, 298, 409, 298, 409, 298, 409);
+
+  const __m128i b = _mm_packs_epi32(
+      _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yu_lo, kb), round), 8),
+      _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yu_hi, kb), round), 8));
+  const __m128i g = _mm_packs_epi32(
+      _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yu_lo, kg0),
+                                   _mm_madd_epi16(v1_lo, kg1)),
+                     8),
+      _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yu_hi, kg0),
+                                   _mm_madd_epi16(v1_hi, kg1)),
+                     8));
+  const __m128i r = _mm_packs_epi32(
+      _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yv_lo, kr), round), 8),
+      _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yv_hi, kr), round), 8));
+
+  // Saturate to bytes and interleave.
+  const __m128i bg = _mm_unpacklo_epi8(_mm_packus_epi16(b, b),
+                                       _mm_packus_epi16(g, g));
+  const __m128i ra = _mm_unpacklo_epi8(_mm_packus_epi16(r, r),
+                                       _mm_set1_epi8(-1));
+  Store16(dst, _mm_unpacklo_epi16(bg, ra), stream);
+  Store16(dst + 16, _mm_unpackhi_epi16(bg, ra), stream);
+}
+
+uint32_t Nv12ToBgraVector(const uint8_t* y, const uint8_t* uv, uint8_t* dst,
+                          uint32_t width, bool stream) {
+  const __m128i zero = _mm_setzero_si128();
+  uint32_t x = 0u;
+  for (; x + 8u <= width; x += 8u) {
+    YuvToBgra8(
+        _mm_unpacklo_epi8(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + x)), zero),
+        _mm_unpacklo_epi8(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(uv + x)), zero),
+        dst + 4u * x, stream);
+  }
+  return x;
+}
+
+uint32_t Yuy2ToBgraVector(const uint8_t* src, uint8_t* dst, uint32_t width,
+                          bool stream) {
+  uint32_t x = 0u;
+  for (; x + 8u <= width; x += 8u) {
+    const __m128i pixels =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2u * x));
+    YuvToBgra8(_mm_and_si128(pixels, _mm_set1_epi16(0xff)),
+               _mm_srli_epi16(pixels, 8), dst + 4u * x, stream);
+  }
+  return x;
+}
+
+// Splits 8 BGRA pixels into 16-bit blue, green and red values.
+void SplitBgra8(const uint8_t* src, __m128i* b, __m128i* g, __m128i* r) {
+  const __m128i mask = _mm_set1_epi32(0xff);
+  const __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+  const __m128i p1 =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+  *b = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+  *g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask),
+                       _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+  *r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask),
+                       _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+}
+
+// Computes the luma of 8 pixels.  The sum of the terms fits 16 unsigned
+// bits, so the wrapping 16-bit arithmetic is exact.
+__m128i BgraToY8(__m128i b, __m128i g, __m128i r) {
+  __m128i y = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)),
+                            _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+  y = _mm_add_epi16(y, _mm_mullo_epi16(b, _mm_set1_epi16(25)));
+  y = _mm_srli_epi16(_mm_add_epi16(y, _mm_set1_epi16(128)), 8);
+  y = _mm_add_epi16(y, _mm_set1_epi16(16));
+  return _mm_packus_epi16(y, y);
+}
+
+// Averages the 2x2 blocks of two rows of 8 16-bit values, giving 4 values,
+// repeated to fill the vector.
+__m128i Average2x2(__m128i row0, __m128i row1) {
+  __m128i sum = _mm_madd_epi16(_mm_add_epi16(row0, row1), _mm_set1_epi16(1));
+  sum = _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(2)), 2);
+  return _mm_packs_epi32(sum, sum);
+}
+
+uint32_t BgraToNv12Vector(const uint8_t* src0, const uint8_t* src1,
+                          uint8_t* y0, uint8_t* y1, uint8_t* uv,
+                          uint32_t width) {
+  uint32_t x = 0u;
+  for (; x + 8u <= width; x += 8u) {
+    __m128i b0, g0, r0, b1, g1, r1;
+    SplitBgra8(src0 + 4u * x, &b0, &g0, &r0);
+    SplitBgra8(src1 + 4u * x, &b1, &g1, &r1);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(y0 + x),
+                     BgraToY8(b0, g0, r0));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(y1 + x),
+                     BgraToY8(b1, g1, r1));
+
+    // The chroma terms of averaged colors fit 16 signed bits.
+    const __m128i b = Average2x2(b0, b1);
+    const __m128i g = Average2x2(g0, g1);
+    const __m128i r = Average2x2(r0, r1);
+    const __m128i round = _mm_set1_epi16(128);
+    __m128i u = _mm_sub_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(112)),
+                              _mm_mullo_epi16(g, _mm_set1_epi16(74)));
+    u = _mm_sub_epi16(u, _mm_mullo_epi16(r, _mm_set1_epi16(38)));
+    u = _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(u, round), 8), round);
+    __m128i v = _mm_sub_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(112)),
+                              _mm_mullo_epi16(g, _mm_set1_epi16(94)));
+    v = _mm_sub_epi16(v, _mm_mullo_epi16(b, _mm_set1_epi16(18)));
+    v = _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(v, round), 8), round);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(uv + x),
+                     _mm_or_si128(u, _mm_slli_epi16(v, 8)));
+  }
+  return x;
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+// NEON has no non-temporal store intrinsics, so destinations are always
+// written through the cache.
+bool CanStream(StoreMode store_mode, const void* dst) { return false; }
+void Fence() {}
+size_t StreamRow(const uint8_t* src, uint8_t* dst, size_t size) { return 0u; }
+
+// Converts 8 pixels from 16-bit Y values and interleaved 16-bit U and V
+// values, one pair for every two pixels.
+void YuvToBgra8(uint16x8_t y16, uint16x8_t uv16, uint8_t* dst) {
+  const int16x8_t y =
+      vsubq_s16(vreinterpretq_s16_u16(y16), vdupq_n_s16(16));
+  const int16x8_t c =
+      vsubq_s16(vreinterpretq_s16_u16(uv16), vdupq_n_s16(128));
+
+  // Separate the chroma samples, then duplicate each for its two pixels.
+  const int16x8x2_t split = vuzpq_s16(c, c);
+  const int16x8_t u = vzipq_s16(split.val[0], split.val[0]).val[0];
+  const int16x8_t v = vzipq_s16(split.val[1], split.val[1]).val[0];
+
+  const int16x4_t y_lo = vget_low_s16(y), y_hi = vget_high_s16(y);
+  const int16x4_t u_lo = vget_low_s16(u), u_hi = vget_high_s16(u);
+  const int16x4_t v_lo = vget_low_s16(v), v_hi = vget_high_s16(v);
+  const int32x4_t c_lo = vmull_n_s16(y_lo, 298);
+  const int32x4_t c_hi = vmull_n_s16(y_hi, 298);
+
+  // Rounding narrowing shifts add the rounding term.
+  const int16x8_t b =
+      vcombine_s16(vrshrn_n_s32(vmlal_n_s16(c_lo, u_lo, 516), 8),
+                   vrshrn_n_s32(vmlal_n_s16(c_hi, u_hi, 516), 8));
+  const int16x8_t g = vcombine_s16(
+      vrshrn_n_s32(vmlal_n_s16(vmlal_n_s16(c_lo, u_lo, -100), v_lo, -208), 8),
+      vrshrn_n_s32(vmlal_n_s16(vmlal_n_s16(c_hi, u_hi, -100), v_hi, -208),
+                   8));
+  const int16x8_t r =
+      vcombine_s16(vrshrn_n_s32(vmlal_n_s16(c_lo, v_lo, 409), 8),
+                   vrshrn_n_s32(vmlal_n_s16(c_hi, v_hi, 409), 8));
+
+  uint8x8x4_t pixels;
+  pixels.val[0] = vqmovun_s16(b);
+  pixels.val[1] = vqmovun_s16(g);
+  pixels.val[2] = vqmovun_s16(r);
+  pixels.val[3] = vdup_n_u8(0xff);
+  vst4_u8(dst, pixels);
+}
+
+uint32_t Nv12ToBgraVector(const uint8_t* y, const uint8_t* uv, uint8_t* dst,
+                          uint32_t width, bool stream) {
+  uint32_t x = 0u;
+  for (; x + 8u <= width; x += 8u) {
+    YuvToBgra8(vmovl_u8(vld1_u8(y + x)), vmovl_u8(vld1_u8(uv + x)),
+               dst + 4u * x);
+  }
+  return x;
+}
+
+uint32_t Yuy2ToBgraVector(const uint8_t* src, uint8_t* dst, uint32_t width,
+                          bool stream) {
+  uint32_t x = 0u;
+  for (; x + 8u <= width; x += 8u) {
+    const uint16x8_t pixels = vreinterpretq_u16_u8(vld1q_u8(src + 2u * x));
+    YuvToBgra8(vandq_u16(pixels, vdupq_n_u16(0xff)), vshrq_n_u16(pixels, 8),
+               dst + 4u * x);
+  }
+  return x;
+}
+
+uint8x8_t BgraToY8(const uint8x8x4_t& pixels) {
+  uint16x8_t y = vmull_u8(pixels.val[2], vdup_n_u8(66));
+  y = vmlal_u8(y, pixels.val[1], vdup_n_u8(129));
+  y = vmlal_u8(y, pixels.val[0], vdup_n_u8(25));
+  return vadd_u8(vrshrn_n_u16(y, 8), vdup_n_u8(16));
+}
+
+// Averages the 2x2 blocks of two rows of 8 values, giving 4 values.
+int16x4_t Average2x2(uint8x8_t row0, uint8x8_t row1) {
+  return vreinterpret_s16_u16(
+      vrshrn_n_u32(vpaddlq_u16(vaddl_u8(row0, row1)), 2));
+}
+
+uint32_t BgraToNv12Vector(const uint8_t* src0, const uint8_t* src1,
+                          uint8_t* y0, uint8_t* y1, uint8_t* uv,
+                          uint32_t width) {
+  uint32_t x = 0u;
+  for (; x + 8u <= width; x += 8u) {
+    const uint8x8x4_t p0 = vld4_u8(src0 + 4u * x);
+    const uint8x8x4_t p1 = vld4_u8(src1 + 4u * x);
+    vst1_u8(y0 + x, BgraToY8(p0));
+    vst1_u8(y1 + x, BgraToY8(p1));
+
+    // The chroma terms of averaged colors fit 16 signed bits.
+    const int16x4_t b = Average2x2(p0.val[0], p1.val[0]);
+    const int16x4_t g = Average2x2(p0.val[1], p1.val[1]);
+    const int16x4_t r = Average2x2(p0.val[2], p1.val[2]);
+    int16x4_t u = vmul_n_s16(b, 112);
+    u = vmls_n_s16(u, g, 74);
+    u = vmls_n_s16(u, r, 38);
+    u = vadd_s16(vrshr_n_s16(u, 8), vdup_n_s16(128));
+    int16x4_t v = vmul_n_s16(r, 112);
+    v = vmls_n_s16(v, g, 94);
+    v = vmls_n_s16(v, b, 18);
+    v = vadd_s16(vrshr_n_s16(v, 8), vdup_n_s16(128));
+    const uint16x4_t pairs = vorr_u16(
+        vreinterpret_u16_s16(u), vshl_n_u16(vreinterpret_u16_s16(v), 8));
+    vst1_u8(uv + x, vreinterpret_u8_u16(pairs));
+  }
+  return x;
+}
+
+#else
+
+bool CanStream(StoreMode store_mode, const void* dst) { return false; }
+void Fence() {}
+size_t StreamRow(const uint8_t* src, uint8_t* dst, size_t size) { return 0u; }
+
+uint32_t Nv12ToBgraVector(const uint8_t* y, const uint8_t* uv, uint8_t* dst,
+                          uint32_t width, bool stream) {
+  return 0u;
+}
+
+uint32_t Yuy2ToBgraVector(const uint8_t* src, uint8_t* dst, uint32_t width,
+                          bool stream) {
+  return 0u;
+}
+
+uint32_t BgraToNv12Vector(const uint8_t* src0, const uint8_t* src1,
+                          uint8_t* y0, uint8_t* y1, uint8_t* uv,
+                          uint32_t width) {
+  return 0u;
+}
+
+#endif
+
+void Nv12RowToBgra(const uint8_t* y, const uint8_t* uv, uint8_t* dst,
+                   uint32_t width, bool stream) {
+  for (uint32_t x = Nv12ToBgraVector(y, uv, dst, width, stream); x < width;
+       x += 2u) {
+    YuvToBgra(y[x], uv[x], uv[x + 1u], dst + 4u * x);
+    YuvToBgra(y[x + 1u], uv[x], uv[x + 1u], dst + 4u * x + 4u);
+  }
+}
+
+void Yuy2RowToBgra(const uint8_t* src, uint8_t* dst, uint32_t width,
+                   bool stream) {
+  for (uint32_t x = Yuy2ToBgraVector(src, dst, width, stream); x < width;
+       x += 2u) {
+    const uint8_t* pair = src + 2u * x;
+    YuvToBgra(pair[0], pair[1], pair[3], dst + 4u * x);
+    YuvToBgra(pair[2], pair[1], pair[3], dst + 4u * x + 4u);
+  }
+}
+
+void BgraRowsToNv12(const uint8_t* src0, const uint8_t* src1, uint8_t* y0,
+                    uint8_t* y1, uint8_t* uv, uint32_t width) {
+  for (uint32_t x = BgraToNv12Vector(src0, src1, y0, y1, uv, width);
+       x < width; x += 2u) {
+    y0[x] = BgraToY(src0 + 4u * x);
+    y0[x + 1u] = BgraToY(src0 + 4u * x + 4u);
+    y1[x] = BgraToY(src1 + 4u * x);
+    y1[x + 1u] = BgraToY(src1 + 4u * x + 4u);
+    BgraToUv(src0 + 4u * x, src1 + 4u * x, uv + x);
+  }
+}
+
+// Returns true if the chroma of |format| is subsampled horizontally, so that
+// images must have even widths.
+bool HasPairedColumns(const PixelFormat& format) {
+  return format != PixelFormat::BGRA_8;
+}
+
+// Returns true if the chroma of |format| is subsampled vertically, so that
+// images must have even heights and be converted in pairs of rows.
+bool HasPairedRows(const PixelFormat& format) {
+  return format == PixelFormat::NV12 || format == PixelFormat::YV12;
+}
+
+bool IsValid(const ImageInfo& info) {
+  if (info.tiling != fuchsia::images::Tiling::LINEAR)
+    return false;
+  if (info.stride < info.width * StrideBytesPerWidthPixel(info.pixel_format))
+    return false;
+  if (HasPairedColumns(info.pixel_format) && info.width % 2u != 0u)
+    return false;
+  if (HasPairedRows(info.pixel_format) && info.height % 2u != 0u)
+    return false;
+  return true;
+}
+
+void CopyPlane(const uint8_t* src, size_t src_stride, uint8_t* dst,
+               size_t dst_stride, size_t row_bytes, uint32_t first_row,
+               uint32_t row_count, StoreMode store_mode) {
+  src += src_stride * first_row;
+  dst += dst_stride * first_row;
+  for (uint32_t row = 0u; row < row_count; row++) {
+    const size_t streamed =
+        CanStream(store_mode, dst) ? StreamRow(src, dst, row_bytes) : 0u;
+    memcpy(dst + streamed, src + streamed, row_bytes - streamed);
+    src += src_stride;
+    dst += dst_stride;
+  }
+}
+
+void CopyRows(const ImageInfo& src_info, const uint8_t* src,
+              const ImageInfo& dst_info, uint8_t* dst, uint32_t first_row,
+              uint32_t row_count, StoreMode store_mode) {
+  const size_t row_bytes =
+      src_info.width * StrideBytesPerWidthPixel(src_info.pixel_format);
+  CopyPlane(src, src_info.stride, dst, dst_info.stride, row_bytes, first_row,
+            row_count, store_mode);
+
+  const uint8_t* src_chroma = src + src_info.stride * src_info.height;
+  uint8_t* dst_chroma = dst + dst_info.stride * dst_info.height;
+  switch (src_info.pixel_format) {
+    case PixelFormat::BGRA_8:
+    case PixelFormat::YUY2:
+      break;
+    case PixelFormat::NV12:
+      // Interleaved U and V, a row for every two rows of the image.
+      CopyPlane(src_chroma, src_info.stride, dst_chroma, dst_info.stride,
+                row_bytes, first_row / 2u, row_count / 2u, store_mode);
+      break;
+    case PixelFormat::YV12: {
+      // A V plane, then a U plane, at half the stride and a row for every two
+      // rows of the image.
+      const size_t src_stride = src_info.stride / 2u;
+      const size_t dst_stride = dst_info.stride / 2u;
+      const size_t src_plane = src_stride * (src_info.height / 2u);
+      const size_t dst_plane = dst_stride * (dst_info.height / 2u);
+      for (int plane = 0; plane < 2; plane++) {
+        CopyPlane(src_chroma + src_plane * plane, src_stride,
+                  dst_chroma + dst_plane * plane, dst_stride, row_bytes / 2u,
+                  first_row / 2u, row_count / 2u, store_mode);
+      }
+      break;
+    }
+  }
+}
+
+}  // namespace
+
+bool CanConvert(const PixelFormat& src_format, const PixelFormat& dst_format) {
+  if (src_format == dst_format)
+    return true;
+  switch (dst_format) {
+    case PixelFormat::BGRA_8:
+      return src_format == PixelFormat::NV12 ||
+             src_format == PixelFormat::YUY2;
+    case PixelFormat::NV12:
+      return src_format == PixelFormat::BGRA_8;
+    default:
+      return false;
+  }
+}
+
+zx_status_t ConvertImage(const ImageInfo& src_info, const void* src,
+                         const ImageInfo& dst_info, void* dst,
+                         StoreMode store_mode) {
+  return ConvertImageRows(src_info, src, dst_info, dst, 0u, src_info.height,
+                          store_mode);
+}
+
+zx_status_t ConvertImageRows(const ImageInfo& src_info, const void* src,
+                             const ImageInfo& dst_info, void* dst,
+                             uint32_t first_row, uint32_t row_count,
+                             StoreMode store_mode) {
+  if (!CanConvert(src_info.pixel_format, dst_info.pixel_format))
+    return ZX_ERR_NOT_SUPPORTED;
+  if (src_info.width != dst_info.width || src_info.height != dst_info.height ||
+      !IsValid(src_info) || !IsValid(dst_info))
+    return ZX_ERR_INVALID_ARGS;
+  if (first_row > src_info.height || row_count > src_info.height - first_row)
+    return ZX_ERR_INVALID_ARGS;
+  if ((HasPairedRows(src_info.pixel_format) ||
+       HasPairedRows(dst_info.pixel_format)) &&
+      (first_row % 2u != 0u || row_count % 2u != 0u))
+    return ZX_ERR_INVALID_ARGS;
+
+  const uint8_t* src_bytes = static_cast<const uint8_t*>(src);
+  uint8_t* dst_bytes = static_cast<uint8_t*>(dst);
+  if (src_info.pixel_format == dst_info.pixel_format) {
+    CopyRows(src_info, src_bytes, dst_info, dst_bytes, first_row, row_count,
+             store_mode);
+    Fence();
+    return ZX_OK;
+  }
+
+  const uint32_t width = src_info.width;
+  const uint32_t end_row = first_row + row_count;
+  if (src_info.pixel_format == PixelFormat::NV12) {
+    const uint8_t* uv = src_bytes + src_info.stride * src_info.height;
+    for (uint32_t row = first_row; row < end_row; row++) {
+      uint8_t* dst_row = dst_bytes + dst_info.stride * row;
+      Nv12RowToBgra(src_bytes + src_info.stride * row,
+                    uv + src_info.stride * (row / 2u), dst_row, width,
+                    CanStream(store_mode, dst_row));
+    }
+  } else if (src_info.pixel_format == PixelFormat::YUY2) {
+    for (uint32_t row = first_row; row < end_row; row++) {
+      uint8_t* dst_row = dst_bytes + dst_info.stride * row;
+      Yuy2RowToBgra(src_bytes + src_info.stride * row, dst_row, width,
+                    CanStream(store_mode, dst_row));
+    }
+  } else {
+    uint8_t* uv = dst_bytes + dst_info.stride * dst_info.height;
+    for (uint32_t row = first_row; row < end_row; row += 2u) {
+      BgraRowsToNv12(src_bytes + src_info.stride * row,
+                     src_bytes + src_info.stride * (row + 1u),
+                     dst_bytes + dst_info.stride * row,
+                     dst_bytes + dst_info.stride * (row + 1u),
+                     uv + dst_info.stride * (row / 2u), width);
+    }
+  }
+  Fence();
+  return ZX_OK;
+}
+
+}  // namespace images
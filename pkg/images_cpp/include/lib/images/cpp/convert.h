@@ -0,0 +1,63 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_IMAGES_CPP_CONVERT_H_
+#define LIB_IMAGES_CPP_CONVERT_H_
+
+#include <fuchsia/images/cpp/fidl.h>
+#include <zircon/types.h>
+
+#include <stdint.h>
+
+namespace images {
+
+// Returns true if |ConvertImage()| can convert images of |src_format| to
+// |dst_format|.
+//
+// Any format can be copied to itself.  Besides that, NV12 and YUY2 convert to
+// BGRA_8, and BGRA_8 converts to NV12.  YUV data is taken to be BT.601 with
+// limited range, as cameras and video decoders produce it.
+bool CanConvert(const fuchsia::images::PixelFormat& src_format,
+                const fuchsia::images::PixelFormat& dst_format);
+
+// How a conversion writes the destination image.
+enum class StoreMode {
+  // Through the cache, as usual.
+  kCached,
+  // Bypassing the cache where the target supports it, for destinations that
+  // this process does not read back, such as memory shared with the
+  // compositor.  This keeps a large image from evicting the rest of the
+  // process's working set.
+  kNonTemporal,
+};
+
+// Converts the image at |src|, laid out as |src_info| describes, into the
+// image at |dst|, laid out as |dst_info| describes, such as the memory of a
+// |scenic::HostImage| at |image_ptr()|.  Each image may have any stride that
+// fits its width.
+//
+// The conversion uses vector instructions where the target has them.
+//
+// Returns |ZX_ERR_NOT_SUPPORTED| if the formats cannot be converted, and
+// |ZX_ERR_INVALID_ARGS| if the images differ in size, are not linear, have
+// strides too small for their width or, for formats with subsampled chroma,
+// have odd dimensions.
+zx_status_t ConvertImage(const fuchsia::images::ImageInfo& src_info,
+                         const void* src,
+                         const fuchsia::images::ImageInfo& dst_info, void* dst,
+                         StoreMode store_mode = StoreMode::kCached);
+
+// Like |ConvertImage()|, but converts only |row_count| rows, starting at
+// |first_row|, so that the rows of an image can be converted in parts, for
+// example on several threads.  Both must be even for formats whose chroma is
+// subsampled vertically, such as NV12.
+zx_status_t ConvertImageRows(const fuchsia::images::ImageInfo& src_info,
+                             const void* src,
+                             const fuchsia::images::ImageInfo& dst_info,
+                             void* dst, uint32_t first_row, uint32_t row_count,
+                             StoreMode store_mode = StoreMode::kCached);
+
+}  // namespace images
+
+#endif  // LIB_IMAGES_CPP_CONVERT_H_
@@ -0,0 +1,37 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_IMAGES_CPP_PARALLEL_CONVERT_H_
+#define LIB_IMAGES_CPP_PARALLEL_CONVERT_H_
+
+#include <fuchsia/images/cpp/fidl.h>
+#include <lib/fit/thread_pool_executor.h>
+#include <zircon/types.h>
+
+#include "lib/images/cpp/convert.h"
+
+namespace images {
+
+// Converts or copies an image like |ConvertImage()|, on the threads of
+// |executor| as well as the calling thread, for images too large to convert
+// on one thread within a frame, such as 4K video frames.
+//
+// The image is split into bands of rows small enough that a band's source
+// and destination stay in the cache while it is converted, and each thread
+// takes the next band as it finishes one.  By default the destination is
+// written with non-temporal stores, as suits memory shared with the
+// compositor; see |StoreMode|.
+//
+// Blocks until the whole image is converted.  Must not be called from one
+// of the executor's threads.
+zx_status_t ConvertImageParallel(fit::thread_pool_executor* executor,
+                                 const fuchsia::images::ImageInfo& src_info,
+                                 const void* src,
+                                 const fuchsia::images::ImageInfo& dst_info,
+                                 void* dst,
+                                 StoreMode store_mode = StoreMode::kNonTemporal);
+
+}  // namespace images
+
+#endif  // LIB_IMAGES_CPP_PARALLEL_CONVERT_H_
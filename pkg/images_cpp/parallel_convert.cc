@@ -0,0 +1,86 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/images/cpp/parallel_convert.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "lib/images/cpp/images.h"
+
+namespace images {
+namespace {
+
+// The number of bytes of source and destination that a band of rows should
+// span, to stay well within a core's share of the cache.
+constexpr size_t kBandBytes = 256u << 10;
+
+// Returns the number of rows in each band of the conversion.
+uint32_t BandRows(const fuchsia::images::ImageInfo& src_info,
+                  const fuchsia::images::ImageInfo& dst_info) {
+  const size_t row_bytes = std::max<size_t>(
+      ImageSize(src_info) / src_info.height +
+          ImageSize(dst_info) / dst_info.height,
+      1u);
+  // Keep bands to pairs of rows, for formats with subsampled chroma.
+  const size_t rows = std::max<size_t>(kBandBytes / row_bytes, 2u) & ~1u;
+  return static_cast<uint32_t>(std::min<size_t>(rows, src_info.height));
+}
+
+}  // namespace
+
+zx_status_t ConvertImageParallel(fit::thread_pool_executor* executor,
+                                 const fuchsia::images::ImageInfo& src_info,
+                                 const void* src,
+                                 const fuchsia::images::ImageInfo& dst_info,
+                                 void* dst, StoreMode store_mode) {
+  // Converting no rows checks the arguments.
+  zx_status_t status =
+      ConvertImageRows(src_info, src, dst_info, dst, 0u, 0u, store_mode);
+  if (status != ZX_OK || src_info.height == 0u)
+    return status;
+
+  const uint32_t height = src_info.height;
+  const uint32_t band_rows = BandRows(src_info, dst_info);
+  const uint32_t band_count = (height + band_rows - 1u) / band_rows;
+  const size_t helper_count =
+      std::min<size_t>(executor->thread_count(), band_count - 1u);
+  if (helper_count == 0u)
+    return ConvertImage(src_info, src, dst_info, dst, store_mode);
+
+  std::atomic<uint32_t> next_band{0u};
+  auto convert_bands = [&] {
+    for (;;) {
+      const uint32_t band = next_band.fetch_add(1u, std::memory_order_relaxed);
+      if (band >= band_count)
+        return;
+      const uint32_t first_row = band * band_rows;
+      ConvertImageRows(src_info, src, dst_info, dst, first_row,
+                       std::min(band_rows, height - first_row), store_mode);
+    }
+  };
+
+  // The helpers only use this frame's state, which outlives them since this
+  // waits for them all to finish.
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t active_helpers = helper_count;
+  for (size_t i = 0u; i < helper_count; i++) {
+    executor->schedule_task(fit::make_promise([&] {
+      convert_bands();
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--active_helpers == 0u)
+        done.notify_one();
+    }));
+  }
+
+  convert_bands();
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [&] { return active_helpers == 0u; });
+  return ZX_OK;
+}
+
+}  // namespace images
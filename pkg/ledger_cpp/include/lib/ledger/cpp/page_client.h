@@ -0,0 +1,163 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_LEDGER_CPP_PAGE_CLIENT_H_
+#define LIB_LEDGER_CPP_PAGE_CLIENT_H_
+
+#include <fuchsia/ledger/cpp/fidl.h>
+#include <lib/async/dispatcher.h>
+#include <lib/async/task.h>
+#include <lib/fidl/cpp/binding.h>
+#include <lib/fit/function.h>
+#include <lib/zx/time.h>
+#include <zircon/fidl.h>
+#include <zircon/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ledger {
+
+// Reads and writes a |fuchsia::ledger::Page| with fewer round trips.
+//
+// Writes issued within |batch_window()| of each other are sent together in
+// one transaction, between |StartTransaction| and |Commit|, without waiting
+// for the reply to each. A lone write is sent as is. Values too large for a
+// |Put| message are first turned into references with
+// |CreateReferenceFromBuffer| and written with |PutReference|.
+//
+// Reads go through a snapshot of the page that the client keeps, and recent
+// results are cached. The client watches the page, and each |OnChange|
+// evicts the keys it changes from the cache and moves the client to a new
+// snapshot, so the cache holds no values older than the snapshot. Reads of
+// keys with writes still in flight return the value written.
+//
+// The client must be used on the thread of |dispatcher|, which must also be
+// the one that the page is bound to.
+class PageClient : private async_task_t, public fuchsia::ledger::PageWatcher {
+ public:
+  using StatusCallback = fit::function<void(fuchsia::ledger::Status)>;
+  using GetCallback =
+      fit::function<void(fuchsia::ledger::Status, std::vector<uint8_t>)>;
+
+  // The largest value written with |Put| rather than by reference: what
+  // fits in a channel message along with the longest key.
+  static constexpr size_t kMaxInlineValueSize =
+      ZX_CHANNEL_MAX_MSG_BYTES - sizeof(fidl_message_header_t) -
+      2 * sizeof(fidl_vector_t) - 256u;
+
+  PageClient(fuchsia::ledger::PagePtr page, async_dispatcher_t* dispatcher);
+  ~PageClient() override;
+
+  PageClient(const PageClient&) = delete;
+  PageClient& operator=(const PageClient&) = delete;
+
+  // How long a write waits for others to share its transaction. Defaults to
+  // 2 ms.
+  zx::duration batch_window() const { return batch_window_; }
+  void set_batch_window(zx::duration batch_window) {
+    batch_window_ = batch_window;
+  }
+
+  // The most bytes of keys and values the read cache holds. Defaults to
+  // 1 MiB; zero disables the cache.
+  void set_cache_capacity(size_t capacity);
+
+  // Writes or deletes |key|. |callback|, if any, is called with the result
+  // of the transaction the write is part of.
+  void Put(std::vector<uint8_t> key, std::vector<uint8_t> value,
+           StatusCallback callback = nullptr);
+  void Delete(std::vector<uint8_t> key, StatusCallback callback = nullptr);
+
+  // Sends the pending writes now, rather than at the end of the window.
+  void Flush();
+
+  // Reads |key|, calling |callback| with |Status::OK| and its value, or with
+  // |Status::KEY_NOT_FOUND| or another error and no value. Reads answered
+  // from the cache or from pending writes call |callback| before returning.
+  void Get(std::vector<uint8_t> key, GetCallback callback);
+
+ private:
+  struct Write {
+    std::vector<uint8_t> key;
+    bool is_delete = false;
+    std::vector<uint8_t> value;
+    std::unique_ptr<fuchsia::ledger::Reference> reference;
+    StatusCallback callback;
+  };
+
+  struct Batch {
+    std::vector<Write> writes;
+    size_t pending_references = 0u;
+    fuchsia::ledger::Status status = fuchsia::ledger::Status::OK;
+  };
+
+  struct CacheEntry {
+    std::string key;
+    bool found = false;
+    std::vector<uint8_t> value;
+  };
+
+  using SnapshotPtr = std::shared_ptr<fuchsia::ledger::PageSnapshotPtr>;
+
+  static void Handler(async_dispatcher_t* dispatcher, async_task_t* task,
+                      zx_status_t status);
+
+  // |fuchsia::ledger::PageWatcher|
+  void OnChange(fuchsia::ledger::PageChange page_change,
+                fuchsia::ledger::ResultState result_state,
+                OnChangeCallback callback) override;
+
+  void Enqueue(Write write);
+  void CreateReferences(std::shared_ptr<Batch> batch);
+  void SendBatch(std::shared_ptr<Batch> batch);
+  void SendWrite(Write& write, fit::function<void(fuchsia::ledger::Status)>
+                                   callback);
+  void FinishBatch(std::shared_ptr<Batch> batch);
+  const Write* FindWrite(const std::vector<uint8_t>& key) const;
+
+  void ReadFromSnapshot(std::vector<uint8_t> key, GetCallback callback);
+  void CacheResult(std::string key, uint64_t generation, bool found,
+                   const std::vector<uint8_t>& value);
+  void Evict(const std::string& key);
+  void TrimCache();
+  SnapshotPtr NewSnapshot(fidl::InterfaceHandle<fuchsia::ledger::PageWatcher>
+                              watcher = nullptr);
+
+  fuchsia::ledger::PagePtr page_;
+  async_dispatcher_t* const dispatcher_;
+  fidl::Binding<fuchsia::ledger::PageWatcher> watcher_binding_;
+  SnapshotPtr snapshot_;
+
+  zx::duration batch_window_ = zx::msec(2);
+  bool task_posted_ = false;
+  // Writes waiting for the window to end, and the batch being sent. Only
+  // one batch is sent at a time, so that writes apply in order.
+  std::vector<Write> pending_writes_;
+  std::shared_ptr<Batch> sending_batch_;
+
+  size_t cache_capacity_ = 1024u * 1024u;
+  size_t cache_size_ = 0u;
+  // Most recently used first.
+  std::list<CacheEntry> cache_;
+  std::unordered_map<std::string, std::list<CacheEntry>::iterator>
+      cache_index_;
+  // Changes on each eviction, so that reads started before it do not cache
+  // what they read.
+  uint64_t cache_generation_ = 0u;
+
+  // Points back at the client until it is destroyed, so that replies on
+  // snapshots it has let go of do nothing.
+  std::shared_ptr<PageClient*> self_;
+};
+
+}  // namespace ledger
+
+#endif  // LIB_LEDGER_CPP_PAGE_CLIENT_H_
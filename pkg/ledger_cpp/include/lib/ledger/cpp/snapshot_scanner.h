@@ -0,0 +1,93 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_LEDGER_CPP_SNAPSHOT_SCANNER_H_
+#define LIB_LEDGER_CPP_SNAPSHOT_SCANNER_H_
+
+#include <fuchsia/ledger/cpp/fidl.h>
+#include <lib/fit/function.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+namespace ledger {
+
+// Scans a |fuchsia::ledger::PageSnapshot| with its next request always in
+// flight.
+//
+// The snapshot returns its keys and entries in pages, each with a token for
+// the next one. The scanner asks for the next page as soon as a page arrives,
+// before handing that page to the caller, so the snapshot produces each page
+// while the caller handles the one before it.
+//
+// Likewise, |StreamValue()| reads a large value in chunks with
+// |FetchPartial|, keeping several chunks in flight, and hands them to the
+// caller in order as shared VMOs.
+//
+// Destroying the scanner stops its scans; their callbacks are not called
+// afterwards. The scanner must be used on the thread that the snapshot is
+// bound to.
+class SnapshotScanner {
+ public:
+  using DoneCallback = fit::function<void(fuchsia::ledger::Status)>;
+
+  // Scans |snapshot|, which must outlive the scanner.
+  explicit SnapshotScanner(fuchsia::ledger::PageSnapshot* snapshot);
+  ~SnapshotScanner();
+
+  SnapshotScanner(const SnapshotScanner&) = delete;
+  SnapshotScanner& operator=(const SnapshotScanner&) = delete;
+
+  // Calls |on_page| with each page of keys, entries or inlined entries whose
+  // keys are at least |key_start|, in order, then |on_done| with
+  // |Status::OK|, or with the error that stopped the scan.
+  void ScanKeys(
+      std::vector<uint8_t> key_start,
+      fit::function<void(std::vector<std::vector<uint8_t>>)> on_page,
+      DoneCallback on_done);
+  void ScanEntries(std::vector<uint8_t> key_start,
+                   fit::function<void(std::vector<fuchsia::ledger::Entry>)>
+                       on_page,
+                   DoneCallback on_done);
+  void ScanEntriesInline(
+      std::vector<uint8_t> key_start,
+      fit::function<void(std::vector<fuchsia::ledger::InlinedEntry>)> on_page,
+      DoneCallback on_done);
+
+  // Calls |on_chunk| with the value of |key| in chunks of |chunk_size|
+  // bytes, the last one possibly shorter, in order and with their offsets,
+  // then |on_done| with |Status::OK| or the error that stopped the stream.
+  // Values that are not on the device are fetched over the network.
+  //
+  // Up to |chunks_in_flight| chunks are requested at a time.
+  void StreamValue(
+      std::vector<uint8_t> key, uint64_t chunk_size, size_t chunks_in_flight,
+      fit::function<void(uint64_t offset, fuchsia::mem::Buffer chunk)>
+          on_chunk,
+      DoneCallback on_done);
+
+ private:
+  template <typename Item>
+  struct Scan;
+  struct Stream;
+
+  template <typename Item>
+  static void RequestPage(std::shared_ptr<Scan<Item>> scan,
+                          std::unique_ptr<fuchsia::ledger::Token> token);
+  static void RequestChunk(std::shared_ptr<Stream> stream);
+  static void DeliverChunks(const std::shared_ptr<Stream>& stream);
+
+  fuchsia::ledger::PageSnapshot* const snapshot_;
+
+  // Points back at the scanner until it is destroyed, so that replies that
+  // outlive it do nothing.
+  std::shared_ptr<SnapshotScanner*> self_;
+};
+
+}  // namespace ledger
+
+#endif  // LIB_LEDGER_CPP_SNAPSHOT_SCANNER_H_
@@ -0,0 +1,365 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ledger/cpp/page_client.h"
+
+#include <lib/async/time.h>
+#include <lib/zx/vmo.h>
+#include <zircon/assert.h>
+
+#include <utility>
+
+namespace ledger {
+namespace {
+
+using fuchsia::ledger::Status;
+
+fidl::VectorPtr<uint8_t> ToVectorPtr(const std::vector<uint8_t>& bytes) {
+  return fidl::VectorPtr<uint8_t>(bytes);
+}
+
+std::string ToString(const std::vector<uint8_t>& bytes) {
+  return std::string(bytes.begin(), bytes.end());
+}
+
+// Keeps the first error of several operations.
+void RecordStatus(Status* result, Status status) {
+  if (*result == Status::OK)
+    *result = status;
+}
+
+}  // namespace
+
+PageClient::PageClient(fuchsia::ledger::PagePtr page,
+                       async_dispatcher_t* dispatcher)
+    : async_task_t{{ASYNC_STATE_INIT}, &PageClient::Handler, 0, 0},
+      page_(std::move(page)),
+      dispatcher_(dispatcher),
+      watcher_binding_(this),
+      self_(std::make_shared<PageClient*>(this)) {
+  ZX_DEBUG_ASSERT(page_.is_bound());
+  snapshot_ = NewSnapshot(watcher_binding_.NewBinding(dispatcher_));
+}
+
+PageClient::~PageClient() {
+  if (task_posted_)
+    async_cancel_task(dispatcher_, this);
+  *self_ = nullptr;
+}
+
+void PageClient::set_cache_capacity(size_t capacity) {
+  cache_capacity_ = capacity;
+  TrimCache();
+}
+
+// Writes ---------------------------------------------------------------------
+
+void PageClient::Put(std::vector<uint8_t> key, std::vector<uint8_t> value,
+                     StatusCallback callback) {
+  Write write;
+  write.key = std::move(key);
+  write.value = std::move(value);
+  write.callback = std::move(callback);
+  Enqueue(std::move(write));
+}
+
+void PageClient::Delete(std::vector<uint8_t> key, StatusCallback callback) {
+  Write write;
+  write.key = std::move(key);
+  write.is_delete = true;
+  write.callback = std::move(callback);
+  Enqueue(std::move(write));
+}
+
+void PageClient::Enqueue(Write write) {
+  // Reads of the key are answered from the write until it is done, and reads
+  // already in flight must not cache what they find.
+  Evict(ToString(write.key));
+  pending_writes_.push_back(std::move(write));
+  if (task_posted_ || sending_batch_)
+    return;
+  deadline = (zx::time(async_now(dispatcher_)) + batch_window_).get();
+  if (async_post_task(dispatcher_, this) == ZX_OK) {
+    task_posted_ = true;
+  } else {
+    Flush();
+  }
+}
+
+void PageClient::Handler(async_dispatcher_t* dispatcher, async_task_t* task,
+                         zx_status_t status) {
+  auto self = static_cast<PageClient*>(task);
+  self->task_posted_ = false;
+  if (status == ZX_OK)
+    self->Flush();
+}
+
+void PageClient::Flush() {
+  if (task_posted_) {
+    async_cancel_task(dispatcher_, this);
+    task_posted_ = false;
+  }
+  if (sending_batch_ || pending_writes_.empty())
+    return;
+  sending_batch_ = std::make_shared<Batch>();
+  sending_batch_->writes = std::move(pending_writes_);
+  pending_writes_.clear();
+  CreateReferences(sending_batch_);
+}
+
+void PageClient::CreateReferences(std::shared_ptr<Batch> batch) {
+  for (size_t i = 0u; i < batch->writes.size(); ++i) {
+    const Write& write = batch->writes[i];
+    if (write.is_delete || write.value.size() <= kMaxInlineValueSize)
+      continue;
+
+    fuchsia::mem::Buffer buffer;
+    buffer.size = write.value.size();
+    if (zx::vmo::create(buffer.size, 0u, &buffer.vmo) != ZX_OK ||
+        buffer.vmo.write(write.value.data(), 0u, buffer.size) != ZX_OK) {
+      RecordStatus(&batch->status, Status::IO_ERROR);
+      continue;
+    }
+    ++batch->pending_references;
+    page_->CreateReferenceFromBuffer(
+        std::move(buffer),
+        [this, batch, i](Status status,
+                         std::unique_ptr<fuchsia::ledger::Reference> reference) {
+          if (status == Status::OK) {
+            batch->writes[i].reference = std::move(reference);
+          } else {
+            RecordStatus(&batch->status, status);
+          }
+          if (--batch->pending_references == 0u)
+            SendBatch(batch);
+        });
+  }
+  if (batch->pending_references == 0u)
+    SendBatch(std::move(batch));
+}
+
+void PageClient::SendBatch(std::shared_ptr<Batch> batch) {
+  if (batch->status != Status::OK) {
+    FinishBatch(std::move(batch));
+    return;
+  }
+  if (batch->writes.size() == 1u) {
+    SendWrite(batch->writes[0], [this, batch](Status status) {
+      RecordStatus(&batch->status, status);
+      FinishBatch(batch);
+    });
+    return;
+  }
+
+  // The writes are pipelined behind |StartTransaction| rather than each
+  // waiting for the one before it, so the batch costs one round trip.
+  auto record = [batch](Status status) {
+    RecordStatus(&batch->status, status);
+  };
+  page_->StartTransaction(record);
+  for (Write& write : batch->writes)
+    SendWrite(write, record);
+  page_->Commit([this, batch](Status status) {
+    RecordStatus(&batch->status, status);
+    FinishBatch(batch);
+  });
+}
+
+void PageClient::SendWrite(Write& write,
+                           fit::function<void(Status)> callback) {
+  if (write.is_delete) {
+    page_->Delete(ToVectorPtr(write.key), std::move(callback));
+  } else if (write.reference) {
+    page_->PutReference(ToVectorPtr(write.key), std::move(*write.reference),
+                        fuchsia::ledger::Priority::EAGER,
+                        std::move(callback));
+  } else {
+    page_->Put(ToVectorPtr(write.key), ToVectorPtr(write.value),
+               std::move(callback));
+  }
+}
+
+void PageClient::FinishBatch(std::shared_ptr<Batch> batch) {
+  ZX_DEBUG_ASSERT(batch == sending_batch_);
+  sending_batch_ = nullptr;
+  if (batch->status == Status::OK) {
+    // The snapshot predates the batch, so reads move to one that does not.
+    snapshot_ = NewSnapshot();
+  }
+  for (Write& write : batch->writes) {
+    Evict(ToString(write.key));
+    if (write.callback)
+      write.callback(batch->status);
+  }
+  // The writes issued meanwhile have waited long enough.
+  if (!pending_writes_.empty())
+    Flush();
+}
+
+const PageClient::Write* PageClient::FindWrite(
+    const std::vector<uint8_t>& key) const {
+  for (auto it = pending_writes_.rbegin(); it != pending_writes_.rend(); ++it) {
+    if (it->key == key)
+      return &*it;
+  }
+  if (sending_batch_) {
+    const auto& writes = sending_batch_->writes;
+    for (auto it = writes.rbegin(); it != writes.rend(); ++it) {
+      if (it->key == key)
+        return &*it;
+    }
+  }
+  return nullptr;
+}
+
+// Reads ----------------------------------------------------------------------
+
+void PageClient::Get(std::vector<uint8_t> key, GetCallback callback) {
+  if (const Write* write = FindWrite(key)) {
+    if (write->is_delete) {
+      callback(Status::KEY_NOT_FOUND, {});
+    } else {
+      callback(Status::OK, write->value);
+    }
+    return;
+  }
+
+  auto it = cache_index_.find(ToString(key));
+  if (it != cache_index_.end()) {
+    cache_.splice(cache_.begin(), cache_, it->second);
+    const CacheEntry& entry = *it->second;
+    if (entry.found) {
+      callback(Status::OK, entry.value);
+    } else {
+      callback(Status::KEY_NOT_FOUND, {});
+    }
+    return;
+  }
+
+  ReadFromSnapshot(std::move(key), std::move(callback));
+}
+
+void PageClient::ReadFromSnapshot(std::vector<uint8_t> key,
+                                  GetCallback callback) {
+  // The snapshot is captured so that replacing |snapshot_| does not drop the
+  // pending reply.
+  SnapshotPtr snapshot = snapshot_;
+  const uint64_t generation = cache_generation_;
+  (*snapshot)->GetInline(
+      ToVectorPtr(key),
+      [self = self_, snapshot, generation, key = std::move(key),
+       callback = std::move(callback)](
+          Status status,
+          std::unique_ptr<fuchsia::ledger::InlinedValue> value) mutable {
+        if (!*self)
+          return;
+        if (status == Status::VALUE_TOO_LARGE) {
+          (*snapshot)->Get(
+              ToVectorPtr(key),
+              [self, snapshot, generation, key = std::move(key),
+               callback = std::move(callback)](
+                  Status status,
+                  std::unique_ptr<fuchsia::mem::Buffer> buffer) mutable {
+                if (!*self)
+                  return;
+                std::vector<uint8_t> bytes;
+                if (status == Status::OK && buffer) {
+                  bytes.resize(buffer->size);
+                  if (buffer->vmo.read(bytes.data(), 0u, bytes.size()) !=
+                      ZX_OK) {
+                    callback(Status::IO_ERROR, {});
+                    return;
+                  }
+                }
+                if (status == Status::OK || status == Status::KEY_NOT_FOUND) {
+                  (*self)->CacheResult(ToString(key), generation,
+                                       status == Status::OK, bytes);
+                }
+                callback(status, std::move(bytes));
+              });
+          return;
+        }
+
+        std::vector<uint8_t> bytes;
+        if (status == Status::OK && value)
+          bytes = value->value.take();
+        if (status == Status::OK || status == Status::KEY_NOT_FOUND) {
+          (*self)->CacheResult(ToString(key), generation,
+                               status == Status::OK, bytes);
+        }
+        callback(status, std::move(bytes));
+      });
+}
+
+void PageClient::OnChange(fuchsia::ledger::PageChange page_change,
+                          fuchsia::ledger::ResultState result_state,
+                          OnChangeCallback callback) {
+  if (page_change.changed_entries) {
+    for (const auto& entry : *page_change.changed_entries)
+      Evict(ToString(*entry.key));
+  }
+  if (page_change.deleted_keys) {
+    for (const auto& key : *page_change.deleted_keys)
+      Evict(ToString(*key));
+  }
+
+  // A change may arrive in several parts; move to a new snapshot once the
+  // last has been seen.
+  if (result_state != fuchsia::ledger::ResultState::COMPLETED &&
+      result_state != fuchsia::ledger::ResultState::PARTIAL_COMPLETED) {
+    callback(nullptr);
+    return;
+  }
+  snapshot_ = std::make_shared<fuchsia::ledger::PageSnapshotPtr>();
+  callback(snapshot_->NewRequest(dispatcher_));
+}
+
+PageClient::SnapshotPtr PageClient::NewSnapshot(
+    fidl::InterfaceHandle<fuchsia::ledger::PageWatcher> watcher) {
+  auto snapshot = std::make_shared<fuchsia::ledger::PageSnapshotPtr>();
+  page_->GetSnapshot(snapshot->NewRequest(dispatcher_),
+                     fidl::VectorPtr<uint8_t>::New(0u), std::move(watcher),
+                     [](Status status) {});
+  return snapshot;
+}
+
+// Cache ----------------------------------------------------------------------
+
+void PageClient::CacheResult(std::string key, uint64_t generation, bool found,
+                             const std::vector<uint8_t>& value) {
+  if (generation != cache_generation_ ||
+      key.size() + value.size() > cache_capacity_)
+    return;
+  auto it = cache_index_.find(key);
+  if (it != cache_index_.end()) {
+    cache_size_ -= it->second->key.size() + it->second->value.size();
+    cache_.erase(it->second);
+    cache_index_.erase(it);
+  }
+  cache_size_ += key.size() + value.size();
+  cache_.push_front(CacheEntry{key, found, value});
+  cache_index_.emplace(std::move(key), cache_.begin());
+  TrimCache();
+}
+
+void PageClient::Evict(const std::string& key) {
+  ++cache_generation_;
+  auto it = cache_index_.find(key);
+  if (it == cache_index_.end())
+    return;
+  cache_size_ -= it->second->key.size() + it->second->value.size();
+  cache_.erase(it->second);
+  cache_index_.erase(it);
+}
+
+void PageClient::TrimCache() {
+  while (cache_size_ > cache_capacity_) {
+    const CacheEntry& entry = cache_.back();
+    cache_size_ -= entry.key.size() + entry.value.size();
+    cache_index_.erase(entry.key);
+    cache_.pop_back();
+  }
+}
+
+}  // namespace ledger
@@ -0,0 +1,245 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ledger/cpp/snapshot_scanner.h"
+
+#include <zircon/assert.h>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <utility>
+
+namespace ledger {
+namespace {
+
+using fuchsia::ledger::Status;
+using fuchsia::ledger::Token;
+
+fidl::VectorPtr<uint8_t> ToVectorPtr(const std::vector<uint8_t>& bytes) {
+  return fidl::VectorPtr<uint8_t>(bytes);
+}
+
+template <typename T>
+std::vector<T> Take(fidl::VectorPtr<T> items) {
+  return items ? items.take() : std::vector<T>();
+}
+
+}  // namespace
+
+template <typename Item>
+struct SnapshotScanner::Scan {
+  using PageCallback =
+      fit::function<void(Status, std::vector<Item>, std::unique_ptr<Token>)>;
+
+  std::shared_ptr<SnapshotScanner*> self;
+  // Requests the page that |token| continues from, or the first page.
+  fit::function<void(std::unique_ptr<Token>, PageCallback)> request;
+  fit::function<void(std::vector<Item>)> on_page;
+  DoneCallback on_done;
+};
+
+struct SnapshotScanner::Stream {
+  std::shared_ptr<SnapshotScanner*> self;
+  fuchsia::ledger::PageSnapshot* snapshot = nullptr;
+  std::vector<uint8_t> key;
+  uint64_t chunk_size = 0u;
+  size_t chunks_in_flight = 0u;
+  fit::function<void(uint64_t, fuchsia::mem::Buffer)> on_chunk;
+  DoneCallback on_done;
+
+  size_t pending = 0u;
+  uint64_t next_request_offset = 0u;
+  uint64_t next_delivery_offset = 0u;
+  // The size of the value, once a short chunk has shown where it ends.
+  uint64_t end = std::numeric_limits<uint64_t>::max();
+  bool done = false;
+  // Chunks that arrived before the ones ahead of them.
+  std::map<uint64_t, fuchsia::mem::Buffer> ready;
+};
+
+SnapshotScanner::SnapshotScanner(fuchsia::ledger::PageSnapshot* snapshot)
+    : snapshot_(snapshot), self_(std::make_shared<SnapshotScanner*>(this)) {
+  ZX_DEBUG_ASSERT(snapshot_);
+}
+
+SnapshotScanner::~SnapshotScanner() { *self_ = nullptr; }
+
+// Pages ----------------------------------------------------------------------
+
+template <typename Item>
+void SnapshotScanner::RequestPage(std::shared_ptr<Scan<Item>> scan,
+                                  std::unique_ptr<Token> token) {
+  Scan<Item>* raw_scan = scan.get();
+  raw_scan->request(
+      std::move(token),
+      [scan = std::move(scan)](Status status, std::vector<Item> items,
+                               std::unique_ptr<Token> next_token) {
+        if (!*scan->self)
+          return;
+        if (status != Status::OK && status != Status::PARTIAL_RESULT) {
+          scan->on_done(status);
+          return;
+        }
+        // Ask for the next page before handling this one, so that the
+        // snapshot produces it meanwhile.
+        const bool more = status == Status::PARTIAL_RESULT && next_token;
+        if (more)
+          RequestPage(scan, std::move(next_token));
+        scan->on_page(std::move(items));
+        if (!more && *scan->self)
+          scan->on_done(Status::OK);
+      });
+}
+
+void SnapshotScanner::ScanKeys(
+    std::vector<uint8_t> key_start,
+    fit::function<void(std::vector<std::vector<uint8_t>>)> on_page,
+    DoneCallback on_done) {
+  using Item = std::vector<uint8_t>;
+  auto scan = std::make_shared<Scan<Item>>();
+  scan->self = self_;
+  scan->request = [snapshot = snapshot_, key_start = std::move(key_start)](
+                      std::unique_ptr<Token> token,
+                      Scan<Item>::PageCallback callback) {
+    snapshot->GetKeys(
+        ToVectorPtr(key_start), std::move(token),
+        [callback = std::move(callback)](
+            Status status, fidl::VectorPtr<fidl::VectorPtr<uint8_t>> keys,
+            std::unique_ptr<Token> next_token) {
+          std::vector<Item> items;
+          if (keys) {
+            items.reserve(keys->size());
+            for (auto& key : *keys)
+              items.push_back(key.take());
+          }
+          callback(status, std::move(items), std::move(next_token));
+        });
+  };
+  scan->on_page = std::move(on_page);
+  scan->on_done = std::move(on_done);
+  RequestPage(std::move(scan), nullptr);
+}
+
+void SnapshotScanner::ScanEntries(
+    std::vector<uint8_t> key_start,
+    fit::function<void(std::vector<fuchsia::ledger::Entry>)> on_page,
+    DoneCallback on_done) {
+  using Item = fuchsia::ledger::Entry;
+  auto scan = std::make_shared<Scan<Item>>();
+  scan->self = self_;
+  scan->request = [snapshot = snapshot_, key_start = std::move(key_start)](
+                      std::unique_ptr<Token> token,
+                      Scan<Item>::PageCallback callback) {
+    snapshot->GetEntries(
+        ToVectorPtr(key_start), std::move(token),
+        [callback = std::move(callback)](Status status,
+                                         fidl::VectorPtr<Item> entries,
+                                         std::unique_ptr<Token> next_token) {
+          callback(status, Take(std::move(entries)), std::move(next_token));
+        });
+  };
+  scan->on_page = std::move(on_page);
+  scan->on_done = std::move(on_done);
+  RequestPage(std::move(scan), nullptr);
+}
+
+void SnapshotScanner::ScanEntriesInline(
+    std::vector<uint8_t> key_start,
+    fit::function<void(std::vector<fuchsia::ledger::InlinedEntry>)> on_page,
+    DoneCallback on_done) {
+  using Item = fuchsia::ledger::InlinedEntry;
+  auto scan = std::make_shared<Scan<Item>>();
+  scan->self = self_;
+  scan->request = [snapshot = snapshot_, key_start = std::move(key_start)](
+                      std::unique_ptr<Token> token,
+                      Scan<Item>::PageCallback callback) {
+    snapshot->GetEntriesInline(
+        ToVectorPtr(key_start), std::move(token),
+        [callback = std::move(callback)](Status status,
+                                         fidl::VectorPtr<Item> entries,
+                                         std::unique_ptr<Token> next_token) {
+          callback(status, Take(std::move(entries)), std::move(next_token));
+        });
+  };
+  scan->on_page = std::move(on_page);
+  scan->on_done = std::move(on_done);
+  RequestPage(std::move(scan), nullptr);
+}
+
+// Values ---------------------------------------------------------------------
+
+void SnapshotScanner::StreamValue(
+    std::vector<uint8_t> key, uint64_t chunk_size, size_t chunks_in_flight,
+    fit::function<void(uint64_t offset, fuchsia::mem::Buffer chunk)> on_chunk,
+    DoneCallback on_done) {
+  ZX_DEBUG_ASSERT(chunk_size > 0u);
+  ZX_DEBUG_ASSERT(chunk_size <=
+                  static_cast<uint64_t>(std::numeric_limits<int64_t>::max()));
+  auto stream = std::make_shared<Stream>();
+  stream->self = self_;
+  stream->snapshot = snapshot_;
+  stream->key = std::move(key);
+  stream->chunk_size = chunk_size;
+  stream->chunks_in_flight = std::max<size_t>(chunks_in_flight, 1u);
+  stream->on_chunk = std::move(on_chunk);
+  stream->on_done = std::move(on_done);
+  for (size_t i = 0u; i < stream->chunks_in_flight; ++i)
+    RequestChunk(stream);
+}
+
+void SnapshotScanner::RequestChunk(std::shared_ptr<Stream> stream) {
+  const uint64_t offset = stream->next_request_offset;
+  stream->next_request_offset += stream->chunk_size;
+  ++stream->pending;
+  Stream* raw_stream = stream.get();
+  raw_stream->snapshot->FetchPartial(
+      ToVectorPtr(raw_stream->key), static_cast<int64_t>(offset),
+      static_cast<int64_t>(raw_stream->chunk_size),
+      [stream = std::move(stream), offset](
+          Status status, std::unique_ptr<fuchsia::mem::Buffer> buffer) {
+        --stream->pending;
+        if (!*stream->self || stream->done)
+          return;
+        if (status != Status::OK) {
+          stream->done = true;
+          stream->on_done(status);
+          return;
+        }
+
+        const uint64_t size = buffer ? buffer->size : 0u;
+        if (size < stream->chunk_size)
+          stream->end = std::min(stream->end, offset + size);
+        if (size > 0u && offset < stream->end)
+          stream->ready.emplace(offset, std::move(*buffer));
+        DeliverChunks(stream);
+        if (!*stream->self || stream->done)
+          return;
+
+        // Keep the pipeline full until the end of the value is known.
+        while (stream->next_request_offset < stream->end &&
+               stream->pending < stream->chunks_in_flight)
+          RequestChunk(stream);
+      });
+}
+
+void SnapshotScanner::DeliverChunks(const std::shared_ptr<Stream>& stream) {
+  while (!stream->ready.empty() &&
+         stream->ready.begin()->first == stream->next_delivery_offset) {
+    auto it = stream->ready.begin();
+    const uint64_t offset = it->first;
+    fuchsia::mem::Buffer chunk = std::move(it->second);
+    stream->ready.erase(it);
+    stream->next_delivery_offset += stream->chunk_size;
+    stream->on_chunk(offset, std::move(chunk));
+    if (!*stream->self)
+      return;
+  }
+  if (stream->next_delivery_offset >= stream->end) {
+    stream->done = true;
+    stream->on_done(Status::OK);
+  }
+}
+
+}  // namespace ledger
@@ -0,0 +1,134 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_LOGGER_CPP_LOG_LISTENER_H_
+#define LIB_LOGGER_CPP_LOG_LISTENER_H_
+
+#include <fuchsia/logger/cpp/fidl.h>
+#include <lib/async/dispatcher.h>
+#include <lib/async/wait.h>
+#include <lib/fidl/cpp/string_view.h>
+#include <lib/fidl/cpp/vector_view.h>
+#include <lib/fit/function.h>
+#include <lib/zx/channel.h>
+#include <zircon/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace logger {
+
+// A |fuchsia::logger::LogMessage| as laid out in the message that carried
+// it. Its tags and text point into that message rather than being copied
+// out of it.
+struct LogMessageView {
+  uint64_t pid;
+  uint64_t tid;
+  zx_time_t time;
+  int32_t severity;
+  uint32_t dropped_logs;
+  fidl::VectorView<fidl::StringView> tags;
+  fidl::StringView msg;
+};
+
+// Which messages the log service sends a listener.
+struct LogFilter {
+  // Only messages of this process or thread, unless |ZX_KOID_INVALID|.
+  zx_koid_t pid = ZX_KOID_INVALID;
+  zx_koid_t tid = ZX_KOID_INVALID;
+
+  // Only messages at least this severe.
+  fuchsia::logger::LogLevelFilter min_severity =
+      fuchsia::logger::LogLevelFilter::NONE;
+
+  // If more than zero, only messages at most this verbose, and
+  // |min_severity| is ignored.
+  uint8_t verbosity = 0u;
+
+  // Only messages with one of these tags, unless empty. At most
+  // |fuchsia::logger::MAX_TAGS| tags of at most
+  // |fuchsia::logger::MAX_TAG_LEN_BYTES| bytes.
+  std::vector<std::string> tags;
+};
+
+// Turns |filter| into the options the log service takes.
+//
+// Returns |ZX_ERR_INVALID_ARGS| if its tags exceed the limits that would
+// otherwise make the service drop the listener.
+zx_status_t MakeLogFilterOptions(const LogFilter& filter,
+                                 fuchsia::logger::LogFilterOptions* options);
+
+// Receives messages from a |fuchsia::logger::Log| service.
+//
+// The service filters the messages, with the options made from a
+// |LogFilter|, so those the client would drop are never sent. The listener
+// serves the |fuchsia::logger::LogListener| channel itself rather than
+// through a binding: it decodes each message in place, into views of the
+// message's own bytes, so tags and text are only copied if the handler
+// copies them. Each time the channel becomes readable the listener reads as
+// many messages as it holds, along with the batches the service sends with
+// |LogMany|, and hands them to the handler in one call.
+//
+// The listener must be used on the thread of |dispatcher|. Its handlers may
+// not destroy it.
+class LogListener : private async_wait_t {
+ public:
+  // Called with each batch of messages, in the order they arrived. The
+  // messages are valid only during the call.
+  using BatchHandler =
+      fit::function<void(const LogMessageView* messages, size_t count)>;
+
+  LogListener(async_dispatcher_t* dispatcher, BatchHandler handler);
+  ~LogListener();
+
+  LogListener(const LogListener&) = delete;
+  LogListener& operator=(const LogListener&) = delete;
+
+  // Called with the error that ends the listener, such as
+  // |ZX_ERR_PEER_CLOSED| once the service closes the channel.
+  void set_error_handler(fit::function<void(zx_status_t)> error_handler) {
+    error_handler_ = std::move(error_handler);
+  }
+
+  // Listens to the messages that |log| receives from now on. Only one of
+  // |Listen()| and |Dump()| may be called, once.
+  zx_status_t Listen(fuchsia::logger::Log* log, const LogFilter& filter);
+
+  // Receives the messages that |log| holds, in batches, then calls
+  // |on_done|.
+  zx_status_t Dump(fuchsia::logger::Log* log, const LogFilter& filter,
+                   fit::closure on_done);
+
+ private:
+  static void CallHandler(async_dispatcher_t* dispatcher, async_wait_t* wait,
+                          zx_status_t status,
+                          const zx_packet_signal_t* signal);
+  zx_status_t Bind(
+      fidl::InterfaceHandle<fuchsia::logger::LogListener>* client);
+  void OnReadable(zx_status_t status);
+  zx_status_t ReadMessage(size_t* offset, bool* done);
+  void Deliver();
+  void Fail(zx_status_t status);
+
+  async_dispatcher_t* const dispatcher_;
+  BatchHandler handler_;
+  fit::function<void(zx_status_t)> error_handler_;
+  fit::closure on_done_;
+
+  zx::channel channel_;
+  bool waiting_ = false;
+  // Holds the messages of a batch, one after the other, which |batch_|
+  // points into.
+  std::unique_ptr<uint8_t[]> buffer_;
+  std::vector<LogMessageView> batch_;
+};
+
+}  // namespace logger
+
+#endif  // LIB_LOGGER_CPP_LOG_LISTENER_H_
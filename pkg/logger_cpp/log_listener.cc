@@ -0,0 +1,228 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/logger/cpp/log_listener.h"
+
+#include <lib/fidl/coding.h>
+#include <zircon/assert.h>
+#include <zircon/fidl.h>
+
+#include <utility>
+
+extern "C" const fidl_type_t fuchsia_logger_LogListenerLogRequestTable;
+extern "C" const fidl_type_t fuchsia_logger_LogListenerLogManyRequestTable;
+
+namespace logger {
+namespace {
+
+constexpr uint32_t kLogOrdinal = 1u;
+constexpr uint32_t kLogManyOrdinal = 2u;
+constexpr uint32_t kDoneOrdinal = 3u;
+
+// Room for a few of the largest messages, so that a batch spans several
+// messages before it has to be delivered.
+constexpr size_t kMessageCapacity = ZX_CHANNEL_MAX_MSG_BYTES;
+constexpr size_t kBufferSize = 4u * kMessageCapacity;
+
+// The most messages read in one turn of the dispatcher, so that a busy log
+// does not starve the dispatcher's other work.
+constexpr size_t kMaxMessagesPerWakeup = 256u;
+
+static_assert(sizeof(LogMessageView) == 64u,
+              "LogMessageView must match the wire format of LogMessage");
+
+}  // namespace
+
+zx_status_t MakeLogFilterOptions(const LogFilter& filter,
+                                 fuchsia::logger::LogFilterOptions* options) {
+  if (filter.tags.size() > fuchsia::logger::MAX_TAGS)
+    return ZX_ERR_INVALID_ARGS;
+  auto tags = fidl::VectorPtr<fidl::StringPtr>::New(0u);
+  for (const std::string& tag : filter.tags) {
+    if (tag.size() > fuchsia::logger::MAX_TAG_LEN_BYTES)
+      return ZX_ERR_INVALID_ARGS;
+    tags.push_back(fidl::StringPtr(tag));
+  }
+
+  options->filter_by_pid = filter.pid != ZX_KOID_INVALID;
+  options->pid = filter.pid;
+  options->filter_by_tid = filter.tid != ZX_KOID_INVALID;
+  options->tid = filter.tid;
+  options->verbosity = filter.verbosity;
+  options->min_severity = filter.min_severity;
+  options->tags = std::move(tags);
+  return ZX_OK;
+}
+
+LogListener::LogListener(async_dispatcher_t* dispatcher, BatchHandler handler)
+    : async_wait_t{{ASYNC_STATE_INIT}, &LogListener::CallHandler,
+                   ZX_HANDLE_INVALID,
+                   ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED},
+      dispatcher_(dispatcher),
+      handler_(std::move(handler)) {
+  ZX_DEBUG_ASSERT(dispatcher_);
+  ZX_DEBUG_ASSERT(handler_);
+}
+
+LogListener::~LogListener() {
+  if (waiting_)
+    async_cancel_wait(dispatcher_, this);
+}
+
+zx_status_t LogListener::Listen(fuchsia::logger::Log* log,
+                                const LogFilter& filter) {
+  auto options = std::make_unique<fuchsia::logger::LogFilterOptions>();
+  zx_status_t status = MakeLogFilterOptions(filter, options.get());
+  if (status != ZX_OK)
+    return status;
+  fidl::InterfaceHandle<fuchsia::logger::LogListener> client;
+  status = Bind(&client);
+  if (status != ZX_OK)
+    return status;
+  log->Listen(std::move(client), std::move(options));
+  return ZX_OK;
+}
+
+zx_status_t LogListener::Dump(fuchsia::logger::Log* log,
+                              const LogFilter& filter, fit::closure on_done) {
+  auto options = std::make_unique<fuchsia::logger::LogFilterOptions>();
+  zx_status_t status = MakeLogFilterOptions(filter, options.get());
+  if (status != ZX_OK)
+    return status;
+  fidl::InterfaceHandle<fuchsia::logger::LogListener> client;
+  status = Bind(&client);
+  if (status != ZX_OK)
+    return status;
+  on_done_ = std::move(on_done);
+  log->DumpLogs(std::move(client), std::move(options));
+  return ZX_OK;
+}
+
+zx_status_t LogListener::Bind(
+    fidl::InterfaceHandle<fuchsia::logger::LogListener>* client) {
+  ZX_DEBUG_ASSERT(!channel_);
+  zx::channel remote;
+  zx_status_t status = zx::channel::create(0u, &channel_, &remote);
+  if (status != ZX_OK)
+    return status;
+  buffer_.reset(new uint8_t[kBufferSize]);
+  object = channel_.get();
+  status = async_begin_wait(dispatcher_, this);
+  if (status != ZX_OK) {
+    channel_.reset();
+    return status;
+  }
+  waiting_ = true;
+  *client = fidl::InterfaceHandle<fuchsia::logger::LogListener>(
+      std::move(remote));
+  return ZX_OK;
+}
+
+void LogListener::CallHandler(async_dispatcher_t* dispatcher,
+                              async_wait_t* wait, zx_status_t status,
+                              const zx_packet_signal_t* signal) {
+  static_cast<LogListener*>(wait)->OnReadable(status);
+}
+
+void LogListener::OnReadable(zx_status_t status) {
+  waiting_ = false;
+  if (status != ZX_OK) {
+    Fail(status);
+    return;
+  }
+
+  size_t offset = 0u;
+  bool done = false;
+  for (size_t i = 0u; i < kMaxMessagesPerWakeup && !done; ++i) {
+    // Hand over the batch once the buffer has no room for another message,
+    // so that its storage can be reused.
+    if (kBufferSize - offset < kMessageCapacity) {
+      Deliver();
+      offset = 0u;
+    }
+    status = ReadMessage(&offset, &done);
+    if (status == ZX_ERR_SHOULD_WAIT)
+      break;
+    if (status != ZX_OK) {
+      Deliver();
+      Fail(status);
+      return;
+    }
+  }
+  Deliver();
+
+  if (done) {
+    // The service sends nothing after |Done|.
+    channel_.reset();
+    fit::closure on_done = std::move(on_done_);
+    if (on_done)
+      on_done();
+    return;
+  }
+  status = async_begin_wait(dispatcher_, this);
+  if (status != ZX_OK) {
+    Fail(status);
+    return;
+  }
+  waiting_ = true;
+}
+
+zx_status_t LogListener::ReadMessage(size_t* offset, bool* done) {
+  uint8_t* bytes = buffer_.get() + *offset;
+  uint32_t actual_bytes = 0u;
+  uint32_t actual_handles = 0u;
+  zx_status_t status = channel_.read(0u, bytes, kMessageCapacity,
+                                     &actual_bytes, nullptr, 0u,
+                                     &actual_handles);
+  if (status != ZX_OK)
+    return status;
+  if (actual_bytes < sizeof(fidl_message_header_t))
+    return ZX_ERR_INVALID_ARGS;
+
+  const char* error = nullptr;
+  void* payload = bytes + sizeof(fidl_message_header_t);
+  switch (reinterpret_cast<fidl_message_header_t*>(bytes)->ordinal) {
+    case kLogOrdinal:
+      status = fidl_decode(&fuchsia_logger_LogListenerLogRequestTable, bytes,
+                           actual_bytes, nullptr, 0u, &error);
+      if (status != ZX_OK)
+        return status;
+      batch_.push_back(*static_cast<LogMessageView*>(payload));
+      break;
+    case kLogManyOrdinal: {
+      status = fidl_decode(&fuchsia_logger_LogListenerLogManyRequestTable,
+                           bytes, actual_bytes, nullptr, 0u, &error);
+      if (status != ZX_OK)
+        return status;
+      const auto& messages =
+          *static_cast<fidl::VectorView<LogMessageView>*>(payload);
+      batch_.insert(batch_.end(), messages.begin(), messages.end());
+      break;
+    }
+    case kDoneOrdinal:
+      *done = true;
+      break;
+    default:
+      return ZX_ERR_NOT_SUPPORTED;
+  }
+
+  // Keep the next message 8-byte aligned, as decoding requires.
+  *offset += (actual_bytes + FIDL_ALIGNMENT - 1u) & ~(FIDL_ALIGNMENT - 1u);
+  return ZX_OK;
+}
+
+void LogListener::Deliver() {
+  if (batch_.empty())
+    return;
+  handler_(batch_.data(), batch_.size());
+  batch_.clear();
+}
+
+void LogListener::Fail(zx_status_t status) {
+  channel_.reset();
+  if (error_handler_)
+    error_handler_(status);
+}
+
+}  // namespace logger
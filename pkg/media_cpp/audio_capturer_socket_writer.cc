@@ -0,0 +1,195 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/media/cpp/audio_capturer_socket_writer.h"
+
+#include <sys/uio.h>
+#include <zircon/assert.h>
+
+namespace media {
+namespace {
+
+// The most packets gathered into one write.
+constexpr size_t kMaxIovecs = 16u;
+
+}  // namespace
+
+AudioCapturerSocketWriter::AudioCapturerSocketWriter(
+    fuchsia::media::AudioCapturerPtr* capturer, uint32_t frame_size,
+    zx::socket socket, async_dispatcher_t* dispatcher)
+    : async_wait_t{{ASYNC_STATE_INIT},
+                   &AudioCapturerSocketWriter::CallHandler,
+                   ZX_HANDLE_INVALID,
+                   ZX_SOCKET_WRITABLE | ZX_SOCKET_PEER_CLOSED},
+      capturer_(capturer),
+      frame_size_(frame_size),
+      socket_(std::move(socket)),
+      dispatcher_(dispatcher) {
+  ZX_DEBUG_ASSERT(capturer_);
+  ZX_DEBUG_ASSERT(frame_size_ > 0u);
+  ZX_DEBUG_ASSERT(socket_);
+  ZX_DEBUG_ASSERT(dispatcher_);
+  object = socket_.get();
+  capturer_->events().OnPacketProduced =
+      [this](fuchsia::media::StreamPacket packet) {
+        OnPacketProduced(std::move(packet));
+      };
+}
+
+AudioCapturerSocketWriter::~AudioCapturerSocketWriter() {
+  capturer_->events().OnPacketProduced = nullptr;
+  if (wait_pending_)
+    async_cancel_wait(dispatcher_, this);
+  for (auto& packet : queued_)
+    (*capturer_)->ReleasePacket(std::move(packet));
+}
+
+zx_status_t AudioCapturerSocketWriter::Init(size_t size,
+                                            uint32_t frames_per_packet,
+                                            uint32_t payload_buffer_id) {
+  ZX_DEBUG_ASSERT(!payload_.data());
+  const size_t packet_size = size_t{frames_per_packet} * frame_size_;
+  if (packet_size == 0u || size < packet_size)
+    return ZX_ERR_INVALID_ARGS;
+
+  zx_status_t status = zx::mapped_vmo::create(size, ZX_VM_PERM_READ,
+                                              &payload_);
+  if (status != ZX_OK)
+    return status;
+
+  // The capturer writes the payload; the writer only reads it.
+  zx::vmo payload_buffer;
+  status = payload_.vmo().duplicate(ZX_RIGHT_READ | ZX_RIGHT_WRITE |
+                                        ZX_RIGHT_MAP | ZX_RIGHT_TRANSFER |
+                                        ZX_RIGHT_DUPLICATE,
+                                    &payload_buffer);
+  if (status != ZX_OK) {
+    payload_.unmap();
+    return status;
+  }
+
+  payload_buffer_id_ = payload_buffer_id;
+  frames_per_packet_ = frames_per_packet;
+  (*capturer_)->AddPayloadBuffer(payload_buffer_id_,
+                                 std::move(payload_buffer));
+  return ZX_OK;
+}
+
+void AudioCapturerSocketWriter::Start() {
+  ZX_DEBUG_ASSERT(payload_.data());
+  (*capturer_)->StartAsyncCapture(frames_per_packet_);
+}
+
+void AudioCapturerSocketWriter::Stop(fit::closure callback) {
+  if (callback) {
+    (*capturer_)->StopAsyncCapture(std::move(callback));
+  } else {
+    (*capturer_)->StopAsyncCaptureNoReply();
+  }
+}
+
+void AudioCapturerSocketWriter::OnPacketProduced(
+    fuchsia::media::StreamPacket packet) {
+  if (failed_ || packet.payload_buffer_id != payload_buffer_id_ ||
+      packet.payload_offset > payload_.size() ||
+      packet.payload_size > payload_.size() - packet.payload_offset) {
+    (*capturer_)->ReleasePacket(std::move(packet));
+    return;
+  }
+  queued_bytes_ += packet.payload_size;
+  queued_.push_back(std::move(packet));
+  // While waiting for room, the packet joins the write that follows.
+  if (!wait_pending_)
+    Flush();
+}
+
+void AudioCapturerSocketWriter::Flush() {
+  const uint8_t* base = payload_.data();
+  while (!queued_.empty()) {
+    // Gather the queued packets, merging those that follow each other in
+    // the buffer, as the capturer's usually do.
+    iovec iov[kMaxIovecs];
+    size_t iov_count = 0u;
+    size_t offset = written_;
+    for (const auto& packet : queued_) {
+      const uint8_t* data = base + packet.payload_offset + offset;
+      size_t size = packet.payload_size - offset;
+      offset = 0u;
+      if (iov_count > 0u &&
+          static_cast<uint8_t*>(iov[iov_count - 1u].iov_base) +
+                  iov[iov_count - 1u].iov_len ==
+              data) {
+        iov[iov_count - 1u].iov_len += size;
+        continue;
+      }
+      if (iov_count == kMaxIovecs)
+        break;
+      iov[iov_count++] = iovec{const_cast<uint8_t*>(data), size};
+    }
+
+    size_t actual = 0u;
+    zx_status_t status = socket_.writev(0u, iov, iov_count, &actual);
+    if (status == ZX_ERR_SHOULD_WAIT) {
+      actual = 0u;
+    } else if (status != ZX_OK) {
+      Fail(status);
+      return;
+    }
+
+    // Release the packets now wholly in the socket.
+    size_t total = 0u;
+    for (size_t i = 0u; i < iov_count; ++i)
+      total += iov[i].iov_len;
+    queued_bytes_ -= actual;
+    written_ += actual;
+    while (!queued_.empty() && written_ >= queued_.front().payload_size) {
+      written_ -= queued_.front().payload_size;
+      (*capturer_)->ReleasePacket(std::move(queued_.front()));
+      queued_.pop_front();
+    }
+    if (actual < total)
+      break;
+  }
+  if (queued_.empty())
+    return;
+
+  zx_status_t status = async_begin_wait(dispatcher_, this);
+  if (status != ZX_OK) {
+    Fail(status);
+    return;
+  }
+  wait_pending_ = true;
+}
+
+void AudioCapturerSocketWriter::CallHandler(async_dispatcher_t* dispatcher,
+                                            async_wait_t* wait,
+                                            zx_status_t status,
+                                            const zx_packet_signal_t* signal) {
+  auto self = static_cast<AudioCapturerSocketWriter*>(wait);
+  self->wait_pending_ = false;
+  if (status != ZX_OK) {
+    self->Fail(status);
+    return;
+  }
+  if (signal->observed & ZX_SOCKET_WRITABLE) {
+    self->Flush();
+    return;
+  }
+  self->Fail(ZX_ERR_PEER_CLOSED);
+}
+
+void AudioCapturerSocketWriter::Fail(zx_status_t status) {
+  if (failed_)
+    return;
+  failed_ = true;
+  for (auto& packet : queued_)
+    (*capturer_)->ReleasePacket(std::move(packet));
+  queued_.clear();
+  written_ = 0u;
+  queued_bytes_ = 0u;
+  if (error_handler_)
+    error_handler_(status);
+}
+
+}  // namespace media
@@ -0,0 +1,150 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/media/cpp/audio_capturer_stream.h"
+
+#include <zircon/assert.h>
+
+namespace media {
+
+AudioCapturerStream::AudioCapturerStream(
+    fuchsia::media::AudioCapturerPtr* capturer, uint32_t frame_size,
+    async_dispatcher_t* dispatcher)
+    : async_task_t{{ASYNC_STATE_INIT},
+                   &AudioCapturerStream::CallReleaseHandler,
+                   ZX_TIME_INFINITE_PAST, 0},
+      capturer_(capturer),
+      frame_size_(frame_size),
+      dispatcher_(dispatcher) {
+  ZX_DEBUG_ASSERT(capturer_);
+  ZX_DEBUG_ASSERT(frame_size_ > 0u);
+  ZX_DEBUG_ASSERT(dispatcher_);
+  capturer_->events().OnPacketProduced =
+      [this](fuchsia::media::StreamPacket packet) {
+        OnPacketProduced(std::move(packet));
+      };
+}
+
+AudioCapturerStream::~AudioCapturerStream() {
+  capturer_->events().OnPacketProduced = nullptr;
+  if (release_posted_.load(std::memory_order_acquire))
+    async_cancel_task(dispatcher_, this);
+  if (released_)
+    ReleaseQueuedPackets();
+}
+
+zx_status_t AudioCapturerStream::Init(size_t size, uint32_t frames_per_packet,
+                                      uint32_t payload_buffer_id) {
+  ZX_DEBUG_ASSERT(!payload_.data());
+  const size_t packet_size = size_t{frames_per_packet} * frame_size_;
+  if (packet_size == 0u || size < packet_size)
+    return ZX_ERR_INVALID_ARGS;
+
+  zx_status_t status = zx::event::create(0u, &captured_event_);
+  if (status != ZX_OK)
+    return status;
+  status = zx::mapped_vmo::create(size, ZX_VM_PERM_READ, &payload_);
+  if (status != ZX_OK)
+    return status;
+
+  // The capturer writes the payload; the stream only reads it.
+  zx::vmo payload_buffer;
+  status = payload_.vmo().duplicate(ZX_RIGHT_READ | ZX_RIGHT_WRITE |
+                                        ZX_RIGHT_MAP | ZX_RIGHT_TRANSFER |
+                                        ZX_RIGHT_DUPLICATE,
+                                    &payload_buffer);
+  if (status != ZX_OK) {
+    payload_.unmap();
+    return status;
+  }
+
+  // The capturer cannot have more packets outstanding than fit in the
+  // buffer, so neither queue ever fills.
+  const size_t max_packets = payload_.size() / packet_size;
+  captured_ =
+      std::make_unique<SpscQueue<fuchsia::media::StreamPacket>>(max_packets);
+  released_ =
+      std::make_unique<SpscQueue<fuchsia::media::StreamPacket>>(max_packets);
+
+  payload_buffer_id_ = payload_buffer_id;
+  frames_per_packet_ = frames_per_packet;
+  (*capturer_)->AddPayloadBuffer(payload_buffer_id_,
+                                 std::move(payload_buffer));
+  return ZX_OK;
+}
+
+void AudioCapturerStream::Start() {
+  ZX_DEBUG_ASSERT(payload_.data());
+  (*capturer_)->StartAsyncCapture(frames_per_packet_);
+}
+
+void AudioCapturerStream::Stop(fit::closure callback) {
+  if (callback) {
+    (*capturer_)->StopAsyncCapture(std::move(callback));
+  } else {
+    (*capturer_)->StopAsyncCaptureNoReply();
+  }
+}
+
+void AudioCapturerStream::OnPacketProduced(
+    fuchsia::media::StreamPacket packet) {
+  // Hand back packets that the consumer could not read, and, should the
+  // capturer outrun its buffer, packets that do not fit in the queue.
+  if (!captured_ || packet.payload_buffer_id != payload_buffer_id_ ||
+      packet.payload_offset > payload_.size() ||
+      packet.payload_size > payload_.size() - packet.payload_offset ||
+      !captured_->Push(packet)) {
+    (*capturer_)->ReleasePacket(std::move(packet));
+    return;
+  }
+  if (!captured_signaled_.exchange(true, std::memory_order_acq_rel))
+    captured_event_.signal(0u, kCapturedSignal);
+}
+
+bool AudioCapturerStream::Pop(fuchsia::media::StreamPacket* packet) {
+  return captured_->Pop(packet);
+}
+
+zx_status_t AudioCapturerStream::Wait(zx::time deadline) {
+  while (captured_->empty()) {
+    // Clear the signal before the flag, so that a packet captured after the
+    // flag is cleared asserts the signal again.
+    captured_event_.signal(kCapturedSignal, 0u);
+    captured_signaled_.exchange(false, std::memory_order_acq_rel);
+    if (!captured_->empty())
+      break;
+    zx_status_t status =
+        captured_event_.wait_one(kCapturedSignal, deadline, nullptr);
+    if (status != ZX_OK)
+      return status;
+  }
+  return ZX_OK;
+}
+
+void AudioCapturerStream::Release(const fuchsia::media::StreamPacket& packet) {
+  const bool pushed = released_->Push(packet);
+  ZX_DEBUG_ASSERT(pushed);
+  if (!release_posted_.exchange(true, std::memory_order_acq_rel))
+    async_post_task(dispatcher_, this);
+}
+
+void AudioCapturerStream::CallReleaseHandler(async_dispatcher_t* dispatcher,
+                                             async_task_t* task,
+                                             zx_status_t status) {
+  if (status != ZX_OK)
+    return;
+  auto self = static_cast<AudioCapturerStream*>(task);
+  // Cleared before draining, so that a packet released while the queue is
+  // drained is either drained now or posts the task again.
+  self->release_posted_.exchange(false, std::memory_order_acq_rel);
+  self->ReleaseQueuedPackets();
+}
+
+void AudioCapturerStream::ReleaseQueuedPackets() {
+  fuchsia::media::StreamPacket packet;
+  while (released_->Pop(&packet))
+    (*capturer_)->ReleasePacket(std::move(packet));
+}
+
+}  // namespace media
@@ -0,0 +1,121 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/media/cpp/audio_renderer_stream.h"
+
+#include <string.h>
+
+#include <zircon/assert.h>
+
+#include <algorithm>
+
+namespace media {
+
+AudioRendererStream::AudioRendererStream(
+    fuchsia::media::AudioRenderer* renderer, uint32_t frame_size)
+    : renderer_(renderer),
+      frame_size_(frame_size),
+      self_(std::make_shared<AudioRendererStream*>(this)) {
+  ZX_DEBUG_ASSERT(renderer_);
+  ZX_DEBUG_ASSERT(frame_size_ > 0u);
+}
+
+AudioRendererStream::~AudioRendererStream() { *self_ = nullptr; }
+
+zx_status_t AudioRendererStream::Init(size_t size,
+                                      uint32_t payload_buffer_id) {
+  ZX_DEBUG_ASSERT(!payload_.data());
+  if (size < frame_size_)
+    return ZX_ERR_INVALID_ARGS;
+
+  zx_status_t status = zx::mapped_vmo::create(
+      size, ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, &payload_);
+  if (status != ZX_OK)
+    return status;
+
+  // The renderer only reads the payload.
+  zx::vmo payload_buffer;
+  status = payload_.vmo().duplicate(
+      ZX_RIGHT_READ | ZX_RIGHT_MAP | ZX_RIGHT_TRANSFER | ZX_RIGHT_DUPLICATE,
+      &payload_buffer);
+  if (status != ZX_OK) {
+    payload_.unmap();
+    return status;
+  }
+
+  payload_buffer_id_ = payload_buffer_id;
+  capacity_ = payload_.size() / frame_size_ * frame_size_;
+  renderer_->AddPayloadBuffer(payload_buffer_id_, std::move(payload_buffer));
+  return ZX_OK;
+}
+
+size_t AudioRendererStream::writable_frames() const {
+  return (capacity_ - (written_ - consumed_)) / frame_size_;
+}
+
+size_t AudioRendererStream::pending_frames() const {
+  return (written_ - consumed_) / frame_size_;
+}
+
+size_t AudioRendererStream::Write(const void* frames, size_t frame_count,
+                                  int64_t pts) {
+  ZX_DEBUG_ASSERT(payload_.data());
+  const size_t written_frames = std::min(frame_count, writable_frames());
+  const auto* source = static_cast<const uint8_t*>(frames);
+  uint64_t remaining = written_frames * frame_size_;
+  const uint64_t max_packet_size =
+      max_frames_per_packet_ ? max_frames_per_packet_ * frame_size_
+                             : capacity_;
+
+  while (remaining > 0u) {
+    // Packets stop at the end of the ring, so that each one is contiguous.
+    const uint64_t offset = written_ % capacity_;
+    const uint64_t size =
+        std::min({remaining, capacity_ - offset, max_packet_size});
+    memcpy(payload_.data() + offset, source, size);
+    source += size;
+    remaining -= size;
+    written_ += size;
+    SendPacket(offset, size, pts, remaining == 0u);
+    pts = fuchsia::media::NO_TIMESTAMP;
+  }
+  return written_frames;
+}
+
+void AudioRendererStream::SendPacket(uint64_t offset, uint64_t size,
+                                     int64_t pts, bool last) {
+  fuchsia::media::StreamPacket packet;
+  packet.pts = pts;
+  packet.payload_buffer_id = payload_buffer_id_;
+  packet.payload_offset = offset;
+  packet.payload_size = size;
+  if (!last) {
+    renderer_->SendPacketNoReply(std::move(packet));
+    return;
+  }
+  renderer_->SendPacket(std::move(packet), [self = self_, end = written_] {
+    if (*self)
+      (*self)->OnConsumed(end);
+  });
+}
+
+void AudioRendererStream::DiscardAll(fit::closure callback) {
+  renderer_->DiscardAllPackets(
+      [self = self_, end = written_, callback = std::move(callback)] {
+        if (*self)
+          (*self)->OnConsumed(end);
+        if (callback)
+          callback();
+      });
+}
+
+void AudioRendererStream::OnConsumed(uint64_t end) {
+  if (end <= consumed_)
+    return;
+  consumed_ = end;
+  if (space_available_callback_)
+    space_available_callback_();
+}
+
+}  // namespace media
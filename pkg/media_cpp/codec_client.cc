@@ -0,0 +1,291 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/media/cpp/codec_client.h"
+
+#include <zircon/assert.h>
+
+#include <algorithm>
+
+namespace media {
+
+CodecClient::CodecClient(fuchsia::mediacodec::CodecPtr codec)
+    : codec_(std::move(codec)),
+      self_(std::make_shared<CodecClient*>(this)) {
+  ZX_DEBUG_ASSERT(codec_.is_bound());
+  codec_.set_error_handler(
+      [this](zx_status_t status) { Fail(ZX_ERR_PEER_CLOSED); });
+  auto& events = codec_.events();
+  events.OnInputConstraints =
+      [this](fuchsia::mediacodec::CodecBufferConstraints constraints) {
+        OnInputConstraints(std::move(constraints));
+      };
+  events.OnFreeInputPacket =
+      [this](fuchsia::mediacodec::CodecPacketHeader header) {
+        OnFreeInputPacket(header);
+      };
+  events.OnOutputConfig = [this](fuchsia::mediacodec::CodecOutputConfig config) {
+    OnOutputConfig(std::move(config));
+  };
+  events.OnOutputPacket = [this](fuchsia::mediacodec::CodecPacket packet,
+                                 bool error_detected_before,
+                                 bool error_detected_during) {
+    OnOutputPacket(std::move(packet), error_detected_before,
+                   error_detected_during);
+  };
+  events.OnOutputEndOfStream = [this](uint64_t stream_lifetime_ordinal,
+                                      bool error_detected_before) {
+    OnOutputEndOfStream(stream_lifetime_ordinal, error_detected_before);
+  };
+  events.OnStreamFailed = [this](uint64_t stream_lifetime_ordinal) {
+    Fail(ZX_ERR_INTERNAL);
+  };
+  codec_->EnableOnStreamFailed();
+}
+
+CodecClient::~CodecClient() { *self_ = nullptr; }
+
+fit::promise<CodecClient::InputPacket, zx_status_t>
+CodecClient::AcquireInputPacket() {
+  fit::bridge<InputPacket, zx_status_t> bridge;
+  input_waiters_.push_back(std::move(bridge.completer()));
+  ServeInputWaiters();
+  return bridge.consumer().promise_or(fit::error(ZX_ERR_CANCELED));
+}
+
+void CodecClient::QueueInputPacket(InputPacket packet) {
+  ZX_DEBUG_ASSERT(packet);
+  ZX_DEBUG_ASSERT(packet.size_ <= packet.capacity());
+  // Packets of buffers that were replaced no longer exist for the codec.
+  if (packet.buffers_ != input_buffers_ || !codec_.is_bound()) {
+    packet.client_ = nullptr;
+    return;
+  }
+  if (stream_ended_) {
+    stream_lifetime_ordinal_ += 2u;
+    stream_ended_ = false;
+  }
+
+  fuchsia::mediacodec::CodecPacket codec_packet;
+  codec_packet.header.buffer_lifetime_ordinal =
+      input_buffers_->lifetime_ordinal;
+  codec_packet.header.packet_index = packet.index_;
+  codec_packet.buffer_index = packet.index_;
+  codec_packet.stream_lifetime_ordinal = stream_lifetime_ordinal_;
+  codec_packet.start_offset = 0u;
+  codec_packet.valid_length_bytes = static_cast<uint32_t>(packet.size_);
+  codec_packet.has_timestamp_ish = packet.has_timestamp_;
+  codec_packet.timestamp_ish = packet.timestamp_;
+  codec_packet.start_access_unit = packet.has_timestamp_;
+  codec_packet.known_end_access_unit = false;
+  packet.client_ = nullptr;
+  codec_->QueueInputPacket(std::move(codec_packet));
+}
+
+void CodecClient::QueueInputEndOfStream() {
+  if (!codec_.is_bound() || stream_ended_)
+    return;
+  codec_->QueueInputEndOfStream(stream_lifetime_ordinal_);
+  stream_ended_ = true;
+}
+
+zx_status_t CodecClient::ConfigureBuffers(
+    const fuchsia::mediacodec::CodecBufferConstraints& constraints,
+    uint32_t packet_count_for_client, uint64_t lifetime_ordinal,
+    zx_vm_option_t map_options,
+    fuchsia::mediacodec::CodecPortBufferSettings* settings,
+    std::vector<fuchsia::mediacodec::CodecBuffer>* codec_buffers,
+    std::shared_ptr<BufferSet>* out) {
+  *settings = constraints.default_settings;
+  settings->buffer_lifetime_ordinal = lifetime_ordinal;
+  settings->buffer_constraints_version_ordinal =
+      constraints.buffer_constraints_version_ordinal;
+  settings->packet_count_for_codec =
+      constraints.packet_count_for_codec_recommended;
+  settings->packet_count_for_client =
+      std::min(std::max(packet_count_for_client,
+                        constraints.packet_count_for_client_min),
+               constraints.packet_count_for_client_max);
+  settings->per_packet_buffer_bytes =
+      constraints.per_packet_buffer_bytes_recommended;
+  settings->single_buffer_mode = false;
+
+  auto buffers = std::make_shared<BufferSet>();
+  buffers->lifetime_ordinal = lifetime_ordinal;
+  buffers->per_packet_bytes = settings->per_packet_buffer_bytes;
+  const uint32_t packet_count =
+      settings->packet_count_for_codec + settings->packet_count_for_client;
+  buffers->buffers.resize(packet_count);
+  codec_buffers->clear();
+  codec_buffers->reserve(packet_count);
+  for (uint32_t i = 0u; i < packet_count; ++i) {
+    zx_status_t status = zx::mapped_vmo::create(
+        buffers->per_packet_bytes, map_options, &buffers->buffers[i]);
+    if (status != ZX_OK)
+      return status;
+
+    fuchsia::mediacodec::CodecBufferDataVmo data;
+    status = buffers->buffers[i].vmo().duplicate(
+        ZX_RIGHT_READ | ZX_RIGHT_WRITE | ZX_RIGHT_MAP | ZX_RIGHT_TRANSFER |
+            ZX_RIGHT_DUPLICATE,
+        &data.vmo_handle);
+    if (status != ZX_OK)
+      return status;
+    data.vmo_usable_start = 0u;
+    data.vmo_usable_size = buffers->per_packet_bytes;
+
+    fuchsia::mediacodec::CodecBuffer codec_buffer;
+    codec_buffer.buffer_lifetime_ordinal = lifetime_ordinal;
+    codec_buffer.buffer_index = i;
+    codec_buffer.data.set_vmo(std::move(data));
+    codec_buffers->push_back(std::move(codec_buffer));
+  }
+  *out = std::move(buffers);
+  return ZX_OK;
+}
+
+void CodecClient::OnInputConstraints(
+    fuchsia::mediacodec::CodecBufferConstraints constraints) {
+  fuchsia::mediacodec::CodecPortBufferSettings settings;
+  std::vector<fuchsia::mediacodec::CodecBuffer> codec_buffers;
+  std::shared_ptr<BufferSet> buffers;
+  zx_status_t status = ConfigureBuffers(
+      constraints, input_packet_count_for_client_,
+      next_input_lifetime_ordinal_, ZX_VM_PERM_READ | ZX_VM_PERM_WRITE,
+      &settings, &codec_buffers, &buffers);
+  if (status != ZX_OK) {
+    Fail(status);
+    return;
+  }
+  next_input_lifetime_ordinal_ += 2u;
+
+  codec_->SetInputBufferSettings(std::move(settings));
+  for (auto& codec_buffer : codec_buffers)
+    codec_->AddInputBuffer(std::move(codec_buffer));
+
+  // Once the last buffer is added, all the packets are free.
+  input_buffers_ = std::move(buffers);
+  free_input_packets_.clear();
+  for (uint32_t i = static_cast<uint32_t>(input_buffers_->buffers.size());
+       i > 0u; --i)
+    free_input_packets_.push_back(i - 1u);
+  ServeInputWaiters();
+}
+
+void CodecClient::OnFreeInputPacket(
+    fuchsia::mediacodec::CodecPacketHeader header) {
+  if (!input_buffers_ ||
+      header.buffer_lifetime_ordinal != input_buffers_->lifetime_ordinal ||
+      header.packet_index >= input_buffers_->buffers.size())
+    return;
+  ReturnInputPacket(header.packet_index);
+}
+
+void CodecClient::OnOutputConfig(fuchsia::mediacodec::CodecOutputConfig config) {
+  // The format applies to the packets that follow, whether or not the
+  // buffers change.
+  if (output_format_handler_)
+    output_format_handler_(config.format_details);
+  if (!config.buffer_constraints_action_required)
+    return;
+
+  fuchsia::mediacodec::CodecPortBufferSettings settings;
+  std::vector<fuchsia::mediacodec::CodecBuffer> codec_buffers;
+  std::shared_ptr<BufferSet> buffers;
+  zx_status_t status = ConfigureBuffers(
+      config.buffer_constraints, output_packet_count_for_client_,
+      next_output_lifetime_ordinal_, ZX_VM_PERM_READ, &settings,
+      &codec_buffers, &buffers);
+  if (status != ZX_OK) {
+    Fail(status);
+    return;
+  }
+  next_output_lifetime_ordinal_ += 2u;
+
+  // Output packets of the old buffers that consumers still hold keep those
+  // buffers alive, and no longer match |output_buffers_|.
+  output_buffers_ = std::move(buffers);
+  codec_->SetOutputBufferSettings(std::move(settings));
+  for (auto& codec_buffer : codec_buffers)
+    codec_->AddOutputBuffer(std::move(codec_buffer));
+}
+
+void CodecClient::OnOutputPacket(fuchsia::mediacodec::CodecPacket packet,
+                                 bool error_detected_before,
+                                 bool error_detected_during) {
+  if (!output_buffers_ || packet.header.buffer_lifetime_ordinal !=
+                              output_buffers_->lifetime_ordinal)
+    return;
+
+  OutputPacket output_packet;
+  output_packet.client_ = self_;
+  output_packet.buffers_ = output_buffers_;
+  output_packet.packet_ = packet;
+  output_packet.error_detected_before_ = error_detected_before;
+  output_packet.error_detected_during_ = error_detected_during;
+  if (packet.buffer_index >= output_buffers_->buffers.size() ||
+      packet.start_offset > output_buffers_->per_packet_bytes ||
+      packet.valid_length_bytes >
+          output_buffers_->per_packet_bytes - packet.start_offset) {
+    // Recycled as it goes out of scope.
+    return;
+  }
+  if (output_packet_handler_)
+    output_packet_handler_(std::move(output_packet));
+}
+
+void CodecClient::OnOutputEndOfStream(uint64_t stream_lifetime_ordinal,
+                                      bool error_detected_before) {
+  if (end_of_stream_handler_)
+    end_of_stream_handler_();
+}
+
+void CodecClient::ReturnInputPacket(uint32_t index) {
+  free_input_packets_.push_back(index);
+  ServeInputWaiters();
+}
+
+void CodecClient::ServeInputWaiters() {
+  while (!input_waiters_.empty() && !free_input_packets_.empty()) {
+    fit::completer<InputPacket, zx_status_t> completer =
+        std::move(input_waiters_.front());
+    input_waiters_.pop_front();
+    if (completer.was_canceled())
+      continue;
+
+    InputPacket packet;
+    packet.client_ = self_;
+    packet.buffers_ = input_buffers_;
+    packet.index_ = free_input_packets_.back();
+    free_input_packets_.pop_back();
+    completer.complete_ok(std::move(packet));
+  }
+}
+
+void CodecClient::Fail(zx_status_t status) {
+  codec_.Unbind();
+  // Abandons the pending promises.
+  input_waiters_.clear();
+  free_input_packets_.clear();
+  input_buffers_ = nullptr;
+  output_buffers_ = nullptr;
+  if (error_handler_)
+    error_handler_(status);
+}
+
+void CodecClient::InputPacket::Reset() {
+  if (client_ && *client_ && (*client_)->input_buffers_ == buffers_)
+    (*client_)->ReturnInputPacket(index_);
+  client_ = nullptr;
+  buffers_ = nullptr;
+}
+
+void CodecClient::OutputPacket::Reset() {
+  if (client_ && *client_ && (*client_)->output_buffers_ == buffers_)
+    (*client_)->codec_->RecycleOutputPacket(packet_.header);
+  client_ = nullptr;
+  buffers_ = nullptr;
+}
+
+}  // namespace media
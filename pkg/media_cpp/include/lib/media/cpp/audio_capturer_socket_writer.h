@@ -0,0 +1,104 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_MEDIA_CPP_AUDIO_CAPTURER_SOCKET_WRITER_H_
+#define LIB_MEDIA_CPP_AUDIO_CAPTURER_SOCKET_WRITER_H_
+
+#include <fuchsia/media/cpp/fidl.h>
+#include <lib/async/dispatcher.h>
+#include <lib/async/wait.h>
+#include <lib/fit/function.h>
+#include <lib/zx/mapped_vmo.h>
+#include <lib/zx/socket.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <utility>
+
+namespace media {
+
+// Streams what an |AudioCapturer| captures to a socket, such as the audio
+// socket of a speech recognizer, without copying it through the app.
+//
+// The writer maps the capturer's payload buffer once and writes each packet
+// the capturer produces straight from the mapping into the socket, gathering
+// the packets queued at once into one |zx::socket::writev()|. A packet is
+// released to the capturer only once all of its frames are in the socket, so
+// a slow reader holds the capturer back rather than the writer buffering
+// without bound: when the socket is full, the writer waits for it to become
+// writable again.
+//
+// The writer must be used on the thread of |dispatcher|, which must also be
+// the one that |capturer| is bound to.
+class AudioCapturerSocketWriter : private async_wait_t {
+ public:
+  // Called once the socket can no longer be written, with
+  // |ZX_ERR_PEER_CLOSED| if its reader went away. The packets queued are
+  // released, and later ones are released as they arrive.
+  using ErrorHandler = fit::function<void(zx_status_t status)>;
+
+  // Captures from |capturer|, which must outlive the writer and be
+  // configured with |SetPcmStreamType| for frames of |frame_size| bytes,
+  // into |socket|, a stream socket. The writer handles the capturer's
+  // |OnPacketProduced| events.
+  AudioCapturerSocketWriter(fuchsia::media::AudioCapturerPtr* capturer,
+                            uint32_t frame_size, zx::socket socket,
+                            async_dispatcher_t* dispatcher);
+  ~AudioCapturerSocketWriter();
+
+  AudioCapturerSocketWriter(const AudioCapturerSocketWriter&) = delete;
+  AudioCapturerSocketWriter& operator=(const AudioCapturerSocketWriter&) =
+      delete;
+
+  void set_error_handler(ErrorHandler error_handler) {
+    error_handler_ = std::move(error_handler);
+  }
+
+  // Creates a payload buffer of at least |size| bytes, maps it, and adds it
+  // to the capturer as |payload_buffer_id|. The capturer will produce packets
+  // of |frames_per_packet| frames. The buffer bounds how far the reader of
+  // the socket may fall behind.
+  zx_status_t Init(size_t size, uint32_t frames_per_packet,
+                   uint32_t payload_buffer_id = 0u);
+
+  // Starts and stops capturing. Packets already captured are still written.
+  void Start();
+  void Stop(fit::closure callback = nullptr);
+
+  // The bytes captured and not yet written to the socket.
+  size_t queued_bytes() const { return queued_bytes_; }
+
+ private:
+  static void CallHandler(async_dispatcher_t* dispatcher, async_wait_t* wait,
+                          zx_status_t status,
+                          const zx_packet_signal_t* signal);
+  void OnPacketProduced(fuchsia::media::StreamPacket packet);
+  void Flush();
+  void Fail(zx_status_t status);
+
+  fuchsia::media::AudioCapturerPtr* const capturer_;
+  const uint32_t frame_size_;
+  zx::socket socket_;
+  async_dispatcher_t* const dispatcher_;
+  ErrorHandler error_handler_;
+  uint32_t payload_buffer_id_ = 0u;
+  uint32_t frames_per_packet_ = 0u;
+
+  zx::mapped_vmo payload_;
+
+  // Packets not yet written in full, oldest first, and the bytes of the
+  // oldest already written.
+  std::deque<fuchsia::media::StreamPacket> queued_;
+  size_t written_ = 0u;
+  size_t queued_bytes_ = 0u;
+
+  bool wait_pending_ = false;
+  bool failed_ = false;
+};
+
+}  // namespace media
+
+#endif  // LIB_MEDIA_CPP_AUDIO_CAPTURER_SOCKET_WRITER_H_
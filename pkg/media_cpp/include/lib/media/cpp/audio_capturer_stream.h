@@ -0,0 +1,118 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_MEDIA_CPP_AUDIO_CAPTURER_STREAM_H_
+#define LIB_MEDIA_CPP_AUDIO_CAPTURER_STREAM_H_
+
+#include <fuchsia/media/cpp/fidl.h>
+#include <lib/async/dispatcher.h>
+#include <lib/async/task.h>
+#include <lib/fit/function.h>
+#include <lib/zx/event.h>
+#include <lib/zx/mapped_vmo.h>
+#include <lib/zx/time.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+
+#include "lib/media/cpp/spsc_queue.h"
+
+namespace media {
+
+// Hands the packets that an |AudioCapturer| produces to a consumer thread
+// without copying them.
+//
+// The stream maps the capturer's payload buffer once. Each packet that the
+// capturer produces is queued, as is, for the consumer thread, which reads the
+// frames in place through |payload()| and hands the packet back with
+// |Release()| once it is done with them. The stream then releases the packet
+// to the capturer on the dispatcher thread. Neither thread blocks the other,
+// and each signals the other only when the other may be idle, so a busy
+// stream costs no system calls besides the capturer's messages.
+//
+// |Init()|, |Start()|, |Stop()| and the destructor must be called on the
+// thread of |dispatcher|, which must also be the one that |capturer| is bound
+// to. |Pop()|, |Wait()| and |Release()| must be called on one consumer thread,
+// which must stop using the stream before it is destroyed.
+//
+// The consumer thread posts the stream's |async_task_t| to the dispatcher to
+// release the packets it hands back.
+class AudioCapturerStream : private async_task_t {
+ public:
+  // Captures from |capturer|, which must outlive the stream and be configured
+  // with |SetPcmStreamType| for frames of |frame_size| bytes. The stream
+  // handles the capturer's |OnPacketProduced| events.
+  AudioCapturerStream(fuchsia::media::AudioCapturerPtr* capturer,
+                      uint32_t frame_size, async_dispatcher_t* dispatcher);
+  ~AudioCapturerStream();
+
+  AudioCapturerStream(const AudioCapturerStream&) = delete;
+  AudioCapturerStream& operator=(const AudioCapturerStream&) = delete;
+
+  // Creates a payload buffer of at least |size| bytes, maps it, and adds it
+  // to the capturer as |payload_buffer_id|. The capturer will produce packets
+  // of |frames_per_packet| frames, and the queues hold as many packets as
+  // fit in the buffer.
+  zx_status_t Init(size_t size, uint32_t frames_per_packet,
+                   uint32_t payload_buffer_id = 0u);
+
+  // Starts and stops capturing.
+  void Start();
+  void Stop(fit::closure callback = nullptr);
+
+  // Consumer thread ----------------------------------------------------------
+
+  // Takes the oldest captured packet, if any. Returns false if none is
+  // queued.
+  bool Pop(fuchsia::media::StreamPacket* packet);
+
+  // Waits until a packet is queued. Returns |ZX_ERR_TIMED_OUT| if |deadline|
+  // passes first.
+  zx_status_t Wait(zx::time deadline);
+
+  // The frames of |packet|, which stay valid until it is released.
+  const uint8_t* payload(const fuchsia::media::StreamPacket& packet) const {
+    return payload_.data() + packet.payload_offset;
+  }
+
+  // Hands |packet| back, so that the capturer may reuse its frames.
+  void Release(const fuchsia::media::StreamPacket& packet);
+
+ private:
+  static void CallReleaseHandler(async_dispatcher_t* dispatcher,
+                                 async_task_t* task, zx_status_t status);
+  void OnPacketProduced(fuchsia::media::StreamPacket packet);
+  void ReleaseQueuedPackets();
+
+  // Asserted on |captured_event_| when |captured_| may have become
+  // non-empty.
+  static constexpr zx_signals_t kCapturedSignal = ZX_USER_SIGNAL_0;
+
+  fuchsia::media::AudioCapturerPtr* const capturer_;
+  const uint32_t frame_size_;
+  async_dispatcher_t* const dispatcher_;
+  uint32_t payload_buffer_id_ = 0u;
+  uint32_t frames_per_packet_ = 0u;
+
+  zx::mapped_vmo payload_;
+
+  // Packets from the dispatcher thread to the consumer thread, and back.
+  std::unique_ptr<SpscQueue<fuchsia::media::StreamPacket>> captured_;
+  std::unique_ptr<SpscQueue<fuchsia::media::StreamPacket>> released_;
+
+  // Set by the producer of each queue after it pushes, and cleared by the
+  // consumer before it drains the queue, so that the producer signals only
+  // the first packet of each batch.
+  std::atomic<bool> captured_signaled_{false};
+  std::atomic<bool> release_posted_{false};
+
+  zx::event captured_event_;
+};
+
+}  // namespace media
+
+#endif  // LIB_MEDIA_CPP_AUDIO_CAPTURER_STREAM_H_
@@ -0,0 +1,103 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_MEDIA_CPP_AUDIO_RENDERER_STREAM_H_
+#define LIB_MEDIA_CPP_AUDIO_RENDERER_STREAM_H_
+
+#include <fuchsia/media/cpp/fidl.h>
+#include <lib/fit/function.h>
+#include <lib/zx/mapped_vmo.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+namespace media {
+
+// Streams PCM frames to an |AudioRenderer| through one payload buffer, which
+// it maps and uses as a ring.
+//
+// Each |Write()| copies frames into the free part of the ring and sends them
+// as packets that never wrap around its end. All but the last packet of a
+// write are sent with |SendPacketNoReply|. The last uses |SendPacket|, and
+// since the renderer consumes packets in order, its reply returns the space
+// of the whole write to the ring. A write thus costs one reply however many
+// packets it takes.
+//
+// The stream must be used on the thread that the renderer's replies are
+// dispatched on.
+class AudioRendererStream {
+ public:
+  // Streams to |renderer|, which must outlive the stream and be configured
+  // with |SetPcmStreamType| for frames of |frame_size| bytes.
+  AudioRendererStream(fuchsia::media::AudioRenderer* renderer,
+                      uint32_t frame_size);
+  ~AudioRendererStream();
+
+  AudioRendererStream(const AudioRendererStream&) = delete;
+  AudioRendererStream& operator=(const AudioRendererStream&) = delete;
+
+  // Creates a payload buffer of at least |size| bytes, maps it, and adds it
+  // to the renderer as |payload_buffer_id|.
+  zx_status_t Init(size_t size, uint32_t payload_buffer_id = 0u);
+
+  // The most frames each packet holds. Smaller packets let the ring recycle
+  // space sooner, at the cost of more messages. Defaults to no limit other
+  // than the ring's size.
+  void set_max_frames_per_packet(size_t max_frames_per_packet) {
+    max_frames_per_packet_ = max_frames_per_packet;
+  }
+
+  // Called when the renderer has consumed frames, freeing up space.
+  void set_space_available_callback(fit::closure callback) {
+    space_available_callback_ = std::move(callback);
+  }
+
+  // Copies up to |frame_count| frames from |frames| into the ring and sends
+  // them, the first with |pts| and the rest continuous with it. Returns the
+  // number of frames written, which is less than |frame_count| when the ring
+  // does not have room for all of them.
+  size_t Write(const void* frames, size_t frame_count,
+               int64_t pts = fuchsia::media::NO_TIMESTAMP);
+
+  // The number of frames that |Write()| can take now.
+  size_t writable_frames() const;
+
+  // The number of frames written but not yet consumed by the renderer.
+  size_t pending_frames() const;
+
+  // Discards the frames that the renderer has not consumed, and returns their
+  // space to the ring once it has. Calls |callback|, if any, then.
+  void DiscardAll(fit::closure callback = nullptr);
+
+ private:
+  void OnConsumed(uint64_t end);
+  void SendPacket(uint64_t offset, uint64_t size, int64_t pts, bool last);
+
+  fuchsia::media::AudioRenderer* const renderer_;
+  const uint32_t frame_size_;
+  uint32_t payload_buffer_id_ = 0u;
+
+  zx::mapped_vmo payload_;
+  // The usable size of |payload_|, a whole number of frames.
+  uint64_t capacity_ = 0u;
+
+  // Byte positions in the stream, which grow without wrapping. The ring
+  // holds the frames from |consumed_| to |written_|. Replies only ever move
+  // |consumed_| forward, so late replies to discarded packets are harmless.
+  uint64_t written_ = 0u;
+  uint64_t consumed_ = 0u;
+
+  size_t max_frames_per_packet_ = 0u;
+  fit::closure space_available_callback_;
+
+  // Points back at the stream until it is destroyed, so that replies that
+  // outlive it do nothing.
+  std::shared_ptr<AudioRendererStream*> self_;
+};
+
+}  // namespace media
+
+#endif  // LIB_MEDIA_CPP_AUDIO_RENDERER_STREAM_H_
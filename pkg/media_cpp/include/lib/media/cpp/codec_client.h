@@ -0,0 +1,267 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_MEDIA_CPP_CODEC_CLIENT_H_
+#define LIB_MEDIA_CPP_CODEC_CLIENT_H_
+
+#include <fuchsia/mediacodec/cpp/fidl.h>
+#include <lib/fit/bridge.h>
+#include <lib/fit/function.h>
+#include <lib/fit/promise.h>
+#include <lib/zx/mapped_vmo.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace media {
+
+// Manages the buffers and packets of a |fuchsia::mediacodec::Codec|.
+//
+// The client configures input buffers when the codec sends its input
+// constraints, and output buffers each time the codec sends an output config
+// that requires action. Each buffer gets its own packet, mapped once.
+//
+// Input: |AcquireInputPacket()| returns a promise for a free input packet,
+// which completes at once while any are free. The caller fills the packet
+// and hands it to |QueueInputPacket()|. Packets that the codec frees go
+// straight to the oldest pending promise, so a caller that keeps acquiring
+// packets keeps every one of them filled ahead of the codec.
+//
+// Output: each output packet is handed to the output packet handler as an
+// |OutputPacket|, which recycles the packet to the codec as soon as it is
+// destroyed. When the output config changes mid-stream, new output buffers
+// are configured at once; packets of the old buffers that consumers still
+// hold keep their buffers mapped until they are destroyed, and are then
+// dropped rather than recycled, so the stream need not drain first.
+//
+// The client and its packets must be used on the thread whose dispatcher
+// the codec is bound to, typically that of an |async::Loop|. The promises
+// may run on any executor on that thread, such as an |async::Executor|.
+class CodecClient {
+ public:
+  class InputPacket;
+  class OutputPacket;
+
+  // Drives |codec|, which must be bound.
+  explicit CodecClient(fuchsia::mediacodec::CodecPtr codec);
+  ~CodecClient();
+
+  CodecClient(const CodecClient&) = delete;
+  CodecClient& operator=(const CodecClient&) = delete;
+
+  // The number of packets of each port that the client may hold at once,
+  // clamped to the codec's constraints. More input packets let the caller
+  // fill packets further ahead of the codec. Takes effect the next time the
+  // port's buffers are configured.
+  void set_input_packet_count_for_client(uint32_t count) {
+    input_packet_count_for_client_ = count;
+  }
+  void set_output_packet_count_for_client(uint32_t count) {
+    output_packet_count_for_client_ = count;
+  }
+
+  // Called with each output packet. Packets that are not handled are
+  // recycled at once.
+  void set_output_packet_handler(fit::function<void(OutputPacket)> handler) {
+    output_packet_handler_ = std::move(handler);
+  }
+
+  // Called with the format of the output packets that follow.
+  void set_output_format_handler(
+      fit::function<void(const fuchsia::mediacodec::CodecFormatDetails&)>
+          handler) {
+    output_format_handler_ = std::move(handler);
+  }
+
+  // Called once the codec has output the end of a stream.
+  void set_end_of_stream_handler(fit::closure handler) {
+    end_of_stream_handler_ = std::move(handler);
+  }
+
+  // Called once the client stops, with |ZX_ERR_PEER_CLOSED| if the codec
+  // closed its channel, |ZX_ERR_INTERNAL| if a stream failed, or the error
+  // from configuring buffers.
+  void set_error_handler(fit::function<void(zx_status_t)> handler) {
+    error_handler_ = std::move(handler);
+  }
+
+  // Returns a promise for a free input packet. The promise fails with
+  // |ZX_ERR_CANCELED| if the client stops or is destroyed first.
+  fit::promise<InputPacket, zx_status_t> AcquireInputPacket();
+
+  // Queues |packet|, filled with |packet.size()| bytes, to the codec. Starts
+  // a new stream if the last one was ended.
+  void QueueInputPacket(InputPacket packet);
+
+  // Ends the current stream.
+  void QueueInputEndOfStream();
+
+  // The number of input packets that are free and not promised to anyone.
+  size_t free_input_packet_count() const { return free_input_packets_.size(); }
+
+ private:
+  // The buffers of one buffer lifetime of one port, indexed by packet.
+  struct BufferSet {
+    uint64_t lifetime_ordinal = 0u;
+    uint32_t per_packet_bytes = 0u;
+    std::vector<zx::mapped_vmo> buffers;
+  };
+
+  zx_status_t ConfigureBuffers(
+      const fuchsia::mediacodec::CodecBufferConstraints& constraints,
+      uint32_t packet_count_for_client, uint64_t lifetime_ordinal,
+      zx_vm_option_t map_options,
+      fuchsia::mediacodec::CodecPortBufferSettings* settings,
+      std::vector<fuchsia::mediacodec::CodecBuffer>* codec_buffers,
+      std::shared_ptr<BufferSet>* out);
+
+  void OnInputConstraints(
+      fuchsia::mediacodec::CodecBufferConstraints constraints);
+  void OnFreeInputPacket(fuchsia::mediacodec::CodecPacketHeader header);
+  void OnOutputConfig(fuchsia::mediacodec::CodecOutputConfig config);
+  void OnOutputPacket(fuchsia::mediacodec::CodecPacket packet,
+                      bool error_detected_before, bool error_detected_during);
+  void OnOutputEndOfStream(uint64_t stream_lifetime_ordinal,
+                           bool error_detected_before);
+
+  void ReturnInputPacket(uint32_t index);
+  void ServeInputWaiters();
+  void Fail(zx_status_t status);
+
+  fuchsia::mediacodec::CodecPtr codec_;
+
+  uint32_t input_packet_count_for_client_ =
+      fuchsia::mediacodec::kDefaultInputPacketCountForClient;
+  uint32_t output_packet_count_for_client_ =
+      fuchsia::mediacodec::kDefaultOutputPacketCountForClient;
+
+  fit::function<void(OutputPacket)> output_packet_handler_;
+  fit::function<void(const fuchsia::mediacodec::CodecFormatDetails&)>
+      output_format_handler_;
+  fit::closure end_of_stream_handler_;
+  fit::function<void(zx_status_t)> error_handler_;
+
+  // Ordinals must be odd and only increase.
+  uint64_t stream_lifetime_ordinal_ = 1u;
+  bool stream_ended_ = false;
+  uint64_t next_input_lifetime_ordinal_ = 1u;
+  uint64_t next_output_lifetime_ordinal_ = 1u;
+
+  std::shared_ptr<BufferSet> input_buffers_;
+  std::shared_ptr<BufferSet> output_buffers_;
+
+  std::vector<uint32_t> free_input_packets_;
+  std::deque<fit::completer<InputPacket, zx_status_t>> input_waiters_;
+
+  // Points back at the client until it is destroyed, so that packets that
+  // outlive it do nothing.
+  std::shared_ptr<CodecClient*> self_;
+};
+
+// A free input packet, which returns to the client when destroyed unless it
+// was queued.
+class CodecClient::InputPacket {
+ public:
+  InputPacket() = default;
+  ~InputPacket() { Reset(); }
+
+  InputPacket(InputPacket&& other) = default;
+  InputPacket& operator=(InputPacket&& other) {
+    if (this != &other) {
+      Reset();
+      client_ = std::move(other.client_);
+      buffers_ = std::move(other.buffers_);
+      index_ = other.index_;
+      size_ = other.size_;
+      has_timestamp_ = other.has_timestamp_;
+      timestamp_ = other.timestamp_;
+    }
+    return *this;
+  }
+
+  explicit operator bool() const { return !!buffers_; }
+
+  // The packet's buffer.
+  uint8_t* data() const { return buffers_->buffers[index_].data(); }
+  size_t capacity() const { return buffers_->per_packet_bytes; }
+
+  // The number of bytes of the buffer that the packet holds.
+  size_t size() const { return size_; }
+  void set_size(size_t size) { size_ = size; }
+
+  // Marks the packet as starting an access unit with |timestamp|.
+  void set_timestamp(uint64_t timestamp) {
+    has_timestamp_ = true;
+    timestamp_ = timestamp;
+  }
+
+ private:
+  friend class CodecClient;
+
+  void Reset();
+
+  std::shared_ptr<CodecClient*> client_;
+  std::shared_ptr<BufferSet> buffers_;
+  uint32_t index_ = 0u;
+  size_t size_ = 0u;
+  bool has_timestamp_ = false;
+  uint64_t timestamp_ = 0u;
+};
+
+// An output packet, which is recycled to the codec when destroyed.
+class CodecClient::OutputPacket {
+ public:
+  OutputPacket() = default;
+  ~OutputPacket() { Reset(); }
+
+  OutputPacket(OutputPacket&& other) = default;
+  OutputPacket& operator=(OutputPacket&& other) {
+    if (this != &other) {
+      Reset();
+      client_ = std::move(other.client_);
+      buffers_ = std::move(other.buffers_);
+      packet_ = other.packet_;
+      error_detected_before_ = other.error_detected_before_;
+      error_detected_during_ = other.error_detected_during_;
+    }
+    return *this;
+  }
+
+  explicit operator bool() const { return !!buffers_; }
+
+  // The bytes that the packet holds.
+  const uint8_t* data() const {
+    return buffers_->buffers[packet_.buffer_index].data() +
+           packet_.start_offset;
+  }
+  size_t size() const { return packet_.valid_length_bytes; }
+
+  // Whether the codec detected errors in the stream before or within this
+  // packet.
+  bool error_detected_before() const { return error_detected_before_; }
+  bool error_detected_during() const { return error_detected_during_; }
+
+  // The packet as the codec sent it, with its timestamp and access unit
+  // flags.
+  const fuchsia::mediacodec::CodecPacket& packet() const { return packet_; }
+
+ private:
+  friend class CodecClient;
+
+  void Reset();
+
+  std::shared_ptr<CodecClient*> client_;
+  std::shared_ptr<BufferSet> buffers_;
+  fuchsia::mediacodec::CodecPacket packet_;
+  bool error_detected_before_ = false;
+  bool error_detected_during_ = false;
+};
+
+}  // namespace media
+
+#endif  // LIB_MEDIA_CPP_CODEC_CLIENT_H_
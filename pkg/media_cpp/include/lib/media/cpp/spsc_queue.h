@@ -0,0 +1,80 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_MEDIA_CPP_SPSC_QUEUE_H_
+#define LIB_MEDIA_CPP_SPSC_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace media {
+
+// A bounded, lock-free queue between one producer thread and one consumer
+// thread.
+//
+// Neither |Push()| nor |Pop()| blocks or makes a system call; callers that
+// need to sleep while the queue is empty or full pair it with a signal of
+// their own.
+template <typename T>
+class SpscQueue {
+ public:
+  // Holds up to |capacity| elements, rounded up to a power of two.
+  explicit SpscQueue(size_t capacity)
+      : mask_(RoundUpToPowerOfTwo(capacity) - 1u),
+        elements_(new T[mask_ + 1u]) {}
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  size_t capacity() const { return mask_ + 1u; }
+
+  // Called by the producer. Returns false if the queue is full.
+  bool Push(T value) {
+    const uint64_t write = write_index_.load(std::memory_order_relaxed);
+    if (write - read_index_.load(std::memory_order_acquire) > mask_)
+      return false;
+    elements_[write & mask_] = std::move(value);
+    write_index_.store(write + 1u, std::memory_order_release);
+    return true;
+  }
+
+  // Called by the consumer. Returns false if the queue is empty.
+  bool Pop(T* out) {
+    const uint64_t read = read_index_.load(std::memory_order_relaxed);
+    if (read == write_index_.load(std::memory_order_acquire))
+      return false;
+    *out = std::move(elements_[read & mask_]);
+    read_index_.store(read + 1u, std::memory_order_release);
+    return true;
+  }
+
+  // Called by the consumer.
+  bool empty() const {
+    return read_index_.load(std::memory_order_relaxed) ==
+           write_index_.load(std::memory_order_acquire);
+  }
+
+ private:
+  static size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 1u;
+    while (result < value)
+      result <<= 1;
+    return result;
+  }
+
+  const size_t mask_;
+  const std::unique_ptr<T[]> elements_;
+
+  // On separate cache lines, so that each side only writes its own.
+  alignas(64) std::atomic<uint64_t> write_index_{0u};
+  alignas(64) std::atomic<uint64_t> read_index_{0u};
+};
+
+}  // namespace media
+
+#endif  // LIB_MEDIA_CPP_SPSC_QUEUE_H_
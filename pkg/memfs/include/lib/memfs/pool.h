@@ -0,0 +1,52 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_MEMFS_INCLUDE_LIB_MEMFS_POOL_H_
+#define LIB_MEMFS_INCLUDE_LIB_MEMFS_POOL_H_
+
+#include <stddef.h>
+
+#include <zircon/compiler.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// A pool of in-memory filesystems, each served on its own thread.
+//
+// A memfs filesystem serves all of its connections on one dispatcher, and
+// its vnodes are not safe to use from several threads, so it cannot be served
+// by a multi-threaded loop.  A pool instead shards files across several
+// filesystems, each with its own loop thread, so that operations on
+// different shards proceed concurrently.  Operations within a shard are
+// still serialized.
+typedef struct memfs_pool memfs_pool_t;
+
+// Creates a pool of |shard_count| filesystems.
+//
+// If |max_num_pages| is not 0, it is split evenly between the shards, each
+// of which is limited to its share.
+zx_status_t memfs_pool_create(size_t shard_count, size_t max_num_pages,
+                              memfs_pool_t** out_pool);
+
+// Returns the number of filesystems in |pool|.
+size_t memfs_pool_shard_count(const memfs_pool_t* pool);
+
+// Opens a new connection to the root directory of the shard at |index|.
+zx_status_t memfs_pool_connect(memfs_pool_t* pool, size_t index,
+                               zx_handle_t* out_root);
+
+// Installs the root of each shard into the local namespace, at
+// "<path>/<index>".
+//
+// Returns |ZX_ERR_ALREADY_EXISTS| if one of these paths already exists in
+// the namespace for this process.
+zx_status_t memfs_pool_install_at(memfs_pool_t* pool, const char* path);
+
+// Frees the filesystems of |pool|, unmounting any sub-filesystems that may
+// exist, then stops their threads and frees |pool|.
+void memfs_pool_free(memfs_pool_t* pool);
+
+__END_CDECLS
+
+#endif // LIB_MEMFS_INCLUDE_LIB_MEMFS_POOL_H_
@@ -0,0 +1,58 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_MEMFS_INCLUDE_LIB_MEMFS_SNAPSHOT_H_
+#define LIB_MEMFS_INCLUDE_LIB_MEMFS_SNAPSHOT_H_
+
+#include <stddef.h>
+
+#include <lib/async/dispatcher.h>
+#include <zircon/compiler.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// A snapshot of a directory tree, for populating many filesystems with the
+// same fixture.
+//
+// Taking a snapshot walks the tree once, listing each directory in bulk with
+// fdio_dirscan, and keeps a copy-on-write clone of the VMO of each file, so
+// that the snapshot costs no copy of the contents and does not change when
+// the tree does afterwards.  Populating a filesystem from it then skips the
+// walk and the reads of the source: each directory is made, and each file is
+// sized once and written straight from the mapping of its clone.
+//
+// A snapshot may be used from several threads at once.
+typedef struct memfs_snapshot memfs_snapshot_t;
+
+// Takes a snapshot of the tree rooted at the directory open as |dirfd|.
+//
+// Only directories and regular files are kept; other entries are skipped.
+zx_status_t memfs_snapshot_create(int dirfd, memfs_snapshot_t** out_snapshot);
+
+// Returns the number of bytes of file contents in |snapshot|.
+size_t memfs_snapshot_size(const memfs_snapshot_t* snapshot);
+
+// Recreates the tree of |snapshot| in the directory open as |dirfd|, which
+// should be empty.
+zx_status_t memfs_snapshot_populate(const memfs_snapshot_t* snapshot,
+                                    int dirfd);
+
+// Creates an in-memory filesystem with at most |max_num_pages| pages, or
+// no limit if it is 0, installs it into the local namespace at |path|, as
+// memfs_install_at_with_page_limit does, and populates it from |snapshot|.
+//
+// |dispatcher| must run on another thread than the caller's, since it
+// serves the filesystem while it is populated.
+zx_status_t memfs_snapshot_install_at(const memfs_snapshot_t* snapshot,
+                                      async_dispatcher_t* dispatcher,
+                                      size_t max_num_pages,
+                                      const char* path);
+
+// Releases the clones that |snapshot| holds and frees it.
+void memfs_snapshot_free(memfs_snapshot_t* snapshot);
+
+__END_CDECLS
+
+#endif // LIB_MEMFS_INCLUDE_LIB_MEMFS_SNAPSHOT_H_
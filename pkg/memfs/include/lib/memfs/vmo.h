@@ -0,0 +1,38 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_MEMFS_INCLUDE_LIB_MEMFS_VMO_H_
+#define LIB_MEMFS_INCLUDE_LIB_MEMFS_VMO_H_
+
+#include <stddef.h>
+
+#include <zircon/compiler.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// Every memfs file is backed by a VMO.  These functions move whole files in
+// and out of memfs through VMOs, rather than through read(), which copies
+// each 8 KiB through a fuchsia.io message, and a series of write() calls,
+// each of which grows the file a little.
+
+// Gets the VMO of the file open as |fd|, and the size of the file in
+// |out_size|.
+//
+// For a memfs file, this is the file's own VMO, without copying, and later
+// writes to the file are visible through it.  Otherwise, it is a
+// copy-on-write clone of the file's VMO, or a copy of its contents.
+zx_status_t memfs_get_file_vmo(int fd, zx_handle_t* out_vmo, size_t* out_size);
+
+// Replaces the contents of the file open as |fd| with the first |size| bytes
+// of |vmo|.  Does not take ownership of |vmo|.
+//
+// The file is sized once before it is written, so memfs grows its VMO once,
+// rather than by a few pages with each write, and the writes only fill pages
+// that are already allocated.
+zx_status_t memfs_write_file_from_vmo(int fd, zx_handle_t vmo, size_t size);
+
+__END_CDECLS
+
+#endif // LIB_MEMFS_INCLUDE_LIB_MEMFS_VMO_H_
@@ -0,0 +1,130 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/memfs/pool.h>
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <lib/async-loop/loop.h>
+#include <lib/fdio/namespace.h>
+#include <lib/fdio/util.h>
+#include <lib/memfs/memfs.h>
+#include <lib/sync/completion.h>
+#include <zircon/syscalls.h>
+
+typedef struct memfs_shard {
+    async_loop_t* loop;
+    memfs_filesystem_t* fs;
+    zx_handle_t root;
+} memfs_shard_t;
+
+struct memfs_pool {
+    size_t shard_count;
+    memfs_shard_t shards[];
+};
+
+static zx_status_t shard_init(memfs_shard_t* shard, size_t index,
+                              size_t max_num_pages) {
+    zx_status_t status =
+        async_loop_create(&kAsyncLoopConfigNoAttachToThread, &shard->loop);
+    if (status != ZX_OK)
+        return status;
+
+    char name[32];
+    snprintf(name, sizeof(name), "memfs-pool-%zu", index);
+    status = async_loop_start_thread(shard->loop, name, NULL);
+    if (status != ZX_OK)
+        return status;
+
+    async_dispatcher_t* dispatcher = async_loop_get_dispatcher(shard->loop);
+    if (max_num_pages > 0u) {
+        return memfs_create_filesystem_with_page_limit(
+            dispatcher, max_num_pages, &shard->fs, &shard->root);
+    }
+    return memfs_create_filesystem(dispatcher, &shard->fs, &shard->root);
+}
+
+static void shard_destroy(memfs_shard_t* shard) {
+    if (shard->fs != NULL) {
+        // Requires that the loop still be running.
+        sync_completion_t unmounted;
+        sync_completion_reset(&unmounted);
+        memfs_free_filesystem(shard->fs, &unmounted);
+        sync_completion_wait(&unmounted, ZX_TIME_INFINITE);
+    }
+    zx_handle_close(shard->root);
+    if (shard->loop != NULL)
+        async_loop_destroy(shard->loop);
+}
+
+zx_status_t memfs_pool_create(size_t shard_count, size_t max_num_pages,
+                              memfs_pool_t** out_pool) {
+    if (shard_count == 0u)
+        return ZX_ERR_INVALID_ARGS;
+    if (max_num_pages > 0u && max_num_pages < shard_count)
+        return ZX_ERR_INVALID_ARGS;
+
+    memfs_pool_t* pool =
+        calloc(1, sizeof(*pool) + shard_count * sizeof(memfs_shard_t));
+    if (pool == NULL)
+        return ZX_ERR_NO_MEMORY;
+    for (size_t i = 0; i < shard_count; ++i) {
+        pool->shards[i].root = ZX_HANDLE_INVALID;
+        zx_status_t status =
+            shard_init(&pool->shards[i], i, max_num_pages / shard_count);
+        pool->shard_count = i + 1u;
+        if (status != ZX_OK) {
+            memfs_pool_free(pool);
+            return status;
+        }
+    }
+    *out_pool = pool;
+    return ZX_OK;
+}
+
+size_t memfs_pool_shard_count(const memfs_pool_t* pool) {
+    return pool->shard_count;
+}
+
+zx_status_t memfs_pool_connect(memfs_pool_t* pool, size_t index,
+                               zx_handle_t* out_root) {
+    if (index >= pool->shard_count)
+        return ZX_ERR_OUT_OF_RANGE;
+    zx_handle_t root = fdio_service_clone(pool->shards[index].root);
+    if (root == ZX_HANDLE_INVALID)
+        return ZX_ERR_BAD_STATE;
+    *out_root = root;
+    return ZX_OK;
+}
+
+zx_status_t memfs_pool_install_at(memfs_pool_t* pool, const char* path) {
+    fdio_ns_t* ns;
+    zx_status_t status = fdio_ns_get_installed(&ns);
+    if (status != ZX_OK)
+        return status;
+    for (size_t i = 0; i < pool->shard_count; ++i) {
+        char shard_path[PATH_MAX];
+        if (snprintf(shard_path, sizeof(shard_path), "%s/%zu", path, i) >=
+            (int)sizeof(shard_path))
+            return ZX_ERR_BAD_PATH;
+        zx_handle_t root;
+        status = memfs_pool_connect(pool, i, &root);
+        if (status != ZX_OK)
+            return status;
+        status = fdio_ns_bind(ns, shard_path, root);
+        if (status != ZX_OK) {
+            zx_handle_close(root);
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
+void memfs_pool_free(memfs_pool_t* pool) {
+    for (size_t i = 0; i < pool->shard_count; ++i)
+        shard_destroy(&pool->shards[i]);
+    free(pool);
+}
@@ -0,0 +1,230 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/memfs/snapshot.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <lib/fdio/dirscan.h>
+#include <lib/memfs/memfs.h>
+#include <lib/memfs/vmo.h>
+#include <zircon/limits.h>
+#include <zircon/syscalls.h>
+
+// An entry of a snapshot, listed before the entries it contains.
+typedef struct entry {
+    // The path of the entry, relative to the root of the snapshot.
+    char* path;
+    bool is_dir;
+    // A copy-on-write clone of the contents of a file, or ZX_HANDLE_INVALID
+    // for a directory or an empty file.
+    zx_handle_t vmo;
+    size_t size;
+} entry_t;
+
+struct memfs_snapshot {
+    entry_t* entries;
+    size_t count;
+    size_t capacity;
+    size_t size;
+};
+
+static zx_status_t status_from_errno(int error) {
+    switch (error) {
+    case ENOENT:
+        return ZX_ERR_NOT_FOUND;
+    case EEXIST:
+        return ZX_ERR_ALREADY_EXISTS;
+    case ENOSPC:
+        return ZX_ERR_NO_SPACE;
+    case ENOMEM:
+        return ZX_ERR_NO_MEMORY;
+    case EACCES:
+    case EPERM:
+        return ZX_ERR_ACCESS_DENIED;
+    default:
+        return ZX_ERR_IO;
+    }
+}
+
+static entry_t* add_entry(memfs_snapshot_t* snapshot, const char* parent,
+                          const char* name) {
+    if (snapshot->count == snapshot->capacity) {
+        size_t capacity = snapshot->capacity ? snapshot->capacity * 2u : 64u;
+        entry_t* entries = realloc(snapshot->entries,
+                                   capacity * sizeof(entry_t));
+        if (entries == NULL)
+            return NULL;
+        snapshot->entries = entries;
+        snapshot->capacity = capacity;
+    }
+    size_t len = (parent ? strlen(parent) + 1u : 0u) + strlen(name) + 1u;
+    char* path = malloc(len);
+    if (path == NULL)
+        return NULL;
+    if (parent) {
+        snprintf(path, len, "%s/%s", parent, name);
+    } else {
+        snprintf(path, len, "%s", name);
+    }
+    entry_t* entry = &snapshot->entries[snapshot->count++];
+    entry->path = path;
+    entry->is_dir = false;
+    entry->vmo = ZX_HANDLE_INVALID;
+    entry->size = 0u;
+    return entry;
+}
+
+static zx_status_t capture_file(int dirfd, const char* name, entry_t* entry) {
+    int fd = openat(dirfd, name, O_RDONLY);
+    if (fd < 0)
+        return status_from_errno(errno);
+    zx_handle_t vmo;
+    size_t size;
+    zx_status_t status = memfs_get_file_vmo(fd, &vmo, &size);
+    close(fd);
+    if (status != ZX_OK)
+        return status;
+    entry->size = size;
+    if (size > 0u) {
+        // A memfs file hands out its own VMO, which later writes change.
+        size_t len = (size + ZX_PAGE_SIZE - 1u) & ~(size_t)ZX_PAGE_MASK;
+        status = zx_vmo_clone(vmo, ZX_VMO_CLONE_COPY_ON_WRITE, 0u, len,
+                              &entry->vmo);
+    }
+    zx_handle_close(vmo);
+    return status;
+}
+
+// Adds the entries of the directory open as |dirfd|, at |path| in the
+// snapshot, and those of its subdirectories.
+static zx_status_t capture_dir(memfs_snapshot_t* snapshot, int dirfd,
+                               const char* path) {
+    fdio_dirscan_t* scanner;
+    zx_status_t status = fdio_dirscan_create(dirfd, &scanner);
+    if (status != ZX_OK)
+        return status;
+
+    for (;;) {
+        const fdio_dirent_attr_t* entries;
+        size_t count;
+        status = fdio_dirscan_next(scanner, &entries, &count);
+        if (status != ZX_OK || count == 0u)
+            break;
+        for (size_t i = 0; i < count && status == ZX_OK; ++i) {
+            const fdio_dirent_attr_t* dirent = &entries[i];
+            if (!strcmp(dirent->name, ".") || !strcmp(dirent->name, ".."))
+                continue;
+            bool is_dir = dirent->type == DT_DIR;
+            if (!is_dir && dirent->type != DT_REG)
+                continue;
+            entry_t* entry = add_entry(snapshot, path, dirent->name);
+            if (entry == NULL) {
+                status = ZX_ERR_NO_MEMORY;
+                break;
+            }
+            if (!is_dir) {
+                status = capture_file(dirfd, dirent->name, entry);
+                snapshot->size += entry->size;
+                continue;
+            }
+            entry->is_dir = true;
+            // The entry may move when the array grows, so its path is
+            // copied before descending.
+            char* child_path = strdup(entry->path);
+            int child_fd = openat(dirfd, dirent->name,
+                                  O_RDONLY | O_DIRECTORY);
+            if (child_path == NULL || child_fd < 0) {
+                status = child_path == NULL ? ZX_ERR_NO_MEMORY
+                                            : status_from_errno(errno);
+            } else {
+                status = capture_dir(snapshot, child_fd, child_path);
+            }
+            if (child_fd >= 0)
+                close(child_fd);
+            free(child_path);
+        }
+        if (status != ZX_OK)
+            break;
+    }
+    fdio_dirscan_destroy(scanner);
+    return status;
+}
+
+zx_status_t memfs_snapshot_create(int dirfd, memfs_snapshot_t** out_snapshot) {
+    memfs_snapshot_t* snapshot = calloc(1, sizeof(*snapshot));
+    if (snapshot == NULL)
+        return ZX_ERR_NO_MEMORY;
+    zx_status_t status = capture_dir(snapshot, dirfd, NULL);
+    if (status != ZX_OK) {
+        memfs_snapshot_free(snapshot);
+        return status;
+    }
+    *out_snapshot = snapshot;
+    return ZX_OK;
+}
+
+size_t memfs_snapshot_size(const memfs_snapshot_t* snapshot) {
+    return snapshot->size;
+}
+
+zx_status_t memfs_snapshot_populate(const memfs_snapshot_t* snapshot,
+                                    int dirfd) {
+    // Parents are listed before their entries, so each directory exists by
+    // the time its entries are made.
+    for (size_t i = 0; i < snapshot->count; ++i) {
+        const entry_t* entry = &snapshot->entries[i];
+        if (entry->is_dir) {
+            if (mkdirat(dirfd, entry->path, 0755) < 0)
+                return status_from_errno(errno);
+            continue;
+        }
+        int fd = openat(dirfd, entry->path, O_WRONLY | O_CREAT | O_TRUNC,
+                        0644);
+        if (fd < 0)
+            return status_from_errno(errno);
+        zx_status_t status = ZX_OK;
+        if (entry->size > 0u)
+            status = memfs_write_file_from_vmo(fd, entry->vmo, entry->size);
+        close(fd);
+        if (status != ZX_OK)
+            return status;
+    }
+    return ZX_OK;
+}
+
+zx_status_t memfs_snapshot_install_at(const memfs_snapshot_t* snapshot,
+                                      async_dispatcher_t* dispatcher,
+                                      size_t max_num_pages,
+                                      const char* path) {
+    zx_status_t status =
+        max_num_pages ? memfs_install_at_with_page_limit(dispatcher,
+                                                         max_num_pages, path)
+                      : memfs_install_at(dispatcher, path);
+    if (status != ZX_OK)
+        return status;
+    int dirfd = open(path, O_RDONLY | O_DIRECTORY);
+    if (dirfd < 0)
+        return status_from_errno(errno);
+    status = memfs_snapshot_populate(snapshot, dirfd);
+    close(dirfd);
+    return status;
+}
+
+void memfs_snapshot_free(memfs_snapshot_t* snapshot) {
+    for (size_t i = 0; i < snapshot->count; ++i) {
+        zx_handle_close(snapshot->entries[i].vmo);
+        free(snapshot->entries[i].path);
+    }
+    free(snapshot->entries);
+    free(snapshot);
+}
@@ -0,0 +1,93 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/memfs/vmo.h>
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <lib/fdio/io.h>
+#include <lib/fdio/limits.h>
+#include <zircon/limits.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+
+static zx_status_t status_from_errno(int error) {
+    switch (error) {
+    case EBADF:
+        return ZX_ERR_BAD_HANDLE;
+    case ENOSPC:
+        return ZX_ERR_NO_SPACE;
+    case ENOMEM:
+        return ZX_ERR_NO_MEMORY;
+    case EINVAL:
+        return ZX_ERR_INVALID_ARGS;
+    case EACCES:
+    case EPERM:
+        return ZX_ERR_ACCESS_DENIED;
+    default:
+        return ZX_ERR_IO;
+    }
+}
+
+zx_status_t memfs_get_file_vmo(int fd, zx_handle_t* out_vmo, size_t* out_size) {
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+        return status_from_errno(errno);
+    if (!S_ISREG(st.st_mode))
+        return ZX_ERR_NOT_FILE;
+
+    // memfs hands out its own VMO for an exact request, and the other
+    // filesystems a clone, or a copy.
+    zx_handle_t vmo;
+    zx_status_t status = fdio_get_vmo_exact(fd, &vmo);
+    if (status != ZX_OK)
+        status = fdio_get_vmo_clone(fd, &vmo);
+    if (status != ZX_OK)
+        status = fdio_get_vmo_copy(fd, &vmo);
+    if (status != ZX_OK)
+        return status;
+    *out_vmo = vmo;
+    *out_size = (size_t)st.st_size;
+    return ZX_OK;
+}
+
+zx_status_t memfs_write_file_from_vmo(int fd, zx_handle_t vmo, size_t size) {
+    // Size the file first: memfs then resizes its VMO once, and each write
+    // below only fills pages that are already there.
+    if (ftruncate(fd, (off_t)size) < 0)
+        return status_from_errno(errno);
+    if (size == 0u)
+        return ZX_OK;
+
+    size_t len = (size + ZX_PAGE_SIZE - 1u) & ~(size_t)ZX_PAGE_MASK;
+    zx_vaddr_t addr;
+    zx_status_t status = zx_vmar_map(zx_vmar_root_self(), ZX_VM_PERM_READ, 0u,
+                                     vmo, 0u, len, &addr);
+    if (status != ZX_OK)
+        return status;
+
+    size_t offset = 0u;
+    while (offset < size) {
+        size_t count = size - offset;
+        if (count > FDIO_CHUNK_SIZE)
+            count = FDIO_CHUNK_SIZE;
+        ssize_t actual = pwrite(fd, (const char*)addr + offset, count,
+                                (off_t)offset);
+        if (actual < 0) {
+            if (errno == EINTR)
+                continue;
+            status = status_from_errno(errno);
+            break;
+        }
+        if (actual == 0) {
+            status = ZX_ERR_IO;
+            break;
+        }
+        offset += (size_t)actual;
+    }
+    zx_vmar_unmap(zx_vmar_root_self(), addr, len);
+    return status;
+}
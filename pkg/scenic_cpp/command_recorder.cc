@@ -0,0 +1,79 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ui/scenic/cpp/command_recorder.h"
+
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "lib/ui/scenic/cpp/commands.h"
+
+namespace scenic {
+
+CommandRecorder::CommandRecorder(Session* session, uint32_t id_block_size)
+    : session_(session), id_block_size_(id_block_size) {
+  ZX_DEBUG_ASSERT(session_);
+  RefillIds();
+}
+
+CommandRecorder::~CommandRecorder() {
+  zx_handle_close_many(handles_.data(), handles_.size());
+  free_ids_.insert(free_ids_.end(), allocated_ids_.begin(),
+                   allocated_ids_.end());
+  session_->ReturnResourceIds(free_ids_);
+}
+
+uint32_t CommandRecorder::AllocResourceId() {
+  ZX_ASSERT_MSG(!free_ids_.empty(),
+                "Recorder allocated more than its block of %u ids",
+                id_block_size_);
+  uint32_t resource_id = free_ids_.back();
+  free_ids_.pop_back();
+  allocated_ids_.push_back(resource_id);
+  return resource_id;
+}
+
+void CommandRecorder::ReleaseResource(uint32_t resource_id) {
+  released_ids_.push_back(resource_id);
+  Enqueue(NewReleaseResourceCmd(resource_id));
+}
+
+void CommandRecorder::Enqueue(fuchsia::ui::gfx::Command command) {
+  Enqueue(NewCommand(std::move(command)));
+}
+
+void CommandRecorder::Enqueue(fuchsia::ui::input::Command command) {
+  Enqueue(NewCommand(std::move(command)));
+}
+
+void CommandRecorder::Enqueue(fuchsia::ui::scenic::Command command) {
+  EncodedCommand recorded;
+  recorded.is_input =
+      command.Which() == fuchsia::ui::scenic::Command::Tag::kInput;
+  // Whether the session coalesces is only known once it is submitted to.
+  recorded.property_key = Session::PropertyKey(command);
+
+  fidl::Message encoded = Session::EncodeCommand(&encoder_, &command);
+  const uint8_t* bytes = encoded.bytes().data();
+  const zx_handle_t* handles = encoded.handles().data();
+  recorded.num_bytes = encoded.bytes().actual();
+  recorded.num_handles = encoded.handles().actual();
+  bytes_.insert(bytes_.end(), bytes, bytes + recorded.num_bytes);
+  handles_.insert(handles_.end(), handles, handles + recorded.num_handles);
+  encoded.ClearHandlesUnsafe();
+  commands_.push_back(recorded);
+}
+
+void CommandRecorder::RefillIds() {
+  allocated_ids_.clear();
+  session_->ReserveResourceIds(id_block_size_, &free_ids_);
+  // Hand out the lowest ids first, which keeps the ids in use dense.
+  std::sort(free_ids_.begin(), free_ids_.end(), std::greater<uint32_t>());
+}
+
+}  // namespace scenic
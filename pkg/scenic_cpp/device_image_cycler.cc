@@ -0,0 +1,77 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ui/scenic/cpp/device_image_cycler.h"
+
+#include <zircon/assert.h>
+
+#include "lib/ui/scenic/cpp/session.h"
+
+namespace scenic {
+
+DeviceImageCycler::DeviceImageCycler(Session* session, uint32_t num_buffers)
+    : EntityNode(session),
+      content_node_(session),
+      content_material_(session),
+      buffers_(num_buffers) {
+  ZX_DEBUG_ASSERT(num_buffers > 0u);
+  content_node_.SetMaterial(content_material_);
+  AddChild(content_node_);
+}
+
+DeviceImageCycler::~DeviceImageCycler() = default;
+
+void DeviceImageCycler::SetBuffer(uint32_t index, zx::vmo vmo,
+                                  uint64_t allocation_size,
+                                  off_t memory_offset,
+                                  fuchsia::images::ImageInfo info) {
+  ZX_DEBUG_ASSERT(index < num_buffers());
+  ImageBuffer& buffer = buffers_[index];
+  // Releasing the old resources only drops the session's references; scenic
+  // frees them once no pending frame uses them.
+  buffer.image.reset();
+  buffer.memory = std::make_unique<Memory>(
+      session(), std::move(vmo), allocation_size,
+      fuchsia::images::MemoryType::VK_DEVICE_MEMORY);
+  buffer.image =
+      std::make_unique<Image>(*buffer.memory, memory_offset, std::move(info));
+}
+
+uint32_t DeviceImageCycler::AcquireBuffer(zx::event* out_release_fence) {
+  ZX_DEBUG_ASSERT(!acquired_buffer_);
+  ZX_DEBUG_ASSERT(out_release_fence);
+  acquired_buffer_ = true;
+  *out_release_fence = std::move(buffers_[buffer_index_].release_fence);
+  return buffer_index_;
+}
+
+void DeviceImageCycler::PresentBuffer(zx::event acquire_fence) {
+  ZX_DEBUG_ASSERT(acquired_buffer_);
+  acquired_buffer_ = false;
+
+  ImageBuffer& buffer = buffers_[buffer_index_];
+  ZX_DEBUG_ASSERT(buffer.image);
+  content_material_.SetTexture(*buffer.image);
+
+  const fuchsia::images::ImageInfo& info = buffer.image->info();
+  if (info.width != width_ || info.height != height_) {
+    width_ = info.width;
+    height_ = info.height;
+    Rectangle content_rect(session(), width_, height_);
+    content_node_.SetShape(content_rect);
+  }
+
+  if (acquire_fence)
+    session()->EnqueueAcquireFence(std::move(acquire_fence));
+  zx::event fence;
+  zx_status_t status = zx::event::create(0u, &fence);
+  ZX_ASSERT_MSG(status == ZX_OK, "event create failed: status=%d", status);
+  status = fence.duplicate(ZX_RIGHT_SAME_RIGHTS, &buffer.release_fence);
+  ZX_ASSERT_MSG(status == ZX_OK, "duplicate failed: status=%d", status);
+  session()->EnqueueReleaseFence(std::move(fence));
+
+  buffer_index_ = (buffer_index_ + 1) % num_buffers();
+}
+
+}  // namespace scenic
@@ -0,0 +1,135 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ui/scenic/cpp/frame_scheduler.h"
+
+#include <lib/async/time.h>
+#include <zircon/assert.h>
+
+namespace scenic {
+namespace {
+
+// Used until scenic reports the actual interval, and as a starting estimate of
+// the render time.
+constexpr zx::duration kDefaultPresentationInterval = zx::usec(16667);
+constexpr zx::duration kDefaultRenderDuration = zx::msec(2);
+
+// How much earlier than strictly needed to wake the client, to absorb
+// dispatcher latency.
+constexpr zx::duration kWakeMargin = zx::msec(1);
+
+}  // namespace
+
+FrameScheduler::FrameScheduler(Session* session,
+                               async_dispatcher_t* dispatcher,
+                               RenderCallback render_callback)
+    : async_task_t{{ASYNC_STATE_INIT}, &FrameScheduler::Handler, 0, 0},
+      session_(session),
+      dispatcher_(dispatcher),
+      render_callback_(std::move(render_callback)),
+      presentation_interval_(kDefaultPresentationInterval),
+      render_duration_(kDefaultRenderDuration),
+      self_(std::make_shared<FrameScheduler*>(this)) {
+  ZX_DEBUG_ASSERT(session_);
+  ZX_DEBUG_ASSERT(dispatcher_);
+  ZX_DEBUG_ASSERT(render_callback_);
+}
+
+FrameScheduler::~FrameScheduler() {
+  if (task_posted_)
+    async_cancel_task(dispatcher_, this);
+  *self_ = nullptr;
+}
+
+void FrameScheduler::RequestFrame() {
+  frame_requested_ = true;
+  MaybeScheduleFrame();
+}
+
+void FrameScheduler::set_max_frames_in_flight(uint32_t max_frames_in_flight) {
+  ZX_DEBUG_ASSERT(max_frames_in_flight > 0u);
+  max_frames_in_flight_ = max_frames_in_flight;
+  MaybeScheduleFrame();
+}
+
+void FrameScheduler::MaybeScheduleFrame() {
+  if (!frame_requested_ || task_posted_ ||
+      frames_in_flight_ >= max_frames_in_flight_)
+    return;
+
+  // Aim for the first predicted presentation that a frame rendered from now
+  // can make, and that is later than the one presented last, since each
+  // presentation shows at most one frame.
+  const zx::time now(async_now(dispatcher_));
+  zx::time earliest = now + render_duration_ + kWakeMargin;
+  if (earliest <= last_requested_presentation_time_)
+    earliest = last_requested_presentation_time_ + zx::nsec(1);
+  zx::time target = last_presentation_time_;
+  if (target < earliest) {
+    const zx::duration behind = earliest - target;
+    const int64_t intervals =
+        (behind + presentation_interval_ - zx::nsec(1)) /
+        presentation_interval_;
+    target += presentation_interval_ * intervals;
+  }
+
+  target_presentation_time_ = target;
+  deadline = (target - render_duration_ - kWakeMargin).get();
+  if (async_post_task(dispatcher_, this) == ZX_OK)
+    task_posted_ = true;
+}
+
+void FrameScheduler::Handler(async_dispatcher_t* dispatcher,
+                             async_task_t* task, zx_status_t status) {
+  auto self = static_cast<FrameScheduler*>(task);
+  self->task_posted_ = false;
+  if (status == ZX_OK)
+    self->RenderFrame();
+}
+
+void FrameScheduler::RenderFrame() {
+  frame_requested_ = false;
+  const zx::time target = target_presentation_time_;
+
+  // The callback may destroy the scheduler and with it |render_callback_|,
+  // so it runs from the stack, observed through |self_| like the present
+  // callbacks, and is put back only if the scheduler survives.
+  std::shared_ptr<FrameScheduler*> self = self_;
+  RenderCallback render_callback = std::move(render_callback_);
+  const zx::time start(async_now(dispatcher_));
+  render_callback(target);
+  if (!*self)
+    return;
+  render_callback_ = std::move(render_callback);
+  const zx::duration elapsed = zx::time(async_now(dispatcher_)) - start;
+
+  // Adopt a longer render time at once, so that the next frame still makes
+  // its presentation, and let the estimate fall back slowly.
+  if (elapsed > render_duration_)
+    render_duration_ = elapsed;
+  else
+    render_duration_ -= (render_duration_ - elapsed) / 8;
+
+  ++frames_in_flight_;
+  last_requested_presentation_time_ = target;
+  session_->Present(target.get(),
+                    [self = self_](fuchsia::images::PresentationInfo info) {
+                      if (*self)
+                        (*self)->OnFramePresented(std::move(info));
+                    });
+
+  // The render callback may have asked for another frame.
+  MaybeScheduleFrame();
+}
+
+void FrameScheduler::OnFramePresented(fuchsia::images::PresentationInfo info) {
+  ZX_DEBUG_ASSERT(frames_in_flight_ > 0u);
+  --frames_in_flight_;
+  last_presentation_time_ = zx::time(info.presentation_time);
+  if (info.presentation_interval)
+    presentation_interval_ = zx::duration(info.presentation_interval);
+  MaybeScheduleFrame();
+}
+
+}  // namespace scenic
@@ -8,11 +8,12 @@
 
 namespace scenic {
 
-HostImageCycler::HostImageCycler(Session* session)
+HostImageCycler::HostImageCycler(Session* session, uint32_t num_buffers)
     : EntityNode(session),
       content_node_(session),
       content_material_(session),
-      image_pool_(session, kNumBuffers) {
+      image_pool_(session, num_buffers) {
+  ZX_DEBUG_ASSERT(num_buffers > 0u);
   content_node_.SetMaterial(content_material_);
   AddChild(content_node_);
 }
@@ -35,6 +36,10 @@ const HostImage* HostImageCycler::AcquireImage(
   image_info.tiling = fuchsia::images::Tiling::LINEAR;
   reconfigured_ = image_pool_.Configure(&image_info);
 
+  // Wait until scenic is done with the buffer's previous content.  The
+  // buffers are used in turn, so this one is the first to be released.
+  image_pool_.WaitForRelease(image_index_, zx::time::infinite());
+
   const HostImage* image = image_pool_.GetImage(image_index_);
   ZX_DEBUG_ASSERT(image);
   acquired_image_ = true;
@@ -57,9 +62,12 @@ void HostImageCycler::ReleaseAndSwapImage() {
     reconfigured_ = false;
   }
 
-  // TODO(MZ-145): Define an |InvalidateCmd| on |Image| instead.
-  image_pool_.DiscardImage(image_index_);
-  image_index_ = (image_index_ + 1) % kNumBuffers;
+  image_pool_.EnqueueReleaseFence(image_index_);
+  if (!retain_images_) {
+    // TODO(MZ-145): Define an |InvalidateCmd| on |Image| instead.
+    image_pool_.DiscardImage(image_index_);
+  }
+  image_index_ = (image_index_ + 1) % image_pool_.num_images();
 }
 
 }  // namespace scenic
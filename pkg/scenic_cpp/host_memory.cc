@@ -7,6 +7,7 @@
 #include <lib/zx/vmar.h>
 #include <lib/zx/vmo.h>
 #include <zircon/assert.h>
+#include <zircon/limits.h>
 #include <memory>
 
 #include "lib/ui/scenic/cpp/commands.h"
@@ -20,30 +21,53 @@ bool CanReuseMemory(const HostMemory& memory, size_t desired_size) {
          memory.data_size() <= desired_size * 2;
 }
 
-std::pair<zx::vmo, std::shared_ptr<HostData>> AllocateMemory(size_t size) {
+// Returns the size class of memory for |size| bytes: the least power of two
+// of at least a page that is at least |size|.
+size_t SizeClass(size_t size) {
+  size_t size_class = ZX_PAGE_SIZE;
+  while (size_class < size)
+    size_class *= 2u;
+  return size_class;
+}
+
+}  // namespace
+
+struct HostMemory::Allocation {
+  zx::vmo remote_vmo;
+  zx::vmo local_vmo;
+  std::shared_ptr<HostData> data;
+};
+
+HostMemory::Allocation HostMemory::Allocate(size_t size,
+                                            zx::mapping_arena* arena) {
   // Create the vmo and map it into this process.
   zx::vmo local_vmo;
   zx_status_t status = zx::vmo::create(size, 0u, &local_vmo);
   ZX_ASSERT_MSG(status == ZX_OK, "vmo create failed: status=%d", status);
-  auto data = std::make_shared<HostData>(local_vmo, 0u, size);
+  auto data = std::make_shared<HostData>(local_vmo, 0u, size, arena);
 
   // Drop rights before we transfer the VMO to the session manager.
   // TODO(MA-492): Now that host-local memory may be concurrently used as
   // device-local memory on UMA platforms, we need to keep all permissions on
   // the duplicated vmo handle, until Vulkan can import read-only memory.
   zx::vmo remote_vmo;
-  status = local_vmo.replace(ZX_RIGHT_SAME_RIGHTS, &remote_vmo);
-  ZX_ASSERT_MSG(status == ZX_OK, "replace rights failed: status=%d", status);
-  return std::make_pair(std::move(remote_vmo), std::move(data));
+  status = local_vmo.duplicate(ZX_RIGHT_SAME_RIGHTS, &remote_vmo);
+  ZX_ASSERT_MSG(status == ZX_OK, "duplicate failed: status=%d", status);
+  return Allocation{std::move(remote_vmo), std::move(local_vmo),
+                    std::move(data)};
 }
 
-}  // namespace
-
-HostData::HostData(const zx::vmo& vmo, off_t offset, size_t size)
+HostData::HostData(const zx::vmo& vmo, off_t offset, size_t size,
+                   zx::mapping_arena* arena)
     : size_(size) {
   static const uint32_t flags =
       ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE | ZX_VM_FLAG_MAP_RANGE;
   uintptr_t ptr;
+  if (arena && arena->map(vmo, offset, size, flags, &ptr) == ZX_OK) {
+    arena_ = arena;
+    ptr_ = reinterpret_cast<void*>(ptr);
+    return;
+  }
   zx_status_t status =
       zx::vmar::root_self()->map(0, vmo, offset, size, flags, &ptr);
   ZX_ASSERT_MSG(status == ZX_OK, "map failed: status=%d", status);
@@ -51,25 +75,84 @@ HostData::HostData(const zx::vmo& vmo, off_t offset, size_t size)
 }
 
 HostData::~HostData() {
+  if (arena_) {
+    arena_->unmap(reinterpret_cast<uintptr_t>(ptr_), size_);
+    return;
+  }
   zx_status_t status =
       zx::vmar::root_self()->unmap(reinterpret_cast<uintptr_t>(ptr_), size_);
   ZX_ASSERT_MSG(status == ZX_OK, "unmap failed: status=%d", status);
 }
 
-HostMemory::HostMemory(Session* session, size_t size)
-    : HostMemory(session, AllocateMemory(size)) {}
+HostMemory::HostMemory(Session* session, size_t size,
+                       zx::mapping_arena* arena)
+    : HostMemory(session, Allocate(size, arena)) {}
 
-HostMemory::HostMemory(Session* session,
-                       std::pair<zx::vmo, std::shared_ptr<HostData>> init)
-    : Memory(session, std::move(init.first), init.second->size(),
+HostMemory::HostMemory(Session* session, Allocation allocation)
+    : Memory(session, std::move(allocation.remote_vmo),
+             allocation.data->size(),
              fuchsia::images::MemoryType::HOST_MEMORY),
-      data_(std::move(init.second)) {}
+      data_(std::move(allocation.data)),
+      vmo_(std::move(allocation.local_vmo)) {}
 
 HostMemory::HostMemory(HostMemory&& moved)
-    : Memory(std::move(moved)), data_(std::move(moved.data_)) {}
+    : Memory(std::move(moved)),
+      data_(std::move(moved.data_)),
+      vmo_(std::move(moved.vmo_)) {}
 
 HostMemory::~HostMemory() = default;
 
+zx_status_t HostMemory::Decommit() {
+  return vmo_.op_range(ZX_VMO_OP_DECOMMIT, 0u, data_size(), nullptr, 0u);
+}
+
+HostMemoryCache::HostMemoryCache(Session* session, size_t max_cached_bytes)
+    : session_(session), max_cached_bytes_(max_cached_bytes) {}
+
+HostMemoryCache::~HostMemoryCache() = default;
+
+std::unique_ptr<HostMemory> HostMemoryCache::Allocate(size_t size) {
+  const size_t size_class = SizeClass(size);
+  for (auto it = idle_memory_.begin(); it != idle_memory_.end(); ++it) {
+    if ((*it)->data_size() == size_class) {
+      std::unique_ptr<HostMemory> memory = std::move(*it);
+      idle_memory_.erase(it);
+      cached_bytes_ -= size_class;
+      return memory;
+    }
+  }
+  return std::make_unique<HostMemory>(session_, size_class, mapping_arena_);
+}
+
+void HostMemoryCache::Recycle(std::unique_ptr<HostMemory> memory) {
+  ZX_DEBUG_ASSERT(memory);
+  ZX_DEBUG_ASSERT(memory->session() == session_);
+
+  // Memory that did not come from the cache is not of a size class.
+  const size_t size = memory->data_size();
+  if (size != SizeClass(size) || size > max_cached_bytes_)
+    return;
+
+  // Failing to decommit, for example because the memory is pinned, only
+  // means that the pages stay committed.
+  memory->Decommit();
+  cached_bytes_ += size;
+  idle_memory_.push_front(std::move(memory));
+  Trim();
+}
+
+void HostMemoryCache::set_max_cached_bytes(size_t max_cached_bytes) {
+  max_cached_bytes_ = max_cached_bytes;
+  Trim();
+}
+
+void HostMemoryCache::Trim() {
+  while (cached_bytes_ > max_cached_bytes_) {
+    cached_bytes_ -= idle_memory_.back()->data_size();
+    idle_memory_.pop_back();
+  }
+}
+
 HostImage::HostImage(const HostMemory& memory, off_t memory_offset,
                      fuchsia::images::ImageInfo info)
     : HostImage(memory.session(), memory.id(), memory_offset, memory.data(),
@@ -86,10 +169,20 @@ HostImage::HostImage(HostImage&& moved)
 
 HostImage::~HostImage() = default;
 
-HostImagePool::HostImagePool(Session* session, uint32_t num_images)
-    : session_(session), image_ptrs_(num_images), memory_ptrs_(num_images) {}
+HostImagePool::HostImagePool(Session* session, uint32_t num_images,
+                             MemoryMode memory_mode)
+    : session_(session),
+      memory_mode_(memory_mode),
+      image_ptrs_(num_images),
+      memory_ptrs_(memory_mode == MemoryMode::kShared ? 1u : num_images),
+      release_fences_(num_images) {}
 
-HostImagePool::~HostImagePool() = default;
+HostImagePool::~HostImagePool() {
+  for (uint32_t i = 0; i < num_images(); i++)
+    image_ptrs_[i].reset();
+  for (uint32_t i = 0; i < memory_ptrs_.size(); i++)
+    ReleaseMemory(i);
+}
 
 // TODO(mikejurka): Double-check these changes
 bool HostImagePool::Configure(const fuchsia::images::ImageInfo* image_info) {
@@ -114,10 +207,23 @@ bool HostImagePool::Configure(const fuchsia::images::ImageInfo* image_info) {
     ZX_DEBUG_ASSERT(image_info_.height > 0);
     ZX_DEBUG_ASSERT(image_info_.stride > 0);
 
-    size_t desired_size = Image::ComputeSize(image_info_);
-    for (uint32_t i = 0; i < num_images(); i++) {
+    size_t desired_size = memory_mode_ == MemoryMode::kShared
+                              ? shared_image_stride() * num_images()
+                              : Image::ComputeSize(image_info_);
+    for (uint32_t i = 0; i < memory_ptrs_.size(); i++) {
       if (memory_ptrs_[i] && !CanReuseMemory(*memory_ptrs_[i], desired_size))
-        memory_ptrs_[i].reset();
+        ReleaseMemory(i);
+    }
+
+    // Shared memory laid out anew may put an image where scenic still reads
+    // another, so reuse it only once every image has been released.
+    if (memory_mode_ == MemoryMode::kShared && memory_ptrs_[0]) {
+      for (uint32_t i = 0; i < num_images(); i++) {
+        if (!IsImageReleased(i)) {
+          memory_ptrs_[0].reset();
+          break;
+        }
+      }
     }
   }
   return true;
@@ -126,17 +232,27 @@ bool HostImagePool::Configure(const fuchsia::images::ImageInfo* image_info) {
 const HostImage* HostImagePool::GetImage(uint32_t index) {
   ZX_DEBUG_ASSERT(index < num_images());
 
+  if (!IsImageReleased(index))
+    return nullptr;
+
   if (image_ptrs_[index])
     return image_ptrs_[index].get();
 
   if (!configured_)
     return nullptr;
 
-  if (!memory_ptrs_[index]) {
-    memory_ptrs_[index] =
-        std::make_unique<HostMemory>(session_, Image::ComputeSize(image_info_));
+  if (memory_mode_ == MemoryMode::kShared) {
+    const size_t stride = shared_image_stride();
+    if (!memory_ptrs_[0])
+      memory_ptrs_[0] = NewMemory(stride * num_images());
+    image_ptrs_[index] = std::make_unique<HostImage>(
+        *memory_ptrs_[0], static_cast<off_t>(stride * index), image_info_);
+    return image_ptrs_[index].get();
   }
 
+  if (!memory_ptrs_[index])
+    memory_ptrs_[index] = NewMemory(Image::ComputeSize(image_info_));
+
   image_ptrs_[index] =
       std::make_unique<HostImage>(*memory_ptrs_[index], 0u, image_info_);
   return image_ptrs_[index].get();
@@ -148,4 +264,65 @@ void HostImagePool::DiscardImage(uint32_t index) {
   image_ptrs_[index].reset();
 }
 
+void HostImagePool::EnqueueReleaseFence(uint32_t index) {
+  ZX_DEBUG_ASSERT(index < num_images());
+
+  zx::event fence;
+  zx_status_t status = zx::event::create(0u, &fence);
+  ZX_ASSERT_MSG(status == ZX_OK, "event create failed: status=%d", status);
+  status = fence.duplicate(ZX_RIGHT_SAME_RIGHTS, &release_fences_[index]);
+  ZX_ASSERT_MSG(status == ZX_OK, "duplicate failed: status=%d", status);
+  session_->EnqueueReleaseFence(std::move(fence));
+}
+
+void HostImagePool::set_memory_cache(HostMemoryCache* cache) {
+  ZX_DEBUG_ASSERT(!cache || cache->session() == session_);
+  memory_cache_ = cache;
+}
+
+std::unique_ptr<HostMemory> HostImagePool::NewMemory(size_t size) {
+  if (memory_cache_)
+    return memory_cache_->Allocate(size);
+  return std::make_unique<HostMemory>(session_, size, mapping_arena_);
+}
+
+void HostImagePool::ReleaseMemory(uint32_t index) {
+  if (!memory_ptrs_[index])
+    return;
+
+  // Memory that scenic may still be reading must not be handed to anyone
+  // else, so only memory whose images have all been released is recycled.
+  bool released = true;
+  if (memory_mode_ == MemoryMode::kShared) {
+    for (uint32_t i = 0; i < num_images() && released; i++)
+      released = IsImageReleased(i);
+  } else {
+    released = IsImageReleased(index);
+  }
+  if (memory_cache_ && released)
+    memory_cache_->Recycle(std::move(memory_ptrs_[index]));
+  memory_ptrs_[index].reset();
+}
+
+size_t HostImagePool::shared_image_stride() const {
+  const size_t size = Image::ComputeSize(image_info_);
+  return (size + ZX_PAGE_SIZE - 1) & ~static_cast<size_t>(ZX_PAGE_SIZE - 1);
+}
+
+bool HostImagePool::IsImageReleased(uint32_t index) {
+  return WaitForRelease(index, zx::time()) == ZX_OK;
+}
+
+zx_status_t HostImagePool::WaitForRelease(uint32_t index, zx::time deadline) {
+  ZX_DEBUG_ASSERT(index < num_images());
+
+  zx::event& fence = release_fences_[index];
+  if (!fence)
+    return ZX_OK;
+  zx_status_t status = fence.wait_one(ZX_EVENT_SIGNALED, deadline, nullptr);
+  if (status == ZX_OK)
+    fence.reset();
+  return status;
+}
+
 }  // namespace scenic
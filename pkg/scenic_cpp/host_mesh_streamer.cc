@@ -0,0 +1,96 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ui/scenic/cpp/host_mesh_streamer.h"
+
+#include <zircon/assert.h>
+#include <zircon/limits.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace scenic {
+namespace {
+
+size_t RoundUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+}  // namespace
+
+HostMeshStreamer::HostMeshStreamer(Session* session, size_t frame_capacity,
+                                   uint32_t num_buffers)
+    : session_(session),
+      frame_capacity_(frame_capacity),
+      region_stride_(RoundUp(frame_capacity, ZX_PAGE_SIZE)),
+      memory_(session, region_stride_ * num_buffers),
+      buffer_(memory_, 0, region_stride_ * num_buffers),
+      release_fences_(num_buffers) {
+  ZX_DEBUG_ASSERT(frame_capacity > 0u);
+  ZX_DEBUG_ASSERT(num_buffers > 0u);
+}
+
+HostMeshStreamer::~HostMeshStreamer() = default;
+
+zx_status_t HostMeshStreamer::BeginFrame(zx::time deadline) {
+  ZX_DEBUG_ASSERT(!in_frame_);
+
+  // The regions are used in turn, so this one is the first to be released.
+  zx::event& fence = release_fences_[region_index_];
+  if (fence) {
+    zx_status_t status = fence.wait_one(ZX_EVENT_SIGNALED, deadline, nullptr);
+    if (status != ZX_OK)
+      return status;
+    fence.reset();
+  }
+
+  in_frame_ = true;
+  region_used_ = 0u;
+  return ZX_OK;
+}
+
+bool HostMeshStreamer::Allocate(size_t size, Range* range) {
+  ZX_DEBUG_ASSERT(in_frame_);
+
+  if (size > frame_capacity_ - region_used_)
+    return false;
+
+  const size_t offset = region_stride_ * region_index_ + region_used_;
+  range->ptr = static_cast<uint8_t*>(memory_.data_ptr()) + offset;
+  range->offset = offset;
+  range->size = size;
+  region_used_ =
+      std::min(RoundUp(region_used_ + size, kRangeAlignment), frame_capacity_);
+  return true;
+}
+
+void HostMeshStreamer::BindMesh(
+    Mesh* mesh, fuchsia::ui::gfx::MeshIndexFormat index_format,
+    const Range& indices, uint32_t index_count,
+    fuchsia::ui::gfx::MeshVertexFormat vertex_format, const Range& vertices,
+    uint32_t vertex_count, const float bounding_box_min[3],
+    const float bounding_box_max[3]) {
+  ZX_DEBUG_ASSERT(in_frame_);
+
+  mesh->BindBuffers(buffer_, index_format, indices.offset, index_count,
+                    buffer_, std::move(vertex_format), vertices.offset,
+                    vertex_count, bounding_box_min, bounding_box_max);
+}
+
+void HostMeshStreamer::EndFrame() {
+  ZX_DEBUG_ASSERT(in_frame_);
+
+  zx::event fence;
+  zx_status_t status = zx::event::create(0u, &fence);
+  ZX_ASSERT_MSG(status == ZX_OK, "event create failed: status=%d", status);
+  status = fence.duplicate(ZX_RIGHT_SAME_RIGHTS,
+                           &release_fences_[region_index_]);
+  ZX_ASSERT_MSG(status == ZX_OK, "duplicate failed: status=%d", status);
+  session_->EnqueueReleaseFence(std::move(fence));
+
+  in_frame_ = false;
+  region_index_ = (region_index_ + 1) % release_fences_.size();
+}
+
+}  // namespace scenic
@@ -0,0 +1,123 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_UI_SCENIC_CPP_COMMAND_RECORDER_H_
+#define LIB_UI_SCENIC_CPP_COMMAND_RECORDER_H_
+
+#include <fuchsia/ui/gfx/cpp/fidl.h>
+#include <fuchsia/ui/input/cpp/fidl.h>
+#include <fuchsia/ui/scenic/cpp/fidl.h>
+#include <lib/fidl/cpp/encoder.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zircon/types.h>
+
+#include <vector>
+
+#include "lib/ui/scenic/cpp/session.h"
+
+namespace scenic {
+
+// Records operations for a |Session| away from the session's thread, so that
+// the operations of a frame can be built on several threads at once.
+//
+// Each operation is encoded as it is recorded, as |Session::Enqueue()| does,
+// so the work of building and encoding it happens on the recording thread.
+// |Session::Submit()| later appends the encoded operations to the session's
+// queue in a defined order, which costs about a copy of their bytes.
+//
+// Resource ids come from a block of ids the recorder reserves from the
+// session, so allocating one needs no lock. The block is reserved when the
+// recorder is created and refilled by each |Session::Submit()|, so a
+// recorder can allocate at most |id_block_size| ids between submits.
+//
+// A recorder is used on one thread at a time, and not while the session is
+// submitting it. It is created and destroyed on the session's thread, and
+// must not outlive the session. This class is thread-hostile.
+//
+// # Example
+//
+//   std::vector<std::unique_ptr<scenic::CommandRecorder>> recorders;
+//   ...
+//   // On each worker thread:
+//   recorders[i]->Enqueue(scenic::NewSetTranslationCmd(node_id, translation));
+//   // On the session's thread, once the workers are done:
+//   session.Submit({recorders[0].get(), recorders[1].get()});
+//   session.Present(presentation_time, std::move(callback));
+class CommandRecorder {
+ public:
+  // The number of ids a recorder keeps reserved by default.
+  static constexpr uint32_t kDefaultIdBlockSize = 256u;
+
+  // Creates a recorder for |session|, reserving a block of |id_block_size|
+  // resource ids from it.
+  explicit CommandRecorder(Session* session,
+                           uint32_t id_block_size = kDefaultIdBlockSize);
+
+  // Discards the operations recorded since the last submit, and returns the
+  // unused ids of the block to the session. Ids allocated since the last
+  // submit are returned too, since no operation using them will be sent.
+  ~CommandRecorder();
+
+  CommandRecorder(const CommandRecorder&) = delete;
+  CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+  // Allocates a resource id from the recorder's block.
+  //
+  // The block must not run out before the next submit.
+  uint32_t AllocResourceId();
+
+  // Records an operation to release a resource.
+  // Its id becomes free for reuse after the |Present()| that follows the
+  // submit of the release is applied.
+  void ReleaseResource(uint32_t resource_id);
+
+  // Records an operation.
+  void Enqueue(fuchsia::ui::scenic::Command command);
+  void Enqueue(fuchsia::ui::gfx::Command command);
+  void Enqueue(fuchsia::ui::input::Command command);
+
+  // The number of operations recorded since the last submit.
+  size_t command_count() const { return commands_.size(); }
+
+  // The number of ids left in the block.
+  size_t available_ids() const { return free_ids_.size(); }
+
+ private:
+  friend class Session;
+
+  // The sizes of an operation in |bytes_| and |handles_|, and how the
+  // session batches it.
+  struct EncodedCommand {
+    uint32_t num_bytes;
+    uint32_t num_handles;
+    uint64_t property_key;
+    bool is_input;
+  };
+
+  // Reserves ids from the session until the block is full again.
+  void RefillIds();
+
+  Session* const session_;
+  const uint32_t id_block_size_;
+  // The unused ids of the block, lowest last.
+  std::vector<uint32_t> free_ids_;
+  // Ids allocated since the last submit.
+  std::vector<uint32_t> allocated_ids_;
+  // Ids released since the last submit.
+  std::vector<uint32_t> released_ids_;
+
+  // The recorded operations, encoded by |Session::EncodeCommand()| one after
+  // the other, and their handles, which the recorder owns until they are
+  // submitted.
+  std::vector<EncodedCommand> commands_;
+  std::vector<uint8_t> bytes_;
+  std::vector<zx_handle_t> handles_;
+  // Encodes one operation at a time; kept to reuse its storage.
+  fidl::Encoder encoder_{fidl::Encoder::NO_HEADER};
+};
+
+}  // namespace scenic
+
+#endif  // LIB_UI_SCENIC_CPP_COMMAND_RECORDER_H_
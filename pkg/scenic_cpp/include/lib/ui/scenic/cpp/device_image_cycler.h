@@ -0,0 +1,87 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_UI_SCENIC_CPP_DEVICE_IMAGE_CYCLER_H_
+#define LIB_UI_SCENIC_CPP_DEVICE_IMAGE_CYCLER_H_
+
+#include <memory>
+#include <vector>
+
+#include <lib/zx/event.h>
+#include <lib/zx/vmo.h>
+
+#include "lib/ui/scenic/cpp/resources.h"
+
+namespace scenic {
+
+// Creates a node which presents content that the client renders on the GPU,
+// into images in Vulkan device memory, without copying it through the host.
+//
+// Each buffer is the VMO of a |VkDeviceMemory| exported with
+// |vkGetMemoryFuchsiaHandleKHR|, which scenic imports as
+// |fuchsia::images::MemoryType::VK_DEVICE_MEMORY| once, when it is set. The
+// fences of each frame stay on the GPU as well:
+//
+//  * |AcquireBuffer()| returns the release fence of the frame that last
+//    showed the buffer. Import it into a semaphore with
+//    |vkImportSemaphoreFuchsiaHandleKHR| and have the rendering wait on it,
+//    so that it does not overwrite what scenic is still reading.
+//  * |PresentBuffer()| takes an acquire fence exported from the semaphore
+//    that the rendering signals, with |vkGetSemaphoreFuchsiaHandleKHR|, so
+//    that scenic waits for the frame to be rendered.
+//
+// Neither the client nor scenic waits on the CPU for the other.
+class DeviceImageCycler : public scenic::EntityNode {
+ public:
+  static constexpr uint32_t kDefaultNumBuffers = 3u;
+
+  explicit DeviceImageCycler(scenic::Session* session,
+                             uint32_t num_buffers = kDefaultNumBuffers);
+  ~DeviceImageCycler();
+
+  DeviceImageCycler(const DeviceImageCycler&) = delete;
+  DeviceImageCycler& operator=(const DeviceImageCycler&) = delete;
+
+  uint32_t num_buffers() const { return buffers_.size(); }
+
+  // Sets the buffer at |index| to the image described by |info|, at
+  // |memory_offset| in |vmo|, the exported memory of |allocation_size|
+  // bytes. Replaces the buffer's previous image; scenic keeps its memory
+  // until its release fence signals.
+  void SetBuffer(uint32_t index, zx::vmo vmo, uint64_t allocation_size,
+                 off_t memory_offset, fuchsia::images::ImageInfo info);
+
+  // Acquires the next buffer for rendering, in turn, and returns its index.
+  // |out_release_fence| receives the fence that signals once scenic stops
+  // reading the buffer's previous frame, or an invalid event if it has not
+  // been presented before. At most one buffer can be acquired at a time.
+  uint32_t AcquireBuffer(zx::event* out_release_fence);
+
+  // Presents the buffer most recently acquired with the session's next
+  // |Present()|, once |acquire_fence| signals.
+  void PresentBuffer(zx::event acquire_fence);
+
+ private:
+  struct ImageBuffer {
+    std::unique_ptr<scenic::Memory> memory;
+    std::unique_ptr<scenic::Image> image;
+    // The release fence of the latest frame that showed the buffer, until
+    // the buffer is next acquired.
+    zx::event release_fence;
+  };
+
+  scenic::ShapeNode content_node_;
+  scenic::Material content_material_;
+  std::vector<ImageBuffer> buffers_;
+
+  bool acquired_buffer_ = false;
+  uint32_t buffer_index_ = 0u;
+  // The size of the content shape, to resize it only when the images do.
+  uint32_t width_ = 0u;
+  uint32_t height_ = 0u;
+};
+
+}  // namespace scenic
+
+#endif  // LIB_UI_SCENIC_CPP_DEVICE_IMAGE_CYCLER_H_
@@ -0,0 +1,105 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_UI_SCENIC_CPP_FRAME_SCHEDULER_H_
+#define LIB_UI_SCENIC_CPP_FRAME_SCHEDULER_H_
+
+#include <lib/async/task.h>
+#include <lib/fit/function.h>
+#include <lib/zx/time.h>
+
+#include <memory>
+
+#include "lib/ui/scenic/cpp/session.h"
+
+namespace scenic {
+
+// Paces the frames of a session: calls the client back to render a frame just
+// in time for the next presentation, and presents it.
+//
+// The scheduler predicts upcoming presentation times from the
+// |fuchsia::images::PresentationInfo| of earlier frames, and how long
+// rendering takes from how long the render callback has taken so far. It
+// wakes the client that long before the first presentation that rendering can
+// still make, so the frame shows content that is as fresh as possible, and it
+// keeps at most |max_frames_in_flight()| presents outstanding so that frames
+// do not queue up in scenic.
+//
+// The scheduler must be used on the thread of |dispatcher|, which is the one
+// the session's presents are answered on.
+class FrameScheduler : private async_task_t {
+ public:
+  // Renders a frame to be presented at |presentation_time|, by enqueuing
+  // operations on the session. The scheduler presents them once the callback
+  // returns.
+  //
+  // Call |RequestFrame()| from the callback to render again in the next frame,
+  // for example while an animation runs.
+  //
+  // The callback can destroy the scheduler, in which case nothing is
+  // presented.
+  using RenderCallback = fit::function<void(zx::time presentation_time)>;
+
+  FrameScheduler(Session* session, async_dispatcher_t* dispatcher,
+                 RenderCallback render_callback);
+  ~FrameScheduler();
+
+  FrameScheduler(const FrameScheduler&) = delete;
+  FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+  // Asks for a frame to be rendered for the earliest presentation it can
+  // make. Requests made before the frame renders are satisfied by it.
+  void RequestFrame();
+
+  // The number of presents that may await their |PresentCallback| at once.
+  // Defaults to 2, which lets the client render the next frame while scenic
+  // composes the previous one.
+  uint32_t max_frames_in_flight() const { return max_frames_in_flight_; }
+  void set_max_frames_in_flight(uint32_t max_frames_in_flight);
+
+  // The number of presents awaiting their |PresentCallback|.
+  uint32_t frames_in_flight() const { return frames_in_flight_; }
+
+  // The predicted interval between presentations.
+  zx::duration presentation_interval() const { return presentation_interval_; }
+
+  // The predicted time the render callback takes.
+  zx::duration render_duration() const { return render_duration_; }
+
+ private:
+  // Posts the task that renders the next frame, if one is requested and none
+  // is already scheduled or blocked by the frames in flight.
+  void MaybeScheduleFrame();
+
+  static void Handler(async_dispatcher_t* dispatcher, async_task_t* task,
+                      zx_status_t status);
+  void RenderFrame();
+  void OnFramePresented(fuchsia::images::PresentationInfo info);
+
+  Session* const session_;
+  async_dispatcher_t* const dispatcher_;
+  RenderCallback render_callback_;
+
+  uint32_t max_frames_in_flight_ = 2u;
+  uint32_t frames_in_flight_ = 0u;
+  bool frame_requested_ = false;
+  bool task_posted_ = false;
+
+  // The presentation time of the frame |task_posted_| renders.
+  zx::time target_presentation_time_;
+  // The presentation time of the latest frame presented, and the latest
+  // reported by scenic.
+  zx::time last_requested_presentation_time_;
+  zx::time last_presentation_time_;
+  zx::duration presentation_interval_;
+  zx::duration render_duration_;
+
+  // Points back at the scheduler until it is destroyed, so that present
+  // callbacks that outlive it do nothing.
+  std::shared_ptr<FrameScheduler*> self_;
+};
+
+}  // namespace scenic
+
+#endif  // LIB_UI_SCENIC_CPP_FRAME_SCHEDULER_H_
@@ -9,17 +9,26 @@
 
 namespace scenic {
 
-// Creates a node which presents double-buffered content drawn to an image
-// in host memory.
+// Creates a node which presents content drawn to images in host memory, by
+// default double-buffered.
+//
+// Each swap enqueues a release fence for the image presented, and
+// |AcquireImage()| waits for scenic to release an image before handing it out
+// again, so content is never drawn into memory that scenic is reading.
 class HostImageCycler : public scenic::EntityNode {
  public:
-  explicit HostImageCycler(scenic::Session* session);
+  static constexpr uint32_t kDefaultNumBuffers = 2u;
+
+  // Cycles through |num_buffers| images; use 3 for triple buffering, which
+  // lets the client draw a frame while scenic holds the two before it.
+  explicit HostImageCycler(scenic::Session* session,
+                           uint32_t num_buffers = kDefaultNumBuffers);
   ~HostImageCycler();
 
   HostImageCycler(const HostImageCycler&) = delete;
   HostImageCycler& operator=(const HostImageCycler&) = delete;
 
-  // Acquires an image for rendering.
+  // Acquires an image for rendering, waiting until scenic has released it.
   // At most one image can be acquired at a time.
   // The client is responsible for clearing the image.
   const HostImage* AcquireImage(uint32_t width, uint32_t height,
@@ -33,15 +42,25 @@ class HostImageCycler : public scenic::EntityNode {
   // Sets the content node's texture to be backed by the image.
   void ReleaseAndSwapImage();
 
- private:
-  static constexpr uint32_t kNumBuffers = 2u;
+  // Sets whether the cycler keeps its images alive from frame to frame.
+  //
+  // By default each swap discards the image just presented, which makes the
+  // session release its |Image| resource and create a new one for the next
+  // use of the buffer, since that is how scenic learns the content changed.
+  // When images are retained, a swap only retargets the texture.
+  //
+  // Only retain images when presenting to a consumer that reads an image's
+  // host memory each time the image is presented.
+  void set_retain_images(bool retain_images) { retain_images_ = retain_images; }
 
+ private:
   scenic::ShapeNode content_node_;
   scenic::Material content_material_;
   scenic::HostImagePool image_pool_;
 
   bool acquired_image_ = false;
   bool reconfigured_ = false;
+  bool retain_images_ = false;
   uint32_t image_index_ = 0u;
 };
 
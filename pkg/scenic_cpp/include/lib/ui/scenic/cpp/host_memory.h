@@ -5,10 +5,14 @@
 #ifndef LIB_UI_SCENIC_CPP_HOST_MEMORY_H_
 #define LIB_UI_SCENIC_CPP_HOST_MEMORY_H_
 
+#include <list>
 #include <memory>
 #include <utility>
 #include <vector>
 
+#include <lib/zx/event.h>
+#include <lib/zx/mapping_arena.h>
+#include <lib/zx/time.h>
 #include <lib/zx/vmo.h>
 
 #include "lib/ui/scenic/cpp/resources.h"
@@ -19,8 +23,10 @@ namespace scenic {
 // The memory is unmapped once all references to this object have been released.
 class HostData : public std::enable_shared_from_this<HostData> {
  public:
-  // Maps a range of an existing VMO into memory.
-  HostData(const zx::vmo& vmo, off_t offset, size_t size);
+  // Maps a range of an existing VMO into memory, into a slot of |arena| if
+  // one is given and has room, and into the root VMAR otherwise.
+  HostData(const zx::vmo& vmo, off_t offset, size_t size,
+           zx::mapping_arena* arena = nullptr);
   ~HostData();
 
   HostData(const HostData&) = delete;
@@ -35,6 +41,8 @@ class HostData : public std::enable_shared_from_this<HostData> {
  private:
   size_t const size_;
   void* ptr_;
+  // The arena that holds the mapping, if any.
+  zx::mapping_arena* arena_ = nullptr;
 };
 
 // Represents a host-accessible shared memory backed memory resource in a
@@ -48,7 +56,9 @@ class HostData : public std::enable_shared_from_this<HostData> {
 // a read/write vmo in order to successfully import the memory.
 class HostMemory final : public Memory {
  public:
-  HostMemory(Session* session, size_t size);
+  // Maps the memory into a slot of |arena| if one is given; see |HostData|.
+  HostMemory(Session* session, size_t size,
+             zx::mapping_arena* arena = nullptr);
   HostMemory(HostMemory&& moved);
   ~HostMemory();
 
@@ -64,11 +74,74 @@ class HostMemory final : public Memory {
   // Gets a pointer to the data.
   void* data_ptr() const { return data_->ptr(); }
 
+  // Returns the memory's pages to the system, keeping it mapped.
+  // The memory reads as zeros afterwards, and pages are committed again as
+  // they are touched.
+  zx_status_t Decommit();
+
  private:
-  explicit HostMemory(Session* session,
-                      std::pair<zx::vmo, std::shared_ptr<HostData>> init);
+  struct Allocation;
+  static Allocation Allocate(size_t size, zx::mapping_arena* arena);
+  explicit HostMemory(Session* session, Allocation allocation);
 
   std::shared_ptr<HostData> data_;
+  // The VMO, for |Decommit()|.
+  zx::vmo vmo_;
+};
+
+// Keeps idle |HostMemory| of a session so that it can be reused, rather than
+// allocating, mapping and importing new memory each time, for example each
+// time a window is resized.
+//
+// Memory is allocated in power-of-two size classes of at least a page, so
+// that memory released for one size can be reused for nearby ones. Idle
+// memory is decommitted, which returns its pages to the system while keeping
+// it mapped and imported, and once idle memory exceeds the cache's byte
+// budget the least recently used is freed.
+//
+// The cache must outlive the pools that use it.
+class HostMemoryCache {
+ public:
+  static constexpr size_t kDefaultMaxCachedBytes = 32u << 20;
+
+  explicit HostMemoryCache(Session* session,
+                           size_t max_cached_bytes = kDefaultMaxCachedBytes);
+  ~HostMemoryCache();
+
+  HostMemoryCache(const HostMemoryCache&) = delete;
+  HostMemoryCache& operator=(const HostMemoryCache&) = delete;
+
+  Session* session() const { return session_; }
+
+  // Returns memory of at least |size| bytes: idle memory of the same size
+  // class if there is any, or else new memory of the size class.
+  std::unique_ptr<HostMemory> Allocate(size_t size);
+
+  // Takes back memory that is no longer used, which scenic must have stopped
+  // reading, for reuse.
+  void Recycle(std::unique_ptr<HostMemory> memory);
+
+  // The total size of the idle memory, which is at most
+  // |max_cached_bytes()|.
+  size_t cached_bytes() const { return cached_bytes_; }
+
+  size_t max_cached_bytes() const { return max_cached_bytes_; }
+  void set_max_cached_bytes(size_t max_cached_bytes);
+
+  // Maps new memory into slots of |arena|, which must outlive the memory
+  // and may be null.
+  void set_mapping_arena(zx::mapping_arena* arena) { mapping_arena_ = arena; }
+
+ private:
+  // Frees the least recently used memory until the budget is met.
+  void Trim();
+
+  Session* const session_;
+  size_t max_cached_bytes_;
+  size_t cached_bytes_ = 0u;
+  // The idle memory, most recently used first.
+  std::list<std::unique_ptr<HostMemory>> idle_memory_;
+  zx::mapping_arena* mapping_arena_ = nullptr;
 };
 
 // Represents an image resource backed by host-accessible shared memory bound to
@@ -104,8 +177,18 @@ class HostImage final : public Image {
 // bound to a session.  All images in the pool must have the same layout.
 class HostImagePool {
  public:
+  // How a pool backs its images with memory.
+  enum class MemoryMode {
+    // Each image has a |HostMemory| of its own.
+    kPerImage,
+    // All the images share one |HostMemory|, each at a page-aligned offset,
+    // which takes one VMO, one mapping and one memory resource in all.
+    kShared,
+  };
+
   // Creates a pool which can supply up to |num_images| images on demand.
-  explicit HostImagePool(Session* session, uint32_t num_images);
+  explicit HostImagePool(Session* session, uint32_t num_images,
+                         MemoryMode memory_mode = MemoryMode::kPerImage);
   ~HostImagePool();
 
   HostImagePool(const HostImagePool&) = delete;
@@ -128,20 +211,66 @@ class HostImagePool {
   // Gets the image with the specified index.
   // The |index| must be between 0 and |num_images() - 1|.
   // The returned pointer is valid until the image is discarded or the
-  // pool is reconfigured.  Returns nullptr if the pool is not configured.
+  // pool is reconfigured.  Returns nullptr if the pool is not configured, or
+  // if scenic may still be reading the image's memory; see
+  // |EnqueueReleaseFence()|.
   const HostImage* GetImage(uint32_t index);
 
   // Discards the image with the specified index but recycles its memory.
   // The |index| must be between 0 and |num_images() - 1|.
   void DiscardImage(uint32_t index);
 
+  // Enqueues a release fence with the session's next |Present()|, so that the
+  // pool knows when scenic stops reading the memory of the image with the
+  // specified index, as it is presented then.  Until the fence signals, the
+  // image is not released and |GetImage()| does not hand it out.
+  // The |index| must be between 0 and |num_images() - 1|.
+  void EnqueueReleaseFence(uint32_t index);
+
+  // Returns true if the memory of the image with the specified index may be
+  // written: scenic has signaled its release fence, or none is pending.
+  // The |index| must be between 0 and |num_images() - 1|.
+  bool IsImageReleased(uint32_t index);
+
+  // Waits until the image with the specified index is released or |deadline|
+  // passes.  Returns |ZX_OK| once it is released, or an error from waiting on
+  // the fence, such as |ZX_ERR_TIMED_OUT|.
+  // The |index| must be between 0 and |num_images() - 1|.
+  zx_status_t WaitForRelease(uint32_t index, zx::time deadline);
+
+  // Makes the pool take its memory from |cache| and return memory it no
+  // longer needs to it, rather than allocating and freeing its own.
+  // The |cache| must belong to the same session, and may be null.
+  void set_memory_cache(HostMemoryCache* cache);
+
+  // Maps the memory that the pool allocates itself, without a cache, into
+  // slots of |arena|, so that the churn of reconfiguring the pool reuses
+  // address space instead of mapping and unmapping in the root VMAR. The
+  // |arena| must outlive the pool's memory, and may be null.
+  void set_mapping_arena(zx::mapping_arena* arena) { mapping_arena_ = arena; }
+
  private:
+  std::unique_ptr<HostMemory> NewMemory(size_t size);
+  // Frees |memory_ptrs_[index]| or, if it can be reused, returns it to the
+  // cache.
+  void ReleaseMemory(uint32_t index);
+
+  // The distance between images in shared memory.
+  size_t shared_image_stride() const;
+
   Session* const session_;
+  const MemoryMode memory_mode_;
 
   bool configured_ = false;
   fuchsia::images::ImageInfo image_info_;
   std::vector<std::unique_ptr<HostImage>> image_ptrs_;
+  // The memory of each image, or in |MemoryMode::kShared|, of all of them at
+  // index 0.
   std::vector<std::unique_ptr<HostMemory>> memory_ptrs_;
+  // The pending release fence of each image, if any.
+  std::vector<zx::event> release_fences_;
+  HostMemoryCache* memory_cache_ = nullptr;
+  zx::mapping_arena* mapping_arena_ = nullptr;
 };
 
 }  // namespace scenic
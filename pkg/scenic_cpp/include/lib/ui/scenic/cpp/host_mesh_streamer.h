@@ -0,0 +1,107 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_UI_SCENIC_CPP_HOST_MESH_STREAMER_H_
+#define LIB_UI_SCENIC_CPP_HOST_MESH_STREAMER_H_
+
+#include <lib/zx/event.h>
+#include <lib/zx/time.h>
+
+#include <vector>
+
+#include "lib/ui/scenic/cpp/host_memory.h"
+#include "lib/ui/scenic/cpp/resources.h"
+
+namespace scenic {
+
+// Streams the vertices and indices of meshes whose geometry changes every
+// frame, such as charts and particle effects, through host memory, by default
+// double-buffered.
+//
+// All of the geometry lives in one |HostMemory| with one |Buffer| over it,
+// which is divided into a region per buffered frame.  Each frame, the client
+// allocates ranges of vertices and indices from the frame's region, fills
+// them in and binds meshes to them, which only changes the offsets that the
+// meshes read from: no memory or buffer resources are created.
+//
+// Ending a frame enqueues a release fence for its region, and
+// |BeginFrame()| waits for scenic to release a region before handing it out
+// again, so geometry is never written to memory that scenic is reading.
+class HostMeshStreamer {
+ public:
+  static constexpr uint32_t kDefaultNumBuffers = 2u;
+
+  // The alignment of the ranges that |Allocate()| returns.
+  static constexpr size_t kRangeAlignment = 16u;
+
+  // A range of the streamer's memory.
+  struct Range {
+    // Where the client writes the range's contents.
+    void* ptr;
+    // The offset of the range in |buffer()|.
+    uint64_t offset;
+    size_t size;
+  };
+
+  // Streams up to |frame_capacity| bytes of vertices and indices per frame
+  // through |num_buffers| regions; use 3 for triple buffering, which lets the
+  // client fill a frame while scenic holds the two before it.
+  HostMeshStreamer(Session* session, size_t frame_capacity,
+                   uint32_t num_buffers = kDefaultNumBuffers);
+  ~HostMeshStreamer();
+
+  HostMeshStreamer(const HostMeshStreamer&) = delete;
+  HostMeshStreamer& operator=(const HostMeshStreamer&) = delete;
+
+  // The buffer that the ranges are offsets in.
+  const Buffer& buffer() const { return buffer_; }
+
+  // The number of bytes that each frame can allocate.
+  size_t frame_capacity() const { return frame_capacity_; }
+
+  // Starts filling the next region, waiting until scenic has released it or
+  // |deadline| passes.  Returns |ZX_OK| once the region is released, or an
+  // error from waiting on its fence, such as |ZX_ERR_TIMED_OUT|, in which
+  // case no frame is started.
+  zx_status_t BeginFrame(zx::time deadline = zx::time::infinite());
+
+  // Allocates |size| bytes of the current frame's region.  Returns false if
+  // the region does not have that much room left.
+  // Must be called between |BeginFrame()| and |EndFrame()|.
+  bool Allocate(size_t size, Range* range);
+
+  // Binds |mesh| to vertices and indices in ranges of the current frame.
+  // These arguments are documented in commands.fidl; see BindMeshBuffersCmd.
+  // Must be called between |BeginFrame()| and |EndFrame()|.
+  void BindMesh(Mesh* mesh, fuchsia::ui::gfx::MeshIndexFormat index_format,
+                const Range& indices, uint32_t index_count,
+                fuchsia::ui::gfx::MeshVertexFormat vertex_format,
+                const Range& vertices, uint32_t vertex_count,
+                const float bounding_box_min[3],
+                const float bounding_box_max[3]);
+
+  // Finishes the current frame, enqueuing a release fence for its region
+  // with the session's next |Present()|.
+  void EndFrame();
+
+ private:
+  Session* const session_;
+  const size_t frame_capacity_;
+  // The distance between regions, which start on pages of their own.
+  const size_t region_stride_;
+
+  HostMemory memory_;
+  Buffer buffer_;
+  // The pending release fence of each region, if any.
+  std::vector<zx::event> release_fences_;
+
+  bool in_frame_ = false;
+  uint32_t region_index_ = 0u;
+  // The number of bytes allocated from the current region.
+  size_t region_used_ = 0u;
+};
+
+}  // namespace scenic
+
+#endif  // LIB_UI_SCENIC_CPP_HOST_MESH_STREAMER_H_
@@ -0,0 +1,106 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_UI_SCENIC_CPP_POINTER_COALESCER_H_
+#define LIB_UI_SCENIC_CPP_POINTER_COALESCER_H_
+
+#include <fuchsia/ui/input/cpp/fidl.h>
+#include <lib/fit/function.h>
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "lib/ui/scenic/cpp/frame_scheduler.h"
+
+namespace scenic {
+
+// Holds the pointer events that arrive between frames and hands them over
+// once per frame, with the moves of each pointer merged.
+//
+// A high-rate pointer produces many |MOVE| or |HOVER| events per frame, and
+// only the latest position matters for what the frame shows. The coalescer
+// merges each such event into the one queued before it for the same pointer,
+// as long as no other event of that pointer came in between and the buttons
+// are unchanged. The merged event keeps its place in the queue and takes the
+// latest sample; the samples it replaced are kept, oldest first, as its
+// history, for clients such as drawing apps that want every sample. Every
+// other event, such as |DOWN| and |UP|, is queued as is, so the events of
+// each pointer keep their order.
+//
+// Queuing an event requests a frame from |scheduler|; the render callback
+// then calls |Flush()| to handle the events before rendering.
+//
+// The coalescer must be used on the scheduler's thread.
+//
+// EXAMPLE
+//
+//     void OnEvent(fuchsia::ui::input::InputEvent event,
+//                  OnEventCallback callback) override {
+//       if (event.is_pointer())
+//         coalescer_.Add(std::move(event.pointer()));
+//       callback(true);
+//     }
+//
+//     void Render(zx::time presentation_time) {
+//       coalescer_.Flush([this](const auto& event, const auto& history) {
+//         HandlePointer(event);
+//       });
+//       ...
+//     }
+class PointerCoalescer {
+ public:
+  // Called with each event, in order, and with the older samples merged into
+  // it, if any. Both are valid only during the call.
+  using Handler = fit::function<void(
+      const fuchsia::ui::input::PointerEvent& event,
+      const std::vector<fuchsia::ui::input::PointerEvent>& history)>;
+
+  // Requests frames from |scheduler|, which must outlive the coalescer.
+  explicit PointerCoalescer(FrameScheduler* scheduler);
+  ~PointerCoalescer();
+
+  PointerCoalescer(const PointerCoalescer&) = delete;
+  PointerCoalescer& operator=(const PointerCoalescer&) = delete;
+
+  // Whether merged samples are kept as history. Defaults to true; clients
+  // that only need the latest position save the copies.
+  void set_keep_history(bool keep_history) { keep_history_ = keep_history; }
+
+  // Queues |event|, merging it into the last queued event of its pointer if
+  // both are moves.
+  void Add(fuchsia::ui::input::PointerEvent event);
+
+  // Hands the queued events to |handler| and empties the queue. Events added
+  // by |handler| are held for the next flush.
+  void Flush(const Handler& handler);
+
+  // The number of events queued, after merging, and the number merged away
+  // since the coalescer was created.
+  size_t queued_events() const { return count_; }
+  size_t merged_events() const { return merged_events_; }
+
+ private:
+  struct Entry {
+    fuchsia::ui::input::PointerEvent event;
+    std::vector<fuchsia::ui::input::PointerEvent> history;
+  };
+
+  // The last queued entry of the pointer of |event|, or null.
+  Entry* FindLast(const fuchsia::ui::input::PointerEvent& event);
+
+  FrameScheduler* const scheduler_;
+  bool keep_history_ = true;
+  size_t merged_events_ = 0u;
+
+  // The queue is the first |count_| entries. Entries past it, and those of
+  // |flushing_|, are kept so that their history storage is reused.
+  std::vector<Entry> entries_;
+  size_t count_ = 0u;
+  std::vector<Entry> flushing_;
+};
+
+}  // namespace scenic
+
+#endif  // LIB_UI_SCENIC_CPP_POINTER_COALESCER_H_
@@ -0,0 +1,111 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_UI_SCENIC_CPP_RETAINED_NODE_H_
+#define LIB_UI_SCENIC_CPP_RETAINED_NODE_H_
+
+#include <array>
+#include <vector>
+
+#include "lib/ui/scenic/cpp/resources.h"
+
+namespace scenic {
+
+// Remembers the properties last set on a node, and enqueues commands to set
+// them only when they change, so that a UI framework can declare the whole
+// state of its scene each frame without flooding the session with commands
+// that do nothing.
+//
+// Retained nodes form a shadow tree of the nodes they wrap: each knows its
+// children, in order, and its parent.  |SetChildren()| diffs the new children
+// against the old, detaching only the children that leave and adding only
+// those that join or move.
+//
+// A retained node does not own the node it wraps, which must outlive it.
+// All changes to the node must go through the retained node, or its shadow
+// state goes stale.
+class RetainedNode {
+ public:
+  explicit RetainedNode(Node* node);
+  explicit RetainedNode(ShapeNode* node);
+  explicit RetainedNode(ContainerNode* node);
+  explicit RetainedNode(OpacityNode* node);
+  ~RetainedNode();
+
+  RetainedNode(const RetainedNode&) = delete;
+  RetainedNode& operator=(const RetainedNode&) = delete;
+
+  // Gets the node this wraps.
+  Node* node() const { return node_; }
+
+  // Gets the retained node whose children include this one, or nullptr.
+  RetainedNode* parent() const { return parent_; }
+
+  // Gets the children, in order.
+  const std::vector<RetainedNode*>& children() const { return children_; }
+
+  // Sets the node's transform properties.
+  void SetTranslation(float tx, float ty, float tz);
+  void SetScale(float sx, float sy, float sz);
+  void SetRotation(float qi, float qj, float qk, float qw);
+  void SetAnchor(float ax, float ay, float az);
+
+  // Sets the node's tag value.
+  void SetTag(uint32_t tag_value);
+
+  // Sets the node's hit test behavior.
+  void SetHitTestBehavior(fuchsia::ui::gfx::HitTestBehavior hit_test_behavior);
+
+  // Sets the shape and material of a shape node, by id.
+  // Only valid for retained nodes that wrap a |ShapeNode|.
+  void SetShape(uint32_t shape_id);
+  void SetMaterial(uint32_t material_id);
+
+  // Sets the opacity of an opacity node.
+  // Only valid for retained nodes that wrap an |OpacityNode|.
+  void SetOpacity(float opacity);
+
+  // Makes |children| the node's children, in order, taking them from any
+  // other parent they have.
+  //
+  // Children that the node already has keep their place, unless they must
+  // move for the new order: the children after the first one out of order
+  // are detached and added again.
+  // Only valid for retained nodes that wrap a |ContainerNode|.
+  void SetChildren(const std::vector<RetainedNode*>& children);
+
+  // Detaches the node from its retained parent, if it has one.
+  void Detach();
+
+ private:
+  RetainedNode(Node* node, ShapeNode* shape_node, ContainerNode* container_node,
+               OpacityNode* opacity_node);
+
+  // Forgets |child|, which has been detached or taken by another parent.
+  void RemoveChild(RetainedNode* child);
+
+  Node* const node_;
+  ShapeNode* const shape_node_;
+  ContainerNode* const container_node_;
+  OpacityNode* const opacity_node_;
+
+  RetainedNode* parent_ = nullptr;
+  std::vector<RetainedNode*> children_;
+
+  // The properties last set, which start out as scenic's defaults.
+  std::array<float, 3> translation_ = {{0.f, 0.f, 0.f}};
+  std::array<float, 3> scale_ = {{1.f, 1.f, 1.f}};
+  std::array<float, 4> rotation_ = {{0.f, 0.f, 0.f, 1.f}};
+  std::array<float, 3> anchor_ = {{0.f, 0.f, 0.f}};
+  uint32_t tag_value_ = 0u;
+  fuchsia::ui::gfx::HitTestBehavior hit_test_behavior_ =
+      fuchsia::ui::gfx::HitTestBehavior::kDefault;
+  uint32_t shape_id_ = 0u;
+  uint32_t material_id_ = 0u;
+  float opacity_ = 1.f;
+};
+
+}  // namespace scenic
+
+#endif  // LIB_UI_SCENIC_CPP_RETAINED_NODE_H_
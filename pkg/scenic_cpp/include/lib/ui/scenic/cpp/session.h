@@ -9,15 +9,23 @@
 #include <fuchsia/ui/gfx/cpp/fidl.h>
 #include <fuchsia/ui/input/cpp/fidl.h>
 #include <fuchsia/ui/scenic/cpp/fidl.h>
+#include <lib/fidl/cpp/encoder.h>
 #include <lib/fit/function.h>
 #include <lib/zx/event.h>
 
+#include <array>
+#include <deque>
+#include <map>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "lib/fidl/cpp/binding.h"
 
 namespace scenic {
 
+class CommandRecorder;
+
 // Connect to Scenic and establish a new Session, as well as an InterfaceRequest
 // for a SessionListener that can be hooked up as desired.
 using SessionPtrAndListenerRequest =
@@ -40,6 +48,16 @@ class Session : private fuchsia::ui::scenic::SessionListener {
   using HitTestCallback =
       fit::function<void(fidl::VectorPtr<fuchsia::ui::gfx::Hit> hits)>;
 
+  // Provides the hits of each of several rays, in the order of the rays.
+  using MultiHitTestCallback = fit::function<void(
+      std::vector<fidl::VectorPtr<fuchsia::ui::gfx::Hit>> hits)>;
+
+  // A ray to hit test.
+  struct HitTestRay {
+    float origin[3];
+    float direction[3];
+  };
+
   // Called when session events are received.
   using EventHandler =
       fit::function<void(fidl::VectorPtr<fuchsia::ui::scenic::Event>)>;
@@ -75,19 +93,51 @@ class Session : private fuchsia::ui::scenic::SessionListener {
   // Gets a pointer to the underlying session interface.
   fuchsia::ui::scenic::Session* session() { return session_.get(); }
 
-  // Allocates a new unique resource id.
+  // Allocates a resource id that no live resource of the session uses.
+  //
+  // Ids are reused, lowest first, once the |Present()| that follows their
+  // release has been applied, so that the ids in use stay dense.
   uint32_t AllocResourceId();
 
   // Enqueues an operation to release a resource.
+  // Its id becomes free for reuse after the next |Present()| is applied.
   void ReleaseResource(uint32_t resource_id);
 
   // Enqueues an operation.
   // The session will queue operations locally to batch submission of operations
-  // until |Flush()| or |Present()| is called.
+  // until |Flush()| or |Present()| is called. Each operation is encoded as it
+  // is enqueued, and operations are flushed early when the next one would not
+  // fit in the same message, so each message carries as many operations as the
+  // channel's byte and handle limits allow.
   void Enqueue(fuchsia::ui::scenic::Command command);
   void Enqueue(fuchsia::ui::gfx::Command command);
   void Enqueue(fuchsia::ui::input::Command command);
 
+  // Enqueues the operations recorded by each of |recorders|, in the order of
+  // |recorders| and, within each, in the order they were recorded, after the
+  // operations already queued, and empties the recorders.
+  //
+  // The operations are batched, flushed early and coalesced as if they had
+  // been enqueued one at a time. The ids the recorders have allocated from
+  // their blocks are used up and their blocks are refilled, and the ids they
+  // have released become free for reuse after the next |Present()| is applied.
+  //
+  // Must be called on the session's thread, once every recorder is done
+  // recording for now. The recorders may then record again.
+  void Submit(const std::vector<CommandRecorder*>& recorders);
+
+  // Sets whether the session drops property-setting operations, such as
+  // |SetTranslationCmd|, that a later operation setting the same property of
+  // the same resource makes redundant before they are flushed.
+  //
+  // The later operation takes the place of the earlier one. Only runs of
+  // property-setting operations are coalesced: any other operation, such as
+  // creating, releasing or adding a child to a resource, ends the run, so that
+  // no operation moves ahead of one that might depend on it. Off by default.
+  void set_coalesce_commands(bool coalesce_commands) {
+    coalesce_commands_ = coalesce_commands;
+  }
+
   // Registers an acquire fence to be submitted during the subsequent call to
   // |Present()|.
   void EnqueueAcquireFence(zx::event fence);
@@ -97,6 +147,9 @@ class Session : private fuchsia::ui::scenic::SessionListener {
   void EnqueueReleaseFence(zx::event fence);
 
   // Flushes queued operations to the session.
+  //
+  // The operations are written straight to the session's channel, already
+  // encoded, rather than through the |fuchsia::ui::scenic::SessionPtr|.
   void Flush();
 
   // Presents all previously enqueued operations.
@@ -114,6 +167,34 @@ class Session : private fuchsia::ui::scenic::SessionListener {
       const float ray_origin[3], const float ray_direction[3],
       fuchsia::ui::scenic::Session::HitTestDeviceRayCallback callback);
 
+  // Performs hit tests along each of |rays|, which are in the coordinate
+  // system of the specified node, and delivers all the results together.
+  //
+  // The tests are pipelined rather than made one round trip at a time.
+  // If |set_cache_hit_tests()| enabled it, results are cached; see there.
+  void HitTest(uint32_t node_id, const std::vector<HitTestRay>& rays,
+               MultiHitTestCallback callback);
+
+  // Whether |HitTest()| with several rays caches its results until the next
+  // |Present()| is sent or applied, so that repeating a test in the meantime,
+  // for example for several gestures looking at the same input event, is
+  // answered without asking scenic. Off by default.
+  //
+  // Only this session's presents invalidate the cache. A node whose subtree
+  // embeds views of other sessions can change without this session
+  // presenting, and its cached hits are then stale, so only enable this for
+  // nodes whose subtrees this session owns entirely. Disabling it discards
+  // the cached results.
+  void set_cache_hit_tests(bool cache_hit_tests);
+
+  // Performs hit tests along each of |rays| into the engine's first
+  // compositor, and delivers all the results together.
+  //
+  // The tests are pipelined. Their results are not cached, since other
+  // sessions' content may change at any time.
+  void HitTestDeviceRays(const std::vector<HitTestRay>& rays,
+                         MultiHitTestCallback callback);
+
   // Unbinds the internal SessionPtr; this allows moving this across threads.
   void Unbind();
 
@@ -124,21 +205,78 @@ class Session : private fuchsia::ui::scenic::SessionListener {
   void SetDebugName(const std::string& debug_name);
 
  private:
+  friend class CommandRecorder;
+
+  // Encodes |command| by itself with |encoder|: its inline part first, then
+  // its out-of-line objects in the order they take in a message.
+  static fidl::Message EncodeCommand(fidl::Encoder* encoder,
+                                     fuchsia::ui::scenic::Command* command);
+
+  // Returns a key for the property of a resource that |command| sets, if a
+  // later command setting the same property makes it redundant, or zero if
+  // not.
+  static uint64_t PropertyKey(const fuchsia::ui::scenic::Command& command);
+
+  // Enqueues a command encoded by |EncodeCommand()|, whose handles the session
+  // takes. |property_key| is the command's |PropertyKey()|.
+  void EnqueueEncoded(const uint8_t* bytes, size_t num_bytes,
+                      const zx_handle_t* handles, size_t num_handles,
+                      uint64_t property_key, bool is_input);
+
+  // Allocates ids until |ids| holds |count| of them, for a recorder's block.
+  void ReserveResourceIds(size_t count, std::vector<uint32_t>* ids);
+
+  // Frees the ids of a recorder's block that were never used.
+  void ReturnResourceIds(const std::vector<uint32_t>& ids);
+
   // |fuchsia::ui::scenic::SessionListener|
   void OnScenicError(fidl::StringPtr error) override;
   void OnScenicEvent(
       fidl::VectorPtr<fuchsia::ui::scenic::Event> events) override;
 
+  // Identifies a ray tested against a node, by the node id and the bits of
+  // the ray's coordinates.
+  using HitTestKey = std::array<uint32_t, 7>;
+  static HitTestKey MakeHitTestKey(uint32_t node_id, const HitTestRay& ray);
+
+  // Discards the cached hit test results.
+  void InvalidateHitTests();
+
   fuchsia::ui::scenic::SessionPtr session_;
   // |session_handle_| is stored only when |session_| is unbound/invalid.
   fidl::InterfaceHandle<fuchsia::ui::scenic::Session> session_handle_;
   uint32_t next_resource_id_ = 1u;
   uint32_t resource_count_ = 0u;
-
-  fidl::VectorPtr<fuchsia::ui::scenic::Command> commands_;
+  // Ids that can be reused, as a min-heap.
+  std::vector<uint32_t> free_resource_ids_;
+  // Ids released since the last |Present()|.
+  std::vector<uint32_t> released_resource_ids_;
+  // Ids released before each |Present()| that has not yet been applied,
+  // oldest first.
+  std::deque<std::vector<uint32_t>> presented_resource_ids_;
+
+  // The queued commands, encoded: room for the message headers followed by
+  // the inline part of each command, the out-of-line objects of each, and
+  // their handles, which the session owns until they are written.
+  uint32_t command_count_ = 0u;
+  std::vector<uint8_t> command_bytes_;
+  std::vector<uint8_t> command_out_of_line_bytes_;
+  std::vector<zx_handle_t> command_handles_;
+  // While coalescing, the index of the queued command that sets each property
+  // in the current run of property-setting commands, by |PropertyKey()|.
+  bool coalesce_commands_ = false;
+  std::unordered_map<uint64_t, uint32_t> property_commands_;
+  // Encodes one command at a time; kept to reuse its storage.
+  fidl::Encoder command_encoder_{fidl::Encoder::NO_HEADER};
   fidl::VectorPtr<zx::event> acquire_fences_;
   fidl::VectorPtr<zx::event> release_fences_;
 
+  // Cached hit test results, valid for |hit_test_generation_|, which changes
+  // whenever this session's part of the scene may have.
+  bool cache_hit_tests_ = false;
+  std::map<HitTestKey, fidl::VectorPtr<fuchsia::ui::gfx::Hit>> hit_tests_;
+  uint64_t hit_test_generation_ = 0u;
+
   EventHandler event_handler_;
   fidl::Binding<fuchsia::ui::scenic::SessionListener> session_listener_binding_;
 };
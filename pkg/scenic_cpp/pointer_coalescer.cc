@@ -0,0 +1,77 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ui/scenic/cpp/pointer_coalescer.h"
+
+#include <zircon/assert.h>
+
+#include <utility>
+
+namespace scenic {
+namespace {
+
+using fuchsia::ui::input::PointerEvent;
+using fuchsia::ui::input::PointerEventPhase;
+
+bool IsMove(const PointerEvent& event) {
+  return event.phase == PointerEventPhase::MOVE ||
+         event.phase == PointerEventPhase::HOVER;
+}
+
+}  // namespace
+
+PointerCoalescer::PointerCoalescer(FrameScheduler* scheduler)
+    : scheduler_(scheduler) {
+  ZX_DEBUG_ASSERT(scheduler_);
+}
+
+PointerCoalescer::~PointerCoalescer() = default;
+
+void PointerCoalescer::Add(PointerEvent event) {
+  if (IsMove(event)) {
+    Entry* last = FindLast(event);
+    if (last && last->event.phase == event.phase &&
+        last->event.buttons == event.buttons) {
+      if (keep_history_)
+        last->history.push_back(std::move(last->event));
+      last->event = std::move(event);
+      ++merged_events_;
+      return;
+    }
+  }
+
+  if (count_ == entries_.size())
+    entries_.emplace_back();
+  Entry& entry = entries_[count_++];
+  entry.event = std::move(event);
+  entry.history.clear();
+  if (count_ == 1u)
+    scheduler_->RequestFrame();
+}
+
+void PointerCoalescer::Flush(const Handler& handler) {
+  // Swap the queue out first, so that events added by |handler| start the
+  // next one.
+  const size_t count = count_;
+  count_ = 0u;
+  entries_.swap(flushing_);
+  for (size_t i = 0u; i < count; ++i)
+    handler(flushing_[i].event, flushing_[i].history);
+  if (count_ == 0u)
+    entries_.swap(flushing_);
+}
+
+PointerCoalescer::Entry* PointerCoalescer::FindLast(const PointerEvent& event) {
+  // Few pointers are active at once, so the last entry of a pointer is
+  // near the end of the queue.
+  for (size_t i = count_; i > 0u; --i) {
+    Entry& entry = entries_[i - 1u];
+    if (entry.event.device_id == event.device_id &&
+        entry.event.pointer_id == event.pointer_id)
+      return &entry;
+  }
+  return nullptr;
+}
+
+}  // namespace scenic
@@ -0,0 +1,175 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ui/scenic/cpp/retained_node.h"
+
+#include <zircon/assert.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace scenic {
+
+RetainedNode::RetainedNode(Node* node)
+    : RetainedNode(node, nullptr, nullptr, nullptr) {}
+
+RetainedNode::RetainedNode(ShapeNode* node)
+    : RetainedNode(node, node, nullptr, nullptr) {}
+
+RetainedNode::RetainedNode(ContainerNode* node)
+    : RetainedNode(node, nullptr, node, nullptr) {}
+
+RetainedNode::RetainedNode(OpacityNode* node)
+    : RetainedNode(node, nullptr, node, node) {}
+
+RetainedNode::RetainedNode(Node* node, ShapeNode* shape_node,
+                           ContainerNode* container_node,
+                           OpacityNode* opacity_node)
+    : node_(node),
+      shape_node_(shape_node),
+      container_node_(container_node),
+      opacity_node_(opacity_node) {
+  ZX_DEBUG_ASSERT(node_);
+}
+
+RetainedNode::~RetainedNode() {
+  if (parent_)
+    parent_->RemoveChild(this);
+  for (RetainedNode* child : children_)
+    child->parent_ = nullptr;
+}
+
+void RetainedNode::SetTranslation(float tx, float ty, float tz) {
+  const std::array<float, 3> translation = {{tx, ty, tz}};
+  if (translation == translation_)
+    return;
+  translation_ = translation;
+  node_->SetTranslation(translation_.data());
+}
+
+void RetainedNode::SetScale(float sx, float sy, float sz) {
+  const std::array<float, 3> scale = {{sx, sy, sz}};
+  if (scale == scale_)
+    return;
+  scale_ = scale;
+  node_->SetScale(scale_.data());
+}
+
+void RetainedNode::SetRotation(float qi, float qj, float qk, float qw) {
+  const std::array<float, 4> rotation = {{qi, qj, qk, qw}};
+  if (rotation == rotation_)
+    return;
+  rotation_ = rotation;
+  node_->SetRotation(rotation_.data());
+}
+
+void RetainedNode::SetAnchor(float ax, float ay, float az) {
+  const std::array<float, 3> anchor = {{ax, ay, az}};
+  if (anchor == anchor_)
+    return;
+  anchor_ = anchor;
+  node_->SetAnchor(anchor_.data());
+}
+
+void RetainedNode::SetTag(uint32_t tag_value) {
+  if (tag_value == tag_value_)
+    return;
+  tag_value_ = tag_value;
+  node_->SetTag(tag_value_);
+}
+
+void RetainedNode::SetHitTestBehavior(
+    fuchsia::ui::gfx::HitTestBehavior hit_test_behavior) {
+  if (hit_test_behavior == hit_test_behavior_)
+    return;
+  hit_test_behavior_ = hit_test_behavior;
+  node_->SetHitTestBehavior(hit_test_behavior_);
+}
+
+void RetainedNode::SetShape(uint32_t shape_id) {
+  ZX_DEBUG_ASSERT(shape_node_);
+  if (shape_id == shape_id_)
+    return;
+  shape_id_ = shape_id;
+  shape_node_->SetShape(shape_id_);
+}
+
+void RetainedNode::SetMaterial(uint32_t material_id) {
+  ZX_DEBUG_ASSERT(shape_node_);
+  if (material_id == material_id_)
+    return;
+  material_id_ = material_id;
+  shape_node_->SetMaterial(material_id_);
+}
+
+void RetainedNode::SetOpacity(float opacity) {
+  ZX_DEBUG_ASSERT(opacity_node_);
+  if (opacity == opacity_)
+    return;
+  opacity_ = opacity;
+  opacity_node_->SetOpacity(opacity_);
+}
+
+void RetainedNode::SetChildren(const std::vector<RetainedNode*>& children) {
+  ZX_DEBUG_ASSERT(container_node_);
+  if (children == children_)
+    return;
+
+  const std::unordered_set<RetainedNode*> new_children(children.begin(),
+                                                       children.end());
+  ZX_DEBUG_ASSERT(new_children.size() == children.size());
+
+  // The children that stay keep their relative order, so they can stay
+  // attached for as long as that matches the new order.
+  size_t kept = 0u;
+  for (RetainedNode* child : children_) {
+    if (new_children.count(child) == 0u)
+      continue;
+    if (child != children[kept])
+      break;
+    kept++;
+  }
+
+  // Detach the old children that leave or must move.
+  const std::unordered_set<RetainedNode*> kept_children(
+      children.begin(), children.begin() + kept);
+  for (RetainedNode* child : children_) {
+    if (kept_children.count(child) == 0u) {
+      child->node_->Detach();
+      child->parent_ = nullptr;
+    }
+  }
+
+  // Add the new children and those that moved, after the ones kept.
+  for (size_t i = kept; i < children.size(); i++) {
+    RetainedNode* child = children[i];
+    ZX_DEBUG_ASSERT(child != this);
+    ZX_DEBUG_ASSERT(child->node_->session() == node_->session());
+    // Scenic takes the child from its old parent, so the old parent only
+    // needs to forget it.
+    if (child->parent_)
+      child->parent_->RemoveChild(child);
+    container_node_->AddChild(child->node_->id());
+    child->parent_ = this;
+  }
+
+  children_ = children;
+}
+
+void RetainedNode::Detach() {
+  if (!parent_)
+    return;
+  parent_->RemoveChild(this);
+  parent_ = nullptr;
+  node_->Detach();
+}
+
+void RetainedNode::RemoveChild(RetainedNode* child) {
+  auto it = std::find(children_.begin(), children_.end(), child);
+  ZX_DEBUG_ASSERT(it != children_.end());
+  children_.erase(it);
+  child->parent_ = nullptr;
+}
+
+}  // namespace scenic
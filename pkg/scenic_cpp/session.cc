@@ -5,16 +5,42 @@
 #include "lib/ui/scenic/cpp/session.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <trace/event.h>
 #include <zircon/assert.h>
+#include <zircon/syscalls.h>
 
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+#include "lib/fidl/cpp/clone.h"
+#include "lib/fidl/cpp/coding_traits.h"
+#include "lib/ui/scenic/cpp/command_recorder.h"
 #include "lib/ui/scenic/cpp/commands.h"
 
 namespace scenic {
+namespace {
+
+// An |Enqueue()| message starts with the message header and the header of its
+// vector of commands; the commands take the rest.
+struct EnqueueMessageHeader {
+  fidl_message_header_t header;
+  fidl_vector_t commands;
+};
+constexpr size_t kEnqueueMaxBytes =
+    ZX_CHANNEL_MAX_MSG_BYTES - sizeof(EnqueueMessageHeader);
+constexpr size_t kEnqueueMaxHandles = ZX_CHANNEL_MAX_MSG_HANDLES;
+
+// The ordinal of |fuchsia.ui.scenic.Session/Enqueue|, from session.fidl.
+constexpr uint32_t kEnqueueOrdinal = 1u;
 
-constexpr size_t kCommandsPerMessage =
-    (ZX_CHANNEL_MAX_MSG_BYTES - sizeof(fidl_message_header_t) -
-     sizeof(fidl_vector_t)) /
-    sizeof(fuchsia::ui::scenic::Command);
+constexpr size_t kCommandInlineSize =
+    fidl::CodingTraits<fuchsia::ui::scenic::Command>::encoded_size;
+static_assert(kCommandInlineSize % FIDL_ALIGNMENT == 0,
+              "Encoded commands must not need padding between them");
+
+}  // namespace
 
 SessionPtrAndListenerRequest CreateScenicSessionPtrAndListenerRequest(
     fuchsia::ui::scenic::Scenic* scenic) {
@@ -51,10 +77,20 @@ Session::~Session() {
   ZX_DEBUG_ASSERT_MSG(resource_count_ == 0,
                       "Some resources outlived the session: %u",
                       resource_count_);
+  zx_handle_close_many(command_handles_.data(), command_handles_.size());
 }
 
 uint32_t Session::AllocResourceId() {
-  uint32_t resource_id = next_resource_id_++;
+  uint32_t resource_id;
+  if (!free_resource_ids_.empty()) {
+    // Reuse the lowest free id, which keeps the ids in use dense.
+    std::pop_heap(free_resource_ids_.begin(), free_resource_ids_.end(),
+                  std::greater<uint32_t>());
+    resource_id = free_resource_ids_.back();
+    free_resource_ids_.pop_back();
+  } else {
+    resource_id = next_resource_id_++;
+  }
   ZX_DEBUG_ASSERT(resource_id);
   resource_count_++;
   return resource_id;
@@ -62,6 +98,7 @@ uint32_t Session::AllocResourceId() {
 
 void Session::ReleaseResource(uint32_t resource_id) {
   resource_count_--;
+  released_resource_ids_.push_back(resource_id);
   Enqueue(NewReleaseResourceCmd(resource_id));
 }
 
@@ -73,12 +110,121 @@ void Session::Enqueue(fuchsia::ui::input::Command command) {
   Enqueue(NewCommand(std::move(command)));
 }
 
+fidl::Message Session::EncodeCommand(fidl::Encoder* encoder,
+                                     fuchsia::ui::scenic::Command* command) {
+  encoder->Reset(fidl::Encoder::NO_HEADER);
+  encoder->Alloc(kCommandInlineSize);
+  fidl::Encode(encoder, command, 0u);
+  return encoder->GetMessage();
+}
+
+uint64_t Session::PropertyKey(const fuchsia::ui::scenic::Command& command) {
+  if (!command.is_gfx())
+    return 0u;
+  const fuchsia::ui::gfx::Command& gfx = command.gfx();
+  uint32_t id;
+  switch (gfx.Which()) {
+    case fuchsia::ui::gfx::Command::Tag::kSetTranslation:
+      id = gfx.set_translation().id;
+      break;
+    case fuchsia::ui::gfx::Command::Tag::kSetScale:
+      id = gfx.set_scale().id;
+      break;
+    case fuchsia::ui::gfx::Command::Tag::kSetRotation:
+      id = gfx.set_rotation().id;
+      break;
+    case fuchsia::ui::gfx::Command::Tag::kSetAnchor:
+      id = gfx.set_anchor().id;
+      break;
+    case fuchsia::ui::gfx::Command::Tag::kSetSize:
+      id = gfx.set_size().id;
+      break;
+    case fuchsia::ui::gfx::Command::Tag::kSetOpacity:
+      id = gfx.set_opacity().node_id;
+      break;
+    case fuchsia::ui::gfx::Command::Tag::kSetColor:
+      id = gfx.set_color().material_id;
+      break;
+    case fuchsia::ui::gfx::Command::Tag::kSetCameraTransform:
+      id = gfx.set_camera_transform().camera_id;
+      break;
+    case fuchsia::ui::gfx::Command::Tag::kSetLightColor:
+      id = gfx.set_light_color().light_id;
+      break;
+    case fuchsia::ui::gfx::Command::Tag::kSetLightDirection:
+      id = gfx.set_light_direction().light_id;
+      break;
+    default:
+      return 0u;
+  }
+  return (static_cast<uint64_t>(gfx.Which()) + 1u) << 32 | id;
+}
+
 void Session::Enqueue(fuchsia::ui::scenic::Command command) {
-  commands_.push_back(std::move(command));
-  if (commands_->size() >= kCommandsPerMessage ||
-      command.Which() == fuchsia::ui::scenic::Command::Tag::kInput) {
+  const bool is_input =
+      command.Which() == fuchsia::ui::scenic::Command::Tag::kInput;
+  const uint64_t property_key = coalesce_commands_ ? PropertyKey(command) : 0u;
+  fidl::Message encoded = EncodeCommand(&command_encoder_, &command);
+  EnqueueEncoded(encoded.bytes().data(), encoded.bytes().actual(),
+                 encoded.handles().data(), encoded.handles().actual(),
+                 property_key, is_input);
+  encoded.ClearHandlesUnsafe();
+}
+
+void Session::EnqueueEncoded(const uint8_t* bytes, size_t num_bytes,
+                             const zx_handle_t* handles, size_t num_handles,
+                             uint64_t property_key, bool is_input) {
+  ZX_DEBUG_ASSERT_MSG(
+      num_bytes <= kEnqueueMaxBytes && num_handles <= kEnqueueMaxHandles,
+      "Command does not fit in a message: %zu bytes, %zu handles", num_bytes,
+      num_handles);
+  if (!coalesce_commands_)
+    property_key = 0u;
+
+  // A command that sets the same property as one already queued, with only
+  // other property sets in between, replaces it in place.
+  if (property_key && num_handles == 0u && num_bytes == kCommandInlineSize) {
+    auto it = property_commands_.find(property_key);
+    if (it != property_commands_.end()) {
+      memcpy(command_bytes_.data() + sizeof(EnqueueMessageHeader) +
+                 it->second * kCommandInlineSize,
+             bytes, kCommandInlineSize);
+      return;
+    }
+  } else {
+    // Any other command may depend on the properties set so far, so later
+    // commands must not be moved ahead of it.
+    property_commands_.clear();
+    property_key = 0u;
+  }
+
+  // Flush first if the command would not fit in the same message as the
+  // commands already queued.
+  if (command_count_ * kCommandInlineSize + command_out_of_line_bytes_.size() +
+              num_bytes >
+          kEnqueueMaxBytes ||
+      command_handles_.size() + num_handles > kEnqueueMaxHandles) {
     Flush();
   }
+
+  // The inline parts of the commands make up the body of the vector, which
+  // follows the headers, and their out-of-line objects follow it in the same
+  // order.
+  if (command_bytes_.empty())
+    command_bytes_.resize(sizeof(EnqueueMessageHeader));
+  command_bytes_.insert(command_bytes_.end(), bytes,
+                        bytes + kCommandInlineSize);
+  command_out_of_line_bytes_.insert(command_out_of_line_bytes_.end(),
+                                    bytes + kCommandInlineSize,
+                                    bytes + num_bytes);
+  command_handles_.insert(command_handles_.end(), handles,
+                          handles + num_handles);
+  if (property_key)
+    property_commands_.emplace(property_key, command_count_);
+  ++command_count_;
+
+  if (is_input)
+    Flush();
 }
 
 void Session::EnqueueAcquireFence(zx::event fence) {
@@ -93,15 +239,40 @@ void Session::EnqueueReleaseFence(zx::event fence) {
 
 void Session::Flush() {
   ZX_DEBUG_ASSERT(session_);
-  if (!commands_->empty()) {
-    ZX_DEBUG_ASSERT(static_cast<bool>(commands_));
-    session_->Enqueue(std::move(commands_));
-
-    // After being moved, |commands_| is in a "valid but unspecified state";
-    // see http://en.cppreference.com/w/cpp/utility/move.  Calling reset() makes
-    // it safe to continue using.
-    commands_.reset();
+  if (command_count_ == 0u)
+    return;
+
+  // Complete the message: fill in the headers and append the out-of-line
+  // objects after the vector.
+  EnqueueMessageHeader header = {};
+  header.header.ordinal = kEnqueueOrdinal;
+  header.commands.count = command_count_;
+  header.commands.data = reinterpret_cast<void*>(FIDL_ALLOC_PRESENT);
+  memcpy(command_bytes_.data(), &header, sizeof(header));
+  command_bytes_.insert(command_bytes_.end(),
+                        command_out_of_line_bytes_.begin(),
+                        command_out_of_line_bytes_.end());
+  TRACE_COUNTER("gfx", "scenic::Session::Flush",
+                reinterpret_cast<uintptr_t>(this), "commands", command_count_,
+                "bytes", command_bytes_.size(), "handles",
+                command_handles_.size());
+
+  // The write consumes the handles, even if it fails.
+  zx_status_t status = session_.channel().write(
+      0u, command_bytes_.data(), static_cast<uint32_t>(command_bytes_.size()),
+      command_handles_.data(), static_cast<uint32_t>(command_handles_.size()));
+  if (status != ZX_OK) {
+    // TODO(SCN-903): replace fprintf with SDK-approved logging mechanism.
+    fprintf(stderr, "Session failed to enqueue %u commands: %d\n",
+            command_count_, status);
   }
+
+  // Clearing keeps the buffers' storage for the commands of the next message.
+  command_bytes_.clear();
+  command_out_of_line_bytes_.clear();
+  command_handles_.clear();
+  command_count_ = 0u;
+  property_commands_.clear();
 }
 
 void Session::Present(uint64_t presentation_time, PresentCallback callback) {
@@ -112,8 +283,69 @@ void Session::Present(uint64_t presentation_time, PresentCallback callback) {
     acquire_fences_.resize(0u);
   if (release_fences_.is_null())
     release_fences_.resize(0u);
-  session_->Present(presentation_time, std::move(acquire_fences_),
-                    std::move(release_fences_), std::move(callback));
+  // The ids released since the last present can be reused once this present
+  // has been applied, and so their releases with it.
+  presented_resource_ids_.push_back(std::move(released_resource_ids_));
+  released_resource_ids_.clear();
+  InvalidateHitTests();
+  session_->Present(
+      presentation_time, std::move(acquire_fences_),
+      std::move(release_fences_),
+      [this, callback = std::move(callback)](
+          fuchsia::images::PresentationInfo info) {
+        InvalidateHitTests();
+        // Presents are applied in order.
+        std::vector<uint32_t>& ids = presented_resource_ids_.front();
+        for (uint32_t id : ids) {
+          free_resource_ids_.push_back(id);
+          std::push_heap(free_resource_ids_.begin(), free_resource_ids_.end(),
+                         std::greater<uint32_t>());
+        }
+        presented_resource_ids_.pop_front();
+        if (callback)
+          callback(std::move(info));
+      });
+}
+
+void Session::Submit(const std::vector<CommandRecorder*>& recorders) {
+  TRACE_DURATION("gfx", "scenic::Session::Submit", "recorders",
+                 recorders.size());
+  for (CommandRecorder* recorder : recorders) {
+    const uint8_t* bytes = recorder->bytes_.data();
+    const zx_handle_t* handles = recorder->handles_.data();
+    for (const CommandRecorder::EncodedCommand& command :
+         recorder->commands_) {
+      EnqueueEncoded(bytes, command.num_bytes, handles, command.num_handles,
+                     command.property_key, command.is_input);
+      bytes += command.num_bytes;
+      handles += command.num_handles;
+    }
+    recorder->commands_.clear();
+    recorder->bytes_.clear();
+    recorder->handles_.clear();
+
+    resource_count_ -= recorder->released_ids_.size();
+    released_resource_ids_.insert(released_resource_ids_.end(),
+                                  recorder->released_ids_.begin(),
+                                  recorder->released_ids_.end());
+    recorder->released_ids_.clear();
+    recorder->RefillIds();
+  }
+}
+
+void Session::ReserveResourceIds(size_t count, std::vector<uint32_t>* ids) {
+  while (ids->size() < count)
+    ids->push_back(AllocResourceId());
+}
+
+void Session::ReturnResourceIds(const std::vector<uint32_t>& ids) {
+  // The ids were never used, so they can be reused right away.
+  resource_count_ -= ids.size();
+  for (uint32_t id : ids) {
+    free_resource_ids_.push_back(id);
+    std::push_heap(free_resource_ids_.begin(), free_resource_ids_.end(),
+                   std::greater<uint32_t>());
+  }
 }
 
 void Session::HitTest(uint32_t node_id, const float ray_origin[3],
@@ -133,6 +365,115 @@ void Session::HitTest(uint32_t node_id, const float ray_origin[3],
                     std::move(ray_direction_vec), std::move(callback));
 }
 
+namespace {
+
+fuchsia::ui::gfx::vec3 ToVec3(const float value[3]) {
+  fuchsia::ui::gfx::vec3 vec;
+  vec.x = value[0];
+  vec.y = value[1];
+  vec.z = value[2];
+  return vec;
+}
+
+// Gathers the results of the hit tests of a batch as they arrive.
+struct HitTestBatch {
+  std::vector<fidl::VectorPtr<fuchsia::ui::gfx::Hit>> hits;
+  size_t remaining;
+  Session::MultiHitTestCallback callback;
+
+  void Deliver(size_t index, fidl::VectorPtr<fuchsia::ui::gfx::Hit> result) {
+    hits[index] = std::move(result);
+    Release();
+  }
+
+  void Release() {
+    if (--remaining == 0u)
+      callback(std::move(hits));
+  }
+};
+
+}  // namespace
+
+void Session::HitTest(uint32_t node_id, const std::vector<HitTestRay>& rays,
+                      MultiHitTestCallback callback) {
+  ZX_DEBUG_ASSERT(session_);
+  auto batch = std::make_shared<HitTestBatch>();
+  batch->hits.resize(rays.size());
+  batch->remaining = rays.size() + 1u;
+  batch->callback = std::move(callback);
+
+  for (size_t i = 0u; i < rays.size(); i++) {
+    if (!cache_hit_tests_) {
+      session_->HitTest(
+          node_id, ToVec3(rays[i].origin), ToVec3(rays[i].direction),
+          [batch, i](fidl::VectorPtr<fuchsia::ui::gfx::Hit> hits) {
+            batch->Deliver(i, std::move(hits));
+          });
+      continue;
+    }
+    HitTestKey key = MakeHitTestKey(node_id, rays[i]);
+    auto it = hit_tests_.find(key);
+    if (it != hit_tests_.end()) {
+      fidl::VectorPtr<fuchsia::ui::gfx::Hit> hits;
+      fidl::Clone(it->second, &hits);
+      batch->Deliver(i, std::move(hits));
+      continue;
+    }
+    session_->HitTest(
+        node_id, ToVec3(rays[i].origin), ToVec3(rays[i].direction),
+        [this, batch, i, key, generation = hit_test_generation_](
+            fidl::VectorPtr<fuchsia::ui::gfx::Hit> hits) {
+          if (generation == hit_test_generation_)
+            fidl::Clone(hits, &hit_tests_[key]);
+          batch->Deliver(i, std::move(hits));
+        });
+  }
+  // Counted as one more result so that the callback cannot run before every
+  // test has been issued.
+  batch->Release();
+}
+
+void Session::HitTestDeviceRays(const std::vector<HitTestRay>& rays,
+                                MultiHitTestCallback callback) {
+  ZX_DEBUG_ASSERT(session_);
+  auto batch = std::make_shared<HitTestBatch>();
+  batch->hits.resize(rays.size());
+  batch->remaining = rays.size() + 1u;
+  batch->callback = std::move(callback);
+
+  for (size_t i = 0u; i < rays.size(); i++) {
+    session_->HitTestDeviceRay(
+        ToVec3(rays[i].origin), ToVec3(rays[i].direction),
+        [batch, i](fidl::VectorPtr<fuchsia::ui::gfx::Hit> hits) {
+          batch->Deliver(i, std::move(hits));
+        });
+  }
+  batch->Release();
+}
+
+Session::HitTestKey Session::MakeHitTestKey(uint32_t node_id,
+                                            const HitTestRay& ray) {
+  HitTestKey key;
+  key[0] = node_id;
+  static_assert(sizeof(ray.origin) + sizeof(ray.direction) ==
+                    sizeof(uint32_t) * 6,
+                "");
+  memcpy(&key[1], ray.origin, sizeof(ray.origin));
+  memcpy(&key[4], ray.direction, sizeof(ray.direction));
+  return key;
+}
+
+void Session::set_cache_hit_tests(bool cache_hit_tests) {
+  if (!cache_hit_tests)
+    InvalidateHitTests();
+  cache_hit_tests_ = cache_hit_tests;
+}
+
+void Session::InvalidateHitTests() {
+  ++hit_test_generation_;
+  hit_tests_.clear();
+}
+
 void Session::HitTestDeviceRay(
     const float ray_origin[3], const float ray_direction[3],
     fuchsia::ui::scenic::Session::HitTestDeviceRayCallback callback) {
@@ -0,0 +1,143 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/stats/cpp/counter_sampler.h"
+
+#include <lib/async/time.h>
+#include <trace-engine/context.h>
+#include <trace-engine/instrumentation.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace stats {
+namespace {
+
+// The most arguments a trace record holds.
+constexpr size_t kMaxArgsPerRecord = 15u;
+
+// Polls may run this fraction of a period late, so that their timers can be
+// coalesced with other work.
+constexpr int64_t kSlackDivisor = 8;
+
+}  // namespace
+
+CounterSampler::CounterSampler(async_dispatcher_t* dispatcher, size_t count,
+                               const char* const* names)
+    : async_task_t{{ASYNC_STATE_INIT}, &CounterSampler::CallHandler,
+                   ZX_TIME_INFINITE, 0},
+      dispatcher_(dispatcher),
+      count_(count),
+      names_(names),
+      storage_(new uint64_t[3u * count]()),
+      current_(storage_.get()),
+      previous_(storage_.get() + count),
+      deltas_(storage_.get() + 2u * count) {
+  ZX_DEBUG_ASSERT(dispatcher_);
+  ZX_DEBUG_ASSERT(names_ || count_ == 0u);
+}
+
+CounterSampler::~CounterSampler() { Stop(); }
+
+zx_status_t CounterSampler::Start(zx::duration period) {
+  ZX_DEBUG_ASSERT(period > zx::duration(0));
+  Stop();
+  period_ = period;
+  deadline = async_now(dispatcher_);
+  slack = (period_ / kSlackDivisor).get();
+  zx_status_t status = async_post_task(dispatcher_, this);
+  if (status != ZX_OK)
+    return status;
+  task_posted_ = true;
+  return ZX_OK;
+}
+
+void CounterSampler::Stop() {
+  if (!task_posted_)
+    return;
+  async_cancel_task(dispatcher_, this);
+  task_posted_ = false;
+}
+
+void CounterSampler::CallHandler(async_dispatcher_t* dispatcher,
+                                 async_task_t* task, zx_status_t status) {
+  auto self = static_cast<CounterSampler*>(task);
+  self->task_posted_ = false;
+  if (status == ZX_OK)
+    self->OnPoll();
+}
+
+void CounterSampler::OnPoll() {
+  // Keep to the period rather than drifting by the time each poll runs
+  // late, unless the dispatcher fell a whole period behind.
+  zx_time_t now = async_now(dispatcher_);
+  deadline += period_.get();
+  if (deadline <= now)
+    deadline = now + period_.get();
+  if (async_post_task(dispatcher_, this) == ZX_OK)
+    task_posted_ = true;
+
+  if (fetch_pending_ || !fetch_handler_)
+    return;
+  fetch_pending_ = true;
+  fetch_handler_();
+}
+
+void CounterSampler::Record(const uint64_t* values) {
+  std::copy(values, values + count_, next_values());
+  Commit();
+}
+
+void CounterSampler::Commit() {
+  fetch_pending_ = false;
+  std::swap(current_, previous_);
+  zx::time now(async_now(dispatcher_));
+  zx::duration elapsed = now - sample_time_;
+  sample_time_ = now;
+  if (sample_count_++ == 0u)
+    return;
+
+  for (size_t i = 0u; i < count_; ++i) {
+    deltas_[i] = current_[i] >= previous_[i] ? current_[i] - previous_[i]
+                                             : current_[i];
+  }
+  if (trace_category_)
+    WriteTrace();
+  if (delta_handler_)
+    delta_handler_(deltas_, elapsed);
+}
+
+void CounterSampler::WriteTrace() {
+  trace_string_ref_t category_ref;
+  trace_context_t* context =
+      trace_acquire_context_for_category(trace_category_, &category_ref);
+  if (!context)
+    return;
+
+  trace_thread_ref_t thread_ref;
+  trace_string_ref_t name_ref;
+  trace_context_register_current_thread(context, &thread_ref);
+  trace_context_register_string_literal(context, trace_name_, &name_ref);
+  trace_ticks_t ticks = zx_ticks_get();
+
+  trace_arg_t args[kMaxArgsPerRecord];
+  for (size_t begin = 0u; begin < count_; begin += kMaxArgsPerRecord) {
+    size_t num_args = std::min(kMaxArgsPerRecord, count_ - begin);
+    for (size_t i = 0u; i < num_args; ++i) {
+      trace_string_ref_t arg_name_ref;
+      trace_context_register_string_literal(context, names_[begin + i],
+                                            &arg_name_ref);
+      args[i] = trace_make_arg(
+          arg_name_ref, trace_make_uint64_arg_value(deltas_[begin + i]));
+    }
+    trace_context_write_counter_event_record(context, ticks, &thread_ref,
+                                             &category_ref, &name_ref,
+                                             trace_counter_id_, args, num_args);
+  }
+  trace_release_context(context);
+}
+
+}  // namespace stats
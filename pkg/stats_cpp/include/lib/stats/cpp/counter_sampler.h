@@ -0,0 +1,179 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_STATS_CPP_COUNTER_SAMPLER_H_
+#define LIB_STATS_CPP_COUNTER_SAMPLER_H_
+
+#include <lib/async/dispatcher.h>
+#include <lib/async/task.h>
+#include <lib/fit/function.h>
+#include <lib/zx/time.h>
+#include <trace-engine/types.h>
+#include <zircon/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <utility>
+
+namespace stats {
+
+// How the counters of a stats struct are flattened into an array of
+// |uint64_t|, for a |StatsSampler|. Specialized for each struct, as in
+// <lib/stats/cpp/netstack_stats.h>, with:
+//
+//   // The number of counters.
+//   static constexpr size_t kCount;
+//   // Their names, string literals indexed like the counters.
+//   static const char* const* names();
+//   // Writes the |kCount| counters of |stats| to |counters|.
+//   static void Flatten(const Stats& stats, uint64_t* counters);
+template <typename Stats>
+struct CounterLayout;
+
+// Samples a fixed set of monotonic counters, every |period|, and reports how
+// much each grew since the previous sample.
+//
+// The sampler keeps the previous sample and computes the deltas into storage
+// allocated once, at construction, so polling allocates nothing. At each poll
+// it calls the fetch handler, which delivers the sample with |Record()| once
+// it has it; no poll fetches while a sample is outstanding, so a slow source
+// is never asked twice. The deltas go to the delta handler, and to the trace
+// as counter events if |set_trace_counter()| was called and the category is
+// enabled.
+//
+// A counter that goes down, such as once a device restarts, is taken to have
+// been reset: its delta is its new value.
+//
+// The sampler must be used on the thread of |dispatcher|.
+class CounterSampler : private async_task_t {
+ public:
+  // Called at each poll to fetch a sample.
+  using FetchHandler = fit::closure;
+
+  // Called with the deltas of each sample after the first, indexed like the
+  // names, and the time since the previous sample.
+  using DeltaHandler =
+      fit::function<void(const uint64_t* deltas, zx::duration elapsed)>;
+
+  // Samples |count| counters named |names|, string literals which must
+  // outlive the sampler.
+  CounterSampler(async_dispatcher_t* dispatcher, size_t count,
+                 const char* const* names);
+  ~CounterSampler();
+
+  CounterSampler(const CounterSampler&) = delete;
+  CounterSampler& operator=(const CounterSampler&) = delete;
+
+  size_t size() const { return count_; }
+  const char* const* names() const { return names_; }
+
+  void set_fetch_handler(FetchHandler fetch_handler) {
+    fetch_handler_ = std::move(fetch_handler);
+  }
+  void set_delta_handler(DeltaHandler delta_handler) {
+    delta_handler_ = std::move(delta_handler);
+  }
+
+  // Writes the deltas of each sample as counter events named |name|, with id
+  // |counter_id|, in |category|. Both must be string literals.
+  void set_trace_counter(const char* category, const char* name,
+                         trace_counter_id_t counter_id = 0u) {
+    trace_category_ = category;
+    trace_name_ = name;
+    trace_counter_id_ = counter_id;
+  }
+
+  // Polls every |period|, starting now. May be called again to change the
+  // period.
+  zx_status_t Start(zx::duration period);
+
+  // Stops polling. A sample outstanding is still recorded.
+  void Stop();
+
+  // Records a sample of the counters, indexed like the names.
+  void Record(const uint64_t* values);
+
+  // Forgets the sample outstanding, such as when fetching it failed, so that
+  // the next poll fetches again.
+  void CancelFetch() { fetch_pending_ = false; }
+
+  // The latest sample and its deltas, valid once a second sample has been
+  // recorded.
+  const uint64_t* values() const { return current_; }
+  const uint64_t* deltas() const { return deltas_; }
+
+  // The number of samples recorded.
+  uint64_t sample_count() const { return sample_count_; }
+
+ protected:
+  // Where the next sample is written, before |Commit()| records it.
+  uint64_t* next_values() { return previous_; }
+  void Commit();
+
+ private:
+  static void CallHandler(async_dispatcher_t* dispatcher, async_task_t* task,
+                          zx_status_t status);
+  void OnPoll();
+  void WriteTrace();
+
+  async_dispatcher_t* const dispatcher_;
+  const size_t count_;
+  const char* const* const names_;
+  FetchHandler fetch_handler_;
+  DeltaHandler delta_handler_;
+
+  const char* trace_category_ = nullptr;
+  const char* trace_name_ = nullptr;
+  trace_counter_id_t trace_counter_id_ = 0u;
+
+  // Holds the two samples and the deltas, which |current_|, |previous_| and
+  // |deltas_| point into.
+  std::unique_ptr<uint64_t[]> storage_;
+  uint64_t* current_;
+  uint64_t* previous_;
+  uint64_t* deltas_;
+  uint64_t sample_count_ = 0u;
+  zx::time sample_time_;
+
+  zx::duration period_;
+  bool task_posted_ = false;
+  bool fetch_pending_ = false;
+};
+
+// A |CounterSampler| of the counters of |Stats|, as laid out by
+// |CounterLayout<Stats>|.
+//
+// # Example
+//
+//   stats::StatsSampler<fuchsia::netstack::NetInterfaceStats> sampler(
+//       dispatcher);
+//   sampler.set_fetch_handler([&] {
+//     netstack->GetStats(nicid, [&](fuchsia::netstack::NetInterfaceStats s) {
+//       sampler.Record(s);
+//     });
+//   });
+//   sampler.set_trace_counter("net", "nic_stats", nicid);
+//   sampler.Start(zx::sec(1));
+template <typename Stats>
+class StatsSampler : public CounterSampler {
+ public:
+  using Layout = CounterLayout<Stats>;
+
+  explicit StatsSampler(async_dispatcher_t* dispatcher)
+      : CounterSampler(dispatcher, Layout::kCount, Layout::names()) {}
+
+  using CounterSampler::Record;
+
+  // Records a sample of |stats|.
+  void Record(const Stats& stats) {
+    Layout::Flatten(stats, next_values());
+    Commit();
+  }
+};
+
+}  // namespace stats
+
+#endif  // LIB_STATS_CPP_COUNTER_SAMPLER_H_
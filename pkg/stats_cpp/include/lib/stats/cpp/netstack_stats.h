@@ -0,0 +1,37 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_STATS_CPP_NETSTACK_STATS_H_
+#define LIB_STATS_CPP_NETSTACK_STATS_H_
+
+#include <fuchsia/netstack/cpp/fidl.h>
+#include <lib/stats/cpp/counter_sampler.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace stats {
+
+// The traffic counters of an interface, received then sent. |up_since| is a
+// time rather than a counter, so it is not sampled.
+template <>
+struct CounterLayout<fuchsia::netstack::NetInterfaceStats> {
+  static constexpr size_t kCount = 12u;
+  static const char* const* names();
+  static void Flatten(const fuchsia::netstack::NetInterfaceStats& stats,
+                      uint64_t* counters);
+};
+
+// The counters of the whole stack, then of its IP, TCP and UDP layers.
+template <>
+struct CounterLayout<fuchsia::netstack::AggregateStats> {
+  static constexpr size_t kCount = 20u;
+  static const char* const* names();
+  static void Flatten(const fuchsia::netstack::AggregateStats& stats,
+                      uint64_t* counters);
+};
+
+}  // namespace stats
+
+#endif  // LIB_STATS_CPP_NETSTACK_STATS_H_
@@ -0,0 +1,52 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_STATS_CPP_WLAN_STATS_H_
+#define LIB_STATS_CPP_WLAN_STATS_H_
+
+#include <fuchsia/wlan/stats/cpp/fidl.h>
+#include <lib/stats/cpp/counter_sampler.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace stats {
+
+// Each |fuchsia::wlan::stats::PacketCounter| is flattened into its six
+// counts, in declaration order: in, out, drop, in_bytes, out_bytes and
+// drop_bytes. The counters' names are those of the fields rather than the
+// |name| they carry, which the sampler does not read. RSSI histograms are
+// distributions rather than counters, so they are not sampled.
+
+// The packet counters of the dispatcher: any, management, control and data.
+template <>
+struct CounterLayout<fuchsia::wlan::stats::DispatcherStats> {
+  static constexpr size_t kCount = 24u;
+  static const char* const* names();
+  static void Flatten(const fuchsia::wlan::stats::DispatcherStats& stats,
+                      uint64_t* counters);
+};
+
+// The packet counters of a client MLME.
+template <>
+struct CounterLayout<fuchsia::wlan::stats::ClientMlmeStats> {
+  static constexpr size_t kCount = 30u;
+  static const char* const* names();
+  static void Flatten(const fuchsia::wlan::stats::ClientMlmeStats& stats,
+                      uint64_t* counters);
+};
+
+// The counters of the dispatcher then of the client MLME, which are zero
+// while the interface has no client MLME.
+template <>
+struct CounterLayout<fuchsia::wlan::stats::IfaceStats> {
+  static constexpr size_t kCount = 54u;
+  static const char* const* names();
+  static void Flatten(const fuchsia::wlan::stats::IfaceStats& stats,
+                      uint64_t* counters);
+};
+
+}  // namespace stats
+
+#endif  // LIB_STATS_CPP_WLAN_STATS_H_
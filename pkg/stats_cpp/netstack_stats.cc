@@ -0,0 +1,105 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/stats/cpp/netstack_stats.h"
+
+namespace stats {
+namespace {
+
+using fuchsia::netstack::AggregateStats;
+using fuchsia::netstack::NetInterfaceStats;
+using fuchsia::netstack::NetTrafficStats;
+
+constexpr const char* kInterfaceNames[] = {
+    "rx.pkts_total",        "rx.pkts_echo_req",    "rx.pkts_echo_rep",
+    "rx.pkts_echo_req_v6",  "rx.pkts_echo_rep_v6", "rx.bytes_total",
+    "tx.pkts_total",        "tx.pkts_echo_req",    "tx.pkts_echo_rep",
+    "tx.pkts_echo_req_v6",  "tx.pkts_echo_rep_v6", "tx.bytes_total",
+};
+
+static_assert(sizeof(kInterfaceNames) / sizeof(kInterfaceNames[0]) ==
+                  CounterLayout<NetInterfaceStats>::kCount,
+              "Every counter needs a name");
+
+constexpr const char* kAggregateNames[] = {
+    "unknown_protocol_received_packets",
+    "malformed_received_packets",
+    "dropped_packets",
+    "ip.packets_received",
+    "ip.invalid_addresses_received",
+    "ip.packets_delivered",
+    "ip.packets_sent",
+    "ip.outgoing_packet_errors",
+    "tcp.active_connection_openings",
+    "tcp.passive_connection_openings",
+    "tcp.failed_connection_attempts",
+    "tcp.valid_segments_received",
+    "tcp.invalid_segments_received",
+    "tcp.segments_sent",
+    "tcp.resets_sent",
+    "udp.packets_received",
+    "udp.unknown_port_errors",
+    "udp.receive_buffer_errors",
+    "udp.malformed_packets_received",
+    "udp.packets_sent",
+};
+
+static_assert(sizeof(kAggregateNames) / sizeof(kAggregateNames[0]) ==
+                  CounterLayout<AggregateStats>::kCount,
+              "Every counter needs a name");
+
+uint64_t* FlattenTraffic(const NetTrafficStats& stats, uint64_t* counters) {
+  *counters++ = stats.pkts_total;
+  *counters++ = stats.pkts_echo_req;
+  *counters++ = stats.pkts_echo_rep;
+  *counters++ = stats.pkts_echo_req_v6;
+  *counters++ = stats.pkts_echo_rep_v6;
+  *counters++ = stats.bytes_total;
+  return counters;
+}
+
+}  // namespace
+
+const char* const* CounterLayout<NetInterfaceStats>::names() {
+  return kInterfaceNames;
+}
+
+void CounterLayout<NetInterfaceStats>::Flatten(const NetInterfaceStats& stats,
+                                               uint64_t* counters) {
+  counters = FlattenTraffic(stats.rx, counters);
+  FlattenTraffic(stats.tx, counters);
+}
+
+const char* const* CounterLayout<AggregateStats>::names() {
+  return kAggregateNames;
+}
+
+void CounterLayout<AggregateStats>::Flatten(const AggregateStats& stats,
+                                            uint64_t* counters) {
+  *counters++ = stats.unknown_protocol_received_packets;
+  *counters++ = stats.malformed_received_packets;
+  *counters++ = stats.dropped_packets;
+
+  *counters++ = stats.ip_stats.packets_received;
+  *counters++ = stats.ip_stats.invalid_addresses_received;
+  *counters++ = stats.ip_stats.packets_delivered;
+  *counters++ = stats.ip_stats.packets_sent;
+  *counters++ = stats.ip_stats.outgoing_packet_errors;
+
+  *counters++ = stats.tcp_stats.active_connection_openings;
+  *counters++ = stats.tcp_stats.passive_connection_openings;
+  *counters++ = stats.tcp_stats.failed_connection_attempts;
+  *counters++ = stats.tcp_stats.valid_segments_received;
+  *counters++ = stats.tcp_stats.invalid_segments_received;
+  *counters++ = stats.tcp_stats.segments_sent;
+  *counters++ = stats.tcp_stats.resets_sent;
+
+  *counters++ = stats.udp_stats.packets_received;
+  *counters++ = stats.udp_stats.unknown_port_errors;
+  *counters++ = stats.udp_stats.receive_buffer_errors;
+  *counters++ = stats.udp_stats.malformed_packets_received;
+  *counters++ = stats.udp_stats.packets_sent;
+}
+
+}  // namespace stats
@@ -0,0 +1,108 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/stats/cpp/wlan_stats.h"
+
+#include <algorithm>
+
+namespace stats {
+namespace {
+
+using fuchsia::wlan::stats::ClientMlmeStats;
+using fuchsia::wlan::stats::DispatcherStats;
+using fuchsia::wlan::stats::IfaceStats;
+using fuchsia::wlan::stats::PacketCounter;
+
+#define PACKET_COUNTER_NAMES(prefix)                               \
+  prefix ".in", prefix ".out", prefix ".drop", prefix ".in_bytes", \
+      prefix ".out_bytes", prefix ".drop_bytes"
+
+#define DISPATCHER_NAMES(prefix)                                           \
+  PACKET_COUNTER_NAMES(prefix "any_packet"),                               \
+      PACKET_COUNTER_NAMES(prefix "mgmt_frame"),                           \
+      PACKET_COUNTER_NAMES(prefix "ctrl_frame"),                           \
+      PACKET_COUNTER_NAMES(prefix "data_frame")
+
+#define CLIENT_MLME_NAMES(prefix)                                          \
+  PACKET_COUNTER_NAMES(prefix "svc_msg"),                                  \
+      PACKET_COUNTER_NAMES(prefix "data_frame"),                           \
+      PACKET_COUNTER_NAMES(prefix "mgmt_frame"),                           \
+      PACKET_COUNTER_NAMES(prefix "tx_frame"),                             \
+      PACKET_COUNTER_NAMES(prefix "rx_frame")
+
+constexpr const char* kDispatcherNames[] = {DISPATCHER_NAMES("")};
+constexpr const char* kClientMlmeNames[] = {CLIENT_MLME_NAMES("")};
+constexpr const char* kIfaceNames[] = {
+    DISPATCHER_NAMES("dispatcher."),
+    CLIENT_MLME_NAMES("client_mlme."),
+};
+
+#undef CLIENT_MLME_NAMES
+#undef DISPATCHER_NAMES
+#undef PACKET_COUNTER_NAMES
+
+static_assert(sizeof(kDispatcherNames) / sizeof(kDispatcherNames[0]) ==
+                  CounterLayout<DispatcherStats>::kCount,
+              "Every counter needs a name");
+static_assert(sizeof(kClientMlmeNames) / sizeof(kClientMlmeNames[0]) ==
+                  CounterLayout<ClientMlmeStats>::kCount,
+              "Every counter needs a name");
+static_assert(sizeof(kIfaceNames) / sizeof(kIfaceNames[0]) ==
+                  CounterLayout<IfaceStats>::kCount,
+              "Every counter needs a name");
+
+uint64_t* FlattenPacketCounter(const PacketCounter& counter,
+                               uint64_t* counters) {
+  *counters++ = counter.in.count;
+  *counters++ = counter.out.count;
+  *counters++ = counter.drop.count;
+  *counters++ = counter.in_bytes.count;
+  *counters++ = counter.out_bytes.count;
+  *counters++ = counter.drop_bytes.count;
+  return counters;
+}
+
+}  // namespace
+
+const char* const* CounterLayout<DispatcherStats>::names() {
+  return kDispatcherNames;
+}
+
+void CounterLayout<DispatcherStats>::Flatten(const DispatcherStats& stats,
+                                             uint64_t* counters) {
+  counters = FlattenPacketCounter(stats.any_packet, counters);
+  counters = FlattenPacketCounter(stats.mgmt_frame, counters);
+  counters = FlattenPacketCounter(stats.ctrl_frame, counters);
+  FlattenPacketCounter(stats.data_frame, counters);
+}
+
+const char* const* CounterLayout<ClientMlmeStats>::names() {
+  return kClientMlmeNames;
+}
+
+void CounterLayout<ClientMlmeStats>::Flatten(const ClientMlmeStats& stats,
+                                             uint64_t* counters) {
+  counters = FlattenPacketCounter(stats.svc_msg, counters);
+  counters = FlattenPacketCounter(stats.data_frame, counters);
+  counters = FlattenPacketCounter(stats.mgmt_frame, counters);
+  counters = FlattenPacketCounter(stats.tx_frame, counters);
+  FlattenPacketCounter(stats.rx_frame, counters);
+}
+
+const char* const* CounterLayout<IfaceStats>::names() { return kIfaceNames; }
+
+void CounterLayout<IfaceStats>::Flatten(const IfaceStats& stats,
+                                        uint64_t* counters) {
+  CounterLayout<DispatcherStats>::Flatten(stats.dispatcher_stats, counters);
+  counters += CounterLayout<DispatcherStats>::kCount;
+  if (stats.mlme_stats && stats.mlme_stats->is_client_mlme_stats()) {
+    CounterLayout<ClientMlmeStats>::Flatten(
+        stats.mlme_stats->client_mlme_stats(), counters);
+  } else {
+    std::fill(counters, counters + CounterLayout<ClientMlmeStats>::kCount,
+              uint64_t{0u});
+  }
+}
+
+}  // namespace stats
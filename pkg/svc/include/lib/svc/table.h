@@ -0,0 +1,60 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_SVC_TABLE_H_
+#define LIB_SVC_TABLE_H_
+
+#include <lib/async/dispatcher.h>
+#include <lib/svc/dir.h>
+#include <zircon/compiler.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// A service directory, like |svc_dir_t|, for processes that expose many
+// services.
+//
+// Services are kept in a hash table, so routing an Open to a service costs
+// the same however many services there are.  Services may also be
+// registered lazily: when a client opens a service that is not in the
+// table, the table calls its resolver, which may add the service before the
+// request is routed.
+typedef struct svc_table svc_table_t;
+
+// Called when a client opens a service that is not in |table|.  To accept
+// the connection, the resolver adds the service with
+// |svc_table_add_service()| before returning; otherwise the request is
+// closed.  |type| is NULL for services in the root directory.
+typedef void(svc_resolver_t)(void* context, svc_table_t* table,
+                             const char* type, const char* service_name);
+
+// Creates a service directory that serves |directory_request| on
+// |dispatcher|.  Takes ownership of |directory_request|.
+zx_status_t svc_table_create(async_dispatcher_t* dispatcher,
+                             zx_handle_t directory_request,
+                             svc_table_t** out_result);
+
+// Adds a service named |service_name| to |table|, with the same semantics as
+// |svc_dir_add_service()|.
+zx_status_t svc_table_add_service(svc_table_t* table, const char* type,
+                                  const char* service_name, void* context,
+                                  svc_connector_t* handler);
+
+// Removes the service named |service_name| of type |type| from |table|.
+// Returns ZX_ERR_NOT_FOUND if the entry does not exist.
+zx_status_t svc_table_remove_service(svc_table_t* table, const char* type,
+                                     const char* service_name);
+
+// Sets the function that |table| calls to resolve services it does not
+// have, or clears it if |resolver| is NULL.
+void svc_table_set_resolver(svc_table_t* table, void* context,
+                            svc_resolver_t* resolver);
+
+// Closes every connection to |table| and frees it.  Must be called on the
+// dispatcher's thread.
+void svc_table_destroy(svc_table_t* table);
+
+__END_CDECLS
+
+#endif  // LIB_SVC_TABLE_H_
@@ -0,0 +1,661 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/svc/table.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lib/async/wait.h>
+#include <zircon/fidl.h>
+#include <zircon/syscalls.h>
+
+// The parts of the fuchsia.io wire format that a service directory serves.
+// The ordinals are those that fidlc generates for //fidl/fuchsia_io.
+
+#define IO_OPEN_FLAG_DESCRIBE ((uint32_t)0x00800000u)
+#define IO_OPEN_FLAG_STATUS ((uint32_t)0x01000000u)
+#define IO_MODE_TYPE_DIRECTORY ((uint32_t)0x04000u)
+#define IO_MAX_BUF ((uint64_t)8192u)
+#define IO_MAX_PATH ((uint64_t)4096u)
+#define IO_DIRENT_TYPE_DIRECTORY ((uint8_t)4u)
+#define IO_DIRENT_TYPE_SERVICE ((uint8_t)16u)
+#define IO_INO_UNKNOWN ((uint64_t)UINT64_MAX)
+#define IO_NODE_INFO_TAG_SERVICE ((uint32_t)0u)
+#define IO_NODE_INFO_TAG_DIRECTORY ((uint32_t)2u)
+
+#define IO_NODE_CLONE_ORDINAL ((uint32_t)0x17fe6a4c)
+#define IO_NODE_CLOSE_ORDINAL ((uint32_t)0x52b95687)
+#define IO_NODE_DESCRIBE_ORDINAL ((uint32_t)0x1f62df5e)
+#define IO_NODE_ON_OPEN_ORDINAL ((uint32_t)0x4700a7bd)
+#define IO_NODE_GET_ATTR_ORDINAL ((uint32_t)0x4585e7c8)
+#define IO_DIRECTORY_OPEN_ORDINAL ((uint32_t)0x77e4cceb)
+#define IO_DIRECTORY_READ_DIRENTS_ORDINAL ((uint32_t)0x2ea53c2d)
+#define IO_DIRECTORY_REWIND_ORDINAL ((uint32_t)0x7072fd87)
+
+typedef struct io_node_info {
+    FIDL_ALIGNDECL
+    uint32_t tag;
+    uint8_t payload[24];
+} io_node_info_t;
+
+typedef struct io_clone_request {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    uint32_t flags;
+    zx_handle_t object;
+} io_clone_request_t;
+
+typedef struct io_open_request {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    uint32_t flags;
+    uint32_t mode;
+    fidl_string_t path;
+    zx_handle_t object;
+} io_open_request_t;
+
+typedef struct io_read_dirents_request {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    uint64_t max_bytes;
+} io_read_dirents_request_t;
+
+typedef struct io_status_response {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    zx_status_t s;
+} io_status_response_t;
+
+typedef struct io_describe_response {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    io_node_info_t info;
+} io_describe_response_t;
+
+typedef struct io_on_open_event {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    zx_status_t s;
+    uintptr_t info;
+} io_on_open_event_t;
+
+typedef struct io_get_attr_response {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    zx_status_t s;
+    struct {
+        uint32_t mode;
+        uint64_t id;
+        uint64_t content_size;
+        uint64_t storage_size;
+        uint64_t link_count;
+        uint64_t creation_time;
+        uint64_t modification_time;
+    } attributes;
+} io_get_attr_response_t;
+
+typedef struct io_read_dirents_response {
+    FIDL_ALIGNDECL
+    fidl_message_header_t hdr;
+    zx_status_t s;
+    fidl_vector_t dirents;
+} io_read_dirents_response_t;
+
+typedef struct io_dirent {
+    uint64_t ino;
+    uint8_t size;
+    uint8_t type;
+} __PACKED io_dirent_t;
+
+// A directory of services of one type, which lives as long as the table.
+typedef struct svc_type {
+    struct svc_type* next;
+    char* name;
+} svc_type_t;
+
+typedef struct svc_entry {
+    struct svc_entry* next; // in its bucket
+    uint32_t hash;
+    svc_type_t* type; // NULL in the root directory
+    char* name;
+    void* context;
+    svc_connector_t* handler;
+} svc_entry_t;
+
+typedef struct svc_connection {
+    // Must be first, see |on_message()|.
+    async_wait_t wait;
+
+    struct svc_connection* prev;
+    struct svc_connection* next;
+    svc_table_t* table;
+    svc_type_t* type; // NULL for the root directory
+    size_t cursor;    // the number of entries ReadDirents has returned
+} svc_connection_t;
+
+struct svc_table {
+    async_dispatcher_t* dispatcher;
+
+    // A power of two number of buckets, which doubles when there are as many
+    // entries.
+    svc_entry_t** buckets;
+    size_t bucket_count;
+    size_t entry_count;
+
+    svc_type_t* types;
+    svc_connection_t* connections;
+
+    void* resolver_context;
+    svc_resolver_t* resolver;
+};
+
+#define INITIAL_BUCKET_COUNT ((size_t)16u)
+
+// FNV-1a of the type name, a separator, and the service name.
+static uint32_t hash_name(const char* type, const char* name, size_t length) {
+    uint32_t hash = 2166136261u;
+    if (type != NULL) {
+        for (const char* p = type; *p; ++p)
+            hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+    hash = (hash ^ (uint8_t)'/') * 16777619u;
+    for (size_t i = 0; i < length; ++i)
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+    return hash;
+}
+
+static bool is_valid_name(const char* name) {
+    return name != NULL && name[0] != '\0' && strchr(name, '/') == NULL &&
+           strcmp(name, ".") != 0 && strcmp(name, "..") != 0;
+}
+
+static svc_type_t* find_type(svc_table_t* table, const char* name,
+                             size_t length) {
+    for (svc_type_t* type = table->types; type; type = type->next) {
+        if (strncmp(type->name, name, length) == 0 &&
+            type->name[length] == '\0')
+            return type;
+    }
+    return NULL;
+}
+
+static svc_entry_t** find_entry(svc_table_t* table, const svc_type_t* type,
+                                const char* name, size_t length) {
+    uint32_t hash = hash_name(type ? type->name : NULL, name, length);
+    svc_entry_t** link = &table->buckets[hash & (table->bucket_count - 1u)];
+    for (; *link; link = &(*link)->next) {
+        svc_entry_t* entry = *link;
+        if (entry->hash == hash && entry->type == type &&
+            strncmp(entry->name, name, length) == 0 &&
+            entry->name[length] == '\0')
+            break;
+    }
+    return link;
+}
+
+static zx_status_t grow(svc_table_t* table) {
+    size_t bucket_count = table->bucket_count * 2u;
+    svc_entry_t** buckets = calloc(bucket_count, sizeof(*buckets));
+    if (buckets == NULL)
+        return ZX_ERR_NO_MEMORY;
+    for (size_t i = 0; i < table->bucket_count; ++i) {
+        svc_entry_t* entry = table->buckets[i];
+        while (entry != NULL) {
+            svc_entry_t* next = entry->next;
+            svc_entry_t** bucket = &buckets[entry->hash & (bucket_count - 1u)];
+            entry->next = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+    free(table->buckets);
+    table->buckets = buckets;
+    table->bucket_count = bucket_count;
+    return ZX_OK;
+}
+
+// Messages -------------------------------------------------------------------
+
+static zx_status_t send_on_open(zx_handle_t channel, zx_status_t status,
+                                uint32_t tag) {
+    struct {
+        io_on_open_event_t event;
+        io_node_info_t info;
+    } msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.event.hdr.ordinal = IO_NODE_ON_OPEN_ORDINAL;
+    msg.event.s = status;
+    uint32_t size = sizeof(msg.event);
+    if (status == ZX_OK) {
+        msg.event.info = FIDL_ALLOC_PRESENT;
+        msg.info.tag = tag;
+        size = sizeof(msg);
+    }
+    return zx_channel_write(channel, 0u, &msg, size, NULL, 0u);
+}
+
+static zx_status_t reply_status(zx_handle_t channel,
+                                const fidl_message_header_t* request,
+                                zx_status_t status) {
+    io_status_response_t response;
+    memset(&response, 0, sizeof(response));
+    response.hdr.txid = request->txid;
+    response.hdr.ordinal = request->ordinal;
+    response.s = status;
+    return zx_channel_write(channel, 0u, &response, sizeof(response), NULL,
+                            0u);
+}
+
+// Connections ----------------------------------------------------------------
+
+static void on_message(async_dispatcher_t* dispatcher, async_wait_t* wait,
+                       zx_status_t status, const zx_packet_signal_t* signal);
+
+static void connection_destroy(svc_connection_t* connection) {
+    svc_table_t* table = connection->table;
+    if (connection->prev)
+        connection->prev->next = connection->next;
+    else
+        table->connections = connection->next;
+    if (connection->next)
+        connection->next->prev = connection->prev;
+    zx_handle_close(connection->wait.object);
+    free(connection);
+}
+
+// Serves the directory |type| on |channel|, sending OnOpen first if |flags|
+// ask for it.  Takes ownership of |channel|.
+static void connect_directory(svc_table_t* table, svc_type_t* type,
+                              uint32_t flags, zx_handle_t channel) {
+    svc_connection_t* connection = calloc(1, sizeof(*connection));
+    if (connection == NULL) {
+        zx_handle_close(channel);
+        return;
+    }
+    connection->wait = (async_wait_t){
+        {ASYNC_STATE_INIT}, on_message, channel,
+        ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED};
+    connection->table = table;
+    connection->type = type;
+    if (flags & (IO_OPEN_FLAG_DESCRIBE | IO_OPEN_FLAG_STATUS))
+        send_on_open(channel, ZX_OK, IO_NODE_INFO_TAG_DIRECTORY);
+    if (async_begin_wait(table->dispatcher, &connection->wait) != ZX_OK) {
+        zx_handle_close(channel);
+        free(connection);
+        return;
+    }
+    connection->next = table->connections;
+    if (table->connections)
+        table->connections->prev = connection;
+    table->connections = connection;
+}
+
+// Routes |request| to the service |name| of |type_name|, the |length| bytes
+// of which may be a directory that does not exist yet, calling the resolver
+// if the service is not in the table.
+static void connect_service(svc_table_t* table, const char* type_name,
+                            size_t type_length, const char* name,
+                            uint32_t flags, zx_handle_t request) {
+    size_t length = strlen(name);
+    svc_type_t* type = type_name ? find_type(table, type_name, type_length)
+                                 : NULL;
+    svc_entry_t* entry = NULL;
+    if (type_name == NULL || type != NULL)
+        entry = *find_entry(table, type, name, length);
+    if (entry == NULL && table->resolver != NULL &&
+        (type_name == NULL || type_length < 256u)) {
+        char type_buffer[256];
+        if (type_name) {
+            memcpy(type_buffer, type_name, type_length);
+            type_buffer[type_length] = '\0';
+        }
+        table->resolver(table->resolver_context, table,
+                        type_name ? type_buffer : NULL, name);
+        type = type_name ? find_type(table, type_name, type_length) : NULL;
+        if (type_name == NULL || type != NULL)
+            entry = *find_entry(table, type, name, length);
+    }
+    if (entry == NULL) {
+        if (flags & (IO_OPEN_FLAG_DESCRIBE | IO_OPEN_FLAG_STATUS))
+            send_on_open(request, ZX_ERR_NOT_FOUND, 0u);
+        zx_handle_close(request);
+        return;
+    }
+    if (flags & (IO_OPEN_FLAG_DESCRIBE | IO_OPEN_FLAG_STATUS))
+        send_on_open(request, ZX_OK, IO_NODE_INFO_TAG_SERVICE);
+    entry->handler(entry->context, entry->name, request);
+}
+
+static void handle_open(svc_connection_t* connection, uint32_t flags,
+                        char* path, zx_handle_t object) {
+    svc_table_t* table = connection->table;
+
+    // fdio sends cleaned paths, but tolerate a trailing '/'.
+    size_t length = strlen(path);
+    while (length > 1u && path[length - 1u] == '/')
+        path[--length] = '\0';
+    if (length == 0u || strcmp(path, ".") == 0) {
+        connect_directory(table, connection->type, flags, object);
+        return;
+    }
+
+    if (connection->type != NULL) {
+        connect_service(table, connection->type->name,
+                        strlen(connection->type->name), path, flags, object);
+        return;
+    }
+    char* slash = strchr(path, '/');
+    if (slash == NULL) {
+        svc_type_t* type = find_type(table, path, length);
+        if (type != NULL) {
+            connect_directory(table, type, flags, object);
+        } else {
+            connect_service(table, NULL, 0u, path, flags, object);
+        }
+        return;
+    }
+    connect_service(table, path, (size_t)(slash - path), slash + 1, flags,
+                    object);
+}
+
+// Appends the entry |name|, unless it is before the cursor.  Returns false
+// when |buffer| is full.
+static bool append_dirent(svc_connection_t* connection, size_t* index,
+                          uint8_t* buffer, size_t capacity, size_t* size,
+                          const char* name, uint8_t type) {
+    if ((*index)++ < connection->cursor)
+        return true;
+    size_t name_size = strlen(name);
+    if (*size + sizeof(io_dirent_t) + name_size > capacity)
+        return false;
+    io_dirent_t dirent = {IO_INO_UNKNOWN, (uint8_t)name_size, type};
+    memcpy(buffer + *size, &dirent, sizeof(dirent));
+    memcpy(buffer + *size + sizeof(dirent), name, name_size);
+    *size += sizeof(dirent) + name_size;
+    connection->cursor++;
+    return true;
+}
+
+static zx_status_t handle_read_dirents(svc_connection_t* connection,
+                                       const io_read_dirents_request_t* request) {
+    svc_table_t* table = connection->table;
+    struct {
+        io_read_dirents_response_t response;
+        uint8_t data[IO_MAX_BUF];
+    } msg;
+    memset(&msg.response, 0, sizeof(msg.response));
+    msg.response.hdr.txid = request->hdr.txid;
+    msg.response.hdr.ordinal = request->hdr.ordinal;
+
+    size_t capacity = request->max_bytes < IO_MAX_BUF
+                          ? (size_t)request->max_bytes
+                          : (size_t)IO_MAX_BUF;
+    size_t index = 0u;
+    size_t size = 0u;
+    bool more = append_dirent(connection, &index, msg.data, capacity, &size,
+                              ".", IO_DIRENT_TYPE_DIRECTORY);
+    if (connection->type == NULL) {
+        for (svc_type_t* type = table->types; type && more; type = type->next)
+            more = append_dirent(connection, &index, msg.data, capacity,
+                                 &size, type->name, IO_DIRENT_TYPE_DIRECTORY);
+    }
+    for (size_t i = 0; i < table->bucket_count && more; ++i) {
+        for (svc_entry_t* entry = table->buckets[i]; entry && more;
+             entry = entry->next) {
+            if (entry->type == connection->type)
+                more = append_dirent(connection, &index, msg.data, capacity,
+                                     &size, entry->name,
+                                     IO_DIRENT_TYPE_SERVICE);
+        }
+    }
+
+    msg.response.s = ZX_OK;
+    msg.response.dirents.count = size;
+    msg.response.dirents.data = (void*)FIDL_ALLOC_PRESENT;
+    return zx_channel_write(
+        connection->wait.object, 0u, &msg,
+        (uint32_t)(sizeof(msg.response) + FIDL_ALIGN(size)), NULL, 0u);
+}
+
+// Handles one message, which |bytes| is aligned for.  Returns false if the
+// connection should be closed.
+static bool dispatch(svc_connection_t* connection, uint8_t* bytes,
+                     uint32_t num_bytes, zx_handle_t* handles,
+                     uint32_t num_handles) {
+    zx_handle_t channel = connection->wait.object;
+    const fidl_message_header_t* hdr = (const fidl_message_header_t*)bytes;
+    switch (hdr->ordinal) {
+    case IO_NODE_CLONE_ORDINAL: {
+        const io_clone_request_t* request = (const io_clone_request_t*)bytes;
+        if (num_bytes != sizeof(*request) || num_handles != 1u)
+            break;
+        connect_directory(connection->table, connection->type, request->flags,
+                          handles[0]);
+        return true;
+    }
+    case IO_NODE_CLOSE_ORDINAL:
+        if (num_handles != 0u)
+            break;
+        reply_status(channel, hdr, ZX_OK);
+        return false;
+    case IO_NODE_DESCRIBE_ORDINAL: {
+        if (num_handles != 0u)
+            break;
+        io_describe_response_t response;
+        memset(&response, 0, sizeof(response));
+        response.hdr.txid = hdr->txid;
+        response.hdr.ordinal = hdr->ordinal;
+        response.info.tag = IO_NODE_INFO_TAG_DIRECTORY;
+        return zx_channel_write(channel, 0u, &response, sizeof(response),
+                                NULL, 0u) == ZX_OK;
+    }
+    case IO_NODE_GET_ATTR_ORDINAL: {
+        if (num_handles != 0u)
+            break;
+        io_get_attr_response_t response;
+        memset(&response, 0, sizeof(response));
+        response.hdr.txid = hdr->txid;
+        response.hdr.ordinal = hdr->ordinal;
+        response.s = ZX_OK;
+        response.attributes.mode = IO_MODE_TYPE_DIRECTORY | 0400u;
+        response.attributes.id = IO_INO_UNKNOWN;
+        response.attributes.link_count = 1u;
+        return zx_channel_write(channel, 0u, &response, sizeof(response),
+                                NULL, 0u) == ZX_OK;
+    }
+    case IO_DIRECTORY_OPEN_ORDINAL: {
+        io_open_request_t* request = (io_open_request_t*)bytes;
+        if (num_bytes < sizeof(*request) || num_handles != 1u ||
+            request->path.size > IO_MAX_PATH ||
+            num_bytes < sizeof(*request) + FIDL_ALIGN(request->path.size))
+            break;
+        // The path is followed by padding, which leaves room for a null.
+        char* path = (char*)bytes + sizeof(*request);
+        char saved = path[request->path.size];
+        path[request->path.size] = '\0';
+        if (memchr(path, '\0', request->path.size) != NULL) {
+            path[request->path.size] = saved;
+            break;
+        }
+        handle_open(connection, request->flags, path, handles[0]);
+        return true;
+    }
+    case IO_DIRECTORY_READ_DIRENTS_ORDINAL: {
+        const io_read_dirents_request_t* request =
+            (const io_read_dirents_request_t*)bytes;
+        if (num_bytes != sizeof(*request) || num_handles != 0u)
+            break;
+        return handle_read_dirents(connection, request) == ZX_OK;
+    }
+    case IO_DIRECTORY_REWIND_ORDINAL:
+        if (num_handles != 0u)
+            break;
+        connection->cursor = 0u;
+        return reply_status(channel, hdr, ZX_OK) == ZX_OK;
+    default:
+        break;
+    }
+    // Unknown or malformed: close the connection, as the generated bindings
+    // would.
+    for (uint32_t i = 0; i < num_handles; ++i)
+        zx_handle_close(handles[i]);
+    return false;
+}
+
+static void on_message(async_dispatcher_t* dispatcher, async_wait_t* wait,
+                       zx_status_t status, const zx_packet_signal_t* signal) {
+    svc_connection_t* connection = (svc_connection_t*)wait;
+    if (status != ZX_OK) {
+        connection_destroy(connection);
+        return;
+    }
+    if (signal->observed & ZX_CHANNEL_READABLE) {
+        // Leaves a byte after the longest Open for its path's terminator.
+        union {
+            FIDL_ALIGNDECL
+            uint8_t bytes[sizeof(io_open_request_t) + IO_MAX_PATH + 8u];
+        } msg;
+        zx_handle_t handles[2];
+        uint32_t num_bytes, num_handles;
+        status = zx_channel_read(wait->object, 0u, msg.bytes, handles,
+                                 sizeof(msg.bytes) - 1u, 2u, &num_bytes,
+                                 &num_handles);
+        if (status != ZX_OK || num_bytes < sizeof(fidl_message_header_t) ||
+            !dispatch(connection, msg.bytes, num_bytes, handles,
+                      num_handles)) {
+            connection_destroy(connection);
+            return;
+        }
+    } else {
+        // Peer closed, with nothing left to read.
+        connection_destroy(connection);
+        return;
+    }
+    if (async_begin_wait(dispatcher, wait) != ZX_OK)
+        connection_destroy(connection);
+}
+
+// Table ----------------------------------------------------------------------
+
+zx_status_t svc_table_create(async_dispatcher_t* dispatcher,
+                             zx_handle_t directory_request,
+                             svc_table_t** out_result) {
+    svc_table_t* table = calloc(1, sizeof(*table));
+    if (table == NULL) {
+        zx_handle_close(directory_request);
+        return ZX_ERR_NO_MEMORY;
+    }
+    table->buckets = calloc(INITIAL_BUCKET_COUNT, sizeof(*table->buckets));
+    if (table->buckets == NULL) {
+        free(table);
+        zx_handle_close(directory_request);
+        return ZX_ERR_NO_MEMORY;
+    }
+    table->dispatcher = dispatcher;
+    table->bucket_count = INITIAL_BUCKET_COUNT;
+    connect_directory(table, NULL, 0u, directory_request);
+    *out_result = table;
+    return ZX_OK;
+}
+
+zx_status_t svc_table_add_service(svc_table_t* table, const char* type_name,
+                                  const char* service_name, void* context,
+                                  svc_connector_t* handler) {
+    if (!is_valid_name(service_name) ||
+        (type_name != NULL && !is_valid_name(type_name)) || handler == NULL)
+        return ZX_ERR_INVALID_ARGS;
+
+    svc_type_t* type = NULL;
+    if (type_name != NULL) {
+        type = find_type(table, type_name, strlen(type_name));
+        if (type == NULL) {
+            type = calloc(1, sizeof(*type));
+            if (type == NULL || (type->name = strdup(type_name)) == NULL) {
+                free(type);
+                return ZX_ERR_NO_MEMORY;
+            }
+            type->next = table->types;
+            table->types = type;
+        }
+    }
+
+    size_t length = strlen(service_name);
+    if (*find_entry(table, type, service_name, length) != NULL)
+        return ZX_ERR_ALREADY_EXISTS;
+    if (table->entry_count >= table->bucket_count) {
+        zx_status_t status = grow(table);
+        if (status != ZX_OK)
+            return status;
+    }
+    svc_entry_t* entry = calloc(1, sizeof(*entry));
+    if (entry == NULL || (entry->name = strdup(service_name)) == NULL) {
+        free(entry);
+        return ZX_ERR_NO_MEMORY;
+    }
+    entry->hash = hash_name(type_name, service_name, length);
+    entry->type = type;
+    entry->context = context;
+    entry->handler = handler;
+    svc_entry_t** bucket =
+        &table->buckets[entry->hash & (table->bucket_count - 1u)];
+    entry->next = *bucket;
+    *bucket = entry;
+    table->entry_count++;
+    return ZX_OK;
+}
+
+zx_status_t svc_table_remove_service(svc_table_t* table, const char* type_name,
+                                     const char* service_name) {
+    if (service_name == NULL)
+        return ZX_ERR_NOT_FOUND;
+    svc_type_t* type = NULL;
+    if (type_name != NULL) {
+        type = find_type(table, type_name, strlen(type_name));
+        if (type == NULL)
+            return ZX_ERR_NOT_FOUND;
+    }
+    svc_entry_t** link =
+        find_entry(table, type, service_name, strlen(service_name));
+    svc_entry_t* entry = *link;
+    if (entry == NULL)
+        return ZX_ERR_NOT_FOUND;
+    *link = entry->next;
+    table->entry_count--;
+    free(entry->name);
+    free(entry);
+    return ZX_OK;
+}
+
+void svc_table_set_resolver(svc_table_t* table, void* context,
+                            svc_resolver_t* resolver) {
+    table->resolver_context = context;
+    table->resolver = resolver;
+}
+
+void svc_table_destroy(svc_table_t* table) {
+    while (table->connections) {
+        async_cancel_wait(table->dispatcher, &table->connections->wait);
+        connection_destroy(table->connections);
+    }
+    for (size_t i = 0; i < table->bucket_count; ++i) {
+        svc_entry_t* entry = table->buckets[i];
+        while (entry != NULL) {
+            svc_entry_t* next = entry->next;
+            free(entry->name);
+            free(entry);
+            entry = next;
+        }
+    }
+    while (table->types) {
+        svc_type_t* next = table->types->next;
+        free(table->types->name);
+        free(table->types);
+        table->types = next;
+    }
+    free(table->buckets);
+    free(table);
+}
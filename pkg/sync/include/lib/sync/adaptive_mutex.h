@@ -0,0 +1,198 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_SYNC_ADAPTIVE_MUTEX_H_
+#define LIB_SYNC_ADAPTIVE_MUTEX_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zircon/compiler.h>
+#include <zircon/syscalls.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// A non-recursive mutex that spins briefly before blocking.
+//
+// |sync_mutex_t| waits on its futex as soon as it finds the mutex held,
+// which costs two system calls even when the holder was about to release it.
+// For critical sections that last tens of nanoseconds, spinning for a short
+// while is much cheaper.
+//
+// Each mutex adapts how long it spins: it tracks how many spins recent
+// contended acquisitions took and spins for up to twice that, bounded by
+// |SYNC_ADAPTIVE_MUTEX_MAX_SPINS|, before falling back to the futex.  Each
+// time spinning fails the estimate halves, so a mutex whose holders keep it
+// for long soon spins only a few times before blocking.
+//
+// The functions mirror those of |sync_mutex_t| so that the mutex can replace
+// it directly, except that it cannot be used with |sync_condition_t|.
+typedef struct __TA_CAPABILITY("mutex") sync_adaptive_mutex {
+    // 0 when unlocked, 1 when locked, 2 when locked and possibly waited for.
+    int futex;
+    // The recent average number of spins a contended lock took.
+    int spin_estimate;
+
+    // Counters, which are only updated in debug builds.
+    // See |sync_adaptive_mutex_get_stats()|.
+    uint64_t contended_count;
+    uint64_t spin_acquire_count;
+    uint64_t futex_wait_count;
+
+#ifdef __cplusplus
+    sync_adaptive_mutex()
+        : futex(0), spin_estimate(0), contended_count(0u),
+          spin_acquire_count(0u), futex_wait_count(0u) {}
+#endif
+} sync_adaptive_mutex_t;
+
+#if !defined(__cplusplus)
+#define SYNC_ADAPTIVE_MUTEX_INIT ((sync_adaptive_mutex_t){0})
+#endif
+
+// The most times a contended lock spins before waiting on the futex.
+#define SYNC_ADAPTIVE_MUTEX_MAX_SPINS 100
+
+typedef struct sync_adaptive_mutex_stats {
+    // The number of times the mutex was found held when locking it.
+    uint64_t contended_count;
+    // The number of those times it was acquired by spinning.
+    uint64_t spin_acquire_count;
+    // The number of times a thread waited on the futex.
+    uint64_t futex_wait_count;
+} sync_adaptive_mutex_stats_t;
+
+// Implementation details follow the public functions below; they are in this
+// header so that the uncontended paths are inlined.
+static inline zx_status_t sync_adaptive_mutex_lock_slow(
+    sync_adaptive_mutex_t* mutex, zx_time_t deadline);
+
+// Locks the mutex.
+//
+// The current thread spins for a while and then blocks until the mutex is
+// acquired. The mutex is non-recursive, which means attempting to lock a
+// mutex that is already held by this thread will deadlock.
+static inline void sync_adaptive_mutex_lock(sync_adaptive_mutex_t* mutex)
+    __TA_ACQUIRE(mutex) __TA_NO_THREAD_SAFETY_ANALYSIS {
+    int expected = 0;
+    if (!__atomic_compare_exchange_n(&mutex->futex, &expected, 1, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        sync_adaptive_mutex_lock_slow(mutex, ZX_TIME_INFINITE);
+}
+
+// Attempt to lock the mutex until |deadline|.
+//
+// |deadline| is expressed as an absolute time in the ZX_CLOCK_MONOTONIC
+// timebase.
+//
+// Returns |ZX_OK| if the lock is acquired, and |ZX_ERR_TIMED_OUT| if the
+// deadline passes.
+static inline zx_status_t sync_adaptive_mutex_timedlock(
+    sync_adaptive_mutex_t* mutex, zx_time_t deadline) {
+    int expected = 0;
+    if (__atomic_compare_exchange_n(&mutex->futex, &expected, 1, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return ZX_OK;
+    return sync_adaptive_mutex_lock_slow(mutex, deadline);
+}
+
+// Attempts to lock the mutex without blocking or spinning.
+//
+// Returns |ZX_OK| if the lock is obtained, and |ZX_ERR_BAD_STATE| if not.
+static inline zx_status_t sync_adaptive_mutex_trylock(
+    sync_adaptive_mutex_t* mutex) {
+    int expected = 0;
+    return __atomic_compare_exchange_n(&mutex->futex, &expected, 1, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)
+               ? ZX_OK
+               : ZX_ERR_BAD_STATE;
+}
+
+// Unlocks the mutex.
+//
+// Does nothing if the mutex is already unlocked.
+static inline void sync_adaptive_mutex_unlock(sync_adaptive_mutex_t* mutex)
+    __TA_RELEASE(mutex) __TA_NO_THREAD_SAFETY_ANALYSIS {
+    if (__atomic_exchange_n(&mutex->futex, 0, __ATOMIC_RELEASE) == 2)
+        zx_futex_wake((zx_futex_t*)&mutex->futex, 1u);
+}
+
+// Reads the mutex's counters.
+//
+// The counters are only updated in debug builds; otherwise they read zero.
+static inline void sync_adaptive_mutex_get_stats(
+    const sync_adaptive_mutex_t* mutex, sync_adaptive_mutex_stats_t* stats) {
+    stats->contended_count =
+        __atomic_load_n(&mutex->contended_count, __ATOMIC_RELAXED);
+    stats->spin_acquire_count =
+        __atomic_load_n(&mutex->spin_acquire_count, __ATOMIC_RELAXED);
+    stats->futex_wait_count =
+        __atomic_load_n(&mutex->futex_wait_count, __ATOMIC_RELAXED);
+}
+
+static inline void sync_adaptive_mutex_pause(void) {
+#if defined(__x86_64__)
+    __asm__ __volatile__("pause"
+                         :
+                         :
+                         : "memory");
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield"
+                         :
+                         :
+                         : "memory");
+#else
+#error Please define sync_adaptive_mutex_pause() for your architecture
+#endif
+}
+
+static inline void sync_adaptive_mutex_count(uint64_t* counter) {
+#ifndef NDEBUG
+    __atomic_fetch_add(counter, 1u, __ATOMIC_RELAXED);
+#else
+    (void)counter;
+#endif
+}
+
+static inline zx_status_t sync_adaptive_mutex_lock_slow(
+    sync_adaptive_mutex_t* mutex, zx_time_t deadline) {
+    sync_adaptive_mutex_count(&mutex->contended_count);
+
+    // Spin for up to twice as long as recent acquisitions took, keeping the
+    // estimate as a running average with a weight of 1/8 per acquisition.
+    int estimate = __atomic_load_n(&mutex->spin_estimate, __ATOMIC_RELAXED);
+    int max_spins = estimate * 2 + 10;
+    if (max_spins > SYNC_ADAPTIVE_MUTEX_MAX_SPINS)
+        max_spins = SYNC_ADAPTIVE_MUTEX_MAX_SPINS;
+    for (int spins = 0; spins < max_spins; spins++) {
+        int expected = 0;
+        if (__atomic_load_n(&mutex->futex, __ATOMIC_RELAXED) == 0 &&
+            __atomic_compare_exchange_n(&mutex->futex, &expected, 1, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&mutex->spin_estimate,
+                             estimate + (spins - estimate) / 8,
+                             __ATOMIC_RELAXED);
+            sync_adaptive_mutex_count(&mutex->spin_acquire_count);
+            return ZX_OK;
+        }
+        sync_adaptive_mutex_pause();
+    }
+    // Spinning did not pay off this time, so spin less next time.
+    __atomic_store_n(&mutex->spin_estimate, estimate / 2, __ATOMIC_RELAXED);
+
+    // Mark the mutex as waited for, so that its holder wakes us, and block.
+    while (__atomic_exchange_n(&mutex->futex, 2, __ATOMIC_ACQUIRE) != 0) {
+        sync_adaptive_mutex_count(&mutex->futex_wait_count);
+        zx_status_t status = zx_futex_wait((zx_futex_t*)&mutex->futex, 2,
+                                           ZX_HANDLE_INVALID, deadline);
+        if (status == ZX_ERR_TIMED_OUT)
+            return status;
+    }
+    return ZX_OK;
+}
+
+__END_CDECLS
+
+#endif // LIB_SYNC_ADAPTIVE_MUTEX_H_
@@ -0,0 +1,70 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_SYNC_BARRIER_H_
+#define LIB_SYNC_BARRIER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zircon/compiler.h>
+#include <zircon/syscalls.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// A reusable rendezvous for a fixed number of threads.
+//
+// Each phase ends once all |parties| threads have arrived; the last thread to
+// arrive starts the next phase and releases the others with a single
+// |zx_futex_wake()|.
+typedef struct sync_barrier {
+    // The number of threads that take part in each phase.
+    int parties;
+    // The number of threads yet to arrive in the current phase.
+    int remaining;
+    // Counts the phases; the threads of a phase wait for it to change.
+    int generation;
+
+#ifdef __cplusplus
+    explicit sync_barrier(int party_count)
+        : parties(party_count), remaining(party_count), generation(0) {}
+#endif
+} sync_barrier_t;
+
+#if !defined(__cplusplus)
+#define SYNC_BARRIER_INIT(party_count) \
+    ((sync_barrier_t){(party_count), (party_count), 0})
+#endif
+
+// Arrives at the barrier and waits until all of the parties have arrived.
+//
+// Returns true in exactly one of the threads of each phase, the last one to
+// arrive, so that it can do work on behalf of the phase.
+static inline bool sync_barrier_arrive_and_wait(sync_barrier_t* barrier) {
+    // Read the generation first: it cannot change before this thread has
+    // arrived.
+    int generation = __atomic_load_n(&barrier->generation, __ATOMIC_ACQUIRE);
+    if (__atomic_sub_fetch(&barrier->remaining, 1, __ATOMIC_ACQ_REL) == 0) {
+        // None of the other parties can arrive again until the generation
+        // changes, so this is the time to reset the count.
+        __atomic_store_n(&barrier->remaining, barrier->parties,
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&barrier->generation, generation + 1,
+                         __ATOMIC_RELEASE);
+        if (barrier->parties > 1)
+            zx_futex_wake((zx_futex_t*)&barrier->generation, UINT32_MAX);
+        return true;
+    }
+    while (__atomic_load_n(&barrier->generation, __ATOMIC_ACQUIRE) ==
+           generation) {
+        zx_futex_wait((zx_futex_t*)&barrier->generation, generation,
+                      ZX_HANDLE_INVALID, ZX_TIME_INFINITE);
+    }
+    return false;
+}
+
+__END_CDECLS
+
+#endif // LIB_SYNC_BARRIER_H_
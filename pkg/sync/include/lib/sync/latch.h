@@ -0,0 +1,87 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_SYNC_LATCH_H_
+#define LIB_SYNC_LATCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zircon/compiler.h>
+#include <zircon/syscalls.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// A single-use counter that threads wait on until it is counted down to
+// zero, for example to wait until N workers have started.
+//
+// Counting down only touches the futex when the count reaches zero, and then
+// wakes every waiter with a single |zx_futex_wake()|, and only if some thread
+// is waiting.
+typedef struct sync_latch {
+    // The number of counts left until the latch opens.
+    int count;
+    // 0 while closed, 1 once open, 2 while closed with waiters.
+    int futex;
+
+#ifdef __cplusplus
+    explicit sync_latch(int initial_count)
+        : count(initial_count), futex(initial_count > 0 ? 0 : 1) {}
+#endif
+} sync_latch_t;
+
+#if !defined(__cplusplus)
+#define SYNC_LATCH_INIT(initial_count) \
+    ((sync_latch_t){(initial_count), (initial_count) > 0 ? 0 : 1})
+#endif
+
+// Subtracts |n| from the latch's count, opening the latch and waking all of
+// its waiters if that brings the count to zero.
+//
+// The count must not drop below zero.
+static inline void sync_latch_count_down(sync_latch_t* latch, int n) {
+    if (__atomic_sub_fetch(&latch->count, n, __ATOMIC_ACQ_REL) != 0)
+        return;
+    if (__atomic_exchange_n(&latch->futex, 1, __ATOMIC_RELEASE) == 2)
+        zx_futex_wake((zx_futex_t*)&latch->futex, UINT32_MAX);
+}
+
+// Returns true if the latch is open.
+static inline bool sync_latch_try_wait(const sync_latch_t* latch) {
+    return __atomic_load_n(&latch->futex, __ATOMIC_ACQUIRE) == 1;
+}
+
+// Waits until the latch opens or |deadline| passes.
+//
+// Returns |ZX_OK| once the latch is open, and |ZX_ERR_TIMED_OUT| if the
+// deadline passes first.
+static inline zx_status_t sync_latch_wait(sync_latch_t* latch,
+                                          zx_time_t deadline) {
+    int state = __atomic_load_n(&latch->futex, __ATOMIC_ACQUIRE);
+    while (state != 1) {
+        // Announce that a thread is waiting so that opening the latch wakes
+        // it.
+        if (state == 0 &&
+            !__atomic_compare_exchange_n(&latch->futex, &state, 2, false,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+            continue;
+        zx_status_t status = zx_futex_wait((zx_futex_t*)&latch->futex, 2,
+                                           ZX_HANDLE_INVALID, deadline);
+        if (status == ZX_ERR_TIMED_OUT)
+            return status;
+        state = __atomic_load_n(&latch->futex, __ATOMIC_ACQUIRE);
+    }
+    return ZX_OK;
+}
+
+// Counts the latch down by one and then waits for it to open.
+static inline void sync_latch_arrive_and_wait(sync_latch_t* latch) {
+    sync_latch_count_down(latch, 1);
+    sync_latch_wait(latch, ZX_TIME_INFINITE);
+}
+
+__END_CDECLS
+
+#endif // LIB_SYNC_LATCH_H_
@@ -0,0 +1,191 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_SYNC_RWLOCK_H_
+#define LIB_SYNC_RWLOCK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zircon/compiler.h>
+#include <zircon/syscalls.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// A writer-preferring reader-writer lock, for read-mostly state such as
+// routing tables and caches.
+//
+// Taking and releasing a read lock each cost a single atomic add as long as
+// no writer holds or waits for the lock.  Once a writer waits, new readers
+// wait behind it, so a steady stream of readers cannot starve writers.
+// Writers queue on a mutex of their own so that only one at a time waits
+// for the readers to drain.
+//
+// The lock is not recursive: a thread that holds it in either mode must not
+// lock it again.
+typedef struct __TA_CAPABILITY("mutex") sync_rwlock {
+    // The number of readers that hold or are trying to take the lock, plus
+    // |SYNC_RWLOCK_WRITER| while a writer holds it or waits for the readers
+    // to drain, which that writer does on this futex.
+    int state;
+    // Bumped each time a writer releases the lock; readers waiting for the
+    // writer wait on this futex.
+    int read_gate;
+    // The mutex that writers queue on: 0 when unlocked, 1 when locked, 2
+    // when locked and possibly waited for.
+    int write_mutex;
+
+#ifdef __cplusplus
+    sync_rwlock()
+        : state(0), read_gate(0), write_mutex(0) {}
+#endif
+} sync_rwlock_t;
+
+#if !defined(__cplusplus)
+#define SYNC_RWLOCK_INIT ((sync_rwlock_t){0})
+#endif
+
+#define SYNC_RWLOCK_WRITER (1 << 30)
+
+static inline void sync_rwlock_read_lock_slow(sync_rwlock_t* rwlock);
+
+// Takes the lock for reading, blocking while a writer holds or waits for it.
+static inline void sync_rwlock_read_lock(sync_rwlock_t* rwlock)
+    __THREAD_ANNOTATION(__acquire_shared_capability__(rwlock))
+    __TA_NO_THREAD_SAFETY_ANALYSIS {
+    if (__atomic_add_fetch(&rwlock->state, 1, __ATOMIC_ACQUIRE) &
+        SYNC_RWLOCK_WRITER)
+        sync_rwlock_read_lock_slow(rwlock);
+}
+
+// Attempts to take the lock for reading without blocking.
+//
+// Returns |ZX_OK| if the lock is obtained, and |ZX_ERR_BAD_STATE| if a
+// writer holds or waits for it.
+static inline zx_status_t sync_rwlock_try_read_lock(sync_rwlock_t* rwlock) {
+    int state = __atomic_load_n(&rwlock->state, __ATOMIC_RELAXED);
+    while (!(state & SYNC_RWLOCK_WRITER)) {
+        if (__atomic_compare_exchange_n(&rwlock->state, &state, state + 1,
+                                        false, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED))
+            return ZX_OK;
+    }
+    return ZX_ERR_BAD_STATE;
+}
+
+// Releases a read lock.
+static inline void sync_rwlock_read_unlock(sync_rwlock_t* rwlock)
+    __THREAD_ANNOTATION(__release_shared_capability__(rwlock))
+    __TA_NO_THREAD_SAFETY_ANALYSIS {
+    // The last reader out lets a waiting writer in.
+    if (__atomic_sub_fetch(&rwlock->state, 1, __ATOMIC_RELEASE) ==
+        SYNC_RWLOCK_WRITER)
+        zx_futex_wake((zx_futex_t*)&rwlock->state, 1u);
+}
+
+// Takes the lock for writing, blocking while any other thread holds it.
+static inline void sync_rwlock_write_lock(sync_rwlock_t* rwlock)
+    __TA_ACQUIRE(rwlock) __TA_NO_THREAD_SAFETY_ANALYSIS {
+    // Queue behind other writers.
+    int expected = 0;
+    if (!__atomic_compare_exchange_n(&rwlock->write_mutex, &expected, 1,
+                                     false, __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED)) {
+        while (__atomic_exchange_n(&rwlock->write_mutex, 2,
+                                   __ATOMIC_ACQUIRE) != 0) {
+            zx_futex_wait((zx_futex_t*)&rwlock->write_mutex, 2,
+                          ZX_HANDLE_INVALID, ZX_TIME_INFINITE);
+        }
+    }
+
+    // Turn new readers away, then wait for the current ones to leave.
+    int state = __atomic_or_fetch(&rwlock->state, SYNC_RWLOCK_WRITER,
+                                  __ATOMIC_ACQUIRE);
+    while (state != SYNC_RWLOCK_WRITER) {
+        zx_futex_wait((zx_futex_t*)&rwlock->state, state, ZX_HANDLE_INVALID,
+                      ZX_TIME_INFINITE);
+        state = __atomic_load_n(&rwlock->state, __ATOMIC_ACQUIRE);
+    }
+}
+
+// Releases a write lock.
+static inline void sync_rwlock_write_unlock(sync_rwlock_t* rwlock)
+    __TA_RELEASE(rwlock) __TA_NO_THREAD_SAFETY_ANALYSIS {
+    // Let the readers in.  A queued writer sets the bit again as soon as it
+    // gets the write mutex, which keeps out readers that have not yet woken.
+    __atomic_fetch_and(&rwlock->state, ~SYNC_RWLOCK_WRITER, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&rwlock->read_gate, 1, __ATOMIC_RELEASE);
+    zx_futex_wake((zx_futex_t*)&rwlock->read_gate, UINT32_MAX);
+
+    if (__atomic_exchange_n(&rwlock->write_mutex, 0, __ATOMIC_RELEASE) == 2)
+        zx_futex_wake((zx_futex_t*)&rwlock->write_mutex, 1u);
+}
+
+static inline void sync_rwlock_read_lock_slow(sync_rwlock_t* rwlock) {
+    for (;;) {
+        // Back out so that the writer is not kept waiting for this thread.
+        sync_rwlock_read_unlock(rwlock);
+
+        // Wait for the writer to release the lock.  Reading the gate before
+        // checking the state means a release in between is not missed.
+        for (;;) {
+            int gate = __atomic_load_n(&rwlock->read_gate, __ATOMIC_ACQUIRE);
+            if (!(__atomic_load_n(&rwlock->state, __ATOMIC_ACQUIRE) &
+                  SYNC_RWLOCK_WRITER))
+                break;
+            zx_futex_wait((zx_futex_t*)&rwlock->read_gate, gate,
+                          ZX_HANDLE_INVALID, ZX_TIME_INFINITE);
+        }
+
+        if (!(__atomic_add_fetch(&rwlock->state, 1, __ATOMIC_ACQUIRE) &
+              SYNC_RWLOCK_WRITER))
+            return;
+    }
+}
+
+__END_CDECLS
+
+#ifdef __cplusplus
+
+namespace libsync {
+
+// Holds |rwlock| for reading for as long as the guard is in scope.
+class __TA_SCOPED_CAPABILITY ReadLockGuard {
+public:
+    explicit ReadLockGuard(sync_rwlock_t* rwlock)
+        __THREAD_ANNOTATION(__acquire_shared_capability__(rwlock))
+        : rwlock_(rwlock) {
+        sync_rwlock_read_lock(rwlock_);
+    }
+    ~ReadLockGuard() __TA_RELEASE() { sync_rwlock_read_unlock(rwlock_); }
+
+    ReadLockGuard(const ReadLockGuard&) = delete;
+    ReadLockGuard& operator=(const ReadLockGuard&) = delete;
+
+private:
+    sync_rwlock_t* const rwlock_;
+};
+
+// Holds |rwlock| for writing for as long as the guard is in scope.
+class __TA_SCOPED_CAPABILITY WriteLockGuard {
+public:
+    explicit WriteLockGuard(sync_rwlock_t* rwlock) __TA_ACQUIRE(rwlock)
+        : rwlock_(rwlock) {
+        sync_rwlock_write_lock(rwlock_);
+    }
+    ~WriteLockGuard() __TA_RELEASE() { sync_rwlock_write_unlock(rwlock_); }
+
+    WriteLockGuard(const WriteLockGuard&) = delete;
+    WriteLockGuard& operator=(const WriteLockGuard&) = delete;
+
+private:
+    sync_rwlock_t* const rwlock_;
+};
+
+} // namespace libsync
+
+#endif // __cplusplus
+
+#endif // LIB_SYNC_RWLOCK_H_
@@ -0,0 +1,1141 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/syslog/async_logger.h>
+
+#include <lib/syslog/wire_format.h>
+#include <stdio.h>
+#include <string.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Each tag is written as a length byte followed by that many characters, and
+// the tags end with a zero length byte.
+constexpr size_t kMaxTagChars = FX_LOG_MAX_TAG_LEN - 1;
+constexpr size_t kMaxTagPrefixLen = FX_LOG_MAX_TAGS * (1 + kMaxTagChars);
+
+zx_futex_t* AsFutex(std::atomic<int>* value) {
+    return reinterpret_cast<zx_futex_t*>(value);
+}
+
+zx_koid_t GetKoid(zx_handle_t handle) {
+    zx_info_handle_basic_t info;
+    zx_status_t status = zx_object_get_info(handle, ZX_INFO_HANDLE_BASIC,
+                                            &info, sizeof(info), nullptr,
+                                            nullptr);
+    return status == ZX_OK ? info.koid : ZX_KOID_INVALID;
+}
+
+size_t AppendTag(char* dst, const char* tag) {
+    const size_t len = strnlen(tag, kMaxTagChars);
+    dst[0] = static_cast<char>(len);
+    memcpy(dst + 1, tag, len);
+    return 1 + len;
+}
+
+// The kinds of argument that a conversion of a format string takes.
+enum class ArgType : uint8_t {
+    kNone, // "%%"
+    kInt,
+    kLong,
+    kLongLong,
+    kIntMax,
+    kSize,
+    kPtrDiff,
+    kDouble,
+    kLongDouble,
+    kPointer,
+    kString,
+    kInvalid,
+};
+
+// Longer conversion specifications are not supported by deferred formatting,
+// so that the background thread can rebuild them in a fixed buffer.
+constexpr size_t kMaxSpecLen = 24;
+
+struct Conversion {
+    // The character after the conversion specification.
+    const char* end;
+    bool star_width;
+    bool star_precision;
+    ArgType type;
+};
+
+// Parses the conversion specification that starts at the '%' at |spec|.
+void ParseConversion(const char* spec, Conversion* conv) {
+    const char* p = spec + 1;
+    conv->star_width = false;
+    conv->star_precision = false;
+    conv->type = ArgType::kInvalid;
+
+    while (*p != '\0' && strchr("-+ #0", *p) != nullptr) {
+        p++;
+    }
+    if (*p == '*') {
+        conv->star_width = true;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            conv->star_precision = true;
+            p++;
+        } else {
+            while (*p >= '0' && *p <= '9') {
+                p++;
+            }
+        }
+    }
+
+    ArgType int_type = ArgType::kInt;
+    bool is_long = false;
+    bool is_long_double = false;
+    switch (*p) {
+    case 'h':
+        p += p[1] == 'h' ? 2 : 1;
+        break;
+    case 'l':
+        if (p[1] == 'l') {
+            int_type = ArgType::kLongLong;
+            p += 2;
+        } else {
+            int_type = ArgType::kLong;
+            is_long = true;
+            p++;
+        }
+        break;
+    case 'q':
+        int_type = ArgType::kLongLong;
+        p++;
+        break;
+    case 'j':
+        int_type = ArgType::kIntMax;
+        p++;
+        break;
+    case 'z':
+        int_type = ArgType::kSize;
+        p++;
+        break;
+    case 't':
+        int_type = ArgType::kPtrDiff;
+        p++;
+        break;
+    case 'L':
+        is_long_double = true;
+        p++;
+        break;
+    }
+
+    const char c = *p;
+    conv->end = c == '\0' ? p : p + 1;
+    if (static_cast<size_t>(conv->end - spec) > kMaxSpecLen) {
+        return;
+    }
+    switch (c) {
+    case 'd':
+    case 'i':
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+        if (!is_long_double) {
+            conv->type = int_type;
+        }
+        break;
+    case 'c':
+        // Wide characters and strings are not supported.
+        if (!is_long && !is_long_double) {
+            conv->type = ArgType::kInt;
+        }
+        break;
+    case 's':
+        if (!is_long && !is_long_double) {
+            conv->type = ArgType::kString;
+        }
+        break;
+    case 'p':
+        conv->type = ArgType::kPointer;
+        break;
+    case 'a':
+    case 'A':
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+        conv->type = is_long_double ? ArgType::kLongDouble : ArgType::kDouble;
+        break;
+    case '%':
+        if (conv->end == spec + 2) {
+            conv->type = ArgType::kNone;
+        }
+        break;
+    }
+}
+
+// Writes the arguments of a deferred message into a packet, in the order
+// of the conversions of its format string, for the background thread to
+// format.  Strings are copied along with their terminating NUL.
+class ArgWriter {
+public:
+    ArgWriter(char* pos, char* end)
+        : pos_(pos), end_(end) {}
+
+    char* pos() const { return pos_; }
+
+    template <typename T>
+    bool Put(T value) {
+        if (static_cast<size_t>(end_ - pos_) < sizeof(T)) {
+            return false;
+        }
+        memcpy(pos_, &value, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    // Strings too long for the packet are truncated.
+    bool PutString(const char* str) {
+        if (pos_ == end_) {
+            return false;
+        }
+        if (str == nullptr) {
+            str = "(null)";
+        }
+        const size_t len = strnlen(str, end_ - pos_ - 1);
+        memcpy(pos_, str, len);
+        pos_[len] = '\0';
+        pos_ += len + 1;
+        return true;
+    }
+
+private:
+    char* pos_;
+    char* const end_;
+};
+
+// Reads back the arguments written by an |ArgWriter|.
+class ArgReader {
+public:
+    ArgReader(const char* pos, const char* end)
+        : pos_(pos), end_(end) {}
+
+    template <typename T>
+    bool Get(T* value) {
+        if (static_cast<size_t>(end_ - pos_) < sizeof(T)) {
+            return false;
+        }
+        memcpy(value, pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    bool GetString(const char** str) {
+        const size_t len = strnlen(pos_, end_ - pos_);
+        if (len == static_cast<size_t>(end_ - pos_)) {
+            return false;
+        }
+        *str = pos_;
+        pos_ += len + 1;
+        return true;
+    }
+
+private:
+    const char* pos_;
+    const char* const end_;
+};
+
+// Copies the arguments of |format| from |args|.  Returns false if |format|
+// has a conversion that deferred formatting does not support.  Arguments
+// that do not fit are left out, and the message is cut short before them.
+bool CaptureArgs(const char* format, va_list* args, ArgWriter* writer) {
+    bool fits = true;
+    for (const char* p = strchr(format, '%'); p != nullptr;
+         p = strchr(p, '%')) {
+        Conversion conv;
+        ParseConversion(p, &conv);
+        p = conv.end;
+        if (conv.type == ArgType::kInvalid) {
+            return false;
+        }
+        if (!fits) {
+            // Keep checking the format string, but stop reading arguments.
+            continue;
+        }
+        if (conv.star_width) {
+            fits = writer->Put(va_arg(*args, int));
+        }
+        if (fits && conv.star_precision) {
+            fits = writer->Put(va_arg(*args, int));
+        }
+        if (!fits) {
+            continue;
+        }
+        switch (conv.type) {
+        case ArgType::kNone:
+        case ArgType::kInvalid:
+            break;
+        case ArgType::kInt:
+            fits = writer->Put(va_arg(*args, int));
+            break;
+        case ArgType::kLong:
+            fits = writer->Put(va_arg(*args, long));
+            break;
+        case ArgType::kLongLong:
+            fits = writer->Put(va_arg(*args, long long));
+            break;
+        case ArgType::kIntMax:
+            fits = writer->Put(va_arg(*args, intmax_t));
+            break;
+        case ArgType::kSize:
+            fits = writer->Put(va_arg(*args, size_t));
+            break;
+        case ArgType::kPtrDiff:
+            fits = writer->Put(va_arg(*args, ptrdiff_t));
+            break;
+        case ArgType::kDouble:
+            fits = writer->Put(va_arg(*args, double));
+            break;
+        case ArgType::kLongDouble:
+            fits = writer->Put(va_arg(*args, long double));
+            break;
+        case ArgType::kPointer:
+            fits = writer->Put(va_arg(*args, void*));
+            break;
+        case ArgType::kString:
+            fits = writer->PutString(va_arg(*args, const char*));
+            break;
+        }
+    }
+    return true;
+}
+
+// Appends formatted text to a buffer, truncating what does not fit.
+class TextWriter {
+public:
+    TextWriter(char* text, size_t capacity)
+        : text_(text), capacity_(capacity) {}
+
+    size_t len() const { return len_; }
+
+    void Append(const char* str, size_t len) {
+        len = std::min(len, capacity_ - 1 - len_);
+        memcpy(text_ + len_, str, len);
+        len_ += len;
+    }
+
+    template <typename... Args>
+    void Format(const char* spec, Args... args) {
+        const int n = snprintf(text_ + len_, capacity_ - len_, spec, args...);
+        if (n > 0) {
+            len_ = std::min(len_ + static_cast<size_t>(n), capacity_ - 1);
+        }
+    }
+
+    void Terminate() { text_[len_] = '\0'; }
+
+private:
+    char* const text_;
+    const size_t capacity_;
+    size_t len_ = 0u;
+};
+
+// Builds the conversion specification at |spec| into |out|, with the width
+// and precision given by '*' replaced by their values.
+void RebuildSpec(const char* spec, const Conversion& conv, int width,
+                 int precision, char* out, size_t out_size) {
+    size_t len = 0u;
+    for (const char* p = spec; p != conv.end; p++) {
+        if (*p == '*') {
+            const bool is_precision = p > spec && p[-1] == '.';
+            len += snprintf(out + len, out_size - len, "%d",
+                            is_precision ? precision : width);
+        } else {
+            out[len++] = *p;
+        }
+    }
+    out[len] = '\0';
+}
+
+template <typename T>
+bool RenderArg(const char* spec, ArgReader* reader, TextWriter* text) {
+    T value;
+    if (!reader->Get(&value)) {
+        return false;
+    }
+    text->Format(spec, value);
+    return true;
+}
+
+// Formats the message of |format| with the arguments read by |reader|,
+// stopping at the first argument that was left out.
+void RenderArgs(const char* format, ArgReader* reader, TextWriter* text) {
+    const char* p = format;
+    for (;;) {
+        const char* spec = strchr(p, '%');
+        if (spec == nullptr) {
+            text->Append(p, strlen(p));
+            return;
+        }
+        text->Append(p, spec - p);
+
+        Conversion conv;
+        ParseConversion(spec, &conv);
+        p = conv.end;
+        int width = 0;
+        int precision = 0;
+        if ((conv.star_width && !reader->Get(&width)) ||
+            (conv.star_precision && !reader->Get(&precision))) {
+            return;
+        }
+        // Room for a spec with both numbers spelled out.
+        char rebuilt[kMaxSpecLen + 24];
+        RebuildSpec(spec, conv, width, precision, rebuilt, sizeof(rebuilt));
+
+        bool ok = true;
+        switch (conv.type) {
+        case ArgType::kNone:
+            text->Append("%", 1u);
+            break;
+        case ArgType::kInvalid:
+            return;
+        case ArgType::kInt:
+            ok = RenderArg<int>(rebuilt, reader, text);
+            break;
+        case ArgType::kLong:
+            ok = RenderArg<long>(rebuilt, reader, text);
+            break;
+        case ArgType::kLongLong:
+            ok = RenderArg<long long>(rebuilt, reader, text);
+            break;
+        case ArgType::kIntMax:
+            ok = RenderArg<intmax_t>(rebuilt, reader, text);
+            break;
+        case ArgType::kSize:
+            ok = RenderArg<size_t>(rebuilt, reader, text);
+            break;
+        case ArgType::kPtrDiff:
+            ok = RenderArg<ptrdiff_t>(rebuilt, reader, text);
+            break;
+        case ArgType::kDouble:
+            ok = RenderArg<double>(rebuilt, reader, text);
+            break;
+        case ArgType::kLongDouble:
+            ok = RenderArg<long double>(rebuilt, reader, text);
+            break;
+        case ArgType::kPointer:
+            ok = RenderArg<void*>(rebuilt, reader, text);
+            break;
+        case ArgType::kString: {
+            const char* value;
+            ok = reader->GetString(&value);
+            if (ok) {
+                text->Format(rebuilt, value);
+            }
+            break;
+        }
+        }
+        if (!ok) {
+            return;
+        }
+    }
+}
+
+// A ring of packets that one thread formats and the background thread
+// writes to the socket.
+struct Ring {
+    struct Slot {
+        fx_log_packet_t packet;
+        size_t size;
+        // For a deferred message, its format string, and the offset in
+        // |packet.data| of its arguments, which follow the tags.
+        const char* format;
+        size_t args_pos;
+    };
+
+    explicit Ring(uint32_t capacity)
+        : slots(capacity), mask(capacity - 1) {}
+
+    std::vector<Slot> slots;
+    const uint32_t mask;
+
+    // The number of packets consumed by the background thread and produced
+    // by the owning thread.  Both wrap around, and the ring holds the
+    // difference.
+    std::atomic<int> head{0};
+    std::atomic<int> tail{0};
+
+    // The number of threads waiting for |head| to advance.
+    std::atomic<int> head_waiters{0};
+
+    // Whether a thread owns the ring.  The ring of a thread that exits is
+    // released for another thread to take over.
+    std::atomic<bool> claimed{true};
+
+    // Cleared when the logger is destroyed, so that threads forget the ring.
+    std::atomic<bool> logger_alive{true};
+
+    // The number of messages that the owning thread has dropped since it
+    // last wrote one.  Only the owning thread uses this.
+    uint32_t dropped = 0;
+
+    uint32_t size(int head_value, int tail_value) const {
+        return static_cast<uint32_t>(tail_value) -
+               static_cast<uint32_t>(head_value);
+    }
+};
+
+// The rings of the calling thread, one per logger it has written to.
+struct ThreadState {
+    struct Entry {
+        uint64_t logger_id;
+        std::shared_ptr<Ring> ring;
+    };
+
+    ~ThreadState() {
+        for (const Entry& entry : entries) {
+            entry.ring->claimed.store(false, std::memory_order_release);
+        }
+    }
+
+    zx_koid_t tid = ZX_KOID_INVALID;
+    std::vector<Entry> entries;
+};
+
+thread_local ThreadState t_state;
+
+std::atomic<uint64_t> g_next_logger_id{1u};
+
+} // namespace
+
+struct fx_async_logger {
+    explicit fx_async_logger(const fx_async_logger_config_t* config);
+    ~fx_async_logger();
+
+    Ring* GetRing();
+    zx_status_t Log(fx_log_site_t* site, fx_log_severity_t severity,
+                    const char* tag, const char* msg, va_list* args,
+                    bool deferred);
+    void Flush();
+
+    // Returns the minimum severity of messages with |tag| from |site|, or
+    // from no particular site if |site| is null.
+    fx_log_severity_t MinSeverityFor(fx_log_site_t* site, const char* tag);
+    // These must be called with |filter_mutex| held.
+    fx_log_severity_t LookUpSeverity(const char* file, int line,
+                                     const char* tag);
+    void RefreshSites();
+
+    bool FormatPacket(fx_log_severity_t severity, const char* tag,
+                      const char* msg, va_list* args, bool deferred,
+                      Ring::Slot* slot);
+    void WaitForRoom(Ring* ring, int tail);
+
+    // Wakes the background thread if it is waiting for packets.
+    void Kick();
+
+    void Drain();
+    bool DrainRing(Ring* ring);
+    size_t RenderPacket(const Ring::Slot& slot);
+    bool WritePacket(const fx_log_packet_t* packet, size_t size);
+
+    const uint64_t id;
+    std::atomic<fx_log_severity_t> min_severity;
+    const zx_handle_t socket;
+    const uint32_t ring_packets;
+    const fx_log_overflow_policy_t overflow_policy;
+    const zx_koid_t pid;
+
+    char tag_prefix[kMaxTagPrefixLen];
+    size_t tag_prefix_len = 0u;
+
+    std::atomic<uint64_t> dropped_count{0u};
+
+    // A call site whose severity this logger caches.
+    struct Site {
+        Site(fx_log_site_t* site, const char* tag)
+            : site(site), tag(tag != nullptr ? tag : "") {}
+
+        fx_log_site_t* const site;
+        // The tag the site first logged with.  |site->tag| points at it, so
+        // it must not move: sites are kept in a list.
+        const std::string tag;
+        // Whether the site has logged with tags other than |tag|, so that its
+        // severity is looked up for each message instead of cached.
+        bool varying_tags = false;
+    };
+
+    // The severity overrides, and the call sites whose cached severities
+    // they affect.
+    std::mutex filter_mutex;
+    std::map<std::string, fx_log_severity_t> tag_severities;
+    std::map<std::pair<std::string, int>, fx_log_severity_t> site_severities;
+    std::list<Site> sites;
+    std::atomic<bool> has_tag_overrides{false};
+
+    // The rings of all threads, which only the background thread reads
+    // without the lock, from a copy it refreshes when |rings_version| changes.
+    std::mutex rings_mutex;
+    std::vector<std::shared_ptr<Ring>> rings;
+    std::atomic<uint32_t> rings_version{0u};
+
+    std::atomic<int> wake_seq{0};
+    std::atomic<bool> drainer_sleeping{false};
+    std::atomic<bool> stopping{false};
+    // The number of messages the background thread failed to write since it
+    // last wrote one.  Only the background thread uses this.
+    uint32_t write_dropped = 0u;
+    // Where the background thread formats deferred messages.
+    fx_log_packet_t rendered;
+    std::thread drainer;
+};
+
+fx_async_logger::fx_async_logger(const fx_async_logger_config_t* config)
+    : id(g_next_logger_id.fetch_add(1u, std::memory_order_relaxed)),
+      min_severity(config->min_severity),
+      socket(config->log_service_channel),
+      ring_packets(static_cast<uint32_t>(config->ring_packets)),
+      overflow_policy(config->overflow_policy),
+      pid(GetKoid(zx_process_self())) {
+    for (size_t i = 0; i < config->num_tags; i++) {
+        tag_prefix_len += AppendTag(tag_prefix + tag_prefix_len,
+                                    config->tags[i]);
+    }
+    drainer = std::thread([this] { Drain(); });
+}
+
+fx_async_logger::~fx_async_logger() {
+    stopping.store(true);
+    wake_seq.fetch_add(1);
+    zx_futex_wake(AsFutex(&wake_seq), 1u);
+    drainer.join();
+
+    for (const auto& ring : rings) {
+        ring->logger_alive.store(false, std::memory_order_relaxed);
+    }
+    // Let the sites be used with another logger.
+    for (const Site& entry : sites) {
+        __atomic_store_n(&entry.site->min_severity, FX_LOG_SITE_UNRESOLVED,
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&entry.site->logger, nullptr, __ATOMIC_RELEASE);
+        entry.site->tag = nullptr;
+    }
+    zx_handle_close(socket);
+}
+
+Ring* fx_async_logger::GetRing() {
+    auto& entries = t_state.entries;
+    for (const ThreadState::Entry& entry : entries) {
+        if (entry.logger_id == id) {
+            return entry.ring.get();
+        }
+    }
+
+    // Forget the rings of destroyed loggers.
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [](const ThreadState::Entry& entry) {
+                                     return !entry.ring->logger_alive.load(
+                                         std::memory_order_relaxed);
+                                 }),
+                  entries.end());
+
+    std::shared_ptr<Ring> ring;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        for (const auto& candidate : rings) {
+            bool claimed = false;
+            if (candidate->claimed.compare_exchange_strong(
+                    claimed, true, std::memory_order_acquire)) {
+                ring = candidate;
+                break;
+            }
+        }
+        if (!ring) {
+            ring = std::make_shared<Ring>(ring_packets);
+            rings.push_back(ring);
+            rings_version.fetch_add(1u);
+        }
+    }
+    entries.push_back(ThreadState::Entry{id, ring});
+    if (t_state.tid == ZX_KOID_INVALID) {
+        t_state.tid = GetKoid(zx_thread_self());
+    }
+    return ring.get();
+}
+
+zx_status_t fx_async_logger::Log(fx_log_site_t* site,
+                                 fx_log_severity_t severity, const char* tag,
+                                 const char* msg, va_list* args,
+                                 bool deferred) {
+    if (msg == nullptr || severity > FX_LOG_FATAL) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (severity < MinSeverityFor(site, tag)) {
+        return ZX_OK;
+    }
+
+    Ring* ring = GetRing();
+    const int tail = ring->tail.load(std::memory_order_relaxed);
+    if (ring->size(ring->head.load(std::memory_order_acquire), tail) >
+        ring->mask) {
+        if (overflow_policy == FX_LOG_OVERFLOW_DROP) {
+            ring->dropped++;
+            dropped_count.fetch_add(1u, std::memory_order_relaxed);
+            return ZX_ERR_NO_RESOURCES;
+        }
+        WaitForRoom(ring, tail);
+    }
+
+    Ring::Slot& slot = ring->slots[tail & ring->mask];
+    if (!FormatPacket(severity, tag, msg, args, deferred, &slot)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    slot.packet.metadata.dropped_logs = ring->dropped;
+    ring->dropped = 0u;
+    ring->tail.store(tail + 1, std::memory_order_release);
+    Kick();
+    return ZX_OK;
+}
+
+bool fx_async_logger::FormatPacket(fx_log_severity_t severity,
+                                   const char* tag, const char* msg,
+                                   va_list* args, bool deferred,
+                                   Ring::Slot* slot) {
+    fx_log_packet_t* packet = &slot->packet;
+    packet->metadata.pid = pid;
+    packet->metadata.tid = t_state.tid;
+    packet->metadata.time = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    packet->metadata.severity = severity;
+
+    size_t pos = tag_prefix_len;
+    memcpy(packet->data, tag_prefix, pos);
+    if (tag != nullptr) {
+        pos += AppendTag(packet->data + pos, tag);
+    }
+    packet->data[pos++] = '\0';
+
+    if (deferred) {
+        ArgWriter writer(packet->data + pos,
+                         packet->data + sizeof(packet->data));
+        if (!CaptureArgs(msg, args, &writer)) {
+            return false;
+        }
+        slot->format = msg;
+        slot->args_pos = pos;
+        slot->size = writer.pos() - reinterpret_cast<char*>(packet);
+        return true;
+    }
+
+    // Messages too long for the packet are truncated.
+    char* text = packet->data + pos;
+    const size_t capacity = sizeof(packet->data) - pos;
+    size_t len;
+    if (args != nullptr) {
+        const int n = vsnprintf(text, capacity, msg, *args);
+        len = n < 0 ? 0u : std::min(static_cast<size_t>(n), capacity - 1);
+    } else {
+        len = strnlen(msg, capacity - 1);
+        memcpy(text, msg, len);
+    }
+    text[len] = '\0';
+    slot->format = nullptr;
+    slot->size = sizeof(packet->metadata) + pos + len + 1;
+    return true;
+}
+
+fx_log_severity_t fx_async_logger::MinSeverityFor(fx_log_site_t* site,
+                                                  const char* tag) {
+    if (site == nullptr) {
+        if (!has_tag_overrides.load(std::memory_order_relaxed)) {
+            return min_severity.load(std::memory_order_relaxed);
+        }
+        std::lock_guard<std::mutex> lock(filter_mutex);
+        return LookUpSeverity(nullptr, 0, tag);
+    }
+
+    if (__atomic_load_n(&site->logger, __ATOMIC_ACQUIRE) == this) {
+        // The site's tag was set before it was published, and never changes.
+        const fx_log_severity_t cached =
+            __atomic_load_n(&site->min_severity, __ATOMIC_RELAXED);
+        if (cached != FX_LOG_SITE_UNRESOLVED &&
+            strcmp(site->tag, tag != nullptr ? tag : "") == 0) {
+            return cached;
+        }
+        std::lock_guard<std::mutex> lock(filter_mutex);
+        if (cached != FX_LOG_SITE_UNRESOLVED) {
+            // The site logs with more than one tag, so no single cached
+            // severity is right for it.  Letting every message through to
+            // this lookup keeps each tag's override in force.
+            for (Site& entry : sites) {
+                if (entry.site == site) {
+                    entry.varying_tags = true;
+                    break;
+                }
+            }
+            __atomic_store_n(&site->min_severity, FX_LOG_SITE_UNRESOLVED,
+                             __ATOMIC_RELAXED);
+        }
+        return LookUpSeverity(site->file, site->line, tag);
+    }
+    std::lock_guard<std::mutex> lock(filter_mutex);
+    const fx_log_severity_t severity =
+        LookUpSeverity(site->file, site->line, tag);
+    // Sites that another logger caches for are looked up every time.
+    if (__atomic_load_n(&site->logger, __ATOMIC_ACQUIRE) == nullptr) {
+        sites.emplace_back(site, tag);
+        site->tag = sites.back().tag.c_str();
+        __atomic_store_n(&site->min_severity, severity, __ATOMIC_RELAXED);
+        __atomic_store_n(&site->logger, this, __ATOMIC_RELEASE);
+    }
+    return severity;
+}
+
+fx_log_severity_t fx_async_logger::LookUpSeverity(const char* file, int line,
+                                                  const char* tag) {
+    if (file != nullptr && !site_severities.empty()) {
+        auto it = site_severities.find(std::make_pair(std::string(file), line));
+        if (it != site_severities.end()) {
+            return it->second;
+        }
+    }
+    if (tag != nullptr && !tag_severities.empty()) {
+        auto it = tag_severities.find(tag);
+        if (it != tag_severities.end()) {
+            return it->second;
+        }
+    }
+    return min_severity.load(std::memory_order_relaxed);
+}
+
+void fx_async_logger::RefreshSites() {
+    has_tag_overrides.store(!tag_severities.empty(),
+                            std::memory_order_relaxed);
+    for (const Site& entry : sites) {
+        if (entry.varying_tags) {
+            continue;
+        }
+        fx_log_site_t* site = entry.site;
+        __atomic_store_n(&site->min_severity,
+                         LookUpSeverity(site->file, site->line,
+                                        entry.tag.c_str()),
+                         __ATOMIC_RELAXED);
+    }
+}
+
+void fx_async_logger::WaitForRoom(Ring* ring, int tail) {
+    ring->head_waiters.fetch_add(1);
+    for (;;) {
+        const int head = ring->head.load();
+        if (ring->size(head, tail) <= ring->mask) {
+            break;
+        }
+        Kick();
+        zx_futex_wait(AsFutex(&ring->head), head, ZX_HANDLE_INVALID,
+                      ZX_TIME_INFINITE);
+    }
+    ring->head_waiters.fetch_sub(1);
+}
+
+void fx_async_logger::Kick() {
+    // Pairs with the background thread announcing it sleeps before it
+    // checks the rings a last time.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (drainer_sleeping.load(std::memory_order_relaxed)) {
+        wake_seq.fetch_add(1);
+        zx_futex_wake(AsFutex(&wake_seq), 1u);
+    }
+}
+
+void fx_async_logger::Flush() {
+    std::vector<std::pair<std::shared_ptr<Ring>, int>> targets;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        for (const auto& ring : rings) {
+            targets.emplace_back(ring,
+                                 ring->tail.load(std::memory_order_acquire));
+        }
+    }
+    Kick();
+    for (const auto& target : targets) {
+        Ring* ring = target.first.get();
+        ring->head_waiters.fetch_add(1);
+        for (;;) {
+            const int head = ring->head.load();
+            // The head has caught up once it is no longer behind the target.
+            if (static_cast<int32_t>(static_cast<uint32_t>(target.second) -
+                                     static_cast<uint32_t>(head)) <= 0) {
+                break;
+            }
+            zx_futex_wait(AsFutex(&ring->head), head, ZX_HANDLE_INVALID,
+                          ZX_TIME_INFINITE);
+        }
+        ring->head_waiters.fetch_sub(1);
+    }
+}
+
+void fx_async_logger::Drain() {
+    std::vector<std::shared_ptr<Ring>> drained_rings;
+    uint32_t drained_version = 0u;
+    for (;;) {
+        const uint32_t version = rings_version.load(std::memory_order_acquire);
+        if (version != drained_version) {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            drained_rings = rings;
+            drained_version = version;
+        }
+
+        bool wrote = false;
+        for (const auto& ring : drained_rings) {
+            wrote |= DrainRing(ring.get());
+        }
+        if (wrote) {
+            continue;
+        }
+
+        // Announce that this thread sleeps, then look for packets one last
+        // time, so that a thread that writes one either sees the
+        // announcement and wakes this one, or has its packet seen here.
+        const int seq = wake_seq.load();
+        drainer_sleeping.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool pending = rings_version.load() != drained_version;
+        for (const auto& ring : drained_rings) {
+            pending = pending || ring->head.load(std::memory_order_relaxed) !=
+                                     ring->tail.load();
+        }
+        if (!pending) {
+            if (stopping.load()) {
+                break;
+            }
+            zx_futex_wait(AsFutex(&wake_seq), seq, ZX_HANDLE_INVALID,
+                          ZX_TIME_INFINITE);
+        }
+        drainer_sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+bool fx_async_logger::DrainRing(Ring* ring) {
+    int head = ring->head.load(std::memory_order_relaxed);
+    const int tail = ring->tail.load(std::memory_order_acquire);
+    if (head == tail) {
+        return false;
+    }
+    for (; head != tail; head++) {
+        Ring::Slot& slot = ring->slots[head & ring->mask];
+        slot.packet.metadata.dropped_logs += write_dropped;
+        const bool written =
+            slot.format != nullptr
+                ? WritePacket(&rendered, RenderPacket(slot))
+                : WritePacket(&slot.packet, slot.size);
+        if (written) {
+            write_dropped = 0u;
+        } else {
+            write_dropped = slot.packet.metadata.dropped_logs + 1;
+            dropped_count.fetch_add(1u, std::memory_order_relaxed);
+        }
+        ring->head.store(head + 1);
+        if (ring->head_waiters.load() > 0) {
+            zx_futex_wake(AsFutex(&ring->head), UINT32_MAX);
+        }
+    }
+    return true;
+}
+
+size_t fx_async_logger::RenderPacket(const Ring::Slot& slot) {
+    rendered.metadata = slot.packet.metadata;
+    memcpy(rendered.data, slot.packet.data, slot.args_pos);
+
+    ArgReader reader(slot.packet.data + slot.args_pos,
+                     reinterpret_cast<const char*>(&slot.packet) + slot.size);
+    TextWriter text(rendered.data + slot.args_pos,
+                    sizeof(rendered.data) - slot.args_pos);
+    RenderArgs(slot.format, &reader, &text);
+    text.Terminate();
+    return sizeof(rendered.metadata) + slot.args_pos + text.len() + 1;
+}
+
+bool fx_async_logger::WritePacket(const fx_log_packet_t* packet,
+                                  size_t size) {
+    for (;;) {
+        zx_status_t status =
+            zx_socket_write(socket, 0, packet, size, nullptr);
+        if (status != ZX_ERR_SHOULD_WAIT) {
+            return status == ZX_OK;
+        }
+        // Unlike the threads that log, this one can afford to wait for the
+        // log service to catch up.
+        zx_signals_t observed = 0u;
+        status = zx_object_wait_one(socket,
+                                    ZX_SOCKET_WRITABLE | ZX_SOCKET_PEER_CLOSED,
+                                    ZX_TIME_INFINITE, &observed);
+        if (status != ZX_OK || (observed & ZX_SOCKET_PEER_CLOSED)) {
+            return false;
+        }
+    }
+}
+
+zx_status_t fx_async_logger_create(const fx_async_logger_config_t* config,
+                                   fx_async_logger_t** out_logger) {
+    if (config->num_tags > FX_LOG_MAX_TAGS ||
+        config->log_service_channel == ZX_HANDLE_INVALID) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    uint32_t ring_packets = 1u;
+    const size_t requested = config->ring_packets
+                                 ? config->ring_packets
+                                 : FX_ASYNC_LOGGER_DEFAULT_RING_PACKETS;
+    while (ring_packets < requested) {
+        ring_packets *= 2u;
+    }
+    fx_async_logger_config_t adjusted = *config;
+    adjusted.ring_packets = ring_packets;
+    *out_logger = new fx_async_logger(&adjusted);
+    return ZX_OK;
+}
+
+void fx_async_logger_destroy(fx_async_logger_t* logger) {
+    delete logger;
+}
+
+fx_log_severity_t fx_async_logger_get_min_severity(fx_async_logger_t* logger) {
+    return logger->min_severity.load(std::memory_order_relaxed);
+}
+
+void fx_async_logger_set_min_severity(fx_async_logger_t* logger,
+                                      fx_log_severity_t severity) {
+    std::lock_guard<std::mutex> lock(logger->filter_mutex);
+    logger->min_severity.store(severity, std::memory_order_relaxed);
+    logger->RefreshSites();
+}
+
+void fx_async_logger_set_tag_severity(fx_async_logger_t* logger,
+                                      const char* tag,
+                                      fx_log_severity_t severity) {
+    std::lock_guard<std::mutex> lock(logger->filter_mutex);
+    logger->tag_severities[tag] = severity;
+    logger->RefreshSites();
+}
+
+void fx_async_logger_clear_tag_severity(fx_async_logger_t* logger,
+                                        const char* tag) {
+    std::lock_guard<std::mutex> lock(logger->filter_mutex);
+    logger->tag_severities.erase(tag);
+    logger->RefreshSites();
+}
+
+void fx_async_logger_set_site_severity(fx_async_logger_t* logger,
+                                       const char* file, int line,
+                                       fx_log_severity_t severity) {
+    std::lock_guard<std::mutex> lock(logger->filter_mutex);
+    logger->site_severities[std::make_pair(std::string(file), line)] =
+        severity;
+    logger->RefreshSites();
+}
+
+void fx_async_logger_clear_site_severity(fx_async_logger_t* logger,
+                                         const char* file, int line) {
+    std::lock_guard<std::mutex> lock(logger->filter_mutex);
+    logger->site_severities.erase(std::make_pair(std::string(file), line));
+    logger->RefreshSites();
+}
+
+uint64_t fx_async_logger_get_dropped_count(fx_async_logger_t* logger) {
+    return logger->dropped_count.load(std::memory_order_relaxed);
+}
+
+void fx_async_logger_flush(fx_async_logger_t* logger) {
+    logger->Flush();
+}
+
+zx_status_t fx_async_logger_logf(fx_async_logger_t* logger,
+                                 fx_log_severity_t severity, const char* tag,
+                                 const char* msg, ...) {
+    va_list args;
+    va_start(args, msg);
+    zx_status_t status = logger->Log(nullptr, severity, tag, msg, &args, false);
+    va_end(args);
+    return status;
+}
+
+zx_status_t fx_async_logger_logvf(fx_async_logger_t* logger,
+                                  fx_log_severity_t severity, const char* tag,
+                                  const char* msg, va_list args) {
+    va_list args_copy;
+    va_copy(args_copy, args);
+    zx_status_t status =
+        logger->Log(nullptr, severity, tag, msg, &args_copy, false);
+    va_end(args_copy);
+    return status;
+}
+
+zx_status_t fx_async_logger_log(fx_async_logger_t* logger,
+                                fx_log_severity_t severity, const char* tag,
+                                const char* msg) {
+    return logger->Log(nullptr, severity, tag, msg, nullptr, false);
+}
+
+zx_status_t fx_async_logger_logf_deferred(fx_async_logger_t* logger,
+                                          fx_log_severity_t severity,
+                                          const char* tag, const char* format,
+                                          ...) {
+    va_list args;
+    va_start(args, format);
+    zx_status_t status =
+        logger->Log(nullptr, severity, tag, format, &args, true);
+    va_end(args);
+    return status;
+}
+
+zx_status_t fx_async_logger_logvf_deferred(fx_async_logger_t* logger,
+                                           fx_log_severity_t severity,
+                                           const char* tag,
+                                           const char* format, va_list args) {
+    va_list args_copy;
+    va_copy(args_copy, args);
+    zx_status_t status =
+        logger->Log(nullptr, severity, tag, format, &args_copy, true);
+    va_end(args_copy);
+    return status;
+}
+
+zx_status_t fx_async_logger_logf_at(fx_async_logger_t* logger,
+                                    fx_log_site_t* site,
+                                    fx_log_severity_t severity,
+                                    const char* tag, const char* msg, ...) {
+    va_list args;
+    va_start(args, msg);
+    zx_status_t status = logger->Log(site, severity, tag, msg, &args, false);
+    va_end(args);
+    return status;
+}
+
+zx_status_t fx_async_logger_logf_deferred_at(fx_async_logger_t* logger,
+                                             fx_log_site_t* site,
+                                             fx_log_severity_t severity,
+                                             const char* tag,
+                                             const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    zx_status_t status = logger->Log(site, severity, tag, format, &args, true);
+    va_end(args);
+    return status;
+}
@@ -0,0 +1,270 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// This header contains the definition of the asynchronous logger object.
+
+#ifndef LIB_SYSLOG_ASYNC_LOGGER_H_
+#define LIB_SYSLOG_ASYNC_LOGGER_H_
+
+#include <limits.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <lib/syslog/logger.h>
+#include <zircon/types.h>
+
+// Default number of packets that each thread's ring of an asynchronous
+// logger holds.
+#define FX_ASYNC_LOGGER_DEFAULT_RING_PACKETS (16)
+
+// The minimum severity of a call site whose severity has not been looked up
+// yet, which lets every message through to the lookup.
+#define FX_LOG_SITE_UNRESOLVED INT_MIN
+
+__BEGIN_CDECLS
+
+// What a thread does when it logs a message and its ring is full.
+typedef enum fx_log_overflow_policy {
+    // Drop the message.  The number of messages dropped is reported to the
+    // log service with the next message written, and is available from
+    // |fx_async_logger_get_dropped_count()|.
+    FX_LOG_OVERFLOW_DROP = 0,
+
+    // Wait for the background thread to make room.
+    FX_LOG_OVERFLOW_BLOCK = 1,
+} fx_log_overflow_policy_t;
+
+// Configuration for an asynchronous logger object.
+typedef struct fx_async_logger_config {
+    // The minimum log severity.
+    // Log messages with lower severity will be discarded.
+    fx_log_severity_t min_severity;
+
+    // The log service socket to which the logger writes, as for
+    // |fx_logger_config_t.log_service_channel|.
+    // logger takes ownership of this handle.
+    zx_handle_t log_service_channel;
+
+    // An array of tag strings to associate with all messages written
+    // by this logger.  Tags will be truncated if they are (individually) longer
+    // than |FX_LOG_MAX_TAG_LEN|.
+    const char** tags;
+
+    // Number of tag strings.  Must be no more than |FX_LOG_MAX_TAGS|.
+    size_t num_tags;
+
+    // The number of packets that each thread's ring holds, rounded up to a
+    // power of two, or 0 for |FX_ASYNC_LOGGER_DEFAULT_RING_PACKETS|.
+    size_t ring_packets;
+
+    // What to do when a thread's ring is full.
+    fx_log_overflow_policy_t overflow_policy;
+} fx_async_logger_config_t;
+
+// Opaque type representing an asynchronous logger object.
+//
+// Writing a message formats it into a ring of packets of the calling thread,
+// without taking locks or making system calls, and a background thread of
+// the logger writes the packets to the log service socket.  This takes the
+// socket writes off of latency-sensitive threads.
+//
+// Each thread gets a ring of its own the first time it logs to the logger,
+// which it keeps until it exits; the rings of exited threads are reused.
+// Messages of one thread are written in order, but messages of different
+// threads may be written in a different order than they were logged; their
+// timestamps tell the actual order.
+typedef struct fx_async_logger fx_async_logger_t;
+
+// A call site of an asynchronous logger, which caches the minimum severity
+// that applies to its messages, so that checking whether a message is
+// enabled takes one load.  The logger updates the cached severity whenever
+// its minimum severity or its overrides change.
+//
+// Declare call sites with |FX_LOG_SITE_INIT| in static storage, as the
+// |FX_ASYNC_LOGF| macros do, and use each with only one logger.
+//
+// The severity is cached for the tag the site first logs with.  A site
+// that goes on to log with other tags stops being cached, and each of its
+// messages then takes the logger's lock to look up the severity for its tag.
+typedef struct fx_log_site {
+    const char* file;
+    int line;
+
+    // Private state, which only the logger modifies, atomically.
+    fx_log_severity_t min_severity;
+    fx_async_logger_t* logger;
+    // The logger's copy of the tag |min_severity| was looked up for.
+    const char* tag;
+} fx_log_site_t;
+
+#define FX_LOG_SITE_INIT \
+    { __FILE__, __LINE__, FX_LOG_SITE_UNRESOLVED, NULL, NULL }
+
+// Returns true if messages with the given severity may be enabled at |site|.
+static inline bool fx_log_site_is_enabled(const fx_log_site_t* site,
+                                          fx_log_severity_t severity) {
+    return severity >= __atomic_load_n(&site->min_severity, __ATOMIC_RELAXED);
+}
+
+// Creates an asynchronous logger object from the specified configuration, and
+// starts its background thread.
+//
+// This will return ZX_ERR_INVALID_ARGS if |num_tags| is more than
+// |FX_LOG_MAX_TAGS| or |log_service_channel| is invalid.
+// |config| can be safely deleted after this function returns.
+zx_status_t fx_async_logger_create(const fx_async_logger_config_t* config,
+                                   fx_async_logger_t** out_logger);
+
+// Destroys an asynchronous logger object, after its background thread has
+// written all of the messages logged before this call.
+//
+// This closes |log_service_channel| which was passed in
+// |fx_async_logger_config_t|.  No thread may use the logger during or after
+// this call.
+void fx_async_logger_destroy(fx_async_logger_t* logger);
+
+// Gets the logger's minimum log severity.
+fx_log_severity_t fx_async_logger_get_min_severity(fx_async_logger_t* logger);
+
+// Sets logger severity
+void fx_async_logger_set_min_severity(fx_async_logger_t* logger,
+                                      fx_log_severity_t severity);
+
+// Overrides the minimum log severity for messages with the given tag, such
+// as to enable verbose messages for one part of a program.  The override
+// applies to the tag passed with each message, not to the tags of the
+// logger's configuration.
+void fx_async_logger_set_tag_severity(fx_async_logger_t* logger,
+                                      const char* tag,
+                                      fx_log_severity_t severity);
+
+// Removes the override of the minimum log severity for the given tag.
+void fx_async_logger_clear_tag_severity(fx_async_logger_t* logger,
+                                        const char* tag);
+
+// Overrides the minimum log severity for the call sites at the given source
+// line, which take precedence over the overrides for their tags.
+void fx_async_logger_set_site_severity(fx_async_logger_t* logger,
+                                       const char* file, int line,
+                                       fx_log_severity_t severity);
+
+// Removes the override of the minimum log severity for the given source
+// line.
+void fx_async_logger_clear_site_severity(fx_async_logger_t* logger,
+                                         const char* file, int line);
+
+// Gets the number of messages dropped so far because a ring was full or the
+// socket could not be written.
+uint64_t fx_async_logger_get_dropped_count(fx_async_logger_t* logger);
+
+// Blocks until the background thread has written, or dropped, every message
+// that was logged before this call.
+void fx_async_logger_flush(fx_async_logger_t* logger);
+
+// Writes formatted message to a logger.
+// The message will be discarded if |severity| is less than the logger's
+// minimum log severity.
+// The |tag| may be NULL, in which case no additional tags are added to the
+// log message.
+// The |tag| will be truncated if it is longer than |FX_LOG_MAX_TAG_LEN|.
+// No message is written if |message| is NULL.
+// Returns ZX_ERR_NO_RESOURCES if the message is dropped because the calling
+// thread's ring is full.
+zx_status_t fx_async_logger_logf(fx_async_logger_t* logger,
+                                 fx_log_severity_t severity, const char* tag,
+                                 const char* msg, ...);
+
+// Writes formatted message to a logger using varargs.
+// Behaves like |fx_async_logger_logf()|.
+zx_status_t fx_async_logger_logvf(fx_async_logger_t* logger,
+                                  fx_log_severity_t severity, const char* tag,
+                                  const char* msg, va_list args);
+
+// Writes a message to a logger.
+// Behaves like |fx_async_logger_logf()|, but does not format |msg|.
+zx_status_t fx_async_logger_log(fx_async_logger_t* logger,
+                                fx_log_severity_t severity, const char* tag,
+                                const char* msg);
+
+// Writes formatted message to a logger like |fx_async_logger_logf()|, but
+// leaves the formatting to the background thread.
+// The calling thread only copies the arguments into its ring, which costs
+// much less than formatting them, so this suits messages logged on hot
+// paths.  Strings passed for "%s" are copied, but |format| itself is not,
+// so it must stay valid until the logger is destroyed, as string literals
+// do.
+// Supports the conversions of printf except "%n", wide characters and
+// wide strings, for which this returns ZX_ERR_INVALID_ARGS.  Arguments
+// that do not fit in a packet are left out, and the message is cut short
+// before them.
+zx_status_t fx_async_logger_logf_deferred(fx_async_logger_t* logger,
+                                          fx_log_severity_t severity,
+                                          const char* tag, const char* format,
+                                          ...);
+
+// Writes formatted message to a logger using varargs.
+// Behaves like |fx_async_logger_logf_deferred()|.
+zx_status_t fx_async_logger_logvf_deferred(fx_async_logger_t* logger,
+                                           fx_log_severity_t severity,
+                                           const char* tag,
+                                           const char* format, va_list args);
+
+// Writes formatted message to a logger from a call site like
+// |fx_async_logger_logf()|, but discards the message if |severity| is less
+// than the minimum severity of |site|, which takes the logger's overrides
+// into account.
+// Messages from sites with overrides are filtered without taking locks, but
+// messages written by the other functions take a lock while the logger has
+// tag overrides.
+zx_status_t fx_async_logger_logf_at(fx_async_logger_t* logger,
+                                    fx_log_site_t* site,
+                                    fx_log_severity_t severity,
+                                    const char* tag, const char* msg, ...);
+
+// Writes formatted message to a logger from a call site like
+// |fx_async_logger_logf_at()|, but formats it like
+// |fx_async_logger_logf_deferred()|.
+zx_status_t fx_async_logger_logf_deferred_at(fx_async_logger_t* logger,
+                                             fx_log_site_t* site,
+                                             fx_log_severity_t severity,
+                                             const char* tag,
+                                             const char* format, ...);
+
+#define _FX_ASYNC_LOGF(function, logger, severity, tag, message, ...)   \
+    do {                                                                \
+        static fx_log_site_t _fx_log_site = FX_LOG_SITE_INIT;           \
+        if (fx_log_site_is_enabled(&_fx_log_site, (severity))) {        \
+            function((logger), &_fx_log_site, (severity), (tag),        \
+                     (message), __VA_ARGS__);                           \
+        }                                                               \
+    } while (0)
+
+// Writes formatted message to an asynchronous logger, honoring the logger's
+// overrides for this call site and |tag| at the cost of one load when the
+// message is discarded.
+// |severity| is one of DEBUG, INFO, WARNING, ERROR, FATAL
+// |tag| is a tag to associated with the message, or NULL if none.
+// |message| is the message to write.
+#define FX_ASYNC_LOGF(logger, severity, tag, message, ...)               \
+    _FX_ASYNC_LOGF(fx_async_logger_logf_at, logger, (FX_LOG_##severity), \
+                   tag, message, __VA_ARGS__)
+
+// Writes formatted message to an asynchronous logger like |FX_ASYNC_LOGF|,
+// deferring the formatting like |fx_async_logger_logf_deferred()|.
+#define FX_ASYNC_LOGF_DEFERRED(logger, severity, tag, message, ...)       \
+    _FX_ASYNC_LOGF(fx_async_logger_logf_deferred_at, logger,              \
+                   (FX_LOG_##severity), tag, message, __VA_ARGS__)
+
+// Writes formatted verbose message to an asynchronous logger like
+// |FX_ASYNC_LOGF|.
+// |verbosity| is positive integer.
+#define FX_ASYNC_VLOGF(logger, verbosity, tag, message, ...)     \
+    _FX_ASYNC_LOGF(fx_async_logger_logf_at, logger, -(verbosity), \
+                   tag, message, __VA_ARGS__)
+
+__END_CDECLS
+
+#endif // LIB_SYSLOG_ASYNC_LOGGER_H_
@@ -0,0 +1,293 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// The ABI-stable entry points used by trace instrumentation macros, and the
+// macros themselves.
+//
+// Trace events write records into the trace buffer of the trace engine, if
+// tracing is started and the category of the event is enabled.  When it is
+// not, each macro costs one call to check the category, and none of its
+// arguments are evaluated.
+//
+// Events take up to |TRACE_MAX_ARGS| arguments, as key/value pairs: a
+// string literal key followed by a value of a supported type.  In C++ the
+// supported types are bool, the integer and floating-point types, enums,
+// nullptr, C strings, std::string, pointers, and trace_arg_value_t.  C
+// supports the same types except enums, nullptr and std::string.
+//
+// Category and name arguments must be string literals, or otherwise stay
+// valid until the trace engine stops.
+//
+// Example:
+//
+//     TRACE_DURATION("gfx", "Render", "frame", frame_number,
+//                    "width", width, "height", height);
+//
+
+#ifndef TRACE_EVENT_H_
+#define TRACE_EVENT_H_
+
+#include <trace/internal/event_internal.h>
+
+// Returns true if tracing is enabled.
+//
+// Usage:
+//
+//     if (TRACE_ENABLED()) {
+//         // do something possibly expensive only when tracing is enabled
+//     }
+//
+#define TRACE_ENABLED() (trace_is_enabled())
+
+// Returns true if tracing of the specified category has been enabled (which
+// implies that |TRACE_ENABLED()| is also true).
+//
+// |category_literal| must be a null-terminated static string constant.
+//
+// Usage:
+//
+//     if (TRACE_CATEGORY_ENABLED("category")) {
+//         // do something possibly expensive only when tracing this category
+//     }
+//
+#define TRACE_CATEGORY_ENABLED(category_literal) \
+    (trace_is_category_enabled(category_literal))
+
+// Returns a new unique 64-bit unsigned integer (within this process).
+// Each invocation returns a different non-zero value.
+// Useful for generating identifiers for async and flow events.
+//
+// Usage:
+//
+//     trace_async_id_t async_id = TRACE_NONCE();
+//     TRACE_ASYNC_BEGIN("category", "name", async_id);
+//     // a little while later...
+//     TRACE_ASYNC_END("category", "name", async_id);
+//
+#define TRACE_NONCE() (trace_generate_nonce())
+
+// Writes an instant event representing a single moment in time (a probe).
+//
+// Instant events may optionally be associated with a scope: thread, process,
+// or global, usually TRACE_SCOPE_THREAD.
+//
+// |category_literal| and |name_literal| must be null-terminated static
+// string constants.
+// |scope| is the scope to which the instant event applies (thread, process,
+// or global).
+// |args| is the list of argument key/value pairs.
+//
+// Usage:
+//
+//     TRACE_INSTANT("category", "name", TRACE_SCOPE_PROCESS, "x", x, "y", y);
+//
+#define TRACE_INSTANT(category_literal, name_literal, scope, args...) \
+    TRACE_INTERNAL_INSTANT((category_literal), (name_literal), (scope), args)
+
+// Writes a counter event with the specified id.
+//
+// The arguments to this event are numeric samples, which are typically
+// represented by the visualizer as a stacked area chart.  The id serves to
+// distinguish multiple instances of counters which share the same category
+// and name within the same process.
+//
+// |category_literal| and |name_literal| must be null-terminated static
+// string constants.
+// |counter_id| is the correlation id of the counter.
+// Must be unique for a given process, category, and name combination.
+// |args| is the list of argument key/value pairs, of which there must be at
+// least one.
+//
+// Usage:
+//
+//     TRACE_COUNTER("category", "name", 0, "x", x, "y", y);
+//
+#define TRACE_COUNTER(category_literal, name_literal, counter_id, arg1, \
+                      args...)                                          \
+    TRACE_INTERNAL_COUNTER((category_literal), (name_literal),          \
+                           (counter_id), arg1, args)
+
+// Writes a duration event which ends when the current scope exits.
+//
+// Durations describe work which is happening synchronously on one thread.
+// They can be nested to represent a control flow stack.
+//
+// |category_literal| and |name_literal| must be null-terminated static
+// string constants.
+// |args| is the list of argument key/value pairs.
+//
+// Usage:
+//
+//     void function(int arg) {
+//         TRACE_DURATION("category", "name", "arg", arg);
+//         // do something useful here
+//     }
+//
+#define TRACE_DURATION(category_literal, name_literal, args...) \
+    TRACE_INTERNAL_DURATION((category_literal), (name_literal), args)
+
+// Writes a duration begin event only.
+// This event must be matched by a duration end event with the same
+// category and name.
+//
+// Durations describe work which is happening synchronously on one thread.
+// They can be nested to represent a control flow stack.
+//
+// |category_literal| and |name_literal| must be null-terminated static
+// string constants.
+// |args| is the list of argument key/value pairs.
+//
+// Usage:
+//
+//     TRACE_DURATION_BEGIN("category", "name", "x", x);
+//
+#define TRACE_DURATION_BEGIN(category_literal, name_literal, args...) \
+    TRACE_INTERNAL_DURATION_BEGIN((category_literal), (name_literal), args)
+
+// Writes a duration end event only.
+//
+// Durations describe work which is happening synchronously on one thread.
+// They can be nested to represent a control flow stack.
+//
+// |category_literal| and |name_literal| must be null-terminated static
+// string constants.
+// |args| is the list of argument key/value pairs.
+//
+// Usage:
+//
+//     TRACE_DURATION_END("category", "name", "x", x);
+//
+#define TRACE_DURATION_END(category_literal, name_literal, args...) \
+    TRACE_INTERNAL_DURATION_END((category_literal), (name_literal), args)
+
+// Writes an asynchronous begin event with the specified id.
+// This event may be followed by async instant events and must be matched by
+// an async end event with the same category, name, and id.
+//
+// Asynchronous events describe work which is happening asynchronously and
+// which may span multiple threads.  Asynchronous events do not nest.  The id
+// serves to correlate the progress of distinct asynchronous operations which
+// share the same category and name within the same process.
+//
+// |category_literal| and |name_literal| must be null-terminated static
+// string constants.
+// |async_id| is the correlation id of the asynchronous operation.
+// Must be unique for a given process, category, and name combination.
+// |args| is the list of argument key/value pairs.
+//
+// Usage:
+//
+//     trace_async_id_t async_id = 11;
+//     TRACE_ASYNC_BEGIN("category", "name", async_id, "x", x);
+//
+#define TRACE_ASYNC_BEGIN(category_literal, name_literal, async_id, args...) \
+    TRACE_INTERNAL_ASYNC_BEGIN((category_literal), (name_literal),           \
+                               (async_id), args)
+
+// Writes an asynchronous instant event with the specified id.
+//
+// |category_literal| and |name_literal| must be null-terminated static
+// string constants.
+// |async_id| is the correlation id of the asynchronous operation.
+// Must be unique for a given process, category, and name combination.
+// |args| is the list of argument key/value pairs.
+//
+// Usage:
+//
+//     trace_async_id_t async_id = 11;
+//     TRACE_ASYNC_INSTANT("category", "name", async_id, "x", x);
+//
+#define TRACE_ASYNC_INSTANT(category_literal, name_literal, async_id,  \
+                            args...)                                   \
+    TRACE_INTERNAL_ASYNC_INSTANT((category_literal), (name_literal),   \
+                                 (async_id), args)
+
+// Writes an asynchronous end event with the specified id.
+//
+// |category_literal| and |name_literal| must be null-terminated static
+// string constants.
+// |async_id| is the correlation id of the asynchronous operation.
+// Must be unique for a given process, category, and name combination.
+// |args| is the list of argument key/value pairs.
+//
+// Usage:
+//
+//     trace_async_id_t async_id = 11;
+//     TRACE_ASYNC_END("category", "name", async_id, "x", x);
+//
+#define TRACE_ASYNC_END(category_literal, name_literal, async_id, args...) \
+    TRACE_INTERNAL_ASYNC_END((category_literal), (name_literal),           \
+                             (async_id), args)
+
+// Writes a flow begin event with the specified id.
+// This event may be followed by flow steps events and must be matched by
+// a flow end event with the same category, name, and id.
+//
+// Flow events describe control flow handoffs between threads or across
+// processes.  They are typically represented as arrows in a visualizer.
+// Flow arrows are from the end of the duration event which encloses the
+// beginning of the flow to the beginning of the duration event which
+// encloses the next step or the end of the flow.  The id serves to
+// correlate flows which share the same category and name across processes.
+//
+// This event must be enclosed in a duration event which represents where
+// the flow handoff occurs.
+//
+// |category_literal| and |name_literal| must be null-terminated static
+// string constants.
+// |flow_id| is the correlation id of the flow.
+// Must be unique for a given category and name combination.
+// |args| is the list of argument key/value pairs.
+//
+// Usage:
+//
+//     trace_flow_id_t flow_id = 555;
+//     TRACE_FLOW_BEGIN("category", "name", flow_id, "x", x);
+//
+#define TRACE_FLOW_BEGIN(category_literal, name_literal, flow_id, args...) \
+    TRACE_INTERNAL_FLOW_BEGIN((category_literal), (name_literal),          \
+                              (flow_id), args)
+
+// Writes a flow step event with the specified id.
+//
+// This event must be enclosed in a duration event which represents where
+// the flow handoff occurs.
+//
+// |category_literal| and |name_literal| must be null-terminated static
+// string constants.
+// |flow_id| is the correlation id of the flow.
+// Must be unique for a given category and name combination.
+// |args| is the list of argument key/value pairs.
+//
+// Usage:
+//
+//     trace_flow_id_t flow_id = 555;
+//     TRACE_FLOW_STEP("category", "name", flow_id, "x", x);
+//
+#define TRACE_FLOW_STEP(category_literal, name_literal, flow_id, args...) \
+    TRACE_INTERNAL_FLOW_STEP((category_literal), (name_literal),          \
+                             (flow_id), args)
+
+// Writes a flow end event with the specified id.
+//
+// This event must be enclosed in a duration event which represents where
+// the flow handoff occurs.
+//
+// |category_literal| and |name_literal| must be null-terminated static
+// string constants.
+// |flow_id| is the correlation id of the flow.
+// Must be unique for a given category and name combination.
+// |args| is the list of argument key/value pairs.
+//
+// Usage:
+//
+//     trace_flow_id_t flow_id = 555;
+//     TRACE_FLOW_END("category", "name", flow_id, "x", x);
+//
+#define TRACE_FLOW_END(category_literal, name_literal, flow_id, args...) \
+    TRACE_INTERNAL_FLOW_END((category_literal), (name_literal),          \
+                            (flow_id), args)
+
+#endif // TRACE_EVENT_H_
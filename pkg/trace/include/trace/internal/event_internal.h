@@ -0,0 +1,454 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// Internal implementation of <trace/event.h>.
+// This is not part of the public API: use <trace/event.h> instead.
+//
+
+#ifndef TRACE_INTERNAL_EVENT_INTERNAL_H_
+#define TRACE_INTERNAL_EVENT_INTERNAL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <trace-engine/context.h>
+#include <trace-engine/instrumentation.h>
+#include <trace/internal/pairs_internal.h>
+#include <zircon/compiler.h>
+
+#ifdef __cplusplus
+#include <string>
+#include <type_traits>
+#endif
+
+__BEGIN_CDECLS
+
+// Registers the names of |args|, which the trace macros leave in their
+// |inline_string| fields as literals, into the string table.
+void trace_internal_complete_args(trace_context_t* context,
+                                  trace_arg_t* args, size_t num_args);
+
+// Each of these writes a record for the current thread with the current
+// time, then releases |context|.
+void trace_internal_write_instant_event_record_and_release_context(
+    trace_context_t* context,
+    const trace_string_ref_t* category_ref,
+    const char* name_literal,
+    trace_scope_t scope,
+    const trace_arg_t* args, size_t num_args);
+
+void trace_internal_write_counter_event_record_and_release_context(
+    trace_context_t* context,
+    const trace_string_ref_t* category_ref,
+    const char* name_literal,
+    trace_counter_id_t counter_id,
+    const trace_arg_t* args, size_t num_args);
+
+void trace_internal_write_duration_begin_event_record_and_release_context(
+    trace_context_t* context,
+    const trace_string_ref_t* category_ref,
+    const char* name_literal,
+    const trace_arg_t* args, size_t num_args);
+
+void trace_internal_write_duration_end_event_record_and_release_context(
+    trace_context_t* context,
+    const trace_string_ref_t* category_ref,
+    const char* name_literal,
+    const trace_arg_t* args, size_t num_args);
+
+void trace_internal_write_async_begin_event_record_and_release_context(
+    trace_context_t* context,
+    const trace_string_ref_t* category_ref,
+    const char* name_literal,
+    trace_async_id_t async_id,
+    const trace_arg_t* args, size_t num_args);
+
+void trace_internal_write_async_instant_event_record_and_release_context(
+    trace_context_t* context,
+    const trace_string_ref_t* category_ref,
+    const char* name_literal,
+    trace_async_id_t async_id,
+    const trace_arg_t* args, size_t num_args);
+
+void trace_internal_write_async_end_event_record_and_release_context(
+    trace_context_t* context,
+    const trace_string_ref_t* category_ref,
+    const char* name_literal,
+    trace_async_id_t async_id,
+    const trace_arg_t* args, size_t num_args);
+
+void trace_internal_write_flow_begin_event_record_and_release_context(
+    trace_context_t* context,
+    const trace_string_ref_t* category_ref,
+    const char* name_literal,
+    trace_flow_id_t flow_id,
+    const trace_arg_t* args, size_t num_args);
+
+void trace_internal_write_flow_step_event_record_and_release_context(
+    trace_context_t* context,
+    const trace_string_ref_t* category_ref,
+    const char* name_literal,
+    trace_flow_id_t flow_id,
+    const trace_arg_t* args, size_t num_args);
+
+void trace_internal_write_flow_end_event_record_and_release_context(
+    trace_context_t* context,
+    const trace_string_ref_t* category_ref,
+    const char* name_literal,
+    trace_flow_id_t flow_id,
+    const trace_arg_t* args, size_t num_args);
+
+// Writes the duration end event of a |TRACE_DURATION| scope, if the
+// category is still enabled.
+void trace_internal_write_duration_end_event_record(
+    const char* category_literal, const char* name_literal);
+
+// The state of a |TRACE_DURATION| scope.
+typedef struct trace_internal_duration_scope {
+    const char* category_literal;
+    const char* name_literal;
+    // Whether the duration begin event was written.
+    bool begun;
+} trace_internal_duration_scope_t;
+
+static inline void trace_internal_cleanup_duration_scope(
+    trace_internal_duration_scope_t* scope) {
+    if (unlikely(scope->begun)) {
+        trace_internal_write_duration_end_event_record(scope->category_literal,
+                                                       scope->name_literal);
+    }
+}
+
+// Makes argument values of the types the trace macros accept in C.
+static inline trace_arg_value_t trace_internal_make_string_arg_value(
+    const char* value) {
+    return trace_make_string_arg_value(trace_make_inline_c_string_ref(value));
+}
+
+static inline trace_arg_value_t trace_internal_make_pointer_arg_value(
+    const volatile void* value) {
+    return trace_make_pointer_arg_value((uintptr_t)value);
+}
+
+static inline trace_arg_value_t trace_internal_make_arg_value(
+    trace_arg_value_t value) {
+    return value;
+}
+
+__END_CDECLS
+
+#ifdef __cplusplus
+
+namespace trace {
+namespace internal {
+
+// Makes the argument value of each type that the trace macros accept in C++.
+inline trace_arg_value_t MakeArgValue(trace_arg_value_t value) {
+    return value;
+}
+
+inline trace_arg_value_t MakeArgValue(std::nullptr_t) {
+    return trace_make_null_arg_value();
+}
+
+inline trace_arg_value_t MakeArgValue(bool value) {
+    return trace_make_uint32_arg_value(value);
+}
+
+inline trace_arg_value_t MakeArgValue(char value) {
+    return trace_make_int32_arg_value(value);
+}
+
+inline trace_arg_value_t MakeArgValue(signed char value) {
+    return trace_make_int32_arg_value(value);
+}
+
+inline trace_arg_value_t MakeArgValue(short value) {
+    return trace_make_int32_arg_value(value);
+}
+
+inline trace_arg_value_t MakeArgValue(int value) {
+    return trace_make_int32_arg_value(value);
+}
+
+inline trace_arg_value_t MakeArgValue(long value) {
+    return trace_make_int64_arg_value(value);
+}
+
+inline trace_arg_value_t MakeArgValue(long long value) {
+    return trace_make_int64_arg_value(value);
+}
+
+inline trace_arg_value_t MakeArgValue(unsigned char value) {
+    return trace_make_uint32_arg_value(value);
+}
+
+inline trace_arg_value_t MakeArgValue(unsigned short value) {
+    return trace_make_uint32_arg_value(value);
+}
+
+inline trace_arg_value_t MakeArgValue(unsigned int value) {
+    return trace_make_uint32_arg_value(value);
+}
+
+inline trace_arg_value_t MakeArgValue(unsigned long value) {
+    return trace_make_uint64_arg_value(value);
+}
+
+inline trace_arg_value_t MakeArgValue(unsigned long long value) {
+    return trace_make_uint64_arg_value(value);
+}
+
+inline trace_arg_value_t MakeArgValue(float value) {
+    return trace_make_double_arg_value(value);
+}
+
+inline trace_arg_value_t MakeArgValue(double value) {
+    return trace_make_double_arg_value(value);
+}
+
+inline trace_arg_value_t MakeArgValue(const char* value) {
+    return trace_internal_make_string_arg_value(value);
+}
+
+inline trace_arg_value_t MakeArgValue(char* value) {
+    return trace_internal_make_string_arg_value(value);
+}
+
+inline trace_arg_value_t MakeArgValue(const std::string& value) {
+    return trace_make_string_arg_value(
+        trace_make_inline_string_ref(value.data(), value.size()));
+}
+
+template <typename T>
+inline trace_arg_value_t MakeArgValue(T* value) {
+    return trace_internal_make_pointer_arg_value(value);
+}
+
+template <typename T,
+          typename = typename std::enable_if<std::is_enum<T>::value>::type>
+inline trace_arg_value_t MakeArgValue(T value) {
+    return MakeArgValue(
+        static_cast<typename std::underlying_type<T>::type>(value));
+}
+
+// Writes the duration end event of a |TRACE_DURATION| scope when it goes
+// out of scope.
+struct DurationEventScope : trace_internal_duration_scope_t {
+    DurationEventScope(const char* category_literal,
+                       const char* name_literal) {
+        this->category_literal = category_literal;
+        this->name_literal = name_literal;
+        this->begun = false;
+    }
+
+    ~DurationEventScope() { trace_internal_cleanup_duration_scope(this); }
+
+    DurationEventScope(const DurationEventScope&) = delete;
+    DurationEventScope& operator=(const DurationEventScope&) = delete;
+};
+
+} // namespace internal
+} // namespace trace
+
+#define TRACE_INTERNAL_MAKE_ARG_VALUE(value) \
+    (::trace::internal::MakeArgValue(value))
+
+#define TRACE_INTERNAL_DECLARE_DURATION_SCOPE(scope_label, category_literal, \
+                                              name_literal)                  \
+    ::trace::internal::DurationEventScope scope_label((category_literal),    \
+                                                      (name_literal))
+
+#else
+
+#define TRACE_INTERNAL_MAKE_ARG_VALUE(value)                        \
+    (_Generic((value),                                              \
+        _Bool: trace_make_uint32_arg_value,                         \
+        char: trace_make_int32_arg_value,                           \
+        signed char: trace_make_int32_arg_value,                    \
+        short: trace_make_int32_arg_value,                          \
+        int: trace_make_int32_arg_value,                            \
+        long: trace_make_int64_arg_value,                           \
+        long long: trace_make_int64_arg_value,                      \
+        unsigned char: trace_make_uint32_arg_value,                 \
+        unsigned short: trace_make_uint32_arg_value,                \
+        unsigned int: trace_make_uint32_arg_value,                  \
+        unsigned long: trace_make_uint64_arg_value,                 \
+        unsigned long long: trace_make_uint64_arg_value,            \
+        float: trace_make_double_arg_value,                         \
+        double: trace_make_double_arg_value,                        \
+        char*: trace_internal_make_string_arg_value,                \
+        const char*: trace_internal_make_string_arg_value,          \
+        trace_arg_value_t: trace_internal_make_arg_value,           \
+        default: trace_internal_make_pointer_arg_value)(value))
+
+#define TRACE_INTERNAL_DECLARE_DURATION_SCOPE(scope_label, category_literal, \
+                                              name_literal)                  \
+    __attribute__((cleanup(trace_internal_cleanup_duration_scope)))          \
+    trace_internal_duration_scope_t scope_label = {(category_literal),       \
+                                                   (name_literal), false}
+
+#endif // __cplusplus
+
+// Names a variable unique to the line it is used on.
+#define TRACE_INTERNAL_SCOPE_LABEL__(token) __trace_scope_##token
+#define TRACE_INTERNAL_SCOPE_LABEL_(token) TRACE_INTERNAL_SCOPE_LABEL__(token)
+#define TRACE_INTERNAL_SCOPE_LABEL() TRACE_INTERNAL_SCOPE_LABEL_(__COUNTER__)
+
+#define TRACE_INTERNAL_CONTEXT __trace_context
+#define TRACE_INTERNAL_CATEGORY_REF __trace_category_ref
+#define TRACE_INTERNAL_ARGS __trace_args
+
+#define TRACE_INTERNAL_NUM_ARGS(...) TRACE_INTERNAL_COUNT_PAIRS(__VA_ARGS__)
+
+#define TRACE_INTERNAL_INIT_ARG(idx, var_name, arg_name, arg_value) \
+    var_name[countof(var_name) - (idx)].name_ref.encoded_value =     \
+        TRACE_ENCODED_STRING_REF_EMPTY;                              \
+    var_name[countof(var_name) - (idx)].name_ref.inline_string =     \
+        (arg_name);                                                  \
+    var_name[countof(var_name) - (idx)].value =                      \
+        TRACE_INTERNAL_MAKE_ARG_VALUE(arg_value);
+
+// Declares the array |var_name| holding |args|, which are evaluated only
+// here, once the category is known to be enabled.
+#define TRACE_INTERNAL_DECLARE_ARGS(context, var_name, args...)           \
+    trace_arg_t var_name[TRACE_INTERNAL_NUM_ARGS(args) > 0                \
+                             ? TRACE_INTERNAL_NUM_ARGS(args)              \
+                             : 1];                                        \
+    TRACE_INTERNAL_APPLY_PAIRWISE(TRACE_INTERNAL_INIT_ARG, var_name, args) \
+    trace_internal_complete_args((context), var_name,                     \
+                                 TRACE_INTERNAL_NUM_ARGS(args))
+
+// Writes a record with |stmt| if |category_literal| is enabled.
+#define TRACE_INTERNAL_SIMPLE_RECORD(category_literal, stmt, args...)       \
+    do {                                                                    \
+        trace_string_ref_t TRACE_INTERNAL_CATEGORY_REF;                     \
+        trace_context_t* TRACE_INTERNAL_CONTEXT =                           \
+            trace_acquire_context_for_category(                             \
+                (category_literal), &TRACE_INTERNAL_CATEGORY_REF);          \
+        if (unlikely(TRACE_INTERNAL_CONTEXT)) {                             \
+            TRACE_INTERNAL_DECLARE_ARGS(TRACE_INTERNAL_CONTEXT,             \
+                                        TRACE_INTERNAL_ARGS, args);         \
+            stmt;                                                           \
+        }                                                                   \
+    } while (0)
+
+#define TRACE_INTERNAL_INSTANT(category_literal, name_literal, scope, args...) \
+    TRACE_INTERNAL_SIMPLE_RECORD(                                             \
+        (category_literal),                                                   \
+        trace_internal_write_instant_event_record_and_release_context(        \
+            TRACE_INTERNAL_CONTEXT, &TRACE_INTERNAL_CATEGORY_REF,             \
+            (name_literal), (scope),                                          \
+            TRACE_INTERNAL_ARGS, TRACE_INTERNAL_NUM_ARGS(args)),              \
+        args)
+
+#define TRACE_INTERNAL_COUNTER(category_literal, name_literal, counter_id, \
+                               args...)                                   \
+    TRACE_INTERNAL_SIMPLE_RECORD(                                         \
+        (category_literal),                                               \
+        trace_internal_write_counter_event_record_and_release_context(    \
+            TRACE_INTERNAL_CONTEXT, &TRACE_INTERNAL_CATEGORY_REF,         \
+            (name_literal), (counter_id),                                 \
+            TRACE_INTERNAL_ARGS, TRACE_INTERNAL_NUM_ARGS(args)),          \
+        args)
+
+#define TRACE_INTERNAL_DURATION_BEGIN(category_literal, name_literal, args...) \
+    TRACE_INTERNAL_SIMPLE_RECORD(                                             \
+        (category_literal),                                                   \
+        trace_internal_write_duration_begin_event_record_and_release_context( \
+            TRACE_INTERNAL_CONTEXT, &TRACE_INTERNAL_CATEGORY_REF,             \
+            (name_literal),                                                   \
+            TRACE_INTERNAL_ARGS, TRACE_INTERNAL_NUM_ARGS(args)),              \
+        args)
+
+#define TRACE_INTERNAL_DURATION_END(category_literal, name_literal, args...) \
+    TRACE_INTERNAL_SIMPLE_RECORD(                                           \
+        (category_literal),                                                 \
+        trace_internal_write_duration_end_event_record_and_release_context( \
+            TRACE_INTERNAL_CONTEXT, &TRACE_INTERNAL_CATEGORY_REF,           \
+            (name_literal),                                                 \
+            TRACE_INTERNAL_ARGS, TRACE_INTERNAL_NUM_ARGS(args)),            \
+        args)
+
+#define TRACE_INTERNAL_DURATION_(scope_label, scope_category_literal,      \
+                                 scope_name_literal, args...)               \
+    TRACE_INTERNAL_DECLARE_DURATION_SCOPE(scope_label,                      \
+                                          (scope_category_literal),         \
+                                          (scope_name_literal));            \
+    TRACE_INTERNAL_SIMPLE_RECORD(                                           \
+        scope_label.category_literal,                                       \
+        trace_internal_write_duration_begin_event_record_and_release_context( \
+            TRACE_INTERNAL_CONTEXT, &TRACE_INTERNAL_CATEGORY_REF,           \
+            scope_label.name_literal,                                       \
+            TRACE_INTERNAL_ARGS, TRACE_INTERNAL_NUM_ARGS(args));            \
+        scope_label.begun = true,                                           \
+        args)
+
+#define TRACE_INTERNAL_DURATION(category_literal, name_literal, args...) \
+    TRACE_INTERNAL_DURATION_(TRACE_INTERNAL_SCOPE_LABEL(),               \
+                             (category_literal), (name_literal), args)
+
+#define TRACE_INTERNAL_ASYNC_BEGIN(category_literal, name_literal, async_id, \
+                                   args...)                                 \
+    TRACE_INTERNAL_SIMPLE_RECORD(                                           \
+        (category_literal),                                                 \
+        trace_internal_write_async_begin_event_record_and_release_context(  \
+            TRACE_INTERNAL_CONTEXT, &TRACE_INTERNAL_CATEGORY_REF,           \
+            (name_literal), (async_id),                                     \
+            TRACE_INTERNAL_ARGS, TRACE_INTERNAL_NUM_ARGS(args)),            \
+        args)
+
+#define TRACE_INTERNAL_ASYNC_INSTANT(category_literal, name_literal, async_id, \
+                                     args...)                                 \
+    TRACE_INTERNAL_SIMPLE_RECORD(                                             \
+        (category_literal),                                                   \
+        trace_internal_write_async_instant_event_record_and_release_context(  \
+            TRACE_INTERNAL_CONTEXT, &TRACE_INTERNAL_CATEGORY_REF,             \
+            (name_literal), (async_id),                                       \
+            TRACE_INTERNAL_ARGS, TRACE_INTERNAL_NUM_ARGS(args)),              \
+        args)
+
+#define TRACE_INTERNAL_ASYNC_END(category_literal, name_literal, async_id, \
+                                 args...)                                 \
+    TRACE_INTERNAL_SIMPLE_RECORD(                                         \
+        (category_literal),                                               \
+        trace_internal_write_async_end_event_record_and_release_context(  \
+            TRACE_INTERNAL_CONTEXT, &TRACE_INTERNAL_CATEGORY_REF,         \
+            (name_literal), (async_id),                                   \
+            TRACE_INTERNAL_ARGS, TRACE_INTERNAL_NUM_ARGS(args)),          \
+        args)
+
+#define TRACE_INTERNAL_FLOW_BEGIN(category_literal, name_literal, flow_id, \
+                                  args...)                                \
+    TRACE_INTERNAL_SIMPLE_RECORD(                                         \
+        (category_literal),                                               \
+        trace_internal_write_flow_begin_event_record_and_release_context( \
+            TRACE_INTERNAL_CONTEXT, &TRACE_INTERNAL_CATEGORY_REF,         \
+            (name_literal), (flow_id),                                    \
+            TRACE_INTERNAL_ARGS, TRACE_INTERNAL_NUM_ARGS(args)),          \
+        args)
+
+#define TRACE_INTERNAL_FLOW_STEP(category_literal, name_literal, flow_id, \
+                                 args...)                                \
+    TRACE_INTERNAL_SIMPLE_RECORD(                                        \
+        (category_literal),                                              \
+        trace_internal_write_flow_step_event_record_and_release_context( \
+            TRACE_INTERNAL_CONTEXT, &TRACE_INTERNAL_CATEGORY_REF,        \
+            (name_literal), (flow_id),                                   \
+            TRACE_INTERNAL_ARGS, TRACE_INTERNAL_NUM_ARGS(args)),         \
+        args)
+
+#define TRACE_INTERNAL_FLOW_END(category_literal, name_literal, flow_id, \
+                                args...)                                \
+    TRACE_INTERNAL_SIMPLE_RECORD(                                       \
+        (category_literal),                                             \
+        trace_internal_write_flow_end_event_record_and_release_context( \
+            TRACE_INTERNAL_CONTEXT, &TRACE_INTERNAL_CATEGORY_REF,       \
+            (name_literal), (flow_id),                                  \
+            TRACE_INTERNAL_ARGS, TRACE_INTERNAL_NUM_ARGS(args)),        \
+        args)
+
+#endif // TRACE_INTERNAL_EVENT_INTERNAL_H_
@@ -0,0 +1,82 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// Internal macros for applying a macro to each argument pair of a trace
+// event.  Do not use these directly; they are subject to change.
+//
+
+#ifndef TRACE_INTERNAL_PAIRS_INTERNAL_H_
+#define TRACE_INTERNAL_PAIRS_INTERNAL_H_
+
+// Counts the number of key/value pairs in |...|, which may be empty.
+// Expands to an undefined identifier if there are an odd number of
+// arguments, other than one, which makes the trace macro fail to compile.
+// Works with 0 to 15 pairs.
+#define TRACE_INTERNAL_COUNT_PAIRS(...) \
+    TRACE_INTERNAL_COUNT_PAIRS_(__VA_ARGS__, TRACE_INTERNAL_ODD_ARGS, \
+        15, TRACE_INTERNAL_ODD_ARGS, \
+        14, TRACE_INTERNAL_ODD_ARGS, \
+        13, TRACE_INTERNAL_ODD_ARGS, \
+        12, TRACE_INTERNAL_ODD_ARGS, \
+        11, TRACE_INTERNAL_ODD_ARGS, \
+        10, TRACE_INTERNAL_ODD_ARGS, \
+        9, TRACE_INTERNAL_ODD_ARGS, \
+        8, TRACE_INTERNAL_ODD_ARGS, \
+        7, TRACE_INTERNAL_ODD_ARGS, \
+        6, TRACE_INTERNAL_ODD_ARGS, \
+        5, TRACE_INTERNAL_ODD_ARGS, \
+        4, TRACE_INTERNAL_ODD_ARGS, \
+        3, TRACE_INTERNAL_ODD_ARGS, \
+        2, TRACE_INTERNAL_ODD_ARGS, \
+        1, 0)
+#define TRACE_INTERNAL_COUNT_PAIRS_( \
+    _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, \
+    _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, \
+    _30, _31, n, ...) n
+
+// Applies |fn| to each key/value pair of |...|, as
+// |fn(idx, param, key, value)|, where |idx| counts down from the number of
+// pairs to 1.
+#define TRACE_INTERNAL_APPLY_PAIRWISE(fn, param, ...) \
+    TRACE_INTERNAL_APPLY_PAIRWISE_(TRACE_INTERNAL_COUNT_PAIRS(__VA_ARGS__), \
+                                   fn, param, __VA_ARGS__)
+#define TRACE_INTERNAL_APPLY_PAIRWISE_(n, fn, param, ...) \
+    TRACE_INTERNAL_APPLY_PAIRWISE__(n, fn, param, __VA_ARGS__)
+#define TRACE_INTERNAL_APPLY_PAIRWISE__(n, fn, param, ...) \
+    TRACE_INTERNAL_APPLY_PAIRWISE_##n(fn, param, __VA_ARGS__)
+
+#define TRACE_INTERNAL_APPLY_PAIRWISE_0(fn, param, ...)
+#define TRACE_INTERNAL_APPLY_PAIRWISE_1(fn, param, k1, v1) \
+    fn(1, param, k1, v1)
+#define TRACE_INTERNAL_APPLY_PAIRWISE_2(fn, param, k1, v1, ...) \
+    fn(2, param, k1, v1) TRACE_INTERNAL_APPLY_PAIRWISE_1(fn, param, __VA_ARGS__)
+#define TRACE_INTERNAL_APPLY_PAIRWISE_3(fn, param, k1, v1, ...) \
+    fn(3, param, k1, v1) TRACE_INTERNAL_APPLY_PAIRWISE_2(fn, param, __VA_ARGS__)
+#define TRACE_INTERNAL_APPLY_PAIRWISE_4(fn, param, k1, v1, ...) \
+    fn(4, param, k1, v1) TRACE_INTERNAL_APPLY_PAIRWISE_3(fn, param, __VA_ARGS__)
+#define TRACE_INTERNAL_APPLY_PAIRWISE_5(fn, param, k1, v1, ...) \
+    fn(5, param, k1, v1) TRACE_INTERNAL_APPLY_PAIRWISE_4(fn, param, __VA_ARGS__)
+#define TRACE_INTERNAL_APPLY_PAIRWISE_6(fn, param, k1, v1, ...) \
+    fn(6, param, k1, v1) TRACE_INTERNAL_APPLY_PAIRWISE_5(fn, param, __VA_ARGS__)
+#define TRACE_INTERNAL_APPLY_PAIRWISE_7(fn, param, k1, v1, ...) \
+    fn(7, param, k1, v1) TRACE_INTERNAL_APPLY_PAIRWISE_6(fn, param, __VA_ARGS__)
+#define TRACE_INTERNAL_APPLY_PAIRWISE_8(fn, param, k1, v1, ...) \
+    fn(8, param, k1, v1) TRACE_INTERNAL_APPLY_PAIRWISE_7(fn, param, __VA_ARGS__)
+#define TRACE_INTERNAL_APPLY_PAIRWISE_9(fn, param, k1, v1, ...) \
+    fn(9, param, k1, v1) TRACE_INTERNAL_APPLY_PAIRWISE_8(fn, param, __VA_ARGS__)
+#define TRACE_INTERNAL_APPLY_PAIRWISE_10(fn, param, k1, v1, ...) \
+    fn(10, param, k1, v1) TRACE_INTERNAL_APPLY_PAIRWISE_9(fn, param, __VA_ARGS__)
+#define TRACE_INTERNAL_APPLY_PAIRWISE_11(fn, param, k1, v1, ...) \
+    fn(11, param, k1, v1) TRACE_INTERNAL_APPLY_PAIRWISE_10(fn, param, __VA_ARGS__)
+#define TRACE_INTERNAL_APPLY_PAIRWISE_12(fn, param, k1, v1, ...) \
+    fn(12, param, k1, v1) TRACE_INTERNAL_APPLY_PAIRWISE_11(fn, param, __VA_ARGS__)
+#define TRACE_INTERNAL_APPLY_PAIRWISE_13(fn, param, k1, v1, ...) \
+    fn(13, param, k1, v1) TRACE_INTERNAL_APPLY_PAIRWISE_12(fn, param, __VA_ARGS__)
+#define TRACE_INTERNAL_APPLY_PAIRWISE_14(fn, param, k1, v1, ...) \
+    fn(14, param, k1, v1) TRACE_INTERNAL_APPLY_PAIRWISE_13(fn, param, __VA_ARGS__)
+#define TRACE_INTERNAL_APPLY_PAIRWISE_15(fn, param, k1, v1, ...) \
+    fn(15, param, k1, v1) TRACE_INTERNAL_APPLY_PAIRWISE_14(fn, param, __VA_ARGS__)
+
+#endif // TRACE_INTERNAL_PAIRS_INTERNAL_H_
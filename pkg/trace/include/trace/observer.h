@@ -0,0 +1,79 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// Trace observers allow components to observe when tracing is starting or
+// stopping so they can prepare themselves to capture data accordingly.
+//
+// See <trace-engine/instrumentation.h> for the C API and more detailed
+// documentation.
+//
+
+#ifndef TRACE_OBSERVER_H_
+#define TRACE_OBSERVER_H_
+
+#include <lib/async/dispatcher.h>
+#include <lib/async/wait.h>
+#include <lib/fit/function.h>
+#include <lib/zx/event.h>
+
+namespace trace {
+
+// Receives notifications when the trace state or set of enabled categories
+// changes, on an async dispatcher.
+//
+// This class is thread-hostile: it must be started, stopped and destroyed
+// on the dispatcher's thread, or from within its own callback.
+//
+// EXAMPLE
+//
+//     trace::TraceObserver observer;
+//     observer.Start(dispatcher, [] {
+//         if (TRACE_CATEGORY_ENABLED("gfx")) { /* start capturing */ }
+//     });
+//
+class TraceObserver final : private async_wait_t {
+public:
+    // Initializes the trace observer.
+    TraceObserver();
+
+    // Stops the trace observer.
+    ~TraceObserver();
+
+    // Starts the trace observer.
+    // Must be called on the dispatcher's thread.
+    //
+    // |dispatcher| is the dispatcher on which |callback| runs.
+    // |callback| runs after the trace state or set of enabled categories
+    // changes, and may use |trace_state()| and |TRACE_CATEGORY_ENABLED()| to
+    // find out how.
+    //
+    // Returns |ZX_OK| if the observer started, or an error from creating
+    // the event, registering it or beginning the wait.
+    zx_status_t Start(async_dispatcher_t* dispatcher, fit::closure callback);
+
+    // Stops the trace observer.
+    // Must be called on the dispatcher's thread.
+    void Stop();
+
+    bool is_started() const { return dispatcher_ != nullptr; }
+
+    TraceObserver(const TraceObserver&) = delete;
+    TraceObserver(TraceObserver&&) = delete;
+    TraceObserver& operator=(const TraceObserver&) = delete;
+    TraceObserver& operator=(TraceObserver&&) = delete;
+
+private:
+    static void CallHandler(async_dispatcher_t* dispatcher, async_wait_t* wait,
+                            zx_status_t status, const zx_packet_signal_t* signal);
+    void Handle(zx_status_t status);
+
+    async_dispatcher_t* dispatcher_ = nullptr;
+    fit::closure callback_;
+    zx::event event_;
+};
+
+} // namespace trace
+
+#endif // TRACE_OBSERVER_H_
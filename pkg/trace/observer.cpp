@@ -0,0 +1,88 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <trace/observer.h>
+
+#include <trace-engine/instrumentation.h>
+#include <zircon/assert.h>
+
+namespace trace {
+
+TraceObserver::TraceObserver()
+    : async_wait_t{{ASYNC_STATE_INIT}, &TraceObserver::CallHandler,
+                   ZX_HANDLE_INVALID, ZX_EVENT_SIGNALED} {}
+
+TraceObserver::~TraceObserver() {
+    Stop();
+}
+
+zx_status_t TraceObserver::Start(async_dispatcher_t* dispatcher,
+                                 fit::closure callback) {
+    ZX_DEBUG_ASSERT(dispatcher);
+    ZX_DEBUG_ASSERT(callback);
+
+    Stop();
+
+    zx::event event;
+    zx_status_t status = zx::event::create(0u, &event);
+    if (status != ZX_OK)
+        return status;
+    status = trace_register_observer(event.get());
+    if (status != ZX_OK)
+        return status;
+
+    object = event.get();
+    status = async_begin_repeating_wait(dispatcher, this);
+    if (status != ZX_OK) {
+        trace_unregister_observer(event.get());
+        object = ZX_HANDLE_INVALID;
+        return status;
+    }
+
+    dispatcher_ = dispatcher;
+    callback_ = std::move(callback);
+    event_ = std::move(event);
+    return ZX_OK;
+}
+
+void TraceObserver::Stop() {
+    if (!dispatcher_)
+        return;
+    async_cancel_wait(dispatcher_, this);
+    trace_unregister_observer(event_.get());
+    dispatcher_ = nullptr;
+    callback_ = nullptr;
+    event_.reset();
+    object = ZX_HANDLE_INVALID;
+}
+
+void TraceObserver::CallHandler(async_dispatcher_t*, async_wait_t* wait,
+                                zx_status_t status, const zx_packet_signal_t*) {
+    static_cast<TraceObserver*>(wait)->Handle(status);
+}
+
+void TraceObserver::Handle(zx_status_t status) {
+    if (status != ZX_OK) {
+        // The dispatcher ended the wait.
+        trace_unregister_observer(event_.get());
+        dispatcher_ = nullptr;
+        callback_ = nullptr;
+        event_.reset();
+        object = ZX_HANDLE_INVALID;
+        return;
+    }
+
+    // Clear the signal before running the callback so that a change made
+    // while the callback runs raises it again.
+    event_.signal(ZX_EVENT_SIGNALED, 0u);
+    zx_handle_t event = event_.get();
+
+    // The callback may stop or destroy the observer, so it must not be used
+    // after this.
+    callback_();
+
+    trace_notify_observer_updated(event);
+}
+
+} // namespace trace
@@ -0,0 +1,139 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// The ABI-stable entry points used by trace providers to start and stop the
+// trace engine.
+//
+// A trace provider connects the trace engine of a process to the trace
+// manager: it receives the buffer and the categories of each trace session,
+// starts the engine on its dispatcher with a |trace_handler_t| that answers
+// the engine's questions, and stops it when the session ends.
+//
+// Only one trace provider may run the engine of a process at a time.
+//
+
+#ifndef TRACE_ENGINE_HANDLER_H_
+#define TRACE_ENGINE_HANDLER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <lib/async/dispatcher.h>
+#include <trace-engine/types.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// Callbacks from the trace engine to its handler.
+typedef struct trace_handler trace_handler_t;
+
+// Trace handler interface.
+//
+// Implementations must supply valid function pointers for each function
+// defined in the |ops| structure.
+typedef struct trace_handler_ops {
+    // Called by the trace engine to ask whether the specified category is enabled.
+    //
+    // This method may be called frequently so it must be efficiently implemented.
+    // Clients may cache the results while a trace is running; dynamic changes
+    // to the enabled categories may go unnoticed until the next trace.
+    //
+    // |handler| is the trace handler object itself.
+    // |category| is the name of the category.
+    //
+    // Called by instrumentation on any thread.  Must be thread-safe.
+    bool (*is_category_enabled)(trace_handler_t* handler, const char* category);
+
+    // Called by the trace engine to indicate it has completed startup.
+    //
+    // Called on an asynchronous dispatch thread.
+    void (*trace_started)(trace_handler_t* handler);
+
+    // Called by the trace engine when tracing has stopped.
+    //
+    // The trace collection status is |ZX_OK| if trace collection was successful.
+    // An error indicates that the trace data may be inaccurate or incomplete.
+    //
+    // |handler| is the trace handler object itself.
+    // |dispatcher| is the trace engine's asynchronous dispatcher.
+    // |disposition| is |ZX_OK| if tracing stopped normally, otherwise indicates
+    // that tracing was aborted due to an error.
+    // |buffer_bytes_written| is number of bytes which were written to the trace buffer.
+    //
+    // Called on an asynchronous dispatch thread.
+    void (*trace_stopped)(trace_handler_t* handler, async_dispatcher_t* dispatcher,
+                          zx_status_t disposition, size_t buffer_bytes_written);
+
+    // Called by the trace engine in streaming mode to indicate a buffer is full.
+    // This is only used in streaming mode where double-buffering is used.
+    // |wrapped_count| is the number of times writing to the rolling buffer has
+    // switched from one buffer to the other.
+    // |durable_data_end| is the offset into the durable buffer when the rolling
+    // buffer filled.  This is passed back to the trace engine in
+    // |trace_engine_mark_buffer_saved()|.
+    //
+    // Called on an asynchronous dispatch thread.
+    void (*notify_buffer_full)(trace_handler_t* handler,
+                               uint32_t wrapped_count, uint64_t durable_data_end);
+} trace_handler_ops_t;
+
+// Trace handler state.
+//
+// Implementations should "subclass" this structure by placing it at the
+// beginning of their own structure.
+struct trace_handler {
+    const trace_handler_ops_t* ops;
+};
+
+// Asynchronously starts the trace engine.
+//
+// |dispatcher| is the asynchronous dispatcher which the trace engine will use for dispatch.
+// |handler| is the trace handler which will handle lifecycle events.
+// |buffering_mode| is how the engine fills |buffer|.
+// |buffer| is the trace buffer into which the trace engine will write trace events.
+// |buffer_num_bytes| is the size of the trace buffer in bytes, a multiple of
+// the page size.
+//
+// Returns |ZX_OK| if tracing is ready to go.
+// Returns |ZX_ERR_BAD_STATE| if tracing has already been started or is not stopped.
+// Returns |ZX_ERR_NO_MEMORY| if allocation failed.
+// Returns |ZX_ERR_INVALID_ARGS| if the buffering mode or buffer size is invalid.
+//
+// This function is thread-safe.
+zx_status_t trace_start_engine(async_dispatcher_t* dispatcher,
+                               trace_handler_t* handler,
+                               trace_buffering_mode_t buffering_mode,
+                               void* buffer,
+                               size_t buffer_num_bytes);
+
+// Asynchronously stops the trace engine.
+//
+// The engine will disallow new writes to the trace buffer and will wait for
+// outstanding writes to complete before calling |trace_stopped| on its handler.
+//
+// |disposition| is |ZX_OK| if tracing is being stopped normally, otherwise indicates
+// that tracing is being aborted due to an error.
+//
+// Returns |ZX_OK| if the current state is |TRACE_STARTED| or |TRACE_STOPPING|.
+// Returns |ZX_ERR_BAD_STATE| if current state is |TRACE_STOPPED|.
+//
+// This function is thread-safe.
+zx_status_t trace_stop_engine(zx_status_t disposition);
+
+// Called by the trace provider in streaming mode to indicate the manager has
+// saved the rolling buffer that filled, so that the engine can write to it
+// again.
+//
+// |wrapped_count| and |durable_data_end| are the values passed to
+// |notify_buffer_full|.
+//
+// This function is thread-safe.
+void trace_engine_mark_buffer_saved(uint32_t wrapped_count,
+                                    uint64_t durable_data_end);
+
+__END_CDECLS
+
+#endif // TRACE_ENGINE_HANDLER_H_
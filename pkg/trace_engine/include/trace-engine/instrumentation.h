@@ -0,0 +1,141 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// The ABI-stable entry points used by trace instrumentation libraries.
+//
+// These functions are used to write trace records into the trace buffer
+// of the trace session which is currently running, if any.
+//
+// Client code should generally use the macros in <trace/event.h> rather
+// than calling these functions directly.
+//
+// All functions are thread-safe.
+//
+
+#ifndef TRACE_ENGINE_INSTRUMENTATION_H_
+#define TRACE_ENGINE_INSTRUMENTATION_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <trace-engine/types.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// Returns a new unique 64-bit unsigned integer (within this process).
+// Each invocation returns a different non-zero value.
+// Useful for generating identifiers for async and flow events.
+uint64_t trace_generate_nonce(void);
+
+// Gets the current state of the trace engine.
+trace_state_t trace_state(void);
+
+// Returns true if tracing is enabled (started or stopping but not stopped).
+//
+// This function is cheap and can be called at a high frequency, but a
+// category-specific check with |trace_is_category_enabled()| is usually
+// what instrumentation wants.
+static inline bool trace_is_enabled(void) {
+    return trace_state() != TRACE_STOPPED;
+}
+
+// Returns true if tracing of the specified category has been enabled (which
+// implies that |trace_is_enabled()| is also true).
+//
+// Use |trace_acquire_context_for_category()| if you intend to immediately
+// write a record into the trace buffer after checking the category.
+//
+// |category_literal| must be a null-terminated static string constant.
+bool trace_is_category_enabled(const char* category_literal);
+
+// Acquires a reference to the trace engine's context.
+// Must be balanced by a call to |trace_release_context()| when the result is non-NULL.
+//
+// This function is cheap and can be called at a high frequency.
+//
+// Returns a valid trace context if tracing is enabled.
+// Returns NULL otherwise.
+trace_context_t* trace_acquire_context(void);
+
+// Acquires a reference to the trace engine's context, only if the specified
+// category is enabled.  Must be balanced by a call to |trace_release_context()|
+// when the result is non-NULL.
+//
+// Use |trace_is_category_enabled()| if you do not intend to immediately
+// write a record into the trace buffer after checking the category.
+//
+// |category_literal| must be a null-terminated static string constant.
+// |out_ref| points to where the registered string reference should be returned.
+//
+// Returns a valid trace context if tracing is enabled for the specified category.
+// Returns NULL otherwise.
+trace_context_t* trace_acquire_context_for_category(
+    const char* category_literal, trace_string_ref_t* out_ref);
+
+// Releases a reference to the trace engine's context.
+// Must balance a prior successful call to |trace_acquire_context()|
+// or |trace_acquire_context_for_category()|.
+//
+// |context| must be a valid trace context reference.
+void trace_release_context(trace_context_t* context);
+
+// Acquires a reference to the trace engine's context, for use as a prolonged
+// context: one that is held for longer than it takes to write one record,
+// such as while a trace observer holds on to state that the session must
+// keep.  Must be balanced by a call to |trace_release_prolonged_context()|
+// when the result is non-NULL.
+//
+// Returns a valid trace context if tracing is enabled.
+// Returns NULL otherwise.
+trace_prolonged_context_t* trace_acquire_prolonged_context(void);
+
+// Releases a reference to the trace engine's prolonged context.
+// Must balance a prior successful call to |trace_acquire_prolonged_context()|.
+//
+// |context| must be a valid trace prolonged context reference.
+void trace_release_prolonged_context(trace_prolonged_context_t* context);
+
+// Registers an event handle which the trace engine will signal with
+// |ZX_EVENT_SIGNALED| when the trace state or set of enabled categories changes.
+//
+// Trace observers can use this mechanism to activate custom instrumentation
+// mechanisms and write collected information into the trace buffer in response
+// to state changes.
+//
+// The protocol works like this:
+//
+// 1. The trace observer creates an event object (using |zx_event_create()| or
+//    equivalent) then calls |trace_register_observer()| to register itself.
+// 2. The trace observer queries the current trace state and set of enabled categories.
+// 3. If tracing is enabled, the trace observer configures itself to collect data
+//    and write trace records relevant to the set of enabled categories.
+// 4. When the trace state and/or set of enabled categories changes, the trace engine
+//    sets the |ZX_EVENT_SIGNALED| signal bit of each |event| associated with
+//    currently registered observers.
+// 5. In response to observing the |ZX_EVENT_SIGNALED| signal, the trace observer
+//    first clears the |ZX_EVENT_SIGNALED| bit (using |zx_object_signal()| or equivalent)
+//    then calls |trace_notify_observer_updated()| and adjusts its behavior as in step 2.
+// 6. When no longer interested in receiving events, the trace observer calls
+//    |trace_unregister_observer()| to unregister itself then closes the event handle.
+//
+// Returns |ZX_OK| if successful.
+// Returns |ZX_ERR_INVALID_ARGS| if the event was already registered.
+zx_status_t trace_register_observer(zx_handle_t event);
+
+// Unregisters the observer event handle previously registered with
+// |trace_register_observer|.
+//
+// Returns |ZX_OK| if successful.
+// Returns |ZX_ERR_NOT_FOUND| if the event was not previously registered.
+zx_status_t trace_unregister_observer(zx_handle_t event);
+
+// Callback to notify the engine that the observer has finished processing
+// all state changes.
+void trace_notify_observer_updated(zx_handle_t event);
+
+__END_CDECLS
+
+#endif // TRACE_ENGINE_INSTRUMENTATION_H_
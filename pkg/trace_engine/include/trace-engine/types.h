@@ -0,0 +1,339 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// Types, constants, and inline functions used to encode and decode trace records.
+// This header is used by C and C++ code.  For simple support of all choices of
+// C/C++ and -O0/-On the inline functions are "static inline".
+//
+
+#ifndef TRACE_ENGINE_TYPES_H_
+#define TRACE_ENGINE_TYPES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zircon/compiler.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// Timebase recorded into trace files, as returned by zx_ticks_get().
+typedef uint64_t trace_ticks_t;
+
+// The ids used to correlate related counters, asynchronous operations, flows, and virtual threads.
+typedef uint64_t trace_counter_id_t;
+typedef uint64_t trace_async_id_t;
+typedef uint64_t trace_flow_id_t;
+typedef uint64_t trace_vthread_id_t;
+
+// Specifies the scope of instant events.
+typedef enum {
+    // The event is only relevant to the thread it occurred on.
+    TRACE_SCOPE_THREAD = 0,
+    // The event is only relevant to the process in which it occurred.
+    TRACE_SCOPE_PROCESS = 1,
+    // The event is globally relevant.
+    TRACE_SCOPE_GLOBAL = 2,
+} trace_scope_t;
+
+// Thread states used to describe context switches.
+// Use the |ZX_THREAD_STATE_XXX| values defined in <zircon/syscalls/object.h>.
+typedef uint32_t trace_thread_state_t;
+
+// Identifies a particular CPU in a context switch trace record.
+typedef uint32_t trace_cpu_number_t;
+
+// Contains a thread's priority in a context switch trace record.
+typedef uint32_t trace_thread_priority_t;
+
+// The maximum length of a record, in bytes.
+#define TRACE_ENCODED_RECORD_MAX_LENGTH ((size_t)0x7ff8u)
+
+// Represents an index into the string table.
+typedef uint32_t trace_string_index_t;
+
+// Represents the encoded form of string references.
+typedef uint32_t trace_encoded_string_ref_t;
+#define TRACE_ENCODED_STRING_REF_EMPTY ((trace_encoded_string_ref_t)0u)
+#define TRACE_ENCODED_STRING_REF_INLINE_FLAG ((trace_encoded_string_ref_t)0x8000u)
+#define TRACE_ENCODED_STRING_REF_LENGTH_MASK ((trace_encoded_string_ref_t)0x7fffu)
+#define TRACE_ENCODED_STRING_REF_MAX_LENGTH ((trace_encoded_string_ref_t)32000)
+#define TRACE_ENCODED_STRING_REF_MIN_INDEX ((trace_encoded_string_ref_t)0x1u)
+#define TRACE_ENCODED_STRING_REF_MAX_INDEX ((trace_encoded_string_ref_t)0x7fffu)
+
+// Represents an index into the thread table.
+typedef uint32_t trace_thread_index_t;
+
+// Represents the encoded form of thread references.
+typedef uint32_t trace_encoded_thread_ref_t;
+#define TRACE_ENCODED_THREAD_REF_INLINE ((trace_encoded_thread_ref_t)0u)
+#define TRACE_ENCODED_THREAD_REF_MIN_INDEX ((trace_encoded_thread_ref_t)0x01)
+#define TRACE_ENCODED_THREAD_REF_MAX_INDEX ((trace_encoded_thread_ref_t)0xff)
+
+// A string reference which is either encoded inline or indirectly by string table index.
+typedef struct trace_string_ref {
+    trace_encoded_string_ref_t encoded_value;
+    const char* inline_string; // only non-null for inline strings
+} trace_string_ref_t;
+
+// Returns true if the string ref's content is empty.
+static inline bool trace_is_empty_string_ref(const trace_string_ref_t* string_ref) {
+    return string_ref->encoded_value == TRACE_ENCODED_STRING_REF_EMPTY;
+}
+
+// Returns true if the string ref's content is stored inline (rather than empty or indexed).
+static inline bool trace_is_inline_string_ref(const trace_string_ref_t* string_ref) {
+    return string_ref->encoded_value & TRACE_ENCODED_STRING_REF_INLINE_FLAG;
+}
+
+// Returns true if the string ref's content is stored as an index into the string table.
+static inline bool trace_is_indexed_string_ref(const trace_string_ref_t* string_ref) {
+    return string_ref->encoded_value >= TRACE_ENCODED_STRING_REF_MIN_INDEX &&
+           string_ref->encoded_value <= TRACE_ENCODED_STRING_REF_MAX_INDEX;
+}
+
+// Returns the length of an inline string.
+// Only valid for inline strings.
+static inline size_t trace_inline_string_ref_length(const trace_string_ref_t* string_ref) {
+    return string_ref->encoded_value & TRACE_ENCODED_STRING_REF_LENGTH_MASK;
+}
+
+// Makes an empty string ref.
+static inline trace_string_ref_t trace_make_empty_string_ref(void) {
+    trace_string_ref_t ref = {TRACE_ENCODED_STRING_REF_EMPTY, NULL};
+    return ref;
+}
+
+// Makes an inline or empty string ref from a string with given size.
+// The |string| does not need to be null-terminated because its length is provided.
+// The |string| must not be null if length is non-zero.
+// The |string| is truncated if longer than |TRACE_ENCODED_STRING_REF_MAX_LENGTH|.
+static inline trace_string_ref_t trace_make_inline_string_ref(
+    const char* string, size_t length) {
+    if (!length)
+        return trace_make_empty_string_ref();
+
+    if (length > TRACE_ENCODED_STRING_REF_MAX_LENGTH)
+        length = TRACE_ENCODED_STRING_REF_MAX_LENGTH;
+    trace_string_ref_t ref = {
+        TRACE_ENCODED_STRING_REF_INLINE_FLAG | (trace_encoded_string_ref_t)length,
+        string};
+    return ref;
+}
+
+// Makes an inline or empty string ref from a null-terminated string.
+// The |string| is truncated if longer than |TRACE_ENCODED_STRING_REF_MAX_LENGTH|.
+static inline trace_string_ref_t trace_make_inline_c_string_ref(const char* string) {
+    return trace_make_inline_string_ref(string,
+                                        string ? __builtin_strlen(string) : 0u);
+}
+
+// Makes an indexed string ref.
+// The |index| must be >= |TRACE_ENCODED_STRING_REF_MIN_INDEX|
+// and <= |TRACE_ENCODED_STRING_REF_MAX_INDEX|.
+static inline trace_string_ref_t trace_make_indexed_string_ref(trace_string_index_t index) {
+    trace_string_ref_t ref = {index, NULL};
+    return ref;
+}
+
+// A thread reference which is either encoded inline or indirectly by thread table index.
+typedef struct trace_thread_ref {
+    trace_encoded_thread_ref_t encoded_value;
+    zx_koid_t inline_process_koid;
+    zx_koid_t inline_thread_koid;
+} trace_thread_ref_t;
+
+// Returns true if the thread ref's value is unknown.
+static inline bool trace_is_unknown_thread_ref(const trace_thread_ref_t* thread_ref) {
+    return thread_ref->encoded_value == TRACE_ENCODED_THREAD_REF_INLINE &&
+           thread_ref->inline_process_koid == ZX_KOID_INVALID &&
+           thread_ref->inline_thread_koid == ZX_KOID_INVALID;
+}
+
+// Returns true if the thread ref's content is stored as an index into the thread table.
+static inline bool trace_is_indexed_thread_ref(const trace_thread_ref_t* thread_ref) {
+    return thread_ref->encoded_value >= TRACE_ENCODED_THREAD_REF_MIN_INDEX &&
+           thread_ref->encoded_value <= TRACE_ENCODED_THREAD_REF_MAX_INDEX;
+}
+
+// Returns true if the thread ref's content is stored inline (rather than unknown or indexed).
+static inline bool trace_is_inline_thread_ref(const trace_thread_ref_t* thread_ref) {
+    return thread_ref->encoded_value == TRACE_ENCODED_THREAD_REF_INLINE &&
+           (thread_ref->inline_process_koid != ZX_KOID_INVALID ||
+            thread_ref->inline_thread_koid != ZX_KOID_INVALID);
+}
+
+// Makes a thread ref representing an unknown thread.
+static inline trace_thread_ref_t trace_make_unknown_thread_ref(void) {
+    trace_thread_ref_t ref = {TRACE_ENCODED_THREAD_REF_INLINE, ZX_KOID_INVALID, ZX_KOID_INVALID};
+    return ref;
+}
+
+// Makes a thread ref with an inline value.
+// The process and thread koids must not both be invalid.
+static inline trace_thread_ref_t trace_make_inline_thread_ref(zx_koid_t process_koid,
+                                                              zx_koid_t thread_koid) {
+    trace_thread_ref_t ref = {TRACE_ENCODED_THREAD_REF_INLINE, process_koid, thread_koid};
+    return ref;
+}
+
+// Makes an indexed thread ref.
+// The index must be >= |TRACE_ENCODED_THREAD_REF_MIN_INDEX|
+// and <= |TRACE_ENCODED_THREAD_REF_MAX_INDEX|.
+static inline trace_thread_ref_t trace_make_indexed_thread_ref(trace_thread_index_t index) {
+    trace_thread_ref_t ref = {index, ZX_KOID_INVALID, ZX_KOID_INVALID};
+    return ref;
+}
+
+// The maximum number of arguments that a record may have.
+#define TRACE_MAX_ARGS ((size_t)15u)
+
+// Enumerates all known argument types.
+typedef enum {
+    TRACE_ARG_NULL = 0,
+    TRACE_ARG_INT32 = 1,
+    TRACE_ARG_UINT32 = 2,
+    TRACE_ARG_INT64 = 3,
+    TRACE_ARG_UINT64 = 4,
+    TRACE_ARG_DOUBLE = 5,
+    TRACE_ARG_STRING = 6,
+    TRACE_ARG_POINTER = 7,
+    TRACE_ARG_KOID = 8,
+} trace_arg_type_t;
+
+// A typed argument value.
+typedef struct {
+    trace_arg_type_t type;
+    union {
+        int32_t int32_value;
+        uint32_t uint32_value;
+        int64_t int64_value;
+        uint64_t uint64_value;
+        double double_value;
+        trace_string_ref_t string_value_ref;
+        uintptr_t pointer_value;
+        zx_koid_t koid_value;
+        uintptr_t reserved_for_future_expansion[2];
+    };
+} trace_arg_value_t;
+
+// Makes an argument value of each type.
+static inline trace_arg_value_t trace_make_null_arg_value(void) {
+    trace_arg_value_t arg_value;
+    arg_value.type = TRACE_ARG_NULL;
+    arg_value.uint64_value = 0u;
+    return arg_value;
+}
+
+static inline trace_arg_value_t trace_make_int32_arg_value(int32_t value) {
+    trace_arg_value_t arg_value;
+    arg_value.type = TRACE_ARG_INT32;
+    arg_value.int32_value = value;
+    return arg_value;
+}
+
+static inline trace_arg_value_t trace_make_uint32_arg_value(uint32_t value) {
+    trace_arg_value_t arg_value;
+    arg_value.type = TRACE_ARG_UINT32;
+    arg_value.uint32_value = value;
+    return arg_value;
+}
+
+static inline trace_arg_value_t trace_make_int64_arg_value(int64_t value) {
+    trace_arg_value_t arg_value;
+    arg_value.type = TRACE_ARG_INT64;
+    arg_value.int64_value = value;
+    return arg_value;
+}
+
+static inline trace_arg_value_t trace_make_uint64_arg_value(uint64_t value) {
+    trace_arg_value_t arg_value;
+    arg_value.type = TRACE_ARG_UINT64;
+    arg_value.uint64_value = value;
+    return arg_value;
+}
+
+static inline trace_arg_value_t trace_make_double_arg_value(double value) {
+    trace_arg_value_t arg_value;
+    arg_value.type = TRACE_ARG_DOUBLE;
+    arg_value.double_value = value;
+    return arg_value;
+}
+
+static inline trace_arg_value_t trace_make_string_arg_value(trace_string_ref_t value_ref) {
+    trace_arg_value_t arg_value;
+    arg_value.type = TRACE_ARG_STRING;
+    arg_value.string_value_ref = value_ref;
+    return arg_value;
+}
+
+static inline trace_arg_value_t trace_make_pointer_arg_value(uintptr_t value) {
+    trace_arg_value_t arg_value;
+    arg_value.type = TRACE_ARG_POINTER;
+    arg_value.pointer_value = value;
+    return arg_value;
+}
+
+static inline trace_arg_value_t trace_make_koid_arg_value(zx_koid_t value) {
+    trace_arg_value_t arg_value;
+    arg_value.type = TRACE_ARG_KOID;
+    arg_value.koid_value = value;
+    return arg_value;
+}
+
+// A named argument and value.
+// Often packed into an array to form an argument list when writing records.
+typedef struct {
+    trace_string_ref_t name_ref;
+    trace_arg_value_t value;
+} trace_arg_t;
+
+// Makes an argument with name and value.
+static inline trace_arg_t trace_make_arg(trace_string_ref_t name_ref,
+                                         trace_arg_value_t value) {
+    trace_arg_t arg = {name_ref, value};
+    return arg;
+}
+
+// BlobType enumerates all known trace blob types.
+typedef enum {
+    TRACE_BLOB_TYPE_DATA = 1,
+    TRACE_BLOB_TYPE_LAST_BRANCH = 2,
+} trace_blob_type_t;
+
+// Enumerates the states of the trace engine.
+typedef enum {
+    // The trace engine is not running.
+    TRACE_STOPPED = 0,
+    // The trace engine is running and is accepting new records.
+    TRACE_STARTED = 1,
+    // The trace engine is stopping, no new records are being accepted and
+    // it is waiting for outstanding writes to complete.
+    TRACE_STOPPING = 2,
+} trace_state_t;
+
+// Enumerates the ways the trace engine fills its buffer.
+typedef enum {
+    // The trace stops when the buffer fills.
+    TRACE_BUFFERING_MODE_ONESHOT = 0,
+    // The buffer is a ring, and the oldest records are overwritten once it
+    // fills.
+    TRACE_BUFFERING_MODE_CIRCULAR = 1,
+    // Each half of the buffer is saved by the trace manager while the other
+    // half fills.
+    TRACE_BUFFERING_MODE_STREAMING = 2,
+} trace_buffering_mode_t;
+
+// The context of a trace session, through which records are written.
+typedef struct trace_context trace_context_t;
+
+// A trace context which is held for the lifetime of something other than an
+// individual record, such as the registered state of a thread.
+typedef struct trace_prolonged_context trace_prolonged_context_t;
+
+__END_CDECLS
+
+#endif // TRACE_ENGINE_TYPES_H_
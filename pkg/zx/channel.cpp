@@ -4,9 +4,18 @@
 
 #include <lib/zx/channel.h>
 
+#include <string.h>
 #include <zircon/syscalls.h>
 
+#include <new>
+
 namespace zx {
+namespace {
+
+// Messages up to this size are gathered on the stack.
+constexpr size_t kInlineBytes = 512u;
+
+} // namespace
 
 zx_status_t channel::create(uint32_t flags, channel* endpoint0,
                             channel* endpoint1) {
@@ -22,4 +31,43 @@ zx_status_t channel::create(uint32_t flags, channel* endpoint0,
     return status;
 }
 
+zx_status_t channel::writev(uint32_t flags, const iovec* parts,
+                            size_t num_parts, const zx_handle_t* handles,
+                            uint32_t num_handles) const {
+    size_t size = 0u;
+    for (size_t i = 0u; i < num_parts; i++) {
+        size += parts[i].iov_len;
+        if (size > ZX_CHANNEL_MAX_MSG_BYTES) {
+            zx_handle_close_many(handles, num_handles);
+            return ZX_ERR_OUT_OF_RANGE;
+        }
+    }
+    if (num_parts == 1u) {
+        return zx_channel_write(get(), flags, parts[0].iov_base,
+                                static_cast<uint32_t>(size), handles,
+                                num_handles);
+    }
+
+    uint8_t inline_bytes[kInlineBytes];
+    uint8_t* bytes = inline_bytes;
+    if (size > kInlineBytes) {
+        bytes = new (std::nothrow) uint8_t[size];
+        if (!bytes) {
+            zx_handle_close_many(handles, num_handles);
+            return ZX_ERR_NO_MEMORY;
+        }
+    }
+    size_t offset = 0u;
+    for (size_t i = 0u; i < num_parts; i++) {
+        memcpy(bytes + offset, parts[i].iov_base, parts[i].iov_len);
+        offset += parts[i].iov_len;
+    }
+    zx_status_t status = zx_channel_write(get(), flags, bytes,
+                                          static_cast<uint32_t>(size), handles,
+                                          num_handles);
+    if (bytes != inline_bytes)
+        delete[] bytes;
+    return status;
+}
+
 } // namespace zx
@@ -5,6 +5,8 @@
 #ifndef LIB_ZX_CHANNEL_H_
 #define LIB_ZX_CHANNEL_H_
 
+#include <sys/uio.h>
+
 #include <lib/zx/handle.h>
 #include <lib/zx/object.h>
 #include <lib/zx/time.h>
@@ -51,6 +53,16 @@ public:
                                 num_handles);
     }
 
+    // Writes a message whose bytes are the concatenation of the |num_parts|
+    // buffers in |parts|.
+    //
+    // A single buffer is written in place.  Otherwise the buffers are copied
+    // once into a contiguous buffer, which is on the stack if the message is
+    // small.  As with |write()|, the handles are consumed even if the write
+    // fails.
+    zx_status_t writev(uint32_t flags, const iovec* parts, size_t num_parts,
+                       const zx_handle_t* handles, uint32_t num_handles) const;
+
     zx_status_t call(uint32_t flags, zx::time deadline,
                      const zx_channel_call_args_t* args,
                      uint32_t* actual_bytes, uint32_t* actual_handles) const {
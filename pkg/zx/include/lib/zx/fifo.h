@@ -5,6 +5,8 @@
 #ifndef LIB_ZX_FIFO_H_
 #define LIB_ZX_FIFO_H_
 
+#include <type_traits>
+
 #include <lib/zx/handle.h>
 #include <lib/zx/object.h>
 
@@ -42,6 +44,49 @@ public:
 
 using unowned_fifo = unowned<fifo>;
 
+// A fifo whose elements are of type |T|, so that reads and writes are
+// expressed in elements rather than in bytes.
+template <typename T>
+class typed_fifo final : public fifo {
+public:
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "fifo elements are copied as bytes");
+
+    constexpr typed_fifo() = default;
+
+    explicit typed_fifo(zx_handle_t value) : fifo(value) {}
+
+    explicit typed_fifo(handle&& h) : fifo(h.release()) {}
+
+    typed_fifo(typed_fifo&& other) : fifo(other.release()) {}
+
+    typed_fifo& operator=(typed_fifo&& other) {
+        reset(other.release());
+        return *this;
+    }
+
+    static zx_status_t create(uint32_t elem_count, uint32_t options,
+                              typed_fifo* out0, typed_fifo* out1) {
+        return fifo::create(elem_count, sizeof(T), options, out0, out1);
+    }
+
+    zx_status_t write(const T* elements, size_t count, size_t* actual_count) const {
+        return fifo::write(sizeof(T), elements, count, actual_count);
+    }
+
+    zx_status_t write_one(const T& element) const {
+        return fifo::write(sizeof(T), &element, 1u, nullptr);
+    }
+
+    zx_status_t read(T* elements, size_t count, size_t* actual_count) const {
+        return fifo::read(sizeof(T), elements, count, actual_count);
+    }
+
+    zx_status_t read_one(T* element) const {
+        return fifo::read(sizeof(T), element, 1u, nullptr);
+    }
+};
+
 } // namespace zx
 
 #endif  // LIB_ZX_FIFO_H_
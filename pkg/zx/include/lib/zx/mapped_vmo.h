@@ -0,0 +1,84 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_ZX_MAPPED_VMO_H_
+#define LIB_ZX_MAPPED_VMO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <lib/zx/vmar.h>
+#include <lib/zx/vmo.h>
+
+namespace zx {
+
+// Maps a range of a vmo into the root vmar and unmaps it when destroyed.
+//
+// The mapping may be placed at a chosen power-of-two alignment that is
+// larger than a page, such as 2 MiB, so that the kernel can back it with
+// large pages where it supports them.  It may also be committed up front
+// so that the pages are allocated, and the page tables populated, when it is
+// mapped rather than one fault at a time on first access.
+class mapped_vmo final {
+public:
+    // Whether |map()| and |create()| commit the mapping's pages up front.
+    enum class commit_policy {
+        on_demand,
+        up_front,
+    };
+
+    constexpr mapped_vmo() = default;
+
+    // Unmaps the mapping, if any.
+    ~mapped_vmo() { unmap(); }
+
+    mapped_vmo(mapped_vmo&& other);
+    mapped_vmo& operator=(mapped_vmo&& other);
+
+    // Creates a vmo of |size| bytes and maps all of it, keeping the vmo
+    // alongside the mapping.  See |map()| for the remaining arguments.
+    static zx_status_t create(size_t size, zx_vm_option_t options,
+                              mapped_vmo* out, size_t alignment = 0u,
+                              commit_policy commit = commit_policy::on_demand);
+
+    // Maps |size| bytes of |vmo| starting at |vmo_offset|, replacing the
+    // current mapping.  The vmo is not retained; the mapping keeps its pages
+    // alive.
+    //
+    // |options| holds the |ZX_VM_PERM_*| flags of the mapping.
+    // |alignment| is zero for page alignment, or a power of two.
+    //
+    // |size| is rounded up to a whole number of pages.
+    zx_status_t map(const vmo& vmo, uint64_t vmo_offset, size_t size,
+                    zx_vm_option_t options, size_t alignment = 0u,
+                    commit_policy commit = commit_policy::on_demand);
+
+    // Unmaps the mapping, if any, and releases the vmo that |create()| made.
+    void unmap();
+
+    // The vmo that |create()| made, or an invalid vmo if the mapping was
+    // made with |map()|.
+    const zx::vmo& vmo() const { return vmo_; }
+
+    // The mapping's bytes, or null and zero when there is no mapping.
+    uint8_t* data() const { return reinterpret_cast<uint8_t*>(start_); }
+    size_t size() const { return size_; }
+    uint8_t* begin() const { return data(); }
+    uint8_t* end() const { return data() + size_; }
+
+    mapped_vmo(const mapped_vmo&) = delete;
+    mapped_vmo& operator=(const mapped_vmo&) = delete;
+
+private:
+    zx::vmo vmo_;
+    // A vmar that holds just this mapping, when it had to be aligned beyond
+    // what the root vmar guarantees.
+    zx::vmar vmar_;
+    uintptr_t start_ = 0u;
+    size_t size_ = 0u;
+};
+
+} // namespace zx
+
+#endif  // LIB_ZX_MAPPED_VMO_H_
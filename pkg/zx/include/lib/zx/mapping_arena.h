@@ -0,0 +1,94 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_ZX_MAPPING_ARENA_H_
+#define LIB_ZX_MAPPING_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <lib/zx/vmar.h>
+#include <lib/zx/vmo.h>
+
+#include <map>
+#include <mutex>
+
+namespace zx {
+
+// Places short-lived vmo mappings in slots of a vmar reserved once, rather
+// than mapping each into the root vmar and unmapping it again.
+//
+// Slots are carved from the reservation in order and, once released, reused
+// for mappings of the same page-rounded size, so that churn through a few
+// buffer sizes neither fragments the address space nor grows it.  A released
+// slot keeps its mapping until it is reused, when the new mapping replaces
+// it with |ZX_VM_SPECIFIC_OVERWRITE| in the same system call, so reuse costs
+// one syscall instead of an unmap and a map.  The retired mappings keep the
+// pages of their vmos alive, so at most |max_retained_bytes| of them are
+// kept; beyond that, released slots are unmapped at once.
+//
+// The arena is thread-safe.  Destroying it destroys the reservation and
+// every mapping in it, so it must outlive the mappings that it hands out.
+class mapping_arena final {
+public:
+    static constexpr size_t kDefaultMaxRetainedBytes = 16u << 20;
+
+    mapping_arena() = default;
+    ~mapping_arena();
+
+    // Reserves |size| bytes of the root vmar for mappings with at most the
+    // |ZX_VM_PERM_*| flags in |options|.
+    zx_status_t init(size_t size, zx_vm_option_t options,
+                     size_t max_retained_bytes = kDefaultMaxRetainedBytes);
+
+    // Maps |size| bytes of |vmo| starting at |vmo_offset| with the
+    // |ZX_VM_PERM_*| flags in |options|, and returns the address in
+    // |out_address|.  |size| is rounded up to a whole number of pages.
+    //
+    // Returns |ZX_ERR_NO_MEMORY| if no slot of the size is free and the
+    // reservation is used up; the caller may map the vmo elsewhere.
+    zx_status_t map(const vmo& vmo, uint64_t vmo_offset, size_t size,
+                    zx_vm_option_t options, uintptr_t* out_address);
+
+    // Releases the mapping of |size| bytes at |address|, which |map()|
+    // returned, for reuse.  The mapping must no longer be accessed.
+    void unmap(uintptr_t address, size_t size);
+
+    // Unmaps the retired mappings of the released slots.
+    void trim();
+
+    // Whether |address| lies in the arena's reservation.
+    bool contains(uintptr_t address) const {
+        return address >= base_ && address - base_ < size_;
+    }
+
+    // The bytes of the retired mappings that the released slots keep.
+    size_t retained_bytes() const;
+
+    mapping_arena(const mapping_arena&) = delete;
+    mapping_arena& operator=(const mapping_arena&) = delete;
+
+private:
+    struct slot {
+        uintptr_t address;
+        // Whether the slot still holds the mapping it had when released.
+        bool mapped;
+    };
+
+    zx::vmar vmar_;
+    uintptr_t base_ = 0u;
+    size_t size_ = 0u;
+    size_t max_retained_bytes_ = 0u;
+
+    mutable std::mutex mutex_;
+    // The offset of the first byte never handed out.
+    size_t next_offset_ = 0u;
+    // The released slots, by size.
+    std::multimap<size_t, slot> free_slots_;
+    size_t retained_bytes_ = 0u;
+};
+
+} // namespace zx
+
+#endif  // LIB_ZX_MAPPING_ARENA_H_
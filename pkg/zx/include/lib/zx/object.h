@@ -314,6 +314,82 @@ private:
     T value_;
 };
 
+
+// Waits for any of a persistent set of handles to assert some signals.
+//
+// Unlike |zx::object<T>::wait_many()|, which takes an array that the caller
+// builds and then rescans on every call, the set keeps its items between
+// waits and reports just the indices of the items that are ready.
+//
+// Up to |ZX_WAIT_MANY_MAX_ITEMS| items are waited for with a single
+// |zx_object_wait_many()|.  Once the set grows beyond that, it waits with a
+// port instead, re-arming only the items it reported ready last time, so
+// each wait costs system calls in proportion to the number of ready items
+// rather than to the size of the set.  The set keeps using the port from
+// then on.
+//
+// The set does not own the handles, which must stay open while they are in
+// the set.
+//
+// This class is thread-hostile.
+class wait_set final {
+public:
+    wait_set();
+    ~wait_set();
+
+    // The number of items in the set.
+    uint32_t size() const { return count_; }
+
+    // Adds an item that waits for |handle| to assert any of |signals|.
+    // Returns its index, which is the current size of the set, in |index|.
+    zx_status_t add(zx_handle_t handle, zx_signals_t signals, uint32_t* index);
+
+    template <typename T>
+    zx_status_t add(const object<T>& handle, zx_signals_t signals,
+                    uint32_t* index) {
+        static_assert(object_traits<T>::supports_wait,
+                      "Object is not waitable.");
+        return add(handle.get(), signals, index);
+    }
+
+    // Removes the item at |index|, moving the set's last item to |index| in
+    // its stead.
+    void remove(uint32_t index);
+
+    // The signals that the item at |index| had pending when the last wait
+    // reported it ready.
+    zx_signals_t pending(uint32_t index) const { return items_[index].pending; }
+
+    // Waits until at least one item is ready or |deadline| passes.
+    //
+    // Stores the indices of up to |ready_capacity| ready items in |ready| and
+    // their number in |ready_count|.  In the port-based mode, items beyond
+    // |ready_capacity| are reported by the next wait.
+    zx_status_t wait(zx::time deadline, uint32_t* ready, size_t ready_capacity,
+                     size_t* ready_count);
+
+    wait_set(const wait_set&) = delete;
+    wait_set(wait_set&&) = delete;
+    wait_set& operator=(const wait_set&) = delete;
+    wait_set& operator=(wait_set&&) = delete;
+
+private:
+    zx_status_t reserve(uint32_t capacity);
+    zx_status_t begin_port_mode();
+    zx_status_t arm_port_waits();
+    void forget_unarmed(uint32_t index);
+
+    zx_wait_item_t* items_ = nullptr;
+    uint32_t count_ = 0u;
+    uint32_t capacity_ = 0u;
+
+    // Used once the set outgrows |zx_object_wait_many()|.  Each item's key is
+    // its index.  |unarmed_| lists the items that have no async wait pending.
+    object<port> port_;
+    uint32_t* unarmed_ = nullptr;
+    uint32_t unarmed_count_ = 0u;
+};
+
 } // namespace zx
 
 #endif  // LIB_ZX_OBJECT_H_
@@ -5,6 +5,8 @@
 #ifndef LIB_ZX_SOCKET_H_
 #define LIB_ZX_SOCKET_H_
 
+#include <sys/uio.h>
+
 #include <lib/zx/handle.h>
 #include <lib/zx/object.h>
 
@@ -40,6 +42,27 @@ public:
         return zx_socket_read(get(), options, buffer, len, actual);
     }
 
+    // Writes the |iov_count| buffers in |iov| in order, as one stream of
+    // bytes.
+    //
+    // Runs of small buffers are coalesced on the stack into a single write,
+    // so that a header and a short payload cost one system call, while large
+    // buffers are written in place without being copied.  Like |write()|,
+    // stops short once the socket is full and returns the number of bytes
+    // written in |actual|; an error after some bytes were written is
+    // reported as a short write.
+    //
+    // Meant for stream sockets: a datagram socket would receive each write
+    // as a message of its own.
+    zx_status_t writev(uint32_t options, const iovec* iov, size_t iov_count,
+                       size_t* actual) const;
+
+    // Reads into the |iov_count| buffers in |iov| in order, as one stream of
+    // bytes, coalescing runs of small buffers into a single read the same
+    // way as |writev()|.  Returns the number of bytes read in |actual|.
+    zx_status_t readv(uint32_t options, const iovec* iov, size_t iov_count,
+                      size_t* actual) const;
+
     zx_status_t share(socket socket_to_share) const {
         return zx_socket_share(get(), socket_to_share.release());
     }
@@ -107,6 +107,19 @@ public:
     // Acquires the number of ticks contained within this object.
     constexpr zx_ticks_t get() const { return value_; }
 
+    // Converts to the span of time that this many ticks take.
+    //
+    // The conversion uses a fixed-point scale that is computed from
+    // |zx_ticks_per_second()| once per process, so it costs a multiplication
+    // rather than a system call and a division.  Stamping events with
+    // |now()| and converting the differences later is cheaper than reading
+    // the monotonic clock for each event.
+    duration to_duration() const;
+
+    // Converts a span of time to the number of ticks it takes, rounding down.
+    // Negative spans convert to zero ticks.
+    static ticks from_duration(duration span);
+
     constexpr ticks operator+(ticks other) const {
         return ticks(value_ + other.value_);
     }
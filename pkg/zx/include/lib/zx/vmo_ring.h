@@ -0,0 +1,115 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_ZX_VMO_RING_H_
+#define LIB_ZX_VMO_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <lib/zx/eventpair.h>
+#include <lib/zx/mapped_vmo.h>
+#include <lib/zx/time.h>
+#include <lib/zx/vmo.h>
+
+namespace zx {
+
+// A single-producer, single-consumer ring of bytes in a vmo, for streaming
+// data such as audio frames between processes without a message per packet.
+//
+// The vmo's first page holds the ring's write and read indices and the pages
+// after it hold the bytes.  The writer and the reader each map the vmo and
+// hold one end of an eventpair.  Each side signals the other with a user
+// signal only when it might be waiting: the writer when it writes into an
+// empty ring, the reader when it reads from a full one.  While both sides
+// keep up, streaming takes no system calls at all.
+//
+// One side calls |create()| and hands a duplicate of the vmo and one end of
+// the eventpair to the other.  Each side then calls |map()| with its end.
+//
+// The ring does not trust the peer: an index that the peer corrupted makes
+// |read()| and |write()| fail with |ZX_ERR_IO_DATA_INTEGRITY| instead of
+// touching memory outside the ring.
+//
+// This class is thread-hostile.  Only one side may call |write()| and
+// |wait_writable()|, and only the other may call |read()| and
+// |wait_readable()|.
+class vmo_ring final {
+public:
+    // Asserted on the reader's end of the eventpair when the ring has bytes.
+    static constexpr zx_signals_t readable_signal = ZX_USER_SIGNAL_0;
+    // Asserted on the writer's end of the eventpair when the ring has room.
+    static constexpr zx_signals_t writable_signal = ZX_USER_SIGNAL_1;
+
+    constexpr vmo_ring() = default;
+    ~vmo_ring() = default;
+
+    vmo_ring(vmo_ring&& other);
+    vmo_ring& operator=(vmo_ring&& other);
+
+    // Creates an empty ring of |capacity| bytes, which must be a power of two
+    // and a whole number of pages, along with the eventpair that signals it.
+    static zx_status_t create(size_t capacity, zx::vmo* vmo,
+                              zx::eventpair* writer_event,
+                              zx::eventpair* reader_event);
+
+    // Maps a ring made by |create()|, committing its pages up front so that
+    // streaming does not fault them in.  |event| is this side's end of the
+    // eventpair.
+    static zx_status_t map(const zx::vmo& vmo, zx::eventpair event,
+                           vmo_ring* out);
+
+    // The number of bytes the ring holds when full, or zero if unmapped.
+    size_t capacity() const { return capacity_; }
+
+    // The number of bytes that may be read from, or written into, the ring.
+    size_t readable_bytes() const;
+    size_t writable_bytes() const;
+
+    // Copies up to |size| bytes into the ring.
+    //
+    // Returns |ZX_OK| and the number of bytes copied, |ZX_ERR_SHOULD_WAIT| if
+    // the ring is full, or |ZX_ERR_IO_DATA_INTEGRITY| if the reader
+    // corrupted the ring.  Neither this nor |read()| makes a system call
+    // unless it has to signal the peer, so neither notices that the peer is
+    // gone; |wait_writable()| and |wait_readable()| do.
+    zx_status_t write(const void* data, size_t size, size_t* actual);
+
+    // Copies up to |size| bytes out of the ring.
+    //
+    // Returns |ZX_OK| and the number of bytes copied, |ZX_ERR_SHOULD_WAIT| if
+    // the ring is empty, or |ZX_ERR_IO_DATA_INTEGRITY| if the writer
+    // corrupted the ring.
+    zx_status_t read(void* data, size_t size, size_t* actual);
+
+    // Waits until the ring has bytes to read, or room to write.
+    //
+    // Returns |ZX_OK| once it does, |ZX_ERR_PEER_CLOSED| if the other side is
+    // gone so that it never will, or |ZX_ERR_TIMED_OUT| if |deadline| passes.
+    zx_status_t wait_readable(zx::time deadline) const;
+    zx_status_t wait_writable(zx::time deadline) const;
+
+    vmo_ring(const vmo_ring&) = delete;
+    vmo_ring& operator=(const vmo_ring&) = delete;
+
+private:
+    struct header;
+
+    header* get_header() const {
+        return reinterpret_cast<header*>(mapping_.data());
+    }
+    bool is_ready(zx_signals_t signal) const;
+    zx_status_t wait(zx_signals_t signal, zx::time deadline) const;
+    void copy_in(uint64_t index, const uint8_t* data, size_t size);
+    void copy_out(uint64_t index, uint8_t* data, size_t size) const;
+
+    mapped_vmo mapping_;
+    zx::eventpair event_;
+    // Kept apart from the header, which the peer may write.
+    size_t capacity_ = 0u;
+};
+
+} // namespace zx
+
+#endif  // LIB_ZX_VMO_RING_H_
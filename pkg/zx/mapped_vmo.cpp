@@ -0,0 +1,130 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/zx/mapped_vmo.h>
+
+#include <zircon/limits.h>
+#include <zircon/syscalls.h>
+
+#include <utility>
+
+namespace zx {
+namespace {
+
+size_t round_up(size_t value, size_t multiple) {
+    return (value + multiple - 1) & ~(multiple - 1);
+}
+
+// The |ZX_VM_CAN_MAP_*| flags a vmar needs to hold a mapping with the
+// |ZX_VM_PERM_*| flags in |options|.
+zx_vm_option_t can_map_flags(zx_vm_option_t options) {
+    zx_vm_option_t flags = ZX_VM_CAN_MAP_SPECIFIC;
+    if (options & ZX_VM_PERM_READ)
+        flags |= ZX_VM_CAN_MAP_READ;
+    if (options & ZX_VM_PERM_WRITE)
+        flags |= ZX_VM_CAN_MAP_WRITE;
+    if (options & ZX_VM_PERM_EXECUTE)
+        flags |= ZX_VM_CAN_MAP_EXECUTE;
+    return flags;
+}
+
+} // namespace
+
+mapped_vmo::mapped_vmo(mapped_vmo&& other)
+    : vmo_(std::move(other.vmo_)), vmar_(std::move(other.vmar_)),
+      start_(other.start_), size_(other.size_) {
+    other.start_ = 0u;
+    other.size_ = 0u;
+}
+
+mapped_vmo& mapped_vmo::operator=(mapped_vmo&& other) {
+    if (this != &other) {
+        unmap();
+        vmo_ = std::move(other.vmo_);
+        vmar_ = std::move(other.vmar_);
+        start_ = other.start_;
+        size_ = other.size_;
+        other.start_ = 0u;
+        other.size_ = 0u;
+    }
+    return *this;
+}
+
+zx_status_t mapped_vmo::create(size_t size, zx_vm_option_t options,
+                               mapped_vmo* out, size_t alignment,
+                               commit_policy commit) {
+    zx::vmo vmo;
+    zx_status_t status = zx::vmo::create(size, 0u, &vmo);
+    if (status != ZX_OK)
+        return status;
+    mapped_vmo mapping;
+    status = mapping.map(vmo, 0u, size, options, alignment, commit);
+    if (status != ZX_OK)
+        return status;
+    mapping.vmo_ = std::move(vmo);
+    *out = std::move(mapping);
+    return ZX_OK;
+}
+
+zx_status_t mapped_vmo::map(const zx::vmo& vmo, uint64_t vmo_offset,
+                            size_t size, zx_vm_option_t options,
+                            size_t alignment, commit_policy commit) {
+    if (size == 0u || (alignment & (alignment - 1)) != 0u)
+        return ZX_ERR_INVALID_ARGS;
+    size = round_up(size, ZX_PAGE_SIZE);
+
+    if (commit == commit_policy::up_front) {
+        zx_status_t status = vmo.op_range(ZX_VMO_OP_COMMIT, vmo_offset, size,
+                                          nullptr, 0u);
+        if (status != ZX_OK)
+            return status;
+        options |= ZX_VM_MAP_RANGE;
+    }
+
+    zx::vmar vmar;
+    uintptr_t start = 0u;
+    zx_status_t status;
+    if (alignment <= ZX_PAGE_SIZE) {
+        status = zx::vmar::root_self()->map(0u, vmo, vmo_offset, size,
+                                            options, &start);
+    } else {
+        // Reserve enough address space to be sure it holds an aligned range
+        // of |size| bytes, then map the vmo at that range.
+        uintptr_t base = 0u;
+        status = zx::vmar::root_self()->allocate(
+            0u, size + alignment - ZX_PAGE_SIZE, can_map_flags(options),
+            &vmar, &base);
+        if (status == ZX_OK) {
+            status = vmar.map(round_up(base, alignment) - base, vmo,
+                              vmo_offset, size, options | ZX_VM_SPECIFIC,
+                              &start);
+            if (status != ZX_OK)
+                vmar.destroy();
+        }
+    }
+    if (status != ZX_OK)
+        return status;
+
+    unmap();
+    vmar_ = std::move(vmar);
+    start_ = start;
+    size_ = size;
+    return ZX_OK;
+}
+
+void mapped_vmo::unmap() {
+    if (start_) {
+        if (vmar_) {
+            vmar_.destroy();
+            vmar_.reset();
+        } else {
+            zx::vmar::root_self()->unmap(start_, size_);
+        }
+        start_ = 0u;
+        size_ = 0u;
+    }
+    vmo_.reset();
+}
+
+} // namespace zx
@@ -0,0 +1,130 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/zx/mapping_arena.h>
+
+#include <zircon/limits.h>
+#include <zircon/syscalls.h>
+
+namespace zx {
+namespace {
+
+size_t round_up(size_t value, size_t multiple) {
+    return (value + multiple - 1) & ~(multiple - 1);
+}
+
+// The |ZX_VM_CAN_MAP_*| flags a vmar needs to hold mappings with the
+// |ZX_VM_PERM_*| flags in |options|.
+zx_vm_option_t can_map_flags(zx_vm_option_t options) {
+    zx_vm_option_t flags = ZX_VM_CAN_MAP_SPECIFIC;
+    if (options & ZX_VM_PERM_READ)
+        flags |= ZX_VM_CAN_MAP_READ;
+    if (options & ZX_VM_PERM_WRITE)
+        flags |= ZX_VM_CAN_MAP_WRITE;
+    if (options & ZX_VM_PERM_EXECUTE)
+        flags |= ZX_VM_CAN_MAP_EXECUTE;
+    return flags;
+}
+
+} // namespace
+
+mapping_arena::~mapping_arena() {
+    if (vmar_)
+        vmar_.destroy();
+}
+
+zx_status_t mapping_arena::init(size_t size, zx_vm_option_t options,
+                                size_t max_retained_bytes) {
+    if (vmar_)
+        return ZX_ERR_BAD_STATE;
+    if (size == 0u)
+        return ZX_ERR_INVALID_ARGS;
+    size = round_up(size, ZX_PAGE_SIZE);
+    zx_status_t status = vmar::root_self()->allocate(
+        0u, size, can_map_flags(options), &vmar_, &base_);
+    if (status != ZX_OK)
+        return status;
+    size_ = size;
+    max_retained_bytes_ = max_retained_bytes;
+    return ZX_OK;
+}
+
+zx_status_t mapping_arena::map(const vmo& vmo, uint64_t vmo_offset,
+                               size_t size, zx_vm_option_t options,
+                               uintptr_t* out_address) {
+    if (!vmar_)
+        return ZX_ERR_BAD_STATE;
+    if (size == 0u)
+        return ZX_ERR_INVALID_ARGS;
+    size = round_up(size, ZX_PAGE_SIZE);
+
+    slot s;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = free_slots_.find(size);
+        if (it != free_slots_.end()) {
+            s = it->second;
+            free_slots_.erase(it);
+            if (s.mapped)
+                retained_bytes_ -= size;
+        } else if (size <= size_ - next_offset_) {
+            s = slot{base_ + next_offset_, false};
+            next_offset_ += size;
+        } else {
+            return ZX_ERR_NO_MEMORY;
+        }
+    }
+
+    // A retired mapping is replaced in place, in the same system call.
+    zx_vm_option_t placement =
+        s.mapped ? ZX_VM_SPECIFIC_OVERWRITE : ZX_VM_SPECIFIC;
+    uintptr_t address;
+    zx_status_t status = vmar_.map(s.address - base_, vmo, vmo_offset, size,
+                                   options | placement, &address);
+    if (status != ZX_OK) {
+        // The slot is as it was: a failed overwrite leaves the old mapping.
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (s.mapped)
+            retained_bytes_ += size;
+        free_slots_.emplace(size, s);
+        return status;
+    }
+    *out_address = address;
+    return ZX_OK;
+}
+
+void mapping_arena::unmap(uintptr_t address, size_t size) {
+    size = round_up(size, ZX_PAGE_SIZE);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (retained_bytes_ + size <= max_retained_bytes_) {
+            retained_bytes_ += size;
+            free_slots_.emplace(size, slot{address, true});
+            return;
+        }
+    }
+    // Unmapped before the slot is free, so that no new mapping in it is
+    // unmapped too.
+    vmar_.unmap(address, size);
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_slots_.emplace(size, slot{address, false});
+}
+
+void mapping_arena::trim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : free_slots_) {
+        if (!entry.second.mapped)
+            continue;
+        vmar_.unmap(entry.second.address, entry.first);
+        entry.second.mapped = false;
+    }
+    retained_bytes_ = 0u;
+}
+
+size_t mapping_arena::retained_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return retained_bytes_;
+}
+
+} // namespace zx
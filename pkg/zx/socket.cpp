@@ -4,9 +4,30 @@
 
 #include <lib/zx/socket.h>
 
+#include <string.h>
 #include <zircon/syscalls.h>
 
 namespace zx {
+namespace {
+
+// Buffers smaller than this are gathered into, or scattered from, one
+// buffer of this size on the stack so that each run of them costs a single
+// system call.
+constexpr size_t kCoalesceSize = 1024u;
+
+// Returns the end of the run of buffers starting at |iov[begin]| whose
+// sizes, together, fit in |kCoalesceSize| bytes, and their total size.
+size_t find_run(const iovec* iov, size_t iov_count, size_t begin,
+                size_t* run_size) {
+    size_t size = 0u;
+    size_t end = begin;
+    while (end < iov_count && iov[end].iov_len <= kCoalesceSize - size)
+        size += iov[end++].iov_len;
+    *run_size = size;
+    return end;
+}
+
+} // namespace
 
 zx_status_t socket::create(uint32_t flags, socket* endpoint0,
                            socket* endpoint1) {
@@ -22,4 +43,89 @@ zx_status_t socket::create(uint32_t flags, socket* endpoint0,
     return status;
 }
 
+zx_status_t socket::writev(uint32_t options, const iovec* iov,
+                           size_t iov_count, size_t* actual) const {
+    size_t total = 0u;
+    size_t i = 0u;
+    while (i < iov_count) {
+        uint8_t staging[kCoalesceSize];
+        const void* data = iov[i].iov_base;
+        size_t size = iov[i].iov_len;
+        size_t end = find_run(iov, iov_count, i, &size);
+        if (end > i + 1u) {
+            size_t offset = 0u;
+            for (; i < end; i++) {
+                memcpy(staging + offset, iov[i].iov_base, iov[i].iov_len);
+                offset += iov[i].iov_len;
+            }
+            data = staging;
+        } else {
+            // A lone or large buffer is written in place.
+            size = iov[i].iov_len;
+            i++;
+        }
+        if (size == 0u)
+            continue;
+
+        size_t written = 0u;
+        zx_status_t status = zx_socket_write(get(), options, data, size,
+                                             &written);
+        if (status != ZX_OK) {
+            if (total == 0u)
+                return status;
+            break;
+        }
+        total += written;
+        if (written < size)
+            break;
+    }
+    *actual = total;
+    return ZX_OK;
+}
+
+zx_status_t socket::readv(uint32_t options, const iovec* iov,
+                          size_t iov_count, size_t* actual) const {
+    size_t total = 0u;
+    size_t i = 0u;
+    while (i < iov_count) {
+        size_t size = 0u;
+        size_t end = find_run(iov, iov_count, i, &size);
+        if (end > i && size == 0u) {
+            i = end; // skip empty buffers
+            continue;
+        }
+        size_t read = 0u;
+        zx_status_t status;
+        if (end > i + 1u) {
+            uint8_t staging[kCoalesceSize];
+            status = zx_socket_read(get(), options, staging, size, &read);
+            if (status == ZX_OK) {
+                size_t offset = 0u;
+                for (size_t j = i; j < end && offset < read; j++) {
+                    size_t part = read - offset < iov[j].iov_len
+                                      ? read - offset : iov[j].iov_len;
+                    memcpy(iov[j].iov_base, staging + offset, part);
+                    offset += part;
+                }
+            }
+            i = end;
+        } else {
+            size = iov[i].iov_len;
+            status = zx_socket_read(get(), options, iov[i].iov_base, size,
+                                    &read);
+            i++;
+        }
+        if (status != ZX_OK) {
+            if (total == 0u)
+                return status;
+            break;
+        }
+        total += read;
+        if (read < size)
+            break;
+    }
+    *actual = total;
+    return ZX_OK;
+}
+
 } // namespace zx
@@ -0,0 +1,68 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/zx/time.h>
+
+#include <zircon/syscalls.h>
+
+#include <atomic>
+
+namespace zx {
+namespace {
+
+// The scales between ticks and nanoseconds, as fixed-point numbers with this
+// many fractional bits.  Zero until first computed; computing them is
+// idempotent so threads that race to do so agree.
+constexpr unsigned kScaleShift = 48u;
+std::atomic<uint64_t> g_nsec_per_tick{0u};
+std::atomic<uint64_t> g_ticks_per_nsec{0u};
+
+uint64_t divide_rounded(unsigned __int128 dividend, uint64_t divisor) {
+    return static_cast<uint64_t>((dividend + divisor / 2u) / divisor);
+}
+
+uint64_t nsec_per_tick() {
+    uint64_t scale = g_nsec_per_tick.load(std::memory_order_relaxed);
+    if (scale == 0u) {
+        scale = divide_rounded(
+            static_cast<unsigned __int128>(ZX_SEC(1)) << kScaleShift,
+            zx_ticks_per_second());
+        g_nsec_per_tick.store(scale, std::memory_order_relaxed);
+    }
+    return scale;
+}
+
+uint64_t ticks_per_nsec() {
+    uint64_t scale = g_ticks_per_nsec.load(std::memory_order_relaxed);
+    if (scale == 0u) {
+        scale = divide_rounded(
+            static_cast<unsigned __int128>(zx_ticks_per_second())
+                << kScaleShift,
+            ZX_SEC(1));
+        g_ticks_per_nsec.store(scale, std::memory_order_relaxed);
+    }
+    return scale;
+}
+
+} // namespace
+
+duration ticks::to_duration() const {
+    unsigned __int128 nsec =
+        (static_cast<unsigned __int128>(value_) * nsec_per_tick()) >>
+        kScaleShift;
+    if (nsec > static_cast<unsigned __int128>(ZX_TIME_INFINITE))
+        return duration::infinite();
+    return duration(static_cast<zx_duration_t>(nsec));
+}
+
+ticks ticks::from_duration(duration span) {
+    if (span.get() <= 0)
+        return ticks();
+    unsigned __int128 count =
+        (static_cast<unsigned __int128>(span.get()) * ticks_per_nsec()) >>
+        kScaleShift;
+    return ticks(static_cast<zx_ticks_t>(count));
+}
+
+} // namespace zx
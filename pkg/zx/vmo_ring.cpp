@@ -0,0 +1,230 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/zx/vmo_ring.h>
+
+#include <stddef.h>
+#include <string.h>
+#include <zircon/limits.h>
+
+#include <atomic>
+#include <utility>
+
+namespace zx {
+
+// Lives in the vmo's first page.  Each index counts every byte ever written
+// or read, so the ring is empty when they are equal and full when they are
+// |capacity| apart.  The indices are on separate cache lines so that the two
+// sides do not contend for one.
+struct vmo_ring::header {
+    uint64_t capacity;
+    alignas(64) std::atomic<uint64_t> write_index;
+    alignas(64) std::atomic<uint64_t> read_index;
+};
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t) &&
+                  ATOMIC_LLONG_LOCK_FREE == 2,
+              "The indices must be lock-free to be shared between processes.");
+
+vmo_ring::vmo_ring(vmo_ring&& other)
+    : mapping_(std::move(other.mapping_)), event_(std::move(other.event_)),
+      capacity_(other.capacity_) {
+    other.capacity_ = 0u;
+}
+
+vmo_ring& vmo_ring::operator=(vmo_ring&& other) {
+    if (this != &other) {
+        mapping_ = std::move(other.mapping_);
+        event_ = std::move(other.event_);
+        capacity_ = other.capacity_;
+        other.capacity_ = 0u;
+    }
+    return *this;
+}
+
+zx_status_t vmo_ring::create(size_t capacity, zx::vmo* vmo,
+                             zx::eventpair* writer_event,
+                             zx::eventpair* reader_event) {
+    static_assert(sizeof(header) <= ZX_PAGE_SIZE,
+                  "The header must fit in the first page.");
+    if (capacity == 0u || (capacity & (capacity - 1)) != 0u ||
+        capacity % ZX_PAGE_SIZE != 0u)
+        return ZX_ERR_INVALID_ARGS;
+
+    // The vmo starts out zeroed, so the ring starts out empty.
+    zx::vmo ring_vmo;
+    zx_status_t status = zx::vmo::create(ZX_PAGE_SIZE + capacity, 0u,
+                                         &ring_vmo);
+    if (status != ZX_OK)
+        return status;
+    uint64_t header_capacity = capacity;
+    status = ring_vmo.write(&header_capacity, offsetof(header, capacity),
+                            sizeof(header_capacity));
+    if (status != ZX_OK)
+        return status;
+    status = zx::eventpair::create(0u, writer_event, reader_event);
+    if (status != ZX_OK)
+        return status;
+    *vmo = std::move(ring_vmo);
+    return ZX_OK;
+}
+
+zx_status_t vmo_ring::map(const zx::vmo& vmo, zx::eventpair event,
+                          vmo_ring* out) {
+    // Read the capacity before mapping so that the peer cannot change it
+    // after it is checked.
+    uint64_t capacity = 0u;
+    zx_status_t status = vmo.read(&capacity, offsetof(header, capacity),
+                                  sizeof(capacity));
+    if (status != ZX_OK)
+        return status;
+    uint64_t vmo_size = 0u;
+    status = vmo.get_size(&vmo_size);
+    if (status != ZX_OK)
+        return status;
+    if (capacity == 0u || (capacity & (capacity - 1)) != 0u ||
+        capacity % ZX_PAGE_SIZE != 0u || capacity > vmo_size - ZX_PAGE_SIZE)
+        return ZX_ERR_INVALID_ARGS;
+
+    vmo_ring ring;
+    status = ring.mapping_.map(vmo, 0u, ZX_PAGE_SIZE + capacity,
+                               ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, 0u,
+                               mapped_vmo::commit_policy::up_front);
+    if (status != ZX_OK)
+        return status;
+    ring.event_ = std::move(event);
+    ring.capacity_ = static_cast<size_t>(capacity);
+    *out = std::move(ring);
+    return ZX_OK;
+}
+
+size_t vmo_ring::readable_bytes() const {
+    if (!capacity_)
+        return 0u;
+    header* h = get_header();
+    uint64_t used = h->write_index.load() - h->read_index.load();
+    return used <= capacity_ ? static_cast<size_t>(used) : 0u;
+}
+
+size_t vmo_ring::writable_bytes() const {
+    if (!capacity_)
+        return 0u;
+    header* h = get_header();
+    uint64_t used = h->write_index.load() - h->read_index.load();
+    return used <= capacity_ ? capacity_ - static_cast<size_t>(used) : 0u;
+}
+
+zx_status_t vmo_ring::write(const void* data, size_t size, size_t* actual) {
+    if (!capacity_)
+        return ZX_ERR_BAD_STATE;
+    header* h = get_header();
+    uint64_t write_index = h->write_index.load(std::memory_order_relaxed);
+    uint64_t read_index = h->read_index.load(std::memory_order_acquire);
+    uint64_t used = write_index - read_index;
+    if (used > capacity_)
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    size_t count = capacity_ - static_cast<size_t>(used);
+    if (count == 0u)
+        return ZX_ERR_SHOULD_WAIT;
+    if (count > size)
+        count = size;
+
+    copy_in(write_index, static_cast<const uint8_t*>(data), count);
+    h->write_index.store(write_index + count);
+
+    // The reader only waits once it has consumed everything written before,
+    // so only wake it if it has.  It clears the signal before it checks the
+    // index one last time, so this cannot miss it.
+    if (h->read_index.load() == write_index) {
+        zx_status_t status = event_.signal_peer(0u, readable_signal);
+        if (status != ZX_OK && status != ZX_ERR_PEER_CLOSED)
+            return status;
+    }
+    *actual = count;
+    return ZX_OK;
+}
+
+zx_status_t vmo_ring::read(void* data, size_t size, size_t* actual) {
+    if (!capacity_)
+        return ZX_ERR_BAD_STATE;
+    header* h = get_header();
+    uint64_t write_index = h->write_index.load(std::memory_order_acquire);
+    uint64_t read_index = h->read_index.load(std::memory_order_relaxed);
+    uint64_t used = write_index - read_index;
+    if (used > capacity_)
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    size_t count = static_cast<size_t>(used);
+    if (count == 0u)
+        return ZX_ERR_SHOULD_WAIT;
+    if (count > size)
+        count = size;
+
+    copy_out(read_index, static_cast<uint8_t*>(data), count);
+    h->read_index.store(read_index + count);
+
+    // Likewise, the writer only waits once it has filled the ring.
+    if (h->write_index.load() - read_index == capacity_) {
+        zx_status_t status = event_.signal_peer(0u, writable_signal);
+        if (status != ZX_OK && status != ZX_ERR_PEER_CLOSED)
+            return status;
+    }
+    *actual = count;
+    return ZX_OK;
+}
+
+zx_status_t vmo_ring::wait_readable(zx::time deadline) const {
+    return wait(readable_signal, deadline);
+}
+
+zx_status_t vmo_ring::wait_writable(zx::time deadline) const {
+    return wait(writable_signal, deadline);
+}
+
+bool vmo_ring::is_ready(zx_signals_t signal) const {
+    return (signal == readable_signal ? readable_bytes()
+                                      : writable_bytes()) != 0u;
+}
+
+zx_status_t vmo_ring::wait(zx_signals_t signal, zx::time deadline) const {
+    if (!capacity_)
+        return ZX_ERR_BAD_STATE;
+    for (;;) {
+        if (is_ready(signal))
+            return ZX_OK;
+
+        // Clear the signal before checking again, so that the peer either
+        // sees our index and signals afterwards or we see its index.
+        zx_status_t status = event_.signal(signal, 0u);
+        if (status != ZX_OK)
+            return status;
+        if (is_ready(signal))
+            return ZX_OK;
+
+        zx_signals_t pending = 0u;
+        status = event_.wait_one(signal | ZX_EVENTPAIR_PEER_CLOSED, deadline,
+                                 &pending);
+        if (status != ZX_OK)
+            return status;
+        if (!(pending & signal))
+            return is_ready(signal) ? ZX_OK : ZX_ERR_PEER_CLOSED;
+    }
+}
+
+void vmo_ring::copy_in(uint64_t index, const uint8_t* data, size_t size) {
+    uint8_t* bytes = mapping_.data() + ZX_PAGE_SIZE;
+    size_t offset = static_cast<size_t>(index) & (capacity_ - 1);
+    size_t first = capacity_ - offset < size ? capacity_ - offset : size;
+    memcpy(bytes + offset, data, first);
+    memcpy(bytes, data + first, size - first);
+}
+
+void vmo_ring::copy_out(uint64_t index, uint8_t* data, size_t size) const {
+    const uint8_t* bytes = mapping_.data() + ZX_PAGE_SIZE;
+    size_t offset = static_cast<size_t>(index) & (capacity_ - 1);
+    size_t first = capacity_ - offset < size ? capacity_ - offset : size;
+    memcpy(data, bytes + offset, first);
+    memcpy(data + first, bytes, size - first);
+}
+
+} // namespace zx
@@ -0,0 +1,161 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/zx/object.h>
+
+#include <lib/zx/port.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+#include <new>
+
+namespace zx {
+
+wait_set::wait_set() = default;
+
+wait_set::~wait_set() {
+    delete[] items_;
+    delete[] unarmed_;
+}
+
+zx_status_t wait_set::add(zx_handle_t handle, zx_signals_t signals,
+                          uint32_t* index) {
+    if (count_ == capacity_) {
+        if (capacity_ > UINT32_MAX / 2u)
+            return ZX_ERR_OUT_OF_RANGE;
+        zx_status_t status = reserve(capacity_ ? capacity_ * 2u : 4u);
+        if (status != ZX_OK)
+            return status;
+    }
+
+    uint32_t new_index = count_;
+    items_[new_index] = zx_wait_item_t{handle, signals, 0u};
+    count_++;
+    if (port_) {
+        unarmed_[unarmed_count_++] = new_index;
+    } else if (count_ > ZX_WAIT_MANY_MAX_ITEMS) {
+        zx_status_t status = begin_port_mode();
+        if (status != ZX_OK) {
+            count_--;
+            return status;
+        }
+    }
+    *index = new_index;
+    return ZX_OK;
+}
+
+void wait_set::remove(uint32_t index) {
+    uint32_t last = count_ - 1u;
+    if (port_) {
+        // The last item's key changes along with its index, so its wait
+        // must be canceled too and begun again under the new key.
+        zx_port_cancel(port_.get(), items_[index].handle, index);
+        forget_unarmed(index);
+        if (index != last) {
+            zx_port_cancel(port_.get(), items_[last].handle, last);
+            forget_unarmed(last);
+            unarmed_[unarmed_count_++] = index;
+        }
+    }
+    items_[index] = items_[last];
+    count_ = last;
+}
+
+zx_status_t wait_set::wait(zx::time deadline, uint32_t* ready,
+                           size_t ready_capacity, size_t* ready_count) {
+    if (ready_capacity == 0u)
+        return ZX_ERR_INVALID_ARGS;
+    *ready_count = 0u;
+
+    if (!port_) {
+        zx_status_t status = zx_object_wait_many(items_, count_,
+                                                 deadline.get());
+        if (status != ZX_OK)
+            return status;
+        size_t count = 0u;
+        for (uint32_t i = 0u; i < count_ && count < ready_capacity; i++) {
+            if (items_[i].pending & items_[i].waitfor)
+                ready[count++] = i;
+        }
+        *ready_count = count;
+        return ZX_OK;
+    }
+
+    zx_status_t status = arm_port_waits();
+    if (status != ZX_OK)
+        return status;
+
+    // Block for the first packet, then take whichever others are queued.
+    size_t count = 0u;
+    while (count < ready_capacity) {
+        zx_port_packet_t packet;
+        status = zx_port_wait(port_.get(),
+                              count ? ZX_TIME_INFINITE_PAST : deadline.get(),
+                              &packet);
+        if (status != ZX_OK)
+            break;
+        if (packet.type != ZX_PKT_TYPE_SIGNAL_ONE || packet.key >= count_)
+            continue;
+        uint32_t i = static_cast<uint32_t>(packet.key);
+        items_[i].pending = packet.signal.observed;
+        unarmed_[unarmed_count_++] = i;
+        ready[count++] = i;
+    }
+    *ready_count = count;
+    return count ? ZX_OK : status;
+}
+
+zx_status_t wait_set::reserve(uint32_t capacity) {
+    zx_wait_item_t* items = new (std::nothrow) zx_wait_item_t[capacity];
+    uint32_t* unarmed = new (std::nothrow) uint32_t[capacity];
+    if (!items || !unarmed) {
+        delete[] items;
+        delete[] unarmed;
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (uint32_t i = 0u; i < count_; i++)
+        items[i] = items_[i];
+    for (uint32_t i = 0u; i < unarmed_count_; i++)
+        unarmed[i] = unarmed_[i];
+    delete[] items_;
+    delete[] unarmed_;
+    items_ = items;
+    unarmed_ = unarmed;
+    capacity_ = capacity;
+    return ZX_OK;
+}
+
+zx_status_t wait_set::begin_port_mode() {
+    zx_status_t status = zx_port_create(0u, port_.reset_and_get_address());
+    if (status != ZX_OK)
+        return status;
+    for (uint32_t i = 0u; i < count_; i++)
+        unarmed_[i] = i;
+    unarmed_count_ = count_;
+    return ZX_OK;
+}
+
+zx_status_t wait_set::arm_port_waits() {
+    while (unarmed_count_ > 0u) {
+        uint32_t i = unarmed_[unarmed_count_ - 1u];
+        zx_status_t status = zx_object_wait_async(
+            items_[i].handle, port_.get(), i, items_[i].waitfor,
+            ZX_WAIT_ASYNC_ONCE);
+        if (status != ZX_OK)
+            return status;
+        unarmed_count_--;
+    }
+    return ZX_OK;
+}
+
+void wait_set::forget_unarmed(uint32_t index) {
+    for (uint32_t i = 0u; i < unarmed_count_; i++) {
+        if (unarmed_[i] == index) {
+            unarmed_[i] = unarmed_[--unarmed_count_];
+            return;
+        }
+    }
+}
+
+} // namespace zx
@@ -0,0 +1,99 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Checks that |fit::join_promises()| and |fit::join_promise_vector()| pass
+// on the wakeups of their children when the task they run in is rerun by
+// something else while they are pending.
+
+#include <lib/fit/promise.h>
+#include <lib/fit/single_threaded_executor.h>
+#include <stdio.h>
+
+#include <utility>
+#include <vector>
+
+namespace {
+
+// The wakeups that the promises of a test take and give.
+struct tickets {
+    bool child_done = false;
+    fit::suspended_task child;
+    fit::suspended_task other;
+};
+
+fit::promise<> make_child(tickets* t) {
+    return fit::make_promise([t](fit::context& context) -> fit::result<> {
+        if (t->child_done)
+            return fit::ok();
+        t->child = context.suspend_task();
+        return fit::pending();
+    });
+}
+
+// Runs |join| in a task that another source resumes once while the join's
+// child is still pending, then completes the child.  Returns whether the
+// task ran to completion rather than being abandoned.
+template <typename Join>
+bool run_with_rerun(Join join, tickets* t) {
+    bool completed = false;
+    int runs = 0;
+    fit::single_threaded_executor executor;
+    executor.schedule_task(fit::make_promise(
+        [&completed, &runs, t, future = fit::future<typename Join::value_type,
+                                                    typename Join::error_type>(
+                                   std::move(join))](
+            fit::context& context) mutable -> fit::result<> {
+            runs++;
+            if (future(context)) {
+                completed = true;
+                return fit::ok();
+            }
+            if (runs == 1)
+                t->other = context.suspend_task();
+            return fit::pending();
+        }));
+    // Scheduled after the join, so each of its runs follows one of the
+    // join's runs.
+    executor.schedule_task(fit::make_promise(
+        [t, step = 0](fit::context& context) mutable -> fit::result<> {
+            if (step++ == 0) {
+                // Reruns the join's task, though its child has not woken.
+                t->other.resume_task();
+                context.suspend_task().resume_task();
+                return fit::pending();
+            }
+            t->child_done = true;
+            t->child.resume_task();
+            return fit::ok();
+        }));
+    executor.run();
+    return completed;
+}
+
+bool test_join_promises() {
+    tickets t;
+    return run_with_rerun(fit::join_promises(make_child(&t)), &t);
+}
+
+bool test_join_promise_vector() {
+    tickets t;
+    std::vector<fit::promise<>> children;
+    children.push_back(make_child(&t));
+    return run_with_rerun(fit::join_promise_vector(std::move(children)), &t);
+}
+
+} // namespace
+
+int main() {
+    int failures = 0;
+    if (!test_join_promises()) {
+        fprintf(stderr, "join_promises lost its child's wakeup\n");
+        failures++;
+    }
+    if (!test_join_promise_vector()) {
+        fprintf(stderr, "join_promise_vector lost its child's wakeup\n");
+        failures++;
+    }
+    return failures == 0 ? 0 : 1;
+}